@@ -0,0 +1,45 @@
+/* Expands the frontier of a level of a breadth-first search over the part */
+/* of the graph held by the DPU. */
+
+#include <bfs.h>
+#include <defs.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_VERTICES (1 << 19)
+#define MAX_TOTAL_VERTICES (1 << 22)
+#define MAX_NEIGHBOURS (1 << 22)
+
+__mram_noinit uint32_t row_offsets[MAX_VERTICES + 2];
+__mram_noinit uint32_t neighbours[MAX_NEIGHBOURS];
+__mram_noinit uint64_t frontier[MAX_TOTAL_VERTICES / 64];
+__mram_noinit uint64_t next[MAX_TOTAL_VERTICES / 64];
+__mram_noinit uint64_t visited[MAX_VERTICES / 64];
+__host uint32_t first_vertex;
+__host uint32_t nr_vertices;
+__host uint32_t nr_total_vertices;
+__host uint32_t direction;
+__host uint32_t level;
+__host uint32_t nr_frontier;
+__host uint64_t cycles;
+
+BFS_INIT(search);
+
+int main() {
+  struct bfs_graph graph = {
+    .row_offsets = row_offsets,
+    .neighbours = neighbours,
+    .first_vertex = first_vertex,
+    .nr_vertices = nr_vertices,
+    .nr_total_vertices = nr_total_vertices,
+  };
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  bfs_expand(&search, &graph, (bfs_direction_t)direction, level, frontier, nr_frontier, visited, next);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
@@ -0,0 +1,135 @@
+/* Searches a symmetric R-MAT graph from a few sources, pushing only, */
+/* pulling only and switching between the directions, and reports the */
+/* duration of the steps of each level of the first search. */
+
+#include <dpu.h>
+#include <dpu_bfs.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./bfs"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define SCALE 20
+#define EDGE_FACTOR 8
+#define NR_SOURCES 4
+#define MAX_LEVELS 64
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Each edge picks a quadrant of the adjacency matrix at each bit, with */
+/* probabilities 0.57, 0.19, 0.19 and 0.05, and is listed in both directions. */
+static void rmat(uint32_t nr_vertices, uint32_t nr_edges, uint32_t **row_offsets, uint32_t **neighbours) {
+  uint32_t *sources = malloc(nr_edges * sizeof(uint32_t));
+  uint32_t *destinations = malloc(nr_edges * sizeof(uint32_t));
+  *row_offsets = calloc(nr_vertices + 1, sizeof(uint32_t));
+  *neighbours = malloc(2 * (size_t)nr_edges * sizeof(uint32_t));
+
+  for (uint32_t e = 0; e < nr_edges; e++) {
+    uint32_t u = 0, v = 0;
+    for (uint32_t bit = nr_vertices >> 1; bit != 0; bit >>= 1) {
+      uint32_t r = rand() % 100;
+      if (r >= 57 && r < 76)
+        v |= bit;
+      else if (r >= 76 && r < 95)
+        u |= bit;
+      else if (r >= 95)
+        u |= bit, v |= bit;
+    }
+    sources[e] = u;
+    destinations[e] = v;
+    (*row_offsets)[u + 1]++;
+    (*row_offsets)[v + 1]++;
+  }
+  for (uint32_t v = 0; v < nr_vertices; v++)
+    (*row_offsets)[v + 1] += (*row_offsets)[v];
+  uint32_t *cursors = malloc(nr_vertices * sizeof(uint32_t));
+  memcpy(cursors, *row_offsets, nr_vertices * sizeof(uint32_t));
+  for (uint32_t e = 0; e < nr_edges; e++) {
+    (*neighbours)[cursors[sources[e]]++] = destinations[e];
+    (*neighbours)[cursors[destinations[e]]++] = sources[e];
+  }
+  free(cursors);
+  free(sources);
+  free(destinations);
+}
+
+int main() {
+  static const struct {
+    const char *name;
+    dpu_bfs_direction_t direction;
+  } modes[] = { { "push", DPU_BFS_PUSH }, { "pull", DPU_BFS_PULL }, { "auto", DPU_BFS_AUTO } };
+  static const char *directions[] = { "push", "pull" };
+  struct dpu_set_t set;
+  struct dpu_bfs bfs;
+  struct dpu_bfs_level stats[MAX_LEVELS];
+  uint32_t nr_vertices = 1 << SCALE, *row_offsets, *neighbours, nr_levels;
+  int32_t *levels = malloc(nr_vertices * sizeof(int32_t));
+  int32_t *expected = malloc(nr_vertices * sizeof(int32_t));
+  uint32_t sources[NR_SOURCES];
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  srand(1);
+  rmat(nr_vertices, nr_vertices * EDGE_FACTOR, &row_offsets, &neighbours);
+  for (uint32_t s = 0; s < NR_SOURCES; s++) {
+    do
+      sources[s] = rand() % nr_vertices;
+    while (row_offsets[sources[s] + 1] == row_offsets[sources[s]]);
+  }
+  DPU_ASSERT(dpu_bfs_load(set, nr_vertices, row_offsets, neighbours, true, &bfs));
+
+  for (uint32_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+    double total = 0, round_trips = 0;
+    for (uint32_t s = 0; s < NR_SOURCES; s++) {
+      double start = now();
+      DPU_ASSERT(dpu_bfs_run(&bfs, sources[s], modes[m].direction, levels, stats, MAX_LEVELS, &nr_levels));
+      total += now() - start;
+      for (uint32_t l = 0; l < nr_levels && l < MAX_LEVELS; l++)
+        round_trips += stats[l].to_dpus + stats[l].from_dpus + stats[l].merge;
+
+      dpu_bfs_reference(nr_vertices, row_offsets, neighbours, sources[s], expected);
+      for (uint32_t v = 0; v < nr_vertices; v++) {
+        if (levels[v] != expected[v]) {
+          printf("%s: wrong level of vertex %u from %u: %d instead of %d\n", modes[m].name, v, sources[s], levels[v],
+              expected[v]);
+          errors++;
+          break;
+        }
+      }
+
+      if (s == 0) {
+        printf("%s, source %u:\n", modes[m].name, sources[s]);
+        printf("%6s %10s %10s %10s %10s %10s %10s\n", "level", "direction", "frontier", "to DPU ms", "DPU ms",
+            "from DPU ms", "merge ms");
+        for (uint32_t l = 0; l < nr_levels && l < MAX_LEVELS; l++)
+          printf("%6u %10s %10u %10.3f %10.3f %10.3f %10.3f\n", l, directions[stats[l].direction], stats[l].nr_frontier,
+              stats[l].to_dpus * 1e3, stats[l].dpus * 1e3, stats[l].from_dpus * 1e3, stats[l].merge * 1e3);
+      }
+    }
+    printf("%s: %.3f ms per search, %.3f ms of host round trips, %.1f MTEPS\n\n", modes[m].name, total * 1e3 / NR_SOURCES,
+        round_trips * 1e3 / NR_SOURCES, (double)row_offsets[nr_vertices] / 2 * NR_SOURCES / total / 1e6);
+  }
+
+  dpu_bfs_free(&bfs);
+  DPU_ASSERT(dpu_free(set));
+  free(row_offsets);
+  free(neighbours);
+  free(levels);
+  free(expected);
+  return errors != 0;
+}
@@ -0,0 +1,83 @@
+/* Runs an operation of mram_bitmap.h on the bitmaps held by the DPU: a boolean */
+/* combination of the inputs, a population count, rank and select queries, the */
+/* conversion to positions, and the compression into a Roaring image, its */
+/* decompression and queries on it. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_bitmap.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_BITS (1 << 22)
+#define MAX_INPUTS 4
+#define MAX_QUERIES 4096
+
+enum { COMBINE = 0, POPCOUNT = 1, RANK_SELECT = 2, POSITIONS = 3, ENCODE = 4, DECODE = 5, CONTAINS = 6 };
+
+__mram_noinit uint64_t inputs[MAX_INPUTS][MRAM_BITMAP_SIZE(MAX_BITS) / sizeof(uint64_t)];
+__mram_noinit uint32_t output[MAX_BITS];
+__mram_noinit uint32_t ranks[MRAM_BITMAP_RANKS_SIZE(MAX_BITS) / sizeof(uint32_t)];
+__mram_noinit uint8_t image[MRAM_BITMAP_ROARING_BOUND(MAX_BITS)];
+__mram_noinit uint32_t queries[MAX_QUERIES];
+__mram_noinit uint32_t answers[2 * MAX_QUERIES];
+__host uint32_t mode;
+__host uint32_t op;
+__host uint32_t nr_inputs;
+__host uint32_t nr_bits;
+__host uint32_t nr_queries;
+__host uint32_t result;
+__host uint64_t cycles;
+
+MRAM_BITMAP_INIT(state);
+BARRIER_INIT(ranks_barrier, NR_TASKLETS);
+
+/* Answers the queries of the tasklet, 2 words per query. */
+static void answer(void) {
+  __dma_aligned uint32_t query[2], pair[2];
+
+  for (uint32_t i = me(); i < nr_queries; i += NR_TASKLETS) {
+    mram_read(&queries[i & ~1], query, sizeof(query));
+    if (mode == RANK_SELECT) {
+      pair[0] = mram_bitmap_rank(&state, inputs[0], ranks, query[i & 1]);
+      pair[1] = mram_bitmap_select(&state, inputs[0], ranks, nr_bits, query[i & 1]);
+    } else {
+      pair[0] = mram_bitmap_roaring_contains(&state, image, query[i & 1]);
+      pair[1] = 0;
+    }
+    mram_write(pair, &answers[2 * i], sizeof(pair));
+  }
+}
+
+int main() {
+  const __mram_ptr uint64_t *operands[MAX_INPUTS] = { inputs[0], inputs[1], inputs[2], inputs[3] };
+  uint32_t count = 0;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+
+  if (mode == COMBINE) {
+    count = mram_bitmap_combine(&state, op, operands, nr_inputs, nr_bits, (__mram_ptr uint64_t *)output);
+  } else if (mode == POPCOUNT) {
+    count = mram_bitmap_popcount(&state, inputs[0], nr_bits);
+  } else if (mode == RANK_SELECT) {
+    count = mram_bitmap_ranks(&state, inputs[0], nr_bits, ranks);
+    barrier_wait(&ranks_barrier);
+    answer();
+  } else if (mode == POSITIONS) {
+    count = mram_bitmap_positions(&state, inputs[0], nr_bits, output);
+  } else if (mode == ENCODE) {
+    count = mram_bitmap_roaring_encode(&state, inputs[0], nr_bits, image);
+  } else if (mode == DECODE) {
+    count = mram_bitmap_roaring_decode(&state, image, (__mram_ptr uint64_t *)output);
+  } else if (mode == CONTAINS) {
+    answer();
+  }
+
+  if (me() == 0) {
+    result = count;
+    cycles = perfcounter_get();
+  }
+  return 0;
+}
@@ -0,0 +1,356 @@
+/* Splits bitmaps of several densities between the DPUs, and checks the */
+/* operations of mram_bitmap.h against the host: the boolean combinations, the */
+/* population count, rank and select, the positions, and the Roaring images, */
+/* which must be identical to the images built by the host. Reports the bytes */
+/* processed per cycle by a DPU, the compression ratio of the Roaring images and */
+/* the throughput of the gathers of the parts, as they are and compressed, and */
+/* of the OR of the bitmaps of all the DPUs. */
+
+#include <dpu.h>
+#include <dpu_bitmap.h>
+#include <dpu_varlen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./bitmap"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define MAX_BITS (1 << 22)
+#define MAX_INPUTS 4
+#define NR_QUERIES 4096
+#define BITS_PER_DPU MAX_BITS
+/* The last part is not full. */
+#define NR_BITS ((uint32_t)NR_DPUS * BITS_PER_DPU - 1000)
+#define NR_WORDS (((uint64_t)NR_BITS + 63) / 64)
+#define PART_WORDS (BITS_PER_DPU / 64)
+
+enum { COMBINE = 0, POPCOUNT = 1, RANK_SELECT = 2, POSITIONS = 3, ENCODE = 4, DECODE = 5, CONTAINS = 6 };
+
+struct dataset {
+  const char *name;
+  /* The probability of a bit to be set, per million, or of a run to start for the runs. */
+  uint32_t density;
+  int runs;
+};
+
+static const struct dataset datasets[] = {
+  { "sparse", 100, 0 },
+  { "1%", 10000, 0 },
+  { "50%", 500000, 0 },
+  { "runs", 200, 1 },
+};
+
+static const char *ops[] = { "AND", "OR", "XOR", "ANDNOT" };
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random32(void) { return ((uint32_t)rand() << 16) ^ (uint32_t)rand(); }
+
+static void generate(const struct dataset *d, uint64_t *bitmap) {
+  memset(bitmap, 0, NR_WORDS * sizeof(uint64_t));
+  for (uint64_t bit = 0; bit < NR_BITS;) {
+    if (random32() % 1000000 < d->density) {
+      uint64_t length = d->runs ? 1 + random32() % 3000 : 1;
+      for (uint64_t end = bit + length; bit < end && bit < NR_BITS; bit++)
+        bitmap[bit / 64] |= (uint64_t)1 << (bit % 64);
+    } else {
+      bit++;
+    }
+  }
+}
+
+static uint32_t part_bits(uint32_t each_dpu) {
+  uint64_t first = (uint64_t)each_dpu * BITS_PER_DPU;
+  return NR_BITS - first < BITS_PER_DPU ? (uint32_t)(NR_BITS - first) : BITS_PER_DPU;
+}
+
+static uint64_t run(struct dpu_set_t set, uint32_t mode, uint32_t *results) {
+  struct dpu_set_t dpu;
+  uint64_t cycles[NR_DPUS], max_cycles = 0;
+  uint32_t each_dpu;
+
+  DPU_ASSERT(dpu_broadcast_to(set, "mode", 0, &mode, sizeof(mode), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &results[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "result", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+    max_cycles = cycles[each_dpu] > max_cycles ? cycles[each_dpu] : max_cycles;
+  return max_cycles;
+}
+
+/* Pulls the answers of the queries of each DPU, and counts the wrong ones. */
+static int check_answers(struct dpu_set_t set, uint32_t mode, const uint64_t *bitmap, const uint32_t *queries,
+    uint32_t *answers, uint32_t *prefix) {
+  struct dpu_set_t dpu;
+  uint32_t each_dpu;
+  int errors = 0;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &answers[(size_t)each_dpu * 2 * NR_QUERIES]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "answers", 0, 2 * NR_QUERIES * sizeof(uint32_t), DPU_XFER_DEFAULT));
+
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    const uint64_t *part = &bitmap[(size_t)each_dpu * PART_WORDS];
+    const uint32_t *got = &answers[(size_t)each_dpu * 2 * NR_QUERIES];
+    uint32_t nr_words = (part_bits(each_dpu) + 63) / 64;
+
+    /* prefix[w] is the number of bits set before word w. */
+    prefix[0] = 0;
+    for (uint32_t w = 0; w < nr_words; w++)
+      prefix[w + 1] = prefix[w] + __builtin_popcountll(part[w]);
+
+    for (uint32_t i = 0; i < NR_QUERIES; i++) {
+      uint32_t q = queries[i], expected[2] = { 0, 0 };
+      if (mode == RANK_SELECT) {
+        uint32_t low = 0, high = nr_words;
+        expected[0] = prefix[q / 64] + (q % 64 ? __builtin_popcountll(part[q / 64] << (64 - q % 64)) : 0);
+        expected[1] = UINT32_MAX;
+        if (q < prefix[nr_words]) {
+          /* The last word with at most q bits set before it. */
+          while (low + 1 < high) {
+            uint32_t middle = (low + high) / 2;
+            if (prefix[middle] <= q)
+              low = middle;
+            else
+              high = middle;
+          }
+          uint64_t word = part[low];
+          for (uint32_t k = q - prefix[low]; k != 0; k--)
+            word &= word - 1;
+          expected[1] = low * 64 + __builtin_ctzll(word);
+        }
+      } else {
+        expected[0] = q < part_bits(each_dpu) && (part[q / 64] >> (q % 64)) & 1;
+      }
+      if (got[2 * i] != expected[0] || got[2 * i + 1] != expected[1]) {
+        if (errors < 4)
+          printf("DPU %u query %u (%u): got %u %u, expected %u %u\n", each_dpu, i, q, got[2 * i], got[2 * i + 1],
+              expected[0], expected[1]);
+        errors++;
+      }
+    }
+  }
+  return errors;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint64_t *inputs[MAX_INPUTS], *expected = malloc(NR_WORDS * 8), *check = malloc(NR_WORDS * 8 + PART_WORDS * 8);
+  uint64_t *parts = malloc((size_t)NR_DPUS * PART_WORDS * 8);
+  size_t bound = dpu_bitmap_roaring_bound(BITS_PER_DPU);
+  uint8_t *images = malloc(NR_DPUS * bound), *image = malloc(bound);
+  uint32_t *queries = malloc(NR_QUERIES * sizeof(uint32_t)), *answers = malloc((size_t)NR_DPUS * 2 * NR_QUERIES * 4);
+  uint32_t *prefix = malloc((PART_WORDS + 1) * sizeof(uint32_t)), *positions = malloc((size_t)BITS_PER_DPU * 4);
+  uint32_t results[NR_DPUS], nr_bits[NR_DPUS], nr_queries = NR_QUERIES, each_dpu;
+  uint64_t sizes[NR_DPUS], offsets[NR_DPUS + 1];
+  int errors = 0;
+
+  for (uint32_t i = 0; i < MAX_INPUTS; i++)
+    inputs[i] = malloc(NR_WORDS * 8);
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    nr_bits[each_dpu] = part_bits(each_dpu);
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_bits[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "nr_bits", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_queries", 0, &nr_queries, sizeof(nr_queries), DPU_XFER_DEFAULT));
+
+  srand(1);
+  printf("%-8s %9s %9s %9s %9s %9s %9s %9s %9s\n", "data", "density", "combine", "popcount", "ranks", "encode", "ratio",
+      "raw pull", "roaring");
+  printf("%-8s %9s %9s %9s %9s %9s %9s %9s %9s\n", "", "", "B/cycle", "B/cycle", "B/cycle", "B/cycle", "", "GB/s", "GB/s");
+  for (uint32_t each_dataset = 0; each_dataset < sizeof(datasets) / sizeof(datasets[0]); each_dataset++) {
+    const struct dataset *d = &datasets[each_dataset];
+    uint64_t combine_cycles, popcount_cycles, ranks_cycles, encode_cycles, transferred, compressed = 0, count;
+    uint32_t nr_inputs = 3;
+    double start, raw_time, roaring_time;
+
+    for (uint32_t i = 0; i < MAX_INPUTS; i++) {
+      generate(d, inputs[i]);
+      DPU_ASSERT(dpu_bitmap_push_parts(set, "inputs", i * (BITS_PER_DPU / 8), inputs[i], NR_BITS, BITS_PER_DPU));
+    }
+    DPU_ASSERT(dpu_broadcast_to(set, "nr_inputs", 0, &nr_inputs, sizeof(nr_inputs), DPU_XFER_DEFAULT));
+
+    /* Combinations of the first 3 inputs. */
+    for (uint32_t op = 0; op < 4; op++) {
+      count = 0;
+      for (uint64_t w = 0; w < NR_WORDS; w++) {
+        uint64_t a = inputs[0][w], b = inputs[1][w], c = inputs[2][w];
+        expected[w] = op == 0 ? a & b & c : op == 1 ? a | b | c : op == 2 ? a ^ b ^ c : a & ~b & ~c;
+      }
+      DPU_ASSERT(dpu_broadcast_to(set, "op", 0, &op, sizeof(op), DPU_XFER_DEFAULT));
+      combine_cycles = run(set, COMBINE, results);
+      DPU_ASSERT(dpu_bitmap_pull_parts(set, "output", 0, check, NR_BITS, BITS_PER_DPU));
+      for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+        count += results[each_dpu];
+      if (memcmp(check, expected, NR_WORDS * 8) != 0 || count != dpu_bitmap_popcount(expected, NR_BITS)) {
+        printf("%s: wrong %s\n", d->name, ops[op]);
+        errors++;
+      }
+    }
+
+    popcount_cycles = run(set, POPCOUNT, results);
+    count = 0;
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+      count += results[each_dpu];
+    if (count != dpu_bitmap_popcount(inputs[0], NR_BITS)) {
+      printf("%s: wrong popcount\n", d->name);
+      errors++;
+    }
+
+    /* Rank and select: the queries are positions for rank, and ranks for select. */
+    for (uint32_t i = 0; i < NR_QUERIES; i++)
+      queries[i] = i < 16 ? i * (count / NR_DPUS / 16) : random32() % (i % 2 ? part_bits(NR_DPUS - 1) : count / NR_DPUS + 8);
+    DPU_ASSERT(dpu_broadcast_to(set, "queries", 0, queries, NR_QUERIES * sizeof(uint32_t), DPU_XFER_DEFAULT));
+    ranks_cycles = run(set, RANK_SELECT, results);
+    errors += check_answers(set, RANK_SELECT, inputs[0], queries, answers, prefix);
+
+    /* Positions, checked on the first and last DPUs. */
+    run(set, POSITIONS, results);
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu += NR_DPUS - 1) {
+      const uint64_t *part = &inputs[0][(size_t)each_dpu * PART_WORDS];
+      uint32_t n = 0;
+      DPU_FOREACH(set, dpu, count) {
+        if (count == each_dpu)
+          DPU_ASSERT(dpu_copy_from(dpu, "output", 0, positions, ((results[each_dpu] * 4) + 7) & ~7));
+      }
+      for (uint32_t w = 0; w < (part_bits(each_dpu) + 63) / 64; w++)
+        for (uint64_t bits = part[w]; bits != 0 && n <= results[each_dpu]; bits &= bits - 1, n++)
+          errors += n >= results[each_dpu] || positions[n] != w * 64 + __builtin_ctzll(bits);
+      if (n != results[each_dpu]) {
+        printf("%s: wrong number of positions on DPU %u\n", d->name, each_dpu);
+        errors++;
+      }
+      if (NR_DPUS == 1)
+        break;
+    }
+
+    /* Roaring images built by the DPUs, compared with the images of the host and gathered. */
+    encode_cycles = run(set, ENCODE, results);
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      size_t size;
+      DPU_ASSERT(dpu_bitmap_roaring_encode(
+          &inputs[0][(size_t)each_dpu * PART_WORDS], part_bits(each_dpu), &images[compressed], &size));
+      if (size != results[each_dpu]) {
+        printf("%s: image of %u bytes on DPU %u, expected %zu\n", d->name, results[each_dpu], each_dpu, size);
+        errors++;
+      }
+      sizes[each_dpu] = size;
+      compressed += size;
+    }
+    DPU_FOREACH(set, dpu, each_dpu) {
+      if (each_dpu == NR_DPUS - 1) {
+        DPU_ASSERT(dpu_copy_from(dpu, "image", 0, image, sizes[each_dpu]));
+        if (memcmp(image, &images[compressed - sizes[each_dpu]], sizes[each_dpu]) != 0) {
+          printf("%s: image of DPU %u not identical to the host image\n", d->name, each_dpu);
+          errors++;
+        }
+      }
+    }
+    start = now();
+    DPU_ASSERT(dpu_bitmap_pull_parts(set, "inputs", 0, check, NR_BITS, BITS_PER_DPU));
+    raw_time = now() - start;
+    start = now();
+    DPU_ASSERT(dpu_bitmap_pull_roaring(set, "image", 0, check, NR_BITS, BITS_PER_DPU, &transferred));
+    roaring_time = now() - start;
+    if (memcmp(check, inputs[0], NR_WORDS * 8) != 0) {
+      printf("%s: wrong bitmap gathered from the Roaring images\n", d->name);
+      errors++;
+    }
+
+    /* Roaring images built by the host, decompressed by the DPUs and queried. */
+    generate(d, inputs[3]);
+    compressed = 0;
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      size_t size;
+      DPU_ASSERT(dpu_bitmap_roaring_encode(
+          &inputs[3][(size_t)each_dpu * PART_WORDS], part_bits(each_dpu), &images[compressed], &size));
+      sizes[each_dpu] = size;
+      compressed += size;
+    }
+    DPU_ASSERT(dpu_push_varlen_xfer(set, DPU_XFER_TO_DPU, "image", 0, images, offsets,
+        dpu_varlen_offsets(sizes, NR_DPUS, offsets), DPU_SG_XFER_DEFAULT));
+    run(set, DECODE, results);
+    DPU_ASSERT(dpu_bitmap_pull_parts(set, "output", 0, check, NR_BITS, BITS_PER_DPU));
+    if (memcmp(check, inputs[3], NR_WORDS * 8) != 0) {
+      printf("%s: wrong bitmap decompressed by the DPUs\n", d->name);
+      errors++;
+    }
+    for (uint32_t i = 0; i < NR_QUERIES; i++)
+      queries[i] = random32() % BITS_PER_DPU;
+    DPU_ASSERT(dpu_broadcast_to(set, "queries", 0, queries, NR_QUERIES * sizeof(uint32_t), DPU_XFER_DEFAULT));
+    run(set, CONTAINS, results);
+    errors += check_answers(set, CONTAINS, inputs[3], queries, answers, prefix);
+
+    printf("%-8s %8.3f%% %9.3f %9.3f %9.3f %9.3f %9.2f %9.2f %9.2f\n", d->name,
+        100.0 * dpu_bitmap_popcount(inputs[0], NR_BITS) / NR_BITS, 3.0 * BITS_PER_DPU / 8 / combine_cycles,
+        (double)BITS_PER_DPU / 8 / popcount_cycles, (double)BITS_PER_DPU / 8 / ranks_cycles,
+        (double)BITS_PER_DPU / 8 / encode_cycles, (double)NR_WORDS * 8 / transferred, NR_WORDS * 8 / raw_time / 1e9,
+        NR_WORDS * 8 / roaring_time / 1e9);
+  }
+
+  /* OR of a bitmap of all the bits from each DPU, as the parts of the DPUs. */
+  {
+    double start;
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+      memcpy(&parts[(size_t)each_dpu * PART_WORDS], inputs[0], PART_WORDS * 8);
+    memset(expected, 0, PART_WORDS * 8);
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      parts[(size_t)each_dpu * PART_WORDS + each_dpu] = ~(uint64_t)0;
+      for (uint32_t w = 0; w < PART_WORDS; w++)
+        expected[w] |= parts[(size_t)each_dpu * PART_WORDS + w];
+    }
+    start = now();
+    dpu_bitmap_or_reduce(parts, NR_DPUS, PART_WORDS, check);
+    printf("OR of %u bitmaps of %u bits: %.2f GB/s\n", NR_DPUS, BITS_PER_DPU,
+        (double)NR_DPUS * PART_WORDS * 8 / (now() - start) / 1e9);
+    if (memcmp(check, expected, PART_WORDS * 8) != 0) {
+      printf("wrong OR of the bitmaps\n");
+      errors++;
+    }
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &parts[(size_t)each_dpu * PART_WORDS]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "inputs", 0, BITS_PER_DPU / 8, DPU_XFER_DEFAULT));
+    DPU_ASSERT(dpu_bitmap_pull_or(set, "inputs", 0, BITS_PER_DPU, check));
+    if (memcmp(check, expected, PART_WORDS * 8) != 0) {
+      printf("wrong OR of the bitmaps of the DPUs\n");
+      errors++;
+    }
+  }
+
+  for (uint32_t i = 0; i < MAX_INPUTS; i++)
+    free(inputs[i]);
+  free(expected);
+  free(check);
+  free(parts);
+  free(images);
+  free(image);
+  free(queries);
+  free(answers);
+  free(prefix);
+  free(positions);
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
@@ -0,0 +1,61 @@
+/* Builds a blocked Bloom filter in MRAM from the keys routed to the DPU by */
+/* the host, or probes it for a batch of keys and writes one bit per key. */
+
+#define MRAM_STRING_BUFFER_SIZE 256
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_bloom.h>
+#include <mram_string.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_FILTER_SIZE (16 << 20)
+#define MAX_KEYS (2 << 20)
+
+#define MODE_BUILD 0
+#define MODE_PROBE 1
+
+__mram_noinit uint8_t filter[MAX_FILTER_SIZE];
+__mram_noinit uint64_t keys[MAX_KEYS];
+__mram_noinit uint64_t results[MAX_KEYS / 64];
+__host uint32_t mode;
+__host uint32_t nr_blocks;
+__host uint32_t nr_hashes;
+__host uint32_t nr_keys;
+__host uint32_t nr_found;
+__host uint64_t cycles;
+
+uint32_t found_per_tasklet[NR_TASKLETS];
+__dma_aligned uint8_t buffers[NR_TASKLETS][MRAM_STRING_BUFFER_SIZE];
+
+MRAM_BLOOM_INIT(bloom, 64);
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+int main() {
+  uint32_t found = 0;
+
+  mram_bloom_attach(&bloom, filter, nr_blocks, nr_hashes);
+  if (mode == MODE_BUILD)
+    mram_memset_parallel(filter, 0, nr_blocks * MRAM_BLOOM_BLOCK_SIZE, buffers[me()]);
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  if (mode == MODE_BUILD)
+    mram_bloom_insert_keys(&bloom, keys, nr_keys);
+  else
+    found = mram_bloom_probe_keys(&bloom, keys, nr_keys, results);
+  found_per_tasklet[me()] = found;
+  barrier_wait(&done);
+
+  if (me() == 0) {
+    cycles = perfcounter_get();
+    nr_found = 0;
+    for (int t = 0; t < NR_TASKLETS; t++)
+      nr_found += found_per_tasklet[t];
+  }
+  return 0;
+}
@@ -0,0 +1,190 @@
+/* Shards a blocked Bloom filter between the DPUs: routes the keys to their */
+/* DPUs, builds the filters on the DPUs and checks them against filters built */
+/* by the host, then probes them with a batch of keys, half of them inserted. */
+/* Reports the false positive rate and the probes per second of the DPUs, */
+/* with and without the transfers, and of a single filter on the host. */
+
+#include <dpu.h>
+#include <dpu_bloom.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./bloom"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+/* MRAM_BLOOM_BLOCK_SIZE of the DPU program. */
+#ifndef BLOCK_SIZE
+#define BLOCK_SIZE 64
+#endif
+
+#define MAX_FILTER_SIZE (16 << 20)
+#define MAX_KEYS (2 << 20)
+#define KEYS_PER_DPU 400000
+#define BITS_PER_KEY 10
+
+#define MODE_BUILD 0
+#define MODE_PROBE 1
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t launch(struct dpu_set_t set, uint32_t mode, uint64_t *nr_found) {
+  struct dpu_set_t dpu;
+  uint32_t found[NR_DPUS], each_dpu;
+  uint64_t cycles[NR_DPUS], max_cycles = 0;
+
+  DPU_ASSERT(dpu_broadcast_to(set, "mode", 0, &mode, sizeof(mode), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &found[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "nr_found", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  *nr_found = 0;
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    *nr_found += found[each_dpu];
+    max_cycles = cycles[each_dpu] > max_cycles ? cycles[each_dpu] : max_cycles;
+  }
+  return max_cycles;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t nr_keys = NR_DPUS * KEYS_PER_DPU, nr_probes = NR_DPUS * KEYS_PER_DPU, each_dpu;
+  uint64_t *keys = malloc((size_t)nr_keys * sizeof(uint64_t)), *probes = malloc((size_t)nr_probes * sizeof(uint64_t));
+  uint64_t *results = malloc(((size_t)nr_probes + 63) / 64 * sizeof(uint64_t));
+  uint64_t build_cycles, probe_cycles, nr_found, host_found = 0, false_positives = 0, host_false_positives = 0;
+  struct dpu_bloom_batch inserted, probed;
+  uint32_t nr_blocks, nr_hashes, host_blocks, host_hashes;
+  uint8_t *filters, *pulled, *host_filter;
+  size_t filter_size;
+  double start, build_time, route_time, push_time, probe_time, pull_time, host_time;
+  int errors = 0;
+
+  /* Distinct keys: the odd multiples of an odd constant are inserted, the even ones are not. */
+  srand(1);
+  for (uint32_t i = 0; i < nr_keys; i++)
+    keys[i] = (2 * (uint64_t)i + 1) * 0x9e3779b97f4a7c15ull;
+  for (uint32_t i = 0; i < nr_probes; i++) {
+    uint32_t r = (uint32_t)rand() << 8 ^ (uint32_t)rand();
+    probes[i] = i % 2 ? keys[r % nr_keys] : (2 * (uint64_t)i + 2) * 0x9e3779b97f4a7c15ull;
+  }
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  /* Sizes the filters for the DPU receiving the most keys. */
+  DPU_ASSERT(dpu_bloom_route(set, keys, nr_keys, &inserted));
+  nr_blocks = dpu_bloom_nr_blocks(inserted.max_keys, BITS_PER_KEY, BLOCK_SIZE);
+  nr_hashes = dpu_bloom_nr_hashes(inserted.max_keys, nr_blocks, BLOCK_SIZE);
+  filter_size = (size_t)nr_blocks * BLOCK_SIZE;
+  if (inserted.max_keys > MAX_KEYS || filter_size > MAX_FILTER_SIZE) {
+    printf("%u keys on a DPU, filters of %zu bytes: too large\n", inserted.max_keys, filter_size);
+    return 1;
+  }
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_blocks", 0, &nr_blocks, sizeof(nr_blocks), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_hashes", 0, &nr_hashes, sizeof(nr_hashes), DPU_XFER_DEFAULT));
+
+  start = now();
+  DPU_ASSERT(dpu_bloom_push_keys(&inserted, "keys", 0, "nr_keys"));
+  build_cycles = launch(set, MODE_BUILD, &nr_found);
+  build_time = now() - start;
+
+  /* The same filters built by the host must be identical. */
+  filters = calloc(NR_DPUS, filter_size);
+  pulled = malloc(NR_DPUS * filter_size);
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    for (uint32_t i = inserted.first_keys[each_dpu]; i < inserted.first_keys[each_dpu + 1]; i++)
+      dpu_bloom_insert(&filters[each_dpu * filter_size], nr_blocks, BLOCK_SIZE, nr_hashes, inserted.keys[i]);
+  }
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &pulled[each_dpu * filter_size]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "filter", 0, filter_size, DPU_XFER_DEFAULT));
+  if (memcmp(filters, pulled, NR_DPUS * filter_size) != 0) {
+    printf("filters built by the DPUs differ from the filters of the host\n");
+    errors++;
+  }
+
+  start = now();
+  DPU_ASSERT(dpu_bloom_route(set, probes, nr_probes, &probed));
+  route_time = now() - start;
+  if (probed.max_keys > MAX_KEYS) {
+    printf("%u probes on a DPU: too many\n", probed.max_keys);
+    return 1;
+  }
+  start = now();
+  DPU_ASSERT(dpu_bloom_push_keys(&probed, "keys", 0, "nr_keys"));
+  push_time = now() - start;
+  start = now();
+  probe_cycles = launch(set, MODE_PROBE, &nr_found);
+  probe_time = now() - start;
+  start = now();
+  DPU_ASSERT(dpu_bloom_pull_results(&probed, "results", 0, results, &host_found));
+  pull_time = now() - start;
+
+  /* No false negative, and the answers of the filters of the host. */
+  if (host_found != nr_found) {
+    printf("%lu keys found, %lu gathered\n", (unsigned long)nr_found, (unsigned long)host_found);
+    errors++;
+  }
+  for (uint32_t i = 0; i < nr_probes; i++) {
+    bool found = (results[i / 64] >> (i % 64)) & 1;
+    uint32_t owner = dpu_bloom_dpu_of(probes[i], NR_DPUS);
+    if (found != dpu_bloom_contains(&filters[owner * filter_size], nr_blocks, BLOCK_SIZE, nr_hashes, probes[i])
+        || (i % 2 && !found)) {
+      if (errors < 10)
+        printf("probe %u: wrong result %d\n", i, found);
+      errors++;
+    }
+    false_positives += i % 2 == 0 && found;
+  }
+
+  /* A single filter of all the keys on the host. */
+  host_blocks = dpu_bloom_nr_blocks(nr_keys, BITS_PER_KEY, BLOCK_SIZE);
+  host_hashes = dpu_bloom_nr_hashes(nr_keys, host_blocks, BLOCK_SIZE);
+  host_filter = calloc(host_blocks, BLOCK_SIZE);
+  for (uint32_t i = 0; i < nr_keys; i++)
+    dpu_bloom_insert(host_filter, host_blocks, BLOCK_SIZE, host_hashes, keys[i]);
+  start = now();
+  for (uint32_t i = 0; i < nr_probes; i++)
+    host_false_positives
+        += i % 2 == 0 && dpu_bloom_contains(host_filter, host_blocks, BLOCK_SIZE, host_hashes, probes[i]);
+  host_time = now() - start;
+
+  printf("%u keys, %u probes, %u-byte blocks, %.1f bits per key, %u hashes\n", nr_keys, nr_probes, BLOCK_SIZE,
+      (double)NR_DPUS * filter_size * 8 / nr_keys, nr_hashes);
+  printf("build: %.1f Mkeys/s, %.1f cycles per key on a DPU\n", nr_keys / build_time / 1e6,
+      (double)build_cycles / inserted.max_keys);
+  printf("%-12s %12s %12s\n", "", "Mprobes/s", "false pos.");
+  printf("%-12s %12.1f %11.3f%%  (%.1f bits per key)\n", "host", nr_probes / host_time / 1e6,
+      200.0 * host_false_positives / nr_probes, (double)host_blocks * BLOCK_SIZE * 8 / nr_keys);
+  printf("%-12s %12.1f %11.3f%%\n", "DPU probe", nr_probes / probe_time / 1e6, 200.0 * false_positives / nr_probes);
+  printf("%-12s %12.1f\n", "DPU total", nr_probes / (route_time + push_time + probe_time + pull_time) / 1e6);
+  printf("%.1f cycles per probe on a DPU\n", (double)probe_cycles / probed.max_keys);
+
+  dpu_bloom_batch_free(&inserted);
+  dpu_bloom_batch_free(&probed);
+  free(filters);
+  free(pulled);
+  free(host_filter);
+  free(keys);
+  free(probes);
+  free(results);
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
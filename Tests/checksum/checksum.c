@@ -0,0 +1,56 @@
+/* Computes a checksum of the data held by the DPU: the CRC32C or the chunked */
+/* xxHash64 with all the tasklets, or the xxHash32 with tasklet 0. Or */
+/* combines two CRC32C sent by the host with tasklet 0. */
+
+#include <checksum.h>
+#include <defs.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_LENGTH (32 << 20)
+#define CHUNK_SIZE (64 << 10)
+
+enum { CRC32C = 0, XXH64 = 1, XXH32 = 2, COMBINE = 3 };
+
+__mram_noinit uint8_t data[MAX_LENGTH];
+__mram_noinit uint64_t digests[MAX_LENGTH / CHUNK_SIZE];
+__host uint32_t length;
+__host uint32_t algorithm;
+__host uint32_t combined_crcs[2];
+__host uint32_t combined_length;
+__host uint64_t result;
+__host uint64_t cycles;
+
+CHECKSUM_INIT(state);
+__dma_aligned uint8_t block[CHECKSUM_BLOCK_SIZE];
+
+int main() {
+  uint64_t checksum = 0;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+
+  if (algorithm == CRC32C) {
+    checksum = checksum_mram_crc32c(&state, data, length);
+  } else if (algorithm == XXH64) {
+    checksum = checksum_mram_xxh64(&state, data, length, CHUNK_SIZE, 0, digests);
+  } else if (algorithm == COMBINE && me() == 0) {
+    checksum = checksum_crc32c_combine(combined_crcs[0], combined_crcs[1], combined_length);
+  } else if (me() == 0) {
+    struct checksum_xxh32 xxh32;
+    checksum_xxh32_reset(&xxh32, 0);
+    for (uint32_t i = 0; i < length; i += CHECKSUM_BLOCK_SIZE) {
+      uint32_t n = length - i < CHECKSUM_BLOCK_SIZE ? length - i : CHECKSUM_BLOCK_SIZE;
+      mram_read(&data[i], block, (n + 7) & ~7);
+      checksum_xxh32_update(&xxh32, block, n);
+    }
+    checksum = checksum_xxh32_digest(&xxh32);
+  }
+
+  if (me() == 0) {
+    result = checksum;
+    cycles = perfcounter_get();
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+/* Computes the CRC32C, the chunked xxHash64 and the xxHash32 of the data held */
+/* by each DPU, checks them against the host, and combines the CRC32C of the */
+/* DPUs into the CRC32C of the whole data. Reports the bytes per cycle of a */
+/* DPU, and the throughput of all the DPUs and of the host. Then checks the */
+/* CRC32C combined by the DPUs for second sequences of 2^29 bytes and more. */
+
+#include <dpu.h>
+#include <dpu_checksum.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./checksum"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define BYTES_PER_DPU (8 << 20)
+#define CHUNK_SIZE (64 << 10)
+#define COMBINE 3
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  const char *names[3] = { "CRC32C", "xxHash64", "xxHash32" };
+  uint64_t total = (uint64_t)NR_DPUS * BYTES_PER_DPU;
+  uint8_t *data = malloc(total);
+  uint64_t results[NR_DPUS], cycles[NR_DPUS], expected[NR_DPUS];
+  uint32_t length = BYTES_PER_DPU, each_dpu, crc = 0;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  srand(1);
+  for (uint64_t i = 0; i < total; i++)
+    data[i] = rand();
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &data[(uint64_t)each_dpu * BYTES_PER_DPU]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "data", 0, BYTES_PER_DPU, DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "length", 0, &length, sizeof(length), DPU_XFER_DEFAULT));
+
+  printf("%10s %12s %12s %12s\n", "checksum", "bytes/cycle", "DPU GB/s", "host GB/s");
+  for (uint32_t algorithm = 0; algorithm < 3; algorithm++) {
+    uint64_t max_cycles = 0;
+    double start, dpu_time, host_time;
+
+    DPU_ASSERT(dpu_broadcast_to(set, "algorithm", 0, &algorithm, sizeof(algorithm), DPU_XFER_DEFAULT));
+    start = now();
+    DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+    dpu_time = now() - start;
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &results[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "result", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+
+    start = now();
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      const uint8_t *part = &data[(uint64_t)each_dpu * BYTES_PER_DPU];
+      if (algorithm == 0)
+        expected[each_dpu] = dpu_checksum_crc32c(0, part, BYTES_PER_DPU);
+      else if (algorithm == 1)
+        expected[each_dpu] = dpu_checksum_xxh64_chunked(part, BYTES_PER_DPU, CHUNK_SIZE, 0);
+      else
+        expected[each_dpu] = dpu_checksum_xxh32(part, BYTES_PER_DPU, 0);
+    }
+    host_time = now() - start;
+
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      if (results[each_dpu] != expected[each_dpu]) {
+        printf("%s: wrong checksum on DPU %u: 0x%016lx instead of 0x%016lx\n", names[algorithm], each_dpu,
+            (unsigned long)results[each_dpu], (unsigned long)expected[each_dpu]);
+        errors++;
+      }
+      max_cycles = cycles[each_dpu] > max_cycles ? cycles[each_dpu] : max_cycles;
+    }
+    if (algorithm == 0) {
+      for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+        crc = dpu_checksum_crc32c_combine(crc, (uint32_t)results[each_dpu], BYTES_PER_DPU);
+    }
+    printf("%10s %12.3f %12.2f %12.2f\n", names[algorithm], (double)BYTES_PER_DPU / max_cycles, total / dpu_time / 1e9,
+        total / host_time / 1e9);
+  }
+
+  if (crc != dpu_checksum_crc32c(0, data, total)) {
+    printf("wrong combined CRC32C: 0x%08x instead of 0x%08x\n", crc, dpu_checksum_crc32c(0, data, total));
+    errors++;
+  }
+
+  /* The data twice, whose CRC32C is computed on the host, then lengths with the upper bits set. */
+  uint32_t combined_lengths[] = { (uint32_t)total, 1u << 30, (3u << 29) + 12345, UINT32_MAX };
+  uint32_t combined_crcs[2] = { crc, crc }, algorithm = COMBINE;
+  DPU_ASSERT(dpu_broadcast_to(set, "algorithm", 0, &algorithm, sizeof(algorithm), DPU_XFER_DEFAULT));
+  for (uint32_t i = 0; i < sizeof(combined_lengths) / sizeof(combined_lengths[0]); i++) {
+    uint32_t expected_crc = i == 0 ? dpu_checksum_crc32c(crc, data, total)
+                                   : dpu_checksum_crc32c_combine(crc, crc, combined_lengths[i]);
+
+    DPU_ASSERT(dpu_broadcast_to(set, "combined_crcs", 0, combined_crcs, sizeof(combined_crcs), DPU_XFER_DEFAULT));
+    DPU_ASSERT(dpu_broadcast_to(set, "combined_length", 0, &combined_lengths[i], sizeof(uint32_t), DPU_XFER_DEFAULT));
+    DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &results[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "result", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      if (results[each_dpu] != expected_crc) {
+        printf("wrong CRC32C combined on DPU %u for %u bytes: 0x%08x instead of 0x%08x\n", each_dpu,
+            combined_lengths[i], (uint32_t)results[each_dpu], expected_crc);
+        errors++;
+        break;
+      }
+    }
+  }
+
+  free(data);
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
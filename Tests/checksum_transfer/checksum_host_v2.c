@@ -1,6 +1,7 @@
 #include <assert.h>
 #include <dpu.h>
 #include <dpu_log.h>
+#include <dpu_checksum.h>
 #include <stdio.h>
 #include <stdint.h>
 #ifndef DPU_BINARY
@@ -19,6 +20,7 @@ int main(void) {
   struct dpu_set_t set, dpu;
   uint32_t* buffer  = (uint32_t*)malloc(NB_ELEMENTS * sizeof(int));
   uint32_t* output = (uint32_t*)malloc(sizeof(int));
+  int errors = 0;
   DPU_ASSERT(dpu_alloc(NB_DPUS, NULL, &set));
   uint32_t num_ranks,num_dpus;
   dpu_get_nr_ranks(set,&num_ranks);
@@ -36,10 +38,14 @@ int main(void) {
   }
   DPU_FOREACH(set,dpu){ 
   DPU_ASSERT(dpu_copy_from(dpu,"checksum",0,output,sizeof(uint32_t)));
-  printf("\nReturned value from the set is %u",*output);
+  printf("\nReturned CRC32C from the set is 0x%08x",*output);
+  if (*output != dpu_checksum_crc32c(0, buffer, sizeof(uint32_t) * NB_ELEMENTS_PER_DPU)) {
+    printf("\nExpected 0x%08x", dpu_checksum_crc32c(0, buffer, sizeof(uint32_t) * NB_ELEMENTS_PER_DPU));
+    errors++;
+  }
   }
   
   DPU_ASSERT(dpu_free(set));
 
-  return 0;
+  return errors != 0;
 }
\ No newline at end of file
@@ -2,20 +2,26 @@
 #include <mram.h>
 #include <stdint.h>
 #include <defs.h>
+#include <barrier.h>
+#include <checksum.h>
 #define BUFFER_SIZE 1024
 #define NR_ELEMENTS_PER_TASKLET (BUFFER_SIZE / NR_TASKLETS)
 __mram uint32_t buffer[BUFFER_SIZE];
 uint32_t checksums[NR_TASKLETS] = {0};
+__host uint32_t checksum;
+BARRIER_INIT(done, NR_TASKLETS);
 int main(){
 
     for(int i = me()*NR_ELEMENTS_PER_TASKLET ;i < (me()+1)*NR_ELEMENTS_PER_TASKLET;i++){
-        checksums[me()] += buffer[i];
+        uint32_t element = buffer[i];
+        checksums[me()] = checksum_crc32c(checksums[me()], &element, sizeof(element));
     }
+    barrier_wait(&done);
     if(!me()){
-        uint32_t checksum =0;
+        checksum = 0;
         for(int i = 0;i<NR_TASKLETS;i++){
-            checksum += checksums[i];
+            checksum = checksum_crc32c_combine(checksum, checksums[i], NR_ELEMENTS_PER_TASKLET * sizeof(uint32_t));
         }
-        printf("\nThe checksum is %u",checksum);
+        printf("\nThe CRC32C is 0x%08x",checksum);
     }
-}
\ No newline at end of file
+}
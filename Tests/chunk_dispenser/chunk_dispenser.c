@@ -0,0 +1,79 @@
+/* Skewed workload balanced with a chunk dispenser. */
+/* Each element costs a data-dependent number of iterations (Collatz steps), */
+/* so a static split of the buffer between tasklets finishes unevenly. The */
+/* bounds of the chunks taken by each tasklet are recorded for the host. */
+
+#define CHUNK_DISPENSER_ACCOUNTING
+
+#include <barrier.h>
+#include <chunk_dispenser.h>
+#include <defs.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define BUFFER_SIZE (1 << 16)
+#define CACHE_SIZE 256
+#define MIN_CHUNK 16
+#define MAX_CHUNKS (BUFFER_SIZE / MIN_CHUNK)
+
+__mram_noinit uint32_t buffer[BUFFER_SIZE];
+__host uint32_t policy;
+__host uint32_t total_steps;
+__host uint64_t busy_cycles[NR_TASKLETS];
+__host uint64_t idle_cycles[NR_TASKLETS];
+__host uint32_t nr_chunks[NR_TASKLETS];
+__mram_noinit uint32_t chunk_bounds[NR_TASKLETS][MAX_CHUNKS][2];
+
+uint32_t steps[NR_TASKLETS];
+__dma_aligned uint32_t cache[NR_TASKLETS][CACHE_SIZE];
+__dma_aligned uint32_t bounds[NR_TASKLETS][2];
+
+CHUNK_DISPENSER_INIT(dispenser);
+BARRIER_INIT(ready, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+static uint32_t collatz_steps(uint32_t value) {
+  uint32_t nr_steps = 0;
+  while (value > 1) {
+    value = (value & 1) ? (3 * value + 1) : (value >> 1);
+    nr_steps++;
+  }
+  return nr_steps;
+}
+
+int main() {
+  uint32_t begin, end, nr_recorded = 0;
+
+  if (me() == 0) {
+    perfcounter_config(COUNT_CYCLES, true);
+    chunk_dispenser_reset(&dispenser, BUFFER_SIZE, (chunk_dispenser_policy_t)policy, MIN_CHUNK, CACHE_SIZE, 2);
+  }
+  steps[me()] = 0;
+  barrier_wait(&ready);
+
+  while (chunk_dispenser_next(&dispenser, &begin, &end)) {
+    if (nr_recorded < MAX_CHUNKS) {
+      bounds[me()][0] = begin;
+      bounds[me()][1] = end;
+      mram_write(bounds[me()], chunk_bounds[me()][nr_recorded++], sizeof(bounds[0]));
+    }
+    mram_read(&buffer[begin], cache[me()], (end - begin) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < end - begin; i++)
+      steps[me()] += collatz_steps(cache[me()][i]);
+  }
+  barrier_wait(&done);
+
+  chunk_dispenser_stats_t stats;
+  chunk_dispenser_get_stats(&dispenser, me(), &stats);
+  busy_cycles[me()] = stats.busy;
+  idle_cycles[me()] = stats.idle;
+  nr_chunks[me()] = stats.nr_chunks;
+
+  if (me() == 0) {
+    total_steps = 0;
+    for (int i = 0; i < NR_TASKLETS; i++)
+      total_steps += steps[i];
+  }
+  return 0;
+}
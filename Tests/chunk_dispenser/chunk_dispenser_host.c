@@ -0,0 +1,97 @@
+/* Runs the skewed workload with each chunk dispenser policy and */
+/* reports the busy/idle cycles of every tasklet. Checks that every element */
+/* was handed out in exactly one chunk, and the number of Collatz steps. */
+
+#include <dpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./chunk_dispenser"
+#endif
+
+#ifndef NR_TASKLETS
+#define NR_TASKLETS 16
+#endif
+
+#define BUFFER_SIZE (1 << 16)
+#define MAX_CHUNKS (BUFFER_SIZE / 16)
+
+static const char *policy_names[] = { "fixed", "guided", "adaptive" };
+
+static uint32_t chunk_bounds[NR_TASKLETS][MAX_CHUNKS][2];
+static uint8_t handed_out[BUFFER_SIZE];
+
+static uint32_t collatz_steps(uint32_t value) {
+  uint32_t nr_steps = 0;
+  while (value > 1) {
+    value = (value & 1) ? (3 * value + 1) : (value >> 1);
+    nr_steps++;
+  }
+  return nr_steps;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t *buffer = malloc(BUFFER_SIZE * sizeof(uint32_t));
+  uint64_t busy[NR_TASKLETS], idle[NR_TASKLETS];
+  uint32_t chunks[NR_TASKLETS], total_steps, expected_steps = 0;
+  int errors = 0;
+
+  /* Large values in the first half of the buffer: a static split overloads the first tasklets. */
+  srand(0);
+  for (int i = 0; i < BUFFER_SIZE; i++)
+    buffer[i] = (i < BUFFER_SIZE / 2) ? (uint32_t)rand() : (uint32_t)(rand() & 0xff);
+  for (int i = 0; i < BUFFER_SIZE; i++)
+    expected_steps += collatz_steps(buffer[i]);
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_copy_to(set, "buffer", 0, buffer, BUFFER_SIZE * sizeof(uint32_t)));
+
+  for (uint32_t policy = 0; policy < 3; policy++) {
+    DPU_ASSERT(dpu_copy_to(set, "policy", 0, &policy, sizeof(policy)));
+    DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+    DPU_FOREACH(set, dpu) {
+      DPU_ASSERT(dpu_copy_from(dpu, "total_steps", 0, &total_steps, sizeof(total_steps)));
+      DPU_ASSERT(dpu_copy_from(dpu, "busy_cycles", 0, busy, sizeof(busy)));
+      DPU_ASSERT(dpu_copy_from(dpu, "idle_cycles", 0, idle, sizeof(idle)));
+      DPU_ASSERT(dpu_copy_from(dpu, "nr_chunks", 0, chunks, sizeof(chunks)));
+      DPU_ASSERT(dpu_copy_from(dpu, "chunk_bounds", 0, chunk_bounds, sizeof(chunk_bounds)));
+    }
+    printf("policy %s: %u steps\n", policy_names[policy], total_steps);
+    if (total_steps != expected_steps) {
+      printf("wrong number of steps: %u instead of %u\n", total_steps, expected_steps);
+      errors++;
+    }
+
+    memset(handed_out, 0, sizeof(handed_out));
+    for (int t = 0; t < NR_TASKLETS; t++) {
+      if (chunks[t] > MAX_CHUNKS) {
+        printf("too many chunks for tasklet %d: %u\n", t, chunks[t]);
+        errors++;
+        continue;
+      }
+      for (uint32_t c = 0; c < chunks[t]; c++) {
+        for (uint32_t i = chunk_bounds[t][c][0]; i < chunk_bounds[t][c][1] && i < BUFFER_SIZE; i++)
+          handed_out[i]++;
+      }
+    }
+    for (int i = 0; i < BUFFER_SIZE; i++) {
+      if (handed_out[i] != 1) {
+        printf("element %d handed out %u times\n", i, handed_out[i]);
+        errors++;
+        break;
+      }
+    }
+    for (int t = 0; t < NR_TASKLETS; t++)
+      printf("  tasklet %2d: %4u chunks, busy %10lu cycles, idle %10lu cycles\n", t, chunks[t], (unsigned long)busy[t],
+          (unsigned long)idle[t]);
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(buffer);
+  return errors != 0;
+}
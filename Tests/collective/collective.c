@@ -0,0 +1,55 @@
+/* One iteration of a training on each DPU: computes the gradient of the DPU */
+/* from the model, which the host sums with an allreduce into the model of */
+/* the next iteration, or with a reduce-scatter into a slice per DPU. The */
+/* values are int32, int64 or Q15.16, and the gradient depends on the index */
+/* of the DPU, for the host to check the sums. */
+
+#include <defs.h>
+#include <fixed_point.h>
+#include <mram.h>
+#include <stdint.h>
+
+#define MAX_VALUES (1 << 20)
+#define BLOCK 1024
+
+enum { INT32, INT64, FIXED_Q16 };
+
+__mram_noinit uint64_t model[MAX_VALUES];
+__mram_noinit uint64_t gradient[MAX_VALUES];
+__mram_noinit uint64_t slice[MAX_VALUES];
+__host uint32_t nr_values;
+__host uint32_t type;
+__host uint32_t dpu_index;
+
+__dma_aligned uint8_t blocks[NR_TASKLETS][BLOCK];
+
+/* The gradient of a block of values, i being the index of the first one. */
+static void compute(uint8_t *block, uint32_t size, uint32_t i) {
+  if (type == INT64) {
+    int64_t *values = (int64_t *)block;
+    for (uint32_t j = 0; j < size / sizeof(int64_t); j++)
+      values[j] = (int64_t)((uint64_t)(values[j] >> 3) + (uint64_t)(dpu_index + 1) * (i + j + 1));
+  } else if (type == INT32) {
+    int32_t *values = (int32_t *)block;
+    for (uint32_t j = 0; j < size / sizeof(int32_t); j++)
+      values[j] = (int32_t)((uint32_t)(values[j] >> 3) + (dpu_index + 1) * (i + j + 1));
+  } else {
+    fixed_q16_t *values = (fixed_q16_t *)block;
+    for (uint32_t j = 0; j < size / sizeof(fixed_q16_t); j++)
+      values[j] = fixed_q16_add(fixed_q16_mul(values[j], FIXED_Q16_ONE / 8), (dpu_index + 1) * ((i + j) & 1023));
+  }
+}
+
+int main() {
+  uint32_t value_size = type == INT64 ? sizeof(int64_t) : sizeof(int32_t);
+  uint32_t size = (nr_values * value_size + 7) & ~7;
+  uint8_t *block = blocks[me()];
+
+  for (uint32_t start = me() * BLOCK; start < size; start += NR_TASKLETS * BLOCK) {
+    uint32_t n = size - start < BLOCK ? size - start : BLOCK;
+    mram_read((__mram_ptr uint8_t *)model + start, block, n);
+    compute(block, n, start / value_size);
+    mram_write(block, (__mram_ptr uint8_t *)gradient + start, n);
+  }
+  return 0;
+}
@@ -0,0 +1,225 @@
+/* Iterations of a training on NR_DPUS DPUs: each iteration launches the */
+/* DPUs to compute their gradients, then sums them into the model of the */
+/* next iteration, with dpu_collective_allreduce, or naively with a */
+/* dpu_copy_from of each DPU, a scalar sum and a dpu_broadcast_to. Checks */
+/* the sums of the first iteration of both, and of a reduce-scatter, for */
+/* int32, int64 and Q15.16 values, and reports the time per iteration. The */
+/* odd number of values pads the int32 vectors, whose padding the DPUs */
+/* compute a gradient of but must receive as zeros. */
+
+#include <dpu.h>
+#include <dpu_collective.h>
+#include <dpu_fixed_point.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./collective"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#ifndef NR_VALUES
+#define NR_VALUES ((1 << 18) + 1)
+#endif
+
+#ifndef NR_ITERATIONS
+#define NR_ITERATIONS 10
+#endif
+
+#define SIZE ((NR_VALUES * sizeof(int64_t) + 7) & ~(size_t)7)
+
+static const char *const type_names[] = { "int32", "int64", "Q15.16" };
+
+static uint8_t initial_model[SIZE], expected[SIZE], received[SIZE];
+/* The sums of the values. */
+static int64_t sums[NR_VALUES];
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Adds the gradient of a DPU, computed from the model of nr values as by the DPU, to the exact sums. */
+static void add_gradient(dpu_collective_type_t type, const uint8_t *model, uint32_t nr, uint32_t dpu_index) {
+  for (uint32_t i = 0; i < nr; i++) {
+    if (type == DPU_COLLECTIVE_INT64) {
+      int64_t value = ((const int64_t *)model)[i];
+      sums[i] = (int64_t)((uint64_t)sums[i] + (uint64_t)(value >> 3) + (uint64_t)(dpu_index + 1) * (i + 1));
+    } else if (type == DPU_COLLECTIVE_INT32) {
+      int32_t value = ((const int32_t *)model)[i];
+      sums[i] = (int32_t)((uint32_t)sums[i] + (uint32_t)(value >> 3) + (dpu_index + 1) * (i + 1));
+    } else {
+      dpu_fixed_q16_t value = ((const dpu_fixed_q16_t *)model)[i];
+      sums[i] += dpu_fixed_q16_add(dpu_fixed_q16_mul(value, DPU_FIXED_Q16_ONE / 8), (dpu_index + 1) * (i & 1023));
+    }
+  }
+}
+
+/* Stores the sums as values of the type, the fixed-point sums being saturated. */
+static void store_sums(dpu_collective_type_t type, uint8_t *values, uint32_t nr) {
+  for (uint32_t i = 0; i < nr; i++) {
+    if (type == DPU_COLLECTIVE_INT64)
+      ((int64_t *)values)[i] = sums[i];
+    else
+      ((int32_t *)values)[i] = sums[i] > INT32_MAX ? INT32_MAX : sums[i] < INT32_MIN ? INT32_MIN : (int32_t)sums[i];
+  }
+}
+
+/* Sums the gradients of all the DPUs into the model of each DPU, one DPU and one value at a time. */
+static void naive_allreduce(struct dpu_set_t set, dpu_collective_type_t type, uint8_t *gathered, uint8_t *model) {
+  size_t size = (NR_VALUES * dpu_collective_type_size(type) + 7) & ~(size_t)7;
+  uint32_t each_dpu;
+  struct dpu_set_t dpu;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_copy_from(dpu, "gradient", 0, &gathered[each_dpu * size], size));
+  }
+  memset(sums, 0, sizeof(sums));
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    const uint8_t *gradient = &gathered[each_dpu * size];
+    for (uint32_t i = 0; i < NR_VALUES; i++) {
+      if (type == DPU_COLLECTIVE_INT64)
+        sums[i] = (int64_t)((uint64_t)sums[i] + (uint64_t)((const int64_t *)gradient)[i]);
+      else if (type == DPU_COLLECTIVE_INT32)
+        sums[i] = (int32_t)((uint32_t)sums[i] + (uint32_t)((const int32_t *)gradient)[i]);
+      else
+        sums[i] += ((const int32_t *)gradient)[i];
+    }
+  }
+  memset(model, 0, size);
+  store_sums(type, model, NR_VALUES);
+  DPU_ASSERT(dpu_broadcast_to(set, "model", 0, model, size, DPU_XFER_DEFAULT));
+}
+
+/* Starts an iteration from the initial model, and launches the DPUs to compute their gradients. */
+static void start_iteration(struct dpu_collective *collective, size_t size) {
+  DPU_ASSERT(dpu_collective_broadcast(collective, "model", 0, initial_model, size));
+  DPU_ASSERT(dpu_launch(collective->dpu_set, DPU_SYNCHRONOUS));
+}
+
+/* Checks the model of the first and last DPUs against the expected sums. */
+static int check_model(struct dpu_set_t set, const char *method, dpu_collective_type_t type, size_t size) {
+  struct dpu_set_t dpu;
+  uint32_t each_dpu;
+  int errors = 0;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    if (each_dpu != 0 && each_dpu != NR_DPUS - 1)
+      continue;
+    DPU_ASSERT(dpu_copy_from(dpu, "model", 0, received, size));
+    if (memcmp(received, expected, size) != 0) {
+      printf("%s %s: wrong model on DPU %u\n", method, type_names[type], each_dpu);
+      errors++;
+    }
+  }
+  return errors;
+}
+
+/* Checks the slice of the sums received by each DPU, padded with zeros. */
+static int check_slices(struct dpu_set_t set, dpu_collective_type_t type, size_t slice_size) {
+  struct dpu_set_t dpu;
+  uint32_t each_dpu;
+  int errors = 0;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    size_t start = each_dpu * slice_size, end = start + slice_size;
+    DPU_ASSERT(dpu_copy_from(dpu, "slice", 0, received, slice_size));
+    for (size_t i = start; i < end; i++) {
+      if (received[i - start] != (i < SIZE ? expected[i] : 0)) {
+        if (errors < 10)
+          printf("reduce-scatter %s: wrong byte %zu of the slice of DPU %u\n", type_names[type], i - start, each_dpu);
+        errors++;
+        break;
+      }
+    }
+  }
+  return errors;
+}
+
+int main() {
+  uint8_t *gathered = malloc((size_t)NR_DPUS * SIZE), *model = malloc(SIZE);
+  uint32_t nr_values = NR_VALUES;
+  struct dpu_collective collective;
+  struct dpu_set_t set, dpu;
+  uint32_t each_dpu;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_collective_init(&collective, set));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_values", 0, &nr_values, sizeof(nr_values), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_copy_to(dpu, "dpu_index", 0, &each_dpu, sizeof(each_dpu)));
+  }
+
+  printf("%d DPUs in %u ranks, %d values\n", NR_DPUS, collective.nr_ranks, NR_VALUES);
+  printf("%8s %16s %16s %16s %10s\n", "type", "allreduce ms", "naive ms", "scatter ms", "speedup");
+  for (dpu_collective_type_t type = DPU_COLLECTIVE_INT32; type <= DPU_COLLECTIVE_FIXED_Q16; type++) {
+    size_t size = (NR_VALUES * dpu_collective_type_size(type) + 7) & ~(size_t)7;
+    double start, allreduce_time, naive_time, scatter_time;
+
+    /* Random models, whose sums saturate for many of the Q15.16 values. */
+    srand(type + 1);
+    memset(initial_model, 0, sizeof(initial_model));
+    for (size_t i = 0; i < size; i++)
+      initial_model[i] = (uint8_t)rand();
+    memset(sums, 0, sizeof(sums));
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+      add_gradient(type, initial_model, NR_VALUES, each_dpu);
+    memset(expected, 0, sizeof(expected));
+    store_sums(type, expected, NR_VALUES);
+    DPU_ASSERT(dpu_broadcast_to(set, "type", 0, &type, sizeof(uint32_t), DPU_XFER_DEFAULT));
+
+    start_iteration(&collective, size);
+    DPU_ASSERT(dpu_collective_allreduce(&collective, type, "gradient", 0, "model", 0, NR_VALUES));
+    if (memcmp(collective.result, expected, size) != 0) {
+      printf("allreduce %s: wrong sums on the host\n", type_names[type]);
+      errors++;
+    }
+    errors += check_model(set, "allreduce", type, size);
+
+    start_iteration(&collective, size);
+    naive_allreduce(set, type, gathered, model);
+    errors += check_model(set, "naive", type, size);
+
+    start_iteration(&collective, size);
+    DPU_ASSERT(dpu_collective_reduce_scatter(&collective, type, "gradient", 0, "slice", 0, NR_VALUES));
+    errors += check_slices(set, type, collective.slice_size);
+
+    /* The iterations go on from the model of the previous one. */
+    start = now();
+    for (uint32_t each_iteration = 0; each_iteration < NR_ITERATIONS; each_iteration++) {
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      DPU_ASSERT(dpu_collective_allreduce(&collective, type, "gradient", 0, "model", 0, NR_VALUES));
+    }
+    allreduce_time = (now() - start) / NR_ITERATIONS;
+    start = now();
+    for (uint32_t each_iteration = 0; each_iteration < NR_ITERATIONS; each_iteration++) {
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      naive_allreduce(set, type, gathered, model);
+    }
+    naive_time = (now() - start) / NR_ITERATIONS;
+    start = now();
+    for (uint32_t each_iteration = 0; each_iteration < NR_ITERATIONS; each_iteration++) {
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      DPU_ASSERT(dpu_collective_reduce_scatter(&collective, type, "gradient", 0, "slice", 0, NR_VALUES));
+    }
+    scatter_time = (now() - start) / NR_ITERATIONS;
+
+    printf("%8s %16.3f %16.3f %16.3f %10.2f\n", type_names[type], allreduce_time * 1e3, naive_time * 1e3,
+        scatter_time * 1e3, naive_time / allreduce_time);
+  }
+
+  dpu_collective_free(&collective);
+  DPU_ASSERT(dpu_free(set));
+  free(gathered);
+  free(model);
+  return errors != 0;
+}
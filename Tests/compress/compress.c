@@ -0,0 +1,97 @@
+/* Sums the values of an integer column or the bytes of a byte stream held by */
+/* the DPU, stored as they are or compressed: the compressed blocks are */
+/* decompressed into WRAM in front of the sum. Can also decompress a whole */
+/* image to MRAM, to be checked by the host. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_compress.h>
+#include <perfcounter.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_SIZE (24 << 20)
+#define RAW_BLOCK 1024
+
+enum { SCAN_INTEGERS = 0, SCAN_FOR = 1, DECOMPRESS_FOR = 2, SCAN_BYTES = 3, SCAN_LZ4 = 4, DECOMPRESS_LZ4 = 5 };
+
+__mram_noinit uint8_t input[MAX_SIZE];
+__mram_noinit uint8_t output[MAX_SIZE];
+/* The number of values or bytes of the data, for the scans of uncompressed data. */
+__host uint32_t length;
+__host uint32_t mode;
+__host uint64_t result;
+__host uint32_t status;
+__host uint64_t cycles;
+
+MRAM_COMPRESS_INIT(state);
+BARRIER_INIT(sum_barrier, NR_TASKLETS);
+uint64_t sums[NR_TASKLETS];
+bool failures[NR_TASKLETS];
+
+int main() {
+  /* The scans of uncompressed data read into the input buffer of the tasklet. */
+  uint8_t *raw = state.inputs[me()];
+  uint64_t sum = 0;
+  bool failed = false;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+
+  if (mode == SCAN_INTEGERS) {
+    for (uint32_t i = me() * (RAW_BLOCK / 4); i < length; i += NR_TASKLETS * (RAW_BLOCK / 4)) {
+      uint32_t n = length - i < RAW_BLOCK / 4 ? length - i : RAW_BLOCK / 4;
+      mram_read(&input[i * 4], raw, (n * 4 + 7) & ~7);
+      for (uint32_t j = 0; j < n; j++)
+        sum += ((int32_t *)raw)[j];
+    }
+  } else if (mode == SCAN_BYTES) {
+    for (uint32_t i = me() * RAW_BLOCK; i < length; i += NR_TASKLETS * RAW_BLOCK) {
+      uint32_t n = length - i < RAW_BLOCK ? length - i : RAW_BLOCK;
+      mram_read(&input[i], raw, (n + 7) & ~7);
+      for (uint32_t j = 0; j < n; j++)
+        sum += raw[j];
+    }
+  } else if (mode == SCAN_FOR) {
+    uint32_t nr_blocks;
+    mram_read(input, raw, sizeof(struct mram_compress_for_header));
+    nr_blocks = ((struct mram_compress_for_header *)raw)->nr_blocks;
+    for (uint32_t each_block = me(); each_block < nr_blocks && !failed; each_block += NR_TASKLETS) {
+      uint32_t n;
+      int32_t *values = mram_compress_for_get(&state, input, each_block, &n);
+      failed = values == NULL;
+      for (uint32_t j = 0; !failed && j < n; j++)
+        sum += values[j];
+    }
+  } else if (mode == SCAN_LZ4) {
+    uint32_t nr_blocks;
+    mram_read(input, raw, sizeof(struct mram_compress_lz4_header));
+    nr_blocks = ((struct mram_compress_lz4_header *)raw)->nr_blocks;
+    for (uint32_t each_block = me(); each_block < nr_blocks && !failed; each_block += NR_TASKLETS) {
+      uint32_t n;
+      uint8_t *bytes = mram_compress_lz4_get(&state, input, each_block, &n);
+      failed = bytes == NULL;
+      for (uint32_t j = 0; !failed && j < n; j++)
+        sum += bytes[j];
+    }
+  } else if (mode == DECOMPRESS_FOR) {
+    failed = !mram_compress_for_decompress(&state, input, (__mram_ptr int32_t *)output);
+  } else if (mode == DECOMPRESS_LZ4) {
+    failed = !mram_compress_lz4_decompress(&state, input, output);
+  }
+
+  sums[me()] = sum;
+  failures[me()] = failed;
+  barrier_wait(&sum_barrier);
+  if (me() == 0) {
+    result = 0;
+    status = 0;
+    for (uint32_t each_tasklet = 0; each_tasklet < NR_TASKLETS; each_tasklet++) {
+      result += sums[each_tasklet];
+      status |= failures[each_tasklet];
+    }
+    cycles = perfcounter_get();
+  }
+  return 0;
+}
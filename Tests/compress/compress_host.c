@@ -0,0 +1,204 @@
+/* Compares integer columns and byte streams transferred and scanned as they */
+/* are, and compressed: frame of reference for the columns and LZ4 for the */
+/* streams, at several compression ratios. Checks the sums of the scans and the */
+/* data decompressed by the DPUs, and reports the compression ratio, the */
+/* effective transfer throughput (uncompressed bytes per second) and the */
+/* uncompressed bytes scanned per cycle by a DPU. */
+
+#include <dpu.h>
+#include <dpu_compress.h>
+#include <dpu_varlen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./compress"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define BYTES_PER_DPU (2 << 20)
+#define VALUES_PER_DPU (BYTES_PER_DPU / 4)
+#define BLOCK_SIZE 1024
+
+enum { SCAN_INTEGERS = 0, SCAN_FOR = 1, DECOMPRESS_FOR = 2, SCAN_BYTES = 3, SCAN_LZ4 = 4, DECOMPRESS_LZ4 = 5 };
+
+struct dataset {
+  const char *name;
+  int lz4;
+  int delta;
+  /* The number of random bits of the values, or the kind of bytes. */
+  int bits;
+};
+
+static const struct dataset datasets[] = {
+  { "int 4-bit", 0, 0, 4 },
+  { "int 12-bit", 0, 0, 12 },
+  { "int 20-bit", 0, 0, 20 },
+  { "int 32-bit", 0, 0, 32 },
+  { "int sorted", 0, 1, 6 },
+  { "bytes runs", 1, 0, 0 },
+  { "bytes text", 1, 0, 1 },
+  { "bytes random", 1, 0, 2 },
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random32(void) { return ((uint32_t)rand() << 16) ^ (uint32_t)rand() ^ ((uint32_t)rand() << 31); }
+
+static void generate(const struct dataset *d, uint8_t *data) {
+  static const char *words[] = { "the ", "DPU ", "reads ", "MRAM ", "and ", "writes ", "WRAM, ", "while ", "host ",
+    "transfers ", "compressed ", "blocks.\n" };
+
+  if (!d->lz4) {
+    int32_t *values = (int32_t *)data;
+    for (uint64_t i = 0; i < (uint64_t)NR_DPUS * VALUES_PER_DPU; i++) {
+      uint32_t r = random32() & (d->bits == 32 ? 0xffffffff : (1u << d->bits) - 1);
+      values[i] = d->delta ? (i % VALUES_PER_DPU == 0 ? (int32_t)random32() / 2 : values[i - 1] + (int32_t)r)
+                           : (int32_t)(r - (1u << 10));
+    }
+  } else if (d->bits == 0) {
+    for (uint64_t i = 0; i < (uint64_t)NR_DPUS * BYTES_PER_DPU; i++)
+      data[i] = (i / 64) % 7 == 0 ? (uint8_t)rand() : (uint8_t)(i / 256);
+  } else if (d->bits == 1) {
+    uint64_t i = 0;
+    while (i < (uint64_t)NR_DPUS * BYTES_PER_DPU) {
+      const char *word = words[rand() % (sizeof(words) / sizeof(words[0]))];
+      for (; *word != '\0' && i < (uint64_t)NR_DPUS * BYTES_PER_DPU; word++)
+        data[i++] = *word;
+    }
+  } else {
+    for (uint64_t i = 0; i < (uint64_t)NR_DPUS * BYTES_PER_DPU; i++)
+      data[i] = rand();
+  }
+}
+
+static uint32_t run(struct dpu_set_t set, uint32_t mode, uint64_t *results, uint64_t *max_cycles) {
+  struct dpu_set_t dpu;
+  uint64_t cycles[NR_DPUS];
+  uint32_t status[NR_DPUS], each_dpu, failed = 0;
+
+  DPU_ASSERT(dpu_broadcast_to(set, "mode", 0, &mode, sizeof(mode), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &results[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "result", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &status[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "status", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+
+  *max_cycles = 0;
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    *max_cycles = cycles[each_dpu] > *max_cycles ? cycles[each_dpu] : *max_cycles;
+    failed |= status[each_dpu];
+  }
+  return failed;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint64_t total = (uint64_t)NR_DPUS * BYTES_PER_DPU;
+  size_t bound = dpu_compress_lz4_bound(BYTES_PER_DPU, BLOCK_SIZE) > dpu_compress_for_bound(VALUES_PER_DPU)
+      ? dpu_compress_lz4_bound(BYTES_PER_DPU, BLOCK_SIZE)
+      : dpu_compress_for_bound(VALUES_PER_DPU);
+  uint8_t *data = malloc(total), *check = malloc(total), *images = malloc(bound * NR_DPUS);
+  uint64_t sizes[NR_DPUS], offsets[NR_DPUS + 1], expected[NR_DPUS], results[NR_DPUS];
+  uint32_t each_dpu;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  srand(1);
+  printf("%-14s %7s %12s %12s %12s %12s %12s\n", "data", "ratio", "raw xfer", "comp xfer", "raw scan", "comp scan",
+      "encode");
+  printf("%-14s %7s %12s %12s %12s %12s %12s\n", "", "", "GB/s", "GB/s", "bytes/cycle", "bytes/cycle", "GB/s");
+  for (uint32_t each_dataset = 0; each_dataset < sizeof(datasets) / sizeof(datasets[0]); each_dataset++) {
+    const struct dataset *d = &datasets[each_dataset];
+    uint32_t length = d->lz4 ? BYTES_PER_DPU : VALUES_PER_DPU;
+    uint64_t raw_cycles, compressed_cycles, decompress_cycles;
+    size_t max_length, compressed = 0;
+    double start, encode_time, raw_time, compressed_time;
+
+    generate(d, data);
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      const uint8_t *part = &data[(uint64_t)each_dpu * BYTES_PER_DPU];
+      expected[each_dpu] = 0;
+      for (uint32_t i = 0; i < length; i++)
+        expected[each_dpu] += d->lz4 ? part[i] : (uint64_t)(int64_t)((const int32_t *)part)[i];
+    }
+
+    /* Each image is a multiple of 8 bytes: they are packed as dpu_push_varlen_xfer expects them. */
+    start = now();
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      const uint8_t *part = &data[(uint64_t)each_dpu * BYTES_PER_DPU];
+      size_t size;
+      if (d->lz4)
+        DPU_ASSERT(dpu_compress_lz4_encode(part, BYTES_PER_DPU, BLOCK_SIZE, &images[compressed], &size));
+      else
+        DPU_ASSERT(dpu_compress_for_encode((const int32_t *)part, VALUES_PER_DPU, d->delta, &images[compressed], &size));
+      sizes[each_dpu] = size;
+      compressed += size;
+    }
+    encode_time = now() - start;
+    max_length = dpu_varlen_offsets(sizes, NR_DPUS, offsets);
+
+    /* Uncompressed. */
+    DPU_ASSERT(dpu_broadcast_to(set, "length", 0, &length, sizeof(length), DPU_XFER_DEFAULT));
+    start = now();
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &data[(uint64_t)each_dpu * BYTES_PER_DPU]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "input", 0, BYTES_PER_DPU, DPU_XFER_DEFAULT));
+    raw_time = now() - start;
+    errors += run(set, d->lz4 ? SCAN_BYTES : SCAN_INTEGERS, results, &raw_cycles);
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+      errors += results[each_dpu] != expected[each_dpu];
+
+    /* Compressed. */
+    start = now();
+    DPU_ASSERT(dpu_push_varlen_xfer(set, DPU_XFER_TO_DPU, "input", 0, images, offsets, max_length, DPU_SG_XFER_DEFAULT));
+    compressed_time = now() - start;
+    errors += run(set, d->lz4 ? SCAN_LZ4 : SCAN_FOR, results, &compressed_cycles);
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      if (results[each_dpu] != expected[each_dpu]) {
+        printf("%s: wrong sum on DPU %u\n", d->name, each_dpu);
+        errors++;
+      }
+    }
+    errors += run(set, d->lz4 ? DECOMPRESS_LZ4 : DECOMPRESS_FOR, results, &decompress_cycles);
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &check[(uint64_t)each_dpu * BYTES_PER_DPU]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "output", 0, BYTES_PER_DPU, DPU_XFER_DEFAULT));
+    if (memcmp(check, data, total) != 0) {
+      printf("%s: wrong decompressed data\n", d->name);
+      errors++;
+    }
+
+    printf("%-14s %7.2f %12.2f %12.2f %12.3f %12.3f %12.2f\n", d->name, (double)total / compressed,
+        total / raw_time / 1e9, total / compressed_time / 1e9, (double)BYTES_PER_DPU / raw_cycles,
+        (double)BYTES_PER_DPU / compressed_cycles, total / encode_time / 1e9);
+  }
+
+  free(data);
+  free(check);
+  free(images);
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
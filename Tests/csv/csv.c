@@ -0,0 +1,41 @@
+/* Parses the records of the part of a CSV text held by the DPU into MRAM */
+/* columns, one per field of the schema broadcast by the host. */
+
+#include <defs.h>
+#include <mram.h>
+#include <mram_csv.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_TEXT (16 << 20)
+#define MAX_RECORDS (256 << 10)
+
+__mram_noinit uint8_t text[MAX_TEXT + MRAM_CSV_WINDOW];
+__mram_noinit uint64_t columns[MRAM_CSV_MAX_FIELDS][MAX_RECORDS];
+__host struct mram_csv_schema schema;
+__host uint32_t text_length;
+__host uint32_t text_from;
+__host uint32_t nr_records;
+__host uint32_t nr_errors;
+__host uint64_t cycles;
+
+MRAM_CSV_INIT(parser);
+/* Set by the first tasklet, read by all of them after the barriers of mram_csv_parse. */
+__mram_ptr void *destinations[MRAM_CSV_MAX_FIELDS];
+
+int main() {
+  uint32_t count, errors;
+
+  if (me() == 0) {
+    perfcounter_config(COUNT_CYCLES, true);
+    for (uint32_t field = 0; field < MRAM_CSV_MAX_FIELDS; field++)
+      destinations[field] = columns[field];
+  }
+  count = mram_csv_parse(&parser, &schema, text, text_from, text_length, destinations, MAX_RECORDS, &errors);
+  if (me() == 0) {
+    nr_records = count;
+    nr_errors = errors;
+    cycles = perfcounter_get();
+  }
+  return 0;
+}
@@ -0,0 +1,147 @@
+/* Parses a generated CSV text, with quoted fields holding delimiters, newlines */
+/* and double quotes, on the DPUs and on the host. Checks that the columns are */
+/* identical, and reports the throughput of the parsing and of the whole load, */
+/* parse and gather of the columns. */
+
+#include <dpu.h>
+#include <dpu_csv.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./csv"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define MAX_RECORDS (256 << 10)
+#define RECORDS_PER_DPU (128 << 10)
+#define NR_FIELDS 5
+
+static const dpu_csv_type_t types[NR_FIELDS] = { DPU_CSV_INT64, DPU_CSV_FIXED32, DPU_CSV_STRING, DPU_CSV_SKIP, DPU_CSV_INT32 };
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* id,price,name,comment,quantity with CRLF line endings on some records, and a few invalid numbers. */
+static uint64_t generate(char *text, uint64_t nr_records) {
+  static const char *names[] = { "plain", "\"with, comma\"", "\"with \"\"quotes\"\"\"", "\"two\nlines\"", "" };
+  uint64_t length = 0;
+
+  for (uint64_t i = 0; i < nr_records; i++) {
+    int r = rand();
+    length += sprintf(&text[length], "%llu,%d.%02d,%s,%s,%s%d%s", (unsigned long long)i * 7919, r % 100000, r % 100,
+        names[r % 5], r % 3 == 0 ? "\"a\nb,c\"" : "note", r % 101 == 0 ? "x" : "", (r >> 8) % 2000 - 1000,
+        r % 7 == 0 ? "\r\n" : "\n");
+  }
+  return length;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  struct dpu_csv_schema schema = { .delimiter = ',', .nr_fields = NR_FIELDS };
+  uint64_t total_records = (uint64_t)NR_DPUS * RECORDS_PER_DPU, length, expected_records, expected_errors;
+  char *text = malloc(total_records * 96);
+  void *columns[NR_FIELDS] = { 0 }, *expected[NR_FIELDS] = { 0 };
+  uint32_t nr_records[NR_DPUS], nr_errors[NR_DPUS], each_dpu;
+  uint64_t cycles[NR_DPUS], max_cycles = 0, records = 0, errors_found = 0;
+  struct dpu_csv_text loaded;
+  double start, load_time, parse_time, pull_time, host_time;
+  int errors = 0;
+
+  for (uint32_t field = 0; field < NR_FIELDS; field++) {
+    schema.types[field] = types[field];
+    columns[field] = malloc(total_records * 8);
+    expected[field] = malloc(total_records * 8);
+  }
+  schema.scales[1] = 2;
+
+  srand(1);
+  length = generate(text, total_records);
+
+  start = now();
+  dpu_csv_parse(&schema, text, length, expected, total_records, &expected_records, &expected_errors);
+  host_time = now() - start;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "schema", 0, &schema, sizeof(schema), DPU_XFER_DEFAULT));
+
+  start = now();
+  DPU_ASSERT(dpu_csv_load(set, text, length, &loaded));
+  load_time = now() - start;
+
+  start = now();
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  parse_time = now() - start;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_records[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "nr_records", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_errors[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "nr_errors", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    if (nr_records[each_dpu] > MAX_RECORDS) {
+      printf("DPU %u: %u records, more than %u\n", each_dpu, nr_records[each_dpu], MAX_RECORDS);
+      errors++;
+      nr_records[each_dpu] = MAX_RECORDS;
+    }
+    records += nr_records[each_dpu];
+    errors_found += nr_errors[each_dpu];
+    max_cycles = cycles[each_dpu] > max_cycles ? cycles[each_dpu] : max_cycles;
+  }
+
+  start = now();
+  for (uint32_t field = 0; field < NR_FIELDS; field++) {
+    if (types[field] != DPU_CSV_SKIP)
+      DPU_ASSERT(dpu_csv_pull_column(
+          &loaded, "columns", field * MAX_RECORDS * sizeof(uint64_t), types[field], nr_records, columns[field]));
+  }
+  pull_time = now() - start;
+
+  if (records != expected_records || errors_found != expected_errors) {
+    printf("%llu records and %llu errors, expected %llu and %llu\n", (unsigned long long)records,
+        (unsigned long long)errors_found, (unsigned long long)expected_records, (unsigned long long)expected_errors);
+    errors++;
+  }
+  for (uint32_t field = 0; field < NR_FIELDS && errors == 0; field++) {
+    if (types[field] != DPU_CSV_SKIP
+        && memcmp(columns[field], expected[field], records * dpu_csv_element_size(types[field])) != 0) {
+      printf("field %u: wrong column\n", field);
+      errors++;
+    }
+  }
+
+  printf("%llu records, %.1f MB, %llu invalid numbers\n", (unsigned long long)records, length / 1e6,
+      (unsigned long long)errors_found);
+  printf("%-10s %12s %12s\n", "", "GB/s", "Mrecords/s");
+  printf("%-10s %12.2f %12.2f\n", "host", length / host_time / 1e9, records / host_time / 1e6);
+  printf("%-10s %12.2f %12.2f\n", "DPU parse", length / parse_time / 1e9, records / parse_time / 1e6);
+  printf("%-10s %12.2f %12.2f\n", "DPU total", length / (load_time + parse_time + pull_time) / 1e9,
+      records / (load_time + parse_time + pull_time) / 1e6);
+  printf("%.3f bytes/cycle per DPU\n", (double)length / NR_DPUS / max_cycles);
+
+  dpu_csv_free(&loaded);
+  for (uint32_t field = 0; field < NR_FIELDS; field++) {
+    free(columns[field]);
+    free(expected[field]);
+  }
+  free(text);
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
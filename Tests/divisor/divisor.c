@@ -0,0 +1,104 @@
+/* Divides the 64-bit numerators held by the DPU, or takes their remainder, */
+/* on 32 or 64 bits: with the / and % operators or with a divisor prepared */
+/* by the host, and with a constant divisor, with the operators or with a */
+/* divisor prepared when compiling. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <divisor.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_VALUES (1 << 20)
+#define BLOCK 64
+#define CONSTANT 1000
+
+enum { DIVIDE_32, MODULO_32, DIVIDE_64, MODULO_64 };
+enum { OPERATOR, PREPARED, CONSTANT_OPERATOR, CONSTANT_PREPARED };
+
+__mram_noinit uint64_t numerators[MAX_VALUES];
+__mram_noinit uint64_t results[MAX_VALUES];
+__host uint32_t nr_values;
+__host uint32_t operation;
+__host uint32_t method;
+__host uint64_t divisor;
+__host struct divisor_u32 divisor_u32;
+__host struct divisor_u64 divisor_u64;
+__host uint64_t cycles;
+
+__dma_aligned uint64_t blocks[NR_TASKLETS][BLOCK];
+
+DIVISOR_U32_INIT(constant_u32, CONSTANT);
+DIVISOR_U64_INIT(constant_u64, CONSTANT);
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+static void operator_block(uint64_t *values, uint32_t n) {
+  uint32_t d32 = (uint32_t)divisor;
+  uint64_t d64 = divisor;
+
+  for (uint32_t i = 0; i < n; i++) {
+    if (operation == DIVIDE_32)
+      values[i] = (uint32_t)values[i] / d32;
+    else if (operation == MODULO_32)
+      values[i] = (uint32_t)values[i] % d32;
+    else if (operation == DIVIDE_64)
+      values[i] = values[i] / d64;
+    else
+      values[i] = values[i] % d64;
+  }
+}
+
+static void prepared_block(uint64_t *values, uint32_t n, const struct divisor_u32 *d32, const struct divisor_u64 *d64) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (operation == DIVIDE_32)
+      values[i] = divisor_u32_divide(d32, (uint32_t)values[i]);
+    else if (operation == MODULO_32)
+      values[i] = divisor_u32_modulo(d32, (uint32_t)values[i]);
+    else if (operation == DIVIDE_64)
+      values[i] = divisor_u64_divide(d64, values[i]);
+    else
+      values[i] = divisor_u64_modulo(d64, values[i]);
+  }
+}
+
+static void constant_block(uint64_t *values, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    if (operation == DIVIDE_32)
+      values[i] = (uint32_t)values[i] / CONSTANT;
+    else if (operation == MODULO_32)
+      values[i] = (uint32_t)values[i] % CONSTANT;
+    else if (operation == DIVIDE_64)
+      values[i] = values[i] / CONSTANT;
+    else
+      values[i] = values[i] % CONSTANT;
+  }
+}
+
+int main() {
+  uint64_t *values = blocks[me()];
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  for (uint32_t first = me() * BLOCK; first < nr_values; first += NR_TASKLETS * BLOCK) {
+    uint32_t n = nr_values - first < BLOCK ? nr_values - first : BLOCK;
+    mram_read(&numerators[first], values, BLOCK * sizeof(uint64_t));
+    if (method == OPERATOR)
+      operator_block(values, n);
+    else if (method == PREPARED)
+      prepared_block(values, n, &divisor_u32, &divisor_u64);
+    else if (method == CONSTANT_OPERATOR)
+      constant_block(values, n);
+    else
+      prepared_block(values, n, &constant_u32, &constant_u64);
+    mram_write(values, &results[first], BLOCK * sizeof(uint64_t));
+  }
+
+  barrier_wait(&done);
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
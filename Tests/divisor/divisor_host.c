@@ -0,0 +1,93 @@
+/* Divides random numerators by divisors of 32 and 64 bits on a DPU, with */
+/* the / and % operators and with divisors prepared by the host, then by a */
+/* constant, with the operators and with a divisor prepared when compiling. */
+/* Checks the results, and reports the cycles per value of each method. */
+
+#include <dpu.h>
+#include <dpu_divisor.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./divisor"
+#endif
+
+#define NR_VALUES (1 << 16)
+#define CONSTANT 1000
+
+enum { DIVIDE_32, MODULO_32, DIVIDE_64, MODULO_64, NR_OPERATIONS };
+enum { OPERATOR, PREPARED, CONSTANT_OPERATOR, CONSTANT_PREPARED };
+
+static uint64_t numerators[NR_VALUES], results[NR_VALUES];
+
+/* Runs an operation with a method, checks the results and returns the cycles per value. */
+static double run(struct dpu_set_t set, uint32_t operation, uint32_t method, uint64_t divisor, int *errors) {
+  uint64_t cycles;
+
+  DPU_ASSERT(dpu_broadcast_to(set, "operation", 0, &operation, sizeof(operation), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "method", 0, &method, sizeof(method), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  DPU_ASSERT(dpu_copy_from(set, "cycles", 0, &cycles, sizeof(cycles)));
+  DPU_ASSERT(dpu_copy_from(set, "results", 0, results, sizeof(results)));
+
+  for (uint32_t i = 0; i < NR_VALUES; i++) {
+    uint64_t n = operation < DIVIDE_64 ? (uint32_t)numerators[i] : numerators[i];
+    uint64_t expected = operation == DIVIDE_32 || operation == DIVIDE_64 ? n / divisor : n % divisor;
+    if (results[i] != expected) {
+      if (*errors < 10)
+        printf("method %u: %lu by %lu: %lu instead of %lu\n", method, (unsigned long)n, (unsigned long)divisor,
+            (unsigned long)results[i], (unsigned long)expected);
+      (*errors)++;
+    }
+  }
+  return (double)cycles / NR_VALUES;
+}
+
+int main() {
+  const char *names[NR_OPERATIONS] = { "div u32", "mod u32", "div u64", "mod u64" };
+  const uint64_t divisors[] = { 7, 1000, 65537, 1000003, 0x80000001ull, 0x100000007ull, 0xfffffffffffffc5ull };
+  struct dpu_set_t set;
+  uint32_t nr_values = NR_VALUES;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  srand(1);
+  for (uint32_t i = 0; i < NR_VALUES; i++)
+    numerators[i] = (uint64_t)rand() << 33 ^ (uint64_t)rand() << 16 ^ (uint64_t)rand();
+  DPU_ASSERT(dpu_copy_to(set, "numerators", 0, numerators, sizeof(numerators)));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_values", 0, &nr_values, sizeof(nr_values), DPU_XFER_DEFAULT));
+
+  printf("%8s %20s %12s %12s %8s\n", "", "divisor", "operator", "prepared", "speedup");
+  for (uint32_t operation = 0; operation < NR_OPERATIONS; operation++) {
+    for (uint32_t each_divisor = 0; each_divisor < sizeof(divisors) / sizeof(divisors[0]); each_divisor++) {
+      uint64_t divisor = divisors[each_divisor];
+      struct dpu_divisor_u32 divisor_u32;
+      struct dpu_divisor_u64 divisor_u64;
+      double operator_cycles, prepared_cycles;
+
+      if (operation < DIVIDE_64 && divisor > UINT32_MAX)
+        continue;
+      dpu_divisor_u32_init(&divisor_u32, (uint32_t)divisor);
+      dpu_divisor_u64_init(&divisor_u64, divisor);
+      DPU_ASSERT(dpu_broadcast_to(set, "divisor", 0, &divisor, sizeof(divisor), DPU_XFER_DEFAULT));
+      DPU_ASSERT(dpu_broadcast_to(set, "divisor_u32", 0, &divisor_u32, sizeof(divisor_u32), DPU_XFER_DEFAULT));
+      DPU_ASSERT(dpu_broadcast_to(set, "divisor_u64", 0, &divisor_u64, sizeof(divisor_u64), DPU_XFER_DEFAULT));
+      operator_cycles = run(set, operation, OPERATOR, divisor, &errors);
+      prepared_cycles = run(set, operation, PREPARED, divisor, &errors);
+      printf("%8s %20lu %12.1f %12.1f %8.2f\n", names[operation], (unsigned long)divisor, operator_cycles,
+          prepared_cycles, operator_cycles / prepared_cycles);
+    }
+    {
+      double operator_cycles = run(set, operation, CONSTANT_OPERATOR, CONSTANT, &errors);
+      double prepared_cycles = run(set, operation, CONSTANT_PREPARED, CONSTANT, &errors);
+      printf("%8s %11s %8u %12.1f %12.1f %8.2f\n", names[operation], "constant", CONSTANT, operator_cycles,
+          prepared_cycles, operator_cycles / prepared_cycles);
+    }
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
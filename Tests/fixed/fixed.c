@@ -0,0 +1,169 @@
+/* Applies a fixed-point operation of fixed_point.h to the values held by the */
+/* DPU, or the same operation in float with the soft-float routines, to */
+/* compare their cycles per value. The values are 32-bit words: Q15.16 or */
+/* quantized integers for fixed point, floats otherwise. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <fixed_point.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_VALUES (1 << 20)
+#define BLOCK 128
+
+enum { ADD, MUL_Q16, MUL_Q15, EXP, LOG, SIGMOID, QUANTIZE_INT8, DEQUANTIZE_INT8, NR_OPERATIONS };
+
+__mram_noinit uint32_t a[MAX_VALUES];
+__mram_noinit uint32_t b[MAX_VALUES];
+__mram_noinit uint32_t results[MAX_VALUES];
+__host uint32_t nr_values;
+__host uint32_t operation;
+__host uint32_t use_float;
+__host struct fixed_quantization quantization;
+__host float float_scale;
+__host float float_zero_point;
+__host uint64_t cycles;
+
+__dma_aligned uint32_t blocks_a[NR_TASKLETS][BLOCK];
+__dma_aligned uint32_t blocks_b[NR_TASKLETS][BLOCK];
+__dma_aligned uint32_t blocks_results[NR_TASKLETS][BLOCK];
+
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+typedef union {
+  uint32_t word;
+  float value;
+} word_t;
+
+/* 2^n for an integer n of [-126, 127]. */
+static float power2(int32_t n) {
+  word_t w = { .word = (uint32_t)(n + 127) << 23 };
+  return w.value;
+}
+
+/* e^x as 2^n.e^r with |r| <= ln(2) / 2, as a libm would. */
+static float float_exp(float x) {
+  float y, r, p;
+  int32_t n;
+
+  if (x > 88.0f)
+    return power2(127) * 2.0f;
+  if (x < -87.0f)
+    return 0.0f;
+  y = x * 1.44269504f;
+  n = (int32_t)(y < 0.0f ? y - 0.5f : y + 0.5f);
+  r = x - (float)n * 0.693147181f;
+  p = 1.0f + r * (1.0f + r * (0.5f + r * (0.166666667f + r * (0.0416666667f + r * 0.00833333333f))));
+  return p * power2(n);
+}
+
+/* ln(x) as e.ln(2) + ln(m) with m in [sqrt(2) / 2, sqrt(2)). */
+static float float_log(float x) {
+  word_t w = { .value = x };
+  int32_t e;
+  float m, s, s2;
+
+  if (x <= 0.0f)
+    return -power2(127) * 2.0f;
+  e = (int32_t)(w.word >> 23) - 127;
+  w.word = (w.word & 0x7fffff) | 0x3f800000;
+  m = w.value;
+  if (m > 1.41421356f) {
+    m *= 0.5f;
+    e++;
+  }
+  /* ln(m) = 2.atanh(s) with s = (m - 1) / (m + 1). */
+  s = (m - 1.0f) / (m + 1.0f);
+  s2 = s * s;
+  return (float)e * 0.693147181f + 2.0f * s * (1.0f + s2 * (0.333333333f + s2 * (0.2f + s2 * 0.142857143f)));
+}
+
+static void fixed_block(uint32_t *x, uint32_t *y, uint32_t *r, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    switch (operation) {
+      case ADD:
+        r[i] = fixed_q16_add(x[i], y[i]);
+        break;
+      case MUL_Q16:
+        r[i] = fixed_q16_mul(x[i], y[i]);
+        break;
+      case MUL_Q15:
+        r[i] = (uint16_t)fixed_q15_mul(x[i], y[i]);
+        break;
+      case EXP:
+        r[i] = fixed_q16_exp(x[i]);
+        break;
+      case LOG:
+        r[i] = fixed_q16_log(x[i]);
+        break;
+      case SIGMOID:
+        r[i] = fixed_q16_sigmoid(x[i]);
+        break;
+      case QUANTIZE_INT8:
+        r[i] = (uint8_t)fixed_quantize_int8(x[i], &quantization);
+        break;
+      default:
+        r[i] = fixed_dequantize((int8_t)x[i], &quantization);
+        break;
+    }
+  }
+}
+
+static void float_block(word_t *x, word_t *y, word_t *r, uint32_t n) {
+  for (uint32_t i = 0; i < n; i++) {
+    switch (operation) {
+      case ADD:
+        r[i].value = x[i].value + y[i].value;
+        break;
+      case MUL_Q16:
+      case MUL_Q15:
+        r[i].value = x[i].value * y[i].value;
+        break;
+      case EXP:
+        r[i].value = float_exp(x[i].value);
+        break;
+      case LOG:
+        r[i].value = float_log(x[i].value);
+        break;
+      case SIGMOID:
+        r[i].value = 1.0f / (1.0f + float_exp(-x[i].value));
+        break;
+      case QUANTIZE_INT8: {
+        float q = x[i].value / float_scale + float_zero_point;
+        int32_t rounded = (int32_t)(q < 0.0f ? q - 0.5f : q + 0.5f);
+        r[i].word = (uint8_t)(rounded > 127 ? 127 : rounded < -128 ? -128 : rounded);
+        break;
+      }
+      default:
+        r[i].value = ((float)(int8_t)x[i].word - float_zero_point) * float_scale;
+        break;
+    }
+  }
+}
+
+int main() {
+  uint32_t *x = blocks_a[me()], *y = blocks_b[me()], *r = blocks_results[me()];
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  for (uint32_t first = me() * BLOCK; first < nr_values; first += NR_TASKLETS * BLOCK) {
+    uint32_t n = nr_values - first < BLOCK ? nr_values - first : BLOCK;
+    mram_read(&a[first], x, BLOCK * sizeof(uint32_t));
+    mram_read(&b[first], y, BLOCK * sizeof(uint32_t));
+    if (use_float)
+      float_block((word_t *)x, (word_t *)y, (word_t *)r, n);
+    else
+      fixed_block(x, y, r, n);
+    mram_write(r, &results[first], BLOCK * sizeof(uint32_t));
+  }
+
+  barrier_wait(&done);
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
@@ -0,0 +1,181 @@
+/* Runs each operation of fixed_point.h on a DPU, checks that the results are */
+/* identical to the results of the host, and measures their error against */
+/* libm. Runs the same operations in float on the DPU, with the soft-float */
+/* routines, and reports the cycles per value of both. The errors are in */
+/* units of 2^-16, relative above 1, and in quantization steps for the */
+/* quantization. */
+
+#include <dpu.h>
+#include <dpu_fixed_point.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./fixed"
+#endif
+
+#define NR_VALUES (1 << 18)
+
+enum { ADD, MUL_Q16, MUL_Q15, EXP, LOG, SIGMOID, QUANTIZE_INT8, DEQUANTIZE_INT8, NR_OPERATIONS };
+
+static uint32_t a[NR_VALUES], b[NR_VALUES], results[NR_VALUES];
+static float float_a[NR_VALUES], float_b[NR_VALUES], float_results[NR_VALUES];
+
+/* A random Q15.16 value of [min, max). */
+static int32_t random_q16(double min, double max) {
+  double r = rand() / (RAND_MAX + 1.0);
+  return dpu_fixed_q16_from_double(min + (max - min) * r);
+}
+
+/* The result of the host and the exact value of an operation. */
+static void expected_result(uint32_t operation, uint32_t x, uint32_t y, struct dpu_fixed_quantization *q,
+    uint32_t *expected, double *exact) {
+  double real_x = dpu_fixed_q16_to_double((int32_t)x), real_y = dpu_fixed_q16_to_double((int32_t)y);
+  double scale = ldexp(q->scale, -(int)q->scale_shift);
+
+  switch (operation) {
+    case ADD:
+      *expected = dpu_fixed_q16_add(x, y);
+      *exact = real_x + real_y;
+      break;
+    case MUL_Q16:
+      *expected = dpu_fixed_q16_mul(x, y);
+      *exact = real_x * real_y;
+      break;
+    case MUL_Q15:
+      *expected = (uint16_t)dpu_fixed_q15_mul(x, y);
+      *exact = (int16_t)x / 32768.0 * ((int16_t)y / 32768.0);
+      break;
+    case EXP:
+      *expected = dpu_fixed_q16_exp(x);
+      *exact = exp(real_x);
+      break;
+    case LOG:
+      *expected = dpu_fixed_q16_log(x);
+      *exact = log(real_x);
+      break;
+    case SIGMOID:
+      *expected = dpu_fixed_q16_sigmoid(x);
+      *exact = 1.0 / (1.0 + exp(-real_x));
+      break;
+    case QUANTIZE_INT8:
+      *expected = (uint8_t)dpu_fixed_quantize_int8(x, q);
+      *exact = real_x / scale + q->zero_point;
+      break;
+    default:
+      *expected = dpu_fixed_dequantize((int8_t)x, q);
+      *exact = ((int8_t)x - q->zero_point) * scale;
+      break;
+  }
+}
+
+/* The error of a result against the exact value. */
+static double error(uint32_t operation, double result, double exact) {
+  if (operation == QUANTIZE_INT8)
+    return fabs(result - exact);
+  return fabs(result - exact) / (fabs(exact) > 1.0 ? fabs(exact) : 1.0) * 65536.0;
+}
+
+static uint64_t launch(struct dpu_set_t set, uint32_t operation, uint32_t use_float) {
+  uint64_t cycles;
+
+  DPU_ASSERT(dpu_broadcast_to(set, "operation", 0, &operation, sizeof(operation), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "use_float", 0, &use_float, sizeof(use_float), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  DPU_ASSERT(dpu_copy_from(set, "cycles", 0, &cycles, sizeof(cycles)));
+  return cycles;
+}
+
+int main() {
+  const char *names[NR_OPERATIONS]
+      = { "add", "mul Q15.16", "mul Q0.15", "exp", "log", "sigmoid", "quantize", "dequantize" };
+  /* The ranges of the inputs of exp, log, sigmoid and quantize. */
+  const double min[NR_OPERATIONS] = { [EXP] = -16.0, [LOG] = 0.0, [SIGMOID] = -16.0, [QUANTIZE_INT8] = -4.0 };
+  const double max[NR_OPERATIONS] = { [EXP] = 10.0, [LOG] = 32767.0, [SIGMOID] = 16.0, [QUANTIZE_INT8] = 4.0 };
+  struct dpu_set_t set;
+  struct dpu_fixed_quantization q;
+  uint32_t nr_values = NR_VALUES;
+  float float_scale, float_zero_point;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_values", 0, &nr_values, sizeof(nr_values), DPU_XFER_DEFAULT));
+  dpu_fixed_quantization_of_range(min[QUANTIZE_INT8], max[QUANTIZE_INT8], 8, &q);
+  float_scale = (float)ldexp(q.scale, -(int)q.scale_shift);
+  float_zero_point = (float)q.zero_point;
+  DPU_ASSERT(dpu_broadcast_to(set, "quantization", 0, &q, sizeof(q), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "float_scale", 0, &float_scale, sizeof(float_scale), DPU_XFER_DEFAULT));
+  DPU_ASSERT(
+      dpu_broadcast_to(set, "float_zero_point", 0, &float_zero_point, sizeof(float_zero_point), DPU_XFER_DEFAULT));
+
+  srand(1);
+  printf("%12s %14s %14s %8s %12s %12s\n", "operation", "fixed cycles", "float cycles", "speedup", "fixed error",
+      "float error");
+  for (uint32_t operation = 0; operation < NR_OPERATIONS; operation++) {
+    uint64_t fixed_cycles, float_cycles;
+    double fixed_error = 0.0, float_error = 0.0;
+
+    for (uint32_t i = 0; i < NR_VALUES; i++) {
+      if (operation == ADD || operation == MUL_Q16) {
+        a[i] = random_q16(-256.0, 256.0);
+        b[i] = random_q16(-128.0, 128.0);
+      } else if (operation == MUL_Q15 || operation == DEQUANTIZE_INT8) {
+        a[i] = (uint32_t)rand() & (operation == MUL_Q15 ? 0xffff : 0xff);
+        b[i] = (uint32_t)rand() & 0xffff;
+      } else {
+        a[i] = random_q16(min[operation], max[operation]) | (operation == LOG);
+        b[i] = 0;
+      }
+      if (operation == MUL_Q15) {
+        float_a[i] = (int16_t)a[i] / 32768.0f;
+        float_b[i] = (int16_t)b[i] / 32768.0f;
+      } else if (operation == DEQUANTIZE_INT8) {
+        memcpy(&float_a[i], &a[i], sizeof(float));
+      } else {
+        float_a[i] = (float)dpu_fixed_q16_to_double((int32_t)a[i]);
+        float_b[i] = (float)dpu_fixed_q16_to_double((int32_t)b[i]);
+      }
+    }
+
+    DPU_ASSERT(dpu_copy_to(set, "a", 0, a, sizeof(a)));
+    DPU_ASSERT(dpu_copy_to(set, "b", 0, b, sizeof(b)));
+    fixed_cycles = launch(set, operation, 0);
+    DPU_ASSERT(dpu_copy_from(set, "results", 0, results, sizeof(results)));
+    DPU_ASSERT(dpu_copy_to(set, "a", 0, float_a, sizeof(float_a)));
+    DPU_ASSERT(dpu_copy_to(set, "b", 0, float_b, sizeof(float_b)));
+    float_cycles = launch(set, operation, 1);
+    DPU_ASSERT(dpu_copy_from(set, "results", 0, float_results, sizeof(float_results)));
+
+    for (uint32_t i = 0; i < NR_VALUES; i++) {
+      uint32_t expected, float_word;
+      double exact, result, float_result;
+
+      expected_result(operation, a[i], b[i], &q, &expected, &exact);
+      if (results[i] != expected) {
+        if (errors < 10)
+          printf("%s: wrong result for 0x%08x, 0x%08x: 0x%08x instead of 0x%08x\n", names[operation], a[i], b[i],
+              results[i], expected);
+        errors++;
+      }
+      if (operation == MUL_Q15)
+        result = (int16_t)results[i] / 32768.0;
+      else if (operation == QUANTIZE_INT8)
+        result = (int8_t)results[i];
+      else
+        result = dpu_fixed_q16_to_double((int32_t)results[i]);
+      memcpy(&float_word, &float_results[i], sizeof(float_word));
+      float_result = operation == QUANTIZE_INT8 ? (int8_t)float_word : float_results[i];
+      fixed_error = fmax(fixed_error, error(operation, result, exact));
+      float_error = fmax(float_error, error(operation, float_result, exact));
+    }
+    printf("%12s %14.1f %14.1f %8.1f %12.2f %12.2f\n", names[operation], (double)fixed_cycles / NR_VALUES,
+        (double)float_cycles / NR_VALUES, (double)float_cycles / fixed_cycles, fixed_error, float_error);
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
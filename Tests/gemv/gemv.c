@@ -0,0 +1,33 @@
+/* Multiplies the slice of the matrix held by the DPU with the vectors */
+/* broadcast by the host. */
+
+#include <defs.h>
+#include <gemv.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_VECTOR_SIZE 4096
+#define MAX_OUTPUT_ROWS (1 << 18)
+
+__mram_noinit uint64_t matrix[(48 << 20) / sizeof(uint64_t)];
+__mram_noinit int32_t output[GEMV_MAX_VECTORS * MAX_OUTPUT_ROWS];
+__host __dma_aligned uint8_t vectors[GEMV_MAX_VECTORS * MAX_VECTOR_SIZE];
+__host uint32_t nr_rows;
+__host uint32_t nr_columns;
+__host uint32_t nr_vectors;
+__host uint32_t type;
+__host uint32_t shift;
+__host uint64_t cycles;
+
+GEMV_INIT(products);
+
+int main() {
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  gemv_multiply(&products, (gemv_type_t)type, matrix, nr_rows, nr_columns, vectors, nr_vectors, shift, output);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
@@ -0,0 +1,111 @@
+/* Multiplies a matrix split across the DPUs with 1 and 4 vectors, for */
+/* 8-bit, 16-bit and 32-bit integers and for fixed-point numbers, and */
+/* compares the throughput with the same products on the host. Build with */
+/* -O3 -mavx2 for a vectorized host baseline. */
+
+#include <dpu.h>
+#include <dpu_gemv.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./gemv"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define ROWS_PER_DPU 2048
+#define NR_COLUMNS 1024
+#define MAX_VECTORS 4
+#define NR_REPETITIONS 8
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill(void *data, size_t size) {
+  uint8_t *bytes = data;
+  for (size_t i = 0; i < size; i++)
+    bytes[i] = (uint8_t)rand();
+}
+
+int main() {
+  static const struct {
+    const char *name;
+    dpu_gemv_type_t type;
+    uint32_t shift;
+  } formats[] = {
+    { "int8", DPU_GEMV_INT8, 0 },
+    { "int16", DPU_GEMV_INT16, 0 },
+    { "q8.8", DPU_GEMV_INT16, 8 },
+    { "int32", DPU_GEMV_INT32, 0 },
+    { "q16.16", DPU_GEMV_INT32, 16 },
+  };
+  struct dpu_set_t set;
+  uint32_t nr_rows = NR_DPUS * ROWS_PER_DPU;
+  int32_t *output = malloc((size_t)MAX_VECTORS * nr_rows * sizeof(int32_t));
+  int32_t *expected = malloc((size_t)MAX_VECTORS * nr_rows * sizeof(int32_t));
+  int errors = 0;
+#ifdef __AVX2__
+  const char *host = "host AVX2";
+#else
+  const char *host = "host";
+#endif
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  printf("%7s %8s %10s %10s %10s %12s\n", "format", "vectors", "load s", "DPU GOPS", "host GOPS", "speedup");
+  for (uint32_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+    size_t element_size = (size_t)1 << formats[f].type;
+    void *matrix = malloc((size_t)nr_rows * NR_COLUMNS * element_size);
+    void *vectors = malloc((size_t)MAX_VECTORS * NR_COLUMNS * element_size);
+    struct dpu_gemv gemv;
+    double start, load_time;
+
+    srand(f);
+    fill(matrix, (size_t)nr_rows * NR_COLUMNS * element_size);
+    start = now();
+    DPU_ASSERT(dpu_gemv_load(set, formats[f].type, matrix, nr_rows, NR_COLUMNS, &gemv));
+    load_time = now() - start;
+
+    for (uint32_t nr_vectors = 1; nr_vectors <= MAX_VECTORS; nr_vectors *= 4) {
+      double operations = 2.0 * nr_rows * NR_COLUMNS * nr_vectors * NR_REPETITIONS, dpu_time, host_time;
+
+      fill(vectors, (size_t)nr_vectors * NR_COLUMNS * element_size);
+      start = now();
+      for (uint32_t r = 0; r < NR_REPETITIONS; r++)
+        DPU_ASSERT(dpu_gemv_multiply(&gemv, vectors, nr_vectors, formats[f].shift, output));
+      dpu_time = now() - start;
+
+      start = now();
+      for (uint32_t r = 0; r < NR_REPETITIONS; r++)
+        dpu_gemv_reference(formats[f].type, matrix, nr_rows, NR_COLUMNS, vectors, nr_vectors, formats[f].shift, expected);
+      host_time = now() - start;
+
+      for (uint64_t i = 0; i < (uint64_t)nr_vectors * nr_rows; i++) {
+        if (output[i] != expected[i]) {
+          printf("%s: wrong result %lu: %d instead of %d\n", formats[f].name, (unsigned long)i, output[i], expected[i]);
+          errors++;
+          break;
+        }
+      }
+      printf("%7s %8u %10.3f %10.2f %10.2f %12.2f\n", formats[f].name, nr_vectors, load_time, operations / dpu_time / 1e9,
+          operations / host_time / 1e9, host_time / dpu_time);
+    }
+    free(vectors);
+    free(matrix);
+  }
+  printf("host baseline: %s\n", host);
+
+  DPU_ASSERT(dpu_free(set));
+  free(expected);
+  free(output);
+  return errors != 0;
+}
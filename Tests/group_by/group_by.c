@@ -0,0 +1,38 @@
+/* Aggregates the rows of the DPU by key (count, sum, min, max of the */
+/* values), and reports how many partial aggregates were spilled to MRAM. */
+
+#include <defs.h>
+#include <group_by.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_ROWS (1 << 19)
+#define MAX_SLOTS (1 << 20)
+
+__mram_noinit uint32_t keys[MAX_ROWS];
+__mram_noinit int32_t values[MAX_ROWS];
+__mram_noinit struct group_by_entry table[MAX_SLOTS];
+__mram_noinit struct group_by_entry groups[MAX_ROWS];
+__host uint32_t nr_rows;
+__host uint32_t nr_slots;
+__host uint32_t nr_groups;
+__host uint32_t nr_spills;
+__host uint64_t cycles;
+
+GROUP_BY_INIT(aggregation, 64);
+
+int main() {
+  uint32_t n;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  n = group_by_aggregate(&aggregation, keys, values, nr_rows, table, nr_slots, groups);
+
+  if (me() == 0) {
+    cycles = perfcounter_get();
+    nr_groups = n;
+    nr_spills = group_by_nr_spills(&aggregation);
+  }
+  return 0;
+}
@@ -0,0 +1,157 @@
+/* Aggregates rows spread across the DPUs by key, from 10 to 10M distinct */
+/* keys: the DPUs aggregate their rows, spilling to MRAM when their WRAM */
+/* tables overflow, and the host merges the groups of all the DPUs. */
+
+#include <dpu.h>
+#include <dpu_group_by.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./group_by"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#ifndef NR_MERGE_THREADS
+#define NR_MERGE_THREADS 8
+#endif
+
+#define ROWS_PER_DPU (1 << 19)
+#define MAX_SLOTS (1 << 20)
+#define MAX_GROUPS 10000000
+
+/* The keys are the group numbers multiplied by an odd constant, so that they are sparse. */
+#define KEY_FACTOR 2654435761u
+#define KEY_FACTOR_INVERSE 244002641u
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t each_dpu, nr_rows = ROWS_PER_DPU;
+  uint64_t nr_total_rows = (uint64_t)NR_DPUS * ROWS_PER_DPU;
+  uint32_t *keys = malloc(nr_total_rows * sizeof(uint32_t));
+  int32_t *values = malloc(nr_total_rows * sizeof(int32_t));
+  struct dpu_group *expected = malloc(MAX_GROUPS * sizeof(struct dpu_group));
+  struct dpu_group *groups = malloc((size_t)NR_DPUS * ROWS_PER_DPU * sizeof(struct dpu_group));
+  uint32_t nr_groups[NR_DPUS], nr_spills[NR_DPUS];
+  uint64_t cycles[NR_DPUS], offsets[NR_DPUS + 1];
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_rows", 0, &nr_rows, sizeof(nr_rows), DPU_XFER_DEFAULT));
+
+  printf("%9s %9s %10s %10s %10s %12s %10s %10s %10s\n", "groups", "spills", "spills/row", "cycles/row", "DPU s",
+      "DPU groups", "pull s", "merge s", "Mrows/s");
+  for (uint32_t cardinality = 10; cardinality <= MAX_GROUPS; cardinality *= 10) {
+    uint32_t nr_slots = 1;
+    uint64_t total_spills = 0, total_groups = 0, max_cycles = 0, nr_merged = 0, nr_expected = 0;
+    struct dpu_group *merged = NULL;
+    double start, dpu_time, pull_time, merge_time;
+    size_t max_length;
+
+    /* Each DPU sees at most ROWS_PER_DPU groups: size its MRAM table for a load factor of 1/2. */
+    while (nr_slots < 2 * (cardinality < ROWS_PER_DPU ? cardinality : ROWS_PER_DPU))
+      nr_slots <<= 1;
+    nr_slots = nr_slots > MAX_SLOTS ? MAX_SLOTS : nr_slots;
+
+    srand(cardinality);
+    for (uint32_t g = 0; g < cardinality; g++)
+      expected[g].count = 0;
+    for (uint64_t i = 0; i < nr_total_rows; i++) {
+      uint32_t g = (uint32_t)(((uint64_t)rand() << 16 ^ rand()) % cardinality);
+      struct dpu_group *e = &expected[g];
+      keys[i] = g * KEY_FACTOR + 1;
+      values[i] = rand() % 2001 - 1000;
+      if (e->count++ == 0) {
+        e->sum = e->min = e->max = values[i];
+        nr_expected++;
+      } else {
+        e->sum += values[i];
+        e->min = values[i] < e->min ? values[i] : e->min;
+        e->max = values[i] > e->max ? values[i] : e->max;
+      }
+    }
+
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &keys[(uint64_t)each_dpu * ROWS_PER_DPU]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "keys", 0, ROWS_PER_DPU * sizeof(uint32_t), DPU_XFER_DEFAULT));
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &values[(uint64_t)each_dpu * ROWS_PER_DPU]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "values", 0, ROWS_PER_DPU * sizeof(int32_t), DPU_XFER_DEFAULT));
+    DPU_ASSERT(dpu_broadcast_to(set, "nr_slots", 0, &nr_slots, sizeof(nr_slots), DPU_XFER_DEFAULT));
+
+    start = now();
+    DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+    dpu_time = now() - start;
+
+    start = now();
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_groups[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "nr_groups", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_spills[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "nr_spills", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+    for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+      if (nr_groups[each_dpu] == 0xffffffffu) {
+        printf("MRAM table too small on DPU %u\n", each_dpu);
+        return 1;
+      }
+      total_groups += nr_groups[each_dpu];
+      total_spills += nr_spills[each_dpu];
+      if (cycles[each_dpu] > max_cycles)
+        max_cycles = cycles[each_dpu];
+    }
+    max_length = dpu_group_offsets(nr_groups, NR_DPUS, offsets);
+    DPU_ASSERT(dpu_group_pull(set, "groups", groups, offsets, max_length));
+    pull_time = now() - start;
+
+    start = now();
+    DPU_ASSERT(dpu_group_merge(groups, total_groups, NR_MERGE_THREADS, &merged, &nr_merged));
+    merge_time = now() - start;
+
+    if (nr_merged != nr_expected) {
+      printf("wrong number of groups: %lu instead of %lu\n", (unsigned long)nr_merged, (unsigned long)nr_expected);
+      errors++;
+    }
+    for (uint64_t i = 0; i < nr_merged; i++) {
+      uint32_t g = (merged[i].key - 1) * KEY_FACTOR_INVERSE;
+      if (g >= cardinality || merged[i].count != expected[g].count || merged[i].sum != expected[g].sum
+          || merged[i].min != expected[g].min || merged[i].max != expected[g].max) {
+        printf("wrong aggregates for key %u\n", merged[i].key);
+        errors++;
+        break;
+      }
+    }
+    free(merged);
+
+    printf("%9u %9lu %10.3f %10.1f %10.4f %12lu %10.4f %10.4f %10.1f\n", cardinality, (unsigned long)total_spills,
+        (double)total_spills / nr_total_rows, (double)max_cycles / ROWS_PER_DPU, dpu_time, (unsigned long)total_groups,
+        pull_time, merge_time, nr_total_rows / (dpu_time + pull_time + merge_time) / 1e6);
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(groups);
+  free(expected);
+  free(values);
+  free(keys);
+  return errors != 0;
+}
@@ -0,0 +1,113 @@
+/* Join kernel of dpu::HashJoin (dpu_join.hpp): builds a hash table from the */
+/* build tuples of the DPU, then probes it with the probe tuples in batches. */
+
+#define MRAM_GATHER_WINDOW_SIZE 256
+#define MRAM_STRING_BUFFER_SIZE 256
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_hash.h>
+#include <mram_string.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_BUILD_TUPLES (1 << 18)
+#define MAX_PROBE_TUPLES (1 << 20)
+#define MAX_MATCHES (1 << 20)
+#define MAX_TABLE_SIZE (8 << 20)
+#define BATCH_SIZE 16
+#define MATCH_BUFFER_SIZE 32
+
+__mram_noinit uint64_t build_tuples[MAX_BUILD_TUPLES];
+__mram_noinit uint64_t probe_tuples[MAX_PROBE_TUPLES];
+__mram_noinit uint64_t matches[MAX_MATCHES];
+__mram_noinit uint8_t table[MAX_TABLE_SIZE];
+__host uint32_t nr_build_tuples;
+__host uint32_t nr_probe_tuples;
+__host uint32_t nr_buckets;
+__host uint32_t nr_matches;
+__host uint64_t cycles;
+
+__dma_aligned uint64_t tuples[NR_TASKLETS][BATCH_SIZE];
+__dma_aligned uint64_t match_buffers[NR_TASKLETS][MATCH_BUFFER_SIZE];
+__dma_aligned uint8_t buffers[NR_TASKLETS][MRAM_STRING_BUFFER_SIZE];
+uint32_t batch_keys[NR_TASKLETS][BATCH_SIZE];
+uint32_t batch_values[NR_TASKLETS][BATCH_SIZE];
+bool batch_found[NR_TASKLETS][BATCH_SIZE];
+
+MRAM_HASH_INIT(hash_table, 64);
+MRAM_HASH_BATCH_INIT(batch, BATCH_SIZE);
+MUTEX_INIT(match_cursor);
+BARRIER_INIT(cleared, NR_TASKLETS);
+BARRIER_INIT(built, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+/* Reserves room for the buffered matches of the tasklet, and writes those */
+/* that fit in the capacity of matches. */
+static void flush_matches(uint64_t *buffer, uint32_t n) {
+  uint32_t first;
+
+  mutex_lock(match_cursor);
+  first = nr_matches;
+  nr_matches += n;
+  mutex_unlock(match_cursor);
+
+  if (first < MAX_MATCHES) {
+    uint32_t fitting = MAX_MATCHES - first < n ? MAX_MATCHES - first : n;
+    mram_write(buffer, &matches[first], fitting * sizeof(uint64_t));
+  }
+}
+
+int main() {
+  uint64_t *t = tuples[me()];
+  uint64_t *m = match_buffers[me()];
+  uint32_t *k = batch_keys[me()];
+  uint32_t *v = batch_values[me()];
+  bool *f = batch_found[me()];
+  uint32_t nr_buffered = 0;
+
+  if (me() == 0) {
+    nr_matches = 0;
+    perfcounter_config(COUNT_CYCLES, true);
+  }
+  mram_hash_attach(&hash_table, table, nr_buckets);
+  mram_memset_parallel(table, 0xff, nr_buckets * MRAM_HASH_BUCKET_SIZE, buffers[me()]);
+  barrier_wait(&cleared);
+
+  /* Build: the keys are unique, each tuple is inserted with its payload. */
+  for (uint32_t i = me() * BATCH_SIZE; i < nr_build_tuples; i += NR_TASKLETS * BATCH_SIZE) {
+    uint32_t n = nr_build_tuples - i < BATCH_SIZE ? nr_build_tuples - i : BATCH_SIZE;
+    mram_read(&build_tuples[i], t, BATCH_SIZE * sizeof(uint64_t));
+    for (uint32_t j = 0; j < n; j++)
+      mram_hash_insert(&hash_table, (uint32_t)t[j], (uint32_t)(t[j] >> 32));
+  }
+  barrier_wait(&built);
+
+  /* Probe: a match is the build payload followed by the probe payload. */
+  for (uint32_t i = me() * BATCH_SIZE; i < nr_probe_tuples; i += NR_TASKLETS * BATCH_SIZE) {
+    uint32_t n = nr_probe_tuples - i < BATCH_SIZE ? nr_probe_tuples - i : BATCH_SIZE;
+    mram_read(&probe_tuples[i], t, BATCH_SIZE * sizeof(uint64_t));
+    for (uint32_t j = 0; j < n; j++)
+      k[j] = (uint32_t)t[j];
+    if (mram_hash_lookup_batch(&hash_table, &batch, k, n, v, f) == 0)
+      continue;
+    for (uint32_t j = 0; j < n; j++) {
+      if (!f[j])
+        continue;
+      m[nr_buffered++] = v[j] | (t[j] & 0xffffffff00000000ull);
+      if (nr_buffered == MATCH_BUFFER_SIZE) {
+        flush_matches(m, nr_buffered);
+        nr_buffered = 0;
+      }
+    }
+  }
+  if (nr_buffered != 0)
+    flush_matches(m, nr_buffered);
+  barrier_wait(&done);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
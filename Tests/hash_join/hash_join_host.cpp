@@ -0,0 +1,93 @@
+/* Joins synthetic TPC-H-like orders and lineitems with dpu::HashJoin on all */
+/* the DPUs of a set, and compares with a hash join on the host. */
+
+#include <dpu_join.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./hash_join"
+#endif
+
+#define NR_DPUS 64
+#define MAX_BUILD_TUPLES (1 << 18)
+#define MAX_PROBE_TUPLES (1 << 20)
+#define MAX_MATCHES (1 << 20)
+#define MAX_TABLE_SIZE (8 << 20)
+
+using namespace dpu;
+
+/* Orders have sparse unique keys, as the orderkeys of TPC-H (8 out of every */
+/* 32), and 1 to 7 lineitems each. One lineitem out of 16 references a */
+/* missing order. */
+static void generate(uint32_t nr_orders, std::vector<JoinTuple> &orders, std::vector<JoinTuple> &lineitems) {
+  std::mt19937 rng(42);
+
+  orders.clear();
+  lineitems.clear();
+  for (uint32_t i = 0; i < nr_orders; i++) {
+    uint32_t orderkey = (i / 8) * 32 + i % 8 + 1;
+    orders.push_back({ orderkey, i });
+    for (uint32_t l = rng() % 7 + 1; l > 0; l--) {
+      uint32_t key = rng() % 16 == 0 ? orderkey + 8 : orderkey;
+      lineitems.push_back({ key, (uint32_t)lineitems.size() });
+    }
+  }
+  std::shuffle(lineitems.begin(), lineitems.end(), rng);
+}
+
+static uint64_t checksum(const std::vector<JoinMatch> &matches) {
+  uint64_t sum = 0;
+  for (const JoinMatch &m : matches)
+    sum += ((uint64_t)m.buildPayload << 32 | m.probePayload) * 0x9e3779b97f4a7c15ull >> 7;
+  return sum;
+}
+
+int main() {
+  auto system = DpuSet::allocate(NR_DPUS, "sgXferEnable=true");
+  std::vector<JoinTuple> orders, lineitems;
+  int errors = 0;
+
+  system.load(DPU_BINARY);
+  HashJoin join(system, MAX_BUILD_TUPLES, MAX_PROBE_TUPLES, MAX_MATCHES, MAX_TABLE_SIZE);
+
+  printf("%9s %9s %9s %11s %11s %9s %9s %9s %9s\n", "orders", "lineitems", "matches", "host Mt/s", "dpu Mt/s",
+      "part s", "in s", "exec s", "out s");
+  for (uint32_t nr_orders = 1 << 16; nr_orders <= NR_DPUS * (MAX_BUILD_TUPLES / 4); nr_orders <<= 2) {
+    generate(nr_orders, orders, lineitems);
+    double nr_tuples = orders.size() + lineitems.size();
+
+    auto start = std::chrono::steady_clock::now();
+    std::unordered_map<uint32_t, uint32_t> table(orders.size());
+    std::vector<JoinMatch> expected;
+    for (const JoinTuple &o : orders)
+      table.emplace(o.key, o.payload);
+    for (const JoinTuple &l : lineitems) {
+      auto it = table.find(l.key);
+      if (it != table.end())
+        expected.push_back({ it->second, l.payload });
+    }
+    double host_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    std::vector<JoinMatch> matches = join.join(orders, lineitems);
+    double dpu_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (matches.size() != expected.size() || checksum(matches) != checksum(expected)) {
+      printf("wrong result for %u orders\n", nr_orders);
+      errors++;
+    }
+    const JoinTimings &t = join.timings();
+    printf("%9u %9zu %9zu %11.1f %11.1f %9.4f %9.4f %9.4f %9.4f\n", nr_orders, lineitems.size(), matches.size(),
+        nr_tuples / host_time / 1e6, nr_tuples / dpu_time / 1e6, t.partition, t.transferIn, t.execution,
+        t.transferOut);
+  }
+
+  return errors != 0;
+}
@@ -1,3 +1,4 @@
+#include <checksum.h>
 #include <mram.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -15,9 +16,8 @@ int main() {
   for (unsigned int bytes_read = 0; bytes_read < BUFFER_SIZE;) {
     mram_read(&buffer[bytes_read], local_cache, CACHE_SIZE);
 
-    for (unsigned int byte_index = 0; (byte_index < CACHE_SIZE) && (bytes_read < BUFFER_SIZE); byte_index++, bytes_read++) {
-      checksum += (uint32_t)local_cache[byte_index];
-    }
+    checksum = checksum_crc32c(checksum, local_cache, CACHE_SIZE);
+    bytes_read += CACHE_SIZE;
   }
 
   return checksum;
@@ -1,8 +1,9 @@
 /* Communication with a DPU via the MRAM. */
 /* Populate the MRAM with a collection of bytes and request the DPU to */
-/* compute the checksum. */
+/* compute their CRC32C, checked against the host. */
 
 #include <dpu.h>
+#include <dpu_checksum.h>
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -14,9 +15,9 @@
 /* Size of the buffer for which we compute the checksum: 64KBytes. */
 #define BUFFER_SIZE (1 << 16)
 
-void populate_mram(struct dpu_set_t set) {
-  uint8_t buffer[BUFFER_SIZE];
+uint8_t buffer[BUFFER_SIZE];
 
+void populate_mram(struct dpu_set_t set) {
   for (int byte_index = 0; byte_index < BUFFER_SIZE; byte_index++) {
     buffer[byte_index] = (uint8_t)byte_index;
   }
@@ -26,6 +27,7 @@ void populate_mram(struct dpu_set_t set) {
 int main() {
   struct dpu_set_t set, dpu;
   uint32_t checksum;
+  int errors = 0;
 
   DPU_ASSERT(dpu_alloc(1, NULL, &set));
   DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
@@ -35,7 +37,11 @@ int main() {
   DPU_FOREACH(set, dpu) {
     DPU_ASSERT(dpu_copy_from(dpu, "checksum", 0, (uint8_t *)&checksum, sizeof(checksum)));
     printf("Computed checksum = 0x%08x\n", checksum);
+    if (checksum != dpu_checksum_crc32c(0, buffer, BUFFER_SIZE)) {
+      printf("Expected checksum = 0x%08x\n", dpu_checksum_crc32c(0, buffer, BUFFER_SIZE));
+      errors++;
+    }
   }
   DPU_ASSERT(dpu_free(set));
-  return 0;
+  return errors != 0;
 }
\ No newline at end of file
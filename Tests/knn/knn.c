@@ -0,0 +1,32 @@
+/* Searches the nearest neighbours of a batch of queries among the int8 */
+/* vectors stored in the MRAM of the DPU. */
+
+#include <defs.h>
+#include <knn.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_DIMS 256
+
+__mram_noinit int8_t vectors[32 << 20];
+__host __dma_aligned int8_t queries[KNN_MAX_QUERIES * MAX_DIMS];
+__host struct knn_result results[KNN_MAX_QUERIES * KNN_MAX_K];
+__host uint32_t metric;
+__host uint32_t nr_vectors;
+__host uint32_t dims;
+__host uint32_t nr_queries;
+__host uint32_t k;
+__host uint64_t cycles;
+
+KNN_INIT(search);
+
+int main() {
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  knn_search(&search, (knn_metric_t)metric, vectors, nr_vectors, dims, queries, nr_queries, k, results);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
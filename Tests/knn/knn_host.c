@@ -0,0 +1,151 @@
+/* Searches the nearest neighbours of batches of queries among int8 vectors */
+/* spread across the DPUs, from 256K to 16M vectors with 64 DPUs: the */
+/* vectors stay in MRAM, the queries are broadcast, and the host merges the */
+/* neighbours found by each DPU. The first batch of each size is checked */
+/* against a search on the host. */
+
+#include <dpu.h>
+#include <dpu_knn.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./knn"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define DIMS 64
+#define NR_QUERIES 8
+#define K 10
+#define NR_BATCHES 4
+#define MIN_VECTORS_PER_DPU (1 << 12)
+#define MAX_VECTORS_PER_DPU (1 << 18)
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* The vectors are generated from their index, so that the host does not keep them. */
+static void make_vector(uint64_t index, int8_t *vector) {
+  for (uint32_t d = 0; d < DIMS; d++) {
+    uint64_t x = (index * DIMS + d + 1) * 0x9e3779b97f4a7c15ull;
+    vector[d] = (int8_t)((x ^ (x >> 29)) >> 56);
+  }
+}
+
+/* The k nearest neighbours of a query, with the smallest index first among equal distances. */
+static void search(dpu_knn_metric_t metric, const int8_t *query, uint64_t nr_vectors, uint64_t *indices,
+                   int32_t *distances) {
+  int8_t vector[DIMS];
+  uint32_t found = 0;
+
+  for (uint64_t i = 0; i < nr_vectors; i++) {
+    int32_t distance;
+    uint32_t j;
+
+    make_vector(i, vector);
+    distance = dpu_knn_distance(metric, query, vector, DIMS);
+    if (found == K && distance >= distances[K - 1])
+      continue;
+    j = found < K ? found++ : K - 1;
+    for (; j > 0 && distances[j - 1] > distance; j--) {
+      distances[j] = distances[j - 1];
+      indices[j] = indices[j - 1];
+    }
+    distances[j] = distance;
+    indices[j] = i;
+  }
+}
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t each_dpu, dims = DIMS, k = K, nr_queries = NR_QUERIES;
+  int8_t *vectors = malloc((size_t)MAX_VECTORS_PER_DPU * DIMS);
+  int8_t queries[NR_QUERIES * DIMS];
+  struct dpu_knn_result *results = malloc((size_t)NR_DPUS * NR_QUERIES * K * sizeof(*results));
+  uint64_t first_indices[NR_DPUS], cycles[NR_DPUS];
+  uint64_t indices[NR_QUERIES * K], expected_indices[K];
+  int32_t distances[NR_QUERIES * K], expected_distances[K];
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "dims", 0, &dims, sizeof(dims), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "k", 0, &k, sizeof(k), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_queries", 0, &nr_queries, sizeof(nr_queries), DPU_XFER_DEFAULT));
+
+  printf("%6s %10s %12s %10s %10s %12s\n", "metric", "vectors", "cycles/vec", "DPU s", "merge s", "queries/s");
+  for (uint32_t nr_vectors = MIN_VECTORS_PER_DPU; nr_vectors <= MAX_VECTORS_PER_DPU; nr_vectors *= 4) {
+    uint64_t nr_total_vectors = (uint64_t)NR_DPUS * nr_vectors;
+
+    /* The vectors are loaded once, and stay in MRAM for all the batches. */
+    DPU_FOREACH(set, dpu, each_dpu) {
+      first_indices[each_dpu] = (uint64_t)each_dpu * nr_vectors;
+      for (uint32_t i = 0; i < nr_vectors; i++)
+        make_vector(first_indices[each_dpu] + i, &vectors[(size_t)i * DIMS]);
+      DPU_ASSERT(dpu_copy_to(dpu, "vectors", 0, vectors, (size_t)nr_vectors * DIMS));
+    }
+    DPU_ASSERT(dpu_broadcast_to(set, "nr_vectors", 0, &nr_vectors, sizeof(nr_vectors), DPU_XFER_DEFAULT));
+
+    for (uint32_t metric = DPU_KNN_DOT; metric <= DPU_KNN_L2; metric++) {
+      uint64_t max_cycles = 0;
+      double start, dpu_time = 0, merge_time = 0;
+
+      DPU_ASSERT(dpu_broadcast_to(set, "metric", 0, &metric, sizeof(metric), DPU_XFER_DEFAULT));
+      srand(nr_vectors + metric);
+      for (uint32_t batch = 0; batch < NR_BATCHES; batch++) {
+        for (uint32_t i = 0; i < NR_QUERIES * DIMS; i++)
+          queries[i] = (int8_t)(rand() % 256 - 128);
+
+        start = now();
+        DPU_ASSERT(dpu_broadcast_to(set, "queries", 0, queries, sizeof(queries), DPU_XFER_DEFAULT));
+        DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+        DPU_ASSERT(dpu_knn_pull(set, "results", NR_QUERIES, K, results));
+        dpu_time += now() - start;
+
+        start = now();
+        DPU_ASSERT(dpu_knn_merge(results, NR_DPUS, NR_QUERIES, K, first_indices, indices, distances));
+        merge_time += now() - start;
+
+        DPU_FOREACH(set, dpu, each_dpu) {
+          DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+        }
+        DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+        for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+          if (cycles[each_dpu] > max_cycles)
+            max_cycles = cycles[each_dpu];
+
+        if (batch != 0)
+          continue;
+        for (uint32_t q = 0; q < NR_QUERIES; q++) {
+          search(metric, &queries[q * DIMS], nr_total_vectors, expected_indices, expected_distances);
+          for (uint32_t i = 0; i < K; i++) {
+            if (indices[q * K + i] != expected_indices[i] || distances[q * K + i] != expected_distances[i]) {
+              printf("wrong neighbour %u of query %u: %lu (%d) instead of %lu (%d)\n", i, q,
+                  (unsigned long)indices[q * K + i], distances[q * K + i], (unsigned long)expected_indices[i],
+                  expected_distances[i]);
+              errors++;
+              break;
+            }
+          }
+        }
+      }
+
+      printf("%6s %10lu %12.1f %10.4f %10.6f %12.1f\n", metric == DPU_KNN_DOT ? "dot" : "l2",
+          (unsigned long)nr_total_vectors, (double)max_cycles / nr_vectors, dpu_time / NR_BATCHES,
+          merge_time / NR_BATCHES, NR_BATCHES * NR_QUERIES / (dpu_time + merge_time));
+    }
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(results);
+  free(vectors);
+  return errors != 0;
+}
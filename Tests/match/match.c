@@ -0,0 +1,38 @@
+/* Searches the patterns of the automaton broadcast by the host in the part of */
+/* the text held by the DPU. */
+
+#include <defs.h>
+#include <mram.h>
+#include <mram_match.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_TEXT (32 << 20)
+#define MAX_MATCHES (1 << 20)
+#define MAX_AUTOMATON (32 << 10)
+
+__mram_noinit uint8_t text[MAX_TEXT + 2 * SEQREAD_CACHE_SIZE];
+__mram_noinit struct mram_match_result matches[MAX_MATCHES];
+__host __dma_aligned uint8_t automaton[MAX_AUTOMATON];
+__host uint32_t text_length;
+__host uint32_t report_from;
+__host uint32_t max_matches;
+__host uint32_t nr_matches;
+__host uint64_t cycles;
+
+MRAM_MATCH_INIT(search);
+
+int main() {
+  uint32_t count;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  count = mram_match_search(&search, (const struct mram_match_automaton *)automaton, text, text_length, report_from,
+      matches, max_matches);
+
+  if (me() == 0) {
+    nr_matches = count;
+    cycles = perfcounter_get();
+  }
+  return 0;
+}
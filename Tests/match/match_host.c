@@ -0,0 +1,126 @@
+/* Searches a DNA text for short reads and a lowercase text for words, some of */
+/* the patterns being copied from the text, then a text shorter than 8 bytes */
+/* per DPU. Checks the matches against the host search with the same */
+/* automaton, and reports the throughput of both in GB/s, for the text held by */
+/* all the DPUs. */
+
+#include <dpu.h>
+#include <dpu_match.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./match"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define BYTES_PER_DPU (16 << 20)
+#define MAX_DPU_MATCHES (1 << 20)
+#define NR_PATTERNS 64
+#define MAX_PATTERN_LENGTH 16
+#define NR_REPETITIONS 4
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void random_text(uint8_t *text, uint64_t length, const char *alphabet) {
+  uint32_t size = strlen(alphabet);
+  for (uint64_t i = 0; i < length; i++)
+    text[i] = alphabet[rand() % size];
+}
+
+/* Half of the patterns are copied from the text, the others are random. */
+static void random_patterns(const uint8_t *text, uint64_t length, const char *alphabet, uint32_t min_length,
+    uint32_t max_length, uint8_t *patterns[NR_PATTERNS], uint32_t lengths[NR_PATTERNS]) {
+  for (uint32_t p = 0; p < NR_PATTERNS; p++) {
+    lengths[p] = min_length + rand() % (max_length - min_length + 1);
+    patterns[p] = malloc(lengths[p]);
+    if (p % 2 == 0)
+      memcpy(patterns[p], &text[((uint64_t)rand() * RAND_MAX + rand()) % (length - lengths[p])], lengths[p]);
+    else
+      random_text(patterns[p], lengths[p], alphabet);
+  }
+}
+
+int main() {
+  struct dpu_set_t set;
+  const char *names[3] = { "DNA", "words", "short" };
+  const char *alphabets[3] = { "ACGT", "abcdefghijklmnopqrstuvwxyz ", "ab" };
+  uint32_t min_lengths[3] = { 8, 3, 2 }, max_lengths[3] = { MAX_PATTERN_LENGTH, 8, 4 };
+  /* The parts of the short text are about 4 bytes, and those of the last DPUs end in its last 7 bytes, past its last */
+  /* multiple of 8: each of these DPUs transfers its end padded with zeros. */
+  uint64_t text_lengths[3] = { (uint64_t)NR_DPUS * BYTES_PER_DPU, (uint64_t)NR_DPUS * BYTES_PER_DPU, 4 * NR_DPUS + 7 };
+  uint8_t *text = malloc(text_lengths[0]);
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  srand(1);
+  printf("%6s %9s %8s %10s %10s %10s %10s\n", "text", "automaton", "states", "matches", "DPU ms", "DPU GB/s",
+      "host GB/s");
+  for (uint32_t t = 0; t < 3; t++) {
+    uint64_t length = text_lengths[t];
+    uint8_t *patterns[NR_PATTERNS];
+    uint32_t lengths[NR_PATTERNS], size;
+    void *automaton;
+    struct dpu_match_text loaded;
+    uint64_t nr_matches, nr_expected;
+    double start, dpu_time, host_time;
+
+    random_text(text, length, alphabets[t]);
+    random_patterns(text, length, alphabets[t], min_lengths[t], max_lengths[t], patterns, lengths);
+    DPU_ASSERT(dpu_match_compile(NR_PATTERNS, (const uint8_t *const *)patterns, lengths, &automaton, &size));
+    DPU_ASSERT(dpu_match_load(set, text, length, MAX_PATTERN_LENGTH - 1, MAX_DPU_MATCHES, &loaded));
+
+    start = now();
+    nr_expected = dpu_match_reference(automaton, text, length, NULL, 0);
+    host_time = now() - start;
+    struct dpu_match *matches = malloc((nr_expected + 1) * sizeof(*matches));
+    struct dpu_match *expected = malloc((nr_expected + 1) * sizeof(*expected));
+    dpu_match_reference(automaton, text, length, expected, nr_expected);
+
+    start = now();
+    for (uint32_t r = 0; r < NR_REPETITIONS; r++)
+      DPU_ASSERT(dpu_match_search(&loaded, automaton, size, matches, nr_expected, &nr_matches));
+    dpu_time = (now() - start) / NR_REPETITIONS;
+
+    if (nr_matches != nr_expected) {
+      printf("%s: %lu matches instead of %lu\n", names[t], (unsigned long)nr_matches, (unsigned long)nr_expected);
+      errors++;
+    } else {
+      for (uint64_t i = 0; i < nr_matches; i++) {
+        if (matches[i].end != expected[i].end || matches[i].pattern != expected[i].pattern) {
+          printf("%s: wrong match %lu: pattern %u ending at %lu instead of pattern %u ending at %lu\n", names[t],
+              (unsigned long)i, matches[i].pattern, (unsigned long)matches[i].end, expected[i].pattern,
+              (unsigned long)expected[i].end);
+          errors++;
+          break;
+        }
+      }
+    }
+    printf("%6s %9u %8u %10lu %10.3f %10.2f %10.2f\n", names[t], size,
+        ((const struct dpu_match_automaton *)automaton)->nr_states, (unsigned long)nr_matches, dpu_time * 1e3,
+        length / dpu_time / 1e9, length / host_time / 1e9);
+
+    dpu_match_free(&loaded);
+    for (uint32_t p = 0; p < NR_PATTERNS; p++)
+      free(patterns[p]);
+    free(automaton);
+    free(matches);
+    free(expected);
+  }
+
+  free(text);
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
@@ -0,0 +1,61 @@
+/* MRAM histogram built with mram_update_int_atomic (one locked DMA */
+/* read-modify-write per element) or with an update combiner. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_combiner.h>
+#include <mram_unaligned.h>
+#include <perfcounter.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BUFFER_SIZE (1 << 16)
+#define NR_BINS 4096
+#define CACHE_SIZE 256
+#define NR_ELEMENTS_PER_TASKLET (BUFFER_SIZE / NR_TASKLETS)
+
+__mram_noinit uint32_t buffer[BUFFER_SIZE];
+__mram_noinit int32_t histogram[NR_BINS];
+__host uint32_t use_combiner;
+__host uint32_t nr_bins;
+__host uint64_t cycles;
+
+__dma_aligned uint32_t cache[NR_TASKLETS][CACHE_SIZE];
+__dma_aligned int32_t zeros[256];
+
+MRAM_COMBINER_INIT(combiner, MRAM_COMBINER_ADD);
+BARRIER_INIT(cleared, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+static void increment(int *value, void *args) {
+  (void)args;
+  (*value)++;
+}
+
+int main() {
+  if (me() == 0) {
+    for (uint32_t i = 0; i < NR_BINS; i += 256)
+      mram_write(zeros, &histogram[i], sizeof(zeros));
+    perfcounter_config(COUNT_CYCLES, true);
+  }
+  barrier_wait(&cleared);
+
+  for (uint32_t i = me() * NR_ELEMENTS_PER_TASKLET; i < (me() + 1) * NR_ELEMENTS_PER_TASKLET; i += CACHE_SIZE) {
+    mram_read(&buffer[i], cache[me()], sizeof(cache[me()]));
+    for (uint32_t j = 0; j < CACHE_SIZE; j++) {
+      uint32_t bin = cache[me()][j] & (nr_bins - 1);
+      if (use_combiner)
+        mram_combiner_update(&combiner, &histogram[bin], 1);
+      else
+        mram_update_int_atomic(&histogram[bin], increment, NULL);
+    }
+  }
+  if (use_combiner)
+    mram_combiner_flush(&combiner);
+  barrier_wait(&done);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
@@ -0,0 +1,61 @@
+/* Compares the MRAM histogram built with mram_update_int_atomic and */
+/* with the update combiner, for several numbers of bins. */
+
+#include <dpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./histogram"
+#endif
+
+#define BUFFER_SIZE (1 << 16)
+#define NR_BINS 4096
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t *buffer = malloc(BUFFER_SIZE * sizeof(uint32_t));
+  int32_t histogram[NR_BINS], expected[NR_BINS];
+  uint64_t cycles[2];
+  int errors = 0;
+
+  srand(0);
+  for (int i = 0; i < BUFFER_SIZE; i++)
+    buffer[i] = rand();
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_copy_to(set, "buffer", 0, buffer, BUFFER_SIZE * sizeof(uint32_t)));
+
+  for (uint32_t nr_bins = 16; nr_bins <= NR_BINS; nr_bins <<= 2) {
+    memset(expected, 0, sizeof(expected));
+    for (int i = 0; i < BUFFER_SIZE; i++)
+      expected[buffer[i] & (nr_bins - 1)]++;
+
+    DPU_ASSERT(dpu_copy_to(set, "nr_bins", 0, &nr_bins, sizeof(nr_bins)));
+    for (uint32_t use_combiner = 0; use_combiner < 2; use_combiner++) {
+      DPU_ASSERT(dpu_copy_to(set, "use_combiner", 0, &use_combiner, sizeof(use_combiner)));
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      DPU_FOREACH(set, dpu) {
+        DPU_ASSERT(dpu_copy_from(dpu, "cycles", 0, &cycles[use_combiner], sizeof(uint64_t)));
+        DPU_ASSERT(dpu_copy_from(dpu, "histogram", 0, histogram, sizeof(histogram)));
+      }
+      for (uint32_t b = 0; b < nr_bins; b++) {
+        if (histogram[b] != expected[b]) {
+          if (errors < 10)
+            printf("wrong bin %u of %u (combiner: %u): %d instead of %d\n", b, nr_bins, use_combiner, histogram[b],
+                expected[b]);
+          errors++;
+        }
+      }
+    }
+    printf("%5u bins: atomic %10lu cycles, combiner %10lu cycles (x%.2f)\n", nr_bins, (unsigned long)cycles[0],
+        (unsigned long)cycles[1], (double)cycles[0] / (double)cycles[1]);
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(buffer);
+  return errors != 0;
+}
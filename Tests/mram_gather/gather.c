@@ -0,0 +1,75 @@
+/* Random lookups into an MRAM table, either one 8-byte mram_read per */
+/* index or in batches with mram_gather. */
+
+#define MRAM_GATHER_WINDOW_SIZE 1024
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_gather.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define TABLE_SIZE (1 << 20)
+#define NR_LOOKUPS (1 << 16)
+#define BATCH_SIZE 128
+#define NR_LOOKUPS_PER_TASKLET (NR_LOOKUPS / NR_TASKLETS)
+
+__mram_noinit uint32_t table[TABLE_SIZE];
+__mram_noinit uint32_t lookups[NR_LOOKUPS];
+__host uint32_t use_gather;
+__host uint32_t sum;
+__host uint32_t nr_dmas;
+__host uint64_t cycles;
+
+uint32_t sums[NR_TASKLETS];
+uint32_t dmas[NR_TASKLETS];
+__dma_aligned uint32_t indices[NR_TASKLETS][BATCH_SIZE];
+__dma_aligned uint32_t values[NR_TASKLETS][BATCH_SIZE];
+__dma_aligned uint8_t windows[NR_TASKLETS][MRAM_GATHER_WINDOW_SIZE];
+uint16_t orders[NR_TASKLETS][BATCH_SIZE];
+
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+static void lookup_naive(uint32_t *idx, uint32_t *out) {
+  __dma_aligned uint32_t line[2];
+  for (uint32_t i = 0; i < BATCH_SIZE; i++) {
+    mram_read(&table[idx[i] & ~1], line, sizeof(line));
+    out[i] = line[idx[i] & 1];
+  }
+  dmas[me()] += BATCH_SIZE;
+}
+
+int main() {
+  uint32_t *idx = indices[me()];
+  uint32_t *out = values[me()];
+
+  sums[me()] = 0;
+  dmas[me()] = 0;
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  for (uint32_t i = me() * NR_LOOKUPS_PER_TASKLET; i < (me() + 1) * NR_LOOKUPS_PER_TASKLET; i += BATCH_SIZE) {
+    mram_read(&lookups[i], idx, BATCH_SIZE * sizeof(uint32_t));
+    if (use_gather)
+      dmas[me()] += mram_gather(table, sizeof(uint32_t), idx, BATCH_SIZE, out, orders[me()], windows[me()]);
+    else
+      lookup_naive(idx, out);
+    for (uint32_t j = 0; j < BATCH_SIZE; j++)
+      sums[me()] += out[j];
+  }
+  barrier_wait(&done);
+
+  if (me() == 0) {
+    cycles = perfcounter_get();
+    sum = 0;
+    nr_dmas = 0;
+    for (int t = 0; t < NR_TASKLETS; t++) {
+      sum += sums[t];
+      nr_dmas += dmas[t];
+    }
+  }
+  return 0;
+}
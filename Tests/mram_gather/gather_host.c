@@ -0,0 +1,62 @@
+/* Benchmarks mram_gather against one mram_read per lookup, for index */
+/* densities going from a dense range to the whole table. */
+
+#include <dpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./gather"
+#endif
+
+#define TABLE_SIZE (1 << 20)
+#define NR_LOOKUPS (1 << 16)
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t *table = malloc(TABLE_SIZE * sizeof(uint32_t));
+  uint32_t *lookups = malloc(NR_LOOKUPS * sizeof(uint32_t));
+  uint32_t sum, nr_dmas;
+  uint64_t cycles;
+  int errors = 0;
+
+  srand(0);
+  for (int i = 0; i < TABLE_SIZE; i++)
+    table[i] = rand();
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_copy_to(set, "table", 0, table, TABLE_SIZE * sizeof(uint32_t)));
+
+  printf("%10s %8s %12s %10s %12s\n", "range", "mode", "cycles", "dmas", "cycles/idx");
+  for (uint32_t range = 1 << 10; range <= TABLE_SIZE; range <<= 2) {
+    uint32_t expected = 0;
+    for (int i = 0; i < NR_LOOKUPS; i++) {
+      lookups[i] = (uint32_t)rand() % range;
+      expected += table[lookups[i]];
+    }
+    DPU_ASSERT(dpu_copy_to(set, "lookups", 0, lookups, NR_LOOKUPS * sizeof(uint32_t)));
+
+    for (uint32_t use_gather = 0; use_gather < 2; use_gather++) {
+      DPU_ASSERT(dpu_copy_to(set, "use_gather", 0, &use_gather, sizeof(use_gather)));
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      DPU_FOREACH(set, dpu) {
+        DPU_ASSERT(dpu_copy_from(dpu, "sum", 0, &sum, sizeof(sum)));
+        DPU_ASSERT(dpu_copy_from(dpu, "nr_dmas", 0, &nr_dmas, sizeof(nr_dmas)));
+        DPU_ASSERT(dpu_copy_from(dpu, "cycles", 0, &cycles, sizeof(cycles)));
+      }
+      if (sum != expected) {
+        printf("wrong sum for range %u (gather: %u)\n", range, use_gather);
+        errors++;
+      }
+      printf("%10u %8s %12lu %10u %12.1f\n", range, use_gather ? "gather" : "naive", (unsigned long)cycles, nr_dmas,
+          (double)cycles / NR_LOOKUPS);
+    }
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(lookups);
+  free(table);
+  return errors != 0;
+}
@@ -0,0 +1,90 @@
+/* Probes a hash table built by the host in MRAM, one lookup at a time or */
+/* in batches, or builds the table on the DPU with concurrent insertions. */
+
+#define MRAM_GATHER_WINDOW_SIZE 256
+#define MRAM_STRING_BUFFER_SIZE 256
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_hash.h>
+#include <mram_string.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_TABLE_SIZE (8 << 20)
+#define MAX_KEYS (1 << 20)
+#define BATCH_SIZE 16
+
+#define MODE_LOOKUP 0
+#define MODE_LOOKUP_BATCH 1
+#define MODE_INSERT 2
+
+__mram_noinit uint8_t table[MAX_TABLE_SIZE];
+__mram_noinit uint32_t keys[MAX_KEYS];
+__host uint32_t mode;
+__host uint32_t nr_buckets;
+__host uint32_t nr_keys;
+__host uint32_t nr_found;
+__host uint32_t checksum;
+__host uint64_t cycles;
+
+uint32_t found_per_tasklet[NR_TASKLETS];
+uint32_t checksum_per_tasklet[NR_TASKLETS];
+__dma_aligned uint32_t batch_keys[NR_TASKLETS][BATCH_SIZE];
+uint32_t batch_values[NR_TASKLETS][BATCH_SIZE];
+bool batch_found[NR_TASKLETS][BATCH_SIZE];
+__dma_aligned uint8_t buffers[NR_TASKLETS][MRAM_STRING_BUFFER_SIZE];
+
+MRAM_HASH_INIT(hash_table, 64);
+MRAM_HASH_BATCH_INIT(batch, BATCH_SIZE);
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+int main() {
+  uint32_t *k = batch_keys[me()];
+  uint32_t *v = batch_values[me()];
+  bool *f = batch_found[me()];
+  uint32_t found = 0, sum = 0;
+
+  mram_hash_attach(&hash_table, table, nr_buckets);
+  if (mode == MODE_INSERT)
+    mram_memset_parallel(table, 0xff, nr_buckets * MRAM_HASH_BUCKET_SIZE, buffers[me()]);
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  for (uint32_t i = me() * BATCH_SIZE; i < nr_keys; i += NR_TASKLETS * BATCH_SIZE) {
+    uint32_t n = nr_keys - i < BATCH_SIZE ? nr_keys - i : BATCH_SIZE;
+    mram_read(&keys[i], k, BATCH_SIZE * sizeof(uint32_t));
+    if (mode == MODE_LOOKUP_BATCH) {
+      found += mram_hash_lookup_batch(&hash_table, &batch, k, n, v, f);
+      for (uint32_t j = 0; j < n; j++)
+        sum += f[j] ? v[j] : 0;
+    } else {
+      for (uint32_t j = 0; j < n; j++) {
+        uint32_t value;
+        if (mode == MODE_INSERT) {
+          found += mram_hash_insert(&hash_table, k[j], i + j) != MRAM_HASH_FULL;
+        } else if (mram_hash_lookup(&hash_table, k[j], &value)) {
+          found++;
+          sum += value;
+        }
+      }
+    }
+  }
+  found_per_tasklet[me()] = found;
+  checksum_per_tasklet[me()] = sum;
+  barrier_wait(&done);
+
+  if (me() == 0) {
+    cycles = perfcounter_get();
+    nr_found = 0;
+    checksum = 0;
+    for (int t = 0; t < NR_TASKLETS; t++) {
+      nr_found += found_per_tasklet[t];
+      checksum += checksum_per_tasklet[t];
+    }
+  }
+  return 0;
+}
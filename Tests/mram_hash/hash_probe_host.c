@@ -0,0 +1,102 @@
+/* Builds a hash table on the host, loads it into the DPU and measures the */
+/* lookups (one by one and in batches) and the insertions on the DPU. */
+
+#include <dpu.h>
+#include <dpu_hash_table.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./hash_probe"
+#endif
+
+#define MAX_KEYS (1 << 20)
+#define BUCKET_SIZE 64
+#define MAX_LOAD_PERCENT 70
+
+#define MODE_LOOKUP 0
+#define MODE_LOOKUP_BATCH 1
+#define MODE_INSERT 2
+
+static const char *mode_names[] = { "lookup", "batch", "insert" };
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t *keys = malloc(MAX_KEYS * sizeof(uint32_t));
+  uint32_t *values = malloc(MAX_KEYS * sizeof(uint32_t));
+  uint32_t *probes = malloc(MAX_KEYS * sizeof(uint32_t));
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  printf("%8s %8s %8s %12s %10s\n", "keys", "buckets", "mode", "cycles", "cycles/key");
+  for (uint32_t nr_keys = 1 << 10; nr_keys <= MAX_KEYS / 2; nr_keys <<= 3) {
+    uint32_t nr_buckets = dpu_hash_nr_buckets(nr_keys, MAX_LOAD_PERCENT, BUCKET_SIZE);
+    uint8_t *table = malloc((size_t)nr_buckets * BUCKET_SIZE);
+    uint32_t expected_found = 0, expected_checksum = 0;
+
+    /* Distinct keys, and probes hitting the table half of the time. */
+    for (uint32_t i = 0; i < nr_keys; i++) {
+      keys[i] = i * 2654435761u;
+      values[i] = rand();
+    }
+    for (uint32_t i = 0; i < nr_keys; i++)
+      probes[i] = rand() & 1 ? keys[rand() % nr_keys] : (uint32_t)rand() * 2654435761u + 1;
+    DPU_ASSERT(dpu_hash_build(table, nr_buckets, BUCKET_SIZE, keys, values, nr_keys));
+    for (uint32_t i = 0; i < nr_keys; i++) {
+      uint32_t value;
+      if (dpu_hash_lookup(table, nr_buckets, BUCKET_SIZE, probes[i], &value)) {
+        expected_found++;
+        expected_checksum += value;
+      }
+    }
+
+    DPU_ASSERT(dpu_copy_to(set, "nr_buckets", 0, &nr_buckets, sizeof(nr_buckets)));
+    DPU_ASSERT(dpu_copy_to(set, "nr_keys", 0, &nr_keys, sizeof(nr_keys)));
+    for (uint32_t mode = MODE_LOOKUP; mode <= MODE_INSERT; mode++) {
+      uint32_t nr_found, checksum;
+      uint64_t cycles;
+
+      if (mode == MODE_INSERT) {
+        DPU_ASSERT(dpu_copy_to(set, "keys", 0, keys, nr_keys * sizeof(uint32_t)));
+      } else {
+        DPU_ASSERT(dpu_copy_to(set, "table", 0, table, (size_t)nr_buckets * BUCKET_SIZE));
+        DPU_ASSERT(dpu_copy_to(set, "keys", 0, probes, nr_keys * sizeof(uint32_t)));
+      }
+      DPU_ASSERT(dpu_copy_to(set, "mode", 0, &mode, sizeof(mode)));
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      DPU_FOREACH(set, dpu) {
+        DPU_ASSERT(dpu_copy_from(dpu, "nr_found", 0, &nr_found, sizeof(nr_found)));
+        DPU_ASSERT(dpu_copy_from(dpu, "checksum", 0, &checksum, sizeof(checksum)));
+        DPU_ASSERT(dpu_copy_from(dpu, "cycles", 0, &cycles, sizeof(cycles)));
+        if (mode == MODE_INSERT ? nr_found != nr_keys : nr_found != expected_found || checksum != expected_checksum) {
+          printf("wrong result for %u keys (%s)\n", nr_keys, mode_names[mode]);
+          errors++;
+        }
+        /* Each key inserted by the DPU, with its index as value. */
+        if (mode == MODE_INSERT) {
+          DPU_ASSERT(dpu_copy_from(dpu, "table", 0, table, (size_t)nr_buckets * BUCKET_SIZE));
+          for (uint32_t i = 0; i < nr_keys; i++) {
+            uint32_t value;
+            if (!dpu_hash_lookup(table, nr_buckets, BUCKET_SIZE, keys[i], &value) || value != i) {
+              printf("key %u missing or wrong in the table built by the DPU for %u keys\n", i, nr_keys);
+              errors++;
+              break;
+            }
+          }
+        }
+      }
+      printf("%8u %8u %8s %12lu %10.1f\n", nr_keys, nr_buckets, mode_names[mode], (unsigned long)cycles,
+          (double)cycles / nr_keys);
+    }
+    free(table);
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(probes);
+  free(values);
+  free(keys);
+  return errors != 0;
+}
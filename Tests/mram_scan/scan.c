@@ -0,0 +1,49 @@
+/* Filters the rows of a table of three columns with the predicate sent by */
+/* the host, as a bitmap or as a list of row indices. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_scan.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_ROWS (1 << 20)
+#define NR_COLUMNS 3
+
+#define MODE_BITMAP 0
+#define MODE_ROW_IDS 1
+
+__mram_noinit int32_t column_0[MAX_ROWS];
+__mram_noinit int32_t column_1[MAX_ROWS];
+__mram_noinit int32_t column_2[MAX_ROWS];
+__mram_noinit uint8_t bitmap[MRAM_SCAN_BITMAP_SIZE(MAX_ROWS)];
+__mram_noinit uint32_t row_ids[MAX_ROWS];
+__host struct mram_scan_program program;
+__host uint32_t mode;
+__host uint32_t nr_rows;
+__host uint32_t nr_selected;
+__host uint64_t cycles;
+
+const __mram_ptr int32_t *const columns[NR_COLUMNS] = { column_0, column_1, column_2 };
+
+MRAM_SCAN_INIT(scan);
+BARRIER_INIT(done, NR_TASKLETS);
+
+int main() {
+  uint32_t selected;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  if (mode == MODE_ROW_IDS)
+    selected = mram_scan_row_ids(&scan, &program, columns, nr_rows, bitmap, row_ids);
+  else
+    selected = mram_scan_bitmap(&scan, &program, columns, nr_rows, bitmap);
+
+  barrier_wait(&done);
+  if (me() == 0) {
+    cycles = perfcounter_get();
+    nr_selected = selected;
+  }
+  return 0;
+}
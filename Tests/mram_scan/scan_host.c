@@ -0,0 +1,158 @@
+/* Filters a table spread across the DPUs with predicates of increasing */
+/* complexity, as bitmaps and as row indices read back with a transfer */
+/* sized by the selectivity of each DPU, and checks the selected rows, and */
+/* every bit of the bitmap of each DPU. */
+
+#include <dpu.h>
+#include <dpu_scan.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./scan"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 16
+#endif
+
+#define ROWS_PER_DPU (1 << 20)
+#define NR_COLUMNS 3
+#define BITMAP_SIZE (ROWS_PER_DPU / 8)
+
+#define MODE_BITMAP 0
+#define MODE_ROW_IDS 1
+
+static const int32_t odd_categories[] = { 1, 3, 5, 7 };
+
+/* c0 < 10 */
+static const struct dpu_scan_predicate lt = { .opcode = DPU_SCAN_LT, .column = 0, .a = 10 };
+/* c0 BETWEEN 100 AND 599 */
+static const struct dpu_scan_predicate between = { .opcode = DPU_SCAN_BETWEEN, .column = 0, .a = 100, .b = 599 };
+/* c1 IN (1, 3, 5, 7) AND c0 >= 900 */
+static const struct dpu_scan_predicate in = { .opcode = DPU_SCAN_IN, .column = 1, .values = odd_categories, .nr_values = 4 };
+static const struct dpu_scan_predicate ge = { .opcode = DPU_SCAN_GE, .column = 0, .a = 900 };
+static const struct dpu_scan_predicate in_and_ge = { .opcode = DPU_SCAN_AND, .left = &in, .right = &ge };
+/* (c0 < 50 OR c2 > 0) AND NOT c1 = 0 */
+static const struct dpu_scan_predicate lt50 = { .opcode = DPU_SCAN_LT, .column = 0, .a = 50 };
+static const struct dpu_scan_predicate positive = { .opcode = DPU_SCAN_GT, .column = 2, .a = 0 };
+static const struct dpu_scan_predicate either = { .opcode = DPU_SCAN_OR, .left = &lt50, .right = &positive };
+static const struct dpu_scan_predicate zero = { .opcode = DPU_SCAN_EQ, .column = 1, .a = 0 };
+static const struct dpu_scan_predicate not_zero = { .opcode = DPU_SCAN_NOT, .left = &zero };
+static const struct dpu_scan_predicate complex = { .opcode = DPU_SCAN_AND, .left = &either, .right = &not_zero };
+
+static const struct {
+  const char *name;
+  const struct dpu_scan_predicate *predicate;
+} predicates[] = {
+  { "c0 < 10", &lt },
+  { "c0 between 100 and 599", &between },
+  { "c1 in (1,3,5,7) and c0 >= 900", &in_and_ge },
+  { "(c0 < 50 or c2 > 0) and not c1 = 0", &complex },
+};
+
+int main() {
+  struct dpu_set_t set, dpu;
+  uint32_t each_dpu, nr_rows = ROWS_PER_DPU;
+  int32_t *columns[NR_DPUS][NR_COLUMNS];
+  uint32_t nr_selected[NR_DPUS];
+  uint64_t cycles[NR_DPUS], offsets[NR_DPUS + 1] = { 0 };
+  uint32_t *row_ids = malloc((size_t)NR_DPUS * ROWS_PER_DPU * sizeof(uint32_t));
+  uint8_t *bitmaps = malloc((size_t)NR_DPUS * BITMAP_SIZE);
+  int errors = 0;
+
+  srand(0);
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    for (uint32_t c = 0; c < NR_COLUMNS; c++)
+      columns[each_dpu][c] = malloc(ROWS_PER_DPU * sizeof(int32_t));
+    for (uint32_t i = 0; i < ROWS_PER_DPU; i++) {
+      columns[each_dpu][0][i] = rand() % 1000;
+      columns[each_dpu][1][i] = rand() % 25;
+      columns[each_dpu][2][i] = rand() - RAND_MAX / 2;
+    }
+  }
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_rows", 0, &nr_rows, sizeof(nr_rows), DPU_XFER_DEFAULT));
+  for (uint32_t c = 0; c < NR_COLUMNS; c++) {
+    char symbol[16];
+    sprintf(symbol, "column_%u", c);
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, columns[each_dpu][c]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, symbol, 0, ROWS_PER_DPU * sizeof(int32_t), DPU_XFER_DEFAULT));
+  }
+
+  printf("%-36s %8s %10s %12s %10s\n", "predicate", "mode", "selected", "cycles", "cycles/row");
+  for (uint32_t p = 0; p < sizeof(predicates) / sizeof(predicates[0]); p++) {
+    struct dpu_scan_program program;
+    DPU_ASSERT(dpu_scan_compile(predicates[p].predicate, &program));
+    DPU_ASSERT(dpu_broadcast_to(set, "program", 0, &program, sizeof(program), DPU_XFER_DEFAULT));
+
+    for (uint32_t mode = MODE_BITMAP; mode <= MODE_ROW_IDS; mode++) {
+      uint64_t total = 0, max_cycles = 0;
+
+      DPU_ASSERT(dpu_broadcast_to(set, "mode", 0, &mode, sizeof(mode), DPU_XFER_DEFAULT));
+      DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+      DPU_FOREACH(set, dpu, each_dpu) {
+        DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_selected[each_dpu]));
+      }
+      DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "nr_selected", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+      DPU_FOREACH(set, dpu, each_dpu) {
+        DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+      }
+      DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+      DPU_FOREACH(set, dpu, each_dpu) {
+        DPU_ASSERT(dpu_prepare_xfer(dpu, &bitmaps[(size_t)each_dpu * BITMAP_SIZE]));
+      }
+      DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "bitmap", 0, BITMAP_SIZE, DPU_XFER_DEFAULT));
+      if (mode == MODE_ROW_IDS) {
+        size_t max_length = dpu_scan_row_id_offsets(nr_selected, NR_DPUS, offsets);
+        DPU_ASSERT(dpu_scan_pull_row_ids(set, "row_ids", row_ids, offsets, max_length));
+      }
+
+      for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+        const uint32_t *ids = row_ids + offsets[each_dpu] / sizeof(uint32_t);
+        const uint8_t *bitmap = &bitmaps[(size_t)each_dpu * BITMAP_SIZE];
+        uint32_t expected = 0;
+        int wrong_bit = 0;
+
+        for (uint32_t i = 0; i < ROWS_PER_DPU; i++) {
+          int selected = dpu_scan_evaluate(&program, (const int32_t *const *)columns[each_dpu], i);
+          if (!wrong_bit && ((bitmap[i / 8] >> (i % 8)) & 1) != (selected != 0)) {
+            printf("wrong bit %u of the bitmap on DPU %u\n", i, each_dpu);
+            errors++;
+            wrong_bit = 1;
+          }
+          if (!selected)
+            continue;
+          if (mode == MODE_ROW_IDS && (expected >= nr_selected[each_dpu] || ids[expected] != i)) {
+            printf("wrong row index %u on DPU %u\n", expected, each_dpu);
+            errors++;
+            break;
+          }
+          expected++;
+        }
+        if (expected != nr_selected[each_dpu]) {
+          printf("wrong number of rows on DPU %u: %u instead of %u\n", each_dpu, nr_selected[each_dpu], expected);
+          errors++;
+        }
+        total += nr_selected[each_dpu];
+        if (cycles[each_dpu] > max_cycles)
+          max_cycles = cycles[each_dpu];
+      }
+      printf("%-36s %8s %10lu %12lu %10.2f\n", predicates[p].name, mode == MODE_ROW_IDS ? "row ids" : "bitmap",
+          (unsigned long)total, (unsigned long)max_cycles, (double)max_cycles / ROWS_PER_DPU);
+    }
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+    for (uint32_t c = 0; c < NR_COLUMNS; c++)
+      free(columns[each_dpu][c]);
+  free(row_ids);
+  free(bitmaps);
+  return errors != 0;
+}
@@ -0,0 +1,100 @@
+/* Partitions the 32-bit keys held by the DPU by a hash of the key: each */
+/* tasklet counts the keys of its range in each partition, tasklet 0 scans */
+/* the counts into the offset of each tasklet in each partition, then each */
+/* tasklet writes its keys to their partitions, through the staging lines */
+/* of mram_scatter or with one mram_write_unaligned per key. The partitions */
+/* are 4-byte aligned, so their first and last words are shared. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_scatter.h>
+#include <mram_unaligned.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define MAX_KEYS (1 << 20)
+#define BLOCK 128
+#define PARTITION_BITS 6
+#define NR_PARTITIONS (1 << PARTITION_BITS)
+#define LINE_SIZE 16
+
+enum { SCATTER, DIRECT };
+
+__mram_noinit uint32_t keys[MAX_KEYS];
+__mram_noinit uint32_t partitions[MAX_KEYS];
+__host uint32_t nr_keys;
+__host uint32_t mode;
+__host uint64_t cycles;
+
+__dma_aligned uint32_t blocks[NR_TASKLETS][BLOCK];
+uint32_t offsets[NR_TASKLETS][NR_PARTITIONS];
+
+MRAM_SCATTER_INIT(scatter, NR_PARTITIONS, LINE_SIZE);
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(counted, NR_TASKLETS);
+BARRIER_INIT(scanned, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+static uint32_t partition_of(uint32_t key) {
+  return (key * 2654435761u) >> (32 - PARTITION_BITS);
+}
+
+int main() {
+  uint32_t keys_per_tasklet = (nr_keys + NR_TASKLETS * BLOCK - 1) / (NR_TASKLETS * BLOCK) * BLOCK;
+  uint32_t first = me() * keys_per_tasklet, last = first + keys_per_tasklet;
+  uint32_t *block = blocks[me()], *offset = offsets[me()];
+  mram_scatter_writer_t writer = mram_scatter_writer(&scatter);
+
+  first = first < nr_keys ? first : nr_keys;
+  last = last < nr_keys ? last : nr_keys;
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  for (uint32_t p = 0; p < NR_PARTITIONS; p++)
+    offset[p] = 0;
+  for (uint32_t base = first; base < last; base += BLOCK) {
+    uint32_t n = last - base < BLOCK ? last - base : BLOCK;
+    mram_read(&keys[base], block, BLOCK * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++)
+      offset[partition_of(block[i])]++;
+  }
+  barrier_wait(&counted);
+
+  /* The partitions one after the other, and the ranges of the tasklets in order in each partition. */
+  if (me() == 0) {
+    uint32_t sum = 0;
+    for (uint32_t p = 0; p < NR_PARTITIONS; p++) {
+      for (uint32_t t = 0; t < NR_TASKLETS; t++) {
+        uint32_t count = offsets[t][p];
+        offsets[t][p] = sum;
+        sum += count;
+      }
+    }
+  }
+  barrier_wait(&scanned);
+
+  if (mode == SCATTER) {
+    for (uint32_t p = 0; p < NR_PARTITIONS; p++)
+      mram_scatter_set_destination(&writer, p, &partitions[offset[p]]);
+  }
+  for (uint32_t base = first; base < last; base += BLOCK) {
+    uint32_t n = last - base < BLOCK ? last - base : BLOCK;
+    mram_read(&keys[base], block, BLOCK * sizeof(uint32_t));
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t p = partition_of(block[i]);
+      if (mode == SCATTER)
+        mram_scatter_push(&writer, p, &block[i], sizeof(uint32_t));
+      else
+        mram_write_unaligned(&block[i], &partitions[offset[p]++], sizeof(uint32_t));
+    }
+  }
+  if (mode == SCATTER)
+    mram_scatter_flush(&writer);
+
+  barrier_wait(&done);
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
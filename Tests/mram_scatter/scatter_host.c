@@ -0,0 +1,108 @@
+/* Partitions random 32-bit keys on each DPU, with mram_scatter and with one */
+/* mram_write_unaligned per key. Checks the partitions of every DPU byte */
+/* for byte against a stable partition of the same keys on the host, and */
+/* reports the cycles and the bytes written per cycle of both. */
+
+#include <dpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./scatter"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+/* Not a multiple of the blocks of the tasklets, nor of 8 bytes. */
+#ifndef KEYS_PER_DPU
+#define KEYS_PER_DPU ((1 << 20) - 13)
+#endif
+
+/* The MRAM transfers are multiples of 8 bytes: they move an even number of keys, the DPU being given the odd count. */
+#define TRANSFERRED_KEYS ((KEYS_PER_DPU + 1) & ~1)
+
+/* PARTITION_BITS of the DPU program. */
+#define PARTITION_BITS 6
+#define NR_PARTITIONS (1 << PARTITION_BITS)
+
+enum { SCATTER, DIRECT };
+
+static const char *const mode_names[] = { "scatter", "direct" };
+
+static uint32_t keys[TRANSFERRED_KEYS], expected[TRANSFERRED_KEYS], partitions[TRANSFERRED_KEYS];
+
+static uint32_t partition_of(uint32_t key) {
+  return (key * 2654435761u) >> (32 - PARTITION_BITS);
+}
+
+/* The keys of a DPU, different on each DPU, with many duplicates. */
+static void generate_keys(uint32_t dpu_index) {
+  srand(dpu_index + 1);
+  for (uint32_t i = 0; i < KEYS_PER_DPU; i++)
+    keys[i] = (uint32_t)rand() % (KEYS_PER_DPU / 4) ^ dpu_index << 24;
+}
+
+/* The keys of the DPU partitioned on the host: the partitions in order, the keys in their order in each partition. */
+static void partition(void) {
+  uint32_t offsets[NR_PARTITIONS + 1] = { 0 };
+
+  for (uint32_t i = 0; i < KEYS_PER_DPU; i++)
+    offsets[partition_of(keys[i]) + 1]++;
+  for (uint32_t p = 0; p < NR_PARTITIONS; p++)
+    offsets[p + 1] += offsets[p];
+  for (uint32_t i = 0; i < KEYS_PER_DPU; i++)
+    expected[offsets[partition_of(keys[i])]++] = keys[i];
+}
+
+int main() {
+  uint32_t nr_keys = KEYS_PER_DPU, each_dpu;
+  struct dpu_set_t set, dpu;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_keys", 0, &nr_keys, sizeof(nr_keys), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    generate_keys(each_dpu);
+    DPU_ASSERT(dpu_copy_to(dpu, "keys", 0, keys, sizeof(keys)));
+  }
+
+  printf("%8s %14s %14s\n", "mode", "cycles", "bytes/cycle");
+  for (uint32_t mode = SCATTER; mode <= DIRECT; mode++) {
+    uint64_t cycles, max_cycles = 0;
+
+    /* Nothing left by the previous mode can be taken for the partitions of this one. */
+    memset(partitions, 0, sizeof(partitions));
+    DPU_ASSERT(dpu_broadcast_to(set, "partitions", 0, partitions, sizeof(partitions), DPU_XFER_DEFAULT));
+    DPU_ASSERT(dpu_broadcast_to(set, "mode", 0, &mode, sizeof(mode), DPU_XFER_DEFAULT));
+    DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+
+    DPU_FOREACH(set, dpu, each_dpu) {
+      generate_keys(each_dpu);
+      partition();
+      DPU_ASSERT(dpu_copy_from(dpu, "partitions", 0, partitions, sizeof(partitions)));
+      if (memcmp(partitions, expected, KEYS_PER_DPU * sizeof(uint32_t)) != 0) {
+        for (uint32_t i = 0; i < KEYS_PER_DPU; i++) {
+          if (partitions[i] != expected[i]) {
+            if (errors < 10)
+              printf("%s: DPU %u, key %u is 0x%08x instead of 0x%08x\n", mode_names[mode], each_dpu, i, partitions[i],
+                  expected[i]);
+            errors++;
+            break;
+          }
+        }
+      }
+      DPU_ASSERT(dpu_copy_from(dpu, "cycles", 0, &cycles, sizeof(cycles)));
+      max_cycles = cycles > max_cycles ? cycles : max_cycles;
+    }
+    printf("%8s %14lu %14.3f\n", mode_names[mode], (unsigned long)max_cycles,
+        (double)KEYS_PER_DPU * sizeof(uint32_t) / max_cycles);
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
@@ -0,0 +1,55 @@
+/* MRAM to MRAM copy, move and set of any size and alignment with */
+/* mram_string.h, on one tasklet or split between all the tasklets. */
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_string.h>
+#include <perfcounter.h>
+#include <stdint.h>
+
+#define OP_MEMCPY 0
+#define OP_MEMMOVE 1
+#define OP_MEMSET 2
+
+__host uint32_t op;
+__host uint32_t dest_offset;
+__host uint32_t src_offset;
+__host uint32_t size;
+__host uint32_t parallel;
+__host uint64_t cycles;
+
+__dma_aligned uint8_t buffers[NR_TASKLETS][MRAM_STRING_BUFFER_SIZE];
+
+BARRIER_INIT(start, NR_TASKLETS);
+BARRIER_INIT(done, NR_TASKLETS);
+
+int main() {
+  __mram_ptr uint8_t *heap = (__mram_ptr uint8_t *)DPU_MRAM_HEAP_POINTER;
+  __mram_ptr void *dest = heap + dest_offset;
+  __mram_ptr void *src = heap + src_offset;
+  uint8_t *buffer = buffers[me()];
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  barrier_wait(&start);
+
+  if (parallel) {
+    if (op == OP_MEMSET)
+      mram_memset_parallel(dest, 0xa5, size, buffer);
+    else
+      mram_memcpy_parallel(dest, src, size, buffer);
+  } else if (me() == 0) {
+    if (op == OP_MEMCPY)
+      mram_memcpy(dest, src, size, buffer);
+    else if (op == OP_MEMMOVE)
+      mram_memmove(dest, src, size, buffer);
+    else
+      mram_memset(dest, 0xa5, size, buffer);
+  }
+  barrier_wait(&done);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
@@ -0,0 +1,121 @@
+/* Benchmarks mram_memcpy, mram_memmove and mram_memset from 8 B to 32 MB, */
+/* aligned and unaligned, and checks the result of the smaller operations. */
+
+#include <dpu.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./mram_string"
+#endif
+
+#define OP_MEMCPY 0
+#define OP_MEMMOVE 1
+#define OP_MEMSET 2
+
+#define MAX_SIZE (32 << 20)
+#define MAX_CHECKED_SIZE (1 << 20)
+/* Bytes around the destination that are checked to be left untouched. */
+#define GUARD 64
+
+static const char *op_names[] = { "memcpy", "memmove", "memset" };
+
+static uint8_t *before;
+static uint8_t *after;
+static uint8_t *expected;
+
+static void set_u32(struct dpu_set_t set, const char *symbol, uint32_t value) {
+  DPU_ASSERT(dpu_copy_to(set, symbol, 0, &value, sizeof(value)));
+}
+
+static int run(struct dpu_set_t set, uint32_t op, uint32_t dest_offset, uint32_t src_offset, uint32_t size,
+    uint32_t parallel) {
+  struct dpu_set_t dpu;
+  uint32_t lo = (dest_offset < src_offset ? dest_offset : src_offset) & ~7u;
+  uint32_t hi = (dest_offset > src_offset ? dest_offset : src_offset) + size;
+  uint32_t length, from = dest_offset - GUARD, to = dest_offset + size + GUARD;
+  int checked = size <= MAX_CHECKED_SIZE;
+  uint64_t cycles;
+
+  if (to > hi)
+    hi = to;
+  if (from < lo)
+    lo = from & ~7u;
+  length = (hi - lo + 7) & ~7u;
+
+  if (checked) {
+    for (uint32_t i = 0; i < length; i++)
+      before[i] = (uint8_t)rand();
+    DPU_ASSERT(dpu_copy_to(set, DPU_MRAM_HEAP_POINTER_NAME, lo, before, length));
+  }
+
+  set_u32(set, "op", op);
+  set_u32(set, "dest_offset", dest_offset);
+  set_u32(set, "src_offset", src_offset);
+  set_u32(set, "size", size);
+  set_u32(set, "parallel", parallel);
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+
+  DPU_FOREACH(set, dpu) {
+    DPU_ASSERT(dpu_copy_from(dpu, "cycles", 0, &cycles, sizeof(cycles)));
+  }
+  printf("%8s %8s %10u %4u %4u %12lu %8.3f\n", op_names[op], parallel ? "parallel" : "single", size, dest_offset & 7,
+      src_offset & 7, (unsigned long)cycles, (double)size / cycles);
+
+  if (!checked)
+    return 0;
+  DPU_ASSERT(dpu_copy_from(set, DPU_MRAM_HEAP_POINTER_NAME, lo, after, length));
+  memcpy(expected, before, length);
+  if (op == OP_MEMSET)
+    memset(expected + dest_offset - lo, 0xa5, size);
+  else
+    memmove(expected + dest_offset - lo, before + src_offset - lo, size);
+  if (memcmp(expected, after, length) != 0) {
+    printf("wrong result for %s of %u bytes from %u to %u\n", op_names[op], size, src_offset, dest_offset);
+    return 1;
+  }
+  return 0;
+}
+
+int main() {
+  struct dpu_set_t set;
+  int errors = 0;
+
+  before = malloc(MAX_CHECKED_SIZE * 2 + 4 * GUARD);
+  after = malloc(MAX_CHECKED_SIZE * 2 + 4 * GUARD);
+  expected = malloc(MAX_CHECKED_SIZE * 2 + 4 * GUARD);
+  srand(0);
+
+  DPU_ASSERT(dpu_alloc(1, NULL, &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  printf("%8s %8s %10s %4s %4s %12s %8s\n", "op", "mode", "size", "dst", "src", "cycles", "B/cycle");
+  for (uint32_t size = 8; size <= MAX_SIZE; size <<= 2) {
+    for (uint32_t parallel = 0; parallel < 2; parallel++) {
+      /* Non-overlapping copies, aligned then unaligned. */
+      if (size <= MAX_SIZE / 2) {
+        errors += run(set, OP_MEMCPY, GUARD, GUARD + size + GUARD, size, parallel);
+        errors += run(set, OP_MEMCPY, GUARD + 3, GUARD + size + GUARD + 6, size, parallel);
+      }
+      errors += run(set, OP_MEMSET, GUARD, 0, size, parallel);
+      errors += run(set, OP_MEMSET, GUARD + 5, 0, size, parallel);
+    }
+    /* Overlapping moves, in both directions. */
+    if (size <= MAX_SIZE - 2 * GUARD) {
+      errors += run(set, OP_MEMMOVE, GUARD + 13, GUARD, size - size / 8, 0);
+      errors += run(set, OP_MEMMOVE, GUARD, GUARD + 13, size - size / 8, 0);
+    }
+  }
+
+  DPU_ASSERT(dpu_free(set));
+  free(expected);
+  free(after);
+  free(before);
+  if (errors != 0) {
+    printf("%d errors\n", errors);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,31 @@
+/* Prefix sum of the 64-bit values held by the DPU, in place: the first */
+/* launch replaces them by their exclusive prefix sum and publishes their */
+/* total, the second one adds the offset sent by the host. */
+
+#include <defs.h>
+#include <mram.h>
+#include <mram_prefix_sum.h>
+#include <stdint.h>
+
+#define MAX_VALUES (4 << 20)
+
+enum { SCAN, ADD };
+
+__mram_noinit uint64_t values[MAX_VALUES];
+__host uint32_t nr_values;
+__host uint32_t mode;
+__host uint64_t total;
+__host uint64_t offset;
+
+MRAM_PREFIX_SUM_INIT(prefix_sum);
+
+int main() {
+  if (mode == SCAN) {
+    uint64_t sum = mram_prefix_sum_exclusive(&prefix_sum, values, nr_values);
+    if (me() == 0)
+      total = sum;
+  } else {
+    mram_prefix_sum_add(&prefix_sum, values, nr_values, offset);
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+/* Prefix sum of an array split between 1 to NR_DPUS DPUs: a local scan on */
+/* each DPU, the propagation of the carries by the host, then the addition */
+/* of the offsets on each DPU. Checks the first and last value of each DPU, */
+/* and all the values of the last DPU, against a prefix sum of the host. */
+/* Reports the time of each step and the values per second end to end. */
+
+#include <dpu.h>
+#include <dpu_prefix_sum.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./prefix_sum"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#ifndef VALUES_PER_DPU
+#define VALUES_PER_DPU (1 << 20)
+#endif
+
+/* The DPUs hold the parts in turn. */
+#define NR_PARTS 4
+
+enum { SCAN, ADD };
+
+static uint64_t parts[NR_PARTS][VALUES_PER_DPU], part_totals[NR_PARTS], results[VALUES_PER_DPU];
+static uint64_t firsts[NR_DPUS], lasts[NR_DPUS], offsets[NR_DPUS];
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void launch(struct dpu_set_t set, uint32_t mode) {
+  DPU_ASSERT(dpu_broadcast_to(set, "mode", 0, &mode, sizeof(mode), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+}
+
+/* Checks the prefix sum on nr_dpus DPUs, whose offsets are computed again by the host. */
+static int check(struct dpu_set_t set, uint32_t nr_dpus, uint64_t total) {
+  struct dpu_set_t dpu;
+  uint64_t offset = 0, expected;
+  uint32_t each_dpu;
+  int errors = 0;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &firsts[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "values", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &lasts[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(
+      set, DPU_XFER_FROM_DPU, "values", (VALUES_PER_DPU - 1) * sizeof(uint64_t), sizeof(uint64_t), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    if (each_dpu == nr_dpus - 1)
+      DPU_ASSERT(dpu_copy_from(dpu, "values", 0, results, sizeof(results)));
+  }
+
+  for (each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+    const uint64_t *part = parts[each_dpu % NR_PARTS];
+    expected = offset + part_totals[each_dpu % NR_PARTS] - part[VALUES_PER_DPU - 1];
+    if (firsts[each_dpu] != offset || lasts[each_dpu] != expected || offsets[each_dpu] != offset) {
+      if (errors < 10)
+        printf("DPU %u: first %lu, last %lu, offset %lu instead of %lu, %lu, %lu\n", each_dpu,
+            (unsigned long)firsts[each_dpu], (unsigned long)lasts[each_dpu], (unsigned long)offsets[each_dpu],
+            (unsigned long)offset, (unsigned long)expected, (unsigned long)offset);
+      errors++;
+    }
+    if (each_dpu == nr_dpus - 1) {
+      expected = offset;
+      for (uint32_t i = 0; i < VALUES_PER_DPU; i++) {
+        if (results[i] != expected) {
+          if (errors < 10)
+            printf("DPU %u: value %u is %lu instead of %lu\n", each_dpu, i, (unsigned long)results[i],
+                (unsigned long)expected);
+          errors++;
+        }
+        expected += part[i];
+      }
+    }
+    offset += part_totals[each_dpu % NR_PARTS];
+  }
+  if (total != offset) {
+    printf("%u DPUs: total %lu instead of %lu\n", nr_dpus, (unsigned long)total, (unsigned long)offset);
+    errors++;
+  }
+  return errors;
+}
+
+int main() {
+  const uint32_t nr_dpus_of_runs[] = { 1, 4, 16, 64, 256, 1024, 2560 };
+  uint32_t nr_values = VALUES_PER_DPU;
+  int errors = 0;
+
+  srand(1);
+  for (uint32_t each_part = 0; each_part < NR_PARTS; each_part++) {
+    for (uint32_t i = 0; i < VALUES_PER_DPU; i++) {
+      parts[each_part][i] = (uint64_t)rand() << 8 ^ (uint64_t)rand();
+      part_totals[each_part] += parts[each_part][i];
+    }
+  }
+
+  printf("%6s %12s %12s %12s %12s %14s\n", "DPUs", "scan ms", "carry ms", "add ms", "total ms", "values/s");
+  for (uint32_t each_run = 0; each_run < sizeof(nr_dpus_of_runs) / sizeof(nr_dpus_of_runs[0]); each_run++) {
+    uint32_t nr_dpus = nr_dpus_of_runs[each_run], each_dpu;
+    struct dpu_set_t set, dpu;
+    double start, scan_time, carry_time, add_time, time;
+    uint64_t total;
+
+    if (nr_dpus > NR_DPUS)
+      break;
+    DPU_ASSERT(dpu_alloc(nr_dpus, NULL, &set));
+    DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+    DPU_ASSERT(dpu_broadcast_to(set, "nr_values", 0, &nr_values, sizeof(nr_values), DPU_XFER_DEFAULT));
+    DPU_FOREACH(set, dpu, each_dpu) {
+      DPU_ASSERT(dpu_prepare_xfer(dpu, parts[each_dpu % NR_PARTS]));
+    }
+    DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "values", 0, sizeof(parts[0]), DPU_XFER_DEFAULT));
+
+    start = now();
+    launch(set, SCAN);
+    scan_time = now() - start;
+    DPU_ASSERT(dpu_prefix_sum_carry(set, "total", "offset", offsets, &total));
+    carry_time = now() - start - scan_time;
+    launch(set, ADD);
+    add_time = now() - start - scan_time - carry_time;
+    time = scan_time + carry_time + add_time;
+
+    errors += check(set, nr_dpus, total);
+    printf("%6u %12.3f %12.3f %12.3f %12.3f %14.3e\n", nr_dpus, scan_time * 1e3, carry_time * 1e3, add_time * 1e3,
+        time * 1e3, (double)nr_dpus * VALUES_PER_DPU / time);
+    DPU_ASSERT(dpu_free(set));
+  }
+
+  return errors != 0;
+}
@@ -0,0 +1,41 @@
+/* Sorts the elements (32-bit key and 32-bit payload) sent by the host */
+/* with radix_sort, and leaves them sorted in the elements array. */
+
+#define MRAM_STRING_BUFFER_SIZE 256
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_string.h>
+#include <perfcounter.h>
+#include <radix_sort.h>
+#include <stdint.h>
+
+#define MAX_ELEMENTS (1 << 21)
+
+__mram_noinit uint64_t elements[MAX_ELEMENTS];
+__mram_noinit uint64_t scratch[MAX_ELEMENTS];
+__host uint32_t nr_elements;
+__host uint64_t cycles;
+
+__dma_aligned uint8_t buffers[NR_TASKLETS][MRAM_STRING_BUFFER_SIZE];
+
+RADIX_SORT_INIT(sorter);
+BARRIER_INIT(done, NR_TASKLETS);
+
+int main() {
+  __mram_ptr void *sorted;
+
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+
+  sorted = radix_sort(&sorter, elements, scratch, nr_elements, sizeof(uint64_t), sizeof(uint32_t));
+  if (sorted != (__mram_ptr void *)elements) {
+    mram_memcpy_parallel(elements, sorted, nr_elements * sizeof(uint64_t), buffers[me()]);
+    barrier_wait(&done);
+  }
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
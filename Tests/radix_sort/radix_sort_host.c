@@ -0,0 +1,145 @@
+/* Sorts random elements across all the DPUs, first with a sample sort */
+/* (range partitioning on the host, no merge), then by merging on the */
+/* host the runs sorted by the DPUs, and reports the keys/s. */
+
+#include <dpu.h>
+#include <dpu_sort.h>
+#include <dpu_varlen.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./radix_sort"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+/* Frequency used to convert the cycles of a DPU into seconds. */
+#ifndef DPU_FREQUENCY_MHZ
+#define DPU_FREQUENCY_MHZ 350
+#endif
+
+#define ELEMENTS_PER_DPU (1 << 18)
+#define MAX_ELEMENTS (1 << 21)
+#define ELEMENT_SIZE sizeof(uint64_t)
+#define KEY_SIZE sizeof(uint32_t)
+#define OVERSAMPLING 64
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int check_sorted(const uint64_t *elements, uint64_t nr_elements, uint64_t expected_sum) {
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < nr_elements; i++) {
+    if (i != 0 && (uint32_t)elements[i - 1] > (uint32_t)elements[i]) {
+      printf("elements %lu and %lu are not sorted\n", (unsigned long)i - 1, (unsigned long)i);
+      return 1;
+    }
+    sum += elements[i] >> 32;
+  }
+  if (sum != expected_sum) {
+    printf("wrong payloads\n");
+    return 1;
+  }
+  return 0;
+}
+
+/* Sends the partitions, sorts them and reads them back; returns the largest number of cycles of a DPU. */
+static uint64_t sort_on_dpus(struct dpu_set_t set, uint8_t *partitions, const uint64_t *offsets, const uint64_t *counts,
+    size_t max_length, double *seconds) {
+  struct dpu_set_t dpu;
+  uint32_t each_dpu, nr_elements[NR_DPUS];
+  uint64_t cycles[NR_DPUS], max_cycles = 0;
+  double start;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    nr_elements[each_dpu] = (uint32_t)counts[each_dpu];
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &nr_elements[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "nr_elements", 0, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_push_varlen_xfer(set, DPU_XFER_TO_DPU, "elements", 0, partitions, offsets, max_length, DPU_SG_XFER_DEFAULT));
+
+  start = now();
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+  *seconds = now() - start;
+
+  DPU_ASSERT(dpu_push_varlen_xfer(set, DPU_XFER_FROM_DPU, "elements", 0, partitions, offsets, max_length, DPU_SG_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, &cycles[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_FROM_DPU, "cycles", 0, sizeof(uint64_t), DPU_XFER_DEFAULT));
+  for (each_dpu = 0; each_dpu < NR_DPUS; each_dpu++) {
+    if (cycles[each_dpu] > max_cycles)
+      max_cycles = cycles[each_dpu];
+  }
+  return max_cycles;
+}
+
+static void report(const char *mode, uint64_t nr_elements, uint64_t max_cycles, double dpu_seconds, double total_seconds) {
+  double per_dpu = (double)nr_elements / NR_DPUS / (max_cycles / (DPU_FREQUENCY_MHZ * 1e6));
+  printf("%-12s %12.1f %14.1f %14.1f %14.1f\n", mode, per_dpu / 1e6, per_dpu * NR_DPUS / 1e6, nr_elements / dpu_seconds / 1e6,
+      nr_elements / total_seconds / 1e6);
+}
+
+int main() {
+  struct dpu_set_t set;
+  uint64_t nr_elements = (uint64_t)NR_DPUS * ELEMENTS_PER_DPU;
+  uint64_t *elements = malloc(nr_elements * ELEMENT_SIZE);
+  uint64_t *sorted = malloc(nr_elements * ELEMENT_SIZE);
+  uint8_t *partitions = malloc(nr_elements * ELEMENT_SIZE + NR_DPUS * 8);
+  uint64_t splitters[NR_DPUS], counts[NR_DPUS], offsets[NR_DPUS + 1];
+  uint64_t expected_sum = 0, max_cycles;
+  double start, dpu_seconds;
+  size_t max_length;
+  int errors = 0;
+
+  srand(0);
+  for (uint64_t i = 0; i < nr_elements; i++) {
+    elements[i] = (uint32_t)rand() | ((uint64_t)(uint32_t)rand() << 32);
+    expected_sum += elements[i] >> 32;
+  }
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  printf("%-12s %12s %14s %14s %14s\n", "mode", "Mkeys/s/DPU", "Mkeys/s (DPUs)", "Mkeys/s (wall)", "Mkeys/s (e2e)");
+
+  /* Sample sort: the partitions read back are globally sorted. */
+  start = now();
+  DPU_ASSERT(dpu_sort_splitters(elements, nr_elements, ELEMENT_SIZE, KEY_SIZE, NR_DPUS, OVERSAMPLING, splitters));
+  dpu_sort_count_partitions(elements, nr_elements, ELEMENT_SIZE, KEY_SIZE, splitters, NR_DPUS, counts);
+  max_length = dpu_sort_offsets(counts, NR_DPUS, ELEMENT_SIZE, offsets);
+  if (max_length > MAX_ELEMENTS * ELEMENT_SIZE) {
+    printf("partition too large for a DPU\n");
+    return 1;
+  }
+  DPU_ASSERT(dpu_sort_partition(elements, nr_elements, ELEMENT_SIZE, KEY_SIZE, splitters, NR_DPUS, offsets, partitions));
+  max_cycles = sort_on_dpus(set, partitions, offsets, counts, max_length, &dpu_seconds);
+  report("sample sort", nr_elements, max_cycles, dpu_seconds, now() - start);
+  /* With 8-byte elements, the partitions are packed without padding. */
+  errors += check_sorted((const uint64_t *)partitions, nr_elements, expected_sum);
+
+  /* Merge: each DPU sorts a contiguous slice of the input, then the host merges the runs. */
+  start = now();
+  for (uint32_t each_dpu = 0; each_dpu < NR_DPUS; each_dpu++)
+    counts[each_dpu] = ELEMENTS_PER_DPU;
+  max_length = dpu_sort_offsets(counts, NR_DPUS, ELEMENT_SIZE, offsets);
+  memcpy(partitions, elements, nr_elements * ELEMENT_SIZE);
+  max_cycles = sort_on_dpus(set, partitions, offsets, counts, max_length, &dpu_seconds);
+  DPU_ASSERT(dpu_sort_merge(partitions, offsets, counts, NR_DPUS, ELEMENT_SIZE, KEY_SIZE, sorted));
+  report("merge", nr_elements, max_cycles, dpu_seconds, now() - start);
+  errors += check_sorted(sorted, nr_elements, expected_sum);
+
+  DPU_ASSERT(dpu_free(set));
+  free(partitions);
+  free(sorted);
+  free(elements);
+  return errors != 0;
+}
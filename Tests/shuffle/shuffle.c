@@ -0,0 +1,59 @@
+/* Partitions the elements sent by the host (32-bit destination DPU and */
+/* 32-bit payload) into one bucket per DPU with radix_sort, leaves the */
+/* buckets in destination order in the buckets array, and counts the */
+/* elements of each bucket for dpu_shuffle_plan. */
+
+#define MRAM_STRING_BUFFER_SIZE 256
+#define RADIX_SORT_DIGIT_BITS 4
+
+#include <barrier.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_string.h>
+#include <radix_sort.h>
+#include <stdint.h>
+
+#define MAX_ELEMENTS (1 << 20)
+#define MAX_DPUS 2560
+
+__mram_noinit uint64_t elements[MAX_ELEMENTS];
+__mram_noinit uint64_t buckets[MAX_ELEMENTS];
+__mram_noinit uint64_t received[2 * MAX_ELEMENTS];
+__host uint32_t nr_elements;
+__host uint32_t nr_dpus;
+__host uint32_t nr_received;
+__host uint32_t histogram[MAX_DPUS];
+
+__dma_aligned uint8_t buffers[NR_TASKLETS][MRAM_STRING_BUFFER_SIZE];
+
+RADIX_SORT_INIT(sorter);
+BARRIER_INIT(done, NR_TASKLETS);
+
+/* The index of the first sorted element whose destination is at least dpu. */
+static uint32_t lower_bound(uint32_t dpu) {
+  uint64_t *element = (uint64_t *)buffers[me()];
+  uint32_t from = 0, to = nr_elements;
+
+  while (from < to) {
+    uint32_t middle = (from + to) >> 1;
+    mram_read(&buckets[middle], element, sizeof(uint64_t));
+    if ((uint32_t)*element < dpu)
+      from = middle + 1;
+    else
+      to = middle;
+  }
+  return from;
+}
+
+int main() {
+  __mram_ptr void *sorted = radix_sort(&sorter, elements, buckets, nr_elements, sizeof(uint64_t), sizeof(uint32_t));
+
+  if (sorted != (__mram_ptr void *)buckets) {
+    mram_memcpy_parallel(buckets, sorted, nr_elements * sizeof(uint64_t), buffers[me()]);
+    barrier_wait(&done);
+  }
+
+  for (uint32_t dpu = me(); dpu < nr_dpus; dpu += NR_TASKLETS)
+    histogram[dpu] = lower_bound(dpu + 1) - lower_bound(dpu);
+  return 0;
+}
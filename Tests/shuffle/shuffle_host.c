@@ -0,0 +1,173 @@
+/* Shuffles random elements between all the DPUs: each DPU partitions its */
+/* elements by destination DPU, then the buckets are exchanged through the */
+/* host, first with dpu_shuffle, then naively with dpu_copy_from and */
+/* dpu_copy_to and a transpose on the host. Checks the elements received */
+/* by each DPU, and reports the time, bandwidth and host memory of both. */
+
+#include <dpu.h>
+#include <dpu_shuffle.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./shuffle"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#ifndef ELEMENTS_PER_DPU
+#define ELEMENTS_PER_DPU (1 << 16)
+#endif
+
+#define STRINGIFY(x) #x
+#define PROFILE(nr_dpus) "sgXferEnable=true,sgXferMaxBlocksPerDpu=" STRINGIFY(nr_dpus)
+
+static uint64_t elements[NR_DPUS][ELEMENTS_PER_DPU], zeros[2 * ELEMENTS_PER_DPU];
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Checks the elements received by each DPU: the elements sent to it, by source DPU, each in the order of its source. */
+static int check(struct dpu_set_t set, const char *method, const uint64_t *expected, const uint64_t *offsets) {
+  uint64_t *received = malloc((size_t)2 * ELEMENTS_PER_DPU * sizeof(uint64_t));
+  struct dpu_set_t dpu;
+  uint32_t each_dpu, nr_received;
+  int errors = 0;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    uint64_t nr_expected = offsets[each_dpu + 1] - offsets[each_dpu];
+    DPU_ASSERT(dpu_copy_from(dpu, "nr_received", 0, &nr_received, sizeof(nr_received)));
+    if (nr_received != nr_expected) {
+      if (errors < 10)
+        printf("%s: DPU %u received %u elements instead of %lu\n", method, each_dpu, nr_received,
+            (unsigned long)nr_expected);
+      errors++;
+      continue;
+    }
+    if (nr_received != 0)
+      DPU_ASSERT(dpu_copy_from(dpu, "received", 0, received, nr_received * sizeof(uint64_t)));
+    if (memcmp(received, &expected[offsets[each_dpu]], nr_received * sizeof(uint64_t)) != 0) {
+      if (errors < 10)
+        printf("%s: DPU %u received wrong elements\n", method, each_dpu);
+      errors++;
+    }
+  }
+  free(received);
+  return errors;
+}
+
+/* Gathers all the buckets of each DPU, transposes them on the host, and copies the elements of each DPU to it. */
+static void naive_shuffle(struct dpu_set_t set, uint64_t *gathered, uint64_t *transposed, uint32_t *histograms) {
+  uint64_t offsets[NR_DPUS + 1] = { 0 }, cursors[NR_DPUS];
+  struct dpu_set_t dpu;
+  uint32_t each_dpu;
+
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_copy_from(dpu, "histogram", 0, &histograms[each_dpu * NR_DPUS], NR_DPUS * sizeof(uint32_t)));
+    DPU_ASSERT(dpu_copy_from(
+        dpu, "buckets", 0, &gathered[(size_t)each_dpu * ELEMENTS_PER_DPU], ELEMENTS_PER_DPU * sizeof(uint64_t)));
+  }
+  for (uint32_t source = 0; source < NR_DPUS; source++) {
+    for (uint32_t destination = 0; destination < NR_DPUS; destination++)
+      offsets[destination + 1] += histograms[source * NR_DPUS + destination];
+  }
+  for (uint32_t destination = 0; destination < NR_DPUS; destination++) {
+    offsets[destination + 1] += offsets[destination];
+    cursors[destination] = offsets[destination];
+  }
+  for (uint32_t source = 0; source < NR_DPUS; source++) {
+    const uint64_t *bucket = &gathered[(size_t)source * ELEMENTS_PER_DPU];
+    for (uint32_t destination = 0; destination < NR_DPUS; destination++) {
+      uint32_t count = histograms[source * NR_DPUS + destination];
+      memcpy(&transposed[cursors[destination]], bucket, count * sizeof(uint64_t));
+      cursors[destination] += count;
+      bucket += count;
+    }
+  }
+  DPU_FOREACH(set, dpu, each_dpu) {
+    uint32_t nr_received = (uint32_t)(offsets[each_dpu + 1] - offsets[each_dpu]);
+    if (nr_received != 0)
+      DPU_ASSERT(dpu_copy_to(dpu, "received", 0, &transposed[offsets[each_dpu]], nr_received * sizeof(uint64_t)));
+    DPU_ASSERT(dpu_copy_to(dpu, "nr_received", 0, &nr_received, sizeof(nr_received)));
+  }
+}
+
+int main() {
+  uint64_t *expected = malloc((size_t)NR_DPUS * ELEMENTS_PER_DPU * sizeof(uint64_t));
+  uint64_t *gathered = malloc((size_t)NR_DPUS * ELEMENTS_PER_DPU * sizeof(uint64_t));
+  uint64_t *transposed = malloc((size_t)NR_DPUS * ELEMENTS_PER_DPU * sizeof(uint64_t));
+  uint32_t *histograms = malloc((size_t)NR_DPUS * NR_DPUS * sizeof(uint32_t));
+  uint64_t offsets[NR_DPUS + 1] = { 0 }, cursors[NR_DPUS];
+  uint32_t nr_elements = ELEMENTS_PER_DPU, nr_dpus = NR_DPUS, each_dpu;
+  double bytes = (double)NR_DPUS * ELEMENTS_PER_DPU * sizeof(uint64_t), start, plan_time, exchange_time, naive_time;
+  struct dpu_shuffle shuffle;
+  struct dpu_set_t set, dpu;
+  int errors = 0;
+
+  /* Random destinations, the payload being the source and the index of the element. */
+  srand(1);
+  for (uint32_t source = 0; source < NR_DPUS; source++) {
+    for (uint32_t i = 0; i < ELEMENTS_PER_DPU; i++) {
+      uint32_t destination = (uint32_t)rand() % NR_DPUS;
+      elements[source][i] = (uint64_t)(source * ELEMENTS_PER_DPU + i) << 32 | destination;
+      offsets[destination + 1]++;
+    }
+  }
+  for (uint32_t destination = 0; destination < NR_DPUS; destination++) {
+    offsets[destination + 1] += offsets[destination];
+    cursors[destination] = offsets[destination];
+  }
+  for (uint32_t source = 0; source < NR_DPUS; source++) {
+    for (uint32_t i = 0; i < ELEMENTS_PER_DPU; i++)
+      expected[cursors[(uint32_t)elements[source][i]]++] = elements[source][i];
+  }
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, PROFILE(NR_DPUS), &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_elements", 0, &nr_elements, sizeof(nr_elements), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_dpus", 0, &nr_dpus, sizeof(nr_dpus), DPU_XFER_DEFAULT));
+  DPU_FOREACH(set, dpu, each_dpu) {
+    DPU_ASSERT(dpu_prepare_xfer(dpu, elements[each_dpu]));
+  }
+  DPU_ASSERT(dpu_push_xfer(set, DPU_XFER_TO_DPU, "elements", 0, sizeof(elements[0]), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_launch(set, DPU_SYNCHRONOUS));
+
+  DPU_ASSERT(dpu_shuffle_init(&shuffle, set, sizeof(uint64_t)));
+  start = now();
+  DPU_ASSERT(dpu_shuffle_plan(&shuffle, "histogram"));
+  plan_time = now() - start;
+  DPU_ASSERT(dpu_shuffle_exchange(&shuffle, "buckets", 0, "received", 0, "nr_received"));
+  exchange_time = now() - start - plan_time;
+  errors += check(set, "dpu_shuffle", expected, offsets);
+
+  /* Nothing left by dpu_shuffle can be taken for the results of the naive shuffle. */
+  DPU_ASSERT(dpu_broadcast_to(set, "received", 0, zeros, sizeof(zeros), DPU_XFER_DEFAULT));
+  DPU_ASSERT(dpu_broadcast_to(set, "nr_received", 0, zeros, sizeof(uint32_t), DPU_XFER_DEFAULT));
+  start = now();
+  naive_shuffle(set, gathered, transposed, histograms);
+  naive_time = now() - start;
+  errors += check(set, "naive", expected, offsets);
+
+  printf("%12s %10s %10s %10s %10s %12s\n", "method", "plan ms", "move ms", "total ms", "GB/s", "host MB");
+  printf("%12s %10.3f %10.3f %10.3f %10.3f %12.1f\n", "dpu_shuffle", plan_time * 1e3, exchange_time * 1e3,
+      (plan_time + exchange_time) * 1e3, bytes / (plan_time + exchange_time) * 1e-9,
+      (shuffle.staging_size + (size_t)3 * NR_DPUS * shuffle.nr_bins * sizeof(uint32_t)) / 1e6);
+  printf("%12s %10s %10s %10.3f %10.3f %12.1f\n", "naive", "", "", naive_time * 1e3, bytes / naive_time * 1e-9,
+      (2 * bytes + (double)NR_DPUS * NR_DPUS * sizeof(uint32_t)) / 1e6);
+
+  dpu_shuffle_free(&shuffle);
+  DPU_ASSERT(dpu_free(set));
+  free(expected);
+  free(gathered);
+  free(transposed);
+  free(histograms);
+  return errors != 0;
+}
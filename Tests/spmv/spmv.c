@@ -0,0 +1,35 @@
+/* Multiplies the slice of the sparse matrix held by the DPU with the vector */
+/* broadcast by the host. */
+
+#define MRAM_GATHER_WINDOW_SIZE 512
+
+#include <defs.h>
+#include <mram.h>
+#include <perfcounter.h>
+#include <spmv.h>
+#include <stdint.h>
+
+#define MAX_ROWS (1 << 20)
+#define MAX_ENTRIES (1 << 20)
+#define MAX_COLUMNS (1 << 20)
+
+__mram_noinit uint32_t row_offsets[MAX_ROWS + 2];
+__mram_noinit uint32_t columns[MAX_ENTRIES];
+__mram_noinit int32_t values[MAX_ENTRIES * SPMV_BLOCK_SIZE * SPMV_BLOCK_SIZE];
+__mram_noinit int32_t x[MAX_COLUMNS * SPMV_BLOCK_SIZE];
+__mram_noinit int64_t y[MAX_ROWS * SPMV_BLOCK_SIZE];
+__host uint32_t nr_rows;
+__host uint32_t format;
+__host uint64_t cycles;
+
+SPMV_INIT(product);
+
+int main() {
+  if (me() == 0)
+    perfcounter_config(COUNT_CYCLES, true);
+  spmv_multiply(&product, (spmv_format_t)format, row_offsets, columns, values, nr_rows, x, y);
+
+  if (me() == 0)
+    cycles = perfcounter_get();
+  return 0;
+}
@@ -0,0 +1,175 @@
+/* Multiplies a power-law matrix, whose first rows hold most of the entries, */
+/* and a banded matrix with vectors, in CSR and 2x2 block CSR formats. */
+/* Reports the largest number of entries of a DPU when the entries are split */
+/* evenly and when the rows are, and the throughput of the products. */
+
+#include <dpu.h>
+#include <dpu_spmv.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef DPU_BINARY
+#define DPU_BINARY "./spmv"
+#endif
+
+#ifndef NR_DPUS
+#define NR_DPUS 64
+#endif
+
+#define ROWS_PER_DPU 8192
+#define BAND_WIDTH 8
+#define NR_REPETITIONS 8
+
+struct matrix {
+  uint32_t nr_rows;
+  uint32_t nr_columns;
+  uint32_t *row_offsets;
+  uint32_t *columns;
+  int32_t *values;
+};
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Row r holds about 8192 * 64 / (r + 64) entries at random columns. Built in */
+/* COO format and converted. */
+static void power_law(struct matrix *m, uint32_t n) {
+  uint64_t nr_entries = 0, e = 0;
+  for (uint32_t r = 0; r < n; r++)
+    nr_entries += 1 + 8192 * 64 / (r + 64);
+  uint32_t *rows = malloc(nr_entries * sizeof(uint32_t));
+  uint32_t *columns = malloc(nr_entries * sizeof(uint32_t));
+  int32_t *values = malloc(nr_entries * sizeof(int32_t));
+  for (uint32_t r = 0; r < n; r++) {
+    for (uint32_t i = 0; i < 1 + 8192 * 64 / (r + 64); i++, e++) {
+      rows[e] = r;
+      columns[e] = rand() % n;
+      values[e] = rand() % 2001 - 1000;
+    }
+  }
+  m->nr_rows = m->nr_columns = n;
+  m->row_offsets = malloc((n + 1) * sizeof(uint32_t));
+  m->columns = malloc(nr_entries * sizeof(uint32_t));
+  m->values = malloc(nr_entries * sizeof(int32_t));
+  dpu_spmv_csr_from_coo(n, nr_entries, rows, columns, values, m->row_offsets, m->columns, m->values);
+  free(rows);
+  free(columns);
+  free(values);
+}
+
+static void banded(struct matrix *m, uint32_t n) {
+  uint32_t e = 0;
+  m->nr_rows = m->nr_columns = n;
+  m->row_offsets = malloc((n + 1) * sizeof(uint32_t));
+  m->columns = malloc((size_t)n * (2 * BAND_WIDTH + 1) * sizeof(uint32_t));
+  m->values = malloc((size_t)n * (2 * BAND_WIDTH + 1) * sizeof(int32_t));
+  for (uint32_t r = 0; r < n; r++) {
+    m->row_offsets[r] = e;
+    for (uint32_t c = r < BAND_WIDTH ? 0 : r - BAND_WIDTH; c <= r + BAND_WIDTH && c < n; c++, e++) {
+      m->columns[e] = c;
+      m->values[e] = rand() % 2001 - 1000;
+    }
+  }
+  m->row_offsets[n] = e;
+}
+
+/* The largest number of entries of a DPU when each DPU holds the same number */
+/* of rows. */
+static uint32_t max_entries_by_rows(const uint32_t *row_offsets, uint32_t nr_rows) {
+  uint32_t rows_per_dpu = (nr_rows + NR_DPUS - 1) / NR_DPUS, max = 0;
+  for (uint32_t d = 0; d < NR_DPUS && d * rows_per_dpu < nr_rows; d++) {
+    uint32_t end = (d + 1) * rows_per_dpu < nr_rows ? (d + 1) * rows_per_dpu : nr_rows;
+    uint32_t count = row_offsets[end] - row_offsets[d * rows_per_dpu];
+    max = count > max ? count : max;
+  }
+  return max;
+}
+
+int main() {
+  struct dpu_set_t set;
+  struct matrix matrices[2];
+  const char *names[2] = { "power-law", "banded" };
+  uint32_t n = NR_DPUS * ROWS_PER_DPU;
+  int errors = 0;
+
+  DPU_ASSERT(dpu_alloc(NR_DPUS, "sgXferEnable=true", &set));
+  DPU_ASSERT(dpu_load(set, DPU_BINARY, NULL));
+
+  srand(1);
+  power_law(&matrices[0], n);
+  banded(&matrices[1], n);
+
+  printf("%10s %6s %10s %12s %12s %10s %10s\n", "matrix", "format", "entries", "max by nnz", "max by rows", "DPU ms",
+      "GOP/s");
+  for (uint32_t m = 0; m < 2; m++) {
+    for (uint32_t f = 0; f < 2; f++) {
+      dpu_spmv_format_t format = f == 0 ? DPU_SPMV_CSR : DPU_SPMV_BCSR;
+      uint32_t b = f == 0 ? 1 : DPU_SPMV_BLOCK_SIZE;
+      uint32_t nr_rows = matrices[m].nr_rows, nr_columns = matrices[m].nr_columns;
+      uint32_t *row_offsets = matrices[m].row_offsets, *columns = matrices[m].columns;
+      int32_t *values = matrices[m].values;
+      uint32_t max_by_nnz = 0;
+      struct dpu_spmv spmv;
+      double start, dpu_time;
+
+      if (format == DPU_SPMV_BCSR) {
+        uint32_t nr_blocks;
+        DPU_ASSERT(dpu_spmv_bcsr_from_csr(
+            nr_rows, nr_columns, row_offsets, columns, values, &row_offsets, &columns, &values, &nr_blocks));
+        nr_rows = (nr_rows + b - 1) / b;
+        nr_columns = (nr_columns + b - 1) / b;
+      }
+      int32_t *x = calloc((size_t)nr_columns * b, sizeof(int32_t));
+      int64_t *y = malloc((size_t)nr_rows * b * sizeof(int64_t));
+      int64_t *expected = malloc((size_t)nr_rows * b * sizeof(int64_t));
+      for (uint32_t i = 0; i < matrices[m].nr_columns; i++)
+        x[i] = rand() % 2001 - 1000;
+
+      DPU_ASSERT(dpu_spmv_load(set, format, nr_rows, nr_columns, row_offsets, columns, values, &spmv));
+      for (uint32_t d = 0; d < NR_DPUS; d++) {
+        uint32_t count = spmv.first_entries[d + 1] - spmv.first_entries[d];
+        max_by_nnz = count > max_by_nnz ? count : max_by_nnz;
+      }
+
+      start = now();
+      for (uint32_t r = 0; r < NR_REPETITIONS; r++)
+        DPU_ASSERT(dpu_spmv_multiply(&spmv, x, y));
+      dpu_time = (now() - start) / NR_REPETITIONS;
+
+      dpu_spmv_reference(format, nr_rows, row_offsets, columns, values, x, expected);
+      for (uint64_t i = 0; i < (uint64_t)nr_rows * b; i++) {
+        if (y[i] != expected[i]) {
+          printf("%s: wrong result %lu: %ld instead of %ld\n", names[m], (unsigned long)i, (long)y[i], (long)expected[i]);
+          errors++;
+          break;
+        }
+      }
+      printf("%10s %6s %10u %12u %12u %10.3f %10.2f\n", names[m], f == 0 ? "CSR" : "BCSR", row_offsets[nr_rows],
+          max_by_nnz, max_entries_by_rows(row_offsets, nr_rows), dpu_time * 1e3,
+          2.0 * row_offsets[nr_rows] * b * b / dpu_time / 1e9);
+
+      dpu_spmv_free(&spmv);
+      if (format == DPU_SPMV_BCSR) {
+        free(row_offsets);
+        free(columns);
+        free(values);
+      }
+      free(x);
+      free(y);
+      free(expected);
+    }
+  }
+
+  for (uint32_t m = 0; m < 2; m++) {
+    free(matrices[m].row_offsets);
+    free(matrices[m].columns);
+    free(matrices[m].values);
+  }
+  DPU_ASSERT(dpu_free(set));
+  return errors != 0;
+}
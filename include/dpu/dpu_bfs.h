@@ -0,0 +1,554 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_BFS_H
+#define __DPU_BFS_H
+
+/**
+ * @file dpu_bfs.h
+ * @brief Host side of the breadth-first search of the DPU runtime (bfs.h).
+ *
+ * The graph is split in ranges of vertices when it is loaded, with about the same number of vertices plus neighbours on
+ * each DPU, and stays in MRAM for all the searches. Each level of a search sends the frontier to the DPUs, launches them
+ * and gathers the next frontier, and the host updates the visited vertices:
+ *  - push: each DPU receives the part of the frontier holding its vertices, as a bitmap or, when it is sparse, as a
+ *    list. It returns a bitmap of all the vertices, and the host ORs the bitmaps of all the DPUs.
+ *  - pull: the bitmap of the frontier is broadcast to all the DPUs, and each DPU returns the bitmap of its vertices
+ *    found at this level, transferred directly in place.
+ *
+ * The search switches between the directions as proposed by Beamer et al. (direction-optimizing BFS): it pulls when
+ * the frontier has more than 1/14 of the neighbours of the vertices not visited yet, and pushes again when the frontier
+ * has fewer than 1/24 of the vertices. Pulling requires a symmetric graph. The time spent in each step of each level is
+ * reported, so that the cost of the round trips of the host can be measured.
+ *
+ * The transfers of the parts of the DPUs move only the useful bytes: the DPU set must have been allocated with
+ * scatter/gather transfers enabled (the "sgXferEnable=true" profile option).
+ *
+ * The DPU program is provided by the application, calls bfs_expand with its symbols, and must define:
+ *  - row_offsets and neighbours in MRAM, large enough for the part of the graph of a DPU,
+ *  - frontier and next in MRAM, large enough for a bitmap of all the vertices, and visited for the vertices of a DPU,
+ *  - uint32_t first_vertex, nr_vertices, nr_total_vertices, direction, level and nr_frontier, set by the host.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <dpu.h>
+#include <dpu_bitmap.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief The number of vertices of a frontier given as a bitmap, identical to BFS_FRONTIER_BITMAP on the DPU.
+ */
+#define DPU_BFS_FRONTIER_BITMAP 0xffffffffu
+
+/**
+ * @brief The direction of the expansion of a frontier, identical to bfs_direction_t on the DPU.
+ */
+typedef enum _dpu_bfs_direction_t {
+    DPU_BFS_PUSH = 0,
+    DPU_BFS_PULL = 1,
+    /** Chooses the direction at each level, for symmetric graphs. */
+    DPU_BFS_AUTO = 2,
+} dpu_bfs_direction_t;
+
+/**
+ * @brief A graph loaded on a DPU set.
+ */
+struct dpu_bfs {
+    struct dpu_set_t dpu_set;
+    uint32_t nr_dpus;
+    uint32_t nr_vertices;
+    /** The row offsets of the graph, which must stay valid while it is loaded. */
+    const uint32_t *row_offsets;
+    bool symmetric;
+    /** DPU i holds the vertices [first_vertices[i], first_vertices[i + 1]). */
+    uint32_t *first_vertices;
+};
+
+/**
+ * @brief The duration of the steps of a level of a search, in seconds.
+ */
+struct dpu_bfs_level {
+    dpu_bfs_direction_t direction;
+    /** The number of vertices of the frontier expanded. */
+    uint32_t nr_frontier;
+    /** Sending the frontier to the DPUs. */
+    double to_dpus;
+    /** Running the DPUs. */
+    double dpus;
+    /** Gathering the next frontier. */
+    double from_dpus;
+    /** Merging the next frontier and updating the visited vertices. */
+    double merge;
+};
+
+static inline double
+__dpu_bfs_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* The number of 64-bit words of the bitmap of the vertices of a DPU. */
+static inline uint32_t
+__dpu_bfs_nr_words(const struct dpu_bfs *bfs, uint32_t dpu)
+{
+    return (bfs->first_vertices[dpu + 1] - bfs->first_vertices[dpu] + 63) / 64;
+}
+
+/**
+ * @brief Frees the description of a graph loaded by dpu_bfs_load.
+ * @param bfs the graph
+ */
+static inline void
+dpu_bfs_free(struct dpu_bfs *bfs)
+{
+    free(bfs->first_vertices);
+    bfs->first_vertices = NULL;
+}
+
+/**
+ * @brief Splits a graph between the DPUs of a set, where the DPU program is loaded.
+ * @param dpu_set the DPU set
+ * @param nr_vertices the number of vertices
+ * @param row_offsets the nr_vertices + 1 offsets of the lists of neighbours, kept by the loaded graph
+ * @param neighbours the neighbours of each vertex
+ * @param symmetric whether each edge is listed in both directions, which allows the pull direction
+ * @param bfs receives the description of the loaded graph, to be freed with dpu_bfs_free
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bfs_load(struct dpu_set_t dpu_set,
+    uint32_t nr_vertices,
+    const uint32_t *row_offsets,
+    const uint32_t *neighbours,
+    bool symmetric,
+    struct dpu_bfs *bfs)
+{
+    uint64_t total = (uint64_t)row_offsets[nr_vertices] + nr_vertices;
+    uint64_t *sizes = NULL, *offsets = NULL;
+    uint32_t *staging = NULL, *counts = NULL, each_dpu;
+    struct dpu_set_t dpu;
+    size_t max_length;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &bfs->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    bfs->dpu_set = dpu_set;
+    bfs->nr_vertices = nr_vertices;
+    bfs->row_offsets = row_offsets;
+    bfs->symmetric = symmetric;
+    bfs->first_vertices = malloc((bfs->nr_dpus + 1) * sizeof(uint32_t));
+    sizes = calloc(bfs->nr_dpus, sizeof(*sizes));
+    offsets = malloc((bfs->nr_dpus + 1) * sizeof(*offsets));
+    counts = malloc(bfs->nr_dpus * sizeof(*counts));
+    if (bfs->first_vertices == NULL || sizes == NULL || offsets == NULL || counts == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    /* The first vertex v of DPU i, rounded down to 64, is the first where row_offsets[v] + v reaches i * total / nr_dpus. */
+    for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+        uint64_t target = total * each_dpu / bfs->nr_dpus;
+        uint32_t low = 0, high = nr_vertices;
+        while (low < high) {
+            uint32_t middle = low + (high - low) / 2;
+            if ((uint64_t)row_offsets[middle] + middle < target) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        bfs->first_vertices[each_dpu] = low & ~63u;
+    }
+    bfs->first_vertices[bfs->nr_dpus] = nr_vertices;
+
+    /* The row offsets of each DPU, rebased to its first neighbour. */
+    for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+        counts[each_dpu] = bfs->first_vertices[each_dpu + 1] - bfs->first_vertices[each_dpu];
+        sizes[each_dpu] = ((uint64_t)counts[each_dpu] + 1) * sizeof(uint32_t);
+    }
+    max_length = dpu_varlen_offsets(sizes, bfs->nr_dpus, offsets);
+    staging = malloc(offsets[bfs->nr_dpus] != 0 ? offsets[bfs->nr_dpus] : 1);
+    if (staging == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+        const uint32_t *global = &row_offsets[bfs->first_vertices[each_dpu]];
+        uint32_t *local = &staging[offsets[each_dpu] / sizeof(uint32_t)];
+        for (uint32_t each_vertex = 0; each_vertex <= counts[each_dpu]; each_vertex++) {
+            local[each_vertex] = global[each_vertex] - global[0];
+        }
+        if ((counts[each_dpu] & 1) == 0) {
+            local[counts[each_dpu] + 1] = local[counts[each_dpu]];
+        }
+    }
+    status = dpu_push_varlen_xfer(
+        dpu_set, DPU_XFER_TO_DPU, "row_offsets", 0, staging, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    free(staging);
+    staging = NULL;
+
+    /* The neighbours of each DPU, padded to 8 bytes. */
+    for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+        uint64_t nr_neighbours = row_offsets[bfs->first_vertices[each_dpu + 1]] - row_offsets[bfs->first_vertices[each_dpu]];
+        sizes[each_dpu] = nr_neighbours * sizeof(uint32_t);
+    }
+    max_length = dpu_varlen_offsets(sizes, bfs->nr_dpus, offsets);
+    staging = calloc(offsets[bfs->nr_dpus] != 0 ? offsets[bfs->nr_dpus] : 1, 1);
+    if (status == DPU_OK && staging == NULL) {
+        status = DPU_ERR_SYSTEM;
+    }
+    if (status == DPU_OK) {
+        for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+            memcpy((uint8_t *)staging + offsets[each_dpu],
+                &neighbours[row_offsets[bfs->first_vertices[each_dpu]]],
+                sizes[each_dpu]);
+        }
+        status = dpu_push_varlen_xfer(
+            dpu_set, DPU_XFER_TO_DPU, "neighbours", 0, staging, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    }
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &counts[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "nr_vertices", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &bfs->first_vertices[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "first_vertex", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        status = dpu_broadcast_to(dpu_set, "nr_total_vertices", 0, &nr_vertices, sizeof(nr_vertices), DPU_XFER_DEFAULT);
+    }
+
+end:
+    if (status != DPU_OK) {
+        dpu_bfs_free(bfs);
+    }
+    free(sizes);
+    free(offsets);
+    free(counts);
+    free(staging);
+    return status;
+}
+
+/* The buffers of a search. */
+struct __dpu_bfs_search {
+    uint32_t nr_words;
+    uint64_t *frontier;
+    uint64_t *visited;
+    uint64_t *next;
+    uint64_t *results;
+    uint32_t *staging;
+    uint32_t *nr_frontiers;
+    uint64_t *sizes;
+    uint64_t *offsets;
+    uint64_t *pull_offsets;
+};
+
+/* Sends the part of the frontier of each DPU, as a list when it is smaller than the bitmap. */
+static inline dpu_error_t
+__dpu_bfs_send_parts(struct dpu_bfs *bfs, struct __dpu_bfs_search *s)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    size_t max_length;
+    dpu_error_t status = DPU_OK;
+
+    for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+        const uint64_t *words = &s->frontier[bfs->first_vertices[each_dpu] / 64];
+        uint32_t nr_words = __dpu_bfs_nr_words(bfs, each_dpu), count = 0;
+        for (uint32_t each_word = 0; each_word < nr_words; each_word++) {
+            count += (uint32_t)__builtin_popcountll(words[each_word]);
+        }
+        s->nr_frontiers[each_dpu] = (uint64_t)count * sizeof(uint32_t) < (uint64_t)nr_words * sizeof(uint64_t)
+            ? count
+            : DPU_BFS_FRONTIER_BITMAP;
+        s->sizes[each_dpu] = s->nr_frontiers[each_dpu] == DPU_BFS_FRONTIER_BITMAP ? (uint64_t)nr_words * sizeof(uint64_t)
+                                                                                  : (uint64_t)count * sizeof(uint32_t);
+    }
+    max_length = dpu_varlen_offsets(s->sizes, bfs->nr_dpus, s->offsets);
+
+    for (each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+        const uint64_t *words = &s->frontier[bfs->first_vertices[each_dpu] / 64];
+        uint32_t nr_words = __dpu_bfs_nr_words(bfs, each_dpu);
+        uint32_t *part = &s->staging[s->offsets[each_dpu] / sizeof(uint32_t)];
+
+        if (s->nr_frontiers[each_dpu] == DPU_BFS_FRONTIER_BITMAP) {
+            memcpy(part, words, (size_t)nr_words * sizeof(uint64_t));
+        } else {
+            uint32_t count = 0;
+            for (uint32_t each_word = 0; each_word < nr_words; each_word++) {
+                for (uint64_t bits = words[each_word]; bits != 0; bits &= bits - 1) {
+                    part[count++] = each_word * 64 + (uint32_t)__builtin_ctzll(bits);
+                }
+            }
+        }
+    }
+
+    status = dpu_push_varlen_xfer(
+        bfs->dpu_set, DPU_XFER_TO_DPU, "frontier", 0, s->staging, s->offsets, max_length, DPU_SG_XFER_DEFAULT);
+    DPU_FOREACH (bfs->dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &s->nr_frontiers[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(bfs->dpu_set, DPU_XFER_TO_DPU, "nr_frontier", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    return status;
+}
+
+/* ORs the bitmaps of all the DPUs. */
+static inline void
+__dpu_bfs_or_results(struct dpu_bfs *bfs, struct __dpu_bfs_search *s)
+{
+    dpu_bitmap_or_reduce(s->results, bfs->nr_dpus, s->nr_words, s->next);
+}
+
+/* Runs the levels of a search from the source, its buffers being allocated. */
+static inline dpu_error_t
+__dpu_bfs_levels(struct dpu_bfs *bfs,
+    struct __dpu_bfs_search *s,
+    uint32_t source,
+    dpu_bfs_direction_t direction,
+    int32_t *levels,
+    struct dpu_bfs_level *stats,
+    uint32_t max_stats,
+    uint32_t *nr_levels)
+{
+    const uint32_t *row_offsets = bfs->row_offsets;
+    uint64_t frontier_edges = row_offsets[source + 1] - row_offsets[source];
+    uint64_t unvisited_edges = row_offsets[bfs->nr_vertices] - frontier_edges;
+    uint32_t nr_frontier = 1, level;
+    dpu_bfs_direction_t current = direction == DPU_BFS_PULL ? DPU_BFS_PULL : DPU_BFS_PUSH;
+    dpu_error_t status = DPU_OK;
+
+    for (uint32_t each_vertex = 0; each_vertex < bfs->nr_vertices; each_vertex++) {
+        levels[each_vertex] = -1;
+    }
+    levels[source] = 0;
+    memset(s->frontier, 0, (size_t)s->nr_words * sizeof(uint64_t));
+    s->frontier[source / 64] = (uint64_t)1 << (source % 64);
+    memcpy(s->visited, s->frontier, (size_t)s->nr_words * sizeof(uint64_t));
+
+    for (level = 0; status == DPU_OK && nr_frontier != 0; level++) {
+        uint32_t dpu_direction;
+        double start = __dpu_bfs_now(), sent, ran, gathered;
+
+        if (direction == DPU_BFS_AUTO) {
+            if (current == DPU_BFS_PUSH && frontier_edges > unvisited_edges / 14) {
+                current = DPU_BFS_PULL;
+            } else if (current == DPU_BFS_PULL && nr_frontier < bfs->nr_vertices / 24) {
+                current = DPU_BFS_PUSH;
+            }
+        }
+        dpu_direction = current;
+        if (stats != NULL && level < max_stats) {
+            stats[level].nr_frontier = nr_frontier;
+        }
+
+        if (current == DPU_BFS_PUSH) {
+            status = __dpu_bfs_send_parts(bfs, s);
+        } else {
+            uint32_t bitmap = DPU_BFS_FRONTIER_BITMAP;
+            status = dpu_broadcast_to(
+                bfs->dpu_set, "frontier", 0, s->frontier, (size_t)s->nr_words * sizeof(uint64_t), DPU_XFER_DEFAULT);
+            if (status == DPU_OK) {
+                status = dpu_broadcast_to(bfs->dpu_set, "nr_frontier", 0, &bitmap, sizeof(bitmap), DPU_XFER_DEFAULT);
+            }
+        }
+        if (status == DPU_OK) {
+            status = dpu_broadcast_to(bfs->dpu_set, "direction", 0, &dpu_direction, sizeof(dpu_direction), DPU_XFER_DEFAULT);
+        }
+        if (status == DPU_OK) {
+            status = dpu_broadcast_to(bfs->dpu_set, "level", 0, &level, sizeof(level), DPU_XFER_DEFAULT);
+        }
+        sent = __dpu_bfs_now();
+
+        if (status == DPU_OK) {
+            status = dpu_launch(bfs->dpu_set, DPU_SYNCHRONOUS);
+        }
+        ran = __dpu_bfs_now();
+
+        if (status == DPU_OK && current == DPU_BFS_PUSH) {
+            struct dpu_set_t dpu;
+            uint32_t each_dpu;
+            DPU_FOREACH (bfs->dpu_set, dpu, each_dpu) {
+                if (status == DPU_OK) {
+                    status = dpu_prepare_xfer(dpu, &s->results[(size_t)each_dpu * s->nr_words]);
+                }
+            }
+            if (status == DPU_OK) {
+                status = dpu_push_xfer(
+                    bfs->dpu_set, DPU_XFER_FROM_DPU, "next", 0, (size_t)s->nr_words * sizeof(uint64_t), DPU_XFER_DEFAULT);
+            }
+        } else if (status == DPU_OK) {
+            status = dpu_push_varlen_xfer(bfs->dpu_set,
+                DPU_XFER_FROM_DPU,
+                "next",
+                0,
+                s->next,
+                s->pull_offsets,
+                (size_t)s->nr_words * sizeof(uint64_t),
+                DPU_SG_XFER_DEFAULT);
+        }
+        gathered = __dpu_bfs_now();
+
+        if (status == DPU_OK) {
+            if (current == DPU_BFS_PUSH) {
+                __dpu_bfs_or_results(bfs, s);
+            }
+            nr_frontier = 0;
+            frontier_edges = 0;
+            for (uint32_t each_word = 0; each_word < s->nr_words; each_word++) {
+                uint64_t found = s->next[each_word] & ~s->visited[each_word];
+                s->visited[each_word] |= found;
+                s->frontier[each_word] = found;
+                for (; found != 0; found &= found - 1) {
+                    uint32_t vertex = each_word * 64 + (uint32_t)__builtin_ctzll(found);
+                    levels[vertex] = (int32_t)level + 1;
+                    frontier_edges += row_offsets[vertex + 1] - row_offsets[vertex];
+                    nr_frontier++;
+                }
+            }
+            unvisited_edges -= frontier_edges;
+        }
+
+        if (stats != NULL && level < max_stats) {
+            stats[level].direction = current;
+            stats[level].to_dpus = sent - start;
+            stats[level].dpus = ran - sent;
+            stats[level].from_dpus = gathered - ran;
+            stats[level].merge = __dpu_bfs_now() - gathered;
+        }
+    }
+
+    *nr_levels = level;
+    return status;
+}
+
+/**
+ * @brief Searches the graph loaded on the DPUs from a source vertex.
+ * @param bfs the graph, loaded by dpu_bfs_load
+ * @param source the source vertex
+ * @param direction the direction of all the levels, or DPU_BFS_AUTO to choose it at each level; DPU_BFS_PULL and
+ * DPU_BFS_AUTO require a symmetric graph, DPU_BFS_AUTO always pushing otherwise
+ * @param levels receives the level of each vertex, -1 for the vertices not reached
+ * @param stats receives the duration of the steps of the first max_stats levels, or NULL
+ * @param max_stats the number of levels of stats
+ * @param nr_levels receives the number of levels, each expanding a non-empty frontier
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bfs_run(struct dpu_bfs *bfs,
+    uint32_t source,
+    dpu_bfs_direction_t direction,
+    int32_t *levels,
+    struct dpu_bfs_level *stats,
+    uint32_t max_stats,
+    uint32_t *nr_levels)
+{
+    struct __dpu_bfs_search s;
+    size_t bitmap_size;
+    dpu_error_t status;
+
+    if (direction == DPU_BFS_AUTO && !bfs->symmetric) {
+        direction = DPU_BFS_PUSH;
+    }
+    s.nr_words = (bfs->nr_vertices + 63) / 64;
+    bitmap_size = ((size_t)s.nr_words != 0 ? s.nr_words : 1) * sizeof(uint64_t);
+    s.frontier = malloc(bitmap_size);
+    s.visited = malloc(bitmap_size);
+    s.next = malloc(bitmap_size);
+    s.results = malloc(bitmap_size * bfs->nr_dpus);
+    s.staging = malloc(bitmap_size + bfs->nr_dpus * sizeof(uint64_t));
+    s.nr_frontiers = malloc(bfs->nr_dpus * sizeof(uint32_t));
+    s.sizes = malloc(bfs->nr_dpus * sizeof(uint64_t));
+    s.offsets = malloc((bfs->nr_dpus + 1) * sizeof(uint64_t));
+    s.pull_offsets = malloc((bfs->nr_dpus + 1) * sizeof(uint64_t));
+
+    if (s.frontier == NULL || s.visited == NULL || s.next == NULL || s.results == NULL || s.staging == NULL
+        || s.nr_frontiers == NULL || s.sizes == NULL || s.offsets == NULL || s.pull_offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+    } else {
+        /* The bitmaps of the vertices of the DPUs are gathered in place. */
+        for (uint32_t each_dpu = 0; each_dpu < bfs->nr_dpus; each_dpu++) {
+            s.pull_offsets[each_dpu] = bfs->first_vertices[each_dpu] / 64 * sizeof(uint64_t);
+        }
+        s.pull_offsets[bfs->nr_dpus] = (uint64_t)s.nr_words * sizeof(uint64_t);
+        status = __dpu_bfs_levels(bfs, &s, source, direction, levels, stats, max_stats, nr_levels);
+    }
+
+    free(s.frontier);
+    free(s.visited);
+    free(s.next);
+    free(s.results);
+    free(s.staging);
+    free(s.nr_frontiers);
+    free(s.sizes);
+    free(s.offsets);
+    free(s.pull_offsets);
+    return status;
+}
+
+/**
+ * @brief Searches a graph on the host, with the same results as dpu_bfs_run.
+ * @param nr_vertices the number of vertices
+ * @param row_offsets the nr_vertices + 1 offsets of the lists of neighbours
+ * @param neighbours the neighbours of each vertex
+ * @param source the source vertex
+ * @param levels receives the level of each vertex, -1 for the vertices not reached
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bfs_reference(uint32_t nr_vertices,
+    const uint32_t *row_offsets,
+    const uint32_t *neighbours,
+    uint32_t source,
+    int32_t *levels)
+{
+    uint32_t *queue = malloc((nr_vertices != 0 ? nr_vertices : 1) * sizeof(*queue));
+    uint32_t head = 0, tail = 0;
+
+    if (queue == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    for (uint32_t each_vertex = 0; each_vertex < nr_vertices; each_vertex++) {
+        levels[each_vertex] = -1;
+    }
+    levels[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+        uint32_t vertex = queue[head++];
+        for (uint32_t each_edge = row_offsets[vertex]; each_edge < row_offsets[vertex + 1]; each_edge++) {
+            uint32_t neighbour = neighbours[each_edge];
+            if (levels[neighbour] < 0) {
+                levels[neighbour] = levels[vertex] + 1;
+                queue[tail++] = neighbour;
+            }
+        }
+    }
+    free(queue);
+    return DPU_OK;
+}
+
+#endif /* __DPU_BFS_H */
@@ -0,0 +1,653 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_BITMAP_H
+#define __DPU_BITMAP_H
+
+/**
+ * @file dpu_bitmap.h
+ * @brief Host side of the bitmaps of the DPU runtime (mram_bitmap.h).
+ *
+ * A bitmap of nr_bits bits is an array of dpu_bitmap_size(nr_bits) bytes, where bit i is bit i % 64 of the 64-bit word
+ * i / 64, which is the layout of the MRAM bitmaps. A bitmap is usually split between the DPUs in parts of the same number
+ * of bits, a multiple of 64: dpu_bitmap_push_parts and dpu_bitmap_pull_parts move the parts in place, and
+ * dpu_bitmap_pull_roaring gathers the parts compressed by the DPUs in the Roaring format, which moves the bytes of the
+ * bits set when the parts are sparse. dpu_bitmap_pull_or gathers a bitmap of all the bits from each DPU, and ORs them.
+ *
+ * The OR of the bitmaps of many DPUs is done by blocks of DPU_BITMAP_OR_BLOCK words, which stay in the L1 cache while the
+ * bitmaps of all the DPUs are ORed into them, 4 at a time, with AVX2 or SSE2 when they are available.
+ *
+ * The Roaring images built by dpu_bitmap_roaring_encode are identical to those built by mram_bitmap_roaring_encode on
+ * the DPU. The transfers of the Roaring images require a DPU set allocated with scatter/gather transfers enabled (the
+ * "sgXferEnable=true" profile option).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Number of bits of a Roaring container, identical to MRAM_BITMAP_CONTAINER_BITS.
+ */
+#define DPU_BITMAP_CONTAINER_BITS 65536
+
+/**
+ * @brief Number of 64-bit words of the blocks of dpu_bitmap_or_reduce.
+ */
+#define DPU_BITMAP_OR_BLOCK 512
+
+/**
+ * @brief The forms of the data of a Roaring container, identical to mram_bitmap_container_type_t on the DPU.
+ */
+typedef enum _dpu_bitmap_container_type_t {
+    DPU_BITMAP_CONTAINER_ARRAY = 1,
+    DPU_BITMAP_CONTAINER_BITMAP = 2,
+    DPU_BITMAP_CONTAINER_RUN = 3,
+} dpu_bitmap_container_type_t;
+
+/**
+ * @brief The header of a Roaring image, identical to struct mram_bitmap_roaring_header on the DPU.
+ */
+struct dpu_bitmap_roaring_header {
+    uint32_t nr_bits;
+    uint32_t nr_containers;
+    uint32_t cardinality;
+    uint32_t size;
+};
+
+/**
+ * @brief A container of a Roaring image, identical to struct mram_bitmap_container on the DPU.
+ */
+struct dpu_bitmap_container {
+    uint32_t offset;
+    uint32_t cardinality;
+    uint16_t key;
+    uint8_t type;
+    uint8_t reserved;
+    uint32_t count;
+};
+
+/**
+ * @brief The size of a bitmap.
+ * @param nr_bits the number of bits of the bitmap
+ * @return The size, in bytes, a multiple of 8.
+ */
+static inline size_t
+dpu_bitmap_size(uint32_t nr_bits)
+{
+    return (((size_t)nr_bits + 63) >> 6) << 3;
+}
+
+/**
+ * @brief The largest size of the Roaring image of a bitmap.
+ * @param nr_bits the number of bits of the bitmap
+ * @return The size, in bytes.
+ */
+static inline size_t
+dpu_bitmap_roaring_bound(uint32_t nr_bits)
+{
+    size_t nr_keys = ((size_t)nr_bits + DPU_BITMAP_CONTAINER_BITS - 1) / DPU_BITMAP_CONTAINER_BITS;
+    return sizeof(struct dpu_bitmap_roaring_header) + nr_keys * (sizeof(struct dpu_bitmap_container) + 8192);
+}
+
+/**
+ * @brief Counts the bits set in a bitmap.
+ * @param bitmap the bitmap
+ * @param nr_bits the number of bits of the bitmap
+ * @return The number of bits set.
+ */
+static inline uint64_t
+dpu_bitmap_popcount(const uint64_t *bitmap, uint32_t nr_bits)
+{
+    size_t nr_words = dpu_bitmap_size(nr_bits) / sizeof(uint64_t);
+    uint64_t count = 0;
+
+    for (size_t each_word = 0; each_word < nr_words; each_word++) {
+        count += (uint64_t)__builtin_popcountll(bitmap[each_word]);
+    }
+    return count;
+}
+
+/* ORs 4 blocks of n words into a block of the result. */
+static inline void
+__dpu_bitmap_or4(uint64_t *to, const uint64_t *a, const uint64_t *b, const uint64_t *c, const uint64_t *d, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)&a[i]), _mm256_loadu_si256((const __m256i *)&b[i]));
+        __m256i y = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)&c[i]), _mm256_loadu_si256((const __m256i *)&d[i]));
+        __m256i z = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)&to[i]), _mm256_or_si256(x, y));
+        _mm256_storeu_si256((__m256i *)&to[i], z);
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_or_si128(_mm_loadu_si128((const __m128i *)&a[i]), _mm_loadu_si128((const __m128i *)&b[i]));
+        __m128i y = _mm_or_si128(_mm_loadu_si128((const __m128i *)&c[i]), _mm_loadu_si128((const __m128i *)&d[i]));
+        __m128i z = _mm_or_si128(_mm_loadu_si128((const __m128i *)&to[i]), _mm_or_si128(x, y));
+        _mm_storeu_si128((__m128i *)&to[i], z);
+    }
+#endif
+    for (; i < n; i++) {
+        to[i] |= a[i] | b[i] | c[i] | d[i];
+    }
+}
+
+/**
+ * @brief ORs bitmaps of the same size, such as the bitmaps gathered from the DPUs of a set.
+ * @param bitmaps the bitmaps, one after the other
+ * @param nr_bitmaps the number of bitmaps
+ * @param nr_words the number of 64-bit words of each bitmap
+ * @param result receives the OR of the bitmaps, which is all zeros without bitmaps
+ */
+static inline void
+dpu_bitmap_or_reduce(const uint64_t *bitmaps, uint32_t nr_bitmaps, size_t nr_words, uint64_t *result)
+{
+    for (size_t start = 0; start < nr_words; start += DPU_BITMAP_OR_BLOCK) {
+        size_t n = nr_words - start < DPU_BITMAP_OR_BLOCK ? nr_words - start : DPU_BITMAP_OR_BLOCK;
+        uint32_t each_bitmap = 1;
+
+        if (nr_bitmaps == 0) {
+            memset(&result[start], 0, n * sizeof(uint64_t));
+            continue;
+        }
+        memcpy(&result[start], &bitmaps[start], n * sizeof(uint64_t));
+        for (; each_bitmap < nr_bitmaps; each_bitmap += 4) {
+            /* The missing bitmaps of the last group repeat the first one, which is already in the result. */
+            const uint64_t *group[4];
+            for (uint32_t each = 0; each < 4; each++) {
+                group[each] = &bitmaps[(each_bitmap + each < nr_bitmaps ? each_bitmap + each : 0) * nr_words + start];
+            }
+            __dpu_bitmap_or4(&result[start], group[0], group[1], group[2], group[3], n);
+        }
+    }
+}
+
+/* The statistics of a container: its number of bits set and its number of runs of bits. */
+static inline uint32_t
+__dpu_bitmap_container_stats(const uint64_t *bitmap, uint32_t nr_bits, uint32_t key, uint32_t *nr_runs)
+{
+    size_t first = (size_t)key * (DPU_BITMAP_CONTAINER_BITS / 64), last = dpu_bitmap_size(nr_bits) / sizeof(uint64_t);
+    uint32_t cardinality = 0, runs = 0;
+    uint64_t carry = 0;
+
+    if (last > first + DPU_BITMAP_CONTAINER_BITS / 64) {
+        last = first + DPU_BITMAP_CONTAINER_BITS / 64;
+    }
+    for (size_t each_word = first; each_word < last; each_word++) {
+        uint64_t x = bitmap[each_word];
+        cardinality += (uint32_t)__builtin_popcountll(x);
+        runs += (uint32_t)__builtin_popcountll(x & ~((x << 1) | carry));
+        carry = x >> 63;
+    }
+    *nr_runs = runs;
+    return cardinality;
+}
+
+/* The form of a container, as chosen by __mram_bitmap_container_type on the DPU. */
+static inline uint32_t
+__dpu_bitmap_container_type(uint32_t cardinality, uint32_t nr_runs)
+{
+    if (4 * nr_runs < 2 * cardinality && 4 * nr_runs < 8192) {
+        return DPU_BITMAP_CONTAINER_RUN;
+    }
+    return 2 * cardinality <= 8192 ? DPU_BITMAP_CONTAINER_ARRAY : DPU_BITMAP_CONTAINER_BITMAP;
+}
+
+static inline uint32_t
+__dpu_bitmap_container_count(uint32_t type, uint32_t cardinality, uint32_t nr_runs)
+{
+    return type == DPU_BITMAP_CONTAINER_ARRAY ? cardinality : type == DPU_BITMAP_CONTAINER_RUN ? nr_runs : 8192 / 8;
+}
+
+static inline uint32_t
+__dpu_bitmap_container_size(uint32_t type, uint32_t count)
+{
+    return type == DPU_BITMAP_CONTAINER_ARRAY ? ((count * 2 + 7) & ~7u)
+        : type == DPU_BITMAP_CONTAINER_RUN    ? ((count * 4 + 7) & ~7u)
+                                              : 8192;
+}
+
+/**
+ * @brief Compresses a bitmap into a Roaring image, identical to the image built by mram_bitmap_roaring_encode.
+ * @param bitmap the bitmap, whose bits past nr_bits are zero
+ * @param nr_bits the number of bits of the bitmap
+ * @param image receives the image, of up to dpu_bitmap_roaring_bound(nr_bits) bytes
+ * @param size receives the size of the image, in bytes, a multiple of 8
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bitmap_roaring_encode(const uint64_t *bitmap, uint32_t nr_bits, void *image, size_t *size)
+{
+    uint32_t nr_keys = (uint32_t)(((uint64_t)nr_bits + DPU_BITMAP_CONTAINER_BITS - 1) / DPU_BITMAP_CONTAINER_BITS);
+    uint32_t *stats = malloc(2 * (size_t)nr_keys * sizeof(uint32_t) + 1);
+    struct dpu_bitmap_roaring_header header = { .nr_bits = nr_bits };
+    uint8_t *bytes = (uint8_t *)image;
+    uint32_t offset, entry = 0;
+
+    if (stats == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    for (uint32_t key = 0; key < nr_keys; key++) {
+        stats[2 * key] = __dpu_bitmap_container_stats(bitmap, nr_bits, key, &stats[2 * key + 1]);
+        header.nr_containers += stats[2 * key] != 0;
+        header.cardinality += stats[2 * key];
+    }
+
+    offset = (uint32_t)(sizeof(header) + header.nr_containers * sizeof(struct dpu_bitmap_container));
+    for (uint32_t key = 0; key < nr_keys; key++) {
+        uint32_t cardinality = stats[2 * key], nr_runs = stats[2 * key + 1];
+        uint32_t type = __dpu_bitmap_container_type(cardinality, nr_runs), count;
+        const uint64_t *words = &bitmap[(size_t)key * (DPU_BITMAP_CONTAINER_BITS / 64)];
+        size_t nr_words = dpu_bitmap_size(nr_bits) / sizeof(uint64_t) - (size_t)key * (DPU_BITMAP_CONTAINER_BITS / 64);
+        struct dpu_bitmap_container container;
+        uint16_t *values = (uint16_t *)(bytes + offset);
+        uint32_t nr_values = 0;
+
+        if (cardinality == 0) {
+            continue;
+        }
+        count = __dpu_bitmap_container_count(type, cardinality, nr_runs);
+        nr_words = nr_words < DPU_BITMAP_CONTAINER_BITS / 64 ? nr_words : DPU_BITMAP_CONTAINER_BITS / 64;
+        memset(bytes + offset, 0, __dpu_bitmap_container_size(type, count));
+
+        if (type == DPU_BITMAP_CONTAINER_BITMAP) {
+            memcpy(bytes + offset, words, nr_words * sizeof(uint64_t));
+        } else if (type == DPU_BITMAP_CONTAINER_ARRAY) {
+            for (size_t each_word = 0; each_word < nr_words; each_word++) {
+                for (uint64_t x = words[each_word]; x != 0; x &= x - 1) {
+                    values[nr_values++] = (uint16_t)(each_word * 64 + (uint32_t)__builtin_ctzll(x));
+                }
+            }
+        } else {
+            uint32_t end = nr_bits - key * DPU_BITMAP_CONTAINER_BITS, start = 0;
+            end = end < DPU_BITMAP_CONTAINER_BITS ? end : DPU_BITMAP_CONTAINER_BITS;
+            bool in_run = false;
+            for (size_t each_word = 0; each_word < nr_words; each_word++) {
+                uint64_t x = words[each_word];
+                uint32_t bit = 0;
+                while (bit < 64) {
+                    uint64_t rest = in_run ? ~x >> bit : x >> bit;
+                    if (rest == 0) {
+                        break;
+                    }
+                    bit += (uint32_t)__builtin_ctzll(rest);
+                    if (in_run) {
+                        values[nr_values++] = (uint16_t)start;
+                        values[nr_values++] = (uint16_t)(each_word * 64 + bit - start - 1);
+                    } else {
+                        start = (uint32_t)each_word * 64 + bit;
+                    }
+                    in_run = !in_run;
+                }
+            }
+            if (in_run) {
+                values[nr_values++] = (uint16_t)start;
+                values[nr_values++] = (uint16_t)(end - start - 1);
+            }
+        }
+
+        container.offset = offset;
+        container.cardinality = cardinality;
+        container.key = (uint16_t)key;
+        container.type = (uint8_t)type;
+        container.reserved = 0;
+        container.count = count;
+        memcpy(bytes + sizeof(header) + entry * sizeof(container), &container, sizeof(container));
+        offset += __dpu_bitmap_container_size(type, count);
+        entry++;
+    }
+
+    header.size = offset;
+    memcpy(bytes, &header, sizeof(header));
+    *size = offset;
+    free(stats);
+    return DPU_OK;
+}
+
+/* Sets the bits [from, to) of a bitmap. */
+static inline void
+__dpu_bitmap_set_range(uint64_t *words, uint32_t from, uint32_t to)
+{
+    while (from < to) {
+        uint32_t bit = from & 63, n = 64 - bit < to - from ? 64 - bit : to - from;
+        words[from >> 6] |= (n == 64 ? ~(uint64_t)0 : (((uint64_t)1 << n) - 1)) << bit;
+        from += n;
+    }
+}
+
+/**
+ * @brief Decompresses a Roaring image into a bitmap.
+ * @param image the image
+ * @param size the size of the image, in bytes
+ * @param bitmap receives the bitmap
+ * @param nr_bits the number of bits of the bitmap, which must be the number of bits of the image
+ * @return Whether the operation was successful: DPU_ERR_INVALID_BUFFER_SIZE if the image is not valid.
+ */
+static inline dpu_error_t
+dpu_bitmap_roaring_decode(const void *image, size_t size, uint64_t *bitmap, uint32_t nr_bits)
+{
+    const uint8_t *bytes = (const uint8_t *)image;
+    uint32_t nr_keys = (uint32_t)(((uint64_t)nr_bits + DPU_BITMAP_CONTAINER_BITS - 1) / DPU_BITMAP_CONTAINER_BITS);
+    size_t nr_words = dpu_bitmap_size(nr_bits) / sizeof(uint64_t);
+    struct dpu_bitmap_roaring_header header;
+    int32_t previous = -1;
+
+    if (size < sizeof(header)) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    memcpy(&header, bytes, sizeof(header));
+    if (header.nr_bits != nr_bits || header.size > size || header.nr_containers > nr_keys
+        || sizeof(header) + (size_t)header.nr_containers * sizeof(struct dpu_bitmap_container) > header.size) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+
+    memset(bitmap, 0, nr_words * sizeof(uint64_t));
+    for (uint32_t entry = 0; entry < header.nr_containers; entry++) {
+        struct dpu_bitmap_container container;
+        uint64_t *words;
+        const uint8_t *data;
+        uint32_t container_bits;
+
+        memcpy(&container, bytes + sizeof(header) + entry * sizeof(container), sizeof(container));
+        if ((int32_t)container.key <= previous || container.key >= nr_keys || (container.offset & 7) != 0
+            || container.type < DPU_BITMAP_CONTAINER_ARRAY || container.type > DPU_BITMAP_CONTAINER_RUN
+            || (container.type == DPU_BITMAP_CONTAINER_BITMAP && container.count != 8192 / 8)
+            || container.count > 8192 || container.offset > header.size
+            || __dpu_bitmap_container_size(container.type, container.count) > header.size - container.offset) {
+            return DPU_ERR_INVALID_BUFFER_SIZE;
+        }
+        previous = container.key;
+        words = &bitmap[(size_t)container.key * (DPU_BITMAP_CONTAINER_BITS / 64)];
+        data = bytes + container.offset;
+        container_bits = nr_bits - container.key * DPU_BITMAP_CONTAINER_BITS;
+        container_bits = container_bits < DPU_BITMAP_CONTAINER_BITS ? container_bits : DPU_BITMAP_CONTAINER_BITS;
+
+        if (container.type == DPU_BITMAP_CONTAINER_BITMAP) {
+            memcpy(words, data, ((container_bits + 63) >> 6) * sizeof(uint64_t));
+        } else {
+            uint32_t step = container.type == DPU_BITMAP_CONTAINER_RUN ? 2 : 1;
+            for (uint32_t each = 0; each < container.count; each++) {
+                uint16_t value[2] = { 0, 0 };
+                uint32_t end;
+                memcpy(value, data + (size_t)each * step * sizeof(uint16_t), step * sizeof(uint16_t));
+                end = (uint32_t)value[0] + value[1] + 1;
+                if (end > container_bits) {
+                    return DPU_ERR_INVALID_BUFFER_SIZE;
+                }
+                __dpu_bitmap_set_range(words, value[0], end);
+            }
+        }
+    }
+
+    /* The bits past nr_bits of a bitmap container. */
+    if ((nr_bits & 63) != 0) {
+        bitmap[nr_words - 1] &= ((uint64_t)1 << (nr_bits & 63)) - 1;
+    }
+    return DPU_OK;
+}
+
+/**
+ * @brief Copies the parts of a bitmap to the DPUs of a set.
+ *
+ * DPU i receives the bits [i * bits_per_dpu, (i + 1) * bits_per_dpu) of the bitmap, the bits past nr_bits being zero.
+ *
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol receiving the part of each DPU
+ * @param symbol_offset the byte offset of the part from the symbol
+ * @param bitmap the bitmap, whose bits past nr_bits are zero
+ * @param nr_bits the number of bits of the bitmap
+ * @param bits_per_dpu the number of bits of the part of each DPU, a multiple of 64
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bitmap_push_parts(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    const uint64_t *bitmap,
+    uint32_t nr_bits,
+    uint32_t bits_per_dpu)
+{
+    size_t part_size = bits_per_dpu / 8, size = dpu_bitmap_size(nr_bits);
+    uint8_t *partial = NULL;
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status = DPU_OK;
+
+    if ((bits_per_dpu & 63) != 0) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    /* The part overlapping the end of the bitmap, and the parts past its end, are copied from a padded buffer. */
+    if ((partial = calloc(1, 2 * part_size + 8)) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        size_t first = (size_t)each_dpu * part_size;
+        const uint8_t *part = partial + part_size;
+        if (first + part_size <= size) {
+            part = (const uint8_t *)bitmap + first;
+        } else if (first < size) {
+            memcpy(partial, (const uint8_t *)bitmap + first, size - first);
+            part = partial;
+        }
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, (void *)part);
+        }
+    }
+    if (status == DPU_OK && part_size != 0) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, symbol_name, symbol_offset, part_size, DPU_XFER_DEFAULT);
+    }
+    free(partial);
+    return status;
+}
+
+/**
+ * @brief Gathers the parts of a bitmap from the DPUs of a set, as they are split by dpu_bitmap_push_parts.
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol holding the part of each DPU
+ * @param symbol_offset the byte offset of the part from the symbol
+ * @param bitmap receives the bitmap
+ * @param nr_bits the number of bits of the bitmap
+ * @param bits_per_dpu the number of bits of the part of each DPU, a multiple of 64
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bitmap_pull_parts(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    uint64_t *bitmap,
+    uint32_t nr_bits,
+    uint32_t bits_per_dpu)
+{
+    size_t part_size = bits_per_dpu / 8, size = dpu_bitmap_size(nr_bits), overlap = size;
+    uint8_t *partial = NULL;
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status = DPU_OK;
+
+    if ((bits_per_dpu & 63) != 0) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    /* The part overlapping the end of the bitmap, and the parts past its end, are received in scratch buffers. */
+    if ((partial = malloc(2 * part_size + 8)) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        size_t first = (size_t)each_dpu * part_size;
+        uint8_t *part = partial + part_size;
+        if (first + part_size <= size) {
+            part = (uint8_t *)bitmap + first;
+        } else if (first < size) {
+            part = partial;
+            overlap = first;
+        }
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, part);
+        }
+    }
+    if (status == DPU_OK && part_size != 0) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, symbol_name, symbol_offset, part_size, DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK && overlap != size) {
+        memcpy((uint8_t *)bitmap + overlap, partial, size - overlap);
+    }
+    free(partial);
+    return status;
+}
+
+/**
+ * @brief Gathers a bitmap from each DPU of a set, and ORs them.
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol holding the bitmap of each DPU
+ * @param symbol_offset the byte offset of the bitmap from the symbol
+ * @param nr_bits the number of bits of the bitmaps
+ * @param result receives the OR of the bitmaps
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bitmap_pull_or(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    uint32_t nr_bits,
+    uint64_t *result)
+{
+    size_t size = dpu_bitmap_size(nr_bits);
+    uint64_t *bitmaps = NULL;
+    struct dpu_set_t dpu;
+    uint32_t nr_dpus, each_dpu;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    if ((bitmaps = malloc(nr_dpus * size + 1)) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &bitmaps[each_dpu * (size / sizeof(uint64_t))]);
+        }
+    }
+    if (status == DPU_OK && size != 0) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, symbol_name, symbol_offset, size, DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        dpu_bitmap_or_reduce(bitmaps, nr_dpus, size / sizeof(uint64_t), result);
+    }
+    free(bitmaps);
+    return status;
+}
+
+/**
+ * @brief Gathers the parts of a bitmap from the DPUs of a set, compressed by the DPUs with mram_bitmap_roaring_encode.
+ *
+ * The image of DPU i holds the bits [i * bits_per_dpu, (i + 1) * bits_per_dpu) of the bitmap, but for the bits past
+ * nr_bits: its number of bits is the number of bits of its part which are in the bitmap. The headers of the images are
+ * read first, and then each image is transferred with its own size.
+ *
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol holding the image of each DPU
+ * @param symbol_offset the byte offset of the image from the symbol
+ * @param bitmap receives the bitmap
+ * @param nr_bits the number of bits of the bitmap
+ * @param bits_per_dpu the number of bits of the part of each DPU, a multiple of 64
+ * @param transferred if not NULL, receives the number of bytes transferred
+ * @return Whether the operation was successful: DPU_ERR_INVALID_BUFFER_SIZE if an image is not valid.
+ */
+static inline dpu_error_t
+dpu_bitmap_pull_roaring(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    uint64_t *bitmap,
+    uint32_t nr_bits,
+    uint32_t bits_per_dpu,
+    uint64_t *transferred)
+{
+    struct dpu_bitmap_roaring_header *headers = NULL;
+    uint64_t *sizes = NULL, *offsets = NULL;
+    uint8_t *images = NULL;
+    struct dpu_set_t dpu;
+    uint32_t nr_dpus, each_dpu;
+    size_t max_length;
+    dpu_error_t status;
+
+    if ((bits_per_dpu & 63) != 0) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    if ((status = dpu_get_nr_dpus(dpu_set, &nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    headers = malloc(nr_dpus * sizeof(*headers));
+    sizes = malloc(nr_dpus * sizeof(uint64_t));
+    offsets = malloc((nr_dpus + 1) * sizeof(uint64_t));
+    if (headers == NULL || sizes == NULL || offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &headers[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, symbol_name, symbol_offset, sizeof(*headers), DPU_XFER_DEFAULT);
+    }
+    if (status != DPU_OK) {
+        goto end;
+    }
+    for (each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+        if (headers[each_dpu].size < sizeof(*headers) || (headers[each_dpu].size & 7) != 0
+            || headers[each_dpu].size > dpu_bitmap_roaring_bound(bits_per_dpu)) {
+            status = DPU_ERR_INVALID_BUFFER_SIZE;
+            goto end;
+        }
+        sizes[each_dpu] = headers[each_dpu].size;
+    }
+    max_length = dpu_varlen_offsets(sizes, nr_dpus, offsets);
+    if ((images = malloc(offsets[nr_dpus] + 8)) == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    status = dpu_push_varlen_xfer(
+        dpu_set, DPU_XFER_FROM_DPU, symbol_name, symbol_offset, images, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    if (transferred != NULL) {
+        *transferred = nr_dpus * sizeof(*headers) + offsets[nr_dpus];
+    }
+
+    memset(bitmap, 0, dpu_bitmap_size(nr_bits));
+    for (each_dpu = 0; each_dpu < nr_dpus && status == DPU_OK; each_dpu++) {
+        uint64_t first = (uint64_t)each_dpu * bits_per_dpu;
+        uint32_t part_bits = first >= nr_bits ? 0
+            : nr_bits - first < bits_per_dpu ? (uint32_t)(nr_bits - first)
+                                             : bits_per_dpu;
+        if (part_bits != 0) {
+            status = dpu_bitmap_roaring_decode(&images[offsets[each_dpu]], sizes[each_dpu], &bitmap[first / 64], part_bits);
+        } else if (headers[each_dpu].nr_bits != 0) {
+            status = DPU_ERR_INVALID_BUFFER_SIZE;
+        }
+    }
+
+end:
+    free(images);
+    free(offsets);
+    free(sizes);
+    free(headers);
+    return status;
+}
+
+#endif /* __DPU_BITMAP_H */
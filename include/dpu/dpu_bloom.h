@@ -0,0 +1,441 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_BLOOM_H
+#define __DPU_BLOOM_H
+
+/**
+ * @file dpu_bloom.h
+ * @brief Host side of the MRAM Bloom filters of the DPU runtime (mram_bloom.h).
+ *
+ * A large filter is sharded between the DPUs of a set: dpu_bloom_dpu_of gives the DPU of a key, from hash bits
+ * independent from its block and its bits in the block. A batch of keys, to insert or to probe, is routed by
+ * dpu_bloom_route into one contiguous part per DPU, which dpu_bloom_push_keys copies to the DPUs with a single
+ * scatter/gather transfer. After the DPUs probed their keys with mram_bloom_probe_keys, dpu_bloom_pull_results gathers
+ * the bits of results back in the order of the batch. The DPU set must have been allocated with scatter/gather transfers
+ * enabled (the "sgXferEnable=true" profile option).
+ *
+ * A filter can also be built, or probed, on the host, with the same hashes and layout as the DPU code.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_hash_table.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief The largest number of bits set by a key, identical to MRAM_BLOOM_MAX_HASHES on the DPU.
+ */
+#define DPU_BLOOM_MAX_HASHES 16
+
+/**
+ * @brief The hashes of a key, identical to mram_bloom_hash on the DPU.
+ * @param key the key
+ * @param bits receives the hash giving the bits of the key in its block
+ * @return The hash giving the block of the key, from its low bits.
+ */
+static inline uint32_t
+dpu_bloom_hash(uint64_t key, uint32_t *bits)
+{
+    uint32_t low = (uint32_t)key, high = (uint32_t)(key >> 32);
+
+    *bits = dpu_hash_key(high ^ dpu_hash_key(low + 0x7f4a7c15u));
+    return dpu_hash_key(low ^ dpu_hash_key(high + 0x9e3779b9u));
+}
+
+/**
+ * @brief The DPU owning a key when a filter is sharded between DPUs.
+ * @param key the key
+ * @param nr_dpus the number of DPUs
+ * @return The index of the DPU, in [0, nr_dpus).
+ */
+static inline uint32_t
+dpu_bloom_dpu_of(uint64_t key, uint32_t nr_dpus)
+{
+    uint32_t bits, block = dpu_bloom_hash(key, &bits);
+    /* The keys of a DPU still use all the blocks, and all the bits of the blocks. */
+    return (uint32_t)(((uint64_t)dpu_hash_key(block ^ bits ^ 0x5bd1e995u) * nr_dpus) >> 32);
+}
+
+/**
+ * @brief The smallest power of 2 number of blocks giving at least the given number of bits per key.
+ * @param nr_keys the number of keys
+ * @param bits_per_key the number of bits of the filter per key
+ * @param block_size the size of a block in bytes (MRAM_BLOOM_BLOCK_SIZE on the DPU)
+ * @return The number of blocks.
+ */
+static inline uint32_t
+dpu_bloom_nr_blocks(uint64_t nr_keys, uint32_t bits_per_key, uint32_t block_size)
+{
+    uint64_t nr_bits = nr_keys * bits_per_key;
+    uint32_t nr_blocks = 1;
+
+    while ((uint64_t)nr_blocks * block_size * 8 < nr_bits) {
+        nr_blocks <<= 1;
+    }
+    return nr_blocks;
+}
+
+/* The false positive rate of a blocked filter, the number of keys of a block following a Poisson distribution. */
+static inline double
+__dpu_bloom_false_positive_rate(double keys_per_block, uint32_t block_bits, uint32_t nr_hashes)
+{
+    double probability = 1.0 - keys_per_block / (1 << 20), clear = 1.0, all_clear = 1.0, rate = 0.0;
+
+    /* e^-keys_per_block, the probability of an empty block, as (1 - keys_per_block / 2^20)^(2^20). */
+    for (uint32_t i = 0; i < 20; i++) {
+        probability *= probability;
+    }
+    /* The probability of a bit not to be set by a key. */
+    for (uint32_t each_hash = 0; each_hash < nr_hashes; each_hash++) {
+        clear *= 1.0 - 1.0 / block_bits;
+    }
+    for (uint32_t nr_keys = 0; nr_keys < keys_per_block * 4 + 64; nr_keys++) {
+        double all_set = 1.0;
+        if (nr_keys != 0) {
+            probability *= keys_per_block / nr_keys;
+            all_clear *= clear;
+        }
+        for (uint32_t each_hash = 0; each_hash < nr_hashes; each_hash++) {
+            all_set *= 1.0 - all_clear;
+        }
+        rate += probability * all_set;
+    }
+    return rate;
+}
+
+/**
+ * @brief The number of bits set by a key minimizing the false positive rate of a filter.
+ *
+ * The keys being concentrated in their blocks, the best number is lower than for a filter without blocks, and much lower
+ * for small blocks.
+ *
+ * @param nr_keys the number of keys
+ * @param nr_blocks the number of blocks
+ * @param block_size the size of a block in bytes
+ * @return The number of hashes, from 1 to DPU_BLOOM_MAX_HASHES.
+ */
+static inline uint32_t
+dpu_bloom_nr_hashes(uint64_t nr_keys, uint32_t nr_blocks, uint32_t block_size)
+{
+    double keys_per_block = (double)nr_keys / nr_blocks, best_rate = 2.0;
+    uint32_t best = 1;
+
+    for (uint32_t nr_hashes = 1; nr_hashes <= DPU_BLOOM_MAX_HASHES && nr_keys != 0; nr_hashes++) {
+        double rate = __dpu_bloom_false_positive_rate(keys_per_block, block_size * 8, nr_hashes);
+        if (rate < best_rate) {
+            best_rate = rate;
+            best = nr_hashes;
+        }
+    }
+    return best;
+}
+
+/* The position in its block of the next bit of a key, as __mram_bloom_next on the DPU. */
+static inline uint32_t
+__dpu_bloom_next(uint32_t block_size, uint32_t *hash, uint32_t *unused, uint32_t *nr_unused)
+{
+    uint32_t log_bits = __builtin_ctz(block_size * 8), position;
+
+    if (*nr_unused < log_bits) {
+        *hash = dpu_hash_key(*hash + 0x9e3779b9u);
+        *unused = *hash;
+        *nr_unused = 32;
+    }
+    position = *unused & (block_size * 8 - 1);
+    *unused >>= log_bits;
+    *nr_unused -= log_bits;
+    return position;
+}
+
+/**
+ * @brief Inserts a key in a filter in host memory.
+ * @param filter the filter, of nr_blocks * block_size bytes, set to 0 when empty
+ * @param nr_blocks the number of blocks, a power of 2
+ * @param block_size the size of a block in bytes
+ * @param nr_hashes the number of bits set by a key
+ * @param key the key
+ */
+static inline void
+dpu_bloom_insert(void *filter, uint32_t nr_blocks, uint32_t block_size, uint32_t nr_hashes, uint64_t key)
+{
+    uint32_t bits, block = dpu_bloom_hash(key, &bits) & (nr_blocks - 1), unused = bits, nr_unused = 32;
+    uint32_t *words = (uint32_t *)((uint8_t *)filter + (size_t)block * block_size);
+
+    for (uint32_t each_hash = 0; each_hash < nr_hashes; each_hash++) {
+        uint32_t position = __dpu_bloom_next(block_size, &bits, &unused, &nr_unused);
+        words[position >> 5] |= 1u << (position & 31);
+    }
+}
+
+/**
+ * @brief Probes a filter in host memory for a key.
+ * @param filter the filter
+ * @param nr_blocks the number of blocks, a power of 2
+ * @param block_size the size of a block in bytes
+ * @param nr_hashes the number of bits set by a key
+ * @param key the key
+ * @return false if the key was not inserted, true if it may have been.
+ */
+static inline bool
+dpu_bloom_contains(const void *filter, uint32_t nr_blocks, uint32_t block_size, uint32_t nr_hashes, uint64_t key)
+{
+    uint32_t bits, block = dpu_bloom_hash(key, &bits) & (nr_blocks - 1), unused = bits, nr_unused = 32;
+    const uint32_t *words = (const uint32_t *)((const uint8_t *)filter + (size_t)block * block_size);
+
+    for (uint32_t each_hash = 0; each_hash < nr_hashes; each_hash++) {
+        uint32_t position = __dpu_bloom_next(block_size, &bits, &unused, &nr_unused);
+        if ((words[position >> 5] & (1u << (position & 31))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Copies one filter per DPU to the MRAM of the DPUs.
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol receiving the filters
+ * @param symbol_offset the byte offset of the filters from the symbol
+ * @param filters the filters, nr_blocks * block_size bytes each, in the order of DPU_FOREACH
+ * @param nr_blocks the number of blocks of each filter
+ * @param block_size the size of a block in bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bloom_push_filters(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    void *filters,
+    uint32_t nr_blocks,
+    uint32_t block_size)
+{
+    size_t filter_size = (size_t)nr_blocks * block_size;
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status;
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, (uint8_t *)filters + each_dpu * filter_size)) != DPU_OK) {
+            return status;
+        }
+    }
+    return dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, symbol_name, symbol_offset, filter_size, DPU_XFER_DEFAULT);
+}
+
+/**
+ * @brief A batch of keys routed to the DPUs of a set by dpu_bloom_route.
+ */
+struct dpu_bloom_batch {
+    struct dpu_set_t dpu_set;
+    uint32_t nr_dpus;
+    uint32_t nr_keys;
+    /** The keys, grouped by DPU. */
+    uint64_t *keys;
+    /** DPU i holds the keys [first_keys[i], first_keys[i + 1]). */
+    uint32_t *first_keys;
+    /** The index in the batch of each routed key. */
+    uint32_t *origins;
+    /** The largest number of keys of a DPU. */
+    uint32_t max_keys;
+};
+
+/**
+ * @brief Frees a batch routed by dpu_bloom_route.
+ * @param batch the batch
+ */
+static inline void
+dpu_bloom_batch_free(struct dpu_bloom_batch *batch)
+{
+    free(batch->keys);
+    free(batch->first_keys);
+    free(batch->origins);
+    batch->keys = NULL;
+    batch->first_keys = NULL;
+    batch->origins = NULL;
+}
+
+/**
+ * @brief Routes a batch of keys to the DPUs owning them, keeping the order of the keys of each DPU.
+ * @param dpu_set the DPU set
+ * @param keys the keys
+ * @param nr_keys the number of keys
+ * @param batch receives the routed keys, to be freed with dpu_bloom_batch_free
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bloom_route(struct dpu_set_t dpu_set, const uint64_t *keys, uint32_t nr_keys, struct dpu_bloom_batch *batch)
+{
+    uint32_t *owners = NULL, *next = NULL, each_dpu;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &batch->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    batch->dpu_set = dpu_set;
+    batch->nr_keys = nr_keys;
+    batch->max_keys = 0;
+    batch->keys = malloc((size_t)nr_keys * sizeof(uint64_t) + sizeof(uint64_t));
+    batch->first_keys = calloc(batch->nr_dpus + 1, sizeof(uint32_t));
+    batch->origins = malloc((size_t)nr_keys * sizeof(uint32_t) + sizeof(uint32_t));
+    owners = malloc((size_t)nr_keys * sizeof(uint32_t) + sizeof(uint32_t));
+    next = malloc(batch->nr_dpus * sizeof(uint32_t));
+    if (batch->keys == NULL || batch->first_keys == NULL || batch->origins == NULL || owners == NULL || next == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    for (uint32_t each_key = 0; each_key < nr_keys; each_key++) {
+        owners[each_key] = dpu_bloom_dpu_of(keys[each_key], batch->nr_dpus);
+        batch->first_keys[owners[each_key] + 1]++;
+    }
+    for (each_dpu = 0; each_dpu < batch->nr_dpus; each_dpu++) {
+        uint32_t nr = batch->first_keys[each_dpu + 1];
+        batch->max_keys = nr > batch->max_keys ? nr : batch->max_keys;
+        batch->first_keys[each_dpu + 1] += batch->first_keys[each_dpu];
+        next[each_dpu] = batch->first_keys[each_dpu];
+    }
+    for (uint32_t each_key = 0; each_key < nr_keys; each_key++) {
+        uint32_t to = next[owners[each_key]]++;
+        batch->keys[to] = keys[each_key];
+        batch->origins[to] = each_key;
+    }
+
+end:
+    if (status != DPU_OK) {
+        dpu_bloom_batch_free(batch);
+    }
+    free(owners);
+    free(next);
+    return status;
+}
+
+/**
+ * @brief Copies the keys of each DPU of a routed batch to the DPUs, with their number.
+ *
+ * The DPU program must define the MRAM buffer receiving the keys, and a uint32_t variable receiving their number. Only
+ * the keys of each DPU are transferred.
+ *
+ * @param batch the batch, routed by dpu_bloom_route
+ * @param symbol_name the DPU symbol receiving the keys
+ * @param symbol_offset the byte offset of the keys from the symbol
+ * @param count_symbol_name the DPU symbol receiving the number of keys
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bloom_push_keys(struct dpu_bloom_batch *batch,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    const char *count_symbol_name)
+{
+    uint64_t *offsets = malloc((batch->nr_dpus + 1) * sizeof(uint64_t));
+    uint32_t *counts = malloc(batch->nr_dpus * sizeof(uint32_t)), each_dpu;
+    struct dpu_set_t dpu;
+    dpu_error_t status = DPU_OK;
+
+    if (offsets == NULL || counts == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    for (each_dpu = 0; each_dpu <= batch->nr_dpus; each_dpu++) {
+        offsets[each_dpu] = (uint64_t)batch->first_keys[each_dpu] * sizeof(uint64_t);
+    }
+    for (each_dpu = 0; each_dpu < batch->nr_dpus; each_dpu++) {
+        counts[each_dpu] = batch->first_keys[each_dpu + 1] - batch->first_keys[each_dpu];
+    }
+    status = dpu_push_varlen_xfer(batch->dpu_set,
+        DPU_XFER_TO_DPU,
+        symbol_name,
+        symbol_offset,
+        batch->keys,
+        offsets,
+        (size_t)batch->max_keys * sizeof(uint64_t),
+        DPU_SG_XFER_DEFAULT);
+    DPU_FOREACH (batch->dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &counts[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(batch->dpu_set, DPU_XFER_TO_DPU, count_symbol_name, 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+
+end:
+    free(offsets);
+    free(counts);
+    return status;
+}
+
+/**
+ * @brief Gathers the results of the probes of a routed batch, written by mram_bloom_probe_keys, in the order of the batch.
+ * @param batch the batch, routed by dpu_bloom_route
+ * @param symbol_name the DPU symbol holding the results
+ * @param symbol_offset the byte offset of the results from the symbol
+ * @param results receives the results, (nr_keys + 63) / 64 words: bit i % 64 of results[i / 64] is set when key i of the
+ * batch may have been inserted
+ * @param nr_found receives the number of keys of the batch which may have been inserted
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_bloom_pull_results(struct dpu_bloom_batch *batch,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    uint64_t *results,
+    uint64_t *nr_found)
+{
+    uint64_t *sizes = malloc(batch->nr_dpus * sizeof(uint64_t));
+    uint64_t *offsets = malloc((batch->nr_dpus + 1) * sizeof(uint64_t));
+    uint64_t *words = NULL;
+    uint32_t each_dpu;
+    size_t max_length;
+    dpu_error_t status = DPU_OK;
+
+    if (sizes == NULL || offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    for (each_dpu = 0; each_dpu < batch->nr_dpus; each_dpu++) {
+        uint32_t nr = batch->first_keys[each_dpu + 1] - batch->first_keys[each_dpu];
+        sizes[each_dpu] = (uint64_t)(nr + 63) / 64 * sizeof(uint64_t);
+    }
+    max_length = dpu_varlen_offsets(sizes, batch->nr_dpus, offsets);
+    if ((words = malloc(offsets[batch->nr_dpus] + sizeof(uint64_t))) == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    status = dpu_push_varlen_xfer(
+        batch->dpu_set, DPU_XFER_FROM_DPU, symbol_name, symbol_offset, words, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    if (status != DPU_OK) {
+        goto end;
+    }
+
+    memset(results, 0, (size_t)(batch->nr_keys + 63) / 64 * sizeof(uint64_t));
+    *nr_found = 0;
+    for (each_dpu = 0; each_dpu < batch->nr_dpus; each_dpu++) {
+        const uint64_t *found = &words[offsets[each_dpu] / sizeof(uint64_t)];
+        uint32_t first = batch->first_keys[each_dpu];
+        uint32_t nr = batch->first_keys[each_dpu + 1] - first;
+
+        for (uint32_t each_key = 0; each_key < nr; each_key++) {
+            if ((found[each_key / 64] >> (each_key % 64)) & 1) {
+                uint32_t origin = batch->origins[first + each_key];
+                results[origin / 64] |= (uint64_t)1 << (origin % 64);
+                (*nr_found)++;
+            }
+        }
+    }
+
+end:
+    free(sizes);
+    free(offsets);
+    free(words);
+    return status;
+}
+
+#endif /* __DPU_BLOOM_H */
@@ -0,0 +1,452 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_CHECKSUM_H
+#define __DPU_CHECKSUM_H
+
+/**
+ * @file dpu_checksum.h
+ * @brief Host side of the checksums of the DPU runtime (checksum.h): CRC32C, xxHash32 and xxHash64.
+ *
+ * The checksums are identical to the checksums computed by the DPUs, so that data transferred to the DPUs can be checked
+ * without being transferred back. CRC32C uses the SSE 4.2 crc32 instruction when the host code is compiled for it, and a
+ * table otherwise. The CRC32C of the data held by several DPUs is combined with dpu_checksum_crc32c_combine into the
+ * CRC32C of the whole data.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+/**
+ * @brief The state of an xxHash32 computation.
+ */
+struct dpu_checksum_xxh32 {
+    uint32_t lanes[4];
+    uint8_t buffer[16];
+    uint64_t total_length;
+    uint32_t nr_buffered;
+};
+
+/**
+ * @brief The state of an xxHash64 computation.
+ */
+struct dpu_checksum_xxh64 {
+    uint64_t lanes[4];
+    uint8_t buffer[32];
+    uint64_t total_length;
+    uint32_t nr_buffered;
+};
+
+#define __DPU_CHECKSUM_CRC32C_POLYNOMIAL 0x82f63b78u
+
+/* The CRC32C of each byte. */
+static const uint32_t __dpu_checksum_crc32c_table[256] = {
+    0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+    0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b, 0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+    0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+    0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+    0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a, 0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+    0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+    0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+    0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a, 0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+    0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+    0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+    0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927, 0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+    0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+    0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+    0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859, 0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+    0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+    0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+    0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c, 0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+    0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+    0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+    0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c, 0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+    0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+    0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+    0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d, 0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+    0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+    0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+    0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff, 0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+    0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+    0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+    0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee, 0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+    0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+    0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+    0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e, 0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351,
+};
+
+#define __DPU_CHECKSUM_XXH32_PRIME1 0x9e3779b1u
+#define __DPU_CHECKSUM_XXH32_PRIME2 0x85ebca77u
+#define __DPU_CHECKSUM_XXH32_PRIME3 0xc2b2ae3du
+#define __DPU_CHECKSUM_XXH32_PRIME4 0x27d4eb2fu
+#define __DPU_CHECKSUM_XXH32_PRIME5 0x165667b1u
+
+#define __DPU_CHECKSUM_XXH64_PRIME1 0x9e3779b185ebca87ull
+#define __DPU_CHECKSUM_XXH64_PRIME2 0xc2b2ae3d27d4eb4full
+#define __DPU_CHECKSUM_XXH64_PRIME3 0x165667b19e3779f9ull
+#define __DPU_CHECKSUM_XXH64_PRIME4 0x85ebca77c2b2ae63ull
+#define __DPU_CHECKSUM_XXH64_PRIME5 0x27d4eb2f165667c5ull
+
+/* Little-endian reads, the byte order of the DPUs and of the hosts they are attached to. */
+static inline uint32_t
+__dpu_checksum_read32(const uint8_t *bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint64_t
+__dpu_checksum_read64(const uint8_t *bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint32_t
+__dpu_checksum_rotl32(uint32_t x, uint32_t r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t
+__dpu_checksum_rotl64(uint64_t x, uint32_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @brief Computes the CRC32C of a buffer, identical to checksum_crc32c on the DPU.
+ * @param crc the CRC32C of the previous bytes, 0 for the first buffer
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @return The CRC32C of the previous bytes followed by the buffer.
+ */
+static inline uint32_t
+dpu_checksum_crc32c(uint32_t crc, const void *buffer, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer;
+
+    crc = ~crc;
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    {
+        uint64_t wide = crc;
+        for (; length >= 8; length -= 8, bytes += 8) {
+            wide = _mm_crc32_u64(wide, __dpu_checksum_read64(bytes));
+        }
+        crc = (uint32_t)wide;
+        for (; length != 0; length--) {
+            crc = _mm_crc32_u8(crc, *bytes++);
+        }
+    }
+#else
+    for (; length != 0; length--) {
+        crc = __dpu_checksum_crc32c_table[(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+    }
+#endif
+    return ~crc;
+}
+
+/* The product of two polynomials modulo the CRC32C polynomial, bit-reversed. */
+static inline uint32_t
+__dpu_checksum_crc32c_multiply(uint32_t a, uint32_t b)
+{
+    uint32_t mask = 1u << 31, product = 0;
+
+    while (true) {
+        if ((a & mask) != 0) {
+            product ^= b;
+            if ((a & (mask - 1)) == 0) {
+                return product;
+            }
+        }
+        mask >>= 1;
+        b = (b & 1) != 0 ? (b >> 1) ^ __DPU_CHECKSUM_CRC32C_POLYNOMIAL : b >> 1;
+    }
+}
+
+/**
+ * @brief Computes the CRC32C of two consecutive sequences of bytes from their CRC32C, identical to
+ * checksum_crc32c_combine on the DPU.
+ * @param crc_a the CRC32C of the first sequence
+ * @param crc_b the CRC32C of the second sequence
+ * @param length_b the length of the second sequence, in bytes
+ * @return The CRC32C of the first sequence followed by the second.
+ */
+static inline uint32_t
+dpu_checksum_crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t length_b)
+{
+    /* x^(8.2^k) modulo the polynomial, starting from x^8, and x^(8.length_b). */
+    uint32_t square = 1u << 23, power = 1u << 31;
+
+    for (; length_b != 0; length_b >>= 1) {
+        if ((length_b & 1) != 0) {
+            power = __dpu_checksum_crc32c_multiply(square, power);
+        }
+        square = __dpu_checksum_crc32c_multiply(square, square);
+    }
+    return __dpu_checksum_crc32c_multiply(power, crc_a) ^ crc_b;
+}
+
+static inline uint32_t
+__dpu_checksum_xxh32_round(uint32_t lane, uint32_t input)
+{
+    return __dpu_checksum_rotl32(lane + input * __DPU_CHECKSUM_XXH32_PRIME2, 13) * __DPU_CHECKSUM_XXH32_PRIME1;
+}
+
+static inline void
+__dpu_checksum_xxh32_stripe(uint32_t *lanes, const uint8_t *input)
+{
+    for (uint32_t each_lane = 0; each_lane < 4; each_lane++) {
+        lanes[each_lane] = __dpu_checksum_xxh32_round(lanes[each_lane], __dpu_checksum_read32(input + 4 * each_lane));
+    }
+}
+
+/**
+ * @brief Starts an xxHash32 computation.
+ * @param state the state of the computation
+ * @param seed the seed of the hash
+ */
+static inline void
+dpu_checksum_xxh32_reset(struct dpu_checksum_xxh32 *state, uint32_t seed)
+{
+    state->lanes[0] = seed + __DPU_CHECKSUM_XXH32_PRIME1 + __DPU_CHECKSUM_XXH32_PRIME2;
+    state->lanes[1] = seed + __DPU_CHECKSUM_XXH32_PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - __DPU_CHECKSUM_XXH32_PRIME1;
+    state->total_length = 0;
+    state->nr_buffered = 0;
+}
+
+/**
+ * @brief Adds a buffer to an xxHash32 computation.
+ * @param state the state of the computation
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ */
+static inline void
+dpu_checksum_xxh32_update(struct dpu_checksum_xxh32 *state, const void *buffer, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer, *end = bytes + length;
+
+    state->total_length += length;
+    if (state->nr_buffered + length < 16) {
+        memcpy(state->buffer + state->nr_buffered, bytes, length);
+        state->nr_buffered += (uint32_t)length;
+        return;
+    }
+    if (state->nr_buffered != 0) {
+        memcpy(state->buffer + state->nr_buffered, bytes, 16 - state->nr_buffered);
+        __dpu_checksum_xxh32_stripe(state->lanes, state->buffer);
+        bytes += 16 - state->nr_buffered;
+    }
+    for (; end - bytes >= 16; bytes += 16) {
+        __dpu_checksum_xxh32_stripe(state->lanes, bytes);
+    }
+    state->nr_buffered = (uint32_t)(end - bytes);
+    memcpy(state->buffer, bytes, state->nr_buffered);
+}
+
+/**
+ * @brief Computes the xxHash32 of the buffers added to a computation, which can go on.
+ * @param state the state of the computation
+ * @return The xxHash32 of the buffers.
+ */
+static inline uint32_t
+dpu_checksum_xxh32_digest(const struct dpu_checksum_xxh32 *state)
+{
+    const uint8_t *bytes = state->buffer;
+    uint32_t hash, remaining = state->nr_buffered;
+
+    if (state->total_length >= 16) {
+        hash = __dpu_checksum_rotl32(state->lanes[0], 1) + __dpu_checksum_rotl32(state->lanes[1], 7)
+            + __dpu_checksum_rotl32(state->lanes[2], 12) + __dpu_checksum_rotl32(state->lanes[3], 18);
+    } else {
+        hash = state->lanes[2] + __DPU_CHECKSUM_XXH32_PRIME5;
+    }
+    hash += (uint32_t)state->total_length;
+
+    for (; remaining >= 4; remaining -= 4, bytes += 4) {
+        hash += __dpu_checksum_read32(bytes) * __DPU_CHECKSUM_XXH32_PRIME3;
+        hash = __dpu_checksum_rotl32(hash, 17) * __DPU_CHECKSUM_XXH32_PRIME4;
+    }
+    for (; remaining != 0; remaining--, bytes++) {
+        hash += *bytes * __DPU_CHECKSUM_XXH32_PRIME5;
+        hash = __dpu_checksum_rotl32(hash, 11) * __DPU_CHECKSUM_XXH32_PRIME1;
+    }
+
+    hash = (hash ^ (hash >> 15)) * __DPU_CHECKSUM_XXH32_PRIME2;
+    hash = (hash ^ (hash >> 13)) * __DPU_CHECKSUM_XXH32_PRIME3;
+    return hash ^ (hash >> 16);
+}
+
+/**
+ * @brief Computes the xxHash32 of a buffer, identical to checksum_xxh32 on the DPU.
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @param seed the seed of the hash
+ * @return The xxHash32 of the buffer.
+ */
+static inline uint32_t
+dpu_checksum_xxh32(const void *buffer, size_t length, uint32_t seed)
+{
+    struct dpu_checksum_xxh32 state;
+
+    dpu_checksum_xxh32_reset(&state, seed);
+    dpu_checksum_xxh32_update(&state, buffer, length);
+    return dpu_checksum_xxh32_digest(&state);
+}
+
+static inline uint64_t
+__dpu_checksum_xxh64_round(uint64_t lane, uint64_t input)
+{
+    return __dpu_checksum_rotl64(lane + input * __DPU_CHECKSUM_XXH64_PRIME2, 31) * __DPU_CHECKSUM_XXH64_PRIME1;
+}
+
+static inline void
+__dpu_checksum_xxh64_stripe(uint64_t *lanes, const uint8_t *input)
+{
+    for (uint32_t each_lane = 0; each_lane < 4; each_lane++) {
+        lanes[each_lane] = __dpu_checksum_xxh64_round(lanes[each_lane], __dpu_checksum_read64(input + 8 * each_lane));
+    }
+}
+
+/**
+ * @brief Starts an xxHash64 computation.
+ * @param state the state of the computation
+ * @param seed the seed of the hash
+ */
+static inline void
+dpu_checksum_xxh64_reset(struct dpu_checksum_xxh64 *state, uint64_t seed)
+{
+    state->lanes[0] = seed + __DPU_CHECKSUM_XXH64_PRIME1 + __DPU_CHECKSUM_XXH64_PRIME2;
+    state->lanes[1] = seed + __DPU_CHECKSUM_XXH64_PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - __DPU_CHECKSUM_XXH64_PRIME1;
+    state->total_length = 0;
+    state->nr_buffered = 0;
+}
+
+/**
+ * @brief Adds a buffer to an xxHash64 computation.
+ * @param state the state of the computation
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ */
+static inline void
+dpu_checksum_xxh64_update(struct dpu_checksum_xxh64 *state, const void *buffer, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer, *end = bytes + length;
+
+    state->total_length += length;
+    if (state->nr_buffered + length < 32) {
+        memcpy(state->buffer + state->nr_buffered, bytes, length);
+        state->nr_buffered += (uint32_t)length;
+        return;
+    }
+    if (state->nr_buffered != 0) {
+        memcpy(state->buffer + state->nr_buffered, bytes, 32 - state->nr_buffered);
+        __dpu_checksum_xxh64_stripe(state->lanes, state->buffer);
+        bytes += 32 - state->nr_buffered;
+    }
+    for (; end - bytes >= 32; bytes += 32) {
+        __dpu_checksum_xxh64_stripe(state->lanes, bytes);
+    }
+    state->nr_buffered = (uint32_t)(end - bytes);
+    memcpy(state->buffer, bytes, state->nr_buffered);
+}
+
+/**
+ * @brief Computes the xxHash64 of the buffers added to a computation, which can go on.
+ * @param state the state of the computation
+ * @return The xxHash64 of the buffers.
+ */
+static inline uint64_t
+dpu_checksum_xxh64_digest(const struct dpu_checksum_xxh64 *state)
+{
+    const uint8_t *bytes = state->buffer;
+    uint32_t remaining = state->nr_buffered;
+    uint64_t hash;
+
+    if (state->total_length >= 32) {
+        hash = __dpu_checksum_rotl64(state->lanes[0], 1) + __dpu_checksum_rotl64(state->lanes[1], 7)
+            + __dpu_checksum_rotl64(state->lanes[2], 12) + __dpu_checksum_rotl64(state->lanes[3], 18);
+        for (uint32_t each_lane = 0; each_lane < 4; each_lane++) {
+            hash ^= __dpu_checksum_xxh64_round(0, state->lanes[each_lane]);
+            hash = hash * __DPU_CHECKSUM_XXH64_PRIME1 + __DPU_CHECKSUM_XXH64_PRIME4;
+        }
+    } else {
+        hash = state->lanes[2] + __DPU_CHECKSUM_XXH64_PRIME5;
+    }
+    hash += state->total_length;
+
+    for (; remaining >= 8; remaining -= 8, bytes += 8) {
+        hash ^= __dpu_checksum_xxh64_round(0, __dpu_checksum_read64(bytes));
+        hash = __dpu_checksum_rotl64(hash, 27) * __DPU_CHECKSUM_XXH64_PRIME1 + __DPU_CHECKSUM_XXH64_PRIME4;
+    }
+    if (remaining >= 4) {
+        hash ^= __dpu_checksum_read32(bytes) * __DPU_CHECKSUM_XXH64_PRIME1;
+        hash = __dpu_checksum_rotl64(hash, 23) * __DPU_CHECKSUM_XXH64_PRIME2 + __DPU_CHECKSUM_XXH64_PRIME3;
+        remaining -= 4;
+        bytes += 4;
+    }
+    for (; remaining != 0; remaining--, bytes++) {
+        hash ^= *bytes * __DPU_CHECKSUM_XXH64_PRIME5;
+        hash = __dpu_checksum_rotl64(hash, 11) * __DPU_CHECKSUM_XXH64_PRIME1;
+    }
+
+    hash = (hash ^ (hash >> 33)) * __DPU_CHECKSUM_XXH64_PRIME2;
+    hash = (hash ^ (hash >> 29)) * __DPU_CHECKSUM_XXH64_PRIME3;
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * @brief Computes the xxHash64 of a buffer, identical to checksum_xxh64 on the DPU.
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @param seed the seed of the hash
+ * @return The xxHash64 of the buffer.
+ */
+static inline uint64_t
+dpu_checksum_xxh64(const void *buffer, size_t length, uint64_t seed)
+{
+    struct dpu_checksum_xxh64 state;
+
+    dpu_checksum_xxh64_reset(&state, seed);
+    dpu_checksum_xxh64_update(&state, buffer, length);
+    return dpu_checksum_xxh64_digest(&state);
+}
+
+/**
+ * @brief Computes the chunked xxHash64 of a buffer, identical to checksum_mram_xxh64 on the DPU: the xxHash64 of the
+ * little-endian xxHash64 of the chunks of chunk_size bytes of the buffer, the last one being shorter.
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @param chunk_size the size of the chunks, in bytes
+ * @param seed the seed of the hashes
+ * @return The chunked xxHash64 of the buffer.
+ */
+static inline uint64_t
+dpu_checksum_xxh64_chunked(const void *buffer, size_t length, size_t chunk_size, uint64_t seed)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer;
+    struct dpu_checksum_xxh64 state;
+
+    dpu_checksum_xxh64_reset(&state, seed);
+    for (size_t from = 0; from < length; from += chunk_size) {
+        uint64_t digest = dpu_checksum_xxh64(bytes + from, length - from < chunk_size ? length - from : chunk_size, seed);
+        dpu_checksum_xxh64_update(&state, &digest, sizeof(digest));
+    }
+    return dpu_checksum_xxh64_digest(&state);
+}
+
+#endif /* __DPU_CHECKSUM_H */
@@ -0,0 +1,536 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_COLLECTIVE_H
+#define __DPU_COLLECTIVE_H
+
+/**
+ * @file dpu_collective.h
+ * @brief Collective operations between the DPUs of a set: allreduce, reduce-scatter and broadcast.
+ *
+ * Each DPU holds a vector of the same number of values, such as the gradient computed on its part of the data by an
+ * iteration of a training. dpu_collective_allreduce sums the vectors of all the DPUs on the host, and sends the sum to
+ * every DPU. dpu_collective_reduce_scatter sends to each DPU only its slice of the sum, the DPUs holding the slices in
+ * the order of DPU_FOREACH. dpu_collective_broadcast sends a vector of the host to every DPU.
+ *
+ * The reductions are pipelined by chunks and by ranks: while the values of a rank are summed on the host, the values of
+ * the next rank are gathered, and the sum of a chunk is sent back to the DPUs while the next chunk is gathered and
+ * summed. Every transfer is asynchronous, on the ranks of the set in parallel, and the transfers of a rank are done in
+ * their order. The values of each DPU are summed into an accumulator of a chunk, which stays in the cache of the host,
+ * with AVX2 or SSE2 when they are available. A chunk is DPU_COLLECTIVE_CHUNK_SIZE bytes of the vectors for an allreduce,
+ * and the slices of the DPUs of a rank for a reduce-scatter, whose sums are sent to the rank at once.
+ *
+ * The int32 and int64 values wrap around, like the additions of the DPU. The Q15.16 fixed-point values (dpu_fixed_q16_t)
+ * are summed exactly, then saturated, which is the result of a sequence of fixed_q16_add when none of them saturates.
+ *
+ * The host memory used is twice the values of a chunk of the largest rank, plus the sum of the vectors.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief Number of bytes of the vector of each DPU gathered by each step of dpu_collective_allreduce, a multiple of 8.
+ */
+#define DPU_COLLECTIVE_CHUNK_SIZE (32 << 10)
+
+/**
+ * @brief The types of the values of the vectors.
+ */
+typedef enum _dpu_collective_type_t {
+    DPU_COLLECTIVE_INT32 = 0,
+    DPU_COLLECTIVE_INT64 = 1,
+    /** Q15.16 fixed-point values, as dpu_fixed_q16_t and fixed_q16_t on the DPU. */
+    DPU_COLLECTIVE_FIXED_Q16 = 2,
+} dpu_collective_type_t;
+
+/**
+ * @brief The ranks of a DPU set, and the buffers of the collective operations between its DPUs.
+ */
+struct dpu_collective {
+    /** The DPU set. */
+    struct dpu_set_t dpu_set;
+    /** The number of DPUs of the set. */
+    uint32_t nr_dpus;
+    /** The number of ranks of the set. */
+    uint32_t nr_ranks;
+    /** The ranks of the set, in the order of DPU_RANK_FOREACH. */
+    struct dpu_set_t *ranks;
+    /** The index of the first DPU of each rank, in the order of DPU_FOREACH, and the number of DPUs of the set. */
+    uint32_t *first_dpus;
+    /** The largest number of DPUs of a rank. */
+    uint32_t max_rank_dpus;
+    /** The sum of the vectors of the last reduction, padded with zeros to a multiple of 8 bytes or of the slices. */
+    void *result;
+    /** The size of the slice of each DPU of the last reduce-scatter, in bytes. */
+    size_t slice_size;
+    /* The buffers receiving the values of a chunk of a rank, one being filled while the other is summed. */
+    uint8_t *buffers[2];
+    /* The accumulators of the fixed-point values of a chunk. */
+    int64_t *sums;
+    size_t result_capacity;
+    size_t chunk_capacity;
+};
+
+/**
+ * @brief The size of a value of a type, in bytes.
+ */
+static inline size_t
+dpu_collective_type_size(dpu_collective_type_t type)
+{
+    return type == DPU_COLLECTIVE_INT64 ? sizeof(int64_t) : sizeof(int32_t);
+}
+
+/**
+ * @brief Initializes the collective operations between the DPUs of a set.
+ * @param c the state to initialize, to be freed by dpu_collective_free
+ * @param dpu_set the DPU set
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_collective_init(struct dpu_collective *c, struct dpu_set_t dpu_set)
+{
+    struct dpu_set_t rank;
+    uint32_t each_rank, nr_dpus;
+    dpu_error_t status;
+
+    memset(c, 0, sizeof(*c));
+    c->dpu_set = dpu_set;
+    if ((status = dpu_get_nr_dpus(dpu_set, &c->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    if ((status = dpu_get_nr_ranks(dpu_set, &c->nr_ranks)) != DPU_OK) {
+        return status;
+    }
+    c->ranks = malloc(c->nr_ranks * sizeof(struct dpu_set_t));
+    c->first_dpus = malloc((c->nr_ranks + 1) * sizeof(uint32_t));
+    if (c->ranks == NULL || c->first_dpus == NULL) {
+        free(c->ranks);
+        free(c->first_dpus);
+        return DPU_ERR_SYSTEM;
+    }
+
+    c->first_dpus[0] = 0;
+    DPU_RANK_FOREACH (dpu_set, rank, each_rank) {
+        if ((status = dpu_get_nr_dpus(rank, &nr_dpus)) != DPU_OK) {
+            free(c->ranks);
+            free(c->first_dpus);
+            return status;
+        }
+        c->ranks[each_rank] = rank;
+        c->first_dpus[each_rank + 1] = c->first_dpus[each_rank] + nr_dpus;
+        if (nr_dpus > c->max_rank_dpus) {
+            c->max_rank_dpus = nr_dpus;
+        }
+    }
+    return DPU_OK;
+}
+
+/**
+ * @brief Frees the state of the collective operations, including its result.
+ * @param c the state
+ */
+static inline void
+dpu_collective_free(struct dpu_collective *c)
+{
+    free(c->ranks);
+    free(c->first_dpus);
+    free(c->result);
+    free(c->buffers[0]);
+    free(c->buffers[1]);
+    free(c->sums);
+    memset(c, 0, sizeof(*c));
+}
+
+/* Grows the result to result_size bytes, and the buffers to chunks of chunk_size bytes of the largest rank. */
+static inline dpu_error_t
+__dpu_collective_reserve(struct dpu_collective *c, size_t result_size, size_t chunk_size)
+{
+    if (result_size > c->result_capacity) {
+        free(c->result);
+        if ((c->result = malloc(result_size)) == NULL) {
+            c->result_capacity = 0;
+            return DPU_ERR_SYSTEM;
+        }
+        c->result_capacity = result_size;
+    }
+    if (chunk_size > c->chunk_capacity) {
+        free(c->buffers[0]);
+        free(c->buffers[1]);
+        free(c->sums);
+        c->buffers[0] = malloc(c->max_rank_dpus * chunk_size);
+        c->buffers[1] = malloc(c->max_rank_dpus * chunk_size);
+        c->sums = malloc(chunk_size / sizeof(int32_t) * sizeof(int64_t));
+        if (c->buffers[0] == NULL || c->buffers[1] == NULL || c->sums == NULL) {
+            free(c->buffers[0]);
+            free(c->buffers[1]);
+            free(c->sums);
+            c->buffers[0] = c->buffers[1] = NULL;
+            c->sums = NULL;
+            c->chunk_capacity = 0;
+            return DPU_ERR_SYSTEM;
+        }
+        c->chunk_capacity = chunk_size;
+    }
+    return DPU_OK;
+}
+
+/* Adds n int32 values to the accumulators, wrapping around. */
+static inline void
+__dpu_collective_add_i32(int32_t *to, const int32_t *from, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 8 <= n; i += 8) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&from[i]);
+        _mm256_storeu_si256((__m256i *)&to[i], _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)&to[i]), x));
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&from[i]);
+        _mm_storeu_si128((__m128i *)&to[i], _mm_add_epi32(_mm_loadu_si128((const __m128i *)&to[i]), x));
+    }
+#endif
+    for (; i < n; i++) {
+        to[i] = (int32_t)((uint32_t)to[i] + (uint32_t)from[i]);
+    }
+}
+
+/* Adds n int64 values to the accumulators, wrapping around. */
+static inline void
+__dpu_collective_add_i64(int64_t *to, const int64_t *from, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)&from[i]);
+        _mm256_storeu_si256((__m256i *)&to[i], _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)&to[i]), x));
+    }
+#elif defined(__SSE2__)
+    for (; i + 2 <= n; i += 2) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&from[i]);
+        _mm_storeu_si128((__m128i *)&to[i], _mm_add_epi64(_mm_loadu_si128((const __m128i *)&to[i]), x));
+    }
+#endif
+    for (; i < n; i++) {
+        to[i] = (int64_t)((uint64_t)to[i] + (uint64_t)from[i]);
+    }
+}
+
+/* Adds n int32 values, sign-extended, to the int64 accumulators, which cannot overflow with less than 2^32 DPUs. */
+static inline void
+__dpu_collective_add_wide(int64_t *to, const int32_t *from, size_t n)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)&from[i]));
+        _mm256_storeu_si256((__m256i *)&to[i], _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)&to[i]), x));
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)&from[i]);
+        __m128i sign = _mm_srai_epi32(x, 31);
+        __m128i low = _mm_add_epi64(_mm_loadu_si128((const __m128i *)&to[i]), _mm_unpacklo_epi32(x, sign));
+        __m128i high = _mm_add_epi64(_mm_loadu_si128((const __m128i *)&to[i + 2]), _mm_unpackhi_epi32(x, sign));
+        _mm_storeu_si128((__m128i *)&to[i], low);
+        _mm_storeu_si128((__m128i *)&to[i + 2], high);
+    }
+#endif
+    for (; i < n; i++) {
+        to[i] += from[i];
+    }
+}
+
+/* Adds the values of a chunk of a DPU, of size bytes, to the accumulators of the chunk, or copies them when first. */
+static inline void
+__dpu_collective_accumulate(
+    struct dpu_collective *c, dpu_collective_type_t type, uint8_t *to, const uint8_t *from, size_t size, bool first)
+{
+    switch (type) {
+        case DPU_COLLECTIVE_INT32:
+            if (first) {
+                memcpy(to, from, size);
+            } else {
+                __dpu_collective_add_i32((int32_t *)to, (const int32_t *)from, size / sizeof(int32_t));
+            }
+            break;
+        case DPU_COLLECTIVE_INT64:
+            if (first) {
+                memcpy(to, from, size);
+            } else {
+                __dpu_collective_add_i64((int64_t *)to, (const int64_t *)from, size / sizeof(int64_t));
+            }
+            break;
+        case DPU_COLLECTIVE_FIXED_Q16:
+            if (first) {
+                memset(c->sums, 0, size / sizeof(int32_t) * sizeof(int64_t));
+            }
+            __dpu_collective_add_wide(c->sums, (const int32_t *)from, size / sizeof(int32_t));
+            break;
+    }
+}
+
+/* Saturates the exact sums of the fixed-point values of a chunk of size bytes into the result. */
+static inline void
+__dpu_collective_saturate(struct dpu_collective *c, int32_t *to, size_t size)
+{
+    for (size_t i = 0; i < size / sizeof(int32_t); i++) {
+        int64_t sum = c->sums[i];
+        to[i] = sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : (int32_t)sum;
+    }
+}
+
+/* The bytes [*start, *end) of a chunk of the result: chunk_size bytes each, or the slices of the DPUs of its rank. */
+static inline void
+__dpu_collective_chunk(struct dpu_collective *c,
+    uint32_t chunk,
+    uint32_t nr_chunks,
+    size_t chunk_size,
+    size_t result_size,
+    bool scatter,
+    size_t *start,
+    size_t *end)
+{
+    *start = scatter ? c->first_dpus[chunk] * c->slice_size : chunk * chunk_size;
+    *end = chunk + 1 == nr_chunks ? result_size : scatter ? c->first_dpus[chunk + 1] * c->slice_size : *start + chunk_size;
+}
+
+/* Gathers size bytes at offset of the symbol from each DPU of a rank, one after the other in the buffer, asynchronously. */
+static inline dpu_error_t
+__dpu_collective_gather(
+    struct dpu_collective *c, uint32_t rank, const char *symbol, uint32_t offset, size_t size, uint8_t *buffer)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status;
+
+    if (size == 0) {
+        return DPU_OK;
+    }
+    DPU_FOREACH (c->ranks[rank], dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, &buffer[each_dpu * size])) != DPU_OK) {
+            return status;
+        }
+    }
+    return dpu_push_xfer(c->ranks[rank], DPU_XFER_FROM_DPU, symbol, offset, size, DPU_XFER_ASYNC);
+}
+
+/*
+ * Sums the first data_size bytes of the vectors of all the DPUs into the result of result_size bytes, chunk by chunk,
+ * and sends each chunk of the result as soon as it is summed: to every DPU, or to the DPUs of its rank when scattering.
+ * Step s gathers chunk s / nr_ranks from rank s % nr_ranks into buffers[s & 1]. The vectors are gathered up to a multiple
+ * of 8 bytes, the bytes after data_size being zeroed before the sum.
+ */
+static inline dpu_error_t
+__dpu_collective_reduce(struct dpu_collective *c,
+    dpu_collective_type_t type,
+    const char *symbol,
+    uint32_t symbol_offset,
+    const char *result_symbol,
+    uint32_t result_offset,
+    size_t data_size,
+    size_t result_size,
+    size_t chunk_size,
+    bool scatter)
+{
+    uint32_t nr_chunks = result_size == 0 ? 0 : scatter ? c->nr_ranks : (uint32_t)((result_size + chunk_size - 1) / chunk_size);
+    uint32_t nr_steps = nr_chunks * c->nr_ranks;
+    uint8_t *result = c->result;
+    size_t gathered_size = (data_size + 7) & ~(size_t)7;
+    size_t start, end, sizes[2] = { 0, 0 };
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status = DPU_OK, sync_status;
+
+    for (uint32_t each_step = 0; each_step < nr_steps; each_step++) {
+        uint32_t chunk = each_step / c->nr_ranks, rank = each_step % c->nr_ranks;
+        size_t size;
+
+        if (each_step == 0) {
+            __dpu_collective_chunk(c, 0, nr_chunks, chunk_size, result_size, scatter, &start, &end);
+            sizes[0] = start < gathered_size ? (end < gathered_size ? end : gathered_size) - start : 0;
+            if ((status = __dpu_collective_gather(c, 0, symbol, symbol_offset, sizes[0], c->buffers[0])) != DPU_OK) {
+                goto end;
+            }
+        }
+        size = sizes[each_step & 1];
+        if (size != 0 && (status = dpu_sync(c->ranks[rank])) != DPU_OK) {
+            goto end;
+        }
+
+        /* The next step is gathered while this one is summed. */
+        if (each_step + 1 < nr_steps) {
+            uint32_t next_chunk = (each_step + 1) / c->nr_ranks, next_rank = (each_step + 1) % c->nr_ranks;
+
+            __dpu_collective_chunk(c, next_chunk, nr_chunks, chunk_size, result_size, scatter, &start, &end);
+            sizes[(each_step + 1) & 1] = start < gathered_size ? (end < gathered_size ? end : gathered_size) - start : 0;
+            if ((status = __dpu_collective_gather(c,
+                     next_rank,
+                     symbol,
+                     symbol_offset + (uint32_t)start,
+                     sizes[(each_step + 1) & 1],
+                     c->buffers[(each_step + 1) & 1]))
+                != DPU_OK) {
+                goto end;
+            }
+        }
+
+        __dpu_collective_chunk(c, chunk, nr_chunks, chunk_size, result_size, scatter, &start, &end);
+        for (uint32_t each_rank_dpu = 0; each_rank_dpu < c->first_dpus[rank + 1] - c->first_dpus[rank]; each_rank_dpu++) {
+            uint8_t *values = &c->buffers[each_step & 1][each_rank_dpu * size];
+            if (size != 0 && start + size > data_size) {
+                memset(&values[data_size - start], 0, start + size - data_size);
+            }
+            __dpu_collective_accumulate(c, type, &result[start], values, size, rank == 0 && each_rank_dpu == 0);
+        }
+        if (rank != c->nr_ranks - 1) {
+            continue;
+        }
+
+        /* The sum of the chunk is sent while the next chunk is gathered and summed. */
+        if (type == DPU_COLLECTIVE_FIXED_Q16) {
+            __dpu_collective_saturate(c, (int32_t *)&result[start], size);
+        }
+        memset(&result[start + size], 0, end - start - size);
+        if (result_symbol == NULL) {
+            continue;
+        }
+        if (!scatter) {
+            status = dpu_broadcast_to(
+                c->dpu_set, result_symbol, result_offset + (uint32_t)start, &result[start], end - start, DPU_XFER_ASYNC);
+        } else {
+            DPU_FOREACH (c->ranks[chunk], dpu, each_dpu) {
+                if ((status = dpu_prepare_xfer(dpu, &result[start + each_dpu * c->slice_size])) != DPU_OK) {
+                    goto end;
+                }
+            }
+            status = dpu_push_xfer(
+                c->ranks[chunk], DPU_XFER_TO_DPU, result_symbol, result_offset, c->slice_size, DPU_XFER_ASYNC);
+        }
+        if (status != DPU_OK) {
+            goto end;
+        }
+    }
+
+end:
+    /* The transfers in flight read and write the buffers, and must be done before returning, even on errors. */
+    if ((sync_status = dpu_sync(c->dpu_set)) != DPU_OK && status == DPU_OK) {
+        status = sync_status;
+    }
+    return status;
+}
+
+/**
+ * @brief Sums the vectors of all the DPUs of a set, and sends the sum to every DPU.
+ *
+ * The vectors are read rounded up to a multiple of 8 bytes, the values after the nr_values ones being ignored. The sum is
+ * written rounded up the same way, the bytes after the nr_values values being zeros, and stays in c->result, padded
+ * the same way, until the next reduction.
+ *
+ * @param c the state of the collective operations of the set
+ * @param type the type of the values
+ * @param symbol the DPU symbol holding the vector of each DPU
+ * @param symbol_offset the byte offset of the vector in the symbol, a multiple of 8
+ * @param result_symbol the DPU symbol receiving the sum, which can be symbol, or NULL to keep the sum on the host
+ * @param result_offset the byte offset of the sum in the result symbol, a multiple of 8
+ * @param nr_values the number of values of the vectors
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_collective_allreduce(struct dpu_collective *c,
+    dpu_collective_type_t type,
+    const char *symbol,
+    uint32_t symbol_offset,
+    const char *result_symbol,
+    uint32_t result_offset,
+    uint32_t nr_values)
+{
+    size_t data_size = (size_t)nr_values * dpu_collective_type_size(type);
+    size_t size = (data_size + 7) & ~(size_t)7;
+    dpu_error_t status;
+
+    if ((symbol_offset | result_offset) & 7) {
+        return DPU_ERR_INVALID_MEMORY_TRANSFER;
+    }
+    if ((status = __dpu_collective_reserve(c, size, DPU_COLLECTIVE_CHUNK_SIZE)) != DPU_OK) {
+        return status;
+    }
+    return __dpu_collective_reduce(
+        c, type, symbol, symbol_offset, result_symbol, result_offset, data_size, size, DPU_COLLECTIVE_CHUNK_SIZE, false);
+}
+
+/**
+ * @brief Sums the vectors of all the DPUs of a set, and sends to each DPU its slice of the sum.
+ *
+ * The sum is split in slices of c->slice_size bytes, a multiple of 8, the i-th DPU of DPU_FOREACH receiving the i-th
+ * slice, padded with zeros after the nr_values values. The vectors are read rounded up to a multiple of 8 bytes, the
+ * values after the nr_values ones being ignored. Each rank receives its slices as soon as they are summed. The sum stays
+ * in c->result until the next reduction.
+ *
+ * @param c the state of the collective operations of the set
+ * @param type the type of the values
+ * @param symbol the DPU symbol holding the vector of each DPU
+ * @param symbol_offset the byte offset of the vector in the symbol, a multiple of 8
+ * @param result_symbol the DPU symbol receiving the slice of each DPU, which can be symbol at the same offset
+ * @param result_offset the byte offset of the slice in the result symbol, a multiple of 8
+ * @param nr_values the number of values of the vectors
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_collective_reduce_scatter(struct dpu_collective *c,
+    dpu_collective_type_t type,
+    const char *symbol,
+    uint32_t symbol_offset,
+    const char *result_symbol,
+    uint32_t result_offset,
+    uint32_t nr_values)
+{
+    size_t data_size = (size_t)nr_values * dpu_collective_type_size(type);
+    size_t size = (data_size + 7) & ~(size_t)7;
+    size_t slice_size = ((size + c->nr_dpus - 1) / c->nr_dpus + 7) & ~(size_t)7;
+    dpu_error_t status;
+
+    if ((symbol_offset | result_offset) & 7) {
+        return DPU_ERR_INVALID_MEMORY_TRANSFER;
+    }
+    if ((status = __dpu_collective_reserve(c, slice_size * c->nr_dpus, slice_size * c->max_rank_dpus)) != DPU_OK) {
+        return status;
+    }
+    c->slice_size = slice_size;
+    return __dpu_collective_reduce(
+        c, type, symbol, symbol_offset, result_symbol, result_offset, data_size, slice_size * c->nr_dpus, 0, true);
+}
+
+/**
+ * @brief Sends a vector of the host to every DPU of a set, such as the model of the next iteration.
+ * @param c the state of the collective operations of the set
+ * @param symbol the DPU symbol receiving the vector
+ * @param symbol_offset the byte offset of the vector in the symbol, a multiple of 8
+ * @param values the vector
+ * @param size the size of the vector, a multiple of 8 bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_collective_broadcast(struct dpu_collective *c, const char *symbol, uint32_t symbol_offset, const void *values, size_t size)
+{
+    return dpu_broadcast_to(c->dpu_set, symbol, symbol_offset, values, size, DPU_XFER_DEFAULT);
+}
+
+#endif /* __DPU_COLLECTIVE_H */
@@ -0,0 +1,437 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_COMPRESS_H
+#define __DPU_COMPRESS_H
+
+/**
+ * @file dpu_compress.h
+ * @brief Host side of the compressed MRAM data (mram_compress.h): encoding of integer columns and byte streams.
+ *
+ * The encoders build the images decompressed by the DPUs, which are transferred to MRAM as they are: integer columns in
+ * frame of reference, with the values optionally replaced by their differences, and byte streams in blocks of the LZ4
+ * block format. The images of several DPUs are packed in one host buffer and transferred with dpu_push_varlen_xfer
+ * (see dpu_varlen.h), so that only the compressed bytes are transferred.
+ *
+ * The bits of the integer columns are packed with SSE2, and the minimum and maximum of the blocks are computed with
+ * SSE 4.1 when the host code is compiled for it. The images are identical either way.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <dpu.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+/**
+ * @brief Number of values of the blocks of a frame of reference image, identical to MRAM_COMPRESS_FOR_BLOCK.
+ */
+#define DPU_COMPRESS_FOR_BLOCK 128
+
+/**
+ * @brief Maximum size of the blocks of an LZ4 image. The DPU program must be built with a MRAM_COMPRESS_LZ4_BLOCK_SIZE at
+ * least as large as the block size of its images.
+ */
+#define DPU_COMPRESS_LZ4_MAX_BLOCK_SIZE 2048
+
+/**
+ * @brief The start of a frame of reference image, identical to struct mram_compress_for_header on the DPU.
+ */
+struct dpu_compress_for_header {
+    uint32_t nr_values;
+    uint32_t nr_blocks;
+    uint32_t reserved[2];
+};
+
+/**
+ * @brief The descriptor of a block of a frame of reference image, identical to struct mram_compress_for_block on the DPU.
+ */
+struct dpu_compress_for_block {
+    uint32_t offset;
+    uint16_t nr_values;
+    uint8_t width;
+    uint8_t delta;
+    int32_t reference;
+    int32_t first;
+};
+
+/**
+ * @brief The start of an LZ4 image, identical to struct mram_compress_lz4_header on the DPU.
+ */
+struct dpu_compress_lz4_header {
+    uint32_t length;
+    uint32_t block_size;
+    uint32_t nr_blocks;
+    uint32_t reserved;
+};
+
+/**
+ * @brief The descriptor of a block of an LZ4 image, identical to struct mram_compress_lz4_block on the DPU.
+ */
+struct dpu_compress_lz4_block {
+    uint32_t offset;
+    uint16_t size;
+    uint16_t length;
+};
+
+#define __DPU_COMPRESS_LZ4_HASH_BITS 11
+/* The last match starts at least 12 bytes before the end of a block, and the last 5 bytes are literals. */
+#define __DPU_COMPRESS_LZ4_MATCH_LIMIT 12
+#define __DPU_COMPRESS_LZ4_LAST_LITERALS 5
+
+static inline uint32_t
+__dpu_compress_read32(const uint8_t *bytes)
+{
+    uint32_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+static inline uint64_t
+__dpu_compress_read64(const uint8_t *bytes)
+{
+    uint64_t value;
+    memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+/* The minimum and the maximum of n signed values. */
+static inline void
+__dpu_compress_min_max(const uint32_t *values, uint32_t n, int32_t *minimum, int32_t *maximum)
+{
+    int32_t lo = (int32_t)values[0], hi = (int32_t)values[0];
+    uint32_t i = 0;
+
+#if defined(__SSE4_1__)
+    if (n >= 4) {
+        __m128i vlo = _mm_loadu_si128((const __m128i *)values), vhi = vlo;
+        int32_t lanes[4];
+        for (i = 4; i + 4 <= n; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&values[i]);
+            vlo = _mm_min_epi32(vlo, v);
+            vhi = _mm_max_epi32(vhi, v);
+        }
+        _mm_storeu_si128((__m128i *)lanes, vlo);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            lo = lanes[lane] < lo ? lanes[lane] : lo;
+        }
+        _mm_storeu_si128((__m128i *)lanes, vhi);
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            hi = lanes[lane] > hi ? lanes[lane] : hi;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        int32_t value = (int32_t)values[i];
+        lo = value < lo ? value : lo;
+        hi = value > hi ? value : hi;
+    }
+    *minimum = lo;
+    *maximum = hi;
+}
+
+/* Packs a block of values on width bits, in 4 interleaved lanes: word j of lane l is word 4 * j + l. */
+static inline void
+__dpu_compress_pack(const uint32_t *values, uint32_t width, uint32_t *words)
+{
+    if (width == 0) {
+        return;
+    }
+#if defined(__SSE2__)
+    {
+        __m128i accumulator = _mm_setzero_si128();
+        uint32_t shift = 0;
+
+        for (uint32_t k = 0; k < DPU_COMPRESS_FOR_BLOCK / 4; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)&values[4 * k]);
+            accumulator = _mm_or_si128(accumulator, _mm_sll_epi32(v, _mm_cvtsi32_si128((int)shift)));
+            shift += width;
+            if (shift >= 32) {
+                _mm_storeu_si128((__m128i *)words, accumulator);
+                words += 4;
+                shift -= 32;
+                accumulator = shift != 0 ? _mm_srl_epi32(v, _mm_cvtsi32_si128((int)(width - shift))) : _mm_setzero_si128();
+            }
+        }
+    }
+#else
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        uint32_t accumulator = 0, shift = 0, word = lane;
+
+        for (uint32_t each_value = lane; each_value < DPU_COMPRESS_FOR_BLOCK; each_value += 4) {
+            uint32_t v = values[each_value];
+            accumulator |= v << shift;
+            shift += width;
+            if (shift >= 32) {
+                words[word] = accumulator;
+                word += 4;
+                shift -= 32;
+                accumulator = shift != 0 ? v >> (width - shift) : 0;
+            }
+        }
+    }
+#endif
+}
+
+/**
+ * @brief The maximum size of the frame of reference image of a column.
+ * @param nr_values the number of values of the column
+ * @return The size, in bytes.
+ */
+static inline size_t
+dpu_compress_for_bound(uint32_t nr_values)
+{
+    size_t nr_blocks = (nr_values + DPU_COMPRESS_FOR_BLOCK - 1) / DPU_COMPRESS_FOR_BLOCK;
+    return sizeof(struct dpu_compress_for_header) + nr_blocks * (sizeof(struct dpu_compress_for_block) + DPU_COMPRESS_FOR_BLOCK * 4);
+}
+
+/**
+ * @brief Encodes an integer column in frame of reference, to be decompressed by mram_compress_for_get on the DPU.
+ *
+ * Each block is encoded on the number of bits of the difference between its largest and smallest value. With delta, the
+ * values are replaced by the difference to the previous value of the block first, which suits sorted columns.
+ *
+ * @param values the values of the column
+ * @param nr_values the number of values
+ * @param delta whether the differences between consecutive values are encoded
+ * @param image storage for the image, of dpu_compress_for_bound(nr_values) bytes
+ * @param size receives the size of the image, a multiple of 8 bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_compress_for_encode(const int32_t *values, uint32_t nr_values, bool delta, void *image, size_t *size)
+{
+    uint8_t *bytes = (uint8_t *)image;
+    uint32_t nr_blocks = (nr_values + DPU_COMPRESS_FOR_BLOCK - 1) / DPU_COMPRESS_FOR_BLOCK;
+    struct dpu_compress_for_header header = { .nr_values = nr_values, .nr_blocks = nr_blocks, .reserved = { 0, 0 } };
+    size_t offset = sizeof(header) + (size_t)nr_blocks * sizeof(struct dpu_compress_for_block);
+
+    if (offset + (size_t)nr_blocks * DPU_COMPRESS_FOR_BLOCK * 4 > UINT32_MAX) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    memcpy(bytes, &header, sizeof(header));
+
+    for (uint32_t each_block = 0; each_block < nr_blocks; each_block++) {
+        uint32_t first = each_block * DPU_COMPRESS_FOR_BLOCK;
+        uint32_t n = nr_values - first < DPU_COMPRESS_FOR_BLOCK ? nr_values - first : DPU_COMPRESS_FOR_BLOCK;
+        uint32_t source[DPU_COMPRESS_FOR_BLOCK], words[DPU_COMPRESS_FOR_BLOCK];
+        struct dpu_compress_for_block descriptor;
+        int32_t minimum, maximum;
+        uint32_t width;
+
+        memcpy(source, &values[first], n * sizeof(uint32_t));
+        if (delta) {
+            for (uint32_t i = n - 1; i != 0; i--) {
+                source[i] -= source[i - 1];
+            }
+            source[0] = 0;
+        }
+        __dpu_compress_min_max(source, n, &minimum, &maximum);
+        width = maximum == minimum ? 0 : 32 - __builtin_clz((uint32_t)maximum - (uint32_t)minimum);
+        for (uint32_t i = 0; i < DPU_COMPRESS_FOR_BLOCK; i++) {
+            source[i] = i < n ? source[i] - (uint32_t)minimum : 0;
+        }
+        __dpu_compress_pack(source, width, words);
+        memcpy(&bytes[offset], words, DPU_COMPRESS_FOR_BLOCK / 8 * width);
+
+        descriptor.offset = (uint32_t)offset;
+        descriptor.nr_values = (uint16_t)n;
+        descriptor.width = (uint8_t)width;
+        descriptor.delta = delta;
+        descriptor.reference = minimum;
+        descriptor.first = delta ? values[first] : 0;
+        memcpy(&bytes[sizeof(header) + each_block * sizeof(descriptor)], &descriptor, sizeof(descriptor));
+        offset += DPU_COMPRESS_FOR_BLOCK / 8 * width;
+    }
+
+    *size = offset;
+    return DPU_OK;
+}
+
+/* Writes the extension bytes of a literal or match length of at least 15. */
+static inline uint8_t *
+__dpu_compress_lz4_length(uint8_t *out, uint32_t length)
+{
+    for (length -= 15; length >= 255; length -= 255) {
+        *out++ = 255;
+    }
+    *out++ = (uint8_t)length;
+    return out;
+}
+
+/* Writes a sequence, or the last literals when match_length is 0. Returns NULL if it does not fit before out_end. */
+static inline uint8_t *
+__dpu_compress_lz4_sequence(uint8_t *out,
+    const uint8_t *out_end,
+    const uint8_t *literals,
+    uint32_t nr_literals,
+    uint32_t offset,
+    uint32_t match_length)
+{
+    uint32_t needed = 1 + nr_literals + (nr_literals >= 15 ? (nr_literals - 15) / 255 + 1 : 0);
+    uint8_t *token = out;
+
+    if (match_length != 0) {
+        needed += 2 + (match_length - 4 >= 15 ? (match_length - 4 - 15) / 255 + 1 : 0);
+    }
+    if (needed > (size_t)(out_end - out)) {
+        return NULL;
+    }
+
+    *out++ = (uint8_t)((nr_literals >= 15 ? 15 : nr_literals) << 4);
+    if (nr_literals >= 15) {
+        out = __dpu_compress_lz4_length(out, nr_literals);
+    }
+    memcpy(out, literals, nr_literals);
+    out += nr_literals;
+    if (match_length != 0) {
+        *out++ = (uint8_t)offset;
+        *out++ = (uint8_t)(offset >> 8);
+        *token |= (uint8_t)(match_length - 4 >= 15 ? 15 : match_length - 4);
+        if (match_length - 4 >= 15) {
+            out = __dpu_compress_lz4_length(out, match_length - 4);
+        }
+    }
+    return out;
+}
+
+/* Compresses a block of at most DPU_COMPRESS_LZ4_MAX_BLOCK_SIZE bytes. Returns 0 if it is not smaller compressed. */
+static inline uint32_t
+__dpu_compress_lz4_block(const uint8_t *in, uint32_t length, uint8_t *out)
+{
+    uint16_t table[1 << __DPU_COMPRESS_LZ4_HASH_BITS];
+    const uint8_t *out_end = out + length - 1;
+    uint8_t *op = out;
+    uint32_t anchor = 0, position = 0;
+
+    memset(table, 0, sizeof(table));
+    if (length > __DPU_COMPRESS_LZ4_MATCH_LIMIT) {
+        uint32_t limit = length - __DPU_COMPRESS_LZ4_MATCH_LIMIT, end = length - __DPU_COMPRESS_LZ4_LAST_LITERALS;
+
+        while (position < limit) {
+            uint32_t sequence = __dpu_compress_read32(&in[position]);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - __DPU_COMPRESS_LZ4_HASH_BITS);
+            uint32_t candidate = table[hash], n = 4;
+
+            table[hash] = (uint16_t)position;
+            if (candidate >= position || __dpu_compress_read32(&in[candidate]) != sequence) {
+                /* Skip faster through the data that does not compress. */
+                position += 1 + ((position - anchor) >> 6);
+                continue;
+            }
+
+            while (position > anchor && candidate > 0 && in[position - 1] == in[candidate - 1]) {
+                position--;
+                candidate--;
+                n++;
+            }
+            /* Compare 8 bytes at a time, the first difference is the lowest set byte of the exclusive or. */
+            while (position + n + 8 <= end) {
+                uint64_t difference = __dpu_compress_read64(&in[position + n]) ^ __dpu_compress_read64(&in[candidate + n]);
+                if (difference != 0) {
+                    n += __builtin_ctzll(difference) >> 3;
+                    goto found;
+                }
+                n += 8;
+            }
+            while (position + n < end && in[position + n] == in[candidate + n]) {
+                n++;
+            }
+        found:
+            op = __dpu_compress_lz4_sequence(op, out_end, &in[anchor], position - anchor, position - candidate, n);
+            if (op == NULL) {
+                return 0;
+            }
+            position += n;
+            anchor = position;
+            if (position - 2 < limit) {
+                table[(__dpu_compress_read32(&in[position - 2]) * 2654435761u) >> (32 - __DPU_COMPRESS_LZ4_HASH_BITS)]
+                    = (uint16_t)(position - 2);
+            }
+        }
+    }
+
+    op = __dpu_compress_lz4_sequence(op, out_end, &in[anchor], length - anchor, 0, 0);
+    return op == NULL ? 0 : (uint32_t)(op - out);
+}
+
+/**
+ * @brief The maximum size of the LZ4 image of a byte stream.
+ * @param length the number of bytes of the stream
+ * @param block_size the size of the blocks, a multiple of 8
+ * @return The size, in bytes.
+ */
+static inline size_t
+dpu_compress_lz4_bound(uint32_t length, uint32_t block_size)
+{
+    size_t nr_blocks = block_size == 0 ? 0 : (length + (size_t)block_size - 1) / block_size;
+    return sizeof(struct dpu_compress_lz4_header) + nr_blocks * (sizeof(struct dpu_compress_lz4_block) + block_size);
+}
+
+/**
+ * @brief Encodes a byte stream in blocks of the LZ4 block format, to be decompressed by mram_compress_lz4_get on the DPU.
+ *
+ * The blocks are compressed independently, and stored as they are when they do not compress.
+ *
+ * @param data the bytes of the stream
+ * @param length the number of bytes
+ * @param block_size the size of the blocks, a multiple of 8 of at most DPU_COMPRESS_LZ4_MAX_BLOCK_SIZE
+ * @param image storage for the image, of dpu_compress_lz4_bound(length, block_size) bytes
+ * @param size receives the size of the image, a multiple of 8 bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_compress_lz4_encode(const void *data, uint32_t length, uint32_t block_size, void *image, size_t *size)
+{
+    const uint8_t *in = (const uint8_t *)data;
+    uint8_t *bytes = (uint8_t *)image;
+    uint32_t nr_blocks;
+    struct dpu_compress_lz4_header header;
+    size_t offset;
+
+    if (block_size == 0 || (block_size & 7) != 0 || block_size > DPU_COMPRESS_LZ4_MAX_BLOCK_SIZE
+        || dpu_compress_lz4_bound(length, block_size) > UINT32_MAX) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    nr_blocks = (length + block_size - 1) / block_size;
+    header.length = length;
+    header.block_size = block_size;
+    header.nr_blocks = nr_blocks;
+    header.reserved = 0;
+    memcpy(bytes, &header, sizeof(header));
+    offset = sizeof(header) + (size_t)nr_blocks * sizeof(struct dpu_compress_lz4_block);
+
+    for (uint32_t each_block = 0; each_block < nr_blocks; each_block++) {
+        uint32_t first = each_block * block_size;
+        uint32_t n = length - first < block_size ? length - first : block_size;
+        uint32_t compressed = __dpu_compress_lz4_block(&in[first], n, &bytes[offset]);
+        struct dpu_compress_lz4_block descriptor;
+
+        if (compressed == 0) {
+            memcpy(&bytes[offset], &in[first], n);
+            compressed = n;
+        }
+        memset(&bytes[offset + compressed], 0, ((compressed + 7) & ~7u) - compressed);
+
+        descriptor.offset = (uint32_t)offset;
+        descriptor.size = (uint16_t)compressed;
+        descriptor.length = (uint16_t)n;
+        memcpy(&bytes[sizeof(header) + each_block * sizeof(descriptor)], &descriptor, sizeof(descriptor));
+        offset += (compressed + 7) & ~7u;
+    }
+
+    *size = offset;
+    return DPU_OK;
+}
+
+#endif /* __DPU_COMPRESS_H */
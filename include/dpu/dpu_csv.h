@@ -0,0 +1,447 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_CSV_H
+#define __DPU_CSV_H
+
+/**
+ * @file dpu_csv.h
+ * @brief Host side of the parsing of delimited text (CSV) by the DPUs (mram_csv.h).
+ *
+ * The text is split between the DPUs at record boundaries, found from the parity of the double quotes before them (see
+ * mram_csv.h for the quoting rules): finding the boundaries only looks for double quotes and newlines, and is much
+ * cheaper than parsing the text. The raw text is transferred once, and each DPU parses its records into MRAM columns,
+ * which are gathered into host columns in the order of the records. dpu_csv_parse parses a text on the host with the
+ * same rules, and gives the same columns.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief Maximum number of fields of a schema, identical to MRAM_CSV_MAX_FIELDS.
+ */
+#define DPU_CSV_MAX_FIELDS 16
+
+/**
+ * @brief Maximum number of decimals of a fixed-point field, identical to MRAM_CSV_MAX_SCALE.
+ */
+#define DPU_CSV_MAX_SCALE 9
+
+/**
+ * @brief The types of the fields, identical to mram_csv_type_t on the DPU.
+ */
+typedef enum _dpu_csv_type_t {
+    DPU_CSV_SKIP = 0,
+    DPU_CSV_INT32 = 1,
+    DPU_CSV_INT64 = 2,
+    DPU_CSV_FIXED32 = 3,
+    DPU_CSV_FIXED64 = 4,
+    DPU_CSV_STRING = 5,
+} dpu_csv_type_t;
+
+/**
+ * @brief The fields of the records, identical to struct mram_csv_schema on the DPU.
+ */
+struct dpu_csv_schema {
+    uint8_t delimiter;
+    uint8_t nr_fields;
+    uint8_t reserved[2];
+    uint8_t types[DPU_CSV_MAX_FIELDS];
+    uint8_t scales[DPU_CSV_MAX_FIELDS];
+};
+
+/**
+ * @brief The element of the column of a string field, identical to struct mram_csv_string on the DPU.
+ */
+struct dpu_csv_string {
+    uint32_t offset;
+    uint32_t length;
+};
+
+/**
+ * @brief A text split between the DPUs of a set by dpu_csv_load.
+ */
+struct dpu_csv_text {
+    struct dpu_set_t dpu_set;
+    uint32_t nr_dpus;
+    uint64_t length;
+    /** DPU i parses the records starting in the bytes [first_bytes[i], first_bytes[i + 1]). */
+    uint64_t *first_bytes;
+    /** The offset in the text of the first byte held by each DPU, a multiple of 8. */
+    uint64_t *origins;
+};
+
+/**
+ * @brief The size of the elements of the column of a field.
+ * @param type the type of the field
+ * @return The size, in bytes, 0 for a skipped field.
+ */
+static inline uint32_t
+dpu_csv_element_size(dpu_csv_type_t type)
+{
+    switch (type) {
+        case DPU_CSV_INT32:
+        case DPU_CSV_FIXED32:
+            return sizeof(int32_t);
+        case DPU_CSV_INT64:
+        case DPU_CSV_FIXED64:
+            return sizeof(int64_t);
+        case DPU_CSV_STRING:
+            return sizeof(struct dpu_csv_string);
+        default:
+            return 0;
+    }
+}
+
+/* Parses a number as __mram_csv_number on the DPU. */
+static inline bool
+__dpu_csv_number(const uint8_t *bytes, size_t length, bool fixed, uint32_t scale, int64_t *number)
+{
+    uint64_t value = 0;
+    uint32_t nr_digits = 0, nr_decimals = 0;
+    bool negative = false, point = false;
+    size_t i = 0;
+
+    *number = 0;
+    if (length == 0) {
+        return true;
+    }
+    if (bytes[0] == '-' || bytes[0] == '+') {
+        negative = bytes[0] == '-';
+        i++;
+    }
+    for (; i < length; i++) {
+        uint8_t c = bytes[i];
+        if (c >= '0' && c <= '9') {
+            if (!point) {
+                if (nr_digits++ > 18) {
+                    return false;
+                }
+                value = value * 10 + (c - '0');
+            } else if (nr_decimals < scale) {
+                value = value * 10 + (c - '0');
+                nr_decimals++;
+            }
+        } else if (c == '.' && fixed && !point) {
+            point = true;
+        } else {
+            return false;
+        }
+    }
+    if (nr_digits + scale > 18 || (nr_digits == 0 && !point)) {
+        return false;
+    }
+    for (; nr_decimals < scale; nr_decimals++) {
+        value *= 10;
+    }
+    *number = negative ? -(int64_t)value : (int64_t)value;
+    return true;
+}
+
+/* Writes a field of record as __mram_csv_store on the DPU, and returns whether it is valid. */
+static inline bool
+__dpu_csv_store(const struct dpu_csv_schema *schema,
+    const uint8_t *text,
+    uint32_t field,
+    uint64_t from,
+    uint64_t to,
+    void *column,
+    uint64_t record)
+{
+    uint32_t type = schema->types[field];
+    bool fixed = type == DPU_CSV_FIXED32 || type == DPU_CSV_FIXED64;
+    int64_t number;
+    bool valid;
+
+    if (type == DPU_CSV_STRING) {
+        struct dpu_csv_string string = { .offset = (uint32_t)from, .length = (uint32_t)(to - from) };
+        memcpy((uint8_t *)column + record * sizeof(string), &string, sizeof(string));
+        return true;
+    }
+    valid = __dpu_csv_number(&text[from], (size_t)(to - from), fixed, fixed ? schema->scales[field] : 0, &number);
+    if (type == DPU_CSV_INT32 || type == DPU_CSV_FIXED32) {
+        int32_t element;
+        valid = valid && number >= INT32_MIN && number <= INT32_MAX;
+        element = valid ? (int32_t)number : 0;
+        memcpy((uint8_t *)column + record * sizeof(element), &element, sizeof(element));
+    } else {
+        int64_t element = valid ? number : 0;
+        memcpy((uint8_t *)column + record * sizeof(element), &element, sizeof(element));
+    }
+    return valid;
+}
+
+/**
+ * @brief Parses the records of a text into columns on the host, with the rules of mram_csv_parse on the DPU.
+ * @param schema the fields of the records
+ * @param text the text
+ * @param length the length of the text, in bytes
+ * @param columns the column of each field of the schema which is not skipped
+ * @param max_records the capacity of the columns, in records
+ * @param nr_records receives the number of records, which are all in the columns if it does not exceed max_records
+ * @param nr_errors if not NULL, receives the number of invalid numbers
+ */
+static inline void
+dpu_csv_parse(const struct dpu_csv_schema *schema,
+    const void *text,
+    uint64_t length,
+    void *const *columns,
+    uint64_t max_records,
+    uint64_t *nr_records,
+    uint64_t *nr_errors)
+{
+    const uint8_t *bytes = (const uint8_t *)text;
+    uint64_t position = 0, record = 0, errors = 0;
+
+    for (; position < length; record++) {
+        uint32_t field = 0;
+        uint64_t end;
+        uint8_t separator;
+
+        do {
+            uint64_t from = position, to;
+            bool quoted = false;
+
+            for (end = position; end < length; end++) {
+                uint8_t c = bytes[end];
+                if (c == '"') {
+                    quoted = !quoted;
+                } else if (!quoted && (c == schema->delimiter || c == '\n')) {
+                    break;
+                }
+            }
+            separator = end == length ? '\n' : bytes[end];
+
+            if (record < max_records && field < schema->nr_fields && schema->types[field] != DPU_CSV_SKIP) {
+                to = end;
+                if (separator == '\n' && to > from && bytes[to - 1] == '\r') {
+                    to--;
+                }
+                if (to > from && bytes[from] == '"') {
+                    from++;
+                    if (to > from && bytes[to - 1] == '"') {
+                        to--;
+                    }
+                }
+                errors += !__dpu_csv_store(schema, bytes, field, from, to, columns[field], record);
+            }
+            field++;
+            position = end + 1;
+        } while (separator != '\n');
+
+        for (; record < max_records && field < schema->nr_fields; field++) {
+            if (schema->types[field] != DPU_CSV_SKIP) {
+                __dpu_csv_store(schema, bytes, field, end, end, columns[field], record);
+            }
+        }
+    }
+
+    *nr_records = record;
+    if (nr_errors != NULL) {
+        *nr_errors = errors;
+    }
+}
+
+/**
+ * @brief Splits a text at record boundaries into parts of about the same length.
+ *
+ * Part i starts after the first newline, which is not quoted, following the byte i * length / nr_parts.
+ *
+ * @param text the text
+ * @param length the length of the text, in bytes
+ * @param nr_parts the number of parts
+ * @param first_bytes receives the nr_parts + 1 offsets of the parts, the last one being length
+ */
+static inline void
+dpu_csv_split(const void *text, uint64_t length, uint32_t nr_parts, uint64_t *first_bytes)
+{
+    const uint8_t *bytes = (const uint8_t *)text;
+    uint64_t position = 0;
+    bool quoted = false;
+
+    first_bytes[0] = 0;
+    for (uint32_t each_part = 1; each_part < nr_parts; each_part++) {
+        uint64_t target = length * each_part / nr_parts;
+
+        /* The quoting state at the target, from the double quotes before it. */
+        while (position < target) {
+            const uint8_t *quote = (const uint8_t *)memchr(&bytes[position], '"', (size_t)(target - position));
+            if (quote == NULL) {
+                position = target;
+                break;
+            }
+            quoted = !quoted;
+            position = (uint64_t)(quote - bytes) + 1;
+        }
+        for (; position < length; position++) {
+            if (bytes[position] == '"') {
+                quoted = !quoted;
+            } else if (bytes[position] == '\n' && !quoted) {
+                position++;
+                break;
+            }
+        }
+        first_bytes[each_part] = position;
+    }
+    first_bytes[nr_parts] = length;
+}
+
+/**
+ * @brief Frees the description of a text loaded by dpu_csv_load.
+ * @param text the text
+ */
+static inline void
+dpu_csv_free(struct dpu_csv_text *text)
+{
+    free(text->first_bytes);
+    free(text->origins);
+    text->first_bytes = NULL;
+    text->origins = NULL;
+}
+
+/**
+ * @brief Splits a text between the DPUs of a set with dpu_csv_split, and copies it to the DPUs.
+ *
+ * Each DPU holds its part from an offset rounded down to a multiple of 8: the DPU program must define the MRAM buffer
+ * "text", and the uint32_t variables "text_length", receiving the length of the bytes held by the DPU, and "text_from",
+ * receiving the offset of its first record in these bytes, to be given to mram_csv_parse.
+ *
+ * @param dpu_set the DPU set
+ * @param bytes the text
+ * @param length the length of the text, in bytes
+ * @param text receives the description of the loaded text, to be freed with dpu_csv_free
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_csv_load(struct dpu_set_t dpu_set, const void *bytes, uint64_t length, struct dpu_csv_text *text)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu, *lengths = NULL;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &text->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    text->dpu_set = dpu_set;
+    text->length = length;
+    text->first_bytes = malloc((text->nr_dpus + 1) * sizeof(uint64_t));
+    text->origins = malloc(text->nr_dpus * sizeof(uint64_t));
+    lengths = malloc(2 * text->nr_dpus * sizeof(uint32_t));
+    if (text->first_bytes == NULL || text->origins == NULL || lengths == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    dpu_csv_split(bytes, length, text->nr_dpus, text->first_bytes);
+    for (each_dpu = 0; each_dpu < text->nr_dpus; each_dpu++) {
+        uint64_t origin = text->first_bytes[each_dpu] & ~(uint64_t)7;
+
+        if (text->first_bytes[each_dpu + 1] - origin > UINT32_MAX) {
+            status = DPU_ERR_INVALID_BUFFER_SIZE;
+            goto end;
+        }
+        text->origins[each_dpu] = origin;
+        lengths[2 * each_dpu] = (uint32_t)(text->first_bytes[each_dpu + 1] - origin);
+        lengths[2 * each_dpu + 1] = (uint32_t)(text->first_bytes[each_dpu] - origin);
+    }
+
+    status = dpu_push_varlen_ranges(dpu_set, "text", 0, bytes, length, text->origins, text->first_bytes + 1);
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &lengths[2 * each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "text_length", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &lengths[2 * each_dpu + 1]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "text_from", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+
+end:
+    if (status != DPU_OK) {
+        dpu_csv_free(text);
+    }
+    free(lengths);
+    return status;
+}
+
+/**
+ * @brief Gathers the MRAM columns of a field from the DPUs into one host column, in the order of the records.
+ *
+ * The offsets of the strings are translated from the bytes held by each DPU to the whole text.
+ *
+ * @param text the text, loaded by dpu_csv_load and parsed by the DPUs
+ * @param symbol_name the DPU symbol holding the column
+ * @param symbol_offset the byte offset of the column from the symbol, a multiple of 8
+ * @param type the type of the field
+ * @param nr_records the number of records parsed by each DPU, at most the capacity of its column
+ * @param column receives the elements of the records of all the DPUs
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_csv_pull_column(struct dpu_csv_text *text,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    dpu_csv_type_t type,
+    const uint32_t *nr_records,
+    void *column)
+{
+    uint32_t element_size = dpu_csv_element_size(type), each_dpu;
+    uint64_t *sizes = malloc(text->nr_dpus * sizeof(uint64_t));
+    uint64_t *offsets = malloc((text->nr_dpus + 1) * sizeof(uint64_t));
+    uint8_t *buffer = NULL, *to = (uint8_t *)column;
+    size_t max_length;
+    dpu_error_t status = DPU_OK;
+
+    if (sizes == NULL || offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    for (each_dpu = 0; each_dpu < text->nr_dpus; each_dpu++) {
+        sizes[each_dpu] = (uint64_t)nr_records[each_dpu] * element_size;
+    }
+    max_length = dpu_varlen_offsets(sizes, text->nr_dpus, offsets);
+    if ((buffer = malloc(offsets[text->nr_dpus] + 8)) == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    status = dpu_push_varlen_xfer(
+        text->dpu_set, DPU_XFER_FROM_DPU, symbol_name, symbol_offset, buffer, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    if (status != DPU_OK) {
+        goto end;
+    }
+
+    for (each_dpu = 0; each_dpu < text->nr_dpus; each_dpu++) {
+        if (type == DPU_CSV_STRING) {
+            struct dpu_csv_string *strings = (struct dpu_csv_string *)(buffer + offsets[each_dpu]);
+            for (uint32_t each_record = 0; each_record < nr_records[each_dpu]; each_record++) {
+                strings[each_record].offset += (uint32_t)text->origins[each_dpu];
+            }
+        }
+        memcpy(to, buffer + offsets[each_dpu], sizes[each_dpu]);
+        to += sizes[each_dpu];
+    }
+
+end:
+    free(buffer);
+    free(offsets);
+    free(sizes);
+    return status;
+}
+
+#endif /* __DPU_CSV_H */
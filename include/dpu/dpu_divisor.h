@@ -0,0 +1,127 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_DIVISOR_H
+#define __DPU_DIVISOR_H
+
+/**
+ * @file dpu_divisor.h
+ * @brief Host side of the prepared divisors of the DPU runtime (divisor.h).
+ *
+ * The host prepares the divisors known when the program runs, such as the number of buckets of a table sized from the
+ * data, and sends them to the __host variables of the DPUs. The division by a prepared divisor is also provided to check
+ * the preparation, the quotients being exact.
+ */
+
+#include <stdint.h>
+
+/**
+ * @brief A 32-bit divisor prepared for the DPUs, identical to struct divisor_u32 on the DPU.
+ */
+struct dpu_divisor_u32 {
+    uint32_t magic;
+    uint32_t increment;
+    uint32_t shift;
+    uint32_t divisor;
+};
+
+/**
+ * @brief A 64-bit divisor prepared for the DPUs, identical to struct divisor_u64 on the DPU.
+ */
+struct dpu_divisor_u64 {
+    uint64_t magic;
+    uint64_t divisor;
+    uint32_t increment;
+    uint32_t shift;
+};
+
+/**
+ * @brief Prepares a 32-bit divisor, identical to divisor_u32_init on the DPU.
+ * @param d receives the prepared divisor
+ * @param divisor the divisor, not 0
+ */
+static inline void
+dpu_divisor_u32_init(struct dpu_divisor_u32 *d, uint32_t divisor)
+{
+    uint32_t shift = 31 - __builtin_clz(divisor);
+    uint64_t power = 1ull << (32 + shift);
+    uint32_t floor = (uint32_t)(power / divisor), error = divisor - (uint32_t)(power % divisor);
+
+    d->divisor = divisor;
+    d->shift = shift;
+    if ((divisor & (divisor - 1)) == 0) {
+        d->magic = 0xffffffffu;
+        d->increment = 1;
+    } else {
+        /* Rounding 2^(32 + shift) / divisor up is exact for all the dividends when its error is at most 2^shift. */
+        d->increment = error > (1u << shift);
+        d->magic = d->increment ? floor : floor + 1;
+    }
+}
+
+/**
+ * @brief Prepares a 64-bit divisor, identical to divisor_u64_init on the DPU.
+ * @param d receives the prepared divisor
+ * @param divisor the divisor, not 0
+ */
+static inline void
+dpu_divisor_u64_init(struct dpu_divisor_u64 *d, uint64_t divisor)
+{
+    uint32_t shift = 63 - __builtin_clzll(divisor);
+    unsigned __int128 power = (unsigned __int128)1 << (64 + shift);
+    uint64_t floor = (uint64_t)(power / divisor), error = divisor - (uint64_t)(power % divisor);
+
+    d->divisor = divisor;
+    d->shift = shift;
+    if ((divisor & (divisor - 1)) == 0) {
+        d->magic = 0xffffffffffffffffull;
+        d->increment = 1;
+    } else {
+        d->increment = error > (1ull << shift);
+        d->magic = d->increment ? floor : floor + 1;
+    }
+}
+
+/**
+ * @brief The quotient of a 32-bit integer by a prepared divisor, identical to divisor_u32_divide on the DPU.
+ */
+static inline uint32_t
+dpu_divisor_u32_divide(const struct dpu_divisor_u32 *d, uint32_t n)
+{
+    uint64_t product = (uint64_t)n * d->magic + (d->increment ? d->magic : 0);
+
+    return (uint32_t)(product >> 32) >> d->shift;
+}
+
+/**
+ * @brief The remainder of a 32-bit integer by a prepared divisor, identical to divisor_u32_modulo on the DPU.
+ */
+static inline uint32_t
+dpu_divisor_u32_modulo(const struct dpu_divisor_u32 *d, uint32_t n)
+{
+    return n - dpu_divisor_u32_divide(d, n) * d->divisor;
+}
+
+/**
+ * @brief The quotient of a 64-bit integer by a prepared divisor, identical to divisor_u64_divide on the DPU.
+ */
+static inline uint64_t
+dpu_divisor_u64_divide(const struct dpu_divisor_u64 *d, uint64_t n)
+{
+    unsigned __int128 product = (unsigned __int128)n * d->magic + (d->increment ? d->magic : 0);
+
+    return (uint64_t)(product >> 64) >> d->shift;
+}
+
+/**
+ * @brief The remainder of a 64-bit integer by a prepared divisor, identical to divisor_u64_modulo on the DPU.
+ */
+static inline uint64_t
+dpu_divisor_u64_modulo(const struct dpu_divisor_u64 *d, uint64_t n)
+{
+    return n - dpu_divisor_u64_divide(d, n) * d->divisor;
+}
+
+#endif /* __DPU_DIVISOR_H */
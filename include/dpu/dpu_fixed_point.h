@@ -0,0 +1,452 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_FIXED_POINT_H
+#define __DPU_FIXED_POINT_H
+
+/**
+ * @file dpu_fixed_point.h
+ * @brief Host side of the fixed-point arithmetic of the DPU runtime (fixed_point.h).
+ *
+ * The results are identical to the results computed by the DPUs, so that the host can check them, or compute the same
+ * functions on the values it keeps. The host also converts values between double and Q15.16, and computes the parameters
+ * of the quantization of a range of values.
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+/**
+ * @brief A value of [-1, 1) with 15 fractional bits (Q0.15), identical to fixed_q15_t on the DPU.
+ */
+typedef int16_t dpu_fixed_q15_t;
+
+/**
+ * @brief A value of [-32768, 32768) with 16 fractional bits (Q15.16), identical to fixed_q16_t on the DPU.
+ */
+typedef int32_t dpu_fixed_q16_t;
+
+#define DPU_FIXED_Q15_MIN INT16_MIN
+#define DPU_FIXED_Q15_MAX INT16_MAX
+#define DPU_FIXED_Q16_MIN INT32_MIN
+#define DPU_FIXED_Q16_MAX INT32_MAX
+#define DPU_FIXED_Q16_ONE 0x10000
+
+/**
+ * @brief The affine mapping between real values and quantized integers, identical to struct fixed_quantization on the DPU.
+ */
+struct dpu_fixed_quantization {
+    /** The real value of a quantization step, scale / 2^scale_shift. */
+    int32_t scale;
+    uint32_t scale_shift;
+    /** The inverse of the step, inverse_scale / 2^inverse_shift. */
+    int32_t inverse_scale;
+    uint32_t inverse_shift;
+    /** The quantized integer of the real value 0. */
+    int32_t zero_point;
+};
+
+#define __DPU_FIXED_LOG2_E 1549082005u
+#define __DPU_FIXED_LN_2 744261118u
+
+/* 2^(i / 256), with 30 fractional bits. */
+static const uint32_t __dpu_fixed_exp2_table[257] = {
+    0x40000000, 0x402c6be9, 0x4058f6a8, 0x4085a051, 0x40b268fa, 0x40df50b8, 0x410c57a2, 0x41397dcc,
+    0x4166c34c, 0x41942839, 0x41c1aca7, 0x41ef50ae, 0x421d1462, 0x424af7da, 0x4278fb2b, 0x42a71e6c,
+    0x42d561b4, 0x4303c518, 0x433248ae, 0x4360ec8d, 0x438fb0cb, 0x43be957f, 0x43ed9ac0, 0x441cc0a3,
+    0x444c0740, 0x447b6ead, 0x44aaf702, 0x44daa054, 0x450a6abb, 0x453a564d, 0x456a6323, 0x459a9152,
+    0x45cae0f2, 0x45fb521a, 0x462be4e2, 0x465c9961, 0x468d6fae, 0x46be67e0, 0x46ef8210, 0x4720be55,
+    0x47521cc6, 0x47839d7b, 0x47b5408c, 0x47e70611, 0x4818ee22, 0x484af8d6, 0x487d2646, 0x48af768a,
+    0x48e1e9ba, 0x49147fee, 0x4947393f, 0x497a15c4, 0x49ad1598, 0x49e038d0, 0x4a137f88, 0x4a46e9d6,
+    0x4a7a77d4, 0x4aae299b, 0x4ae1ff43, 0x4b15f8e6, 0x4b4a169c, 0x4b7e587e, 0x4bb2bea5, 0x4be7492b,
+    0x4c1bf829, 0x4c50cbb8, 0x4c85c3f1, 0x4cbae0ef, 0x4cf022ca, 0x4d25899c, 0x4d5b157e, 0x4d90c68b,
+    0x4dc69cdd, 0x4dfc988c, 0x4e32b9b4, 0x4e69006e, 0x4e9f6cd4, 0x4ed5ff00, 0x4f0cb70c, 0x4f439514,
+    0x4f7a9930, 0x4fb1c37c, 0x4fe91413, 0x50208b0e, 0x50582888, 0x508fec9c, 0x50c7d765, 0x50ffe8fe,
+    0x51382182, 0x5170810b, 0x51a907b4, 0x51e1b59a, 0x521a8ad7, 0x52538786, 0x528cabc3, 0x52c5f7aa,
+    0x52ff6b55, 0x533906e0, 0x5372ca68, 0x53acb607, 0x53e6c9da, 0x542105fd, 0x545b6a8b, 0x5495f7a1,
+    0x54d0ad5a, 0x550b8bd4, 0x55469329, 0x5581c378, 0x55bd1cdb, 0x55f89f70, 0x56344b52, 0x567020a0,
+    0x56ac1f75, 0x56e847ef, 0x57249a29, 0x57611642, 0x579dbc57, 0x57da8c83, 0x581786e6, 0x5854ab9b,
+    0x5891fac1, 0x58cf7474, 0x590d18d3, 0x594ae7fb, 0x5988e209, 0x59c7071c, 0x5a055751, 0x5a43d2c6,
+    0x5a82799a, 0x5ac14bea, 0x5b0049d4, 0x5b3f7377, 0x5b7ec8f2, 0x5bbe4a61, 0x5bfdf7e5, 0x5c3dd19c,
+    0x5c7dd7a4, 0x5cbe0a1c, 0x5cfe6923, 0x5d3ef4d7, 0x5d7fad59, 0x5dc092c7, 0x5e01a53f, 0x5e42e4e3,
+    0x5e8451d0, 0x5ec5ec26, 0x5f07b405, 0x5f49a98c, 0x5f8bccdb, 0x5fce1e12, 0x60109d51, 0x60534ab7,
+    0x60962665, 0x60d9307b, 0x611c6919, 0x615fd05e, 0x61a3666d, 0x61e72b65, 0x622b1f66, 0x626f4292,
+    0x62b39509, 0x62f816eb, 0x633cc85b, 0x6381a978, 0x63c6ba64, 0x640bfb41, 0x64516c2e, 0x64970d4f,
+    0x64dcdec3, 0x6522e0ad, 0x6569132f, 0x65af766a, 0x65f60a7f, 0x663ccf92, 0x6683c5c3, 0x66caed35,
+    0x6712460b, 0x6759d065, 0x67a18c68, 0x67e97a34, 0x683199ed, 0x6879ebb6, 0x68c26fb1, 0x690b2601,
+    0x69540ec9, 0x699d2a2c, 0x69e6784d, 0x6a2ff94f, 0x6a79ad56, 0x6ac39485, 0x6b0daeff, 0x6b57fce9,
+    0x6ba27e65, 0x6bed3399, 0x6c381ca6, 0x6c8339b2, 0x6cce8ae1, 0x6d1a1057, 0x6d65ca38, 0x6db1b8a8,
+    0x6dfddbcc, 0x6e4a33c9, 0x6e96c0c3, 0x6ee382de, 0x6f307a41, 0x6f7da710, 0x6fcb096f, 0x7018a185,
+    0x70666f76, 0x70b47368, 0x7102ad80, 0x71511de4, 0x719fc4b9, 0x71eea226, 0x723db650, 0x728d015d,
+    0x72dc8374, 0x732c3cba, 0x737c2d55, 0x73cc556d, 0x741cb528, 0x746d4cac, 0x74be1c20, 0x750f23ab,
+    0x75606374, 0x75b1dba2, 0x76038c5b, 0x765575c8, 0x76a7980f, 0x76f9f359, 0x774c87cc, 0x779f5590,
+    0x77f25cce, 0x78459dac, 0x78991854, 0x78ecccec, 0x7940bb9e, 0x7994e492, 0x79e947ef, 0x7a3de5df,
+    0x7a92be8b, 0x7ae7d21a, 0x7b3d20b6, 0x7b92aa88, 0x7be86fba, 0x7c3e7073, 0x7c94acde, 0x7ceb2523,
+    0x7d41d96e, 0x7d98c9e6, 0x7deff6b6, 0x7e476009, 0x7e9f0606, 0x7ef6e8da, 0x7f4f08ae, 0x7fa765ad,
+    0x80000000
+};
+
+/* log2(1 + i / 256), with 30 fractional bits. */
+static const uint32_t __dpu_fixed_log2_table[257] = {
+    0x00000000, 0x005c2712, 0x00b7f286, 0x01136311, 0x016e7968, 0x01c9363c, 0x02239a3b, 0x027da613,
+    0x02d75a6f, 0x0330b7f8, 0x0389bf57, 0x03e27130, 0x043ace28, 0x0492d6e0, 0x04ea8bf7, 0x0541ee0e,
+    0x0598fdbf, 0x05efbba6, 0x0646285c, 0x069c4478, 0x06f21090, 0x07478d39, 0x079cbb04, 0x07f19a84,
+    0x08462c46, 0x089a70da, 0x08ee68cc, 0x094214a6, 0x099574f1, 0x09e88a37, 0x0a3b54fd, 0x0a8dd5c8,
+    0x0ae00d1d, 0x0b31fb7d, 0x0b83a16a, 0x0bd4ff64, 0x0c2615e8, 0x0c76e574, 0x0cc76e84, 0x0d17b192,
+    0x0d67af17, 0x0db7678c, 0x0e06db67, 0x0e560b1e, 0x0ea4f726, 0x0ef39ff2, 0x0f4205f4, 0x0f90299d,
+    0x0fde0b5d, 0x102baba2, 0x10790adc, 0x10c62975, 0x111307db, 0x115fa677, 0x11ac05b3, 0x11f825f7,
+    0x124407ab, 0x128fab36, 0x12db10fc, 0x13263963, 0x137124cf, 0x13bbd3a1, 0x1406463b, 0x14507cff,
+    0x149a784c, 0x14e43881, 0x152dbdfc, 0x1577091b, 0x15c01a3a, 0x1608f1b4, 0x16518fe4, 0x1699f525,
+    0x16e221ce, 0x172a1638, 0x1771d2ba, 0x17b957ac, 0x1800a563, 0x1847bc34, 0x188e9c73, 0x18d54674,
+    0x191bba89, 0x1961f905, 0x19a80239, 0x19edd676, 0x1a33760a, 0x1a78e147, 0x1abe1879, 0x1b031bf0,
+    0x1b47ebf7, 0x1b8c88dc, 0x1bd0f2ea, 0x1c152a6c, 0x1c592fad, 0x1c9d02f7, 0x1ce0a492, 0x1d2414c8,
+    0x1d6753e0, 0x1daa6222, 0x1ded3fd4, 0x1e2fed3d, 0x1e726aa2, 0x1eb4b848, 0x1ef6d673, 0x1f38c568,
+    0x1f7a8569, 0x1fbc16b9, 0x1ffd799b, 0x203eae4f, 0x207fb517, 0x20c08e34, 0x210139e5, 0x2141b86a,
+    0x21820a02, 0x21c22eeb, 0x22022763, 0x2241f3a7, 0x228193f5, 0x22c10889, 0x2300519f, 0x233f6f72,
+    0x237e623d, 0x23bd2a3b, 0x23fbc7a6, 0x243a3ab7, 0x247883a8, 0x24b6a2b1, 0x24f4980b, 0x253263ed,
+    0x2570068e, 0x25ad8027, 0x25ead0ec, 0x2627f914, 0x2664f8d5, 0x26a1d065, 0x26de7ff7, 0x271b07c0,
+    0x275767f5, 0x2793a0c9, 0x27cfb26f, 0x280b9d1a, 0x284760fd, 0x2882fe4a, 0x28be7531, 0x28f9c5e6,
+    0x2934f098, 0x296ff578, 0x29aad4b6, 0x29e58e83, 0x2a20230e, 0x2a5a9286, 0x2a94dd19, 0x2acf02f7,
+    0x2b09044d, 0x2b42e149, 0x2b7c9a19, 0x2bb62eea, 0x2bef9fe8, 0x2c28ed40, 0x2c62171f, 0x2c9b1daf,
+    0x2cd4011d, 0x2d0cc193, 0x2d455f3d, 0x2d7dda45, 0x2db632d5, 0x2dee6918, 0x2e267d36, 0x2e5e6f5a,
+    0x2e963fad, 0x2ecdee56, 0x2f057b80, 0x2f3ce751, 0x2f7431f2, 0x2fab5b8b, 0x2fe26443, 0x30194c41,
+    0x305013ab, 0x3086baaa, 0x30bd4161, 0x30f3a7f9, 0x3129ee96, 0x3160155e, 0x31961c77, 0x31cc0404,
+    0x3201cc2c, 0x32377512, 0x326cfedb, 0x32a269ab, 0x32d7b5a5, 0x330ce2ee, 0x3341f1a7, 0x3376e1f5,
+    0x33abb3fb, 0x33e067da, 0x3414fdb5, 0x344975ae, 0x347dcfe7, 0x34b20c82, 0x34e62ba0, 0x351a2d63,
+    0x354e11eb, 0x3581d959, 0x35b583ce, 0x35e9116a, 0x361c824d, 0x364fd698, 0x36830e69, 0x36b629e1,
+    0x36e9291f, 0x371c0c41, 0x374ed367, 0x37817eb0, 0x37b40e3a, 0x37e68223, 0x3818da89, 0x384b178b,
+    0x387d3946, 0x38af3fd7, 0x38e12b5d, 0x3912fbf4, 0x3944b1b9, 0x39764cca, 0x39a7cd42, 0x39d9333e,
+    0x3a0a7eda, 0x3a3bb033, 0x3a6cc765, 0x3a9dc48b, 0x3acea7c0, 0x3aff7121, 0x3b3020c8, 0x3b60b6d1,
+    0x3b913356, 0x3bc19673, 0x3bf1e041, 0x3c2210db, 0x3c52285c, 0x3c8226dd, 0x3cb20c79, 0x3ce1d949,
+    0x3d118d67, 0x3d4128ec, 0x3d70abf2, 0x3da01691, 0x3dcf68e3, 0x3dfea301, 0x3e2dc504, 0x3e5ccf03,
+    0x3e8bc118, 0x3eba9b5a, 0x3ee95de2, 0x3f1808c8, 0x3f469c23, 0x3f75180c, 0x3fa37c99, 0x3fd1c9e3,
+    0x40000000
+};
+
+/* The sigmoid of i / 32, with 30 fractional bits. */
+static const uint32_t __dpu_fixed_sigmoid_table[257] = {
+    0x20000000, 0x207ffd55, 0x20ffeaad, 0x217fb810, 0x21ff5599, 0x227eb37a, 0x22fdc205, 0x237c71b0,
+    0x23fab325, 0x24787741, 0x24f5af1f, 0x25724c1d, 0x25ee3fe4, 0x26697c70, 0x26e3f410, 0x275d9974,
+    0x27d65faa, 0x284e3a28, 0x28c51ccf, 0x293afbf1, 0x29afcc50, 0x2a238328, 0x2a96162b, 0x2b077b89,
+    0x2b77a9ef, 0x2be6988b, 0x2c543f0a, 0x2cc0959e, 0x2d2b94f7, 0x2d95364d, 0x2dfd7356, 0x2e64464d,
+    0x2ec9a9ec, 0x2f2d996e, 0x2f90108d, 0x2ff10b7f, 0x305086f3, 0x30ae8013, 0x310af47e, 0x3165e245,
+    0x31bf47eb, 0x3217245e, 0x326d76f7, 0x32c23f77, 0x33157dff, 0x33673311, 0x33b75f8c, 0x340604a5,
+    0x345323e5, 0x349ebf29, 0x34e8d896, 0x3531729c, 0x35788ff1, 0x35be338a, 0x3602609b, 0x36451a90,
+    0x3686650c, 0x36c643e4, 0x3704bb1b, 0x3741cee2, 0x377d838e, 0x37b7dd9b, 0x37f0e1a5, 0x38289466,
+    0x385efab5, 0x3894197f, 0x38c7f5c7, 0x38fa94a2, 0x392bfb37, 0x395c2eb8, 0x398b3464, 0x39b91180,
+    0x39e5cb5c, 0x3a116748, 0x3a3bea98, 0x3a655aa3, 0x3a8dbcbc, 0x3ab51634, 0x3adb6c59, 0x3b00c471,
+    0x3b2523bb, 0x3b488f71, 0x3b6b0cbf, 0x3b8ca0c8, 0x3bad50a5, 0x3bcd215e, 0x3bec17f2, 0x3c0a394e,
+    0x3c278a53, 0x3c440fcf, 0x3c5fce82, 0x3c7acb19, 0x3c950a33, 0x3cae905a, 0x3cc76207, 0x3cdf83a0,
+    0x3cf6f978, 0x3d0dc7d2, 0x3d23f2d9, 0x3d397ea8, 0x3d4e6f46, 0x3d62c8a6, 0x3d768ea9, 0x3d89c519,
+    0x3d9c6fb0, 0x3dae9213, 0x3dc02fd5, 0x3dd14c73, 0x3de1eb59, 0x3df20fe1, 0x3e01bd4f, 0x3e10f6d6,
+    0x3e1fbf98, 0x3e2e1aa2, 0x3e3c0af1, 0x3e49936e, 0x3e56b6f4, 0x3e637849, 0x3e6fda23, 0x3e7bdf28,
+    0x3e8789ed, 0x3e92dcf6, 0x3e9ddab9, 0x3ea8859a, 0x3eb2dfee, 0x3ebcebfb, 0x3ec6abfa, 0x3ed02212,
+    0x3ed9505e, 0x3ee238eb, 0x3eeaddb6, 0x3ef340b2, 0x3efb63c2, 0x3f0348bd, 0x3f0af16f, 0x3f125f94,
+    0x3f1994df, 0x3f2092f8, 0x3f275b77, 0x3f2defee, 0x3f3451e1, 0x3f3a82c9, 0x3f408416, 0x3f46572e,
+    0x3f4bfd6c, 0x3f517822, 0x3f56c897, 0x3f5bf00a, 0x3f60efb3, 0x3f65c8bd, 0x3f6a7c4d, 0x3f6f0b81,
+    0x3f73776b, 0x3f77c119, 0x3f7be98f, 0x3f7ff1c9, 0x3f83dabf, 0x3f87a55f, 0x3f8b5290, 0x3f8ee334,
+    0x3f925826, 0x3f95b23a, 0x3f98f23d, 0x3f9c18f8, 0x3f9f272e, 0x3fa21d9b, 0x3fa4fcf5, 0x3fa7c5ef,
+    0x3faa7935, 0x3fad176e, 0x3fafa13d, 0x3fb2173f, 0x3fb47a0e, 0x3fb6ca3d, 0x3fb9085d, 0x3fbb34fa,
+    0x3fbd509b, 0x3fbf5bc4, 0x3fc156f4, 0x3fc342a8, 0x3fc51f57, 0x3fc6ed76, 0x3fc8ad76, 0x3fca5fc5,
+    0x3fcc04ce, 0x3fcd9cf7, 0x3fcf28a4, 0x3fd0a838, 0x3fd21c10, 0x3fd38487, 0x3fd4e1f6, 0x3fd634b3,
+    0x3fd77d11, 0x3fd8bb62, 0x3fd9eff3, 0x3fdb1b11, 0x3fdc3d06, 0x3fdd5619, 0x3fde668f, 0x3fdf6eac,
+    0x3fe06eb0, 0x3fe166dc, 0x3fe2576d, 0x3fe3409d, 0x3fe422a7, 0x3fe4fdc3, 0x3fe5d226, 0x3fe6a006,
+    0x3fe76796, 0x3fe82906, 0x3fe8e487, 0x3fe99a47, 0x3fea4a74, 0x3feaf539, 0x3feb9ac0, 0x3fec3b32,
+    0x3fecd6b8, 0x3fed6d78, 0x3fedff96, 0x3fee8d39, 0x3fef1682, 0x3fef9b95, 0x3ff01c91, 0x3ff09997,
+    0x3ff112c6, 0x3ff1883d, 0x3ff1fa18, 0x3ff26873, 0x3ff2d36b, 0x3ff33b1a, 0x3ff39f99, 0x3ff40102,
+    0x3ff45f6d, 0x3ff4baf1, 0x3ff513a6, 0x3ff569a0, 0x3ff5bcf7, 0x3ff60dbe, 0x3ff65c09, 0x3ff6a7ec,
+    0x3ff6f17a, 0x3ff738c6, 0x3ff77de1, 0x3ff7c0dc, 0x3ff801c7, 0x3ff840b4, 0x3ff87db2, 0x3ff8b8d0,
+    0x3ff8f21d, 0x3ff929a7, 0x3ff95f7b, 0x3ff993a8, 0x3ff9c63b, 0x3ff9f73f, 0x3ffa26c2, 0x3ffa54ce,
+    0x3ffa8171
+};
+
+/* The product of two signed 32-bit integers shifted right, rounded to nearest, halfway cases away from zero. */
+static inline int64_t
+__dpu_fixed_mul_shift(int32_t a, int32_t b, uint32_t shift)
+{
+    uint32_t magnitude_a = a < 0 ? -(uint32_t)a : (uint32_t)a, magnitude_b = b < 0 ? -(uint32_t)b : (uint32_t)b;
+    uint64_t product = (uint64_t)magnitude_a * magnitude_b;
+
+    if (shift != 0) {
+        product = (product + ((uint64_t)1 << (shift - 1))) >> shift;
+    }
+    return (a < 0) != (b < 0) ? -(int64_t)product : (int64_t)product;
+}
+
+static inline int32_t
+__dpu_fixed_saturate32(int64_t value)
+{
+    return value > INT32_MAX ? INT32_MAX : value < INT32_MIN ? INT32_MIN : (int32_t)value;
+}
+
+static inline int32_t
+__dpu_fixed_clamp(int32_t value, int32_t min, int32_t max)
+{
+    return value > max ? max : value < min ? min : value;
+}
+
+/* Interpolates linearly a table with 30 fractional bits at entry index + fraction / 2^16. */
+static inline uint32_t
+__dpu_fixed_interpolate(const uint32_t *table, uint32_t index, uint32_t fraction)
+{
+    uint32_t low = table[index], difference = table[index + 1] - low;
+
+    return low + (difference >> 16) * fraction + (((difference & 0xffff) * fraction) >> 16);
+}
+
+/**
+ * @brief The sum of two Q0.15 values, saturated, identical to fixed_q15_add on the DPU.
+ */
+static inline dpu_fixed_q15_t
+dpu_fixed_q15_add(dpu_fixed_q15_t a, dpu_fixed_q15_t b)
+{
+    return (dpu_fixed_q15_t)__dpu_fixed_clamp((int32_t)a + b, DPU_FIXED_Q15_MIN, DPU_FIXED_Q15_MAX);
+}
+
+/**
+ * @brief The difference of two Q0.15 values, saturated, identical to fixed_q15_sub on the DPU.
+ */
+static inline dpu_fixed_q15_t
+dpu_fixed_q15_sub(dpu_fixed_q15_t a, dpu_fixed_q15_t b)
+{
+    return (dpu_fixed_q15_t)__dpu_fixed_clamp((int32_t)a - b, DPU_FIXED_Q15_MIN, DPU_FIXED_Q15_MAX);
+}
+
+/**
+ * @brief The product of two Q0.15 values, rounded to nearest and saturated, identical to fixed_q15_mul on the DPU.
+ */
+static inline dpu_fixed_q15_t
+dpu_fixed_q15_mul(dpu_fixed_q15_t a, dpu_fixed_q15_t b)
+{
+    int32_t product = (int32_t)a * b;
+    int32_t magnitude = product < 0 ? -product : product;
+
+    magnitude = (magnitude + (1 << 14)) >> 15;
+    return (dpu_fixed_q15_t)__dpu_fixed_clamp(product < 0 ? -magnitude : magnitude, DPU_FIXED_Q15_MIN, DPU_FIXED_Q15_MAX);
+}
+
+/**
+ * @brief The sum of two Q15.16 values, saturated, identical to fixed_q16_add on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_add(dpu_fixed_q16_t a, dpu_fixed_q16_t b)
+{
+    return __dpu_fixed_saturate32((int64_t)a + b);
+}
+
+/**
+ * @brief The difference of two Q15.16 values, saturated, identical to fixed_q16_sub on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_sub(dpu_fixed_q16_t a, dpu_fixed_q16_t b)
+{
+    return __dpu_fixed_saturate32((int64_t)a - b);
+}
+
+/**
+ * @brief The product of two Q15.16 values, rounded to nearest and saturated, identical to fixed_q16_mul on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_mul(dpu_fixed_q16_t a, dpu_fixed_q16_t b)
+{
+    return __dpu_fixed_saturate32(__dpu_fixed_mul_shift(a, b, 16));
+}
+
+/**
+ * @brief The Q15.16 value of an integer, saturated, identical to fixed_q16_from_int on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_from_int(int32_t value)
+{
+    return (dpu_fixed_q16_t)((uint32_t)__dpu_fixed_clamp(value, INT16_MIN, INT16_MAX) << 16);
+}
+
+/**
+ * @brief The integer nearest to a Q15.16 value, halfway cases rounded up, identical to fixed_q16_to_int on the DPU.
+ */
+static inline int32_t
+dpu_fixed_q16_to_int(dpu_fixed_q16_t value)
+{
+    return (int32_t)(((int64_t)value + 0x8000) >> 16);
+}
+
+/**
+ * @brief The Q0.15 value of a Q15.16 value, rounded to nearest and saturated, identical to fixed_q16_to_q15 on the DPU.
+ */
+static inline dpu_fixed_q15_t
+dpu_fixed_q16_to_q15(dpu_fixed_q16_t value)
+{
+    return (dpu_fixed_q15_t)__dpu_fixed_clamp((int32_t)(((int64_t)value + 1) >> 1), DPU_FIXED_Q15_MIN, DPU_FIXED_Q15_MAX);
+}
+
+/**
+ * @brief The Q15.16 value of a Q0.15 value, identical to fixed_q15_to_q16 on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q15_to_q16(dpu_fixed_q15_t value)
+{
+    return (dpu_fixed_q16_t)value * 2;
+}
+
+/**
+ * @brief The Q15.16 value nearest to a double, saturated.
+ * @param value the double
+ * @return The value, or DPU_FIXED_Q16_MIN or DPU_FIXED_Q16_MAX when out of range.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_from_double(double value)
+{
+    double scaled = round(value * 65536.0);
+
+    return scaled >= 2147483647.0 ? DPU_FIXED_Q16_MAX : scaled <= -2147483648.0 ? DPU_FIXED_Q16_MIN : (dpu_fixed_q16_t)scaled;
+}
+
+/**
+ * @brief The double value of a Q15.16 value.
+ */
+static inline double
+dpu_fixed_q16_to_double(dpu_fixed_q16_t value)
+{
+    return value / 65536.0;
+}
+
+/**
+ * @brief The exponential of a Q15.16 value, identical to fixed_q16_exp on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_exp(dpu_fixed_q16_t x)
+{
+    int32_t clamped = __dpu_fixed_clamp(x, -DPU_FIXED_Q16_ONE * 16, DPU_FIXED_Q16_ONE * 16);
+    int32_t exponent = (int32_t)__dpu_fixed_mul_shift(clamped, (int32_t)__DPU_FIXED_LOG2_E, 22);
+    int32_t integer = exponent >> 24;
+    uint32_t fraction = (uint32_t)exponent & 0xffffff;
+    uint32_t power = __dpu_fixed_interpolate(__dpu_fixed_exp2_table, fraction >> 16, fraction & 0xffff);
+    int32_t shift = 14 - integer;
+
+    if (shift <= 0) {
+        return shift == 0 ? (dpu_fixed_q16_t)power : DPU_FIXED_Q16_MAX;
+    }
+    if (shift >= 32) {
+        return 0;
+    }
+    return (dpu_fixed_q16_t)((power + (1u << (shift - 1))) >> shift);
+}
+
+/**
+ * @brief The natural logarithm of a Q15.16 value, DPU_FIXED_Q16_MIN when not positive, identical to fixed_q16_log on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_log(dpu_fixed_q16_t x)
+{
+    uint32_t top, mantissa;
+    int32_t logarithm;
+
+    if (x <= 0) {
+        return DPU_FIXED_Q16_MIN;
+    }
+    top = 31 - __builtin_clz((uint32_t)x);
+    mantissa = (uint32_t)x << (31 - top);
+    logarithm = (int32_t)((top - 16) << 24)
+        + (int32_t)(__dpu_fixed_interpolate(__dpu_fixed_log2_table, (mantissa >> 23) & 0xff, (mantissa >> 7) & 0xffff) >> 6);
+    return (dpu_fixed_q16_t)__dpu_fixed_mul_shift(logarithm, (int32_t)__DPU_FIXED_LN_2, 38);
+}
+
+/**
+ * @brief The sigmoid 1 / (1 + e^-x) of a Q15.16 value, identical to fixed_q16_sigmoid on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_q16_sigmoid(dpu_fixed_q16_t x)
+{
+    uint32_t magnitude = x < 0 ? -(uint32_t)x : (uint32_t)x;
+    dpu_fixed_q16_t sigmoid;
+
+    if (magnitude >= 8 * DPU_FIXED_Q16_ONE) {
+        sigmoid = DPU_FIXED_Q16_ONE - dpu_fixed_q16_exp(-(dpu_fixed_q16_t)(magnitude > INT32_MAX ? INT32_MAX : magnitude));
+    } else {
+        uint32_t value = __dpu_fixed_interpolate(__dpu_fixed_sigmoid_table, magnitude >> 11, (magnitude & 0x7ff) << 5);
+        sigmoid = (dpu_fixed_q16_t)((value + (1u << 13)) >> 14);
+    }
+    return x < 0 ? DPU_FIXED_Q16_ONE - sigmoid : sigmoid;
+}
+
+/* Writes a positive value as mantissa / 2^shift, with a mantissa of 31 significant bits. */
+static inline void
+__dpu_fixed_mantissa(double value, int32_t *mantissa, uint32_t *shift)
+{
+    int exponent;
+    double rounded = round(ldexp(frexp(value, &exponent), 31));
+
+    if (rounded >= 2147483648.0) {
+        rounded /= 2;
+        exponent++;
+    }
+    *mantissa = (int32_t)rounded;
+    *shift = (uint32_t)(31 - exponent);
+}
+
+/**
+ * @brief Computes the quantization of the real values of [min, max] to integers of nr_bits bits.
+ *
+ * The range is extended to include 0, so that 0 is quantized exactly, as padding and ReLU outputs need.
+ *
+ * @param min the smallest value
+ * @param max the largest value
+ * @param nr_bits the number of bits of the quantized integers, 8 or 16
+ * @param q receives the quantization, to be copied into a struct fixed_quantization of the DPUs
+ */
+static inline void
+dpu_fixed_quantization_of_range(double min, double max, uint32_t nr_bits, struct dpu_fixed_quantization *q)
+{
+    double quantized_min = -ldexp(1.0, nr_bits - 1), quantized_max = ldexp(1.0, nr_bits - 1) - 1;
+    double scale, zero_point;
+
+    min = min < 0.0 ? min : 0.0;
+    max = max > 0.0 ? max : 0.0;
+    scale = max > min ? (max - min) / (quantized_max - quantized_min) : 1.0;
+    /* Bounds the shifts of the products of the DPUs to [0, 63]. */
+    scale = scale < ldexp(1.0, -24) ? ldexp(1.0, -24) : scale > ldexp(1.0, 14) ? ldexp(1.0, 14) : scale;
+    zero_point = round(quantized_min - min / scale);
+    zero_point = zero_point < quantized_min ? quantized_min : zero_point > quantized_max ? quantized_max : zero_point;
+    __dpu_fixed_mantissa(scale, &q->scale, &q->scale_shift);
+    __dpu_fixed_mantissa(1.0 / scale, &q->inverse_scale, &q->inverse_shift);
+    q->zero_point = (int32_t)zero_point;
+}
+
+static inline int32_t
+__dpu_fixed_quantize(dpu_fixed_q16_t value, const struct dpu_fixed_quantization *q, int32_t min, int32_t max)
+{
+    int64_t quantized = __dpu_fixed_mul_shift(value, q->inverse_scale, q->inverse_shift + 16) + q->zero_point;
+
+    return quantized > max ? max : quantized < min ? min : (int32_t)quantized;
+}
+
+/**
+ * @brief Quantizes a Q15.16 value to an 8-bit integer, identical to fixed_quantize_int8 on the DPU.
+ */
+static inline int8_t
+dpu_fixed_quantize_int8(dpu_fixed_q16_t value, const struct dpu_fixed_quantization *q)
+{
+    return (int8_t)__dpu_fixed_quantize(value, q, INT8_MIN, INT8_MAX);
+}
+
+/**
+ * @brief Quantizes a Q15.16 value to a 16-bit integer, identical to fixed_quantize_int16 on the DPU.
+ */
+static inline int16_t
+dpu_fixed_quantize_int16(dpu_fixed_q16_t value, const struct dpu_fixed_quantization *q)
+{
+    return (int16_t)__dpu_fixed_quantize(value, q, INT16_MIN, INT16_MAX);
+}
+
+/**
+ * @brief The Q15.16 value of a quantized integer, identical to fixed_dequantize on the DPU.
+ */
+static inline dpu_fixed_q16_t
+dpu_fixed_dequantize(int32_t quantized, const struct dpu_fixed_quantization *q)
+{
+    return __dpu_fixed_saturate32(__dpu_fixed_mul_shift(quantized - q->zero_point, q->scale, q->scale_shift - 16));
+}
+
+#endif /* __DPU_FIXED_POINT_H */
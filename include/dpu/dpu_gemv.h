@@ -0,0 +1,282 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_GEMV_H
+#define __DPU_GEMV_H
+
+/**
+ * @file dpu_gemv.h
+ * @brief Host side of the matrix-vector products of the DPU runtime (gemv.h).
+ *
+ * A row-major matrix is split in slices of consecutive rows, one per DPU, when it is loaded: it stays in MRAM for all the
+ * products. Each product broadcasts the vectors to all the DPUs, which multiply their slice of the matrix with them, and
+ * gathers the slices of the results.
+ *
+ * The DPU program is provided by the application, calls gemv_multiply with its symbols, and must define:
+ *  - matrix in MRAM, large enough for the slice of the matrix of a DPU,
+ *  - output, an int32_t array in MRAM, large enough for the results of the slice for all the vectors,
+ *  - vectors, a __host array in WRAM, large enough for the vectors,
+ *  - uint32_t nr_rows, nr_columns, nr_vectors, type and shift, set by the host.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+
+/**
+ * @brief The type of the elements of the matrix and of the vectors, identical to gemv_type_t on the DPU.
+ */
+typedef enum _dpu_gemv_type_t {
+    DPU_GEMV_INT8 = 0,
+    DPU_GEMV_INT16 = 1,
+    DPU_GEMV_INT32 = 2,
+} dpu_gemv_type_t;
+
+/**
+ * @brief A matrix loaded on a DPU set.
+ */
+struct dpu_gemv {
+    struct dpu_set_t dpu_set;
+    uint32_t nr_dpus;
+    dpu_gemv_type_t type;
+    uint32_t nr_rows;
+    uint32_t nr_columns;
+    uint32_t rows_per_dpu;
+    uint32_t row_size;
+};
+
+/* The number of rows of the slice of a DPU. */
+static inline uint32_t
+__dpu_gemv_rows_of(const struct dpu_gemv *gemv, uint32_t dpu)
+{
+    uint64_t first_row = (uint64_t)dpu * gemv->rows_per_dpu;
+
+    if (first_row >= gemv->nr_rows) {
+        return 0;
+    }
+    return gemv->nr_rows - first_row < gemv->rows_per_dpu ? (uint32_t)(gemv->nr_rows - first_row) : gemv->rows_per_dpu;
+}
+
+/* Copies rows of nr_columns elements to rows of row_size bytes, the padding being already zero. */
+static inline void
+__dpu_gemv_pad(const struct dpu_gemv *gemv, uint8_t *padded, const uint8_t *rows, uint32_t nr_rows)
+{
+    size_t length = (size_t)gemv->nr_columns << gemv->type;
+
+    for (uint32_t each_row = 0; each_row < nr_rows; each_row++) {
+        memcpy(padded + (size_t)each_row * gemv->row_size, rows + each_row * length, length);
+    }
+}
+
+/**
+ * @brief Splits a matrix between the DPUs of a set, where the DPU program is loaded.
+ *
+ * The rows of the slices are copied to the DPUs from the matrix itself when they need no padding, and from a temporary
+ * copy otherwise.
+ *
+ * @param dpu_set the DPU set
+ * @param type the type of the elements
+ * @param matrix the row-major matrix
+ * @param nr_rows the number of rows
+ * @param nr_columns the number of columns
+ * @param gemv receives the description of the loaded matrix
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_gemv_load(struct dpu_set_t dpu_set,
+    dpu_gemv_type_t type,
+    const void *matrix,
+    uint32_t nr_rows,
+    uint32_t nr_columns,
+    struct dpu_gemv *gemv)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu, *counts;
+    size_t slice_size;
+    bool direct;
+    uint8_t *staging;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &gemv->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    gemv->dpu_set = dpu_set;
+    gemv->type = type;
+    gemv->nr_rows = nr_rows;
+    gemv->nr_columns = nr_columns;
+    gemv->rows_per_dpu = (((nr_rows + gemv->nr_dpus - 1) / gemv->nr_dpus) + 1) & ~1;
+    gemv->row_size = (((uint32_t)nr_columns << type) + 7) & ~7;
+    slice_size = (size_t)gemv->rows_per_dpu * gemv->row_size;
+
+    /* Without padding, only the last slice holding rows and the empty slices need a copy. */
+    direct = ((size_t)nr_columns << type) == gemv->row_size;
+    counts = malloc(gemv->nr_dpus * sizeof(*counts));
+    staging = calloc(direct ? 2 : gemv->nr_dpus, slice_size != 0 ? slice_size : 1);
+    if (counts == NULL || staging == NULL) {
+        free(counts);
+        free(staging);
+        return DPU_ERR_SYSTEM;
+    }
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        const uint8_t *rows = (const uint8_t *)matrix + (((size_t)each_dpu * gemv->rows_per_dpu * nr_columns) << type);
+        uint8_t *slice;
+
+        counts[each_dpu] = __dpu_gemv_rows_of(gemv, each_dpu);
+        if (direct && counts[each_dpu] == gemv->rows_per_dpu) {
+            slice = (uint8_t *)rows;
+        } else {
+            slice = direct ? staging + (counts[each_dpu] == 0 ? slice_size : 0) : staging + each_dpu * slice_size;
+            __dpu_gemv_pad(gemv, slice, rows, counts[each_dpu]);
+        }
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, slice);
+        }
+    }
+    if (status == DPU_OK && slice_size != 0) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "matrix", 0, slice_size, DPU_XFER_DEFAULT);
+    }
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &counts[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "nr_rows", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        status = dpu_broadcast_to(dpu_set, "nr_columns", 0, &nr_columns, sizeof(nr_columns), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        uint32_t dpu_type = type;
+        status = dpu_broadcast_to(dpu_set, "type", 0, &dpu_type, sizeof(dpu_type), DPU_XFER_DEFAULT);
+    }
+
+    free(counts);
+    free(staging);
+    return status;
+}
+
+/**
+ * @brief Multiplies the matrix loaded on the DPUs with vectors: output[v][r] = sum over c of matrix[r][c] * vectors[v][c].
+ *
+ * The products are accumulated on 64 bits, wrapping around on overflow, shifted right by shift bits with rounding to
+ * nearest, and truncated to 32 bits, as computed by dpu_gemv_reference.
+ *
+ * @param gemv the matrix, loaded by dpu_gemv_load
+ * @param vectors the vectors, one after the other, each of nr_columns elements
+ * @param nr_vectors the number of vectors, at most GEMV_MAX_VECTORS of the DPU program
+ * @param shift the number of fractional bits of the products, 0 for integers
+ * @param output receives the results, nr_rows per vector
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_gemv_multiply(struct dpu_gemv *gemv, const void *vectors, uint32_t nr_vectors, uint32_t shift, int32_t *output)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    size_t length = (size_t)nr_vectors * gemv->rows_per_dpu;
+    uint8_t *padded = calloc(nr_vectors != 0 ? nr_vectors : 1, gemv->row_size);
+    int32_t *results = malloc((length != 0 ? length : 1) * gemv->nr_dpus * sizeof(int32_t));
+    dpu_error_t status = DPU_OK;
+
+    if (padded == NULL || results == NULL) {
+        free(padded);
+        free(results);
+        return DPU_ERR_SYSTEM;
+    }
+    __dpu_gemv_pad(gemv, padded, (const uint8_t *)vectors, nr_vectors);
+
+    status = dpu_broadcast_to(gemv->dpu_set, "vectors", 0, padded, (size_t)nr_vectors * gemv->row_size, DPU_XFER_DEFAULT);
+    if (status == DPU_OK) {
+        status = dpu_broadcast_to(gemv->dpu_set, "nr_vectors", 0, &nr_vectors, sizeof(nr_vectors), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        status = dpu_broadcast_to(gemv->dpu_set, "shift", 0, &shift, sizeof(shift), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        status = dpu_launch(gemv->dpu_set, DPU_SYNCHRONOUS);
+    }
+
+    DPU_FOREACH (gemv->dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &results[each_dpu * length]);
+        }
+    }
+    if (status == DPU_OK && length != 0) {
+        status = dpu_push_xfer(gemv->dpu_set, DPU_XFER_FROM_DPU, "output", 0, length * sizeof(int32_t), DPU_XFER_DEFAULT);
+    }
+
+    /* The results of a vector on a DPU are followed by a padding result when its slice has an odd number of rows. */
+    for (each_dpu = 0; status == DPU_OK && each_dpu < gemv->nr_dpus; each_dpu++) {
+        uint32_t nr_rows = __dpu_gemv_rows_of(gemv, each_dpu);
+        uint32_t stride = (nr_rows + 1) & ~1;
+        for (uint32_t each_vector = 0; each_vector < nr_vectors; each_vector++) {
+            memcpy(&output[(size_t)each_vector * gemv->nr_rows + (size_t)each_dpu * gemv->rows_per_dpu],
+                &results[each_dpu * length + (size_t)each_vector * stride],
+                nr_rows * sizeof(int32_t));
+        }
+    }
+
+    free(padded);
+    free(results);
+    return status;
+}
+
+/**
+ * @brief Multiplies a matrix with vectors on the host, with the same results as dpu_gemv_multiply.
+ * @param type the type of the elements
+ * @param matrix the row-major matrix
+ * @param nr_rows the number of rows
+ * @param nr_columns the number of columns
+ * @param vectors the vectors, one after the other, each of nr_columns elements
+ * @param nr_vectors the number of vectors
+ * @param shift the number of fractional bits of the products, 0 for integers
+ * @param output receives the results, nr_rows per vector
+ */
+static inline void
+dpu_gemv_reference(dpu_gemv_type_t type,
+    const void *matrix,
+    uint32_t nr_rows,
+    uint32_t nr_columns,
+    const void *vectors,
+    uint32_t nr_vectors,
+    uint32_t shift,
+    int32_t *output)
+{
+    uint64_t rounding = shift == 0 ? 0 : (uint64_t)1 << (shift - 1);
+
+    for (uint32_t each_row = 0; each_row < nr_rows; each_row++) {
+        for (uint32_t each_vector = 0; each_vector < nr_vectors; each_vector++) {
+            size_t row = (size_t)each_row * nr_columns, vector = (size_t)each_vector * nr_columns;
+            uint64_t sum = 0;
+
+            if (type == DPU_GEMV_INT8) {
+                const int8_t *a = (const int8_t *)matrix + row, *b = (const int8_t *)vectors + vector;
+                for (uint32_t each_column = 0; each_column < nr_columns; each_column++) {
+                    sum += a[each_column] * b[each_column];
+                }
+            } else if (type == DPU_GEMV_INT16) {
+                const int16_t *a = (const int16_t *)matrix + row, *b = (const int16_t *)vectors + vector;
+                for (uint32_t each_column = 0; each_column < nr_columns; each_column++) {
+                    sum += a[each_column] * b[each_column];
+                }
+            } else {
+                const int32_t *a = (const int32_t *)matrix + row, *b = (const int32_t *)vectors + vector;
+                for (uint32_t each_column = 0; each_column < nr_columns; each_column++) {
+                    sum += (uint64_t)((int64_t)a[each_column] * b[each_column]);
+                }
+            }
+            output[(size_t)each_vector * nr_rows + each_row] = (int32_t)((int64_t)(sum + rounding) >> shift);
+        }
+    }
+}
+
+#endif /* __DPU_GEMV_H */
@@ -0,0 +1,222 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_GROUP_BY_H
+#define __DPU_GROUP_BY_H
+
+/**
+ * @file dpu_group_by.h
+ * @brief Host side of the aggregations by key of the DPU runtime (group_by.h).
+ *
+ * Each DPU aggregates its own rows, so a group appears in the output of every DPU holding some of its rows. The groups of
+ * all the DPUs are read back with one scatter/gather transfer moving only the groups of each DPU (see dpu_varlen.h), and
+ * merged by dpu_group_merge: the keys are split between threads by hash, and each thread merges its keys in its own hash
+ * table, without any synchronization.
+ */
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_hash_table.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief The aggregates of a group, identical to struct group_by_entry on the DPU.
+ */
+struct dpu_group {
+    uint32_t key;
+    uint32_t count;
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+};
+
+/**
+ * @brief Computes where the groups of each DPU are stored by dpu_group_pull.
+ * @param nr_groups the number of groups of each DPU, in the order of DPU_FOREACH
+ * @param nr_dpus the number of DPUs
+ * @param offsets storage for the nr_dpus + 1 byte offsets of the groups of each DPU
+ * @return The size of the largest array of groups, in bytes.
+ */
+static inline size_t
+dpu_group_offsets(const uint32_t *nr_groups, uint32_t nr_dpus, uint64_t *offsets)
+{
+    size_t max_length = 0;
+
+    offsets[0] = 0;
+    for (uint32_t each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+        uint64_t length = (uint64_t)nr_groups[each_dpu] * sizeof(struct dpu_group);
+        offsets[each_dpu + 1] = offsets[each_dpu] + length;
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    return max_length;
+}
+
+/**
+ * @brief Reads the groups of the DPUs, moving only the groups of each DPU.
+ * @param dpu_set the DPU set, allocated with the "sgXferEnable=true" profile option
+ * @param symbol_name the DPU symbol of the groups
+ * @param groups the host buffer, of offsets[nr_dpus] bytes
+ * @param offsets the offsets computed by dpu_group_offsets
+ * @param max_length the value returned by dpu_group_offsets
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_group_pull(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    struct dpu_group *groups,
+    const uint64_t *offsets,
+    size_t max_length)
+{
+    return dpu_push_varlen_xfer(
+        dpu_set, DPU_XFER_FROM_DPU, symbol_name, 0, groups, offsets, max_length, DPU_SG_XFER_DEFAULT);
+}
+
+struct __dpu_group_merger {
+    const struct dpu_group *groups;
+    uint64_t nr_groups;
+    uint32_t nr_threads;
+    uint32_t thread;
+    struct dpu_group *table;
+    uint64_t nr_merged;
+    bool started;
+    bool failed;
+};
+
+static inline uint32_t
+__dpu_group_thread_of(uint32_t key, uint32_t nr_threads)
+{
+    /* The table of a thread is indexed by the low bits of the hash: split the keys with the high bits. */
+    return (uint32_t)(((uint64_t)dpu_hash_key(key) * nr_threads) >> 32);
+}
+
+static inline void *
+__dpu_group_merge_thread(void *args)
+{
+    struct __dpu_group_merger *merger = (struct __dpu_group_merger *)args;
+    uint64_t nr_keys = 0, mask = 1, nr_merged = 0;
+
+    for (uint64_t each_group = 0; each_group < merger->nr_groups; each_group++) {
+        nr_keys += __dpu_group_thread_of(merger->groups[each_group].key, merger->nr_threads) == merger->thread;
+    }
+    while (mask < 2 * nr_keys) {
+        mask <<= 1;
+    }
+    mask--;
+    if ((merger->table = calloc(mask + 1, sizeof(struct dpu_group))) == NULL) {
+        merger->failed = true;
+        return NULL;
+    }
+
+    for (uint64_t each_group = 0; each_group < merger->nr_groups; each_group++) {
+        const struct dpu_group *group = &merger->groups[each_group];
+        uint64_t index;
+
+        if (__dpu_group_thread_of(group->key, merger->nr_threads) != merger->thread) {
+            continue;
+        }
+        for (index = dpu_hash_key(group->key) & mask;; index = (index + 1) & mask) {
+            struct dpu_group *slot = &merger->table[index];
+            if (slot->count == 0) {
+                *slot = *group;
+                nr_merged++;
+                break;
+            }
+            if (slot->key == group->key) {
+                slot->count += group->count;
+                slot->sum += group->sum;
+                slot->min = group->min < slot->min ? group->min : slot->min;
+                slot->max = group->max > slot->max ? group->max : slot->max;
+                break;
+            }
+        }
+    }
+
+    /* Pack the groups at the beginning of the table. */
+    for (uint64_t from = 0, to = 0; from <= mask; from++) {
+        if (merger->table[from].count != 0) {
+            merger->table[to++] = merger->table[from];
+        }
+    }
+    merger->nr_merged = nr_merged;
+    return NULL;
+}
+
+/**
+ * @brief Merges the groups read back from the DPUs, summing the groups of the same key.
+ * @param groups the groups of all the DPUs
+ * @param nr_groups the number of groups
+ * @param nr_threads the number of threads merging the groups
+ * @param merged receives an array holding one group per key, in no particular order, to release with free
+ * @param nr_merged receives the number of keys
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_group_merge(const struct dpu_group *groups,
+    uint64_t nr_groups,
+    uint32_t nr_threads,
+    struct dpu_group **merged,
+    uint64_t *nr_merged)
+{
+    struct __dpu_group_merger *mergers = calloc(nr_threads, sizeof(*mergers));
+    pthread_t *threads = calloc(nr_threads, sizeof(*threads));
+    dpu_error_t status = DPU_OK;
+    uint64_t total = 0;
+
+    if (mergers == NULL || threads == NULL) {
+        free(mergers);
+        free(threads);
+        return DPU_ERR_SYSTEM;
+    }
+
+    for (uint32_t each_thread = 0; each_thread < nr_threads; each_thread++) {
+        struct __dpu_group_merger *merger = &mergers[each_thread];
+        merger->groups = groups;
+        merger->nr_groups = nr_groups;
+        merger->nr_threads = nr_threads;
+        merger->thread = each_thread;
+        merger->started = pthread_create(&threads[each_thread], NULL, __dpu_group_merge_thread, merger) == 0;
+        if (!merger->started) {
+            __dpu_group_merge_thread(merger);
+        }
+    }
+    for (uint32_t each_thread = 0; each_thread < nr_threads; each_thread++) {
+        if (mergers[each_thread].started) {
+            pthread_join(threads[each_thread], NULL);
+        }
+        if (mergers[each_thread].failed) {
+            status = DPU_ERR_SYSTEM;
+        }
+        total += mergers[each_thread].nr_merged;
+    }
+
+    if (status == DPU_OK && (*merged = malloc((total != 0 ? total : 1) * sizeof(struct dpu_group))) == NULL) {
+        status = DPU_ERR_SYSTEM;
+    }
+    if (status == DPU_OK) {
+        total = 0;
+        for (uint32_t each_thread = 0; each_thread < nr_threads; each_thread++) {
+            memcpy(*merged + total, mergers[each_thread].table, mergers[each_thread].nr_merged * sizeof(struct dpu_group));
+            total += mergers[each_thread].nr_merged;
+        }
+        *nr_merged = total;
+    }
+
+    for (uint32_t each_thread = 0; each_thread < nr_threads; each_thread++) {
+        free(mergers[each_thread].table);
+    }
+    free(mergers);
+    free(threads);
+    return status;
+}
+
+#endif /* __DPU_GROUP_BY_H */
@@ -0,0 +1,211 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_HASH_TABLE_H
+#define __DPU_HASH_TABLE_H
+
+/**
+ * @file dpu_hash_table.h
+ * @brief Host side of the MRAM hash tables of the DPU runtime (mram_hash.h).
+ *
+ * A table can be built on the host, with the same hash function, bucket layout and linear probing as the DPU code, and
+ * copied to the MRAM of the DPUs instead of being filled by the DPUs one insertion at a time. When the keys are spread
+ * between the DPUs, dpu_hash_dpu_of gives the DPU of a key from the high bits of its hash, while the bucket index uses
+ * the low bits: the two are independent as long as the number of buckets times the number of DPUs is at most 2^32.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <dpu.h>
+
+/**
+ * @brief The key of a free slot, which cannot be stored in a table.
+ */
+#define DPU_HASH_EMPTY_KEY 0xffffffffu
+
+/**
+ * @brief The hash of a key, identical to mram_hash_key on the DPU.
+ * @param key the key
+ * @return The hash of the key.
+ */
+static inline uint32_t
+dpu_hash_key(uint32_t key)
+{
+    uint32_t h = key;
+    h ^= h >> 16;
+    h += h << 3;
+    h ^= h >> 11;
+    h += h << 15;
+    h ^= h >> 7;
+    return h;
+}
+
+/**
+ * @brief The DPU owning a key when the keys are hash-partitioned between DPUs.
+ * @param key the key
+ * @param nr_dpus the number of DPUs
+ * @return The index of the DPU, in [0, nr_dpus).
+ */
+static inline uint32_t
+dpu_hash_dpu_of(uint32_t key, uint32_t nr_dpus)
+{
+    uint32_t h = dpu_hash_key(key);
+    /* The bucket index uses the low bits of the hash: the DPU is picked by the high bits. */
+    return (uint32_t)(((uint64_t)h * nr_dpus) >> 32);
+}
+
+/**
+ * @brief The smallest power of 2 number of buckets holding the keys below the given load factor.
+ * @param nr_keys the number of keys
+ * @param max_load_percent the maximum ratio of occupied slots, in percent
+ * @param bucket_size the size of a bucket in bytes (MRAM_HASH_BUCKET_SIZE on the DPU)
+ * @return The number of buckets.
+ */
+static inline uint32_t
+dpu_hash_nr_buckets(uint64_t nr_keys, uint32_t max_load_percent, uint32_t bucket_size)
+{
+    uint64_t nr_slots = (nr_keys * 100 + max_load_percent - 1) / max_load_percent;
+    uint64_t slots_per_bucket = bucket_size / 8;
+    uint32_t nr_buckets = 1;
+
+    while ((uint64_t)nr_buckets * slots_per_bucket < nr_slots) {
+        nr_buckets <<= 1;
+    }
+    return nr_buckets;
+}
+
+/**
+ * @brief Initializes an empty table in host memory.
+ * @param table the table, of nr_buckets * bucket_size bytes
+ * @param nr_buckets the number of buckets, a power of 2
+ * @param bucket_size the size of a bucket in bytes
+ */
+static inline void
+dpu_hash_clear(void *table, uint32_t nr_buckets, uint32_t bucket_size)
+{
+    memset(table, 0xff, (size_t)nr_buckets * bucket_size);
+}
+
+/**
+ * @brief Inserts a key in a table in host memory, or replaces its value if the key is already in the table.
+ * @param table the table
+ * @param nr_buckets the number of buckets, a power of 2
+ * @param bucket_size the size of a bucket in bytes
+ * @param key the key, different from DPU_HASH_EMPTY_KEY
+ * @param value the value
+ * @return Whether the key could be stored (false when the table is full).
+ */
+static inline bool
+dpu_hash_insert(void *table, uint32_t nr_buckets, uint32_t bucket_size, uint32_t key, uint32_t value)
+{
+    uint32_t slots_per_bucket = bucket_size / 8;
+    uint32_t bucket = dpu_hash_key(key) & (nr_buckets - 1);
+
+    for (uint32_t each_bucket = 0; each_bucket < nr_buckets; each_bucket++) {
+        uint32_t *slots = (uint32_t *)((uint8_t *)table + (size_t)bucket * bucket_size);
+        for (uint32_t each_slot = 0; each_slot < slots_per_bucket; each_slot++) {
+            if (slots[2 * each_slot] == key || slots[2 * each_slot] == DPU_HASH_EMPTY_KEY) {
+                slots[2 * each_slot] = key;
+                slots[2 * each_slot + 1] = value;
+                return true;
+            }
+        }
+        bucket = (bucket + 1) & (nr_buckets - 1);
+    }
+    return false;
+}
+
+/**
+ * @brief Looks a key up in a table in host memory.
+ * @param table the table
+ * @param nr_buckets the number of buckets, a power of 2
+ * @param bucket_size the size of a bucket in bytes
+ * @param key the key
+ * @param value receives the value of the key, if found
+ * @return Whether the key is in the table.
+ */
+static inline bool
+dpu_hash_lookup(const void *table, uint32_t nr_buckets, uint32_t bucket_size, uint32_t key, uint32_t *value)
+{
+    uint32_t slots_per_bucket = bucket_size / 8;
+    uint32_t bucket = dpu_hash_key(key) & (nr_buckets - 1);
+
+    for (uint32_t each_bucket = 0; each_bucket < nr_buckets; each_bucket++) {
+        const uint32_t *slots = (const uint32_t *)((const uint8_t *)table + (size_t)bucket * bucket_size);
+        for (uint32_t each_slot = 0; each_slot < slots_per_bucket; each_slot++) {
+            if (slots[2 * each_slot] == key) {
+                *value = slots[2 * each_slot + 1];
+                return true;
+            }
+            if (slots[2 * each_slot] == DPU_HASH_EMPTY_KEY) {
+                return false;
+            }
+        }
+        bucket = (bucket + 1) & (nr_buckets - 1);
+    }
+    return false;
+}
+
+/**
+ * @brief Builds a table in host memory from arrays of keys and values.
+ * @param table the table, of nr_buckets * bucket_size bytes
+ * @param nr_buckets the number of buckets, a power of 2
+ * @param bucket_size the size of a bucket in bytes
+ * @param keys the keys
+ * @param values the values
+ * @param nr_keys the number of keys
+ * @return DPU_OK, or DPU_ERR_INVALID_BUFFER_SIZE if the keys do not fit in the table.
+ */
+static inline dpu_error_t
+dpu_hash_build(void *table,
+    uint32_t nr_buckets,
+    uint32_t bucket_size,
+    const uint32_t *keys,
+    const uint32_t *values,
+    uint64_t nr_keys)
+{
+    dpu_hash_clear(table, nr_buckets, bucket_size);
+    for (uint64_t each_key = 0; each_key < nr_keys; each_key++) {
+        if (!dpu_hash_insert(table, nr_buckets, bucket_size, keys[each_key], values[each_key])) {
+            return DPU_ERR_INVALID_BUFFER_SIZE;
+        }
+    }
+    return DPU_OK;
+}
+
+/**
+ * @brief Copies one table per DPU to the MRAM of the DPUs.
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol receiving the tables
+ * @param symbol_offset the byte offset of the tables from the symbol
+ * @param tables the tables, nr_buckets * bucket_size bytes each, in the order of DPU_FOREACH
+ * @param nr_buckets the number of buckets of each table
+ * @param bucket_size the size of a bucket in bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_hash_push(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    void *tables,
+    uint32_t nr_buckets,
+    uint32_t bucket_size)
+{
+    size_t table_size = (size_t)nr_buckets * bucket_size;
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status;
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, (uint8_t *)tables + each_dpu * table_size)) != DPU_OK) {
+            return status;
+        }
+    }
+    return dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, symbol_name, symbol_offset, table_size, DPU_XFER_DEFAULT);
+}
+
+#endif /* __DPU_HASH_TABLE_H */
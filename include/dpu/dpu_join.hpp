@@ -0,0 +1,341 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_JOIN_HPP
+#define __DPU_JOIN_HPP
+
+/**
+ * @file dpu_join.hpp
+ * @brief Equi-join of two relations spread across all the DPUs of a set.
+ *
+ * DPUs cannot exchange data, so the host shuffles the tuples: both relations are hash-partitioned on their key into one
+ * transfer buffer per DPU, so that matching tuples meet on the same DPU. Each DPU then builds an MRAM hash table
+ * (mram_hash.h) from its build tuples, probes it with its probe tuples, and the matches are gathered back with a
+ * scatter/gather transfer of a different length per DPU.
+ *
+ * The DPU program is provided by the application, and must define the following symbols:
+ *  - uint64_t build_tuples[], probe_tuples[] in MRAM: the tuples of the DPU, as JoinTuple,
+ *  - uint64_t matches[] in MRAM: the matches found by the DPU, as JoinMatch,
+ *  - uint32_t nr_build_tuples, nr_probe_tuples, nr_buckets: set by the host before the execution,
+ *  - uint32_t nr_matches: the number of matches found by the DPU, which can exceed the capacity of matches.
+ *
+ * The keys of the build relation must be unique (a primary key), and different from 0xffffffff.
+ * The DPU set must be allocated with scatter/gather transfers enabled (the "sgXferEnable=true" profile option).
+ * This file includes dpu.hpp, which must not be included a second time.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <dpu.hpp>
+
+extern "C" {
+#include <dpu_hash_table.h>
+}
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace dpu {
+
+/**
+ * @brief A tuple of a relation: the join key and a payload (typically a row identifier).
+ */
+struct JoinTuple {
+    uint32_t key;
+    uint32_t payload;
+};
+
+/**
+ * @brief A match of the join: the payloads of the build tuple and of the probe tuple sharing a key.
+ */
+struct JoinMatch {
+    uint32_t buildPayload;
+    uint32_t probePayload;
+};
+
+/**
+ * @brief Time spent in each step of the last join, in seconds.
+ */
+struct JoinTimings {
+    double partition;
+    double transferIn;
+    double execution;
+    double transferOut;
+};
+
+/**
+ * @brief A hash join operator running on a DPU set.
+ */
+class HashJoin {
+public:
+    /**
+     * @brief Prepare a join on a DPU set where the join program is loaded.
+     * @param Set the DPU set
+     * @param MaxBuildTuples the capacity of build_tuples in the DPU program
+     * @param MaxProbeTuples the capacity of probe_tuples in the DPU program
+     * @param MaxMatches the capacity of matches in the DPU program
+     * @param TableSize the size of the MRAM area of the hash table in the DPU program, in bytes
+     * @param BucketSize the size of a bucket of the hash table (MRAM_HASH_BUCKET_SIZE in the DPU program)
+     * @param MaxLoadPercent the maximum load factor of the hash tables, in percent
+     */
+    HashJoin(DpuSet &Set,
+        uint32_t MaxBuildTuples,
+        uint32_t MaxProbeTuples,
+        uint32_t MaxMatches,
+        uint32_t TableSize,
+        uint32_t BucketSize = 64,
+        uint32_t MaxLoadPercent = 70)
+        : set(Set)
+        , nrDpus(Set.dpus().size())
+        , maxBuildTuples(MaxBuildTuples)
+        , maxProbeTuples(MaxProbeTuples)
+        , maxMatches(MaxMatches)
+        , tableSize(TableSize)
+        , bucketSize(BucketSize)
+        , maxLoadPercent(MaxLoadPercent)
+    {
+    }
+
+    /**
+     * @brief Join two relations.
+     * @param Build the build relation, with unique keys
+     * @param Probe the probe relation
+     * @return The matches, in no particular order.
+     * @throws DpuError when a DPU operation fails
+     * @throws std::length_error when the tuples or the matches of a DPU exceed the capacities of the DPU program
+     */
+    std::vector<JoinMatch>
+    join(const std::vector<JoinTuple> &Build, const std::vector<JoinTuple> &Probe)
+    {
+        std::vector<JoinTuple> buildPartitions, probePartitions;
+        std::vector<uint64_t> buildOffsets, probeOffsets, matchOffsets(nrDpus + 1);
+        std::vector<std::vector<uint32_t>> counts(nrDpus, std::vector<uint32_t>(1));
+        std::vector<JoinMatch> matches;
+        uint64_t maxBuild, maxProbe, maxMatchCount = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        maxBuild = partition(Build, buildPartitions, buildOffsets);
+        maxProbe = partition(Probe, probePartitions, probeOffsets);
+        if (maxBuild > maxBuildTuples || maxProbe > maxProbeTuples) {
+            throw std::length_error("dpu::HashJoin: too many tuples for a DPU");
+        }
+        uint32_t nrBuckets = dpu_hash_nr_buckets(maxBuild, maxLoadPercent, bucketSize);
+        if ((uint64_t)nrBuckets * bucketSize > tableSize) {
+            throw std::length_error("dpu::HashJoin: hash table too large for a DPU");
+        }
+        auto partitioned = std::chrono::steady_clock::now();
+
+        set.copy("nr_buckets", std::vector<uint32_t> { nrBuckets });
+        pushCounts("nr_build_tuples", buildOffsets, counts);
+        pushCounts("nr_probe_tuples", probeOffsets, counts);
+        pushTuples("build_tuples", buildPartitions, buildOffsets, maxBuild);
+        pushTuples("probe_tuples", probePartitions, probeOffsets, maxProbe);
+        auto transferredIn = std::chrono::steady_clock::now();
+
+        set.exec();
+        auto executed = std::chrono::steady_clock::now();
+
+        set.copy(counts, "nr_matches");
+        for (unsigned each_dpu = 0; each_dpu < nrDpus; each_dpu++) {
+            uint32_t count = counts[each_dpu][0];
+            if (count > maxMatches) {
+                throw std::length_error("dpu::HashJoin: too many matches for a DPU");
+            }
+            matchOffsets[each_dpu + 1] = matchOffsets[each_dpu] + count;
+            if (count > maxMatchCount) {
+                maxMatchCount = count;
+            }
+        }
+        matches.resize(matchOffsets[nrDpus]);
+        if (maxMatchCount != 0) {
+            set.copyScatterGather(
+                [&](struct sg_block_info *out, uint32_t dpu, uint32_t block) {
+                    uint64_t from = matchOffsets[dpu];
+                    uint64_t to = matchOffsets[dpu + 1];
+                    if (block != 0 || from == to) {
+                        return false;
+                    }
+                    out->addr = reinterpret_cast<uint8_t *>(&matches[from]);
+                    out->length = (to - from) * sizeof(JoinMatch);
+                    return true;
+                },
+                maxMatchCount * sizeof(JoinMatch),
+                "matches",
+                false);
+        }
+        auto transferredOut = std::chrono::steady_clock::now();
+
+        lastTimings.partition = std::chrono::duration<double>(partitioned - start).count();
+        lastTimings.transferIn = std::chrono::duration<double>(transferredIn - partitioned).count();
+        lastTimings.execution = std::chrono::duration<double>(executed - transferredIn).count();
+        lastTimings.transferOut = std::chrono::duration<double>(transferredOut - executed).count();
+        return matches;
+    }
+
+    /**
+     * @return the time spent in each step of the last join
+     */
+    const JoinTimings &
+    timings() const
+    {
+        return lastTimings;
+    }
+
+private:
+    DpuSet &set;
+    unsigned nrDpus;
+    uint32_t maxBuildTuples;
+    uint32_t maxProbeTuples;
+    uint32_t maxMatches;
+    uint32_t tableSize;
+    uint32_t bucketSize;
+    uint32_t maxLoadPercent;
+    JoinTimings lastTimings {};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    /*
+     * The dpu_hash_key of the keys, which are the even 32-bit lanes of the tuples. The odd lanes hash the payloads, and
+     * are ignored.
+     */
+    template <typename Vector, typename Add, typename Xor, typename ShiftLeft, typename ShiftRight>
+    static Vector
+    hashKeys(Vector H, Add add, Xor bitXor, ShiftLeft left, ShiftRight right)
+    {
+        H = bitXor(H, right(H, 16));
+        H = add(H, left(H, 3));
+        H = bitXor(H, right(H, 11));
+        H = add(H, left(H, 15));
+        return bitXor(H, right(H, 7));
+    }
+#endif
+
+    /*
+     * Computes dpu_hash_dpu_of of the key of each tuple: 8 tuples at a time with AVX2, 4 with SSE2. The products of the
+     * hashes by the number of DPUs are computed on the even lanes, each giving a DPU in its high 32 bits, taken from the
+     * high bits of the hash as the bucket index of the DPU uses its low bits.
+     */
+    void
+    destinationsOf(const JoinTuple *Tuples, size_t Count, uint32_t *Destinations)
+    {
+        size_t i = 0;
+
+#if defined(__AVX2__)
+        const __m256i nrDpusVector = _mm256_set1_epi32(static_cast<int>(nrDpus));
+        const __m256i highHalves = _mm256_set1_epi64x(static_cast<long long>(0xffffffff00000000ULL));
+        const __m256i order = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+        auto add = [](__m256i A, __m256i B) { return _mm256_add_epi32(A, B); };
+        auto bitXor = [](__m256i A, __m256i B) { return _mm256_xor_si256(A, B); };
+        auto left = [](__m256i A, int N) { return _mm256_sll_epi32(A, _mm_cvtsi32_si128(N)); };
+        auto right = [](__m256i A, int N) { return _mm256_srl_epi32(A, _mm_cvtsi32_si128(N)); };
+
+        for (; i + 8 <= Count; i += 8) {
+            __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&Tuples[i]));
+            __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&Tuples[i + 4]));
+            low = _mm256_mul_epu32(hashKeys(low, add, bitXor, left, right), nrDpusVector);
+            high = _mm256_mul_epu32(hashKeys(high, add, bitXor, left, right), nrDpusVector);
+            /* The DPUs of tuples 0 to 3 in the even lanes, of tuples 4 to 7 in the odd lanes, then in order. */
+            __m256i both = _mm256_or_si256(_mm256_srli_epi64(low, 32), _mm256_and_si256(high, highHalves));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(&Destinations[i]), _mm256_permutevar8x32_epi32(both, order));
+        }
+#elif defined(__SSE2__)
+        const __m128i nrDpusVector = _mm_set1_epi32(static_cast<int>(nrDpus));
+        const __m128i highHalves = _mm_set1_epi64x(static_cast<long long>(0xffffffff00000000ULL));
+        auto add = [](__m128i A, __m128i B) { return _mm_add_epi32(A, B); };
+        auto bitXor = [](__m128i A, __m128i B) { return _mm_xor_si128(A, B); };
+        auto left = [](__m128i A, int N) { return _mm_sll_epi32(A, _mm_cvtsi32_si128(N)); };
+        auto right = [](__m128i A, int N) { return _mm_srl_epi32(A, _mm_cvtsi32_si128(N)); };
+
+        for (; i + 4 <= Count; i += 4) {
+            __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&Tuples[i]));
+            __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&Tuples[i + 2]));
+            low = _mm_mul_epu32(hashKeys(low, add, bitXor, left, right), nrDpusVector);
+            high = _mm_mul_epu32(hashKeys(high, add, bitXor, left, right), nrDpusVector);
+            /* The DPUs of tuples 0, 2, 1, 3, then in order. */
+            __m128i both = _mm_or_si128(_mm_srli_epi64(low, 32), _mm_and_si128(high, highHalves));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(&Destinations[i]), _mm_shuffle_epi32(both, _MM_SHUFFLE(3, 1, 2, 0)));
+        }
+#endif
+        for (; i < Count; i++) {
+            Destinations[i] = dpu_hash_dpu_of(Tuples[i].key, nrDpus);
+        }
+    }
+
+    /*
+     * Hash-partitions the tuples into one contiguous range per DPU, in two passes over the input: the DPU of every
+     * tuple is computed with AVX2 or SSE2 when they are available, then the tuples are copied to their range.
+     * Returns the size of the largest partition, in tuples.
+     */
+    uint64_t
+    partition(const std::vector<JoinTuple> &Tuples, std::vector<JoinTuple> &Partitions, std::vector<uint64_t> &Offsets)
+    {
+        std::vector<uint32_t> destinations(Tuples.size());
+        std::vector<uint64_t> cursors(nrDpus, 0);
+        uint64_t maxCount = 0;
+
+        destinationsOf(Tuples.data(), Tuples.size(), destinations.data());
+        for (size_t i = 0; i < Tuples.size(); i++) {
+            cursors[destinations[i]]++;
+        }
+
+        Offsets.assign(nrDpus + 1, 0);
+        for (unsigned each_dpu = 0; each_dpu < nrDpus; each_dpu++) {
+            Offsets[each_dpu + 1] = Offsets[each_dpu] + cursors[each_dpu];
+            if (cursors[each_dpu] > maxCount) {
+                maxCount = cursors[each_dpu];
+            }
+            cursors[each_dpu] = Offsets[each_dpu];
+        }
+
+        Partitions.resize(Tuples.size());
+        for (size_t i = 0; i < Tuples.size(); i++) {
+            Partitions[cursors[destinations[i]]++] = Tuples[i];
+        }
+        return maxCount;
+    }
+
+    void
+    pushCounts(const std::string &Symbol, const std::vector<uint64_t> &Offsets, std::vector<std::vector<uint32_t>> &Counts)
+    {
+        for (unsigned each_dpu = 0; each_dpu < nrDpus; each_dpu++) {
+            Counts[each_dpu][0] = Offsets[each_dpu + 1] - Offsets[each_dpu];
+        }
+        set.copy(Symbol, Counts);
+    }
+
+    void
+    pushTuples(const std::string &Symbol,
+        std::vector<JoinTuple> &Partitions,
+        const std::vector<uint64_t> &Offsets,
+        uint64_t MaxCount)
+    {
+        if (MaxCount == 0) {
+            return;
+        }
+        set.copyScatterGather(
+            Symbol,
+            [&](struct sg_block_info *out, uint32_t dpu, uint32_t block) {
+                uint64_t from = Offsets[dpu];
+                uint64_t to = Offsets[dpu + 1];
+                if (block != 0 || from == to) {
+                    return false;
+                }
+                out->addr = reinterpret_cast<uint8_t *>(&Partitions[from]);
+                out->length = (to - from) * sizeof(JoinTuple);
+                return true;
+            },
+            MaxCount * sizeof(JoinTuple),
+            false);
+    }
+};
+
+}
+
+#endif /* __DPU_JOIN_HPP */
@@ -0,0 +1,216 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_KNN_H
+#define __DPU_KNN_H
+
+/**
+ * @file dpu_knn.h
+ * @brief Host side of the k nearest neighbours search of the DPU runtime (knn.h).
+ *
+ * The vectors are spread across the DPUs and stay in MRAM, while the batches of queries are broadcast to all the DPUs.
+ * Each DPU finds the k nearest neighbours of each query among its vectors, sorted by distance. The results of all the
+ * DPUs are read back with one transfer, and dpu_knn_merge selects the k nearest neighbours of each query with a
+ * tournament tree over the sorted lists of the DPUs: each neighbour costs log2(nr_dpus) comparisons.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <dpu.h>
+
+/**
+ * @brief The index of the results beyond the number of vectors, identical to KNN_NO_NEIGHBOUR on the DPU.
+ */
+#define DPU_KNN_NO_NEIGHBOUR 0xffffffffu
+
+/**
+ * @brief The distance between the queries and the vectors, identical to knn_metric_t on the DPU.
+ */
+typedef enum _dpu_knn_metric_t {
+    DPU_KNN_DOT = 0,
+    DPU_KNN_L2 = 1,
+} dpu_knn_metric_t;
+
+/**
+ * @brief A neighbour of a query, identical to struct knn_result on the DPU.
+ */
+struct dpu_knn_result {
+    int32_t distance;
+    uint32_t index;
+};
+
+/**
+ * @brief Computes the distance between two vectors, with the same results as the DPUs.
+ * @param metric the distance
+ * @param a the first vector
+ * @param b the second vector
+ * @param dims the number of dimensions
+ * @return The distance.
+ */
+static inline int32_t
+dpu_knn_distance(dpu_knn_metric_t metric, const int8_t *a, const int8_t *b, uint32_t dims)
+{
+    int32_t distance = 0;
+
+    for (uint32_t each_dim = 0; each_dim < dims; each_dim++) {
+        if (metric == DPU_KNN_L2) {
+            distance += (a[each_dim] - b[each_dim]) * (a[each_dim] - b[each_dim]);
+        } else {
+            distance -= a[each_dim] * b[each_dim];
+        }
+    }
+    return distance;
+}
+
+/**
+ * @brief Reads the results of the DPUs.
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol of the results
+ * @param nr_queries the number of queries of the batch
+ * @param k the number of neighbours of each query
+ * @param results the host buffer, receiving the nr_queries * k results of each DPU, in the order of DPU_FOREACH
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_knn_pull(struct dpu_set_t dpu_set, const char *symbol_name, uint32_t nr_queries, uint32_t k, struct dpu_knn_result *results)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status;
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, &results[(uint64_t)each_dpu * nr_queries * k])) != DPU_OK) {
+            return status;
+        }
+    }
+    return dpu_push_xfer(dpu_set,
+        DPU_XFER_FROM_DPU,
+        symbol_name,
+        0,
+        ((size_t)nr_queries * k * sizeof(struct dpu_knn_result) + 7) & ~(size_t)7,
+        DPU_XFER_DEFAULT);
+}
+
+struct __dpu_knn_tournament {
+    const struct dpu_knn_result *results;
+    const uint64_t *first_indices;
+    uint32_t nr_dpus;
+    uint32_t nr_queries;
+    uint32_t k;
+    uint32_t query;
+    uint32_t nr_leaves;
+    uint32_t *cursors;
+    uint32_t *winners;
+};
+
+/* The head of the list of a leaf, with its global index: the end of the lists sorts after all the neighbours. */
+static inline const struct dpu_knn_result *
+__dpu_knn_head(const struct __dpu_knn_tournament *t, uint32_t leaf, uint64_t *index)
+{
+    static const struct dpu_knn_result end = { .distance = INT32_MAX, .index = DPU_KNN_NO_NEIGHBOUR };
+    const struct dpu_knn_result *head;
+
+    if (leaf >= t->nr_dpus || t->cursors[leaf] == t->k) {
+        *index = UINT64_MAX;
+        return &end;
+    }
+    head = &t->results[((uint64_t)leaf * t->nr_queries + t->query) * t->k + t->cursors[leaf]];
+    *index = head->index == DPU_KNN_NO_NEIGHBOUR ? UINT64_MAX : t->first_indices[leaf] + head->index;
+    return head;
+}
+
+static inline void
+__dpu_knn_play(struct __dpu_knn_tournament *t, uint32_t node)
+{
+    uint32_t left = t->winners[2 * node], right = t->winners[2 * node + 1];
+    uint64_t left_index, right_index;
+    const struct dpu_knn_result *left_head = __dpu_knn_head(t, left, &left_index);
+    const struct dpu_knn_result *right_head = __dpu_knn_head(t, right, &right_index);
+
+    if (right_head->distance < left_head->distance
+        || (right_head->distance == left_head->distance && right_index < left_index)) {
+        t->winners[node] = right;
+    } else {
+        t->winners[node] = left;
+    }
+}
+
+/**
+ * @brief Merges the nearest neighbours found by the DPUs into the nearest neighbours of each query.
+ *
+ * The winners of the tournament are stored in an array where the children of node i are the nodes 2i and 2i+1, and the
+ * leaves are the DPUs. The winner at the root is the next neighbour; when its list advances, only the matches on the path
+ * from its leaf to the root are played again.
+ *
+ * @param results the results of the DPUs, as read by dpu_knn_pull
+ * @param nr_dpus the number of DPUs
+ * @param nr_queries the number of queries of the batch
+ * @param k the number of neighbours of each query
+ * @param first_indices the index of the first vector of each DPU, added to the indices found by the DPU
+ * @param indices receives the indices of the k neighbours of query q at indices[q * k], in increasing order of distance,
+ * padded with UINT64_MAX when there are fewer than k vectors
+ * @param distances receives the distances of the neighbours, padded with INT32_MAX, or NULL
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_knn_merge(const struct dpu_knn_result *results,
+    uint32_t nr_dpus,
+    uint32_t nr_queries,
+    uint32_t k,
+    const uint64_t *first_indices,
+    uint64_t *indices,
+    int32_t *distances)
+{
+    struct __dpu_knn_tournament t = {
+        .results = results, .first_indices = first_indices, .nr_dpus = nr_dpus, .nr_queries = nr_queries, .k = k
+    };
+
+    /* At least 2 leaves, so that the root is node 1. */
+    t.nr_leaves = 2;
+    while (t.nr_leaves < nr_dpus) {
+        t.nr_leaves <<= 1;
+    }
+    t.winners = malloc(2 * t.nr_leaves * sizeof(*t.winners));
+    t.cursors = malloc(t.nr_leaves * sizeof(*t.cursors));
+    if (t.winners == NULL || t.cursors == NULL) {
+        free(t.winners);
+        free(t.cursors);
+        return DPU_ERR_SYSTEM;
+    }
+
+    for (t.query = 0; t.query < nr_queries; t.query++) {
+        for (uint32_t leaf = 0; leaf < t.nr_leaves; leaf++) {
+            t.cursors[leaf] = 0;
+            t.winners[t.nr_leaves + leaf] = leaf;
+        }
+        for (uint32_t node = t.nr_leaves - 1; node != 0; node--) {
+            __dpu_knn_play(&t, node);
+        }
+
+        for (uint32_t each_neighbour = 0; each_neighbour < k; each_neighbour++) {
+            uint32_t winner = t.winners[1];
+            uint64_t output = (uint64_t)t.query * k + each_neighbour;
+            const struct dpu_knn_result *head = __dpu_knn_head(&t, winner, &indices[output]);
+
+            if (distances != NULL) {
+                distances[output] = head->distance;
+            }
+            if (indices[output] == UINT64_MAX) {
+                continue;
+            }
+            t.cursors[winner]++;
+            for (uint32_t node = (t.nr_leaves + winner) / 2; node != 0; node /= 2) {
+                __dpu_knn_play(&t, node);
+            }
+        }
+    }
+
+    free(t.winners);
+    free(t.cursors);
+    return DPU_OK;
+}
+
+#endif /* __DPU_KNN_H */
@@ -0,0 +1,520 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_MATCH_H
+#define __DPU_MATCH_H
+
+/**
+ * @file dpu_match.h
+ * @brief Host side of the multi-pattern search of the DPU runtime (mram_match.h).
+ *
+ * The patterns are compiled by dpu_match_compile into an Aho-Corasick automaton with all its transitions resolved, the
+ * format read by the DPUs. The text is split between the DPUs when it is loaded, and stays in MRAM for all the searches.
+ * Each DPU also receives the overlap bytes preceding its part of the text, so that the matches straddling two DPUs are
+ * found by the DPU holding their last byte. The transfers of the parts of the DPUs move only the useful bytes: the DPU
+ * set must have been allocated with scatter/gather transfers enabled (the "sgXferEnable=true" profile option).
+ *
+ * Each search broadcasts the automaton, and gathers the matches found by the DPUs, which are sorted by the host.
+ *
+ * The DPU program is provided by the application, calls mram_match_search with its symbols, and must define:
+ *  - text in MRAM, large enough for the part of the text of a DPU plus 2 * SEQREAD_CACHE_SIZE bytes,
+ *  - matches in MRAM, an array of struct mram_match_result,
+ *  - automaton in WRAM, large enough for the compiled automaton and 8-byte aligned,
+ *  - uint32_t text_length, report_from and max_matches, set by the host,
+ *  - uint32_t nr_matches, the result of mram_match_search.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief The header of a compiled automaton, identical to struct mram_match_automaton on the DPU.
+ *
+ * The header is followed by the transitions of the states, nr_classes per state, then by the nr_accepting + 1 offsets
+ * of the outputs of the accepting states, then by the pattern indices of the outputs, all as 16-bit integers.
+ */
+struct dpu_match_automaton {
+    uint16_t nr_states;
+    uint16_t nr_classes;
+    uint16_t first_accepting;
+    uint16_t max_length;
+    uint8_t classes[256];
+};
+
+/**
+ * @brief A match, identical to struct mram_match_result on the DPU.
+ */
+struct dpu_match {
+    /** The offset in the text of the byte following the match. */
+    uint64_t end;
+    /** The index of the pattern. */
+    uint32_t pattern;
+};
+
+/**
+ * @brief A text loaded on a DPU set.
+ */
+struct dpu_match_text {
+    struct dpu_set_t dpu_set;
+    uint32_t nr_dpus;
+    uint64_t length;
+    /** The number of bytes preceding the part of each DPU that it also holds. */
+    uint32_t overlap;
+    /** The capacity of the matches of each DPU. */
+    uint32_t max_dpu_matches;
+    /** DPU i reports the matches ending in the bytes [first_bytes[i], first_bytes[i + 1]). */
+    uint64_t *first_bytes;
+    /** The offset in the text of the first byte held by each DPU. */
+    uint64_t *origins;
+};
+
+/**
+ * @brief Compiles patterns into an automaton.
+ *
+ * The bytes appearing in no pattern share a byte class, and each other byte has its own class. The automaton is limited
+ * to 65536 transitions, so the number of states times the number of byte classes must not exceed 65536. The automaton
+ * is allocated, and must be freed by the caller. Its size is a multiple of 8 bytes.
+ *
+ * @param nr_patterns the number of patterns, between 1 and 65535
+ * @param patterns the patterns, which may hold any byte
+ * @param lengths the length of each pattern, between 1 and 65535
+ * @param automaton receives the automaton
+ * @param size receives the size of the automaton, in bytes
+ * @return Whether the operation was successful: DPU_ERR_INVALID_BUFFER_SIZE when the patterns exceed the limits.
+ */
+static inline dpu_error_t
+dpu_match_compile(uint32_t nr_patterns, const uint8_t *const *patterns, const uint32_t *lengths, void **automaton, uint32_t *size)
+{
+    struct dpu_match_automaton header;
+    uint32_t nr_nodes = 1, max_nodes, nr_accepting = 0, nr_outputs = 0, max_length = 0, nr_bytes = 0, each_node;
+    uint64_t total_length = 0;
+    int32_t *next = NULL;
+    uint32_t *fails = NULL, *queue = NULL, *first_patterns = NULL, *next_patterns = NULL, *nr_node_outputs = NULL;
+    uint32_t *numbers = NULL;
+    uint16_t *words;
+    uint8_t *blob = NULL;
+    dpu_error_t status = DPU_OK;
+
+    if (nr_patterns == 0 || nr_patterns > UINT16_MAX) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    memset(&header, 0, sizeof(header));
+    for (uint32_t each_pattern = 0; each_pattern < nr_patterns; each_pattern++) {
+        if (lengths[each_pattern] == 0 || lengths[each_pattern] > UINT16_MAX) {
+            return DPU_ERR_INVALID_BUFFER_SIZE;
+        }
+        total_length += lengths[each_pattern];
+        max_length = lengths[each_pattern] > max_length ? lengths[each_pattern] : max_length;
+        for (uint32_t i = 0; i < lengths[each_pattern]; i++) {
+            header.classes[patterns[each_pattern][i]] = 1;
+        }
+    }
+    /* The bytes of the patterns are numbered from 1, the other bytes are class 0, unless all the bytes are used. */
+    for (uint32_t each_byte = 0; each_byte < 256; each_byte++) {
+        nr_bytes += header.classes[each_byte];
+    }
+    header.nr_classes = (uint16_t)(nr_bytes == 256 ? 256 : nr_bytes + 1);
+    for (uint32_t each_byte = 0, class_index = nr_bytes == 256 ? 0 : 1; each_byte < 256; each_byte++) {
+        header.classes[each_byte] = header.classes[each_byte] != 0 ? (uint8_t)class_index++ : 0;
+    }
+    /* The trie can have at most one node per transition of the automaton. */
+    max_nodes = (1u << 16) / header.nr_classes;
+    max_nodes = total_length + 1 < max_nodes ? (uint32_t)total_length + 1 : max_nodes;
+
+    /* The trie, whose transitions are completed below into the transitions of the automaton. */
+    next = malloc((size_t)max_nodes * header.nr_classes * sizeof(*next));
+    first_patterns = malloc(max_nodes * sizeof(*first_patterns));
+    next_patterns = malloc(nr_patterns * sizeof(*next_patterns));
+    if (next == NULL || first_patterns == NULL || next_patterns == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    memset(next, 0xff, header.nr_classes * sizeof(*next));
+    first_patterns[0] = UINT32_MAX;
+    /* The patterns are inserted in reverse order, so that the patterns of a node are chained by increasing index. */
+    for (uint32_t each_pattern = nr_patterns; each_pattern-- > 0;) {
+        uint32_t node = 0;
+        for (uint32_t i = 0; i < lengths[each_pattern]; i++) {
+            int32_t *transition = &next[(size_t)node * header.nr_classes + header.classes[patterns[each_pattern][i]]];
+            if (*transition < 0) {
+                if (nr_nodes == max_nodes) {
+                    status = DPU_ERR_INVALID_BUFFER_SIZE;
+                    goto end;
+                }
+                memset(&next[(size_t)nr_nodes * header.nr_classes], 0xff, header.nr_classes * sizeof(*next));
+                first_patterns[nr_nodes] = UINT32_MAX;
+                *transition = (int32_t)nr_nodes++;
+            }
+            node = (uint32_t)*transition;
+        }
+        next_patterns[each_pattern] = first_patterns[node];
+        first_patterns[node] = each_pattern;
+    }
+    /* Breadth-first traversal: the failure of a node is the longest proper suffix of its string that is in the trie,
+     * and its missing transitions are the transitions of its failure. */
+    fails = malloc(nr_nodes * sizeof(*fails));
+    queue = malloc(nr_nodes * sizeof(*queue));
+    nr_node_outputs = malloc(nr_nodes * sizeof(*nr_node_outputs));
+    numbers = malloc(nr_nodes * sizeof(*numbers));
+    if (fails == NULL || queue == NULL || nr_node_outputs == NULL || numbers == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    fails[0] = 0;
+    queue[0] = 0;
+    for (uint32_t head = 0, tail = 1; head < tail; head++) {
+        uint32_t node = queue[head], count = 0;
+        for (uint32_t p = first_patterns[node]; p != UINT32_MAX; p = next_patterns[p]) {
+            count++;
+        }
+        nr_node_outputs[node] = count + (node != 0 ? nr_node_outputs[fails[node]] : 0);
+        for (uint32_t each_class = 0; each_class < header.nr_classes; each_class++) {
+            int32_t *transition = &next[(size_t)node * header.nr_classes + each_class];
+            int32_t inherited = node != 0 ? next[(size_t)fails[node] * header.nr_classes + each_class] : 0;
+            if (*transition < 0) {
+                *transition = inherited;
+            } else {
+                fails[*transition] = (uint32_t)inherited;
+                queue[tail++] = (uint32_t)*transition;
+            }
+        }
+    }
+
+    /* The states are numbered in breadth-first order, the accepting ones last. */
+    for (uint32_t pass = 0; pass < 2; pass++) {
+        for (uint32_t each_index = 0; each_index < nr_nodes; each_index++) {
+            uint32_t node = queue[each_index];
+            if ((nr_node_outputs[node] != 0) == (pass == 1)) {
+                numbers[node] = header.nr_states++;
+                if (pass == 1) {
+                    nr_accepting++;
+                    nr_outputs += nr_node_outputs[node];
+                }
+            }
+        }
+        if (pass == 0) {
+            header.first_accepting = (uint16_t)((uint32_t)header.nr_states * header.nr_classes);
+        }
+    }
+    if (nr_outputs > UINT16_MAX) {
+        status = DPU_ERR_INVALID_BUFFER_SIZE;
+        goto end;
+    }
+    header.max_length = (uint16_t)max_length;
+
+    *size = (uint32_t)(sizeof(header) + ((size_t)nr_nodes * header.nr_classes + nr_accepting + 1 + nr_outputs) * 2);
+    *size = (*size + 7) & ~7u;
+    blob = calloc(1, *size);
+    if (blob == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    memcpy(blob, &header, sizeof(header));
+    words = (uint16_t *)(blob + sizeof(header));
+    for (each_node = 0; each_node < nr_nodes; each_node++) {
+        for (uint32_t each_class = 0; each_class < header.nr_classes; each_class++) {
+            words[numbers[each_node] * header.nr_classes + each_class]
+                = (uint16_t)(numbers[next[(size_t)each_node * header.nr_classes + each_class]] * header.nr_classes);
+        }
+    }
+
+    /* The outputs of an accepting state are its own patterns and the outputs of its failure, sorted by index. */
+    {
+        uint16_t *offsets = &words[(size_t)nr_nodes * header.nr_classes];
+        uint16_t *outputs = &offsets[nr_accepting + 1];
+        uint32_t first_accepting_node = header.nr_states - nr_accepting;
+        uint32_t count = 0;
+
+        /* The queue is reused to map the states to the nodes. */
+        for (each_node = 0; each_node < nr_nodes; each_node++) {
+            queue[numbers[each_node]] = each_node;
+        }
+        for (uint32_t each_state = first_accepting_node; each_state < header.nr_states; each_state++) {
+            uint32_t first = count;
+            offsets[each_state - first_accepting_node] = (uint16_t)count;
+            for (uint32_t node = queue[each_state]; node != 0; node = fails[node]) {
+                for (uint32_t p = first_patterns[node]; p != UINT32_MAX; p = next_patterns[p]) {
+                    uint32_t position = count++;
+                    while (position > first && outputs[position - 1] > p) {
+                        outputs[position] = outputs[position - 1];
+                        position--;
+                    }
+                    outputs[position] = (uint16_t)p;
+                }
+            }
+        }
+        offsets[nr_accepting] = (uint16_t)count;
+    }
+
+    *automaton = blob;
+    blob = NULL;
+
+end:
+    free(next);
+    free(fails);
+    free(queue);
+    free(first_patterns);
+    free(next_patterns);
+    free(nr_node_outputs);
+    free(numbers);
+    free(blob);
+    return status;
+}
+
+/**
+ * @brief Frees the description of a text loaded by dpu_match_load.
+ * @param text the text
+ */
+static inline void
+dpu_match_free(struct dpu_match_text *text)
+{
+    free(text->first_bytes);
+    free(text->origins);
+    text->first_bytes = NULL;
+    text->origins = NULL;
+}
+
+/**
+ * @brief Splits a text between the DPUs of a set, where the DPU program is loaded.
+ *
+ * DPU i reports the matches ending in the bytes [i * length / nr_dpus, (i + 1) * length / nr_dpus). It holds these
+ * bytes, preceded by the overlap bytes before them, from an offset rounded down to a multiple of 8.
+ *
+ * @param dpu_set the DPU set
+ * @param bytes the text
+ * @param length the length of the text, in bytes
+ * @param overlap the number of bytes preceding its part that each DPU holds, at least the length of the longest
+ *        pattern searched minus 1
+ * @param max_dpu_matches the capacity of the matches of the DPU program
+ * @param text receives the description of the loaded text, to be freed with dpu_match_free
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_match_load(struct dpu_set_t dpu_set,
+    const uint8_t *bytes,
+    uint64_t length,
+    uint32_t overlap,
+    uint32_t max_dpu_matches,
+    struct dpu_match_text *text)
+{
+    struct dpu_set_t dpu;
+    uint32_t each_dpu, *lengths = NULL;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &text->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    text->dpu_set = dpu_set;
+    text->length = length;
+    text->overlap = overlap;
+    text->max_dpu_matches = max_dpu_matches;
+    text->first_bytes = malloc((text->nr_dpus + 1) * sizeof(uint64_t));
+    text->origins = malloc(text->nr_dpus * sizeof(uint64_t));
+    lengths = malloc(2 * text->nr_dpus * sizeof(uint32_t));
+    if (text->first_bytes == NULL || text->origins == NULL || lengths == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    for (each_dpu = 0; each_dpu <= text->nr_dpus; each_dpu++) {
+        text->first_bytes[each_dpu] = length * each_dpu / text->nr_dpus;
+    }
+    for (each_dpu = 0; each_dpu < text->nr_dpus; each_dpu++) {
+        uint64_t first = text->first_bytes[each_dpu];
+        uint64_t origin = (first > overlap ? first - overlap : 0) & ~(uint64_t)7;
+
+        if (text->first_bytes[each_dpu + 1] - origin > UINT32_MAX) {
+            status = DPU_ERR_INVALID_BUFFER_SIZE;
+            goto end;
+        }
+        text->origins[each_dpu] = origin;
+        lengths[2 * each_dpu] = (uint32_t)(text->first_bytes[each_dpu + 1] - origin);
+        lengths[2 * each_dpu + 1] = (uint32_t)(first - origin);
+    }
+
+    status = dpu_push_varlen_ranges(dpu_set, "text", 0, bytes, length, text->origins, text->first_bytes + 1);
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &lengths[2 * each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "text_length", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &lengths[2 * each_dpu + 1]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "report_from", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        status = dpu_broadcast_to(dpu_set, "max_matches", 0, &max_dpu_matches, sizeof(max_dpu_matches), DPU_XFER_DEFAULT);
+    }
+
+end:
+    if (status != DPU_OK) {
+        dpu_match_free(text);
+    }
+    free(lengths);
+    return status;
+}
+
+static inline int
+__dpu_match_compare(const void *a, const void *b)
+{
+    const struct dpu_match *x = (const struct dpu_match *)a, *y = (const struct dpu_match *)b;
+
+    if (x->end != y->end) {
+        return x->end < y->end ? -1 : 1;
+    }
+    return x->pattern < y->pattern ? -1 : x->pattern > y->pattern ? 1 : 0;
+}
+
+/**
+ * @brief Finds all the occurrences of the patterns of an automaton in the text loaded on the DPUs.
+ *
+ * The matches are sorted by end offset, then by pattern index. When the matches do not fit in the results, or in the
+ * matches of a DPU, the number of matches found is returned with DPU_ERR_INVALID_BUFFER_SIZE, and the results are
+ * incomplete.
+ *
+ * @param text the text, loaded by dpu_match_load
+ * @param automaton the automaton, built by dpu_match_compile
+ * @param size the size of the automaton, in bytes
+ * @param results receives the matches
+ * @param max_results the capacity of the results
+ * @param nr_results receives the number of matches
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_match_search(struct dpu_match_text *text,
+    const void *automaton,
+    uint32_t size,
+    struct dpu_match *results,
+    uint64_t max_results,
+    uint64_t *nr_results)
+{
+    const struct dpu_match_automaton *header = (const struct dpu_match_automaton *)automaton;
+    uint32_t *counts = malloc(text->nr_dpus * sizeof(*counts));
+    uint64_t *sizes = malloc(text->nr_dpus * sizeof(*sizes));
+    uint64_t *offsets = malloc((text->nr_dpus + 1) * sizeof(*offsets));
+    uint32_t *matches = NULL;
+    uint64_t total = 0, count = 0;
+    bool overflow = false;
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    size_t max_length;
+    dpu_error_t status = DPU_OK;
+
+    if (counts == NULL || sizes == NULL || offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    if ((uint32_t)header->max_length - 1 > text->overlap) {
+        status = DPU_ERR_INVALID_BUFFER_SIZE;
+        goto end;
+    }
+
+    status = dpu_broadcast_to(text->dpu_set, "automaton", 0, automaton, size, DPU_XFER_DEFAULT);
+    if (status == DPU_OK) {
+        status = dpu_launch(text->dpu_set, DPU_SYNCHRONOUS);
+    }
+    DPU_FOREACH (text->dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &counts[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(text->dpu_set, DPU_XFER_FROM_DPU, "nr_matches", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    if (status != DPU_OK) {
+        goto end;
+    }
+
+    for (each_dpu = 0; each_dpu < text->nr_dpus; each_dpu++) {
+        uint32_t stored = counts[each_dpu] < text->max_dpu_matches ? counts[each_dpu] : text->max_dpu_matches;
+        overflow |= counts[each_dpu] != stored;
+        total += counts[each_dpu];
+        sizes[each_dpu] = (uint64_t)stored * 2 * sizeof(uint32_t);
+    }
+    max_length = dpu_varlen_offsets(sizes, text->nr_dpus, offsets);
+    matches = malloc(offsets[text->nr_dpus] != 0 ? offsets[text->nr_dpus] : 1);
+    if (matches == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    status = dpu_push_varlen_xfer(
+        text->dpu_set, DPU_XFER_FROM_DPU, "matches", 0, matches, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    if (status != DPU_OK) {
+        goto end;
+    }
+
+    for (each_dpu = 0; each_dpu < text->nr_dpus; each_dpu++) {
+        const uint32_t *local = &matches[offsets[each_dpu] / sizeof(uint32_t)];
+        for (uint64_t each_match = 0; each_match < sizes[each_dpu] / (2 * sizeof(uint32_t)) && count < max_results;
+             each_match++) {
+            results[count].end = text->origins[each_dpu] + local[2 * each_match];
+            results[count].pattern = local[2 * each_match + 1];
+            count++;
+        }
+    }
+    qsort(results, count, sizeof(*results), __dpu_match_compare);
+    *nr_results = total;
+    if (overflow || total > max_results) {
+        status = DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+
+end:
+    free(counts);
+    free(sizes);
+    free(offsets);
+    free(matches);
+    return status;
+}
+
+/**
+ * @brief Finds all the occurrences of the patterns of an automaton in a text on the host, with the same results as
+ * dpu_match_search.
+ * @param automaton the automaton, built by dpu_match_compile
+ * @param bytes the text
+ * @param length the length of the text, in bytes
+ * @param results receives the matches, or NULL to only count them
+ * @param max_results the capacity of the results
+ * @return The number of matches, which are all in the results if it does not exceed max_results.
+ */
+static inline uint64_t
+dpu_match_reference(const void *automaton, const uint8_t *bytes, uint64_t length, struct dpu_match *results, uint64_t max_results)
+{
+    const struct dpu_match_automaton *header = (const struct dpu_match_automaton *)automaton;
+    const uint16_t *transitions = (const uint16_t *)(header + 1);
+    const uint16_t *offsets = &transitions[(uint32_t)header->nr_states * header->nr_classes];
+    const uint16_t *outputs = &offsets[header->nr_states - header->first_accepting / header->nr_classes + 1];
+    uint32_t state = 0;
+    uint64_t count = 0;
+
+    for (uint64_t each_byte = 0; each_byte < length; each_byte++) {
+        state = transitions[state + header->classes[bytes[each_byte]]];
+        if (state >= header->first_accepting) {
+            uint32_t accepting = (state - header->first_accepting) / header->nr_classes;
+            for (uint32_t each_output = offsets[accepting]; each_output < offsets[accepting + 1]; each_output++) {
+                if (results != NULL && count < max_results) {
+                    results[count].end = each_byte + 1;
+                    results[count].pattern = outputs[each_output];
+                }
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+#endif /* __DPU_MATCH_H */
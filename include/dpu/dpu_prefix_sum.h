@@ -0,0 +1,104 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_PREFIX_SUM_H
+#define __DPU_PREFIX_SUM_H
+
+/**
+ * @file dpu_prefix_sum.h
+ * @brief Host side of the prefix sums across the DPUs of a system (mram_prefix_sum.h).
+ *
+ * Between the two launches of a prefix sum, the host propagates the carries: dpu_prefix_sum_carry gathers the uint64_t
+ * total of each DPU, in a single transfer, scans them in the order of DPU_FOREACH, and sends back to each DPU the sum of
+ * the totals of the DPUs before it, in a single transfer. Both transfers move 8 bytes per DPU, to all the ranks of the
+ * set in parallel.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <dpu.h>
+
+/**
+ * @brief Replaces the totals of the DPUs by their exclusive prefix sum.
+ * @param values the totals, in the order of DPU_FOREACH, receiving the offsets
+ * @param nr_dpus the number of DPUs
+ * @return The sum of the totals.
+ */
+static inline uint64_t
+dpu_prefix_sum_offsets(uint64_t *values, uint32_t nr_dpus)
+{
+    uint64_t sum = 0;
+
+    for (uint32_t each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+        uint64_t value = values[each_dpu];
+        values[each_dpu] = sum;
+        sum += value;
+    }
+    return sum;
+}
+
+/**
+ * @brief Propagates the carries of a prefix sum between the DPUs of a set.
+ *
+ * Must be called after the launch computing the local prefix sums, and before the launch adding the offsets.
+ *
+ * @param dpu_set the DPU set
+ * @param total_symbol the uint64_t DPU symbol holding the total of the DPU, as returned by mram_prefix_sum_exclusive
+ * @param offset_symbol the uint64_t DPU symbol receiving the offset of the DPU, given to mram_prefix_sum_add
+ * @param offsets if not NULL, receives the offsets of the DPUs, in the order of DPU_FOREACH
+ * @param total if not NULL, receives the sum of the totals of all the DPUs
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_prefix_sum_carry(struct dpu_set_t dpu_set,
+    const char *total_symbol,
+    const char *offset_symbol,
+    uint64_t *offsets,
+    uint64_t *total)
+{
+    uint64_t *values = NULL, sum;
+    uint32_t nr_dpus, each_dpu;
+    struct dpu_set_t dpu;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    if ((values = offsets) == NULL && (values = malloc(nr_dpus * sizeof(uint64_t))) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, &values[each_dpu])) != DPU_OK) {
+            goto end;
+        }
+    }
+    if ((status = dpu_push_xfer(dpu_set, DPU_XFER_FROM_DPU, total_symbol, 0, sizeof(uint64_t), DPU_XFER_DEFAULT)) != DPU_OK) {
+        goto end;
+    }
+
+    sum = dpu_prefix_sum_offsets(values, nr_dpus);
+
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, &values[each_dpu])) != DPU_OK) {
+            goto end;
+        }
+    }
+    if ((status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, offset_symbol, 0, sizeof(uint64_t), DPU_XFER_DEFAULT)) != DPU_OK) {
+        goto end;
+    }
+    if (total != NULL) {
+        *total = sum;
+    }
+
+end:
+    if (values != offsets) {
+        free(values);
+    }
+    return status;
+}
+
+#endif /* __DPU_PREFIX_SUM_H */
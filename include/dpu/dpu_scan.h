@@ -0,0 +1,313 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_SCAN_H
+#define __DPU_SCAN_H
+
+/**
+ * @file dpu_scan.h
+ * @brief Host side of the column scans of the DPU runtime (mram_scan.h).
+ *
+ * A predicate is described as a tree of comparisons of columns with constants, combined by AND, OR and NOT. The tree is
+ * compiled into a program, which is copied as is to the __host struct mram_scan_program of the DPU program. The DPUs
+ * select their rows satisfying the predicate, as a bitmap or as a list of row indices.
+ *
+ * The number of selected rows depends on the data of each DPU: the row indices are read back with one scatter/gather
+ * transfer moving only the selected rows of each DPU (see dpu_varlen.h).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief Maximum number of instructions of a program, identical to MRAM_SCAN_MAX_INSTRUCTIONS on the DPU.
+ */
+#define DPU_SCAN_MAX_INSTRUCTIONS 32
+
+/**
+ * @brief Maximum number of values of the IN lists of a program, identical to MRAM_SCAN_MAX_CONSTANTS on the DPU.
+ */
+#define DPU_SCAN_MAX_CONSTANTS 64
+
+/**
+ * @brief Maximum number of masks on the stack while running a program, identical to MRAM_SCAN_STACK_DEPTH on the DPU.
+ */
+#define DPU_SCAN_STACK_DEPTH 8
+
+/**
+ * @brief The nodes of a predicate, and the instructions of a program, identical to mram_scan_opcode_t on the DPU.
+ */
+typedef enum _dpu_scan_opcode_t {
+    DPU_SCAN_TRUE = 0,
+    DPU_SCAN_EQ = 1,
+    DPU_SCAN_NE = 2,
+    DPU_SCAN_LT = 3,
+    DPU_SCAN_LE = 4,
+    DPU_SCAN_GT = 5,
+    DPU_SCAN_GE = 6,
+    DPU_SCAN_BETWEEN = 7,
+    DPU_SCAN_IN = 8,
+    DPU_SCAN_AND = 9,
+    DPU_SCAN_OR = 10,
+    DPU_SCAN_NOT = 11,
+} dpu_scan_opcode_t;
+
+/**
+ * @brief An instruction of a program, identical to struct mram_scan_instruction on the DPU.
+ */
+struct dpu_scan_instruction {
+    uint8_t opcode;
+    uint8_t column;
+    uint16_t count;
+    int32_t a;
+    int32_t b;
+};
+
+/**
+ * @brief A compiled predicate, identical to struct mram_scan_program on the DPU.
+ */
+struct dpu_scan_program {
+    uint32_t nr_instructions;
+    uint32_t nr_constants;
+    struct dpu_scan_instruction instructions[DPU_SCAN_MAX_INSTRUCTIONS];
+    int32_t constants[DPU_SCAN_MAX_CONSTANTS];
+};
+
+/**
+ * @brief A node of a predicate tree.
+ *
+ * The comparisons test column against a (and b for DPU_SCAN_BETWEEN, which includes both bounds), or against the
+ * nr_values values for DPU_SCAN_IN. DPU_SCAN_AND and DPU_SCAN_OR combine left and right, DPU_SCAN_NOT negates left.
+ */
+struct dpu_scan_predicate {
+    dpu_scan_opcode_t opcode;
+    uint8_t column;
+    int32_t a;
+    int32_t b;
+    const int32_t *values;
+    uint32_t nr_values;
+    const struct dpu_scan_predicate *left;
+    const struct dpu_scan_predicate *right;
+};
+
+static inline bool
+__dpu_scan_emit(struct dpu_scan_program *program, dpu_scan_opcode_t opcode, uint8_t column, int32_t a, int32_t b)
+{
+    struct dpu_scan_instruction *instruction;
+
+    if (program->nr_instructions == DPU_SCAN_MAX_INSTRUCTIONS) {
+        return false;
+    }
+    instruction = &program->instructions[program->nr_instructions++];
+    instruction->opcode = (uint8_t)opcode;
+    instruction->column = column;
+    instruction->count = 0;
+    instruction->a = a;
+    instruction->b = b;
+    return true;
+}
+
+/* The number of stack slots needed to evaluate a tree, when the deeper operand of AND and OR is evaluated first. */
+static inline uint32_t
+__dpu_scan_depth(const struct dpu_scan_predicate *predicate)
+{
+    uint32_t left, right;
+
+    switch (predicate->opcode) {
+        case DPU_SCAN_AND:
+        case DPU_SCAN_OR:
+            left = __dpu_scan_depth(predicate->left);
+            right = __dpu_scan_depth(predicate->right);
+            return left == right ? left + 1 : (left > right ? left : right);
+        case DPU_SCAN_NOT:
+            return __dpu_scan_depth(predicate->left);
+        default:
+            return 1;
+    }
+}
+
+static inline bool
+__dpu_scan_compile(const struct dpu_scan_predicate *predicate, struct dpu_scan_program *program)
+{
+    const struct dpu_scan_predicate *first, *second;
+
+    switch (predicate->opcode) {
+        case DPU_SCAN_AND:
+        case DPU_SCAN_OR:
+            /* Both operators are commutative: evaluating the deeper operand first keeps the stack shallow. */
+            first = predicate->left;
+            second = predicate->right;
+            if (__dpu_scan_depth(second) > __dpu_scan_depth(first)) {
+                first = predicate->right;
+                second = predicate->left;
+            }
+            return __dpu_scan_compile(first, program) && __dpu_scan_compile(second, program)
+                && __dpu_scan_emit(program, predicate->opcode, 0, 0, 0);
+        case DPU_SCAN_NOT:
+            return __dpu_scan_compile(predicate->left, program) && __dpu_scan_emit(program, DPU_SCAN_NOT, 0, 0, 0);
+        case DPU_SCAN_BETWEEN:
+            if (predicate->a > predicate->b) {
+                return __dpu_scan_emit(program, DPU_SCAN_TRUE, 0, 0, 0) && __dpu_scan_emit(program, DPU_SCAN_NOT, 0, 0, 0);
+            }
+            return __dpu_scan_emit(program, DPU_SCAN_BETWEEN, predicate->column, predicate->a, predicate->b);
+        case DPU_SCAN_IN:
+            if (predicate->nr_values == 0) {
+                return __dpu_scan_emit(program, DPU_SCAN_TRUE, 0, 0, 0) && __dpu_scan_emit(program, DPU_SCAN_NOT, 0, 0, 0);
+            }
+            if (predicate->nr_values == 1) {
+                return __dpu_scan_emit(program, DPU_SCAN_EQ, predicate->column, predicate->values[0], 0);
+            }
+            if (program->nr_constants + predicate->nr_values > DPU_SCAN_MAX_CONSTANTS
+                || !__dpu_scan_emit(program, DPU_SCAN_IN, predicate->column, (int32_t)program->nr_constants, 0)) {
+                return false;
+            }
+            program->instructions[program->nr_instructions - 1].count = (uint16_t)predicate->nr_values;
+            memcpy(&program->constants[program->nr_constants], predicate->values, predicate->nr_values * sizeof(int32_t));
+            program->nr_constants += predicate->nr_values;
+            return true;
+        default:
+            return __dpu_scan_emit(program, predicate->opcode, predicate->column, predicate->a, predicate->b);
+    }
+}
+
+/**
+ * @brief Compiles a predicate tree into a program.
+ * @param predicate the root of the tree
+ * @param program the program, to copy to the __host struct mram_scan_program of the DPU program
+ * @return DPU_OK, or DPU_ERR_INVALID_BUFFER_SIZE if the predicate exceeds the limits of a program.
+ */
+static inline dpu_error_t
+dpu_scan_compile(const struct dpu_scan_predicate *predicate, struct dpu_scan_program *program)
+{
+    memset(program, 0, sizeof(*program));
+    if (__dpu_scan_depth(predicate) > DPU_SCAN_STACK_DEPTH || !__dpu_scan_compile(predicate, program)) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    return DPU_OK;
+}
+
+/**
+ * @brief Evaluates a program on a row in host memory, with the same results as the DPUs.
+ * @param program the program
+ * @param columns the columns of the table
+ * @param row the index of the row
+ * @return Whether the row is selected.
+ */
+static inline bool
+dpu_scan_evaluate(const struct dpu_scan_program *program, const int32_t *const *columns, uint64_t row)
+{
+    bool stack[DPU_SCAN_STACK_DEPTH];
+    uint32_t top = 0;
+
+    for (uint32_t each_instruction = 0; each_instruction < program->nr_instructions; each_instruction++) {
+        const struct dpu_scan_instruction *instruction = &program->instructions[each_instruction];
+        int32_t x = instruction->opcode >= DPU_SCAN_EQ && instruction->opcode <= DPU_SCAN_IN
+            ? columns[instruction->column][row]
+            : 0;
+        int32_t a = instruction->a;
+        int32_t b = instruction->b;
+
+        switch (instruction->opcode) {
+            case DPU_SCAN_TRUE:
+                stack[top++] = true;
+                break;
+            case DPU_SCAN_EQ:
+                stack[top++] = x == a;
+                break;
+            case DPU_SCAN_NE:
+                stack[top++] = x != a;
+                break;
+            case DPU_SCAN_LT:
+                stack[top++] = x < a;
+                break;
+            case DPU_SCAN_LE:
+                stack[top++] = x <= a;
+                break;
+            case DPU_SCAN_GT:
+                stack[top++] = x > a;
+                break;
+            case DPU_SCAN_GE:
+                stack[top++] = x >= a;
+                break;
+            case DPU_SCAN_BETWEEN:
+                stack[top++] = x >= a && x <= b;
+                break;
+            case DPU_SCAN_IN:
+                stack[top] = false;
+                for (uint32_t each_constant = 0; each_constant < instruction->count; each_constant++) {
+                    stack[top] |= x == program->constants[a + each_constant];
+                }
+                top++;
+                break;
+            case DPU_SCAN_AND:
+                top--;
+                stack[top - 1] = stack[top - 1] && stack[top];
+                break;
+            case DPU_SCAN_OR:
+                top--;
+                stack[top - 1] = stack[top - 1] || stack[top];
+                break;
+            case DPU_SCAN_NOT:
+                stack[top - 1] = !stack[top - 1];
+                break;
+            default:
+                break;
+        }
+    }
+    return top != 0 && stack[0];
+}
+
+/**
+ * @brief Computes where the row indices selected by each DPU are stored by dpu_scan_pull_row_ids.
+ * @param nr_selected the number of rows selected by each DPU, in the order of DPU_FOREACH
+ * @param nr_dpus the number of DPUs
+ * @param offsets storage for the nr_dpus + 1 byte offsets of the row indices of each DPU
+ * @return The size of the largest list of row indices, in bytes, rounded up to 8 bytes.
+ */
+static inline size_t
+dpu_scan_row_id_offsets(const uint32_t *nr_selected, uint32_t nr_dpus, uint64_t *offsets)
+{
+    size_t max_length = 0;
+
+    offsets[0] = 0;
+    for (uint32_t each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+        uint64_t length = ((uint64_t)nr_selected[each_dpu] * sizeof(uint32_t) + 7) & ~(uint64_t)7;
+        offsets[each_dpu + 1] = offsets[each_dpu] + length;
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    return max_length;
+}
+
+/**
+ * @brief Reads the row indices selected by the DPUs, moving only the selected rows of each DPU.
+ *
+ * The row indices of DPU i start at byte offsets[i] of the buffer. They are relative to the first row of the DPU.
+ *
+ * @param dpu_set the DPU set, allocated with the "sgXferEnable=true" profile option
+ * @param symbol_name the DPU symbol of the row indices
+ * @param row_ids the host buffer, of offsets[nr_dpus] bytes
+ * @param offsets the offsets computed by dpu_scan_row_id_offsets
+ * @param max_length the value returned by dpu_scan_row_id_offsets
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_scan_pull_row_ids(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t *row_ids,
+    const uint64_t *offsets,
+    size_t max_length)
+{
+    return dpu_push_varlen_xfer(
+        dpu_set, DPU_XFER_FROM_DPU, symbol_name, 0, row_ids, offsets, max_length, DPU_SG_XFER_DEFAULT);
+}
+
+#endif /* __DPU_SCAN_H */
@@ -0,0 +1,285 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_SHUFFLE_H
+#define __DPU_SHUFFLE_H
+
+/**
+ * @file dpu_shuffle.h
+ * @brief All-to-all exchange of buckets between the DPUs of a set, through the host.
+ *
+ * DPUs cannot exchange data, so the repartitions of joins, group-bys and sorts go through the host. Before a shuffle,
+ * each DPU (the source) partitions its elements into one bucket per DPU of the set (the destination), stored one after
+ * the other in destination order in an MRAM buffer, and counts the elements of each bucket in a uint32_t histogram.
+ *
+ * dpu_shuffle_plan gathers the histograms of all the DPUs in one transfer, and places the buckets in a host staging
+ * buffer ordered by destination: the area of each destination holds its buckets from source 0, then from source 1, and
+ * so on. dpu_shuffle_exchange then moves the buckets in two scatter/gather transfers, without any copy on the host:
+ *  - the pull reads the buffer of each source in one piece, and scatters its buckets directly to their places in the
+ *    areas of the destinations, one block per non-empty bucket,
+ *  - the push writes the area of each destination, in one block, to its receive buffer, followed by the number of
+ *    elements received.
+ * Both transfers are queued on all the ranks at once, each rank moving the data of its DPUs in parallel with the others.
+ * The push waits for the end of the pull of every rank, since every destination receives data from every rank.
+ *
+ * The staging buffer holds the shuffled elements once, and is kept from one shuffle to the next. The elements must be a
+ * multiple of 8 bytes long. The DPU set must be allocated with scatter/gather transfers enabled, with at least one
+ * block per DPU of the set (the "sgXferEnable=true,sgXferMaxBlocksPerDpu=<number of DPUs>" profile options).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief The plan and the staging buffer of the shuffles of a DPU set.
+ */
+struct dpu_shuffle {
+    /** The DPU set. */
+    struct dpu_set_t dpu_set;
+    /** The number of DPUs of the set. */
+    uint32_t nr_dpus;
+    /** The size of an element, in bytes. */
+    uint32_t element_size;
+    /** The number of entries of the histogram of a DPU: nr_dpus rounded up to an even number. */
+    uint32_t nr_bins;
+    /** counts[s * nr_bins + d] is the number of elements of the bucket of source s for destination d. */
+    uint32_t *counts;
+    /** before[s * nr_bins + d] is the number of elements of the buckets for destination d of the sources before s. */
+    uint32_t *before;
+    /** The non-empty buckets of source s are for the destinations destinations[first_buckets[s] .. first_buckets[s + 1]). */
+    uint32_t *first_buckets;
+    uint32_t *destinations;
+    /** The number of elements received by each destination. */
+    uint32_t *received_counts;
+    /** The area of destination d is [received_offsets[d], received_offsets[d + 1]) in the staging buffer. */
+    uint64_t *received_offsets;
+    /** The staging buffer. */
+    uint8_t *staging;
+    size_t staging_size;
+    /** The largest number of bytes sent by a source, and received by a destination. */
+    size_t max_sent;
+    size_t max_received;
+};
+
+/**
+ * @brief Initializes the shuffles of a DPU set.
+ * @param shuffle the shuffles, to be freed with dpu_shuffle_free, even when the initialization fails
+ * @param dpu_set the DPU set
+ * @param element_size the size of an element, a multiple of 8 bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_shuffle_init(struct dpu_shuffle *shuffle, struct dpu_set_t dpu_set, uint32_t element_size)
+{
+    dpu_error_t status;
+    size_t nr_buckets;
+
+    memset(shuffle, 0, sizeof(*shuffle));
+    if (element_size == 0 || (element_size & 7) != 0) {
+        return DPU_ERR_INVALID_BUFFER_SIZE;
+    }
+    if ((status = dpu_get_nr_dpus(dpu_set, &shuffle->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    shuffle->dpu_set = dpu_set;
+    shuffle->element_size = element_size;
+    shuffle->nr_bins = (shuffle->nr_dpus + 1) & ~1u;
+    nr_buckets = (size_t)shuffle->nr_dpus * shuffle->nr_bins;
+
+    shuffle->counts = malloc(nr_buckets * sizeof(uint32_t));
+    shuffle->before = malloc(nr_buckets * sizeof(uint32_t));
+    shuffle->destinations = malloc(nr_buckets * sizeof(uint32_t));
+    shuffle->first_buckets = malloc((shuffle->nr_dpus + 1) * sizeof(uint32_t));
+    shuffle->received_counts = malloc(shuffle->nr_dpus * sizeof(uint32_t));
+    shuffle->received_offsets = malloc((shuffle->nr_dpus + 1) * sizeof(uint64_t));
+    if (shuffle->counts == NULL || shuffle->before == NULL || shuffle->destinations == NULL || shuffle->first_buckets == NULL
+        || shuffle->received_counts == NULL || shuffle->received_offsets == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    return DPU_OK;
+}
+
+/**
+ * @brief Frees the plan and the staging buffer of the shuffles of a DPU set.
+ * @param shuffle the shuffles
+ */
+static inline void
+dpu_shuffle_free(struct dpu_shuffle *shuffle)
+{
+    free(shuffle->counts);
+    free(shuffle->before);
+    free(shuffle->destinations);
+    free(shuffle->first_buckets);
+    free(shuffle->received_counts);
+    free(shuffle->received_offsets);
+    free(shuffle->staging);
+    memset(shuffle, 0, sizeof(*shuffle));
+}
+
+/**
+ * @brief Gathers the histograms of the DPUs, and places their buckets in the staging buffer.
+ *
+ * After the call, max_sent and max_received give the sizes needed by the send and receive buffers of the DPUs.
+ *
+ * @param shuffle the shuffles
+ * @param histogram_symbol the DPU symbol holding the histogram of the DPU: nr_bins uint32_t, entry d being the number of
+ * elements of the bucket for DPU d, in the order of DPU_FOREACH
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_shuffle_plan(struct dpu_shuffle *shuffle, const char *histogram_symbol)
+{
+    uint32_t nr_dpus = shuffle->nr_dpus, nr_bins = shuffle->nr_bins, each_dpu, nr_non_empty = 0;
+    struct dpu_set_t dpu;
+    dpu_error_t status;
+
+    DPU_FOREACH (shuffle->dpu_set, dpu, each_dpu) {
+        if ((status = dpu_prepare_xfer(dpu, &shuffle->counts[(size_t)each_dpu * nr_bins])) != DPU_OK) {
+            return status;
+        }
+    }
+    if ((status = dpu_push_xfer(
+             shuffle->dpu_set, DPU_XFER_FROM_DPU, histogram_symbol, 0, nr_bins * sizeof(uint32_t), DPU_XFER_DEFAULT))
+        != DPU_OK) {
+        return status;
+    }
+
+    /* The buckets of each destination, in source order, then the areas of the destinations. */
+    memset(shuffle->received_counts, 0, nr_dpus * sizeof(uint32_t));
+    shuffle->max_sent = 0;
+    for (uint32_t source = 0; source < nr_dpus; source++) {
+        const uint32_t *counts = &shuffle->counts[(size_t)source * nr_bins];
+        uint32_t *before = &shuffle->before[(size_t)source * nr_bins];
+        size_t sent = 0;
+
+        shuffle->first_buckets[source] = nr_non_empty;
+        for (uint32_t destination = 0; destination < nr_dpus; destination++) {
+            before[destination] = shuffle->received_counts[destination];
+            shuffle->received_counts[destination] += counts[destination];
+            sent += counts[destination];
+            if (counts[destination] != 0) {
+                shuffle->destinations[nr_non_empty++] = destination;
+            }
+        }
+        sent *= shuffle->element_size;
+        shuffle->max_sent = sent > shuffle->max_sent ? sent : shuffle->max_sent;
+    }
+    shuffle->first_buckets[nr_dpus] = nr_non_empty;
+
+    shuffle->received_offsets[0] = 0;
+    shuffle->max_received = 0;
+    for (uint32_t destination = 0; destination < nr_dpus; destination++) {
+        size_t received = (size_t)shuffle->received_counts[destination] * shuffle->element_size;
+        shuffle->received_offsets[destination + 1] = shuffle->received_offsets[destination] + received;
+        shuffle->max_received = received > shuffle->max_received ? received : shuffle->max_received;
+    }
+
+    if (shuffle->received_offsets[nr_dpus] > shuffle->staging_size) {
+        free(shuffle->staging);
+        shuffle->staging_size = shuffle->received_offsets[nr_dpus];
+        if ((shuffle->staging = malloc(shuffle->staging_size)) == NULL) {
+            shuffle->staging_size = 0;
+            return DPU_ERR_SYSTEM;
+        }
+    }
+    return DPU_OK;
+}
+
+/* Block b of source s: its b-th non-empty bucket, at its place in the area of its destination. */
+static inline bool
+__dpu_shuffle_get_block(struct sg_block_info *out, uint32_t dpu_index, uint32_t block_index, void *args)
+{
+    const struct dpu_shuffle *shuffle = (const struct dpu_shuffle *)args;
+    uint32_t bucket = shuffle->first_buckets[dpu_index] + block_index, destination;
+    size_t index;
+
+    if (bucket >= shuffle->first_buckets[dpu_index + 1]) {
+        return false;
+    }
+    destination = shuffle->destinations[bucket];
+    index = (size_t)dpu_index * shuffle->nr_bins + destination;
+    out->addr = shuffle->staging + shuffle->received_offsets[destination]
+        + (size_t)shuffle->before[index] * shuffle->element_size;
+    out->length = shuffle->counts[index] * shuffle->element_size;
+    return true;
+}
+
+/**
+ * @brief Moves the buckets of all the DPUs to their destinations, as placed by the last dpu_shuffle_plan.
+ *
+ * The receive buffer of each destination gets the elements of its buckets, from source 0 first, each bucket keeping the
+ * order of its elements.
+ *
+ * @param shuffle the shuffles
+ * @param send_symbol the DPU symbol holding the buckets of the DPU, one after the other in destination order
+ * @param send_offset the byte offset of the buckets from the send symbol
+ * @param receive_symbol the DPU symbol receiving the elements, of at least max_received bytes
+ * @param receive_offset the byte offset of the elements from the receive symbol
+ * @param count_symbol if not NULL, the uint32_t DPU symbol receiving the number of elements received
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_shuffle_exchange(struct dpu_shuffle *shuffle,
+    const char *send_symbol,
+    uint32_t send_offset,
+    const char *receive_symbol,
+    uint32_t receive_offset,
+    const char *count_symbol)
+{
+    get_block_t get_block = { .f = __dpu_shuffle_get_block, .args = shuffle, .args_size = sizeof(*shuffle) };
+    struct dpu_set_t dpu;
+    uint32_t each_dpu;
+    dpu_error_t status;
+
+    if (shuffle->max_sent != 0) {
+        if ((status = dpu_push_sg_xfer(shuffle->dpu_set,
+                 DPU_XFER_FROM_DPU,
+                 send_symbol,
+                 send_offset,
+                 shuffle->max_sent,
+                 &get_block,
+                 (dpu_sg_xfer_flags_t)(DPU_SG_XFER_ASYNC | DPU_SG_XFER_DISABLE_LENGTH_CHECK)))
+            != DPU_OK) {
+            return status;
+        }
+        /* Every destination needs the buckets of every rank. */
+        if ((status = dpu_sync(shuffle->dpu_set)) != DPU_OK) {
+            return status;
+        }
+        if ((status = dpu_push_varlen_xfer(shuffle->dpu_set,
+                 DPU_XFER_TO_DPU,
+                 receive_symbol,
+                 receive_offset,
+                 shuffle->staging,
+                 shuffle->received_offsets,
+                 shuffle->max_received,
+                 DPU_SG_XFER_ASYNC))
+            != DPU_OK) {
+            return status;
+        }
+    }
+
+    if (count_symbol != NULL) {
+        DPU_FOREACH (shuffle->dpu_set, dpu, each_dpu) {
+            if ((status = dpu_prepare_xfer(dpu, &shuffle->received_counts[each_dpu])) != DPU_OK) {
+                return status;
+            }
+        }
+        if ((status = dpu_push_xfer(
+                 shuffle->dpu_set, DPU_XFER_TO_DPU, count_symbol, 0, sizeof(uint32_t), DPU_XFER_ASYNC))
+            != DPU_OK) {
+            return status;
+        }
+    }
+    return dpu_sync(shuffle->dpu_set);
+}
+
+#endif /* __DPU_SHUFFLE_H */
@@ -0,0 +1,323 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_SORT_H
+#define __DPU_SORT_H
+
+/**
+ * @file dpu_sort.h
+ * @brief Host side of a sort spread across the DPUs of a set.
+ *
+ * Each DPU sorts its elements with the radix sort of the DPU runtime (radix_sort.h). Two ways of combining the DPUs are
+ * provided:
+ *  - sample sort: the host picks nr_dpus - 1 splitters from a sample of the keys, partitions the elements by key range
+ *    (dpu_sort_count_partitions, dpu_sort_offsets, dpu_sort_partition) and sends each range to a DPU with
+ *    dpu_push_varlen_xfer. The sorted partitions are then read back in the order of the DPUs, and are globally sorted.
+ *  - merge: when the elements were already distributed (for example in arrival order), the sorted runs read back from
+ *    the DPUs are merged on the host by dpu_sort_merge.
+ *
+ * The elements follow the layout used on the DPUs: each element starts with its key, a little-endian unsigned integer of
+ * 4 or 8 bytes.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief Reads the key of an element.
+ * @param element the element
+ * @param key_size the size of the key: 4 or 8 bytes
+ * @return The key, as an unsigned integer.
+ */
+static inline uint64_t
+dpu_sort_key(const void *element, uint32_t key_size)
+{
+    if (key_size == sizeof(uint32_t)) {
+        uint32_t key;
+        memcpy(&key, element, sizeof(key));
+        return key;
+    } else {
+        uint64_t key;
+        memcpy(&key, element, sizeof(key));
+        return key;
+    }
+}
+
+static inline int
+__dpu_sort_compare_keys(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Chooses the keys separating the partitions of a sample sort.
+ *
+ * nr_partitions * oversampling keys are sampled with a fixed pseudo-random sequence, sorted, and every oversampling-th
+ * one becomes a splitter. A larger oversampling gives partitions of more even sizes.
+ *
+ * @param elements the elements
+ * @param nr_elements the number of elements
+ * @param element_size the size of an element, in bytes
+ * @param key_size the size of the key of an element: 4 or 8 bytes
+ * @param nr_partitions the number of partitions
+ * @param oversampling the number of samples per partition, 0 being taken as 1
+ * @param splitters storage for the nr_partitions - 1 splitters
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_sort_splitters(const void *elements,
+    uint64_t nr_elements,
+    uint32_t element_size,
+    uint32_t key_size,
+    uint32_t nr_partitions,
+    uint32_t oversampling,
+    uint64_t *splitters)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    uint64_t nr_samples, *samples;
+
+    if (oversampling == 0) {
+        oversampling = 1;
+    }
+    nr_samples = (uint64_t)nr_partitions * oversampling;
+    if (nr_partitions < 2) {
+        return DPU_OK;
+    }
+    if (nr_elements == 0) {
+        memset(splitters, 0, (nr_partitions - 1) * sizeof(*splitters));
+        return DPU_OK;
+    }
+    if ((samples = malloc(nr_samples * sizeof(*samples))) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+
+    for (uint64_t each_sample = 0; each_sample < nr_samples; each_sample++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        samples[each_sample] = dpu_sort_key((const uint8_t *)elements + ((state >> 16) % nr_elements) * element_size, key_size);
+    }
+    qsort(samples, nr_samples, sizeof(*samples), __dpu_sort_compare_keys);
+    for (uint32_t each_partition = 1; each_partition < nr_partitions; each_partition++) {
+        splitters[each_partition - 1] = samples[(uint64_t)each_partition * oversampling];
+    }
+
+    free(samples);
+    return DPU_OK;
+}
+
+/**
+ * @brief Returns the partition of a key: the number of splitters lower than or equal to the key.
+ * @param splitters the nr_partitions - 1 splitters
+ * @param nr_partitions the number of partitions
+ * @param key the key
+ * @return The partition of the key.
+ */
+static inline uint32_t
+dpu_sort_partition_of(const uint64_t *splitters, uint32_t nr_partitions, uint64_t key)
+{
+    uint32_t lo = 0;
+    uint32_t hi = nr_partitions - 1;
+
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (splitters[mid] <= key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+ * @brief Counts the elements of each partition of a sample sort.
+ * @param elements the elements
+ * @param nr_elements the number of elements
+ * @param element_size the size of an element, in bytes
+ * @param key_size the size of the key of an element: 4 or 8 bytes
+ * @param splitters the nr_partitions - 1 splitters
+ * @param nr_partitions the number of partitions
+ * @param counts storage for the number of elements of each partition
+ */
+static inline void
+dpu_sort_count_partitions(const void *elements,
+    uint64_t nr_elements,
+    uint32_t element_size,
+    uint32_t key_size,
+    const uint64_t *splitters,
+    uint32_t nr_partitions,
+    uint64_t *counts)
+{
+    const uint8_t *element = (const uint8_t *)elements;
+
+    memset(counts, 0, nr_partitions * sizeof(*counts));
+    for (uint64_t each_element = 0; each_element < nr_elements; each_element++, element += element_size) {
+        counts[dpu_sort_partition_of(splitters, nr_partitions, dpu_sort_key(element, key_size))]++;
+    }
+}
+
+/**
+ * @brief Computes the offsets of the partitions in the buffer filled by dpu_sort_partition.
+ *
+ * Each partition is padded to a multiple of 8 bytes, as required by dpu_push_varlen_xfer.
+ *
+ * @param counts the number of elements of each partition
+ * @param nr_partitions the number of partitions
+ * @param element_size the size of an element, in bytes
+ * @param offsets storage for the nr_partitions + 1 byte offsets of the partitions
+ * @return The size of the largest partition, in bytes, padding included.
+ */
+static inline size_t
+dpu_sort_offsets(const uint64_t *counts, uint32_t nr_partitions, uint32_t element_size, uint64_t *offsets)
+{
+    size_t max_length = 0;
+
+    offsets[0] = 0;
+    for (uint32_t each_partition = 0; each_partition < nr_partitions; each_partition++) {
+        uint64_t length = (counts[each_partition] * element_size + 7) & ~(uint64_t)7;
+        offsets[each_partition + 1] = offsets[each_partition] + length;
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    return max_length;
+}
+
+/**
+ * @brief Copies the elements to their partition, keeping their relative order.
+ * @param elements the elements
+ * @param nr_elements the number of elements
+ * @param element_size the size of an element, in bytes
+ * @param key_size the size of the key of an element: 4 or 8 bytes
+ * @param splitters the nr_partitions - 1 splitters
+ * @param nr_partitions the number of partitions
+ * @param offsets the offsets of the partitions, as computed by dpu_sort_offsets
+ * @param output the buffer receiving the partitions, of offsets[nr_partitions] bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_sort_partition(const void *elements,
+    uint64_t nr_elements,
+    uint32_t element_size,
+    uint32_t key_size,
+    const uint64_t *splitters,
+    uint32_t nr_partitions,
+    const uint64_t *offsets,
+    void *output)
+{
+    const uint8_t *element = (const uint8_t *)elements;
+    uint64_t *cursors;
+
+    if ((cursors = malloc(nr_partitions * sizeof(*cursors))) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    memcpy(cursors, offsets, nr_partitions * sizeof(*cursors));
+
+    for (uint64_t each_element = 0; each_element < nr_elements; each_element++, element += element_size) {
+        uint32_t partition = dpu_sort_partition_of(splitters, nr_partitions, dpu_sort_key(element, key_size));
+        memcpy((uint8_t *)output + cursors[partition], element, element_size);
+        cursors[partition] += element_size;
+    }
+
+    free(cursors);
+    return DPU_OK;
+}
+
+struct __dpu_sort_run {
+    uint64_t key;
+    const uint8_t *next;
+    const uint8_t *end;
+};
+
+static inline void
+__dpu_sort_sift_down(struct __dpu_sort_run *heap, uint32_t size, uint32_t position)
+{
+    struct __dpu_sort_run run = heap[position];
+
+    for (;;) {
+        uint32_t child = 2 * position + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap[child + 1].key < heap[child].key) {
+            child++;
+        }
+        if (heap[child].key >= run.key) {
+            break;
+        }
+        heap[position] = heap[child];
+        position = child;
+    }
+    heap[position] = run;
+}
+
+/**
+ * @brief Merges the sorted runs read back from the DPUs.
+ *
+ * The runs are packed in one buffer, as with dpu_push_varlen_xfer: run i holds counts[i] elements starting at byte
+ * offsets[i]. The merge uses a binary heap of the runs: equal keys of different runs are output in no particular order,
+ * use a sample sort when the order of equal keys matters.
+ *
+ * @param runs the buffer holding the runs
+ * @param offsets the byte offset of each run in the buffer
+ * @param counts the number of elements of each run
+ * @param nr_runs the number of runs
+ * @param element_size the size of an element, in bytes
+ * @param key_size the size of the key of an element: 4 or 8 bytes
+ * @param output the buffer receiving the merged elements
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_sort_merge(const void *runs,
+    const uint64_t *offsets,
+    const uint64_t *counts,
+    uint32_t nr_runs,
+    uint32_t element_size,
+    uint32_t key_size,
+    void *output)
+{
+    struct __dpu_sort_run *heap;
+    uint8_t *to = (uint8_t *)output;
+    uint32_t size = 0;
+
+    if ((heap = malloc(nr_runs * sizeof(*heap))) == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    for (uint32_t each_run = 0; each_run < nr_runs; each_run++) {
+        const uint8_t *start = (const uint8_t *)runs + offsets[each_run];
+        if (counts[each_run] != 0) {
+            heap[size].key = dpu_sort_key(start, key_size);
+            heap[size].next = start;
+            heap[size].end = start + counts[each_run] * element_size;
+            size++;
+        }
+    }
+    for (uint32_t position = size / 2; position-- > 0;) {
+        __dpu_sort_sift_down(heap, size, position);
+    }
+
+    while (size != 0) {
+        struct __dpu_sort_run *first = &heap[0];
+        memcpy(to, first->next, element_size);
+        to += element_size;
+        first->next += element_size;
+        if (first->next == first->end) {
+            heap[0] = heap[--size];
+        } else {
+            first->key = dpu_sort_key(first->next, key_size);
+        }
+        __dpu_sort_sift_down(heap, size, 0);
+    }
+
+    free(heap);
+    return DPU_OK;
+}
+
+#endif /* __DPU_SORT_H */
@@ -0,0 +1,509 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_SPMV_H
+#define __DPU_SPMV_H
+
+/**
+ * @file dpu_spmv.h
+ * @brief Host side of the sparse matrix-vector products of the DPU runtime (spmv.h).
+ *
+ * A sparse matrix in CSR or 2x2 block CSR format is split between the DPUs when it is loaded, and stays in MRAM for all
+ * the products. The entries, and not the rows, are split evenly: with skewed rows, splitting the rows would leave most
+ * DPUs waiting for the few holding the longest rows. A row split between several DPUs is a row of each of them, and the
+ * host adds their results. A matrix in COO format is first converted with dpu_spmv_csr_from_coo.
+ *
+ * Each product broadcasts the vector to all the DPUs, and gathers the results of their rows. The transfers of the slices
+ * of the DPUs move only the useful bytes: the DPU set must have been allocated with scatter/gather transfers enabled
+ * (the "sgXferEnable=true" profile option).
+ *
+ * The DPU program is provided by the application, calls spmv_multiply with its symbols, and must define:
+ *  - row_offsets, columns, values, x and y in MRAM, large enough for the slice of the matrix of a DPU, the vector and the
+ *    results of the slice,
+ *  - uint32_t nr_rows and format, set by the host.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+#include <dpu_varlen.h>
+
+/**
+ * @brief Number of rows and of columns of the blocks of the BCSR format, identical to SPMV_BLOCK_SIZE on the DPU.
+ */
+#define DPU_SPMV_BLOCK_SIZE 2
+
+/**
+ * @brief The format of the matrix, identical to spmv_format_t on the DPU.
+ */
+typedef enum _dpu_spmv_format_t {
+    DPU_SPMV_CSR = 0,
+    DPU_SPMV_BCSR = 1,
+} dpu_spmv_format_t;
+
+/**
+ * @brief A matrix loaded on a DPU set.
+ */
+struct dpu_spmv {
+    struct dpu_set_t dpu_set;
+    uint32_t nr_dpus;
+    dpu_spmv_format_t format;
+    /** The number of rows and of columns, counted in blocks in BCSR format. */
+    uint32_t nr_rows;
+    uint32_t nr_columns;
+    /** DPU i holds the entries [first_entries[i], first_entries[i + 1]). */
+    uint32_t *first_entries;
+    /** DPU i holds the rows [first_rows[i], first_rows[i] + nr_local_rows[i]). */
+    uint32_t *first_rows;
+    uint32_t *nr_local_rows;
+};
+
+/**
+ * @brief Converts a matrix from COO format to CSR format.
+ *
+ * The entries of a row keep their order. Entries with the same row and column are kept: their products are added.
+ *
+ * @param nr_rows the number of rows
+ * @param nr_entries the number of entries
+ * @param rows the row index of each entry
+ * @param columns the column index of each entry
+ * @param values the value of each entry
+ * @param csr_row_offsets receives the nr_rows + 1 offsets of the rows
+ * @param csr_columns receives the column index of each entry
+ * @param csr_values receives the value of each entry
+ */
+static inline void
+dpu_spmv_csr_from_coo(uint32_t nr_rows,
+    uint32_t nr_entries,
+    const uint32_t *rows,
+    const uint32_t *columns,
+    const int32_t *values,
+    uint32_t *csr_row_offsets,
+    uint32_t *csr_columns,
+    int32_t *csr_values)
+{
+    memset(csr_row_offsets, 0, (nr_rows + 1) * sizeof(*csr_row_offsets));
+    for (uint32_t each_entry = 0; each_entry < nr_entries; each_entry++) {
+        csr_row_offsets[rows[each_entry] + 1]++;
+    }
+    for (uint32_t each_row = 0; each_row < nr_rows; each_row++) {
+        csr_row_offsets[each_row + 1] += csr_row_offsets[each_row];
+    }
+    /* Fill the rows with the offsets shifted by one row, which end up in place. */
+    memmove(csr_row_offsets + 1, csr_row_offsets, nr_rows * sizeof(*csr_row_offsets));
+    for (uint32_t each_entry = 0; each_entry < nr_entries; each_entry++) {
+        uint32_t position = csr_row_offsets[rows[each_entry] + 1]++;
+        csr_columns[position] = columns[each_entry];
+        csr_values[position] = values[each_entry];
+    }
+}
+
+/**
+ * @brief Converts a matrix from CSR format to block CSR format with DPU_SPMV_BLOCK_SIZE x DPU_SPMV_BLOCK_SIZE blocks.
+ *
+ * The matrix is padded with zeros to an even number of rows and of columns. The blocks of a row of blocks are in the
+ * order of their first entry in CSR format. The arrays of the result are allocated, and must be freed by the caller.
+ *
+ * @param nr_rows the number of rows
+ * @param nr_columns the number of columns
+ * @param row_offsets the nr_rows + 1 offsets of the rows
+ * @param columns the column index of each entry
+ * @param values the value of each entry
+ * @param block_row_offsets receives the offsets of the rows of blocks
+ * @param block_columns receives the column index of each block
+ * @param block_values receives the values of each block, row by row
+ * @param nr_blocks receives the number of blocks
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_spmv_bcsr_from_csr(uint32_t nr_rows,
+    uint32_t nr_columns,
+    const uint32_t *row_offsets,
+    const uint32_t *columns,
+    const int32_t *values,
+    uint32_t **block_row_offsets,
+    uint32_t **block_columns,
+    int32_t **block_values,
+    uint32_t *nr_blocks)
+{
+    const uint32_t b = DPU_SPMV_BLOCK_SIZE;
+    uint32_t nr_block_rows = (nr_rows + b - 1) / b, nr_block_columns = (nr_columns + b - 1) / b;
+    uint32_t *offsets = malloc((nr_block_rows + 1) * sizeof(*offsets));
+    /* The last row of blocks where each column of blocks was seen, then the index of its block in that row. */
+    uint32_t *markers = malloc((nr_block_columns != 0 ? nr_block_columns : 1) * sizeof(*markers));
+    uint32_t count = 0;
+
+    *block_columns = NULL;
+    *block_values = NULL;
+    if (offsets == NULL || markers == NULL) {
+        goto error;
+    }
+
+    memset(markers, 0xff, nr_block_columns * sizeof(*markers));
+    for (uint32_t block_row = 0; block_row < nr_block_rows; block_row++) {
+        offsets[block_row] = count;
+        for (uint32_t row = block_row * b; row < nr_rows && row < (block_row + 1) * b; row++) {
+            for (uint32_t each_entry = row_offsets[row]; each_entry < row_offsets[row + 1]; each_entry++) {
+                uint32_t block_column = columns[each_entry] / b;
+                if (markers[block_column] != block_row) {
+                    markers[block_column] = block_row;
+                    count++;
+                }
+            }
+        }
+    }
+    offsets[nr_block_rows] = count;
+
+    *block_columns = malloc((count != 0 ? count : 1) * sizeof(**block_columns));
+    *block_values = calloc(count != 0 ? count : 1, b * b * sizeof(**block_values));
+    if (*block_columns == NULL || *block_values == NULL) {
+        goto error;
+    }
+
+    memset(markers, 0xff, nr_block_columns * sizeof(*markers));
+    count = 0;
+    for (uint32_t block_row = 0; block_row < nr_block_rows; block_row++) {
+        for (uint32_t row = block_row * b; row < nr_rows && row < (block_row + 1) * b; row++) {
+            for (uint32_t each_entry = row_offsets[row]; each_entry < row_offsets[row + 1]; each_entry++) {
+                uint32_t block_column = columns[each_entry] / b;
+                if (markers[block_column] == UINT32_MAX || markers[block_column] < offsets[block_row]) {
+                    markers[block_column] = count;
+                    (*block_columns)[count++] = block_column;
+                }
+                (*block_values)[markers[block_column] * b * b + (row % b) * b + columns[each_entry] % b]
+                    += values[each_entry];
+            }
+        }
+    }
+
+    free(markers);
+    *block_row_offsets = offsets;
+    *nr_blocks = count;
+    return DPU_OK;
+
+error:
+    free(offsets);
+    free(markers);
+    free(*block_columns);
+    free(*block_values);
+    return DPU_ERR_SYSTEM;
+}
+
+/* The first row whose offset is at least the given entry index, among the rows [0, nr_rows]. */
+static inline uint32_t
+__dpu_spmv_lower_bound(const uint32_t *row_offsets, uint32_t nr_rows, uint32_t entry)
+{
+    uint32_t low = 0, high = nr_rows;
+
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (row_offsets[middle] < entry) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/* The slices of an array of entries, each DPU transferring its entries and, if their size is not a multiple of 8 bytes,
+ * a block of 8 bytes holding its last entry padded with zeros. Only the last DPU can have such a block. */
+struct __dpu_spmv_slices {
+    const uint8_t *array;
+    uint32_t entry_size;
+    const uint32_t *first_entries;
+    uint8_t tail[8];
+};
+
+static inline bool
+__dpu_spmv_get_block(struct sg_block_info *out, uint32_t dpu_index, uint32_t block_index, void *args)
+{
+    struct __dpu_spmv_slices *slices = (struct __dpu_spmv_slices *)args;
+    uint64_t from = (uint64_t)slices->first_entries[dpu_index] * slices->entry_size;
+    uint64_t length = (uint64_t)slices->first_entries[dpu_index + 1] * slices->entry_size - from;
+    uint64_t aligned = length & ~(uint64_t)7;
+
+    if (block_index == 0 && aligned != 0) {
+        out->addr = (uint8_t *)slices->array + from;
+        out->length = (uint32_t)aligned;
+        return true;
+    }
+    if (block_index == (aligned != 0 ? 1u : 0u) && aligned != length) {
+        memset(slices->tail, 0, sizeof(slices->tail));
+        memcpy(slices->tail, slices->array + from + aligned, length - aligned);
+        out->addr = slices->tail;
+        out->length = sizeof(slices->tail);
+        return true;
+    }
+    return false;
+}
+
+static inline dpu_error_t
+__dpu_spmv_push_slices(struct dpu_spmv *spmv, const char *symbol_name, const void *array, uint32_t entry_size)
+{
+    struct __dpu_spmv_slices slices = { .array = (const uint8_t *)array,
+        .entry_size = entry_size,
+        .first_entries = spmv->first_entries };
+    get_block_t get_block = { .f = __dpu_spmv_get_block, .args = &slices, .args_size = sizeof(slices) };
+    size_t max_length = 0;
+
+    for (uint32_t each_dpu = 0; each_dpu < spmv->nr_dpus; each_dpu++) {
+        size_t length = (size_t)(spmv->first_entries[each_dpu + 1] - spmv->first_entries[each_dpu]) * entry_size;
+        length = (length + 7) & ~(size_t)7;
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    if (max_length == 0) {
+        return DPU_OK;
+    }
+    return dpu_push_sg_xfer(
+        spmv->dpu_set, DPU_XFER_TO_DPU, symbol_name, 0, max_length, &get_block, DPU_SG_XFER_DISABLE_LENGTH_CHECK);
+}
+
+/**
+ * @brief Frees the description of a matrix loaded by dpu_spmv_load.
+ * @param spmv the matrix
+ */
+static inline void
+dpu_spmv_free(struct dpu_spmv *spmv)
+{
+    free(spmv->first_entries);
+    free(spmv->first_rows);
+    free(spmv->nr_local_rows);
+    spmv->first_entries = NULL;
+    spmv->first_rows = NULL;
+    spmv->nr_local_rows = NULL;
+}
+
+/**
+ * @brief Splits a sparse matrix between the DPUs of a set, where the DPU program is loaded.
+ *
+ * DPU i holds the entries [i * nr_entries / nr_dpus, (i + 1) * nr_entries / nr_dpus), with the boundaries rounded down
+ * to even entries, and the rows holding them. The column indices and the values are copied to the DPUs from the matrix
+ * itself, and the row offsets of each DPU are rebased to its first entry.
+ *
+ * @param dpu_set the DPU set
+ * @param format the format of the matrix
+ * @param nr_rows the number of rows, counted in blocks in BCSR format
+ * @param nr_columns the number of columns, counted in blocks in BCSR format
+ * @param row_offsets the nr_rows + 1 offsets of the rows in the entries
+ * @param columns the column index of each entry
+ * @param values the values of each entry, DPU_SPMV_BLOCK_SIZE x DPU_SPMV_BLOCK_SIZE per entry in BCSR format
+ * @param spmv receives the description of the loaded matrix, to be freed with dpu_spmv_free
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_spmv_load(struct dpu_set_t dpu_set,
+    dpu_spmv_format_t format,
+    uint32_t nr_rows,
+    uint32_t nr_columns,
+    const uint32_t *row_offsets,
+    const uint32_t *columns,
+    const int32_t *values,
+    struct dpu_spmv *spmv)
+{
+    uint32_t block_size = format == DPU_SPMV_BCSR ? DPU_SPMV_BLOCK_SIZE : 1;
+    uint32_t nr_entries = row_offsets[nr_rows];
+    struct dpu_set_t dpu;
+    uint32_t each_dpu, *staging = NULL;
+    uint64_t *sizes = NULL, *offsets = NULL;
+    size_t max_length;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &spmv->nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    spmv->dpu_set = dpu_set;
+    spmv->format = format;
+    spmv->nr_rows = nr_rows;
+    spmv->nr_columns = nr_columns;
+    spmv->first_entries = malloc((spmv->nr_dpus + 1) * sizeof(uint32_t));
+    spmv->first_rows = malloc(spmv->nr_dpus * sizeof(uint32_t));
+    spmv->nr_local_rows = malloc(spmv->nr_dpus * sizeof(uint32_t));
+    sizes = malloc(spmv->nr_dpus * sizeof(*sizes));
+    offsets = malloc((spmv->nr_dpus + 1) * sizeof(*offsets));
+    if (spmv->first_entries == NULL || spmv->first_rows == NULL || spmv->nr_local_rows == NULL || sizes == NULL
+        || offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    for (each_dpu = 0; each_dpu < spmv->nr_dpus; each_dpu++) {
+        spmv->first_entries[each_dpu] = (uint32_t)(((uint64_t)nr_entries * each_dpu / spmv->nr_dpus) & ~1);
+    }
+    spmv->first_entries[spmv->nr_dpus] = nr_entries;
+
+    /* A DPU holds the rows starting in its entries, preceded by the row its entries start in, if any. */
+    for (each_dpu = 0; each_dpu < spmv->nr_dpus; each_dpu++) {
+        uint32_t from = spmv->first_entries[each_dpu], to = spmv->first_entries[each_dpu + 1];
+        uint32_t first_row = __dpu_spmv_lower_bound(row_offsets, nr_rows, from);
+        uint32_t end_row = each_dpu == spmv->nr_dpus - 1 ? nr_rows : __dpu_spmv_lower_bound(row_offsets, nr_rows, to);
+
+        if (first_row != 0 && from < row_offsets[first_row]) {
+            first_row--;
+        }
+        spmv->first_rows[each_dpu] = first_row;
+        spmv->nr_local_rows[each_dpu] = end_row - first_row;
+        sizes[each_dpu] = ((uint64_t)end_row - first_row + 1) * sizeof(uint32_t);
+    }
+    max_length = dpu_varlen_offsets(sizes, spmv->nr_dpus, offsets);
+    staging = malloc(offsets[spmv->nr_dpus] != 0 ? offsets[spmv->nr_dpus] : 1);
+    if (staging == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    for (each_dpu = 0; each_dpu < spmv->nr_dpus; each_dpu++) {
+        uint32_t from = spmv->first_entries[each_dpu], to = spmv->first_entries[each_dpu + 1];
+        uint32_t *local_offsets = &staging[offsets[each_dpu] / sizeof(uint32_t)];
+        uint32_t each_row;
+
+        for (each_row = 0; each_row <= spmv->nr_local_rows[each_dpu]; each_row++) {
+            uint32_t offset = row_offsets[spmv->first_rows[each_dpu] + each_row];
+            local_offsets[each_row] = (offset < from ? from : offset > to ? to : offset) - from;
+        }
+        if ((each_row & 1) != 0) {
+            local_offsets[each_row] = to - from;
+        }
+    }
+
+    status = dpu_push_varlen_xfer(
+        dpu_set, DPU_XFER_TO_DPU, "row_offsets", 0, staging, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    if (status == DPU_OK) {
+        status = __dpu_spmv_push_slices(spmv, "columns", columns, sizeof(uint32_t));
+    }
+    if (status == DPU_OK) {
+        status = __dpu_spmv_push_slices(spmv, "values", values, block_size * block_size * sizeof(int32_t));
+    }
+    DPU_FOREACH (dpu_set, dpu, each_dpu) {
+        if (status == DPU_OK) {
+            status = dpu_prepare_xfer(dpu, &spmv->nr_local_rows[each_dpu]);
+        }
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_xfer(dpu_set, DPU_XFER_TO_DPU, "nr_rows", 0, sizeof(uint32_t), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        uint32_t dpu_format = format;
+        status = dpu_broadcast_to(dpu_set, "format", 0, &dpu_format, sizeof(dpu_format), DPU_XFER_DEFAULT);
+    }
+
+end:
+    if (status != DPU_OK) {
+        dpu_spmv_free(spmv);
+    }
+    free(sizes);
+    free(offsets);
+    free(staging);
+    return status;
+}
+
+/**
+ * @brief Multiplies the matrix loaded on the DPUs with a vector: y = A.x.
+ * @param spmv the matrix, loaded by dpu_spmv_load
+ * @param x the vector, of nr_columns elements, DPU_SPMV_BLOCK_SIZE per column in BCSR format
+ * @param y receives the nr_rows results, DPU_SPMV_BLOCK_SIZE per row in BCSR format
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_spmv_multiply(struct dpu_spmv *spmv, const int32_t *x, int64_t *y)
+{
+    uint32_t block_size = spmv->format == DPU_SPMV_BCSR ? DPU_SPMV_BLOCK_SIZE : 1;
+    size_t x_length = (size_t)spmv->nr_columns * block_size * sizeof(int32_t);
+    size_t x_aligned = x_length & ~(size_t)7;
+    uint64_t *sizes = malloc(spmv->nr_dpus * sizeof(*sizes));
+    uint64_t *offsets = malloc((spmv->nr_dpus + 1) * sizeof(*offsets));
+    int64_t *results = NULL;
+    size_t max_length;
+    dpu_error_t status = DPU_OK;
+
+    if (sizes == NULL || offsets == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+    for (uint32_t each_dpu = 0; each_dpu < spmv->nr_dpus; each_dpu++) {
+        sizes[each_dpu] = (uint64_t)spmv->nr_local_rows[each_dpu] * block_size * sizeof(int64_t);
+    }
+    max_length = dpu_varlen_offsets(sizes, spmv->nr_dpus, offsets);
+    results = malloc(offsets[spmv->nr_dpus] != 0 ? offsets[spmv->nr_dpus] : 1);
+    if (results == NULL) {
+        status = DPU_ERR_SYSTEM;
+        goto end;
+    }
+
+    if (x_aligned != 0) {
+        status = dpu_broadcast_to(spmv->dpu_set, "x", 0, x, x_aligned, DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK && x_aligned != x_length) {
+        int32_t tail[2] = { x[x_aligned / sizeof(int32_t)], 0 };
+        status = dpu_broadcast_to(spmv->dpu_set, "x", (uint32_t)x_aligned, tail, sizeof(tail), DPU_XFER_DEFAULT);
+    }
+    if (status == DPU_OK) {
+        status = dpu_launch(spmv->dpu_set, DPU_SYNCHRONOUS);
+    }
+    if (status == DPU_OK) {
+        status = dpu_push_varlen_xfer(
+            spmv->dpu_set, DPU_XFER_FROM_DPU, "y", 0, results, offsets, max_length, DPU_SG_XFER_DEFAULT);
+    }
+
+    /* The rows split between DPUs receive the sum of the results of each DPU. */
+    if (status == DPU_OK) {
+        memset(y, 0, (size_t)spmv->nr_rows * block_size * sizeof(int64_t));
+        for (uint32_t each_dpu = 0; each_dpu < spmv->nr_dpus; each_dpu++) {
+            const int64_t *local = &results[offsets[each_dpu] / sizeof(int64_t)];
+            int64_t *global = &y[(size_t)spmv->first_rows[each_dpu] * block_size];
+            for (size_t each_result = 0; each_result < (size_t)spmv->nr_local_rows[each_dpu] * block_size; each_result++) {
+                global[each_result] += local[each_result];
+            }
+        }
+    }
+
+end:
+    free(sizes);
+    free(offsets);
+    free(results);
+    return status;
+}
+
+/**
+ * @brief Multiplies a sparse matrix with a vector on the host, with the same results as dpu_spmv_multiply.
+ * @param format the format of the matrix
+ * @param nr_rows the number of rows, counted in blocks in BCSR format
+ * @param row_offsets the nr_rows + 1 offsets of the rows in the entries
+ * @param columns the column index of each entry
+ * @param values the values of each entry, DPU_SPMV_BLOCK_SIZE x DPU_SPMV_BLOCK_SIZE per entry in BCSR format
+ * @param x the vector, DPU_SPMV_BLOCK_SIZE elements per column in BCSR format
+ * @param y receives the nr_rows results, DPU_SPMV_BLOCK_SIZE per row in BCSR format
+ */
+static inline void
+dpu_spmv_reference(dpu_spmv_format_t format,
+    uint32_t nr_rows,
+    const uint32_t *row_offsets,
+    const uint32_t *columns,
+    const int32_t *values,
+    const int32_t *x,
+    int64_t *y)
+{
+    uint32_t b = format == DPU_SPMV_BCSR ? DPU_SPMV_BLOCK_SIZE : 1;
+
+    for (uint32_t each_row = 0; each_row < nr_rows; each_row++) {
+        for (uint32_t i = 0; i < b; i++) {
+            int64_t sum = 0;
+            for (uint32_t each_entry = row_offsets[each_row]; each_entry < row_offsets[each_row + 1]; each_entry++) {
+                for (uint32_t j = 0; j < b; j++) {
+                    sum += (int64_t)values[((size_t)each_entry * b + i) * b + j] * x[(size_t)columns[each_entry] * b + j];
+                }
+            }
+            y[(size_t)each_row * b + i] = sum;
+        }
+    }
+}
+
+#endif /* __DPU_SPMV_H */
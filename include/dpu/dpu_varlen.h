@@ -0,0 +1,203 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef __DPU_VARLEN_H
+#define __DPU_VARLEN_H
+
+/**
+ * @file dpu_varlen.h
+ * @brief Transfers of a different number of bytes to or from each DPU of a set.
+ *
+ * dpu_push_xfer transfers the same number of bytes for every DPU, so data partitioned between the DPUs is usually padded
+ * to the largest partition. The functions of this file describe the partition of each DPU as one block of a
+ * scatter/gather transfer, which moves only the useful bytes. dpu_push_varlen_ranges also copies ranges of a host buffer
+ * that are not multiples of 8 bytes, such as the parts of a text, without copying the buffer. The DPU set must have been
+ * allocated with scatter/gather transfers enabled (the "sgXferEnable=true" profile option).
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <dpu.h>
+
+/**
+ * @brief The partitions of a host buffer between the DPUs of a set.
+ */
+struct dpu_varlen_partitions {
+    /** The host buffer. */
+    uint8_t *buffer;
+    /** DPU i transfers the bytes [offsets[i], offsets[i + 1]) of the buffer. Each length must be a multiple of 8. */
+    const uint64_t *offsets;
+};
+
+static inline bool
+__dpu_varlen_get_block(struct sg_block_info *out, uint32_t dpu_index, uint32_t block_index, void *args)
+{
+    struct dpu_varlen_partitions *partitions = (struct dpu_varlen_partitions *)args;
+    uint64_t from = partitions->offsets[dpu_index];
+    uint64_t to = partitions->offsets[dpu_index + 1];
+
+    if (block_index != 0 || from == to) {
+        return false;
+    }
+    out->addr = partitions->buffer + from;
+    out->length = (uint32_t)(to - from);
+    return true;
+}
+
+/**
+ * @brief Transfers the partition of each DPU between a host buffer and a DPU symbol.
+ *
+ * For a DPU_XFER_TO_DPU transfer, the bytes of the symbol following the partition of a DPU, up to max_length, are
+ * filled with zeros.
+ *
+ * @param dpu_set the DPU set
+ * @param xfer the direction of the transfer
+ * @param symbol_name the DPU symbol where the partitions start
+ * @param symbol_offset the byte offset of the partitions from the symbol
+ * @param buffer the host buffer
+ * @param offsets the nr_dpus + 1 offsets of the partitions in the host buffer, in the order of DPU_FOREACH
+ * @param max_length the size of the largest partition
+ * @param flags the options of the scatter/gather transfer
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_push_varlen_xfer(struct dpu_set_t dpu_set,
+    dpu_xfer_t xfer,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    void *buffer,
+    const uint64_t *offsets,
+    size_t max_length,
+    dpu_sg_xfer_flags_t flags)
+{
+    struct dpu_varlen_partitions partitions = { .buffer = (uint8_t *)buffer, .offsets = offsets };
+    get_block_t get_block = { .f = __dpu_varlen_get_block, .args = &partitions, .args_size = sizeof(partitions) };
+
+    if (max_length == 0) {
+        return DPU_OK;
+    }
+    return dpu_push_sg_xfer(dpu_set,
+        xfer,
+        symbol_name,
+        symbol_offset,
+        max_length,
+        &get_block,
+        (dpu_sg_xfer_flags_t)(flags | DPU_SG_XFER_DISABLE_LENGTH_CHECK));
+}
+
+/* The ranges of a host buffer, each DPU transferring its bytes rounded up to a multiple of 8 with the bytes following
+ * them. A DPU whose rounded range would go past the end of the buffer transfers its last bytes padded with zeros, in a
+ * block of 8 bytes of its own: the blocks of all the DPUs are read by the transfer after the last call to get_block. */
+struct __dpu_varlen_ranges {
+    const uint8_t *buffer;
+    uint64_t length;
+    const uint64_t *starts;
+    const uint64_t *ends;
+    uint8_t (*tails)[8];
+};
+
+static inline bool
+__dpu_varlen_get_range_block(struct sg_block_info *out, uint32_t dpu_index, uint32_t block_index, void *args)
+{
+    struct __dpu_varlen_ranges *ranges = (struct __dpu_varlen_ranges *)args;
+    uint64_t from = ranges->starts[dpu_index];
+    uint64_t length = ranges->ends[dpu_index] - from;
+    uint64_t aligned = from + ((length + 7) & ~(uint64_t)7) <= ranges->length ? (length + 7) & ~(uint64_t)7
+                                                                              : length & ~(uint64_t)7;
+
+    if (block_index == 0 && aligned != 0) {
+        out->addr = (uint8_t *)ranges->buffer + from;
+        out->length = (uint32_t)aligned;
+        return true;
+    }
+    if (block_index == (aligned != 0 ? 1u : 0u) && aligned < length) {
+        uint8_t *tail = ranges->tails[dpu_index];
+        memset(tail, 0, sizeof(ranges->tails[0]));
+        memcpy(tail, ranges->buffer + from + aligned, length - aligned);
+        out->addr = tail;
+        out->length = sizeof(ranges->tails[0]);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Copies a range of a host buffer to each DPU of a set, without padding the ranges to the largest one.
+ *
+ * DPU i receives the bytes [starts[i], ends[i]) of the buffer, rounded up to a multiple of 8 bytes with the bytes
+ * following them in the buffer, or with zeros past its end. The ranges may overlap.
+ *
+ * @param dpu_set the DPU set
+ * @param symbol_name the DPU symbol receiving the ranges
+ * @param symbol_offset the byte offset of the ranges from the symbol
+ * @param buffer the host buffer
+ * @param length the length of the host buffer, in bytes
+ * @param starts the offset in the buffer of the range of each DPU, in the order of DPU_FOREACH
+ * @param ends the offset in the buffer following the range of each DPU, each range being at most UINT32_MAX bytes
+ * @return Whether the operation was successful.
+ */
+static inline dpu_error_t
+dpu_push_varlen_ranges(struct dpu_set_t dpu_set,
+    const char *symbol_name,
+    uint32_t symbol_offset,
+    const void *buffer,
+    uint64_t length,
+    const uint64_t *starts,
+    const uint64_t *ends)
+{
+    struct __dpu_varlen_ranges ranges = { .buffer = (const uint8_t *)buffer, .length = length, .starts = starts, .ends = ends };
+    get_block_t get_block = { .f = __dpu_varlen_get_range_block, .args = &ranges, .args_size = sizeof(ranges) };
+    size_t max_length = 0;
+    uint32_t nr_dpus;
+    dpu_error_t status;
+
+    if ((status = dpu_get_nr_dpus(dpu_set, &nr_dpus)) != DPU_OK) {
+        return status;
+    }
+    for (uint32_t each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+        size_t range_length = (size_t)((ends[each_dpu] - starts[each_dpu] + 7) & ~(uint64_t)7);
+        max_length = range_length > max_length ? range_length : max_length;
+    }
+    if (max_length == 0) {
+        return DPU_OK;
+    }
+    ranges.tails = malloc(nr_dpus * sizeof(ranges.tails[0]));
+    if (ranges.tails == NULL) {
+        return DPU_ERR_SYSTEM;
+    }
+    status = dpu_push_sg_xfer(
+        dpu_set, DPU_XFER_TO_DPU, symbol_name, symbol_offset, max_length, &get_block, DPU_SG_XFER_DISABLE_LENGTH_CHECK);
+    free(ranges.tails);
+    return status;
+}
+
+/**
+ * @brief Computes the offsets of partitions of the given sizes packed in a host buffer, each one rounded up to 8 bytes.
+ * @param sizes the size of the partition of each DPU, in bytes
+ * @param nr_dpus the number of DPUs
+ * @param offsets storage for the nr_dpus + 1 offsets
+ * @return The size of the largest rounded partition.
+ */
+static inline size_t
+dpu_varlen_offsets(const uint64_t *sizes, uint32_t nr_dpus, uint64_t *offsets)
+{
+    size_t max_length = 0;
+
+    offsets[0] = 0;
+    for (uint32_t each_dpu = 0; each_dpu < nr_dpus; each_dpu++) {
+        uint64_t length = (sizes[each_dpu] + 7) & ~(uint64_t)7;
+        offsets[each_dpu + 1] = offsets[each_dpu] + length;
+        if (length > max_length) {
+            max_length = length;
+        }
+    }
+    return max_length;
+}
+
+#endif /* __DPU_VARLEN_H */
@@ -0,0 +1,329 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_BFS_H
+#define DPUSYSCORE_BFS_H
+
+/**
+ * @file bfs.h
+ * @brief Expansion of a frontier of a level-synchronous breadth-first search, over a graph partitioned between the DPUs.
+ *
+ * Each DPU holds a range of vertices starting on a multiple of 64, with their lists of neighbours in CSR format: the
+ * row offsets are local to the DPU, the neighbours are global vertex indices. Sets of vertices are bitmaps where bit i
+ * of the 64-bit word i / 64 stands for vertex i, either for all the vertices of the graph or for the vertices of the DPU.
+ *
+ * Each level of the search calls bfs_expand once, in one of two directions:
+ *  - push (top-down): the frontier holds the vertices of the DPU found at the previous level, as a bitmap or, when it
+ *    is sparse, as a list. The neighbours of these vertices are set in a bitmap of all the vertices, with the OR update
+ *    combiner of mram_combiner.h. The host merges the bitmaps of all the DPUs and removes the vertices already visited.
+ *  - pull (bottom-up): the frontier is the bitmap of all the vertices found at the previous level. Each vertex of the
+ *    DPU not visited yet looks for a neighbour in the frontier, and stops at the first one found. The next frontier is
+ *    a bitmap of the vertices of the DPU. The neighbours are followed in reverse: the graph must be symmetric.
+ *
+ * The DPU keeps the bitmap of its visited vertices across levels, adding the vertices of each frontier. The work is
+ * handed out to the tasklets by a chunk dispenser (chunk_dispenser.h), as the degrees of the vertices can vary a lot.
+ *
+ * The WRAM used by each tasklet is BFS_BATCH * 12 + 24 bytes, plus the table of its combiner (see
+ * MRAM_COMBINER_CAPACITY): 1.8 KB with the default parameters.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <chunk_dispenser.h>
+#include <mram_combiner.h>
+#include <dpu_characteristics.h>
+
+#ifndef BFS_BATCH
+/**
+ * @def BFS_BATCH
+ * @hideinitializer
+ * @brief Number of neighbours, of vertices of a frontier list, or of 32-bit bitmap words read at once.
+ */
+#define BFS_BATCH 64
+#endif
+
+_Static_assert((BFS_BATCH & 1) == 0 && BFS_BATCH >= 2 && BFS_BATCH <= 512, "bfs error: invalid batch size defined");
+
+/**
+ * @def BFS_FRONTIER_BITMAP
+ * @brief The number of vertices of a frontier given as a bitmap rather than as a list.
+ */
+#define BFS_FRONTIER_BITMAP 0xffffffffu
+
+#ifdef NR_TASKLETS
+#define __BFS_NR_TASKLETS NR_TASKLETS
+#else
+#define __BFS_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @brief The direction of the expansion of a frontier.
+ */
+typedef enum _bfs_direction_t {
+    /** The vertices of the frontier set their neighbours. */
+    BFS_PUSH = 0,
+    /** The vertices not visited yet look for a neighbour in the frontier. */
+    BFS_PULL = 1,
+} bfs_direction_t;
+
+/**
+ * @struct bfs_graph
+ * @brief The part of the graph held by a DPU.
+ */
+struct bfs_graph {
+    /** The nr_vertices + 1 offsets of the lists of neighbours, padded to an even number, 8-byte aligned in MRAM. */
+    const __mram_ptr uint32_t *row_offsets;
+    /** The global indices of the neighbours, 8-byte aligned in MRAM. */
+    const __mram_ptr uint32_t *neighbours;
+    /** The global index of the first vertex of the DPU, a multiple of 64. */
+    uint32_t first_vertex;
+    /** The number of vertices of the DPU. */
+    uint32_t nr_vertices;
+    /** The number of vertices of the whole graph. */
+    uint32_t nr_total_vertices;
+};
+
+/* The buffers of a tasklet. */
+struct __bfs_buffers {
+    uint32_t words[BFS_BATCH];
+    uint32_t other_words[BFS_BATCH];
+    uint32_t neighbours[BFS_BATCH];
+    uint32_t cache[2];
+    uint32_t offsets[4];
+};
+
+/**
+ * @struct bfs
+ * @brief The state of the expansions, as declared by BFS_INIT.
+ */
+struct bfs {
+    barrier_t *barrier;
+    chunk_dispenser_t *dispenser;
+    struct mram_combiner *combiner;
+    struct __bfs_buffers *buffers;
+};
+
+/**
+ * @def BFS_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the expansions.
+ */
+#define BFS_INIT(NAME)                                                                                                           \
+    BARRIER_INIT(bfs_barrier_##NAME, __BFS_NR_TASKLETS);                                                                         \
+    CHUNK_DISPENSER_INIT(bfs_dispenser_##NAME);                                                                                  \
+    MRAM_COMBINER_INIT(bfs_combiner_##NAME, MRAM_COMBINER_OR);                                                                   \
+    __dma_aligned struct __bfs_buffers bfs_buffers_##NAME[__BFS_NR_TASKLETS];                                                    \
+    struct bfs NAME = { .barrier = &bfs_barrier_##NAME,                                                                          \
+        .dispenser = &bfs_dispenser_##NAME,                                                                                      \
+        .combiner = &bfs_combiner_##NAME,                                                                                        \
+        .buffers = bfs_buffers_##NAME };
+
+/* The range of the neighbours of a local vertex. The offsets may be read 2 entries past the vertex. */
+static inline void
+__bfs_neighbours_of(const struct bfs_graph *graph, struct __bfs_buffers *buffers, uint32_t vertex, uint32_t *from, uint32_t *to)
+{
+    mram_read(&graph->row_offsets[vertex & ~1], buffers->offsets, (vertex & 1) != 0 ? 16 : 8);
+    *from = buffers->offsets[vertex & 1];
+    *to = buffers->offsets[(vertex & 1) + 1];
+}
+
+/* Reads a batch of the neighbours [first, to) from first rounded down to even, setting end after the last one read.
+ * Returns the position of first in the buffer. */
+static inline uint32_t
+__bfs_read_neighbours(const struct bfs_graph *graph, struct __bfs_buffers *buffers, uint32_t first, uint32_t to, uint32_t *end)
+{
+    uint32_t aligned = first & ~1;
+    uint32_t n = to - aligned < BFS_BATCH ? to - aligned : BFS_BATCH;
+
+    mram_read(&graph->neighbours[aligned], buffers->neighbours, ((n + 1) & ~1) * sizeof(uint32_t));
+    *end = aligned + n;
+    return first - aligned;
+}
+
+/* Sets the neighbours of a local vertex in the next frontier. */
+static inline void
+__bfs_push(struct bfs *b,
+    const struct bfs_graph *graph,
+    struct __bfs_buffers *buffers,
+    uint32_t vertex,
+    __mram_ptr uint64_t *next)
+{
+    __mram_ptr int32_t *words = (__mram_ptr int32_t *)next;
+    uint32_t first, to, end;
+
+    __bfs_neighbours_of(graph, buffers, vertex, &first, &to);
+    for (; first < to; first = end) {
+        uint32_t index = __bfs_read_neighbours(graph, buffers, first, to, &end);
+        for (; index < end - (first & ~1); index++) {
+            uint32_t neighbour = buffers->neighbours[index];
+            mram_combiner_update(b->combiner, &words[neighbour >> 5], (int32_t)(1u << (neighbour & 31)));
+        }
+    }
+}
+
+/* Whether a local vertex has a neighbour in the frontier of all the vertices. The last 64-bit word of the frontier read
+ * is kept in the cache of the tasklet, and its index in cached. */
+static inline bool
+__bfs_pull(const struct bfs_graph *graph,
+    struct __bfs_buffers *buffers,
+    uint32_t vertex,
+    const __mram_ptr uint64_t *frontier,
+    uint32_t *cached)
+{
+    uint32_t first, to, end;
+
+    __bfs_neighbours_of(graph, buffers, vertex, &first, &to);
+    for (; first < to; first = end) {
+        uint32_t index = __bfs_read_neighbours(graph, buffers, first, to, &end);
+        for (; index < end - (first & ~1); index++) {
+            uint32_t neighbour = buffers->neighbours[index];
+            if ((neighbour >> 6) != *cached) {
+                *cached = neighbour >> 6;
+                mram_read(&frontier[*cached], buffers->cache, sizeof(uint64_t));
+            }
+            if ((buffers->cache[(neighbour >> 5) & 1] & (1u << (neighbour & 31))) != 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @fn bfs_expand
+ * @brief Expands the frontier of a level of the search over the vertices of the DPU.
+ *
+ * Must be called by all the tasklets, with the same arguments. The next frontier is complete when the tasklets return.
+ *
+ * @param b the state of the expansions
+ * @param graph the part of the graph held by the DPU
+ * @param direction the direction of the expansion, BFS_PULL requiring a symmetric graph
+ * @param level the level of the search, the bitmap of visited vertices being cleared at level 0
+ * @param frontier the vertices found at the previous level, 8-byte aligned in MRAM: in push direction, a bitmap of the
+ * vertices of the DPU or a list of nr_frontier indices of vertices of the DPU, relative to its first vertex; in pull
+ * direction, a bitmap of all the vertices
+ * @param nr_frontier the number of vertices of a frontier list, or BFS_FRONTIER_BITMAP
+ * @param visited the bitmap of the visited vertices of the DPU, kept between the levels, 8-byte aligned in MRAM
+ * @param next receives the next frontier, 8-byte aligned in MRAM: in push direction, a bitmap of all the vertices
+ * holding the neighbours of the frontier; in pull direction, a bitmap of the vertices of the DPU not visited yet having a
+ * neighbour in the frontier
+ */
+static inline void
+bfs_expand(struct bfs *b,
+    const struct bfs_graph *graph,
+    bfs_direction_t direction,
+    uint32_t level,
+    const __mram_ptr void *frontier,
+    uint32_t nr_frontier,
+    __mram_ptr uint64_t *visited,
+    __mram_ptr uint64_t *next)
+{
+    sysname_t id = me();
+    struct __bfs_buffers *buffers = &b->buffers[id];
+    const __mram_ptr uint32_t *frontier_words = (const __mram_ptr uint32_t *)frontier;
+    uint32_t nr_words = ((graph->nr_vertices + 63) >> 6) << 1;
+    uint32_t nr_next_words = direction == BFS_PUSH ? ((graph->nr_total_vertices + 63) >> 6) << 1 : 0;
+    uint32_t begin, end;
+
+    /* Add the frontier to the visited vertices, and clear the next frontier set by the push expansion. */
+    if (direction == BFS_PULL) {
+        frontier_words += graph->first_vertex >> 5;
+    }
+    for (uint32_t first = id * BFS_BATCH; first < nr_words || first < nr_next_words; first += __BFS_NR_TASKLETS * BFS_BATCH) {
+        if (first < nr_words) {
+            uint32_t n = nr_words - first < BFS_BATCH ? nr_words - first : BFS_BATCH;
+
+            if (level == 0) {
+                for (uint32_t i = 0; i < n; i++) {
+                    buffers->words[i] = 0;
+                }
+            } else {
+                mram_read(&visited[first >> 1], buffers->words, n * sizeof(uint32_t));
+            }
+            if (nr_frontier == BFS_FRONTIER_BITMAP) {
+                mram_read(&frontier_words[first], buffers->other_words, n * sizeof(uint32_t));
+                for (uint32_t i = 0; i < n; i++) {
+                    buffers->words[i] |= buffers->other_words[i];
+                }
+            }
+            mram_write(buffers->words, &visited[first >> 1], n * sizeof(uint32_t));
+        }
+        if (first < nr_next_words) {
+            uint32_t n = nr_next_words - first < BFS_BATCH ? nr_next_words - first : BFS_BATCH;
+            for (uint32_t i = 0; i < n; i++) {
+                buffers->words[i] = 0;
+            }
+            mram_write(buffers->words, &next[first >> 1], n * sizeof(uint32_t));
+        }
+    }
+    if (id == 0) {
+        if (nr_frontier != BFS_FRONTIER_BITMAP) {
+            chunk_dispenser_reset(b->dispenser, nr_frontier, CHUNK_DISPENSER_GUIDED, 2, BFS_BATCH, 2);
+        } else {
+            chunk_dispenser_reset(b->dispenser, nr_words, CHUNK_DISPENSER_GUIDED, 2, BFS_BATCH, 2);
+        }
+    }
+    barrier_wait(b->barrier);
+
+    if (nr_frontier != BFS_FRONTIER_BITMAP) {
+        __mram_ptr int32_t *visited_words = (__mram_ptr int32_t *)visited;
+        while (chunk_dispenser_next(b->dispenser, &begin, &end)) {
+            for (uint32_t first = begin; first < end; first += BFS_BATCH) {
+                uint32_t n = end - first < BFS_BATCH ? end - first : BFS_BATCH;
+                uint32_t *vertices = buffers->words;
+
+                mram_read(&frontier_words[first], vertices, ((n + 1) & ~1) * sizeof(uint32_t));
+                for (uint32_t i = 0; i < n; i++) {
+                    mram_combiner_update(b->combiner, &visited_words[vertices[i] >> 5], (int32_t)(1u << (vertices[i] & 31)));
+                    __bfs_push(b, graph, buffers, vertices[i], next);
+                }
+            }
+        }
+    } else if (direction == BFS_PUSH) {
+        while (chunk_dispenser_next(b->dispenser, &begin, &end)) {
+            for (uint32_t first = begin; first < end; first += BFS_BATCH) {
+                uint32_t n = end - first < BFS_BATCH ? end - first : BFS_BATCH;
+                uint32_t *words = buffers->words;
+
+                mram_read(&frontier_words[first], words, n * sizeof(uint32_t));
+                for (uint32_t i = 0; i < n; i++) {
+                    for (uint32_t bits = words[i]; bits != 0; bits &= bits - 1) {
+                        __bfs_push(b, graph, buffers, ((first + i) << 5) + __builtin_ctz(bits), next);
+                    }
+                }
+            }
+        }
+    } else {
+        uint32_t cached = 0xffffffff;
+        while (chunk_dispenser_next(b->dispenser, &begin, &end)) {
+            for (uint32_t first = begin; first < end; first += BFS_BATCH) {
+                uint32_t n = end - first < BFS_BATCH ? end - first : BFS_BATCH;
+                uint32_t *words = buffers->words;
+
+                mram_read(&visited[first >> 1], words, n * sizeof(uint32_t));
+                for (uint32_t i = 0; i < n; i++) {
+                    uint32_t found = 0;
+                    for (uint32_t bits = ~words[i]; bits != 0; bits &= bits - 1) {
+                        uint32_t vertex = ((first + i) << 5) + __builtin_ctz(bits);
+                        if (vertex >= graph->nr_vertices) {
+                            break;
+                        }
+                        if (__bfs_pull(graph, buffers, vertex, frontier, &cached)) {
+                            found |= 1u << (vertex & 31);
+                        }
+                    }
+                    words[i] = found;
+                }
+                mram_write(words, &next[first >> 1], n * sizeof(uint32_t));
+            }
+        }
+    }
+    mram_combiner_flush(b->combiner);
+}
+
+#endif /* DPUSYSCORE_BFS_H */
@@ -0,0 +1,668 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_CHECKSUM_H
+#define DPUSYSCORE_CHECKSUM_H
+
+/**
+ * @file checksum.h
+ * @brief Checksums of WRAM buffers and of MRAM areas: CRC32C, xxHash32 and xxHash64.
+ *
+ * The functions computing the checksum of a WRAM buffer are called by a single tasklet. CRC32C is computed with a
+ * 1 KB table in WRAM, one word of the buffer at a time. xxHash32 and xxHash64 compute the products of their 32-bit and
+ * 64-bit lanes with their constants from the 8x8-bit multiplications of the DPU (10 and 36 mul instructions per product),
+ * rather than with the generic multiplication routines. The checksums of a buffer can be computed piece by piece:
+ * checksum_crc32c takes the CRC of the previous bytes, and xxHash has a state which is updated with each piece.
+ *
+ * The functions computing the checksum of an MRAM area are called by all the tasklets, each reading a part of the area
+ * by blocks of CHECKSUM_BLOCK_SIZE bytes:
+ *  - the CRC32C of each part is shifted by the bytes after it, and the CRC32C of the area is the exclusive or of the
+ *    shifted CRCs, identical to the CRC32C of the area computed in sequence,
+ *  - xxHash64 cannot be combined in this way: the area is hashed in chunks, distributed to the tasklets, and the result is
+ *    the xxHash64 of the list of the xxHash64 of the chunks. It only depends on the chunk size, not on the number of
+ *    tasklets.
+ *
+ * All the checksums are identical to the checksums computed by the host (see dpu_checksum.h).
+ *
+ * The WRAM used by each tasklet is CHECKSUM_BLOCK_SIZE + 8 bytes, plus the CRC32C table.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <built_ins.h>
+#include <dpu_characteristics.h>
+
+#ifndef CHECKSUM_BLOCK_SIZE
+/**
+ * @def CHECKSUM_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Size of the blocks of MRAM read by each tasklet, in bytes.
+ */
+#define CHECKSUM_BLOCK_SIZE 1024
+#endif
+
+_Static_assert((CHECKSUM_BLOCK_SIZE & 31) == 0 && CHECKSUM_BLOCK_SIZE >= 32 && CHECKSUM_BLOCK_SIZE <= 2048,
+    "checksum error: invalid block size defined");
+
+#ifdef NR_TASKLETS
+#define __CHECKSUM_NR_TASKLETS NR_TASKLETS
+#else
+#define __CHECKSUM_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/* The CRC32C (Castagnoli) polynomial, bit-reversed. */
+#define __CHECKSUM_CRC32C_POLYNOMIAL 0x82f63b78u
+
+/* The CRC32C of each byte. */
+static const uint32_t __checksum_crc32c_table[256] = {
+    0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
+    0x8ad958cf, 0x78b2dbcc, 0x6be22838, 0x9989ab3b, 0x4d43cfd0, 0xbf284cd3, 0xac78bf27, 0x5e133c24,
+    0x105ec76f, 0xe235446c, 0xf165b798, 0x030e349b, 0xd7c45070, 0x25afd373, 0x36ff2087, 0xc494a384,
+    0x9a879fa0, 0x68ec1ca3, 0x7bbcef57, 0x89d76c54, 0x5d1d08bf, 0xaf768bbc, 0xbc267848, 0x4e4dfb4b,
+    0x20bd8ede, 0xd2d60ddd, 0xc186fe29, 0x33ed7d2a, 0xe72719c1, 0x154c9ac2, 0x061c6936, 0xf477ea35,
+    0xaa64d611, 0x580f5512, 0x4b5fa6e6, 0xb93425e5, 0x6dfe410e, 0x9f95c20d, 0x8cc531f9, 0x7eaeb2fa,
+    0x30e349b1, 0xc288cab2, 0xd1d83946, 0x23b3ba45, 0xf779deae, 0x05125dad, 0x1642ae59, 0xe4292d5a,
+    0xba3a117e, 0x4851927d, 0x5b016189, 0xa96ae28a, 0x7da08661, 0x8fcb0562, 0x9c9bf696, 0x6ef07595,
+    0x417b1dbc, 0xb3109ebf, 0xa0406d4b, 0x522bee48, 0x86e18aa3, 0x748a09a0, 0x67dafa54, 0x95b17957,
+    0xcba24573, 0x39c9c670, 0x2a993584, 0xd8f2b687, 0x0c38d26c, 0xfe53516f, 0xed03a29b, 0x1f682198,
+    0x5125dad3, 0xa34e59d0, 0xb01eaa24, 0x42752927, 0x96bf4dcc, 0x64d4cecf, 0x77843d3b, 0x85efbe38,
+    0xdbfc821c, 0x2997011f, 0x3ac7f2eb, 0xc8ac71e8, 0x1c661503, 0xee0d9600, 0xfd5d65f4, 0x0f36e6f7,
+    0x61c69362, 0x93ad1061, 0x80fde395, 0x72966096, 0xa65c047d, 0x5437877e, 0x4767748a, 0xb50cf789,
+    0xeb1fcbad, 0x197448ae, 0x0a24bb5a, 0xf84f3859, 0x2c855cb2, 0xdeeedfb1, 0xcdbe2c45, 0x3fd5af46,
+    0x7198540d, 0x83f3d70e, 0x90a324fa, 0x62c8a7f9, 0xb602c312, 0x44694011, 0x5739b3e5, 0xa55230e6,
+    0xfb410cc2, 0x092a8fc1, 0x1a7a7c35, 0xe811ff36, 0x3cdb9bdd, 0xceb018de, 0xdde0eb2a, 0x2f8b6829,
+    0x82f63b78, 0x709db87b, 0x63cd4b8f, 0x91a6c88c, 0x456cac67, 0xb7072f64, 0xa457dc90, 0x563c5f93,
+    0x082f63b7, 0xfa44e0b4, 0xe9141340, 0x1b7f9043, 0xcfb5f4a8, 0x3dde77ab, 0x2e8e845f, 0xdce5075c,
+    0x92a8fc17, 0x60c37f14, 0x73938ce0, 0x81f80fe3, 0x55326b08, 0xa759e80b, 0xb4091bff, 0x466298fc,
+    0x1871a4d8, 0xea1a27db, 0xf94ad42f, 0x0b21572c, 0xdfeb33c7, 0x2d80b0c4, 0x3ed04330, 0xccbbc033,
+    0xa24bb5a6, 0x502036a5, 0x4370c551, 0xb11b4652, 0x65d122b9, 0x97baa1ba, 0x84ea524e, 0x7681d14d,
+    0x2892ed69, 0xdaf96e6a, 0xc9a99d9e, 0x3bc21e9d, 0xef087a76, 0x1d63f975, 0x0e330a81, 0xfc588982,
+    0xb21572c9, 0x407ef1ca, 0x532e023e, 0xa145813d, 0x758fe5d6, 0x87e466d5, 0x94b49521, 0x66df1622,
+    0x38cc2a06, 0xcaa7a905, 0xd9f75af1, 0x2b9cd9f2, 0xff56bd19, 0x0d3d3e1a, 0x1e6dcdee, 0xec064eed,
+    0xc38d26c4, 0x31e6a5c7, 0x22b65633, 0xd0ddd530, 0x0417b1db, 0xf67c32d8, 0xe52cc12c, 0x1747422f,
+    0x49547e0b, 0xbb3ffd08, 0xa86f0efc, 0x5a048dff, 0x8ecee914, 0x7ca56a17, 0x6ff599e3, 0x9d9e1ae0,
+    0xd3d3e1ab, 0x21b862a8, 0x32e8915c, 0xc083125f, 0x144976b4, 0xe622f5b7, 0xf5720643, 0x07198540,
+    0x590ab964, 0xab613a67, 0xb831c993, 0x4a5a4a90, 0x9e902e7b, 0x6cfbad78, 0x7fab5e8c, 0x8dc0dd8f,
+    0xe330a81a, 0x115b2b19, 0x020bd8ed, 0xf0605bee, 0x24aa3f05, 0xd6c1bc06, 0xc5914ff2, 0x37faccf1,
+    0x69e9f0d5, 0x9b8273d6, 0x88d28022, 0x7ab90321, 0xae7367ca, 0x5c18e4c9, 0x4f48173d, 0xbd23943e,
+    0xf36e6f75, 0x0105ec76, 0x12551f82, 0xe03e9c81, 0x34f4f86a, 0xc69f7b69, 0xd5cf889d, 0x27a40b9e,
+    0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e, 0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351,
+};
+
+/* x^(2^k) modulo the CRC32C polynomial, bit-reversed, for k < 31: x^(2^31) is x, so the powers repeat every 31. */
+static const uint32_t __checksum_crc32c_powers[31] = {
+    0x40000000, 0x20000000, 0x08000000, 0x00800000, 0x00008000, 0x82f63b78, 0x6ea2d55c, 0x18b8ea18,
+    0x510ac59a, 0xb82be955, 0xb8fdb1e7, 0x88e56f72, 0x74c360a4, 0xe4172b16, 0x0d65762a, 0x35d73a62,
+    0x28461564, 0xbf455269, 0xe2ea32dc, 0xfe7740e6, 0xf946610b, 0x3c204f8f, 0x538586e3, 0x59726915,
+    0x734d5309, 0xbc1ac763, 0x7d0722cc, 0xd289cabe, 0xe94ca9bc, 0x05b74f3f, 0xa51e1f42,
+};
+
+#define __CHECKSUM_XXH32_PRIME1 0x9e3779b1u
+#define __CHECKSUM_XXH32_PRIME2 0x85ebca77u
+#define __CHECKSUM_XXH32_PRIME3 0xc2b2ae3du
+#define __CHECKSUM_XXH32_PRIME4 0x27d4eb2fu
+#define __CHECKSUM_XXH32_PRIME5 0x165667b1u
+
+#define __CHECKSUM_XXH64_PRIME1 0x9e3779b185ebca87ull
+#define __CHECKSUM_XXH64_PRIME2 0xc2b2ae3d27d4eb4full
+#define __CHECKSUM_XXH64_PRIME3 0x165667b19e3779f9ull
+#define __CHECKSUM_XXH64_PRIME4 0x85ebca77c2b2ae63ull
+#define __CHECKSUM_XXH64_PRIME5 0x27d4eb2f165667c5ull
+
+/**
+ * @struct checksum_xxh32
+ * @brief The state of an xxHash32 computation.
+ */
+struct checksum_xxh32 {
+    uint32_t lanes[4];
+    uint32_t buffer[4];
+    uint64_t total_length;
+    uint32_t nr_buffered;
+};
+
+/**
+ * @struct checksum_xxh64
+ * @brief The state of an xxHash64 computation.
+ */
+struct checksum_xxh64 {
+    uint64_t lanes[4];
+    uint64_t buffer[4];
+    uint64_t total_length;
+    uint32_t nr_buffered;
+};
+
+/**
+ * @struct checksum
+ * @brief The state of the checksums of MRAM areas, as declared by CHECKSUM_INIT.
+ */
+struct checksum {
+    barrier_t *barrier;
+    uint8_t (*blocks)[CHECKSUM_BLOCK_SIZE];
+    uint64_t *partials;
+};
+
+/**
+ * @def CHECKSUM_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the checksums of MRAM areas.
+ */
+#define CHECKSUM_INIT(NAME)                                                                                                      \
+    BARRIER_INIT(checksum_barrier_##NAME, __CHECKSUM_NR_TASKLETS);                                                               \
+    __dma_aligned uint8_t checksum_blocks_##NAME[__CHECKSUM_NR_TASKLETS][CHECKSUM_BLOCK_SIZE];                                   \
+    __dma_aligned uint64_t checksum_partials_##NAME[__CHECKSUM_NR_TASKLETS];                                                     \
+    struct checksum NAME = { .barrier = &checksum_barrier_##NAME,                                                                \
+        .blocks = checksum_blocks_##NAME,                                                                                        \
+        .partials = checksum_partials_##NAME };
+
+/* The 32-bit product of two 16-bit integers, from the products of their bytes. */
+static inline uint32_t
+__checksum_mul16(uint32_t a, uint32_t b)
+{
+    uint32_t ll, lh, hl, hh;
+
+    __builtin_mul_ul_ul_rrr(ll, a, b);
+    __builtin_mul_ul_uh_rrr(lh, a, b);
+    __builtin_mul_uh_ul_rrr(hl, a, b);
+    __builtin_mul_uh_uh_rrr(hh, a, b);
+    return ll + ((lh + hl) << 8) + (hh << 16);
+}
+
+/* The low 16 bits of the product of two 16-bit integers, in the low half of the result. */
+static inline uint32_t
+__checksum_mul16_low(uint32_t a, uint32_t b)
+{
+    uint32_t ll, lh, hl;
+
+    __builtin_mul_ul_ul_rrr(ll, a, b);
+    __builtin_mul_ul_uh_rrr(lh, a, b);
+    __builtin_mul_uh_ul_rrr(hl, a, b);
+    return ll + ((lh + hl) << 8);
+}
+
+/* The low 32 bits of the product of two 32-bit integers. */
+static inline uint32_t
+__checksum_mul32(uint32_t a, uint32_t b)
+{
+    return __checksum_mul16(a & 0xffff, b & 0xffff)
+        + ((__checksum_mul16_low(a & 0xffff, b >> 16) + __checksum_mul16_low(a >> 16, b & 0xffff)) << 16);
+}
+
+/* The 64-bit product of two 32-bit integers. */
+static inline uint64_t
+__checksum_mul32_wide(uint32_t a, uint32_t b)
+{
+    uint32_t low = __checksum_mul16(a & 0xffff, b & 0xffff), high = __checksum_mul16(a >> 16, b >> 16);
+    uint64_t middle = (uint64_t)__checksum_mul16(a & 0xffff, b >> 16) + __checksum_mul16(a >> 16, b & 0xffff);
+
+    return (((uint64_t)high << 32) | low) + (middle << 16);
+}
+
+/* The low 64 bits of the product of two 64-bit integers. */
+static inline uint64_t
+__checksum_mul64(uint64_t a, uint64_t b)
+{
+    uint32_t a_low = (uint32_t)a, a_high = (uint32_t)(a >> 32), b_low = (uint32_t)b, b_high = (uint32_t)(b >> 32);
+
+    return __checksum_mul32_wide(a_low, b_low)
+        + ((uint64_t)(__checksum_mul32(a_low, b_high) + __checksum_mul32(a_high, b_low)) << 32);
+}
+
+static inline uint32_t
+__checksum_rotl32(uint32_t x, uint32_t r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint64_t
+__checksum_rotl64(uint64_t x, uint32_t r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+/**
+ * @fn checksum_crc32c
+ * @brief Computes the CRC32C of a WRAM buffer.
+ *
+ * The CRC32C of a sequence of buffers is computed by passing the CRC32C of each buffer to the next call.
+ *
+ * @param crc the CRC32C of the previous bytes, 0 for the first buffer
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @return The CRC32C of the previous bytes followed by the buffer.
+ */
+static inline uint32_t
+checksum_crc32c(uint32_t crc, const void *buffer, uint32_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer, *end = bytes + length;
+
+    crc = ~crc;
+    while (bytes != end && ((uintptr_t)bytes & 3) != 0) {
+        crc = __checksum_crc32c_table[(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+    }
+    for (; end - bytes >= 4; bytes += 4) {
+        crc ^= *(const uint32_t *)bytes;
+        crc = __checksum_crc32c_table[crc & 0xff] ^ (crc >> 8);
+        crc = __checksum_crc32c_table[crc & 0xff] ^ (crc >> 8);
+        crc = __checksum_crc32c_table[crc & 0xff] ^ (crc >> 8);
+        crc = __checksum_crc32c_table[crc & 0xff] ^ (crc >> 8);
+    }
+    while (bytes != end) {
+        crc = __checksum_crc32c_table[(crc ^ *bytes++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* The product of two polynomials modulo the CRC32C polynomial, bit-reversed. */
+static inline uint32_t
+__checksum_crc32c_multiply(uint32_t a, uint32_t b)
+{
+    uint32_t mask = 1u << 31, product = 0;
+
+    while (true) {
+        if ((a & mask) != 0) {
+            product ^= b;
+            if ((a & (mask - 1)) == 0) {
+                return product;
+            }
+        }
+        mask >>= 1;
+        b = (b & 1) != 0 ? (b >> 1) ^ __CHECKSUM_CRC32C_POLYNOMIAL : b >> 1;
+    }
+}
+
+/* The CRC32C of some bytes followed by the given number of zero bytes, without the conditioning of these bytes. */
+static inline uint32_t
+__checksum_crc32c_shift(uint32_t crc, uint32_t length)
+{
+    uint32_t power = 1u << 31;
+
+    for (uint32_t k = 3; length != 0; length >>= 1, k = k == 30 ? 0 : k + 1) {
+        if ((length & 1) != 0) {
+            power = __checksum_crc32c_multiply(__checksum_crc32c_powers[k], power);
+        }
+    }
+    return __checksum_crc32c_multiply(power, crc);
+}
+
+/**
+ * @fn checksum_crc32c_combine
+ * @brief Computes the CRC32C of two consecutive sequences of bytes from their CRC32C.
+ * @param crc_a the CRC32C of the first sequence
+ * @param crc_b the CRC32C of the second sequence
+ * @param length_b the length of the second sequence, in bytes
+ * @return The CRC32C of the first sequence followed by the second.
+ */
+static inline uint32_t
+checksum_crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint32_t length_b)
+{
+    return __checksum_crc32c_shift(crc_a, length_b) ^ crc_b;
+}
+
+static inline uint32_t
+__checksum_xxh32_round(uint32_t lane, uint32_t input)
+{
+    lane += __checksum_mul32(input, __CHECKSUM_XXH32_PRIME2);
+    return __checksum_mul32(__checksum_rotl32(lane, 13), __CHECKSUM_XXH32_PRIME1);
+}
+
+static inline void
+__checksum_xxh32_stripe(uint32_t *lanes, const uint32_t *input)
+{
+    lanes[0] = __checksum_xxh32_round(lanes[0], input[0]);
+    lanes[1] = __checksum_xxh32_round(lanes[1], input[1]);
+    lanes[2] = __checksum_xxh32_round(lanes[2], input[2]);
+    lanes[3] = __checksum_xxh32_round(lanes[3], input[3]);
+}
+
+/**
+ * @fn checksum_xxh32_reset
+ * @brief Starts an xxHash32 computation.
+ * @param state the state of the computation
+ * @param seed the seed of the hash
+ */
+static inline void
+checksum_xxh32_reset(struct checksum_xxh32 *state, uint32_t seed)
+{
+    state->lanes[0] = seed + __CHECKSUM_XXH32_PRIME1 + __CHECKSUM_XXH32_PRIME2;
+    state->lanes[1] = seed + __CHECKSUM_XXH32_PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - __CHECKSUM_XXH32_PRIME1;
+    state->total_length = 0;
+    state->nr_buffered = 0;
+}
+
+/**
+ * @fn checksum_xxh32_update
+ * @brief Adds a WRAM buffer to an xxHash32 computation. A 4-byte aligned buffer is read by words.
+ * @param state the state of the computation
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ */
+static inline void
+checksum_xxh32_update(struct checksum_xxh32 *state, const void *buffer, uint32_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer, *end = bytes + length;
+
+    state->total_length += length;
+    if (state->nr_buffered + length < 16) {
+        memcpy((uint8_t *)state->buffer + state->nr_buffered, bytes, length);
+        state->nr_buffered += length;
+        return;
+    }
+    if (state->nr_buffered != 0) {
+        memcpy((uint8_t *)state->buffer + state->nr_buffered, bytes, 16 - state->nr_buffered);
+        __checksum_xxh32_stripe(state->lanes, state->buffer);
+        bytes += 16 - state->nr_buffered;
+    }
+    if (((uintptr_t)bytes & 3) == 0) {
+        for (; end - bytes >= 16; bytes += 16) {
+            __checksum_xxh32_stripe(state->lanes, (const uint32_t *)bytes);
+        }
+    } else {
+        for (; end - bytes >= 16; bytes += 16) {
+            memcpy(state->buffer, bytes, 16);
+            __checksum_xxh32_stripe(state->lanes, state->buffer);
+        }
+    }
+    state->nr_buffered = end - bytes;
+    memcpy(state->buffer, bytes, state->nr_buffered);
+}
+
+/**
+ * @fn checksum_xxh32_digest
+ * @brief Computes the xxHash32 of the buffers added to a computation, which can go on.
+ * @param state the state of the computation
+ * @return The xxHash32 of the buffers.
+ */
+static inline uint32_t
+checksum_xxh32_digest(const struct checksum_xxh32 *state)
+{
+    const uint8_t *bytes = (const uint8_t *)state->buffer;
+    uint32_t hash, remaining = state->nr_buffered;
+
+    if (state->total_length >= 16) {
+        hash = __checksum_rotl32(state->lanes[0], 1) + __checksum_rotl32(state->lanes[1], 7)
+            + __checksum_rotl32(state->lanes[2], 12) + __checksum_rotl32(state->lanes[3], 18);
+    } else {
+        hash = state->lanes[2] + __CHECKSUM_XXH32_PRIME5;
+    }
+    hash += (uint32_t)state->total_length;
+
+    for (; remaining >= 4; remaining -= 4, bytes += 4) {
+        hash += __checksum_mul32(*(const uint32_t *)bytes, __CHECKSUM_XXH32_PRIME3);
+        hash = __checksum_mul32(__checksum_rotl32(hash, 17), __CHECKSUM_XXH32_PRIME4);
+    }
+    for (; remaining != 0; remaining--, bytes++) {
+        hash += __checksum_mul32(*bytes, __CHECKSUM_XXH32_PRIME5);
+        hash = __checksum_mul32(__checksum_rotl32(hash, 11), __CHECKSUM_XXH32_PRIME1);
+    }
+
+    hash = __checksum_mul32(hash ^ (hash >> 15), __CHECKSUM_XXH32_PRIME2);
+    hash = __checksum_mul32(hash ^ (hash >> 13), __CHECKSUM_XXH32_PRIME3);
+    return hash ^ (hash >> 16);
+}
+
+/**
+ * @fn checksum_xxh32
+ * @brief Computes the xxHash32 of a WRAM buffer.
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @param seed the seed of the hash
+ * @return The xxHash32 of the buffer.
+ */
+static inline uint32_t
+checksum_xxh32(const void *buffer, uint32_t length, uint32_t seed)
+{
+    struct checksum_xxh32 state;
+
+    checksum_xxh32_reset(&state, seed);
+    checksum_xxh32_update(&state, buffer, length);
+    return checksum_xxh32_digest(&state);
+}
+
+static inline uint64_t
+__checksum_xxh64_round(uint64_t lane, uint64_t input)
+{
+    lane += __checksum_mul64(input, __CHECKSUM_XXH64_PRIME2);
+    return __checksum_mul64(__checksum_rotl64(lane, 31), __CHECKSUM_XXH64_PRIME1);
+}
+
+static inline uint64_t
+__checksum_xxh64_merge(uint64_t hash, uint64_t lane)
+{
+    hash ^= __checksum_xxh64_round(0, lane);
+    return __checksum_mul64(hash, __CHECKSUM_XXH64_PRIME1) + __CHECKSUM_XXH64_PRIME4;
+}
+
+static inline void
+__checksum_xxh64_stripe(uint64_t *lanes, const uint64_t *input)
+{
+    lanes[0] = __checksum_xxh64_round(lanes[0], input[0]);
+    lanes[1] = __checksum_xxh64_round(lanes[1], input[1]);
+    lanes[2] = __checksum_xxh64_round(lanes[2], input[2]);
+    lanes[3] = __checksum_xxh64_round(lanes[3], input[3]);
+}
+
+/**
+ * @fn checksum_xxh64_reset
+ * @brief Starts an xxHash64 computation.
+ * @param state the state of the computation
+ * @param seed the seed of the hash
+ */
+static inline void
+checksum_xxh64_reset(struct checksum_xxh64 *state, uint64_t seed)
+{
+    state->lanes[0] = seed + __CHECKSUM_XXH64_PRIME1 + __CHECKSUM_XXH64_PRIME2;
+    state->lanes[1] = seed + __CHECKSUM_XXH64_PRIME2;
+    state->lanes[2] = seed;
+    state->lanes[3] = seed - __CHECKSUM_XXH64_PRIME1;
+    state->total_length = 0;
+    state->nr_buffered = 0;
+}
+
+/**
+ * @fn checksum_xxh64_update
+ * @brief Adds a WRAM buffer to an xxHash64 computation. An 8-byte aligned buffer is read by double words.
+ * @param state the state of the computation
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ */
+static inline void
+checksum_xxh64_update(struct checksum_xxh64 *state, const void *buffer, uint32_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)buffer, *end = bytes + length;
+
+    state->total_length += length;
+    if (state->nr_buffered + length < 32) {
+        memcpy((uint8_t *)state->buffer + state->nr_buffered, bytes, length);
+        state->nr_buffered += length;
+        return;
+    }
+    if (state->nr_buffered != 0) {
+        memcpy((uint8_t *)state->buffer + state->nr_buffered, bytes, 32 - state->nr_buffered);
+        __checksum_xxh64_stripe(state->lanes, state->buffer);
+        bytes += 32 - state->nr_buffered;
+    }
+    if (((uintptr_t)bytes & 7) == 0) {
+        for (; end - bytes >= 32; bytes += 32) {
+            __checksum_xxh64_stripe(state->lanes, (const uint64_t *)bytes);
+        }
+    } else {
+        for (; end - bytes >= 32; bytes += 32) {
+            memcpy(state->buffer, bytes, 32);
+            __checksum_xxh64_stripe(state->lanes, state->buffer);
+        }
+    }
+    state->nr_buffered = end - bytes;
+    memcpy(state->buffer, bytes, state->nr_buffered);
+}
+
+/**
+ * @fn checksum_xxh64_digest
+ * @brief Computes the xxHash64 of the buffers added to a computation, which can go on.
+ * @param state the state of the computation
+ * @return The xxHash64 of the buffers.
+ */
+static inline uint64_t
+checksum_xxh64_digest(const struct checksum_xxh64 *state)
+{
+    const uint8_t *bytes = (const uint8_t *)state->buffer;
+    uint32_t remaining = state->nr_buffered;
+    uint64_t hash;
+
+    if (state->total_length >= 32) {
+        hash = __checksum_rotl64(state->lanes[0], 1) + __checksum_rotl64(state->lanes[1], 7)
+            + __checksum_rotl64(state->lanes[2], 12) + __checksum_rotl64(state->lanes[3], 18);
+        for (uint32_t each_lane = 0; each_lane < 4; each_lane++) {
+            hash = __checksum_xxh64_merge(hash, state->lanes[each_lane]);
+        }
+    } else {
+        hash = state->lanes[2] + __CHECKSUM_XXH64_PRIME5;
+    }
+    hash += state->total_length;
+
+    for (; remaining >= 8; remaining -= 8, bytes += 8) {
+        hash ^= __checksum_xxh64_round(0, *(const uint64_t *)bytes);
+        hash = __checksum_mul64(__checksum_rotl64(hash, 27), __CHECKSUM_XXH64_PRIME1) + __CHECKSUM_XXH64_PRIME4;
+    }
+    if (remaining >= 4) {
+        hash ^= __checksum_mul64(*(const uint32_t *)bytes, __CHECKSUM_XXH64_PRIME1);
+        hash = __checksum_mul64(__checksum_rotl64(hash, 23), __CHECKSUM_XXH64_PRIME2) + __CHECKSUM_XXH64_PRIME3;
+        remaining -= 4;
+        bytes += 4;
+    }
+    for (; remaining != 0; remaining--, bytes++) {
+        hash ^= __checksum_mul64(*bytes, __CHECKSUM_XXH64_PRIME5);
+        hash = __checksum_mul64(__checksum_rotl64(hash, 11), __CHECKSUM_XXH64_PRIME1);
+    }
+
+    hash = __checksum_mul64(hash ^ (hash >> 33), __CHECKSUM_XXH64_PRIME2);
+    hash = __checksum_mul64(hash ^ (hash >> 29), __CHECKSUM_XXH64_PRIME3);
+    return hash ^ (hash >> 32);
+}
+
+/**
+ * @fn checksum_xxh64
+ * @brief Computes the xxHash64 of a WRAM buffer.
+ * @param buffer the buffer
+ * @param length the length of the buffer, in bytes
+ * @param seed the seed of the hash
+ * @return The xxHash64 of the buffer.
+ */
+static inline uint64_t
+checksum_xxh64(const void *buffer, uint32_t length, uint64_t seed)
+{
+    struct checksum_xxh64 state;
+
+    checksum_xxh64_reset(&state, seed);
+    checksum_xxh64_update(&state, buffer, length);
+    return checksum_xxh64_digest(&state);
+}
+
+/**
+ * @fn checksum_mram_crc32c
+ * @brief Computes the CRC32C of an MRAM area with all the tasklets.
+ *
+ * Must be called by all the tasklets, with the same arguments. The area may be read up to the next multiple of 8 bytes.
+ *
+ * @param c the state of the checksums
+ * @param data the area, 8-byte aligned in MRAM
+ * @param length the length of the area, in bytes
+ * @return The CRC32C of the area, identical to the CRC32C computed in sequence.
+ */
+static inline uint32_t
+checksum_mram_crc32c(struct checksum *c, const __mram_ptr void *data, uint32_t length)
+{
+    sysname_t id = me();
+    const __mram_ptr uint8_t *bytes = (const __mram_ptr uint8_t *)data;
+    uint8_t *block = c->blocks[id];
+    uint32_t from = (uint32_t)((uint64_t)length * id / __CHECKSUM_NR_TASKLETS) & ~7u;
+    uint32_t to = id == __CHECKSUM_NR_TASKLETS - 1 ? length
+                                                  : (uint32_t)((uint64_t)length * (id + 1) / __CHECKSUM_NR_TASKLETS) & ~7u;
+    uint32_t crc = 0;
+
+    for (uint32_t position = from; position < to; position += CHECKSUM_BLOCK_SIZE) {
+        uint32_t n = to - position < CHECKSUM_BLOCK_SIZE ? to - position : CHECKSUM_BLOCK_SIZE;
+        mram_read(&bytes[position], block, (n + 7) & ~7u);
+        crc = checksum_crc32c(crc, block, n);
+    }
+    c->partials[id] = __checksum_crc32c_shift(crc, length - to);
+    barrier_wait(c->barrier);
+
+    crc = 0;
+    for (uint32_t each_tasklet = 0; each_tasklet < __CHECKSUM_NR_TASKLETS; each_tasklet++) {
+        crc ^= (uint32_t)c->partials[each_tasklet];
+    }
+    barrier_wait(c->barrier);
+    return crc;
+}
+
+/**
+ * @fn checksum_mram_xxh64
+ * @brief Computes the chunked xxHash64 of an MRAM area with all the tasklets.
+ *
+ * The area is split into chunks of chunk_size bytes, the last one being shorter. The result is the xxHash64 of the
+ * little-endian xxHash64 of the chunks, all with the same seed. Must be called by all the tasklets, with the same
+ * arguments. The area may be read up to the next multiple of 8 bytes.
+ *
+ * @param c the state of the checksums
+ * @param data the area, 8-byte aligned in MRAM
+ * @param length the length of the area, in bytes
+ * @param chunk_size the size of the chunks, a non-zero multiple of 8 bytes
+ * @param seed the seed of the hashes
+ * @param digests receives the xxHash64 of each chunk, 8-byte aligned in MRAM
+ * @return The chunked xxHash64 of the area.
+ */
+static inline uint64_t
+checksum_mram_xxh64(struct checksum *c,
+    const __mram_ptr void *data,
+    uint32_t length,
+    uint32_t chunk_size,
+    uint64_t seed,
+    __mram_ptr uint64_t *digests)
+{
+    sysname_t id = me();
+    const __mram_ptr uint8_t *bytes = (const __mram_ptr uint8_t *)data;
+    uint8_t *block = c->blocks[id];
+    uint32_t nr_chunks = (uint32_t)(((uint64_t)length + chunk_size - 1) / chunk_size);
+    struct checksum_xxh64 state;
+    uint64_t hash;
+
+    for (uint32_t each_chunk = id; each_chunk < nr_chunks; each_chunk += __CHECKSUM_NR_TASKLETS) {
+        uint32_t from = each_chunk * chunk_size;
+        uint32_t to = length - from < chunk_size ? length : from + chunk_size;
+
+        checksum_xxh64_reset(&state, seed);
+        for (uint32_t position = from; position < to; position += CHECKSUM_BLOCK_SIZE) {
+            uint32_t n = to - position < CHECKSUM_BLOCK_SIZE ? to - position : CHECKSUM_BLOCK_SIZE;
+            mram_read(&bytes[position], block, (n + 7) & ~7u);
+            checksum_xxh64_update(&state, block, n);
+        }
+        c->partials[id] = checksum_xxh64_digest(&state);
+        mram_write(&c->partials[id], &digests[each_chunk], sizeof(uint64_t));
+    }
+    barrier_wait(c->barrier);
+
+    if (id == 0) {
+        checksum_xxh64_reset(&state, seed);
+        for (uint32_t first = 0; first < nr_chunks; first += CHECKSUM_BLOCK_SIZE / sizeof(uint64_t)) {
+            uint32_t n = nr_chunks - first < CHECKSUM_BLOCK_SIZE / sizeof(uint64_t) ? nr_chunks - first
+                                                                                     : CHECKSUM_BLOCK_SIZE / sizeof(uint64_t);
+            mram_read(&digests[first], block, n * sizeof(uint64_t));
+            checksum_xxh64_update(&state, block, n * sizeof(uint64_t));
+        }
+        c->partials[0] = checksum_xxh64_digest(&state);
+    }
+    barrier_wait(c->barrier);
+    hash = c->partials[0];
+    barrier_wait(c->barrier);
+    return hash;
+}
+
+#endif /* DPUSYSCORE_CHECKSUM_H */
@@ -0,0 +1,346 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_CHUNK_DISPENSER_H
+#define DPUSYSCORE_CHUNK_DISPENSER_H
+
+/**
+ * @file chunk_dispenser.h
+ * @brief Dynamic distribution of work chunks between tasklets (self-scheduling).
+ *
+ * A chunk dispenser hands out consecutive ranges [begin, end) of an index space to the tasklets asking for work.
+ * A tasklet that finishes its chunk early simply comes back for another one, which balances kernels whose per-element
+ * cost depends on the data, where the static me() * NR_ELEMENTS_PER_TASKLET split leaves a few tasklets finishing late.
+ *
+ * The shared cursor is protected by a single hardware mutex (one atomic bit), held for a handful of instructions.
+ *
+ * The size of the chunks is defined by the policy of the dispenser:
+ *  - CHUNK_DISPENSER_FIXED: every chunk holds min_chunk elements.
+ *  - CHUNK_DISPENSER_GUIDED: a chunk holds the remaining number of elements divided by twice the number of tasklets,
+ *    bounded by [min_chunk, max_chunk]. Chunks are large at the beginning and shrink towards the end of the work.
+ *  - CHUNK_DISPENSER_ADAPTIVE: guided, but each tasklet also doubles or halves its own chunk size so that one chunk
+ *    lasts about target_cycles, based on the duration of its previous chunk. The performance counter must be
+ *    configured to count cycles (see perfcounter_config).
+ *
+ * Chunk boundaries are always multiples of the granule of the dispenser (a power of 2 number of elements), so that the
+ * chunk of an array stored in MRAM can be transferred with mram_read/mram_write.
+ *
+ * When compiled with CHUNK_DISPENSER_ACCOUNTING defined, the dispenser records for each tasklet the number of cycles
+ * spent working on its chunks (busy) and the number of cycles spent in the dispenser or waiting for the last tasklet to
+ * run out of work (idle), using perfcounter_get. The performance counter must then be configured to count cycles.
+ *
+ * Typical usage:
+ *
+ *     CHUNK_DISPENSER_INIT(dispenser);
+ *     BARRIER_INIT(ready, NR_TASKLETS);
+ *
+ *     if (me() == 0)
+ *         chunk_dispenser_reset(&dispenser, nr_elements, CHUNK_DISPENSER_GUIDED, 64, 512, 2);
+ *     barrier_wait(&ready);
+ *     uint32_t begin, end;
+ *     while (chunk_dispenser_next(&dispenser, &begin, &end)) {
+ *         ... process elements [begin, end) ...
+ *     }
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <defs.h>
+#include <mutex.h>
+#include <perfcounter.h>
+#include <atomic_bit.h>
+#include <macro_utils.h>
+#include <dpu_characteristics.h>
+
+#ifdef NR_TASKLETS
+#define __CHUNK_DISPENSER_NR_TASKLETS NR_TASKLETS
+#else
+#define __CHUNK_DISPENSER_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/*
+ * The guided policy divides the remaining work by 2 * NR_TASKLETS, rounded up to a power of 2 so that it is a shift.
+ */
+#define __CHUNK_DISPENSER_GUIDED_SHIFT                                                                                           \
+    (__CHUNK_DISPENSER_NR_TASKLETS == 1 ? 1 : (33 - __builtin_clz(__CHUNK_DISPENSER_NR_TASKLETS - 1)))
+
+#ifndef CHUNK_DISPENSER_DEFAULT_TARGET_CYCLES
+/**
+ * @def CHUNK_DISPENSER_DEFAULT_TARGET_CYCLES
+ * @hideinitializer
+ * @brief Duration of a chunk targeted by the adaptive policy, unless changed with chunk_dispenser_set_target_cycles.
+ */
+#define CHUNK_DISPENSER_DEFAULT_TARGET_CYCLES 20000
+#endif
+
+/**
+ * @enum chunk_dispenser_policy_t
+ * @brief How the dispenser chooses the size of the chunks.
+ *
+ * @var CHUNK_DISPENSER_FIXED     chunks of min_chunk elements
+ * @var CHUNK_DISPENSER_GUIDED    chunks proportional to the remaining work
+ * @var CHUNK_DISPENSER_ADAPTIVE  guided, scaled per tasklet from the measured duration of its chunks
+ */
+typedef enum _chunk_dispenser_policy_t {
+    CHUNK_DISPENSER_FIXED = 0,
+    CHUNK_DISPENSER_GUIDED = 1,
+    CHUNK_DISPENSER_ADAPTIVE = 2,
+} chunk_dispenser_policy_t;
+
+/*
+ * Per tasklet state of a dispenser.
+ */
+struct __chunk_dispenser_tasklet {
+    perfcounter_t last;
+    uint32_t chunk;
+    uint32_t nr_chunks;
+#ifdef CHUNK_DISPENSER_ACCOUNTING
+    perfcounter_t busy;
+    perfcounter_t idle;
+    perfcounter_t done;
+#endif
+};
+
+/**
+ * @typedef chunk_dispenser_t
+ * @brief A chunk dispenser, as declared by CHUNK_DISPENSER_INIT.
+ */
+typedef struct chunk_dispenser {
+    volatile uint32_t cursor;
+    uint32_t end;
+    uint32_t min_chunk;
+    uint32_t max_chunk;
+    uint32_t granule_mask;
+    uint32_t target_cycles;
+    chunk_dispenser_policy_t policy;
+    mutex_id_t lock;
+    struct __chunk_dispenser_tasklet *tasklets;
+} chunk_dispenser_t;
+
+/**
+ * @typedef chunk_dispenser_stats_t
+ * @brief Cycle accounting of one tasklet, as returned by chunk_dispenser_get_stats.
+ */
+typedef struct chunk_dispenser_stats {
+    perfcounter_t busy;
+    perfcounter_t idle;
+    uint32_t nr_chunks;
+} chunk_dispenser_stats_t;
+
+/**
+ * @def CHUNK_DISPENSER_INIT
+ * @hideinitializer
+ * @brief Declare and initialize a chunk dispenser associated to the given name.
+ *
+ * The dispenser has no work until chunk_dispenser_reset is called.
+ */
+#define CHUNK_DISPENSER_INIT(_name)                                                                                              \
+    ATOMIC_BIT_INIT(__CONCAT(chunk_dispenser_, _name));                                                                          \
+    struct __chunk_dispenser_tasklet __CONCAT(__chunk_dispenser_tasklets_, _name)[DPU_NR_THREADS];                               \
+    chunk_dispenser_t _name = { .cursor = 0,                                                                                     \
+        .end = 0,                                                                                                                \
+        .min_chunk = 1,                                                                                                          \
+        .max_chunk = 1,                                                                                                          \
+        .granule_mask = 0,                                                                                                       \
+        .target_cycles = CHUNK_DISPENSER_DEFAULT_TARGET_CYCLES,                                                                  \
+        .policy = CHUNK_DISPENSER_FIXED,                                                                                         \
+        .lock = &ATOMIC_BIT_GET(__CONCAT(chunk_dispenser_, _name)),                                                              \
+        .tasklets = __CONCAT(__chunk_dispenser_tasklets_, _name) }
+
+/**
+ * @fn chunk_dispenser_reset
+ * @brief Prepares the dispenser to distribute the elements [0, nr_elements).
+ *
+ * Must be called by a single tasklet while no other tasklet uses the dispenser (typically before a barrier).
+ * The chunk bounds are rounded up to a multiple of the granule.
+ *
+ * @param d the dispenser
+ * @param nr_elements the number of elements to distribute
+ * @param policy how the size of the chunks is chosen
+ * @param min_chunk the size of the chunks with CHUNK_DISPENSER_FIXED, the smallest chunk size otherwise
+ * @param max_chunk the largest chunk size (ignored with CHUNK_DISPENSER_FIXED)
+ * @param granule chunk boundaries are multiples of this number of elements, which must be a power of 2
+ */
+static inline void
+chunk_dispenser_reset(chunk_dispenser_t *d,
+    uint32_t nr_elements,
+    chunk_dispenser_policy_t policy,
+    uint32_t min_chunk,
+    uint32_t max_chunk,
+    uint32_t granule)
+{
+    uint32_t mask = granule - 1;
+
+    min_chunk = (min_chunk + mask) & ~mask;
+    if (min_chunk == 0) {
+        min_chunk = mask + 1;
+    }
+    max_chunk = (max_chunk + mask) & ~mask;
+    if (max_chunk < min_chunk) {
+        max_chunk = min_chunk;
+    }
+
+    d->cursor = 0;
+    d->end = nr_elements;
+    d->min_chunk = min_chunk;
+    d->max_chunk = max_chunk;
+    d->granule_mask = mask;
+    d->policy = policy;
+
+    for (unsigned int each_tasklet = 0; each_tasklet < DPU_NR_THREADS; each_tasklet++) {
+        struct __chunk_dispenser_tasklet *t = &d->tasklets[each_tasklet];
+        t->last = 0;
+        t->chunk = min_chunk;
+        t->nr_chunks = 0;
+#ifdef CHUNK_DISPENSER_ACCOUNTING
+        t->busy = 0;
+        t->idle = 0;
+        t->done = 0;
+#endif
+    }
+}
+
+/**
+ * @fn chunk_dispenser_set_target_cycles
+ * @brief Sets the duration of a chunk targeted by the CHUNK_DISPENSER_ADAPTIVE policy.
+ * @param d the dispenser
+ * @param target_cycles the expected number of cycles to process one chunk
+ */
+static inline void
+chunk_dispenser_set_target_cycles(chunk_dispenser_t *d, uint32_t target_cycles)
+{
+    d->target_cycles = target_cycles;
+}
+
+/*
+ * Size of the next chunk for the given tasklet, not yet bounded by the remaining work.
+ * The cursor is read without the lock: it only sizes the request, the range itself is taken under the lock.
+ */
+static inline uint32_t
+__chunk_dispenser_size(chunk_dispenser_t *d, struct __chunk_dispenser_tasklet *t, perfcounter_t now)
+{
+    uint32_t size;
+
+    if (d->policy == CHUNK_DISPENSER_FIXED) {
+        return d->min_chunk;
+    }
+
+    size = (d->end - d->cursor) >> __CHUNK_DISPENSER_GUIDED_SHIFT;
+
+    if (d->policy == CHUNK_DISPENSER_ADAPTIVE) {
+        if (t->nr_chunks != 0) {
+            uint32_t elapsed = (uint32_t)(now - t->last);
+            if ((elapsed << 1) < d->target_cycles && t->chunk < d->max_chunk) {
+                t->chunk <<= 1;
+            } else if (elapsed > (d->target_cycles << 1) && t->chunk > d->min_chunk) {
+                t->chunk >>= 1;
+            }
+        }
+        if (t->chunk < size) {
+            size = t->chunk;
+        }
+    }
+
+    size = (size + d->granule_mask) & ~d->granule_mask;
+    if (size < d->min_chunk) {
+        return d->min_chunk;
+    }
+    if (size > d->max_chunk) {
+        return d->max_chunk;
+    }
+    return size;
+}
+
+/**
+ * @fn chunk_dispenser_next
+ * @brief Takes the next chunk of work for the invoking tasklet.
+ *
+ * @param d the dispenser
+ * @param begin (output) the index of the first element of the chunk
+ * @param end (output) the index following the last element of the chunk
+ * @return Whether a chunk was available. When false, all the elements have been distributed.
+ */
+static inline bool
+chunk_dispenser_next(chunk_dispenser_t *d, uint32_t *begin, uint32_t *end)
+{
+    struct __chunk_dispenser_tasklet *t = &d->tasklets[me()];
+    perfcounter_t now = 0;
+    uint32_t size, first, last;
+
+#ifdef CHUNK_DISPENSER_ACCOUNTING
+    now = perfcounter_get();
+    if (t->nr_chunks != 0) {
+        t->busy += now - t->last;
+    }
+#else
+    if (d->policy == CHUNK_DISPENSER_ADAPTIVE) {
+        now = perfcounter_get();
+    }
+#endif
+
+    size = __chunk_dispenser_size(d, t, now);
+
+    mutex_lock(d->lock);
+    first = d->cursor;
+    last = first + size;
+    if (last > d->end || last < first) {
+        last = d->end;
+    }
+    d->cursor = last;
+    mutex_unlock(d->lock);
+
+    if (first >= last) {
+#ifdef CHUNK_DISPENSER_ACCOUNTING
+        t->done = perfcounter_get();
+        t->idle += t->done - now;
+#endif
+        return false;
+    }
+
+    *begin = first;
+    *end = last;
+    t->nr_chunks++;
+#if defined(CHUNK_DISPENSER_ACCOUNTING)
+    t->last = perfcounter_get();
+    t->idle += t->last - now;
+#else
+    if (d->policy == CHUNK_DISPENSER_ADAPTIVE) {
+        t->last = now;
+    }
+#endif
+    return true;
+}
+
+#ifdef CHUNK_DISPENSER_ACCOUNTING
+/**
+ * @fn chunk_dispenser_get_stats
+ * @brief Fetches the cycle accounting of a tasklet.
+ *
+ * Must be called once every tasklet using the dispenser got false from chunk_dispenser_next (typically after a
+ * barrier). The idle cycles include the time spent in the dispenser and the time between the moment the tasklet ran out
+ * of work and the moment the last tasklet did.
+ *
+ * @param d the dispenser
+ * @param tasklet the tasklet to report
+ * @param stats (output) the cycle accounting of the tasklet
+ */
+static inline void
+chunk_dispenser_get_stats(chunk_dispenser_t *d, sysname_t tasklet, chunk_dispenser_stats_t *stats)
+{
+    perfcounter_t last_done = 0;
+
+    for (unsigned int each_tasklet = 0; each_tasklet < __CHUNK_DISPENSER_NR_TASKLETS; each_tasklet++) {
+        if (d->tasklets[each_tasklet].done > last_done) {
+            last_done = d->tasklets[each_tasklet].done;
+        }
+    }
+
+    stats->busy = d->tasklets[tasklet].busy;
+    stats->idle = d->tasklets[tasklet].idle + (last_done - d->tasklets[tasklet].done);
+    stats->nr_chunks = d->tasklets[tasklet].nr_chunks;
+}
+#endif /* CHUNK_DISPENSER_ACCOUNTING */
+
+#endif /* DPUSYSCORE_CHUNK_DISPENSER_H */
@@ -0,0 +1,325 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_DIVISOR_H
+#define DPUSYSCORE_DIVISOR_H
+
+/**
+ * @file divisor.h
+ * @brief Division and modulo by a divisor known in advance, with a multiplication instead of the division routines.
+ *
+ * The DPU has no division instruction: n / d and n % d call a routine computing one bit of the quotient per div_step, 32
+ * steps for 32-bit integers, and a much longer routine for 64-bit integers. When the same divisor is used many times, as
+ * the number of buckets or partitions of a hash table, the quotient is computed instead as the high half of the product
+ * of n by a precomputed magic number, shifted right:
+ *     n / d = (n * magic + increment * magic) / 2^(N + shift)
+ * for N-bit integers, with shift = floor(log2(d)). The magic number is the N-bit rounding up of 2^(N + shift) / d, or
+ * its rounding down with an increment when the rounding up is not exact for all n. The products are computed from the
+ * 8x8-bit multiplications of the DPU. The remainder is n - (n / d) * d, computed on the bits of the divisor only.
+ *
+ * A divisor is prepared in a struct divisor_u32 or struct divisor_u64:
+ *  - by DIVISOR_U32_INIT or DIVISOR_U64_INIT for a constant, when the program is compiled,
+ *  - by the host (see dpu_divisor.h), which sends the structure into a __host variable,
+ *  - or by divisor_u32_init or divisor_u64_init, which divide once.
+ *
+ * The division uses no WRAM besides the 16-byte or 24-byte structure of the divisor.
+ */
+
+#include <stdint.h>
+#include <built_ins.h>
+
+/**
+ * @struct divisor_u32
+ * @brief A 32-bit divisor prepared for divisor_u32_divide and divisor_u32_modulo.
+ */
+struct divisor_u32 {
+    uint32_t magic;
+    uint32_t increment;
+    uint32_t shift;
+    uint32_t divisor;
+};
+
+/**
+ * @struct divisor_u64
+ * @brief A 64-bit divisor prepared for divisor_u64_divide and divisor_u64_modulo.
+ */
+struct divisor_u64 {
+    uint64_t magic;
+    uint64_t divisor;
+    uint32_t increment;
+    uint32_t shift;
+};
+
+#define __DIVISOR_LOG2(D) (31 - __builtin_clz((uint32_t)(D)))
+#define __DIVISOR_IS_POWER_OF_2(D) (((D) & ((D)-1)) == 0)
+
+/* floor(2^(32 + shift) / d), and the error d - 2^(32 + shift) % d of its rounding up. */
+#define __DIVISOR_U32_FLOOR(D) ((uint32_t)((1ull << (32 + __DIVISOR_LOG2(D))) / (D)))
+#define __DIVISOR_U32_ERROR(D) ((D) - (uint32_t)((1ull << (32 + __DIVISOR_LOG2(D))) % (D)))
+#define __DIVISOR_U32_INCREMENT(D) (__DIVISOR_IS_POWER_OF_2(D) || __DIVISOR_U32_ERROR(D) > (1u << __DIVISOR_LOG2(D)))
+#define __DIVISOR_U32_MAGIC(D)                                                                                                   \
+    (__DIVISOR_IS_POWER_OF_2(D) ? 0xffffffffu : __DIVISOR_U32_FLOOR(D) + !__DIVISOR_U32_INCREMENT(D))
+
+/* floor(2^(64 + shift) / d) for d < 2^32, as two 32-bit digits of a long division, and the error of its rounding up. */
+#define __DIVISOR_U64_HIGH(D) ((1ull << (32 + __DIVISOR_LOG2(D))) / (D))
+#define __DIVISOR_U64_REMAINDER(D) ((1ull << (32 + __DIVISOR_LOG2(D))) % (D))
+#define __DIVISOR_U64_FLOOR(D) ((__DIVISOR_U64_HIGH(D) << 32) + (__DIVISOR_U64_REMAINDER(D) << 32) / (D))
+#define __DIVISOR_U64_ERROR(D) ((D) - (__DIVISOR_U64_REMAINDER(D) << 32) % (D))
+#define __DIVISOR_U64_INCREMENT(D) (__DIVISOR_IS_POWER_OF_2(D) || __DIVISOR_U64_ERROR(D) > (1ull << __DIVISOR_LOG2(D)))
+#define __DIVISOR_U64_MAGIC(D)                                                                                                   \
+    (__DIVISOR_IS_POWER_OF_2(D) ? 0xffffffffffffffffull : __DIVISOR_U64_FLOOR(D) + !__DIVISOR_U64_INCREMENT(D))
+
+/**
+ * @def DIVISOR_U32_INIT
+ * @hideinitializer
+ * @brief Declares a constant 32-bit divisor, prepared when the program is compiled.
+ * @param NAME the name of the struct divisor_u32
+ * @param D the divisor, a constant from 1 to 2^32 - 1
+ */
+#define DIVISOR_U32_INIT(NAME, D)                                                                                                \
+    _Static_assert((D) >= 1 && (D) <= 0xffffffffull, "divisor error: invalid divisor defined");                                  \
+    const struct divisor_u32 NAME = { .magic = __DIVISOR_U32_MAGIC(D),                                                           \
+        .increment = __DIVISOR_U32_INCREMENT(D),                                                                                 \
+        .shift = __DIVISOR_LOG2(D),                                                                                              \
+        .divisor = (D) }
+
+/**
+ * @def DIVISOR_U64_INIT
+ * @hideinitializer
+ * @brief Declares a constant 64-bit divisor, prepared when the program is compiled.
+ *
+ * Divisors from 2^32 are prepared by divisor_u64_init or by the host.
+ *
+ * @param NAME the name of the struct divisor_u64
+ * @param D the divisor, a constant from 1 to 2^32 - 1
+ */
+#define DIVISOR_U64_INIT(NAME, D)                                                                                                \
+    _Static_assert((D) >= 1 && (D) <= 0xffffffffull, "divisor error: invalid divisor defined");                                  \
+    const struct divisor_u64 NAME = { .magic = __DIVISOR_U64_MAGIC(D),                                                           \
+        .divisor = (D),                                                                                                          \
+        .increment = __DIVISOR_U64_INCREMENT(D),                                                                                 \
+        .shift = __DIVISOR_LOG2(D) }
+
+/* The 32-bit product of two unsigned 16-bit integers, from the products of their bytes. */
+static inline uint32_t
+__divisor_mul_u16(uint32_t a, uint32_t b)
+{
+    uint32_t ll, lh, hl, hh;
+
+    __builtin_mul_ul_ul_rrr(ll, a, b);
+    __builtin_mul_ul_uh_rrr(lh, a, b);
+    __builtin_mul_uh_ul_rrr(hl, a, b);
+    __builtin_mul_uh_uh_rrr(hh, a, b);
+    return ll + ((lh + hl) << 8) + (hh << 16);
+}
+
+/* The 64-bit product of two unsigned 32-bit integers. */
+static inline uint64_t
+__divisor_mul_u32(uint32_t a, uint32_t b)
+{
+    uint32_t low = __divisor_mul_u16(a & 0xffff, b & 0xffff), high = __divisor_mul_u16(a >> 16, b >> 16);
+    uint64_t middle = (uint64_t)__divisor_mul_u16(a & 0xffff, b >> 16) + __divisor_mul_u16(a >> 16, b & 0xffff);
+
+    return ((uint64_t)high << 32) + (middle << 16) + low;
+}
+
+/* The low 32 bits of the product of two unsigned 32-bit integers. */
+static inline uint32_t
+__divisor_mul_low_u32(uint32_t a, uint32_t b)
+{
+    return __divisor_mul_u16(a & 0xffff, b & 0xffff)
+        + ((__divisor_mul_u16(a & 0xffff, b >> 16) + __divisor_mul_u16(a >> 16, b & 0xffff)) << 16);
+}
+
+/* floor(2^(64 + shift) / divisor) and the remainder, by a long division of one bit per step, for 2^shift < divisor. */
+static inline uint64_t
+__divisor_u64_floor(uint64_t divisor, uint32_t shift, uint64_t *remainder)
+{
+    uint64_t quotient = 0, rest = 1ull << shift;
+
+    for (uint32_t each_bit = 0; each_bit < 64; each_bit++) {
+        uint64_t carry = rest >> 63;
+        rest <<= 1;
+        quotient <<= 1;
+        if (carry != 0 || rest >= divisor) {
+            rest -= divisor;
+            quotient |= 1;
+        }
+    }
+    *remainder = rest;
+    return quotient;
+}
+
+/**
+ * @fn divisor_u32_init
+ * @brief Prepares a 32-bit divisor known when the program runs, with a 64-bit division.
+ * @param d receives the prepared divisor
+ * @param divisor the divisor, not 0
+ */
+static inline void
+divisor_u32_init(struct divisor_u32 *d, uint32_t divisor)
+{
+    uint32_t shift = 31 - __builtin_clz(divisor);
+    uint64_t power = 1ull << (32 + shift);
+    uint32_t floor = (uint32_t)(power / divisor), error = divisor - (uint32_t)(power % divisor);
+
+    d->divisor = divisor;
+    d->shift = shift;
+    if ((divisor & (divisor - 1)) == 0) {
+        d->magic = 0xffffffffu;
+        d->increment = 1;
+    } else {
+        d->increment = error > (1u << shift);
+        d->magic = d->increment ? floor : floor + 1;
+    }
+}
+
+/**
+ * @fn divisor_u64_init
+ * @brief Prepares a 64-bit divisor known when the program runs, with a long division of 64 steps.
+ * @param d receives the prepared divisor
+ * @param divisor the divisor, not 0
+ */
+static inline void
+divisor_u64_init(struct divisor_u64 *d, uint64_t divisor)
+{
+    uint32_t shift = 63 - __builtin_clzll(divisor);
+
+    d->divisor = divisor;
+    d->shift = shift;
+    if ((divisor & (divisor - 1)) == 0) {
+        d->magic = 0xffffffffffffffffull;
+        d->increment = 1;
+    } else {
+        uint64_t remainder, floor = __divisor_u64_floor(divisor, shift, &remainder);
+        d->increment = divisor - remainder > (1ull << shift);
+        d->magic = d->increment ? floor : floor + 1;
+    }
+}
+
+/**
+ * @fn divisor_u32_divide
+ * @brief The quotient of a 32-bit integer by a prepared divisor, with 16 8x8-bit multiplications.
+ * @param d the divisor
+ * @param n the dividend
+ * @return n / d.
+ */
+static inline uint32_t
+divisor_u32_divide(const struct divisor_u32 *d, uint32_t n)
+{
+    uint64_t product = __divisor_mul_u32(n, d->magic) + (d->increment ? d->magic : 0);
+
+    return (uint32_t)(product >> 32) >> d->shift;
+}
+
+/* The remainder n - quotient * d, computed on 16 bits when the divisor is below 2^16, and from a quotient below 2^16
+ * otherwise. */
+static inline uint32_t
+__divisor_u32_remainder(const struct divisor_u32 *d, uint32_t n, uint32_t quotient)
+{
+    uint32_t divisor = d->divisor;
+
+    if (divisor <= 0xffff) {
+        return (n - __divisor_mul_u16(quotient & 0xffff, divisor)) & 0xffff;
+    }
+    return n - __divisor_mul_u16(quotient, divisor & 0xffff) - (__divisor_mul_u16(quotient, divisor >> 16) << 16);
+}
+
+/**
+ * @fn divisor_u32_modulo
+ * @brief The remainder of a 32-bit integer by a prepared divisor.
+ * @param d the divisor
+ * @param n the dividend
+ * @return n % d.
+ */
+static inline uint32_t
+divisor_u32_modulo(const struct divisor_u32 *d, uint32_t n)
+{
+    return __divisor_u32_remainder(d, n, divisor_u32_divide(d, n));
+}
+
+/**
+ * @fn divisor_u32_divmod
+ * @brief The quotient and the remainder of a 32-bit integer by a prepared divisor.
+ * @param d the divisor
+ * @param n the dividend
+ * @param remainder receives n % d
+ * @return n / d.
+ */
+static inline uint32_t
+divisor_u32_divmod(const struct divisor_u32 *d, uint32_t n, uint32_t *remainder)
+{
+    uint32_t quotient = divisor_u32_divide(d, n);
+
+    *remainder = __divisor_u32_remainder(d, n, quotient);
+    return quotient;
+}
+
+/**
+ * @fn divisor_u64_divide
+ * @brief The quotient of a 64-bit integer by a prepared divisor, with 64 8x8-bit multiplications.
+ * @param d the divisor
+ * @param n the dividend
+ * @return n / d.
+ */
+static inline uint64_t
+divisor_u64_divide(const struct divisor_u64 *d, uint64_t n)
+{
+    uint32_t n_low = (uint32_t)n, n_high = (uint32_t)(n >> 32);
+    uint32_t magic_low = (uint32_t)d->magic, magic_high = (uint32_t)(d->magic >> 32);
+    uint64_t low = __divisor_mul_u32(n_low, magic_low), high = __divisor_mul_u32(n_high, magic_high);
+    uint64_t cross_low = __divisor_mul_u32(n_low, magic_high), cross_high = __divisor_mul_u32(n_high, magic_low);
+    /* The bits 32 to 63 of n * magic + increment * magic, with their carry. */
+    uint64_t carry = d->increment ? (((uint64_t)(uint32_t)low + magic_low) >> 32) + magic_high : 0;
+    uint64_t middle = (low >> 32) + (uint32_t)cross_low + (uint32_t)cross_high + carry;
+
+    return (high + (cross_low >> 32) + (cross_high >> 32) + (middle >> 32)) >> d->shift;
+}
+
+/* The remainder n - quotient * d, computed on 32 bits when the divisor is below 2^32, and from a quotient below 2^32
+ * otherwise. */
+static inline uint64_t
+__divisor_u64_remainder(const struct divisor_u64 *d, uint64_t n, uint64_t quotient)
+{
+    uint32_t divisor_low = (uint32_t)d->divisor, divisor_high = (uint32_t)(d->divisor >> 32);
+
+    if (divisor_high == 0) {
+        return (uint32_t)n - __divisor_mul_low_u32((uint32_t)quotient, divisor_low);
+    }
+    return n - __divisor_mul_u32((uint32_t)quotient, divisor_low)
+        - ((uint64_t)__divisor_mul_low_u32((uint32_t)quotient, divisor_high) << 32);
+}
+
+/**
+ * @fn divisor_u64_modulo
+ * @brief The remainder of a 64-bit integer by a prepared divisor.
+ * @param d the divisor
+ * @param n the dividend
+ * @return n % d.
+ */
+static inline uint64_t
+divisor_u64_modulo(const struct divisor_u64 *d, uint64_t n)
+{
+    return __divisor_u64_remainder(d, n, divisor_u64_divide(d, n));
+}
+
+/**
+ * @fn divisor_u64_divmod
+ * @brief The quotient and the remainder of a 64-bit integer by a prepared divisor.
+ * @param d the divisor
+ * @param n the dividend
+ * @param remainder receives n % d
+ * @return n / d.
+ */
+static inline uint64_t
+divisor_u64_divmod(const struct divisor_u64 *d, uint64_t n, uint64_t *remainder)
+{
+    uint64_t quotient = divisor_u64_divide(d, n);
+
+    *remainder = __divisor_u64_remainder(d, n, quotient);
+    return quotient;
+}
+
+#endif /* DPUSYSCORE_DIVISOR_H */
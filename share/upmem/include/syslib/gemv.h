@@ -0,0 +1,246 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_GEMV_H
+#define DPUSYSCORE_GEMV_H
+
+/**
+ * @file gemv.h
+ * @brief Products of a row-major MRAM matrix with a few vectors stored in WRAM (GEMV, and GEMM with a small N).
+ *
+ * The elements of the matrix and of the vectors are 8-bit, 16-bit or 32-bit signed integers. Each row of the matrix, and
+ * each vector, is padded with zeros to a multiple of 8 bytes: the row size. The vectors are stored one after the other
+ * in WRAM, typically in a __host array written with dpu_broadcast_to.
+ *
+ * The rows are split between the tasklets. Each tasklet streams its rows through WRAM by blocks of GEMV_BLOCK_SIZE bytes,
+ * and multiplies each block with the matching part of all the vectors, so that the matrix is read once whatever the number
+ * of vectors. The products are accumulated on 64 bits, wrapping around on overflow, then shifted right by the number of
+ * fractional bits of fixed-point operands (0 for integers), rounded to nearest, and truncated to 32 bits.
+ *
+ * The DPU multiplies 8-bit operands in one instruction, while a 32-bit multiplication takes many. The 8-bit elements are
+ * multiplied with mul_sl_sl and mul_sh_sh, 4 elements per word. The 16-bit elements are multiplied from their bytes: the
+ * signed high bytes with mul_sh_sh and mul_sh_ul, the unsigned low bytes with mul_ul_ul. Only the 32-bit elements use
+ * the generic multiplication.
+ *
+ * The WRAM used by each tasklet is GEMV_BLOCK_SIZE + GEMV_MAX_VECTORS * GEMV_OUTPUT_ROWS * 4 bytes: 768 bytes with the
+ * default parameters.
+ */
+
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <built_ins.h>
+#include <dpu_characteristics.h>
+
+#ifndef GEMV_MAX_VECTORS
+/**
+ * @def GEMV_MAX_VECTORS
+ * @hideinitializer
+ * @brief Maximum number of vectors multiplied at once.
+ */
+#define GEMV_MAX_VECTORS 4
+#endif
+
+#ifndef GEMV_BLOCK_SIZE
+/**
+ * @def GEMV_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Size of the DMAs reading the rows of the matrix, in bytes.
+ */
+#define GEMV_BLOCK_SIZE 512
+#endif
+
+#ifndef GEMV_OUTPUT_ROWS
+/**
+ * @def GEMV_OUTPUT_ROWS
+ * @hideinitializer
+ * @brief Number of results of each vector written at once.
+ */
+#define GEMV_OUTPUT_ROWS 16
+#endif
+
+_Static_assert(GEMV_MAX_VECTORS > 0, "gemv error: invalid number of vectors defined");
+_Static_assert((GEMV_BLOCK_SIZE & 7) == 0 && GEMV_BLOCK_SIZE <= 2048, "gemv error: invalid block size defined");
+_Static_assert((GEMV_OUTPUT_ROWS & 1) == 0 && GEMV_OUTPUT_ROWS <= 512, "gemv error: invalid number of output rows defined");
+
+#ifdef NR_TASKLETS
+#define __GEMV_NR_TASKLETS NR_TASKLETS
+#else
+#define __GEMV_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @brief The type of the elements of the matrix and of the vectors.
+ */
+typedef enum _gemv_type_t {
+    GEMV_INT8 = 0,
+    GEMV_INT16 = 1,
+    GEMV_INT32 = 2,
+} gemv_type_t;
+
+/**
+ * @def GEMV_ROW_SIZE
+ * @hideinitializer
+ * @brief The size of a row of nr_columns elements of the given type, in bytes, padded to 8 bytes.
+ */
+#define GEMV_ROW_SIZE(type, nr_columns) ((((uint32_t)(nr_columns) << (type)) + 7) & ~7)
+
+/**
+ * @struct gemv
+ * @brief The state of the products, as declared by GEMV_INIT.
+ */
+struct gemv {
+    uint8_t (*blocks)[GEMV_BLOCK_SIZE];
+    int32_t (*outputs)[GEMV_MAX_VECTORS][GEMV_OUTPUT_ROWS];
+};
+
+/**
+ * @def GEMV_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the products.
+ */
+#define GEMV_INIT(NAME)                                                                                                          \
+    __dma_aligned uint8_t gemv_blocks_##NAME[__GEMV_NR_TASKLETS][GEMV_BLOCK_SIZE];                                               \
+    __dma_aligned int32_t gemv_outputs_##NAME[__GEMV_NR_TASKLETS][GEMV_MAX_VECTORS][GEMV_OUTPUT_ROWS];                           \
+    struct gemv NAME = { .blocks = gemv_blocks_##NAME, .outputs = gemv_outputs_##NAME };
+
+/* The dot product of the 4 int8 of two words. */
+static inline int32_t
+__gemv_dot4_int8(uint32_t a, uint32_t b)
+{
+    int32_t p0, p1, p2, p3;
+
+    __builtin_mul_sl_sl_rrr(p0, a, b);
+    __builtin_mul_sh_sh_rrr(p1, a, b);
+    a >>= 16;
+    b >>= 16;
+    __builtin_mul_sl_sl_rrr(p2, a, b);
+    __builtin_mul_sh_sh_rrr(p3, a, b);
+    return (p0 + p1) + (p2 + p3);
+}
+
+/* The product of the int16 in the low half of two words: (ah.2^8 + al)(bh.2^8 + bl), with signed high bytes and unsigned
+ * low bytes. */
+static inline int32_t
+__gemv_mul_int16(uint32_t a, uint32_t b)
+{
+    int32_t high, middle_a, middle_b;
+    uint32_t low;
+
+    __builtin_mul_sh_sh_rrr(high, a, b);
+    __builtin_mul_sh_ul_rrr(middle_a, a, b);
+    __builtin_mul_sh_ul_rrr(middle_b, b, a);
+    __builtin_mul_ul_ul_rrr(low, a, b);
+    return (int32_t)((uint32_t)high << 16) + (int32_t)((uint32_t)(middle_a + middle_b) << 8) + (int32_t)low;
+}
+
+/* Accumulates the products of a block of a row with the matching blocks of the vectors. */
+static inline void
+__gemv_block(gemv_type_t type,
+    const uint8_t *block,
+    uint32_t size,
+    const uint8_t *vectors,
+    uint32_t row_size,
+    uint32_t nr_vectors,
+    uint64_t *sums)
+{
+    for (uint32_t each_vector = 0; each_vector < nr_vectors; each_vector++) {
+        const uint8_t *vector = vectors + each_vector * row_size;
+        uint64_t sum = 0;
+
+        if (type == GEMV_INT8) {
+            const uint32_t *a = (const uint32_t *)block, *b = (const uint32_t *)vector;
+            int32_t partial = 0;
+            for (uint32_t each_word = 0; each_word < size / 4; each_word++) {
+                partial += __gemv_dot4_int8(a[each_word], b[each_word]);
+            }
+            sum = (uint64_t)(int64_t)partial;
+        } else if (type == GEMV_INT16) {
+            const uint32_t *a = (const uint32_t *)block, *b = (const uint32_t *)vector;
+            for (uint32_t each_word = 0; each_word < size / 4; each_word++) {
+                sum += __gemv_mul_int16(a[each_word], b[each_word]);
+                sum += __gemv_mul_int16(a[each_word] >> 16, b[each_word] >> 16);
+            }
+        } else {
+            const int32_t *a = (const int32_t *)block, *b = (const int32_t *)vector;
+            for (uint32_t each_element = 0; each_element < size / 4; each_element++) {
+                sum += (uint64_t)((int64_t)a[each_element] * b[each_element]);
+            }
+        }
+        sums[each_vector] += sum;
+    }
+}
+
+/**
+ * @fn gemv_multiply
+ * @brief Multiplies an MRAM matrix with vectors in WRAM: output[v][r] = sum over c of matrix[r][c] * vectors[v][c].
+ *
+ * Must be called by all the tasklets, with the same arguments. The results are complete when all the tasklets returned.
+ *
+ * @param g the state of the products
+ * @param type the type of the elements of the matrix and of the vectors
+ * @param matrix the rows of the matrix, each of GEMV_ROW_SIZE(type, nr_columns) bytes padded with zeros, 8-byte aligned
+ * in MRAM
+ * @param nr_rows the number of rows of the matrix
+ * @param nr_columns the number of columns of the matrix, and of elements of the vectors
+ * @param vectors the vectors, each of GEMV_ROW_SIZE(type, nr_columns) bytes padded with zeros, 8-byte aligned in WRAM
+ * @param nr_vectors the number of vectors, at most GEMV_MAX_VECTORS
+ * @param shift the number of fractional bits of the products, 0 for integers
+ * @param output receives the results of vector v from output[v * stride], where stride is nr_rows rounded up to an even
+ * number, 8-byte aligned in MRAM
+ */
+static inline void
+gemv_multiply(struct gemv *g,
+    gemv_type_t type,
+    const __mram_ptr void *matrix,
+    uint32_t nr_rows,
+    uint32_t nr_columns,
+    const void *vectors,
+    uint32_t nr_vectors,
+    uint32_t shift,
+    __mram_ptr int32_t *output)
+{
+    sysname_t id = me();
+    uint8_t *block = g->blocks[id];
+    int32_t (*results)[GEMV_OUTPUT_ROWS] = g->outputs[id];
+    uint32_t row_size = GEMV_ROW_SIZE(type, nr_columns);
+    uint32_t stride = (nr_rows + 1) & ~1;
+    uint32_t per_tasklet = (((nr_rows + __GEMV_NR_TASKLETS - 1) / __GEMV_NR_TASKLETS) + 1) & ~1;
+    uint32_t from = id * per_tasklet;
+    uint32_t to = from + per_tasklet;
+    uint64_t rounding = shift == 0 ? 0 : (uint64_t)1 << (shift - 1);
+
+    if (to > nr_rows) {
+        to = nr_rows;
+    }
+    if (from > to) {
+        from = to;
+    }
+
+    for (uint32_t first_row = from; first_row < to; first_row += GEMV_OUTPUT_ROWS) {
+        uint32_t n = to - first_row < GEMV_OUTPUT_ROWS ? to - first_row : GEMV_OUTPUT_ROWS;
+
+        for (uint32_t each_row = 0; each_row < n; each_row++) {
+            const __mram_ptr uint8_t *row = (const __mram_ptr uint8_t *)matrix + (first_row + each_row) * row_size;
+            uint64_t sums[GEMV_MAX_VECTORS] = { 0 };
+
+            for (uint32_t offset = 0; offset < row_size; offset += GEMV_BLOCK_SIZE) {
+                uint32_t size = row_size - offset < GEMV_BLOCK_SIZE ? row_size - offset : GEMV_BLOCK_SIZE;
+                mram_read(row + offset, block, size);
+                __gemv_block(type, block, size, (const uint8_t *)vectors + offset, row_size, nr_vectors, sums);
+            }
+            for (uint32_t each_vector = 0; each_vector < nr_vectors; each_vector++) {
+                results[each_vector][each_row] = (int32_t)((int64_t)(sums[each_vector] + rounding) >> shift);
+            }
+        }
+
+        /* The slices of the tasklets start on even rows: the results of a vector are written with 8-byte DMAs. */
+        for (uint32_t each_vector = 0; each_vector < nr_vectors; each_vector++) {
+            mram_write(results[each_vector], &output[each_vector * stride + first_row], ((n + 1) & ~1) * sizeof(int32_t));
+        }
+    }
+}
+
+#endif /* DPUSYSCORE_GEMV_H */
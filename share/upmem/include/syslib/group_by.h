@@ -0,0 +1,345 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_GROUP_BY_H
+#define DPUSYSCORE_GROUP_BY_H
+
+/**
+ * @file group_by.h
+ * @brief Aggregation of MRAM rows by key (GROUP BY key: COUNT, SUM, MIN, MAX), split between all the tasklets.
+ *
+ * Each tasklet aggregates its slice of the rows in a small WRAM hash table of GROUP_BY_WRAM_ENTRIES partial aggregates.
+ * When a key finds no room in the table after GROUP_BY_WRAM_PROBES probes, the aggregate in the home slot of the key is
+ * spilled: it is merged into a hash table of aggregates shared by all the tasklets in MRAM, and its slot is given to
+ * the new key. With few groups, the rows are aggregated in WRAM and the MRAM table is only touched at the end. With more
+ * groups than the WRAM tables can hold, most rows end up spilled, and the cost becomes that of the MRAM table.
+ *
+ * When all the rows are aggregated, the tasklets merge their WRAM tables into the MRAM table, and after a barrier copy
+ * the groups of the MRAM table to a dense array, in no particular order. The host reads this array back, and merges the
+ * groups of all the DPUs (see dpu_group_by.h).
+ *
+ * The WRAM used by each tasklet is GROUP_BY_WRAM_ENTRIES * 24 + GROUP_BY_BLOCK_ROWS * 8 + 24 bytes: 1.8 KB with the
+ * default parameters.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_hash.h>
+#include <mram_string.h>
+#include <barrier.h>
+#include <mutex.h>
+#include <mutex_pool.h>
+#include <dpu_characteristics.h>
+
+#ifndef GROUP_BY_WRAM_ENTRIES
+/**
+ * @def GROUP_BY_WRAM_ENTRIES
+ * @hideinitializer
+ * @brief Number of partial aggregates held in WRAM by each tasklet.
+ */
+#define GROUP_BY_WRAM_ENTRIES 32
+#endif
+
+#ifndef GROUP_BY_WRAM_PROBES
+/**
+ * @def GROUP_BY_WRAM_PROBES
+ * @hideinitializer
+ * @brief Number of slots of the WRAM table looked at for a key before spilling an aggregate to MRAM.
+ */
+#define GROUP_BY_WRAM_PROBES 4
+#endif
+
+#ifndef GROUP_BY_BLOCK_ROWS
+/**
+ * @def GROUP_BY_BLOCK_ROWS
+ * @hideinitializer
+ * @brief Number of rows read at once, which sets the size of the DMAs reading the keys and the values.
+ */
+#define GROUP_BY_BLOCK_ROWS 128
+#endif
+
+_Static_assert((GROUP_BY_WRAM_ENTRIES & (GROUP_BY_WRAM_ENTRIES - 1)) == 0 && GROUP_BY_WRAM_PROBES <= GROUP_BY_WRAM_ENTRIES,
+    "group_by error: the number of WRAM entries should be a power of 2, larger than the number of probes");
+/* The block of rows of a tasklet is also the buffer of mram_memset_parallel. */
+_Static_assert(
+    (GROUP_BY_BLOCK_ROWS & 1) == 0 && GROUP_BY_BLOCK_ROWS <= 256 && GROUP_BY_BLOCK_ROWS * 8 >= MRAM_STRING_BUFFER_SIZE,
+    "group_by error: invalid block size defined");
+
+#ifdef NR_TASKLETS
+#define __GROUP_BY_NR_TASKLETS NR_TASKLETS
+#else
+#define __GROUP_BY_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @def GROUP_BY_EMPTY_KEY
+ * @brief The key of a free slot of the MRAM table, which cannot be used as a group key.
+ */
+#define GROUP_BY_EMPTY_KEY 0xffffffffu
+
+/**
+ * @def GROUP_BY_FULL
+ * @brief Returned by group_by_aggregate when the MRAM table cannot hold all the groups.
+ */
+#define GROUP_BY_FULL 0xffffffffu
+
+/**
+ * @struct group_by_entry
+ * @brief The aggregates of a group, identical to struct dpu_group on the host.
+ */
+struct group_by_entry {
+    uint32_t key;
+    uint32_t count;
+    int64_t sum;
+    int32_t min;
+    int32_t max;
+};
+
+/* Number of entries read, and written, by each DMA of the final copy: the row block holds both. */
+#define __GROUP_BY_COPY_ENTRIES ((GROUP_BY_BLOCK_ROWS * 4) / sizeof(struct group_by_entry))
+
+/**
+ * @struct group_by
+ * @brief The state of an aggregation, as declared by GROUP_BY_INIT.
+ */
+struct group_by {
+    __mram_ptr struct group_by_entry *table;
+    uint32_t slot_mask;
+    uint32_t nr_groups;
+    bool full;
+    struct mutex_pool *locks;
+    uint8_t *groups_lock;
+    barrier_t *barrier;
+    struct group_by_entry (*tables)[GROUP_BY_WRAM_ENTRIES];
+    uint8_t (*blocks)[GROUP_BY_BLOCK_ROWS * 8];
+    struct group_by_entry *slots;
+    uint32_t *spills;
+};
+
+/**
+ * @def GROUP_BY_INIT
+ * @hideinitializer
+ * @brief Declare and initialize an aggregation, with a pool of NB_MUTEXES hardware mutexes protecting the MRAM table.
+ */
+#define GROUP_BY_INIT(NAME, NB_MUTEXES)                                                                                          \
+    MUTEX_POOL_INIT(group_by_locks_##NAME, NB_MUTEXES);                                                                          \
+    BARRIER_INIT(group_by_barrier_##NAME, __GROUP_BY_NR_TASKLETS);                                                               \
+    uint8_t __atomic_bit group_by_groups_lock_##NAME = 0;                                                                        \
+    struct group_by_entry group_by_tables_##NAME[__GROUP_BY_NR_TASKLETS][GROUP_BY_WRAM_ENTRIES];                                 \
+    __dma_aligned uint8_t group_by_blocks_##NAME[__GROUP_BY_NR_TASKLETS][GROUP_BY_BLOCK_ROWS * 8];                               \
+    __dma_aligned struct group_by_entry group_by_slots_##NAME[__GROUP_BY_NR_TASKLETS];                                           \
+    uint32_t group_by_spills_##NAME[__GROUP_BY_NR_TASKLETS];                                                                     \
+    struct group_by NAME = { .locks = &group_by_locks_##NAME,                                                                    \
+        .groups_lock = &group_by_groups_lock_##NAME,                                                                             \
+        .barrier = &group_by_barrier_##NAME,                                                                                     \
+        .tables = group_by_tables_##NAME,                                                                                        \
+        .blocks = group_by_blocks_##NAME,                                                                                        \
+        .slots = group_by_slots_##NAME,                                                                                          \
+        .spills = group_by_spills_##NAME };
+
+/*
+ * Merges an aggregate into the MRAM table. The slots only go from free to used, so a key is always found on the probe
+ * sequence before the first free slot, and locking one slot at a time is enough.
+ */
+static inline bool
+__group_by_spill(struct group_by *g, const struct group_by_entry *entry)
+{
+    struct group_by_entry *slot = &g->slots[me()];
+    uint32_t index = mram_hash_key(entry->key) & g->slot_mask;
+
+    for (uint32_t each_slot = 0; each_slot <= g->slot_mask; each_slot++) {
+        mutex_pool_lock(g->locks, index);
+        mram_read(&g->table[index], slot, sizeof(*slot));
+        if (slot->key == entry->key) {
+            slot->count += entry->count;
+            slot->sum += entry->sum;
+            slot->min = entry->min < slot->min ? entry->min : slot->min;
+            slot->max = entry->max > slot->max ? entry->max : slot->max;
+            mram_write(slot, &g->table[index], sizeof(*slot));
+            mutex_pool_unlock(g->locks, index);
+            return true;
+        }
+        if (slot->key == GROUP_BY_EMPTY_KEY) {
+            *slot = *entry;
+            mram_write(slot, &g->table[index], sizeof(*slot));
+            mutex_pool_unlock(g->locks, index);
+            return true;
+        }
+        mutex_pool_unlock(g->locks, index);
+        index = (index + 1) & g->slot_mask;
+    }
+    return false;
+}
+
+/* Aggregates a row in the WRAM table of the tasklet, spilling an aggregate to MRAM if there is no room for the key. */
+static inline void
+__group_by_row(struct group_by *g, struct group_by_entry *table, uint32_t key, int32_t value)
+{
+    uint32_t home = mram_hash_key(key) & (GROUP_BY_WRAM_ENTRIES - 1);
+    uint32_t index = home;
+    struct group_by_entry *entry;
+
+    for (uint32_t each_probe = 0; each_probe < GROUP_BY_WRAM_PROBES; each_probe++) {
+        entry = &table[index];
+        if (entry->count == 0) {
+            break;
+        }
+        if (entry->key == key) {
+            entry->count++;
+            entry->sum += value;
+            entry->min = value < entry->min ? value : entry->min;
+            entry->max = value > entry->max ? value : entry->max;
+            return;
+        }
+        index = (index + 1) & (GROUP_BY_WRAM_ENTRIES - 1);
+    }
+
+    if (entry->count != 0) {
+        entry = &table[home];
+        if (!__group_by_spill(g, entry)) {
+            g->full = true;
+        }
+        g->spills[me()]++;
+    }
+
+    entry->key = key;
+    entry->count = 1;
+    entry->sum = value;
+    entry->min = value;
+    entry->max = value;
+}
+
+/**
+ * @fn group_by_aggregate
+ * @brief Computes the count, sum, minimum and maximum of the values of each key of an MRAM table of rows.
+ *
+ * Must be called by all the tasklets, with the same arguments. The groups are complete when the tasklets return.
+ *
+ * @param g the state of the aggregation
+ * @param keys the key of each row, 8-byte aligned in MRAM, different from GROUP_BY_EMPTY_KEY
+ * @param values the value of each row, 8-byte aligned in MRAM
+ * @param nr_rows the number of rows
+ * @param table an MRAM area of nr_slots entries, 8-byte aligned, for the MRAM hash table
+ * @param nr_slots the number of entries of the MRAM table, a power of 2 larger than the number of groups
+ * @param groups the MRAM array receiving the groups, 8-byte aligned
+ * @return The number of groups, or GROUP_BY_FULL if the MRAM table is too small.
+ */
+static inline uint32_t
+group_by_aggregate(struct group_by *g,
+    const __mram_ptr uint32_t *keys,
+    const __mram_ptr int32_t *values,
+    uint32_t nr_rows,
+    __mram_ptr struct group_by_entry *table,
+    uint32_t nr_slots,
+    __mram_ptr struct group_by_entry *groups)
+{
+    sysname_t id = me();
+    struct group_by_entry *wram_table = g->tables[id];
+    uint32_t *block_keys = (uint32_t *)g->blocks[id];
+    int32_t *block_values = (int32_t *)(g->blocks[id] + GROUP_BY_BLOCK_ROWS * 4);
+    struct group_by_entry *copy_in = (struct group_by_entry *)g->blocks[id];
+    struct group_by_entry *copy_out = copy_in + __GROUP_BY_COPY_ENTRIES;
+    uint32_t per_tasklet = (((nr_rows + __GROUP_BY_NR_TASKLETS - 1) / __GROUP_BY_NR_TASKLETS) + 1) & ~1;
+    uint32_t from = id * per_tasklet;
+    uint32_t to = from + per_tasklet;
+    uint32_t slots_per_tasklet = (nr_slots + __GROUP_BY_NR_TASKLETS - 1) / __GROUP_BY_NR_TASKLETS;
+    uint32_t first_slot = id * slots_per_tasklet;
+    uint32_t last_slot = first_slot + slots_per_tasklet;
+
+    if (to > nr_rows) {
+        to = nr_rows;
+    }
+    if (from > to) {
+        from = to;
+    }
+    if (last_slot > nr_slots) {
+        last_slot = nr_slots;
+    }
+    if (first_slot > last_slot) {
+        first_slot = last_slot;
+    }
+
+    /* The tasklets may still be reading the results of the previous aggregation. */
+    barrier_wait(g->barrier);
+    if (id == 0) {
+        g->table = table;
+        g->slot_mask = nr_slots - 1;
+        g->nr_groups = 0;
+        g->full = false;
+    }
+    g->spills[id] = 0;
+    for (uint32_t each_entry = 0; each_entry < GROUP_BY_WRAM_ENTRIES; each_entry++) {
+        wram_table[each_entry].count = 0;
+    }
+    mram_memset_parallel(table, 0xff, nr_slots * sizeof(struct group_by_entry), g->blocks[id]);
+    barrier_wait(g->barrier);
+
+    for (uint32_t i = from; i < to; i += GROUP_BY_BLOCK_ROWS) {
+        uint32_t n = to - i < GROUP_BY_BLOCK_ROWS ? to - i : GROUP_BY_BLOCK_ROWS;
+        uint32_t size = ((n + 1) & ~1) * sizeof(uint32_t);
+        mram_read(&keys[i], block_keys, size);
+        mram_read(&values[i], block_values, size);
+        for (uint32_t j = 0; j < n; j++) {
+            __group_by_row(g, wram_table, block_keys[j], block_values[j]);
+        }
+    }
+    for (uint32_t each_entry = 0; each_entry < GROUP_BY_WRAM_ENTRIES; each_entry++) {
+        if (wram_table[each_entry].count != 0 && !__group_by_spill(g, &wram_table[each_entry])) {
+            g->full = true;
+        }
+    }
+    barrier_wait(g->barrier);
+
+    if (g->full) {
+        return GROUP_BY_FULL;
+    }
+
+    /* Copy the used slots of the MRAM table to the groups, reserving room in the groups for each batch. */
+    for (uint32_t i = first_slot; i < last_slot; i += __GROUP_BY_COPY_ENTRIES) {
+        uint32_t n = last_slot - i < __GROUP_BY_COPY_ENTRIES ? last_slot - i : __GROUP_BY_COPY_ENTRIES;
+        uint32_t nr_used = 0, offset;
+
+        mram_read(&table[i], copy_in, n * sizeof(struct group_by_entry));
+        for (uint32_t j = 0; j < n; j++) {
+            if (copy_in[j].key != GROUP_BY_EMPTY_KEY) {
+                copy_out[nr_used++] = copy_in[j];
+            }
+        }
+        if (nr_used != 0) {
+            mutex_lock(g->groups_lock);
+            offset = g->nr_groups;
+            g->nr_groups += nr_used;
+            mutex_unlock(g->groups_lock);
+            mram_write(copy_out, &groups[offset], nr_used * sizeof(struct group_by_entry));
+        }
+    }
+    barrier_wait(g->barrier);
+
+    return g->nr_groups;
+}
+
+/**
+ * @fn group_by_nr_spills
+ * @brief The number of aggregates spilled to the MRAM table by the last aggregation, the final merge excluded.
+ *
+ * Must be called after group_by_aggregate returned in all the tasklets.
+ *
+ * @param g the state of the aggregation
+ * @return The number of spills.
+ */
+static inline uint32_t
+group_by_nr_spills(struct group_by *g)
+{
+    uint32_t nr_spills = 0;
+
+    for (uint32_t each_tasklet = 0; each_tasklet < __GROUP_BY_NR_TASKLETS; each_tasklet++) {
+        nr_spills += g->spills[each_tasklet];
+    }
+    return nr_spills;
+}
+
+#endif /* DPUSYSCORE_GROUP_BY_H */
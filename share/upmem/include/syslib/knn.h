@@ -0,0 +1,343 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_KNN_H
+#define DPUSYSCORE_KNN_H
+
+/**
+ * @file knn.h
+ * @brief Search of the k nearest neighbours of a batch of queries among int8 vectors stored in MRAM.
+ *
+ * The vectors are stored one after the other in MRAM, with a number of dimensions multiple of 8, and the queries in WRAM,
+ * typically in a __host array written with dpu_broadcast_to. The distance between a query and a vector is the opposite of
+ * their dot product (KNN_DOT), or the square of their euclidean distance (KNN_L2). The nearest neighbours are the vectors
+ * with the smallest distances, the ties being broken by the smallest index.
+ *
+ * Each tasklet reads its slice of the vectors by blocks of KNN_BLOCK_SIZE bytes, computes the distances of each vector
+ * with all the queries of the batch, and keeps the k best vectors of each query in a max-heap: a vector is compared with
+ * the root of the heap, and most vectors are rejected by this single comparison. Then the heaps of all the tasklets are
+ * merged, and the k nearest neighbours of each query are written in increasing order of distance. The host merges the
+ * results of all the DPUs (see dpu_knn.h).
+ *
+ * The DPU multiplies 8-bit operands in one instruction, while a 32-bit multiplication takes many. The int8 products are
+ * computed with the mul_sl_sl and mul_sh_sh instructions, on the bytes of the words of the vectors, 4 dimensions per
+ * word and no sign extension. The square euclidean distance is expanded as |q|^2 + |v|^2 - 2 q.v, so that it uses the
+ * same products: the norms of the queries are computed once, and the norm of a vector once for all the queries.
+ *
+ * The WRAM used by each tasklet is KNN_MAX_QUERIES * (KNN_MAX_K * 8 + 4) + KNN_BLOCK_SIZE bytes: 1.5 KB with the default
+ * parameters.
+ */
+
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <built_ins.h>
+#include <dpu_characteristics.h>
+
+#ifndef KNN_MAX_K
+/**
+ * @def KNN_MAX_K
+ * @hideinitializer
+ * @brief Maximum number of neighbours searched for each query.
+ */
+#define KNN_MAX_K 16
+#endif
+
+#ifndef KNN_MAX_QUERIES
+/**
+ * @def KNN_MAX_QUERIES
+ * @hideinitializer
+ * @brief Maximum number of queries of a batch.
+ */
+#define KNN_MAX_QUERIES 8
+#endif
+
+#ifndef KNN_BLOCK_SIZE
+/**
+ * @def KNN_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Size of the DMAs reading the vectors, in bytes, which sets the maximum number of dimensions.
+ */
+#define KNN_BLOCK_SIZE 512
+#endif
+
+_Static_assert(KNN_MAX_K > 0 && KNN_MAX_QUERIES > 0, "knn error: invalid number of neighbours or queries defined");
+_Static_assert((KNN_BLOCK_SIZE & 7) == 0 && KNN_BLOCK_SIZE <= 2048, "knn error: invalid block size defined");
+
+#ifdef NR_TASKLETS
+#define __KNN_NR_TASKLETS NR_TASKLETS
+#else
+#define __KNN_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @def KNN_NO_NEIGHBOUR
+ * @brief The index of the results beyond the number of vectors, whose distance is INT32_MAX.
+ */
+#define KNN_NO_NEIGHBOUR 0xffffffffu
+
+/**
+ * @brief The distance between the queries and the vectors.
+ */
+typedef enum _knn_metric_t {
+    /** The opposite of the dot product: the nearest vectors have the largest dot products. */
+    KNN_DOT = 0,
+    /** The square of the euclidean distance. */
+    KNN_L2 = 1,
+} knn_metric_t;
+
+/**
+ * @struct knn_result
+ * @brief A neighbour of a query, identical to struct dpu_knn_result on the host.
+ */
+struct knn_result {
+    int32_t distance;
+    uint32_t index;
+};
+
+/**
+ * @struct knn
+ * @brief The state of a search, as declared by KNN_INIT.
+ */
+struct knn {
+    int32_t query_norms[KNN_MAX_QUERIES];
+    barrier_t *barrier;
+    struct knn_result (*heaps)[KNN_MAX_QUERIES][KNN_MAX_K];
+    uint32_t (*heap_sizes)[KNN_MAX_QUERIES];
+    uint8_t (*blocks)[KNN_BLOCK_SIZE];
+};
+
+/**
+ * @def KNN_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of a search.
+ */
+#define KNN_INIT(NAME)                                                                                                           \
+    BARRIER_INIT(knn_barrier_##NAME, __KNN_NR_TASKLETS);                                                                         \
+    struct knn_result knn_heaps_##NAME[__KNN_NR_TASKLETS][KNN_MAX_QUERIES][KNN_MAX_K];                                           \
+    uint32_t knn_heap_sizes_##NAME[__KNN_NR_TASKLETS][KNN_MAX_QUERIES];                                                          \
+    __dma_aligned uint8_t knn_blocks_##NAME[__KNN_NR_TASKLETS][KNN_BLOCK_SIZE];                                                  \
+    struct knn NAME = { .barrier = &knn_barrier_##NAME,                                                                          \
+        .heaps = knn_heaps_##NAME,                                                                                               \
+        .heap_sizes = knn_heap_sizes_##NAME,                                                                                     \
+        .blocks = knn_blocks_##NAME };
+
+/* The dot product of the 4 int8 of two words: the low byte and the high byte of each half word are multiplied by the
+ * 8x8-bit multiplier. */
+static inline int32_t
+__knn_dot4(uint32_t a, uint32_t b)
+{
+    int32_t p0, p1, p2, p3;
+
+    __builtin_mul_sl_sl_rrr(p0, a, b);
+    __builtin_mul_sh_sh_rrr(p1, a, b);
+    a >>= 16;
+    b >>= 16;
+    __builtin_mul_sl_sl_rrr(p2, a, b);
+    __builtin_mul_sh_sh_rrr(p3, a, b);
+    return (p0 + p1) + (p2 + p3);
+}
+
+/**
+ * @fn knn_dot_int8
+ * @brief The dot product of two int8 vectors in WRAM.
+ * @param a the first vector, 4-byte aligned
+ * @param b the second vector, 4-byte aligned
+ * @param dims the number of dimensions, a multiple of 4
+ * @return The dot product.
+ */
+static inline int32_t
+knn_dot_int8(const int8_t *a, const int8_t *b, uint32_t dims)
+{
+    const uint32_t *words_a = (const uint32_t *)a;
+    const uint32_t *words_b = (const uint32_t *)b;
+    int32_t sum = 0;
+
+    for (uint32_t each_word = 0; each_word < dims / 4; each_word++) {
+        sum += __knn_dot4(words_a[each_word], words_b[each_word]);
+    }
+    return sum;
+}
+
+static inline int
+__knn_before(const struct knn_result *a, const struct knn_result *b)
+{
+    return a->distance < b->distance || (a->distance == b->distance && a->index < b->index);
+}
+
+/* Restores the max-heap of size entries from its root, after the root was replaced. */
+static inline void
+__knn_sift_down(struct knn_result *heap, uint32_t size)
+{
+    struct knn_result root = heap[0];
+    uint32_t parent = 0;
+
+    for (;;) {
+        uint32_t child = 2 * parent + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && __knn_before(&heap[child], &heap[child + 1])) {
+            child++;
+        }
+        if (!__knn_before(&root, &heap[child])) {
+            break;
+        }
+        heap[parent] = heap[child];
+        parent = child;
+    }
+    heap[parent] = root;
+}
+
+/* Adds a candidate to a max-heap holding at most k entries. */
+static inline void
+__knn_push(struct knn_result *heap, uint32_t *size, uint32_t k, int32_t distance, uint32_t index)
+{
+    struct knn_result candidate = { .distance = distance, .index = index };
+    uint32_t child;
+
+    if (*size == k) {
+        if (__knn_before(&candidate, &heap[0])) {
+            heap[0] = candidate;
+            __knn_sift_down(heap, k);
+        }
+        return;
+    }
+    for (child = (*size)++; child != 0 && __knn_before(&heap[(child - 1) / 2], &candidate); child = (child - 1) / 2) {
+        heap[child] = heap[(child - 1) / 2];
+    }
+    heap[child] = candidate;
+}
+
+/* Computes the distances of a block of vectors with all the queries. */
+static inline void
+__knn_block(struct knn *s,
+    knn_metric_t metric,
+    const int8_t *block,
+    uint32_t first_index,
+    uint32_t nr_vectors,
+    uint32_t dims,
+    const int8_t *queries,
+    uint32_t nr_queries,
+    uint32_t k)
+{
+    sysname_t id = me();
+    uint32_t *sizes = s->heap_sizes[id];
+
+    for (uint32_t each_vector = 0; each_vector < nr_vectors; each_vector++) {
+        const int8_t *vector = block + each_vector * dims;
+        int32_t norm = metric == KNN_L2 ? knn_dot_int8(vector, vector, dims) : 0;
+
+        for (uint32_t each_query = 0; each_query < nr_queries; each_query++) {
+            struct knn_result *heap = s->heaps[id][each_query];
+            int32_t dot = knn_dot_int8(queries + each_query * dims, vector, dims);
+            int32_t distance = metric == KNN_L2 ? s->query_norms[each_query] + norm - 2 * dot : -dot;
+
+            /* The indices of a tasklet are increasing, so a vector as far as the root of a full heap is behind it. */
+            if (sizes[each_query] < k || distance < heap[0].distance) {
+                __knn_push(heap, &sizes[each_query], k, distance, first_index + each_vector);
+            }
+        }
+    }
+}
+
+/**
+ * @fn knn_search
+ * @brief Searches the k nearest neighbours of each query of a batch among MRAM vectors.
+ *
+ * Must be called by all the tasklets, with the same arguments. The results are complete when the tasklets return.
+ *
+ * @param s the state of the search
+ * @param metric the distance between the queries and the vectors
+ * @param vectors the vectors, one after the other, 8-byte aligned in MRAM
+ * @param nr_vectors the number of vectors
+ * @param dims the number of dimensions of the vectors and of the queries, a multiple of 8, at most KNN_BLOCK_SIZE
+ * @param queries the queries, one after the other, 4-byte aligned in WRAM
+ * @param nr_queries the number of queries, at most KNN_MAX_QUERIES
+ * @param k the number of neighbours of each query, at most KNN_MAX_K
+ * @param results receives the k neighbours of query q at results[q * k], in increasing order of distance, padded with
+ * KNN_NO_NEIGHBOUR when there are fewer than k vectors
+ * @return The number of neighbours found for each query, the minimum of k and nr_vectors.
+ */
+static inline uint32_t
+knn_search(struct knn *s,
+    knn_metric_t metric,
+    const __mram_ptr int8_t *vectors,
+    uint32_t nr_vectors,
+    uint32_t dims,
+    const int8_t *queries,
+    uint32_t nr_queries,
+    uint32_t k,
+    struct knn_result *results)
+{
+    sysname_t id = me();
+    int8_t *block = (int8_t *)s->blocks[id];
+    uint32_t vectors_per_block = KNN_BLOCK_SIZE / dims;
+    uint32_t per_tasklet = (nr_vectors + __KNN_NR_TASKLETS - 1) / __KNN_NR_TASKLETS;
+    uint32_t from = id * per_tasklet;
+    uint32_t to = from + per_tasklet;
+
+    if (to > nr_vectors) {
+        to = nr_vectors;
+    }
+    if (from > to) {
+        from = to;
+    }
+
+    for (uint32_t each_query = 0; each_query < nr_queries; each_query++) {
+        s->heap_sizes[id][each_query] = 0;
+    }
+    if (id == 0) {
+        for (uint32_t each_query = 0; each_query < nr_queries; each_query++) {
+            const int8_t *query = queries + each_query * dims;
+            s->query_norms[each_query] = metric == KNN_L2 ? knn_dot_int8(query, query, dims) : 0;
+        }
+    }
+    barrier_wait(s->barrier);
+
+    for (uint32_t i = from; i < to; i += vectors_per_block) {
+        uint32_t n = to - i < vectors_per_block ? to - i : vectors_per_block;
+        mram_read(&vectors[i * dims], block, n * dims);
+        __knn_block(s, metric, block, i, n, dims, queries, nr_queries, k);
+    }
+    barrier_wait(s->barrier);
+
+    /* Merge the heaps of all the tasklets, one query per tasklet, in the heap of the first tasklet. */
+    for (uint32_t each_query = id; each_query < nr_queries; each_query += __KNN_NR_TASKLETS) {
+        struct knn_result *heap = s->heaps[0][each_query];
+        uint32_t *size = &s->heap_sizes[0][each_query];
+        uint32_t count;
+
+        for (uint32_t each_tasklet = 1; each_tasklet < __KNN_NR_TASKLETS; each_tasklet++) {
+            const struct knn_result *other = s->heaps[each_tasklet][each_query];
+            for (uint32_t each_entry = 0; each_entry < s->heap_sizes[each_tasklet][each_query]; each_entry++) {
+                __knn_push(heap, size, k, other[each_entry].distance, other[each_entry].index);
+            }
+        }
+
+        /* Sort the heap in place, by moving the largest entry to the end. */
+        for (count = *size; count > 1; count--) {
+            struct knn_result largest = heap[0];
+            heap[0] = heap[count - 1];
+            __knn_sift_down(heap, count - 1);
+            heap[count - 1] = largest;
+        }
+        for (uint32_t each_entry = 0; each_entry < k; each_entry++) {
+            struct knn_result *result = &results[each_query * k + each_entry];
+            if (each_entry < *size) {
+                *result = heap[each_entry];
+            } else {
+                result->distance = INT32_MAX;
+                result->index = KNN_NO_NEIGHBOUR;
+            }
+        }
+    }
+    barrier_wait(s->barrier);
+
+    return nr_vectors < k ? nr_vectors : k;
+}
+
+#endif /* DPUSYSCORE_KNN_H */
@@ -0,0 +1,998 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_BITMAP_H
+#define DPUSYSCORE_MRAM_BITMAP_H
+
+/**
+ * @file mram_bitmap.h
+ * @brief Operations on bitmaps stored in MRAM: boolean combinations, population count, rank and select, conversion to
+ * positions, and compression into Roaring containers.
+ *
+ * Bit i of a bitmap is bit i % 8 of its byte i / 8, as in mram_scan.h and bfs.h: the bitmap of nr_bits bits takes
+ * MRAM_BITMAP_SIZE(nr_bits) bytes, 8-byte aligned, and its bits past nr_bits must be zero. The bitmaps are streamed by
+ * chunks of MRAM_BITMAP_CHUNK bytes, each tasklet handling a contiguous range of chunks. The bits are counted 32 at a
+ * time with __builtin_popcount, which compiles to the cao instruction, and found with __builtin_ctz.
+ *
+ * Rank and select queries use a directory of the number of bits set before each chunk, built by mram_bitmap_ranks: a
+ * query reads one entry of the directory for rank, or binary searches it for select, and then at most one chunk.
+ *
+ * The Roaring format (Chambi et al., "Better bitmap performance with Roaring bitmaps") splits the bitmap into containers
+ * of 65536 bits, stores no data for the empty ones, and stores each other one in the smallest of three forms:
+ *  - an array of the 16-bit positions of its bits, in increasing order,
+ *  - a bitmap of 8192 bytes,
+ *  - an array of runs of consecutive bits, each one as its 16-bit start and its length minus one.
+ * An image starts with a struct mram_bitmap_roaring_header, followed by a struct mram_bitmap_container for each container
+ * which is not empty, in increasing order, and by their data, each one padded to a multiple of 8 bytes. The images built
+ * on the DPU are identical to those built on the host (see dpu_bitmap.h), so that a sparse bitmap can be transferred
+ * compressed in either direction.
+ *
+ * The WRAM used by each tasklet is 2 * MRAM_BITMAP_CHUNK + MRAM_BITMAP_LINE_SIZE + 8 bytes: 2.1 KB with the default
+ * parameters.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_scatter.h>
+#include <tasklet_scan.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_BITMAP_CHUNK
+/**
+ * @def MRAM_BITMAP_CHUNK
+ * @hideinitializer
+ * @brief Number of bytes of a bitmap read or written at once, which is the size of the DMAs. Up to 2048, the largest
+ * DMA, when the WRAM allows it.
+ */
+#define MRAM_BITMAP_CHUNK 1024
+#endif
+
+#ifndef MRAM_BITMAP_LINE_SIZE
+/**
+ * @def MRAM_BITMAP_LINE_SIZE
+ * @hideinitializer
+ * @brief Size of the write-combining line of each tasklet, which is the size of the DMAs writing the positions.
+ */
+#define MRAM_BITMAP_LINE_SIZE 64
+#endif
+
+_Static_assert((MRAM_BITMAP_CHUNK & (MRAM_BITMAP_CHUNK - 1)) == 0 && MRAM_BITMAP_CHUNK >= 64 && MRAM_BITMAP_CHUNK <= 2048,
+    "mram_bitmap error: invalid chunk size defined");
+
+/**
+ * @def MRAM_BITMAP_SIZE
+ * @hideinitializer
+ * @brief The size, in bytes, of a bitmap of nr_bits bits.
+ */
+#define MRAM_BITMAP_SIZE(nr_bits) ((((nr_bits) + 63) >> 6) << 3)
+
+/**
+ * @def MRAM_BITMAP_NR_CHUNKS
+ * @hideinitializer
+ * @brief The number of chunks of a bitmap of nr_bits bits.
+ */
+#define MRAM_BITMAP_NR_CHUNKS(nr_bits) ((MRAM_BITMAP_SIZE(nr_bits) + MRAM_BITMAP_CHUNK - 1) / MRAM_BITMAP_CHUNK)
+
+/**
+ * @def MRAM_BITMAP_RANKS_SIZE
+ * @hideinitializer
+ * @brief The size, in bytes, of the rank directory of a bitmap of nr_bits bits.
+ */
+#define MRAM_BITMAP_RANKS_SIZE(nr_bits) (((MRAM_BITMAP_NR_CHUNKS(nr_bits) + 2) >> 1) << 3)
+
+/**
+ * @def MRAM_BITMAP_CONTAINER_BITS
+ * @brief Number of bits of a Roaring container. Shared with the host, cannot be changed.
+ */
+#define MRAM_BITMAP_CONTAINER_BITS 65536
+
+/**
+ * @def MRAM_BITMAP_ROARING_BOUND
+ * @hideinitializer
+ * @brief The largest size, in bytes, of the Roaring image of a bitmap of nr_bits bits.
+ */
+#define MRAM_BITMAP_ROARING_BOUND(nr_bits) (16 + (((nr_bits) + MRAM_BITMAP_CONTAINER_BITS - 1) >> 16) * (16 + 8192))
+
+#ifdef NR_TASKLETS
+#define __MRAM_BITMAP_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_BITMAP_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+#define __MRAM_BITMAP_CHUNK_BITS (MRAM_BITMAP_CHUNK * 8)
+#define __MRAM_BITMAP_CONTAINER_SIZE (MRAM_BITMAP_CONTAINER_BITS / 8)
+#define __MRAM_BITMAP_CONTAINER_CHUNKS (__MRAM_BITMAP_CONTAINER_SIZE / MRAM_BITMAP_CHUNK)
+
+/**
+ * @enum mram_bitmap_op_t
+ * @brief The boolean combinations of bitmaps.
+ */
+typedef enum _mram_bitmap_op_t {
+    /** The bits set in all the inputs. */
+    MRAM_BITMAP_AND = 0,
+    /** The bits set in any of the inputs. */
+    MRAM_BITMAP_OR = 1,
+    /** The bits set in an odd number of inputs. */
+    MRAM_BITMAP_XOR = 2,
+    /** The bits set in the first input and in none of the others. */
+    MRAM_BITMAP_ANDNOT = 3,
+} mram_bitmap_op_t;
+
+/**
+ * @enum mram_bitmap_container_type_t
+ * @brief The forms of the data of a Roaring container.
+ */
+typedef enum _mram_bitmap_container_type_t {
+    /** The positions of the bits, as uint16_t. */
+    MRAM_BITMAP_CONTAINER_ARRAY = 1,
+    /** A bitmap of 8192 bytes. */
+    MRAM_BITMAP_CONTAINER_BITMAP = 2,
+    /** The runs of bits, as a uint16_t start and a uint16_t length minus one. */
+    MRAM_BITMAP_CONTAINER_RUN = 3,
+} mram_bitmap_container_type_t;
+
+/**
+ * @struct mram_bitmap_roaring_header
+ * @brief The header of a Roaring image: the layout is identical to struct dpu_bitmap_roaring_header.
+ */
+struct mram_bitmap_roaring_header {
+    /** The number of bits of the bitmap. */
+    uint32_t nr_bits;
+    /** The number of containers which are not empty. */
+    uint32_t nr_containers;
+    /** The number of bits set. */
+    uint32_t cardinality;
+    /** The size of the image, in bytes. */
+    uint32_t size;
+};
+
+/**
+ * @struct mram_bitmap_container
+ * @brief A container of a Roaring image: the layout is identical to struct dpu_bitmap_container.
+ */
+struct mram_bitmap_container {
+    /** The offset of the data of the container from the start of the image. */
+    uint32_t offset;
+    /** The number of bits set. */
+    uint32_t cardinality;
+    /** The index of the container, the bits of the container being bits key * 65536 to key * 65536 + 65535. */
+    uint16_t key;
+    /** The form of the data, an mram_bitmap_container_type_t. */
+    uint8_t type;
+    uint8_t reserved;
+    /** The number of elements of the data: positions, 64-bit words or runs. */
+    uint32_t count;
+};
+
+/**
+ * @struct mram_bitmap
+ * @brief The WRAM state of the bitmap operations, as declared by MRAM_BITMAP_INIT.
+ */
+struct mram_bitmap {
+    struct tasklet_scan *scan;
+    struct mram_scatter *scatter;
+    uint8_t (*buffers)[2][MRAM_BITMAP_CHUNK];
+};
+
+/**
+ * @def MRAM_BITMAP_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the bitmap operations.
+ */
+#define MRAM_BITMAP_INIT(NAME)                                                                                                   \
+    TASKLET_SCAN_INIT(mram_bitmap_scan_##NAME, 0);                                                                               \
+    MRAM_SCATTER_INIT(mram_bitmap_scatter_##NAME, 1, MRAM_BITMAP_LINE_SIZE);                                                     \
+    __dma_aligned uint8_t mram_bitmap_buffers_##NAME[__MRAM_BITMAP_NR_TASKLETS][2][MRAM_BITMAP_CHUNK];                           \
+    struct mram_bitmap NAME = { .scan = &mram_bitmap_scan_##NAME,                                                                \
+        .scatter = &mram_bitmap_scatter_##NAME,                                                                                  \
+        .buffers = mram_bitmap_buffers_##NAME };
+
+/* The first chunk or container of a tasklet, out of nr, on an even index: the rank entries of a tasklet start on 8 bytes. */
+static inline uint32_t
+__mram_bitmap_split(uint32_t nr, uint32_t tasklet)
+{
+    if (tasklet == __MRAM_BITMAP_NR_TASKLETS) {
+        return nr;
+    }
+    return (uint32_t)((uint64_t)nr * tasklet / __MRAM_BITMAP_NR_TASKLETS) & ~1u;
+}
+
+/* Reads a chunk of a bitmap of size bytes, and returns its length. */
+static inline uint32_t
+__mram_bitmap_read(const __mram_ptr uint64_t *bitmap, uint32_t size, uint32_t chunk, void *buffer)
+{
+    uint32_t offset = chunk * MRAM_BITMAP_CHUNK;
+    uint32_t length = size - offset < MRAM_BITMAP_CHUNK ? size - offset : MRAM_BITMAP_CHUNK;
+
+    mram_read((const __mram_ptr uint8_t *)bitmap + offset, buffer, length);
+    return length;
+}
+
+static inline uint32_t
+__mram_bitmap_count(const uint32_t *words, uint32_t nr_words)
+{
+    uint32_t count = 0;
+
+    for (uint32_t w = 0; w < nr_words; w++) {
+        count += __builtin_popcount(words[w]);
+    }
+    return count;
+}
+
+/* The position of the bit of rank k of a word, which has more than k bits set. */
+static inline uint32_t
+__mram_bitmap_select_word(uint32_t word, uint32_t k)
+{
+    for (; k != 0; k--) {
+        word &= word - 1;
+    }
+    return __builtin_ctz(word);
+}
+
+/**
+ * @fn mram_bitmap_combine
+ * @brief Combines bitmaps bit by bit.
+ *
+ * Must be called by all the tasklets, with the same arguments. The output is complete when the tasklets return. An AND
+ * or an ANDNOT stops reading the inputs of a chunk once it is empty.
+ *
+ * @param b the state of the bitmap operations
+ * @param op the combination
+ * @param inputs the MRAM address of each input, 8-byte aligned
+ * @param nr_inputs the number of inputs, at least 1
+ * @param nr_bits the number of bits of the bitmaps
+ * @param output the MRAM bitmap receiving the combination, 8-byte aligned, which can be one of the inputs
+ * @return The number of bits set in the output.
+ */
+static inline uint32_t
+mram_bitmap_combine(struct mram_bitmap *b,
+    mram_bitmap_op_t op,
+    const __mram_ptr uint64_t *const *inputs,
+    uint32_t nr_inputs,
+    uint32_t nr_bits,
+    __mram_ptr uint64_t *output)
+{
+    uint32_t size = MRAM_BITMAP_SIZE(nr_bits), nr_chunks = MRAM_BITMAP_NR_CHUNKS(nr_bits);
+    uint32_t *result = (uint32_t *)b->buffers[me()][0], *operand = (uint32_t *)b->buffers[me()][1];
+    uint32_t count = 0, total;
+
+    for (uint32_t chunk = __mram_bitmap_split(nr_chunks, me()); chunk < __mram_bitmap_split(nr_chunks, me() + 1); chunk++) {
+        uint32_t length = __mram_bitmap_read(inputs[0], size, chunk, result), nr_words = length / sizeof(uint32_t);
+
+        for (uint32_t each_input = 1; each_input < nr_inputs; each_input++) {
+            uint32_t any = 0;
+            __mram_bitmap_read(inputs[each_input], size, chunk, operand);
+            switch (op) {
+                case MRAM_BITMAP_AND:
+                    for (uint32_t w = 0; w < nr_words; w++) {
+                        any |= result[w] &= operand[w];
+                    }
+                    break;
+                case MRAM_BITMAP_OR:
+                    for (uint32_t w = 0; w < nr_words; w++) {
+                        result[w] |= operand[w];
+                    }
+                    any = 1;
+                    break;
+                case MRAM_BITMAP_XOR:
+                    for (uint32_t w = 0; w < nr_words; w++) {
+                        result[w] ^= operand[w];
+                    }
+                    any = 1;
+                    break;
+                case MRAM_BITMAP_ANDNOT:
+                    for (uint32_t w = 0; w < nr_words; w++) {
+                        any |= result[w] &= ~operand[w];
+                    }
+                    break;
+            }
+            if (any == 0) {
+                break;
+            }
+        }
+
+        count += __mram_bitmap_count(result, nr_words);
+        mram_write(result, (__mram_ptr uint8_t *)output + chunk * MRAM_BITMAP_CHUNK, length);
+    }
+
+    tasklet_scan_exclusive(b->scan, count, &total);
+    return total;
+}
+
+/**
+ * @fn mram_bitmap_popcount
+ * @brief Counts the bits set in a bitmap.
+ *
+ * Must be called by all the tasklets, with the same arguments.
+ *
+ * @param b the state of the bitmap operations
+ * @param bitmap the bitmap in MRAM, 8-byte aligned
+ * @param nr_bits the number of bits of the bitmap
+ * @return The number of bits set.
+ */
+static inline uint32_t
+mram_bitmap_popcount(struct mram_bitmap *b, const __mram_ptr uint64_t *bitmap, uint32_t nr_bits)
+{
+    uint32_t size = MRAM_BITMAP_SIZE(nr_bits), nr_chunks = MRAM_BITMAP_NR_CHUNKS(nr_bits);
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint32_t count = 0, total;
+
+    for (uint32_t chunk = __mram_bitmap_split(nr_chunks, me()); chunk < __mram_bitmap_split(nr_chunks, me() + 1); chunk++) {
+        count += __mram_bitmap_count(words, __mram_bitmap_read(bitmap, size, chunk, words) / sizeof(uint32_t));
+    }
+
+    tasklet_scan_exclusive(b->scan, count, &total);
+    return total;
+}
+
+/**
+ * @fn mram_bitmap_ranks
+ * @brief Builds the rank directory of a bitmap: the number of bits set before each chunk, and in the whole bitmap.
+ *
+ * Must be called by all the tasklets, with the same arguments. The directory is complete when the tasklets return. The
+ * entries of a tasklet stay in WRAM while it counts its chunks, unless they are more than MRAM_BITMAP_CHUNK / 4: the
+ * first ones are then written before the number of bits set before the tasklet is known, and updated.
+ *
+ * @param b the state of the bitmap operations
+ * @param bitmap the bitmap in MRAM, 8-byte aligned
+ * @param nr_bits the number of bits of the bitmap
+ * @param ranks the MRAM directory, 8-byte aligned, of MRAM_BITMAP_RANKS_SIZE(nr_bits) bytes
+ * @return The number of bits set.
+ */
+static inline uint32_t
+mram_bitmap_ranks(struct mram_bitmap *b, const __mram_ptr uint64_t *bitmap, uint32_t nr_bits, __mram_ptr uint32_t *ranks)
+{
+    const uint32_t per_block = MRAM_BITMAP_CHUNK / sizeof(uint32_t);
+    uint32_t size = MRAM_BITMAP_SIZE(nr_bits), nr_chunks = MRAM_BITMAP_NR_CHUNKS(nr_bits);
+    uint32_t first = __mram_bitmap_split(nr_chunks, me()), last = __mram_bitmap_split(nr_chunks, me() + 1);
+    uint32_t *words = (uint32_t *)b->buffers[me()][0], *block = (uint32_t *)b->buffers[me()][1];
+    /* The last tasklet also writes the entry following the last chunk. */
+    uint32_t nr_entries = last - first + (me() == __MRAM_BITMAP_NR_TASKLETS - 1);
+    uint32_t count = 0, offset, total;
+
+    for (uint32_t entry = 0; entry < nr_entries; entry++) {
+        block[entry % per_block] = count;
+        if (entry % per_block == per_block - 1 && entry + 1 != nr_entries) {
+            mram_write(block, &ranks[first + entry + 1 - per_block], MRAM_BITMAP_CHUNK);
+        }
+        if (first + entry < last) {
+            count += __mram_bitmap_count(words, __mram_bitmap_read(bitmap, size, first + entry, words) / sizeof(uint32_t));
+        }
+    }
+
+    offset = tasklet_scan_exclusive(b->scan, count, &total);
+
+    if (nr_entries != 0) {
+        uint32_t in_block = (nr_entries - 1) % per_block + 1;
+        for (uint32_t entry = 0; entry < in_block; entry++) {
+            block[entry] += offset;
+        }
+        mram_write(block, &ranks[first + nr_entries - in_block], ((in_block + 1) >> 1) << 3);
+        for (uint32_t start = 0; start + in_block < nr_entries; start += per_block) {
+            mram_read(&ranks[first + start], block, MRAM_BITMAP_CHUNK);
+            for (uint32_t entry = 0; entry < per_block; entry++) {
+                block[entry] += offset;
+            }
+            mram_write(block, &ranks[first + start], MRAM_BITMAP_CHUNK);
+        }
+    }
+    return total;
+}
+
+/* The entry of the rank directory before a chunk. */
+static inline uint32_t
+__mram_bitmap_rank_entry(const __mram_ptr uint32_t *ranks, uint32_t chunk, uint32_t *buffer)
+{
+    mram_read(&ranks[chunk & ~1u], buffer, 2 * sizeof(uint32_t));
+    return buffer[chunk & 1];
+}
+
+/**
+ * @fn mram_bitmap_rank
+ * @brief Counts the bits set before a position of a bitmap.
+ *
+ * Can be called by any tasklet, independently of the others.
+ *
+ * @param b the state of the bitmap operations
+ * @param bitmap the bitmap in MRAM, 8-byte aligned
+ * @param ranks the rank directory of the bitmap, built by mram_bitmap_ranks
+ * @param position the position, at most the number of bits of the bitmap
+ * @return The number of bits set before the position.
+ */
+static inline uint32_t
+mram_bitmap_rank(struct mram_bitmap *b, const __mram_ptr uint64_t *bitmap, const __mram_ptr uint32_t *ranks, uint32_t position)
+{
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint32_t chunk = position / __MRAM_BITMAP_CHUNK_BITS, bit = position % __MRAM_BITMAP_CHUNK_BITS;
+    uint32_t rank = __mram_bitmap_rank_entry(ranks, chunk, words);
+
+    if (bit != 0) {
+        mram_read((const __mram_ptr uint8_t *)bitmap + chunk * MRAM_BITMAP_CHUNK, words, ((bit + 63) >> 6) << 3);
+        rank += __mram_bitmap_count(words, bit >> 5);
+        if ((bit & 31) != 0) {
+            rank += __builtin_popcount(words[bit >> 5] & ((1u << (bit & 31)) - 1));
+        }
+    }
+    return rank;
+}
+
+/**
+ * @fn mram_bitmap_select
+ * @brief Finds the bit set of a given rank in a bitmap.
+ *
+ * Can be called by any tasklet, independently of the others. The chunk holding the bit is found by a binary search of
+ * the rank directory.
+ *
+ * @param b the state of the bitmap operations
+ * @param bitmap the bitmap in MRAM, 8-byte aligned
+ * @param ranks the rank directory of the bitmap, built by mram_bitmap_ranks
+ * @param nr_bits the number of bits of the bitmap
+ * @param rank the number of bits set before the bit
+ * @return The position of the bit, or UINT32_MAX if the bitmap has at most rank bits set.
+ */
+static inline uint32_t
+mram_bitmap_select(struct mram_bitmap *b,
+    const __mram_ptr uint64_t *bitmap,
+    const __mram_ptr uint32_t *ranks,
+    uint32_t nr_bits,
+    uint32_t rank)
+{
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint32_t nr_chunks = MRAM_BITMAP_NR_CHUNKS(nr_bits), low = 0, high, nr_words;
+
+    if (nr_chunks == 0 || rank >= __mram_bitmap_rank_entry(ranks, nr_chunks, words)) {
+        return UINT32_MAX;
+    }
+
+    /* The last chunk with at most rank bits set before it. */
+    high = nr_chunks - 1;
+    while (low < high) {
+        uint32_t middle = (low + high + 1) >> 1;
+        if (__mram_bitmap_rank_entry(ranks, middle, words) <= rank) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    rank -= __mram_bitmap_rank_entry(ranks, low, words);
+
+    nr_words = __mram_bitmap_read(bitmap, MRAM_BITMAP_SIZE(nr_bits), low, words) / sizeof(uint32_t);
+    for (uint32_t w = 0; w < nr_words; w++) {
+        uint32_t count = __builtin_popcount(words[w]);
+        if (rank < count) {
+            return low * __MRAM_BITMAP_CHUNK_BITS + (w << 5) + __mram_bitmap_select_word(words[w], rank);
+        }
+        rank -= count;
+    }
+    return UINT32_MAX;
+}
+
+/**
+ * @fn mram_bitmap_positions
+ * @brief Converts a bitmap into the list of the positions of its bits set, in increasing order.
+ *
+ * Must be called by all the tasklets, with the same arguments. The positions are complete when the tasklets return. The
+ * tasklets count the bits of their chunks, then read them again to write their positions through the write-combining
+ * lines of mram_scatter.h, at the offsets given by tasklet_scan_exclusive.
+ *
+ * @param b the state of the bitmap operations
+ * @param bitmap the bitmap in MRAM, 8-byte aligned
+ * @param nr_bits the number of bits of the bitmap
+ * @param positions the MRAM array receiving the positions, 8-byte aligned
+ * @return The number of positions.
+ */
+static inline uint32_t
+mram_bitmap_positions(struct mram_bitmap *b,
+    const __mram_ptr uint64_t *bitmap,
+    uint32_t nr_bits,
+    __mram_ptr uint32_t *positions)
+{
+    uint32_t size = MRAM_BITMAP_SIZE(nr_bits), nr_chunks = MRAM_BITMAP_NR_CHUNKS(nr_bits);
+    uint32_t first = __mram_bitmap_split(nr_chunks, me()), last = __mram_bitmap_split(nr_chunks, me() + 1);
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint32_t count = 0, offset, total;
+    mram_scatter_writer_t writer;
+
+    for (uint32_t chunk = first; chunk < last; chunk++) {
+        count += __mram_bitmap_count(words, __mram_bitmap_read(bitmap, size, chunk, words) / sizeof(uint32_t));
+    }
+    offset = tasklet_scan_exclusive(b->scan, count, &total);
+
+    writer = mram_scatter_writer(b->scatter);
+    mram_scatter_set_destination(&writer, 0, &positions[offset]);
+    for (uint32_t chunk = first; chunk < last && count != 0; chunk++) {
+        uint32_t nr_words = __mram_bitmap_read(bitmap, size, chunk, words) / sizeof(uint32_t);
+        for (uint32_t w = 0; w < nr_words; w++) {
+            for (uint32_t bits = words[w]; bits != 0; bits &= bits - 1) {
+                uint32_t position = chunk * __MRAM_BITMAP_CHUNK_BITS + (w << 5) + __builtin_ctz(bits);
+                mram_scatter_push(&writer, 0, &position, sizeof(position));
+            }
+        }
+    }
+    mram_scatter_flush(&writer);
+    return total;
+}
+
+/* The chunks [*first, *last) of a container, which can be past the end of the bitmap. */
+static inline void
+__mram_bitmap_container_chunks(uint32_t key, uint32_t nr_chunks, uint32_t *first, uint32_t *last)
+{
+    *first = key * __MRAM_BITMAP_CONTAINER_CHUNKS;
+    *last = *first + __MRAM_BITMAP_CONTAINER_CHUNKS < nr_chunks ? *first + __MRAM_BITMAP_CONTAINER_CHUNKS : nr_chunks;
+    if (*first > *last) {
+        *first = *last;
+    }
+}
+
+/* Counts the bits set and the runs of bits of a container. */
+static inline uint32_t
+__mram_bitmap_container_stats(const __mram_ptr uint64_t *bitmap,
+    uint32_t nr_bits,
+    uint32_t key,
+    uint32_t *words,
+    uint32_t *nr_runs)
+{
+    uint32_t first, last, cardinality = 0, runs = 0, carry = 0;
+
+    __mram_bitmap_container_chunks(key, MRAM_BITMAP_NR_CHUNKS(nr_bits), &first, &last);
+    for (uint32_t chunk = first; chunk < last; chunk++) {
+        uint32_t nr_words = __mram_bitmap_read(bitmap, MRAM_BITMAP_SIZE(nr_bits), chunk, words) / sizeof(uint32_t);
+        for (uint32_t w = 0; w < nr_words; w++) {
+            uint32_t x = words[w];
+            cardinality += __builtin_popcount(x);
+            runs += __builtin_popcount(x & ~((x << 1) | carry));
+            carry = x >> 31;
+        }
+    }
+    *nr_runs = runs;
+    return cardinality;
+}
+
+/* The smallest form of a container, as in Roaring: runs if smaller than both other forms, else an array if at most
+ * 4096 bits are set. */
+static inline uint32_t
+__mram_bitmap_container_type(uint32_t cardinality, uint32_t nr_runs)
+{
+    if (4 * nr_runs < 2 * cardinality && 4 * nr_runs < __MRAM_BITMAP_CONTAINER_SIZE) {
+        return MRAM_BITMAP_CONTAINER_RUN;
+    }
+    return 2 * cardinality <= __MRAM_BITMAP_CONTAINER_SIZE ? MRAM_BITMAP_CONTAINER_ARRAY : MRAM_BITMAP_CONTAINER_BITMAP;
+}
+
+/* The number of elements of the data of a container of a given type. */
+static inline uint32_t
+__mram_bitmap_container_count(uint32_t type, uint32_t cardinality, uint32_t nr_runs)
+{
+    return type == MRAM_BITMAP_CONTAINER_ARRAY ? cardinality
+        : type == MRAM_BITMAP_CONTAINER_RUN    ? nr_runs
+                                               : __MRAM_BITMAP_CONTAINER_SIZE / sizeof(uint64_t);
+}
+
+/* The size of the data of a container, padded to 8 bytes. */
+static inline uint32_t
+__mram_bitmap_container_size(uint32_t type, uint32_t count)
+{
+    return type == MRAM_BITMAP_CONTAINER_ARRAY ? ((count * 2 + 7) & ~7u)
+        : type == MRAM_BITMAP_CONTAINER_RUN    ? ((count * 4 + 7) & ~7u)
+                                               : __MRAM_BITMAP_CONTAINER_SIZE;
+}
+
+/* Writes 16-bit values to MRAM through a buffer of MRAM_BITMAP_CHUNK bytes. */
+struct __mram_bitmap_output {
+    __mram_ptr uint8_t *to;
+    uint16_t *buffer;
+    uint32_t fill;
+};
+
+static inline void
+__mram_bitmap_put(struct __mram_bitmap_output *o, uint32_t value)
+{
+    o->buffer[o->fill++] = (uint16_t)value;
+    if (o->fill == MRAM_BITMAP_CHUNK / sizeof(uint16_t)) {
+        mram_write(o->buffer, o->to, MRAM_BITMAP_CHUNK);
+        o->to += MRAM_BITMAP_CHUNK;
+        o->fill = 0;
+    }
+}
+
+static inline void
+__mram_bitmap_finish(struct __mram_bitmap_output *o)
+{
+    if (o->fill != 0) {
+        for (; (o->fill & 3) != 0; o->fill++) {
+            o->buffer[o->fill] = 0;
+        }
+        mram_write(o->buffer, o->to, o->fill * sizeof(uint16_t));
+    }
+}
+
+/* Writes the data of a container to the image. */
+static inline void
+__mram_bitmap_encode_container(const __mram_ptr uint64_t *bitmap,
+    uint32_t nr_bits,
+    uint32_t key,
+    uint32_t type,
+    __mram_ptr uint8_t *data,
+    uint32_t *words,
+    uint16_t *buffer)
+{
+    uint32_t nr_chunks = MRAM_BITMAP_NR_CHUNKS(nr_bits), size = MRAM_BITMAP_SIZE(nr_bits), first, last;
+    struct __mram_bitmap_output o = { .to = data, .buffer = buffer, .fill = 0 };
+    uint32_t start = 0;
+    bool in_run = false;
+
+    __mram_bitmap_container_chunks(key, nr_chunks, &first, &last);
+    for (uint32_t each_chunk = 0; each_chunk < __MRAM_BITMAP_CONTAINER_CHUNKS; each_chunk++) {
+        uint32_t chunk = first + each_chunk, nr_words = 0;
+
+        if (chunk < last) {
+            nr_words = __mram_bitmap_read(bitmap, size, chunk, words) / sizeof(uint32_t);
+        }
+        if (type == MRAM_BITMAP_CONTAINER_BITMAP) {
+            for (uint32_t w = nr_words; w < MRAM_BITMAP_CHUNK / sizeof(uint32_t); w++) {
+                words[w] = 0;
+            }
+            mram_write(words, data + each_chunk * MRAM_BITMAP_CHUNK, MRAM_BITMAP_CHUNK);
+            continue;
+        }
+
+        for (uint32_t w = 0; w < nr_words; w++) {
+            uint32_t x = words[w], base = each_chunk * __MRAM_BITMAP_CHUNK_BITS + (w << 5), bit = 0;
+            if (type == MRAM_BITMAP_CONTAINER_ARRAY) {
+                for (; x != 0; x &= x - 1) {
+                    __mram_bitmap_put(&o, base + __builtin_ctz(x));
+                }
+                continue;
+            }
+            /* Alternately look for the next bit set and the next bit clear of the word. */
+            while (bit < 32) {
+                uint32_t rest = in_run ? ~x >> bit : x >> bit;
+                if (rest == 0) {
+                    break;
+                }
+                bit += __builtin_ctz(rest);
+                if (in_run) {
+                    __mram_bitmap_put(&o, start);
+                    __mram_bitmap_put(&o, base + bit - start - 1);
+                } else {
+                    start = base + bit;
+                }
+                in_run = !in_run;
+            }
+        }
+    }
+    /* A run still open ends with the bitmap or the container. */
+    if (in_run) {
+        uint32_t end = nr_bits - key * MRAM_BITMAP_CONTAINER_BITS;
+        __mram_bitmap_put(&o, start);
+        __mram_bitmap_put(&o, (end < MRAM_BITMAP_CONTAINER_BITS ? end : MRAM_BITMAP_CONTAINER_BITS) - start - 1);
+    }
+    __mram_bitmap_finish(&o);
+}
+
+/**
+ * @fn mram_bitmap_roaring_encode
+ * @brief Compresses a bitmap into a Roaring image.
+ *
+ * Must be called by all the tasklets, with the same arguments. The image is complete when the tasklets return. Each
+ * tasklet handles a contiguous range of containers: it first sizes them, and then, at the offsets given by
+ * tasklet_scan_exclusive, reads them again to write their data.
+ *
+ * @param b the state of the bitmap operations
+ * @param bitmap the bitmap in MRAM, 8-byte aligned
+ * @param nr_bits the number of bits of the bitmap
+ * @param image the MRAM image, 8-byte aligned, of up to MRAM_BITMAP_ROARING_BOUND(nr_bits) bytes
+ * @return The size of the image, in bytes.
+ */
+static inline uint32_t
+mram_bitmap_roaring_encode(struct mram_bitmap *b,
+    const __mram_ptr uint64_t *bitmap,
+    uint32_t nr_bits,
+    __mram_ptr uint8_t *image)
+{
+    uint32_t nr_keys = (nr_bits + MRAM_BITMAP_CONTAINER_BITS - 1) >> 16;
+    uint32_t first = __mram_bitmap_split(nr_keys, me()), last = __mram_bitmap_split(nr_keys, me() + 1);
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint16_t *buffer = (uint16_t *)b->buffers[me()][1];
+    uint32_t nr_containers = 0, data_size = 0, cardinality = 0, entry, offset, total_containers, total_size, total;
+
+    for (uint32_t key = first; key < last; key++) {
+        uint32_t nr_runs, count = __mram_bitmap_container_stats(bitmap, nr_bits, key, words, &nr_runs);
+        if (count != 0) {
+            uint32_t type = __mram_bitmap_container_type(count, nr_runs);
+            nr_containers++;
+            data_size += __mram_bitmap_container_size(type, __mram_bitmap_container_count(type, count, nr_runs));
+            cardinality += count;
+        }
+    }
+
+    entry = tasklet_scan_exclusive(b->scan, nr_containers, &total_containers);
+    offset = tasklet_scan_exclusive(b->scan, data_size, &total_size);
+    tasklet_scan_exclusive(b->scan, cardinality, &total);
+    offset += sizeof(struct mram_bitmap_roaring_header) + total_containers * sizeof(struct mram_bitmap_container);
+    total_size += sizeof(struct mram_bitmap_roaring_header) + total_containers * sizeof(struct mram_bitmap_container);
+
+    if (me() == 0) {
+        struct mram_bitmap_roaring_header *header = (struct mram_bitmap_roaring_header *)words;
+        header->nr_bits = nr_bits;
+        header->nr_containers = total_containers;
+        header->cardinality = total;
+        header->size = total_size;
+        mram_write(header, image, sizeof(*header));
+    }
+
+    for (uint32_t key = first; key < last && nr_containers != 0; key++) {
+        struct mram_bitmap_container *container = (struct mram_bitmap_container *)words;
+        uint32_t nr_runs, count = __mram_bitmap_container_stats(bitmap, nr_bits, key, words, &nr_runs), type;
+        if (count == 0) {
+            continue;
+        }
+        type = __mram_bitmap_container_type(count, nr_runs);
+        __mram_bitmap_encode_container(bitmap, nr_bits, key, type, image + offset, words, buffer);
+
+        container->offset = offset;
+        container->cardinality = count;
+        container->key = (uint16_t)key;
+        container->type = (uint8_t)type;
+        container->reserved = 0;
+        container->count = __mram_bitmap_container_count(type, count, nr_runs);
+        mram_write(container,
+            image + sizeof(struct mram_bitmap_roaring_header) + entry * sizeof(struct mram_bitmap_container),
+            sizeof(*container));
+        offset += __mram_bitmap_container_size(type, container->count);
+        entry++;
+    }
+    return total_size;
+}
+
+/* Reads the 16-bit values of the data of a container through a buffer of MRAM_BITMAP_CHUNK bytes. */
+struct __mram_bitmap_input {
+    const __mram_ptr uint8_t *from;
+    uint32_t remaining;
+    uint16_t *buffer;
+    uint32_t index;
+    uint32_t available;
+};
+
+/* The next value, or UINT32_MAX at the end of the data. */
+static inline uint32_t
+__mram_bitmap_get(struct __mram_bitmap_input *in)
+{
+    if (in->index == in->available) {
+        const uint32_t per_chunk = MRAM_BITMAP_CHUNK / sizeof(uint16_t);
+        uint32_t n = in->remaining < per_chunk ? in->remaining : per_chunk;
+        if (n == 0) {
+            return UINT32_MAX;
+        }
+        mram_read(in->from, in->buffer, (n * sizeof(uint16_t) + 7) & ~7u);
+        in->from += MRAM_BITMAP_CHUNK;
+        in->remaining -= n;
+        in->available = n;
+        in->index = 0;
+    }
+    return in->buffer[in->index++];
+}
+
+/* Sets the bits [from, to) of a chunk. */
+static inline void
+__mram_bitmap_set_range(uint32_t *words, uint32_t from, uint32_t to)
+{
+    while (from < to) {
+        uint32_t bit = from & 31, n = 32 - bit < to - from ? 32 - bit : to - from;
+        words[from >> 5] |= (n == 32 ? ~0u : ((1u << n) - 1)) << bit;
+        from += n;
+    }
+}
+
+/* Writes a container of the image, or an empty container if it is NULL, to the bitmap. */
+static inline void
+__mram_bitmap_decode_container(const __mram_ptr uint8_t *image,
+    const struct mram_bitmap_container *container,
+    uint32_t key,
+    uint32_t nr_bits,
+    __mram_ptr uint64_t *bitmap,
+    uint32_t *words,
+    uint16_t *buffer)
+{
+    uint32_t size = MRAM_BITMAP_SIZE(nr_bits), first, last, type = container != NULL ? container->type : 0;
+    struct __mram_bitmap_input in = { .from = container != NULL ? image + container->offset : image,
+        .remaining = container != NULL ? container->count * (type == MRAM_BITMAP_CONTAINER_RUN ? 2 : 1) : 0,
+        .buffer = buffer,
+        .index = 0,
+        .available = 0 };
+    uint32_t start = UINT32_MAX, end = 0;
+
+    if (type == MRAM_BITMAP_CONTAINER_ARRAY) {
+        start = __mram_bitmap_get(&in);
+    } else if (type == MRAM_BITMAP_CONTAINER_RUN) {
+        start = __mram_bitmap_get(&in);
+        end = start + __mram_bitmap_get(&in) + 1;
+    }
+
+    __mram_bitmap_container_chunks(key, MRAM_BITMAP_NR_CHUNKS(nr_bits), &first, &last);
+    for (uint32_t chunk = first; chunk < last; chunk++) {
+        uint32_t rest = size - chunk * MRAM_BITMAP_CHUNK, length = rest < MRAM_BITMAP_CHUNK ? rest : MRAM_BITMAP_CHUNK;
+        uint32_t low = (chunk - first) * __MRAM_BITMAP_CHUNK_BITS, high = low + length * 8;
+
+        if (type == MRAM_BITMAP_CONTAINER_BITMAP) {
+            mram_read(image + container->offset + (chunk - first) * MRAM_BITMAP_CHUNK, words, length);
+        } else {
+            for (uint32_t w = 0; w < length / sizeof(uint32_t); w++) {
+                words[w] = 0;
+            }
+        }
+        if (type == MRAM_BITMAP_CONTAINER_ARRAY) {
+            for (; start < high; start = __mram_bitmap_get(&in)) {
+                if (start >= low) {
+                    words[(start - low) >> 5] |= 1u << (start & 31);
+                }
+            }
+        } else if (type == MRAM_BITMAP_CONTAINER_RUN) {
+            while (start < high) {
+                __mram_bitmap_set_range(words, (start > low ? start : low) - low, (end < high ? end : high) - low);
+                if (end > high) {
+                    break;
+                }
+                start = __mram_bitmap_get(&in);
+                end = start + __mram_bitmap_get(&in) + 1;
+            }
+        }
+        mram_write(words, (__mram_ptr uint8_t *)bitmap + chunk * MRAM_BITMAP_CHUNK, length);
+    }
+}
+
+/* Reads a container of an image. */
+static inline void
+__mram_bitmap_container_at(const __mram_ptr uint8_t *image,
+    uint32_t index,
+    uint32_t *words,
+    struct mram_bitmap_container *container)
+{
+    mram_read(image + sizeof(struct mram_bitmap_roaring_header) + index * sizeof(struct mram_bitmap_container),
+        words,
+        sizeof(struct mram_bitmap_container));
+    *container = *(struct mram_bitmap_container *)words;
+}
+
+/* The index of the first container of an image with a key at least key. */
+static inline uint32_t
+__mram_bitmap_find_container(const __mram_ptr uint8_t *image, uint32_t nr_containers, uint32_t key, uint32_t *words)
+{
+    uint32_t low = 0, high = nr_containers;
+
+    while (low < high) {
+        uint32_t middle = (low + high) >> 1;
+        struct mram_bitmap_container container;
+        __mram_bitmap_container_at(image, middle, words, &container);
+        if (container.key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * @fn mram_bitmap_roaring_decode
+ * @brief Decompresses a Roaring image into a bitmap.
+ *
+ * Must be called by all the tasklets, with the same arguments. The bitmap is complete when the tasklets return. Each
+ * tasklet handles a contiguous range of containers, found by a binary search of the containers of the image.
+ *
+ * @param b the state of the bitmap operations
+ * @param image the MRAM image, 8-byte aligned
+ * @param bitmap the MRAM bitmap, 8-byte aligned, receiving the bits of the image
+ * @return The number of bits of the bitmap.
+ */
+static inline uint32_t
+mram_bitmap_roaring_decode(struct mram_bitmap *b, const __mram_ptr uint8_t *image, __mram_ptr uint64_t *bitmap)
+{
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint16_t *buffer = (uint16_t *)b->buffers[me()][1];
+    struct mram_bitmap_roaring_header header;
+    uint32_t nr_keys, first, last, index;
+
+    mram_read(image, words, sizeof(header));
+    header = *(struct mram_bitmap_roaring_header *)words;
+    nr_keys = (header.nr_bits + MRAM_BITMAP_CONTAINER_BITS - 1) >> 16;
+    first = __mram_bitmap_split(nr_keys, me());
+    last = __mram_bitmap_split(nr_keys, me() + 1);
+
+    index = __mram_bitmap_find_container(image, header.nr_containers, first, words);
+    for (uint32_t key = first; key < last; key++) {
+        struct mram_bitmap_container container;
+        bool found = false;
+        if (index < header.nr_containers) {
+            __mram_bitmap_container_at(image, index, words, &container);
+            found = container.key == key;
+        }
+        __mram_bitmap_decode_container(image, found ? &container : NULL, key, header.nr_bits, bitmap, words, buffer);
+        index += found;
+    }
+    return header.nr_bits;
+}
+
+/* The 16-bit value of index of the data of a container. */
+static inline uint32_t
+__mram_bitmap_value_at(const __mram_ptr uint8_t *data, uint32_t index, uint16_t *buffer)
+{
+    mram_read(data + ((index * sizeof(uint16_t)) & ~7u), buffer, 8);
+    return buffer[index & 3];
+}
+
+/**
+ * @fn mram_bitmap_roaring_contains
+ * @brief Tests a bit of a Roaring image, without decompressing it.
+ *
+ * Can be called by any tasklet, independently of the others. The container of the bit, and the bit in an array or a run
+ * container, are found by binary searches, reading 8 bytes at a time.
+ *
+ * @param b the state of the bitmap operations
+ * @param image the MRAM image, 8-byte aligned
+ * @param position the position of the bit
+ * @return Whether the bit is set.
+ */
+static inline bool
+mram_bitmap_roaring_contains(struct mram_bitmap *b, const __mram_ptr uint8_t *image, uint32_t position)
+{
+    uint32_t *words = (uint32_t *)b->buffers[me()][0];
+    uint32_t key = position >> 16, value = position & 0xffff, index, low = 0, high;
+    struct mram_bitmap_roaring_header header;
+    struct mram_bitmap_container container;
+    const __mram_ptr uint8_t *data;
+
+    mram_read(image, words, sizeof(header));
+    header = *(struct mram_bitmap_roaring_header *)words;
+    if (position >= header.nr_bits) {
+        return false;
+    }
+    index = __mram_bitmap_find_container(image, header.nr_containers, key, words);
+    if (index == header.nr_containers) {
+        return false;
+    }
+    __mram_bitmap_container_at(image, index, words, &container);
+    if (container.key != key) {
+        return false;
+    }
+
+    data = image + container.offset;
+    switch (container.type) {
+        case MRAM_BITMAP_CONTAINER_BITMAP:
+            mram_read(data + ((value >> 6) << 3), words, 8);
+            return (words[(value >> 5) & 1] >> (value & 31)) & 1;
+        case MRAM_BITMAP_CONTAINER_ARRAY:
+            high = container.count;
+            while (low < high) {
+                uint32_t middle = (low + high) >> 1;
+                if (__mram_bitmap_value_at(data, middle, (uint16_t *)words) < value) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            return low < container.count && __mram_bitmap_value_at(data, low, (uint16_t *)words) == value;
+        case MRAM_BITMAP_CONTAINER_RUN:
+            /* The number of runs starting at most at the value. */
+            high = container.count;
+            while (low < high) {
+                uint32_t middle = (low + high) >> 1;
+                if (__mram_bitmap_value_at(data, 2 * middle, (uint16_t *)words) <= value) {
+                    low = middle + 1;
+                } else {
+                    high = middle;
+                }
+            }
+            return low != 0
+                && value - __mram_bitmap_value_at(data, 2 * (low - 1), (uint16_t *)words)
+                <= __mram_bitmap_value_at(data, 2 * (low - 1) + 1, (uint16_t *)words);
+        default:
+            return false;
+    }
+}
+
+#endif /* DPUSYSCORE_MRAM_BITMAP_H */
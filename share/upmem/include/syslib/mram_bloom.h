@@ -0,0 +1,292 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_BLOOM_H
+#define DPUSYSCORE_MRAM_BLOOM_H
+
+/**
+ * @file mram_bloom.h
+ * @brief Blocked Bloom filter of 64-bit keys stored in MRAM, shared by all the tasklets.
+ *
+ * The filter is an array of blocks of MRAM_BLOOM_BLOCK_SIZE bytes in MRAM. A key sets, or tests, nr_hashes bits of a
+ * single block, so that an insertion or a probe reads one block with a single DMA. The block of a key is given by the low
+ * bits of a first hash, and its bits in the block by the consecutive groups of log2(8 * MRAM_BLOOM_BLOCK_SIZE) bits of a
+ * second hash, hashed again when its 32 bits are used up. The hashes only use shifts, additions and exclusive ors, the
+ * 32-bit multiplication being slow on the DPU. An MRAM area set to 0 is an empty filter.
+ *
+ * Probes take no lock. Insertions lock the block they update with a mutex of a mutex pool, so that tasklets can insert
+ * concurrently. Keys cannot be removed.
+ *
+ * When the keys are spread between DPUs, the host sends each key to the DPU given by dpu_bloom_dpu_of (see
+ * dpu_bloom.h), which uses hash bits independent from the block and the bits of the key. The filter can also be built by
+ * the host, with the same hashes and layout, and copied into MRAM before attaching it with mram_bloom_attach.
+ *
+ * Each tasklet uses MRAM_BLOOM_BLOCK_SIZE + 8 * MRAM_BLOOM_BATCH bytes of WRAM.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <mutex_pool.h>
+#include <mram_hash.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_BLOOM_BLOCK_SIZE
+/**
+ * @def MRAM_BLOOM_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Size of a block in bytes, read with one DMA: a power of 2 from 8 to 64.
+ */
+#define MRAM_BLOOM_BLOCK_SIZE 64
+#endif
+
+_Static_assert((MRAM_BLOOM_BLOCK_SIZE & (MRAM_BLOOM_BLOCK_SIZE - 1)) == 0 && MRAM_BLOOM_BLOCK_SIZE >= 8
+        && MRAM_BLOOM_BLOCK_SIZE <= 64,
+    "mram_bloom error: invalid block size defined");
+
+/**
+ * @def MRAM_BLOOM_BATCH
+ * @hideinitializer
+ * @brief Number of keys read with one DMA by mram_bloom_insert_keys and mram_bloom_probe_keys, one 64-bit word of results.
+ */
+#define MRAM_BLOOM_BATCH 64
+
+/**
+ * @def MRAM_BLOOM_MAX_HASHES
+ * @hideinitializer
+ * @brief The largest number of bits set by a key.
+ */
+#define MRAM_BLOOM_MAX_HASHES 16
+
+#ifdef NR_TASKLETS
+#define __MRAM_BLOOM_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_BLOOM_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+#define __MRAM_BLOOM_NR_BITS (MRAM_BLOOM_BLOCK_SIZE * 8)
+#define __MRAM_BLOOM_LOG_BITS (__builtin_ctz(__MRAM_BLOOM_NR_BITS))
+
+/**
+ * @struct mram_bloom
+ * @brief A Bloom filter, as declared by MRAM_BLOOM_INIT and located in MRAM by mram_bloom_attach.
+ */
+struct mram_bloom {
+    uintptr_t blocks;
+    uint32_t block_mask;
+    uint32_t nr_hashes;
+    struct mutex_pool *locks;
+    uint32_t (*cache)[MRAM_BLOOM_BLOCK_SIZE / sizeof(uint32_t)];
+    uint64_t (*keys)[MRAM_BLOOM_BATCH];
+};
+
+/**
+ * @def MRAM_BLOOM_INIT
+ * @hideinitializer
+ * @brief Declare and initialize a Bloom filter, with a pool of NB_MUTEXES hardware mutexes protecting the insertions.
+ */
+#define MRAM_BLOOM_INIT(NAME, NB_MUTEXES)                                                                                        \
+    MUTEX_POOL_INIT(mram_bloom_locks_##NAME, NB_MUTEXES);                                                                        \
+    __dma_aligned uint32_t mram_bloom_cache_##NAME[__MRAM_BLOOM_NR_TASKLETS][MRAM_BLOOM_BLOCK_SIZE / sizeof(uint32_t)];          \
+    __dma_aligned uint64_t mram_bloom_keys_##NAME[__MRAM_BLOOM_NR_TASKLETS][MRAM_BLOOM_BATCH];                                   \
+    struct mram_bloom NAME = { .blocks = 0,                                                                                      \
+        .block_mask = 0,                                                                                                         \
+        .nr_hashes = 0,                                                                                                          \
+        .locks = &mram_bloom_locks_##NAME,                                                                                       \
+        .cache = mram_bloom_cache_##NAME,                                                                                        \
+        .keys = mram_bloom_keys_##NAME };
+
+/**
+ * @fn mram_bloom_hash
+ * @brief The hashes of a key, also computed by dpu_bloom_hash on the host.
+ * @param key the key
+ * @param bits receives the hash giving the bits of the key in its block
+ * @return The hash giving the block of the key, from its low bits.
+ */
+static inline uint32_t
+mram_bloom_hash(uint64_t key, uint32_t *bits)
+{
+    uint32_t low = (uint32_t)key, high = (uint32_t)(key >> 32);
+
+    *bits = mram_hash_key(high ^ mram_hash_key(low + 0x7f4a7c15u));
+    return mram_hash_key(low ^ mram_hash_key(high + 0x9e3779b9u));
+}
+
+/**
+ * @fn mram_bloom_attach
+ * @brief Sets the MRAM location and the number of hashes of a Bloom filter.
+ * @param f the Bloom filter
+ * @param blocks the blocks of the filter, 8-byte aligned in MRAM
+ * @param nr_blocks the number of blocks, a power of 2
+ * @param nr_hashes the number of bits set by a key, from 1 to MRAM_BLOOM_MAX_HASHES
+ */
+static inline void
+mram_bloom_attach(struct mram_bloom *f, __mram_ptr void *blocks, uint32_t nr_blocks, uint32_t nr_hashes)
+{
+    f->blocks = (uintptr_t)blocks;
+    f->block_mask = nr_blocks - 1;
+    f->nr_hashes = nr_hashes;
+}
+
+static inline __mram_ptr void *
+__mram_bloom_block(struct mram_bloom *f, uint32_t block)
+{
+    return (__mram_ptr void *)(f->blocks + block * MRAM_BLOOM_BLOCK_SIZE);
+}
+
+/*
+ * The position in its block of the next bit of a key, taken from the unused bits of its hash.
+ */
+static inline uint32_t
+__mram_bloom_next(uint32_t *hash, uint32_t *unused, uint32_t *nr_unused)
+{
+    uint32_t position;
+
+    if (*nr_unused < __MRAM_BLOOM_LOG_BITS) {
+        *hash = mram_hash_key(*hash + 0x9e3779b9u);
+        *unused = *hash;
+        *nr_unused = 32;
+    }
+    position = *unused & (__MRAM_BLOOM_NR_BITS - 1);
+    *unused >>= __MRAM_BLOOM_LOG_BITS;
+    *nr_unused -= __MRAM_BLOOM_LOG_BITS;
+    return position;
+}
+
+/*
+ * Tests the bits of a key in a block held in WRAM, stopping at the first bit not set.
+ */
+static inline bool
+__mram_bloom_test(const uint32_t *words, uint32_t bits, uint32_t nr_hashes)
+{
+    uint32_t unused = bits, nr_unused = 32;
+
+    for (uint32_t each_hash = 0; each_hash < nr_hashes; each_hash++) {
+        uint32_t position = __mram_bloom_next(&bits, &unused, &nr_unused);
+        if ((words[position >> 5] & (1u << (position & 31))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Sets the bits of a key in a block held in WRAM.
+ */
+static inline void
+__mram_bloom_set(uint32_t *words, uint32_t bits, uint32_t nr_hashes)
+{
+    uint32_t unused = bits, nr_unused = 32;
+
+    for (uint32_t each_hash = 0; each_hash < nr_hashes; each_hash++) {
+        uint32_t position = __mram_bloom_next(&bits, &unused, &nr_unused);
+        words[position >> 5] |= 1u << (position & 31);
+    }
+}
+
+/**
+ * @fn mram_bloom_insert
+ * @brief Inserts a key in a Bloom filter.
+ * @param f the Bloom filter
+ * @param key the key
+ */
+static inline void
+mram_bloom_insert(struct mram_bloom *f, uint64_t key)
+{
+    uint32_t *cache = f->cache[me()], bits;
+    uint32_t block = mram_bloom_hash(key, &bits) & f->block_mask;
+    __mram_ptr void *address = __mram_bloom_block(f, block);
+
+    mutex_pool_lock(f->locks, block);
+    mram_read(address, cache, MRAM_BLOOM_BLOCK_SIZE);
+    __mram_bloom_set(cache, bits, f->nr_hashes);
+    mram_write(cache, address, MRAM_BLOOM_BLOCK_SIZE);
+    mutex_pool_unlock(f->locks, block);
+}
+
+/**
+ * @fn mram_bloom_contains
+ * @brief Probes a Bloom filter for a key.
+ * @param f the Bloom filter
+ * @param key the key
+ * @return false if the key was not inserted, true if it may have been.
+ */
+static inline bool
+mram_bloom_contains(struct mram_bloom *f, uint64_t key)
+{
+    uint32_t *cache = f->cache[me()], bits;
+    uint32_t block = mram_bloom_hash(key, &bits) & f->block_mask;
+
+    mram_read(__mram_bloom_block(f, block), cache, MRAM_BLOOM_BLOCK_SIZE);
+    return __mram_bloom_test(cache, bits, f->nr_hashes);
+}
+
+/**
+ * @fn mram_bloom_insert_keys
+ * @brief Inserts an array of keys in a Bloom filter, the work being split between all the tasklets.
+ *
+ * Every tasklet must call this function with the same keys. Each tasklet inserts batches of MRAM_BLOOM_BATCH keys, read
+ * with one DMA. The filter holds all the keys once every tasklet has returned.
+ *
+ * @param f the Bloom filter
+ * @param keys the keys, in MRAM
+ * @param nr_keys the number of keys
+ */
+static inline void
+mram_bloom_insert_keys(struct mram_bloom *f, const __mram_ptr uint64_t *keys, uint32_t nr_keys)
+{
+    uint64_t *batch = f->keys[me()];
+
+    for (uint32_t first = me() * MRAM_BLOOM_BATCH; first < nr_keys; first += __MRAM_BLOOM_NR_TASKLETS * MRAM_BLOOM_BATCH) {
+        uint32_t nr = nr_keys - first < MRAM_BLOOM_BATCH ? nr_keys - first : MRAM_BLOOM_BATCH;
+        mram_read(&keys[first], batch, nr * sizeof(uint64_t));
+        for (uint32_t i = 0; i < nr; i++) {
+            mram_bloom_insert(f, batch[i]);
+        }
+    }
+}
+
+/**
+ * @fn mram_bloom_probe_keys
+ * @brief Probes a Bloom filter for an array of keys, the work being split between all the tasklets.
+ *
+ * Every tasklet must call this function with the same keys and results. Each tasklet probes batches of MRAM_BLOOM_BATCH
+ * keys, read with one DMA, and writes the 64 bits of results of a batch with one DMA. Bit i % 64 of results[i / 64] is
+ * set when key i may have been inserted; the bits following the last key in its word are cleared.
+ *
+ * @param f the Bloom filter
+ * @param keys the keys, in MRAM
+ * @param nr_keys the number of keys
+ * @param results receives the results, (nr_keys + 63) / 64 words in MRAM
+ * @return The number of keys probed by the invoking tasklet which may have been inserted.
+ */
+static inline uint32_t
+mram_bloom_probe_keys(struct mram_bloom *f, const __mram_ptr uint64_t *keys, uint32_t nr_keys, __mram_ptr uint64_t *results)
+{
+    uint64_t *batch = f->keys[me()];
+    uint32_t *cache = f->cache[me()];
+    uint32_t nr_found = 0;
+
+    for (uint32_t first = me() * MRAM_BLOOM_BATCH; first < nr_keys; first += __MRAM_BLOOM_NR_TASKLETS * MRAM_BLOOM_BATCH) {
+        uint32_t nr = nr_keys - first < MRAM_BLOOM_BATCH ? nr_keys - first : MRAM_BLOOM_BATCH;
+        __dma_aligned uint64_t found = 0;
+
+        mram_read(&keys[first], batch, nr * sizeof(uint64_t));
+        for (uint32_t i = 0; i < nr; i++) {
+            uint32_t bits;
+            uint32_t block = mram_bloom_hash(batch[i], &bits) & f->block_mask;
+            mram_read(__mram_bloom_block(f, block), cache, MRAM_BLOOM_BLOCK_SIZE);
+            if (__mram_bloom_test(cache, bits, f->nr_hashes)) {
+                found |= (uint64_t)1 << i;
+            }
+        }
+        mram_write(&found, &results[first / MRAM_BLOOM_BATCH], sizeof(found));
+        nr_found += __builtin_popcount((uint32_t)found) + __builtin_popcount((uint32_t)(found >> 32));
+    }
+    return nr_found;
+}
+
+#endif /* DPUSYSCORE_MRAM_BLOOM_H */
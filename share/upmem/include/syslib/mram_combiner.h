@@ -0,0 +1,218 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_COMBINER_H
+#define DPUSYSCORE_MRAM_COMBINER_H
+
+/**
+ * @file mram_combiner.h
+ * @brief Batched atomic updates of integers in MRAM, combined in WRAM.
+ *
+ * mram_update_int_atomic performs a locked 8-byte read-modify-write of MRAM for every single update, which dominates the
+ * execution time of kernels updating histograms or counters stored in MRAM.
+ *
+ * An update combiner gives each tasklet a small hash table in WRAM, indexed by 8-byte MRAM line. Updates to the same
+ * line are combined in WRAM with the operation of the combiner (add, min, max or or) and each line is written back to
+ * MRAM with a single locked read-modify-write when the table fills up or when the tasklet calls mram_combiner_flush.
+ *
+ * The combiner uses the same virtual mutexes as mram_update_int_atomic and mram_write_int_atomic (see mram_unaligned.h),
+ * so that both APIs can be used on the same MRAM area.
+ *
+ * The size of the table of each tasklet is defined by MRAM_COMBINER_CAPACITY (a power of 2, 64 lines by default, each
+ * line taking 16 bytes of WRAM).
+ */
+
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <vmutex.h>
+#include <mram_unaligned.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_COMBINER_CAPACITY
+/**
+ * @def MRAM_COMBINER_CAPACITY
+ * @hideinitializer
+ * @brief Number of MRAM lines that a tasklet can hold in its table before it is flushed.
+ */
+#define MRAM_COMBINER_CAPACITY 64
+#endif
+
+_Static_assert((MRAM_COMBINER_CAPACITY & (MRAM_COMBINER_CAPACITY - 1)) == 0 && MRAM_COMBINER_CAPACITY >= 8,
+    "mram_combiner error: capacity must be a power of 2 of at least 8");
+
+#ifdef NR_TASKLETS
+#define __MRAM_COMBINER_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_COMBINER_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/* The table is flushed when it is three quarters full, to keep the probe sequences short. */
+#define __MRAM_COMBINER_THRESHOLD ((MRAM_COMBINER_CAPACITY >> 1) + (MRAM_COMBINER_CAPACITY >> 2))
+#define __MRAM_COMBINER_EMPTY 0xffffffffu
+
+/**
+ * @enum mram_combiner_op_t
+ * @brief The operation applied by a combiner to the integers in MRAM.
+ *
+ * @var MRAM_COMBINER_ADD  *dest += value
+ * @var MRAM_COMBINER_MIN  *dest = min(*dest, value), as signed integers
+ * @var MRAM_COMBINER_MAX  *dest = max(*dest, value), as signed integers
+ * @var MRAM_COMBINER_OR   *dest |= value
+ */
+typedef enum _mram_combiner_op_t {
+    MRAM_COMBINER_ADD = 0,
+    MRAM_COMBINER_MIN = 1,
+    MRAM_COMBINER_MAX = 2,
+    MRAM_COMBINER_OR = 3,
+} mram_combiner_op_t;
+
+/*
+ * A pending update of one 8-byte MRAM line: the two 32-bit halves and which of them have been updated.
+ */
+struct __mram_combiner_line {
+    uint32_t line;
+    uint32_t valid;
+    int32_t values[2];
+};
+
+/**
+ * @struct mram_combiner
+ * @brief An update combiner, as declared by MRAM_COMBINER_INIT.
+ */
+struct mram_combiner {
+    mram_combiner_op_t op;
+    struct __mram_combiner_line (*tables)[MRAM_COMBINER_CAPACITY];
+    uint32_t *nr_lines;
+};
+
+/**
+ * @def MRAM_COMBINER_INIT
+ * @hideinitializer
+ * @brief Declare and initialize an update combiner applying the given operation.
+ */
+#define MRAM_COMBINER_INIT(NAME, OP)                                                                                             \
+    struct __mram_combiner_line mram_combiner_tables_##NAME[__MRAM_COMBINER_NR_TASKLETS][MRAM_COMBINER_CAPACITY] = {              \
+        [0 ...(__MRAM_COMBINER_NR_TASKLETS - 1)] = { [0 ...(MRAM_COMBINER_CAPACITY - 1)] = { .line = __MRAM_COMBINER_EMPTY } }   \
+    };                                                                                                                           \
+    uint32_t mram_combiner_nr_lines_##NAME[__MRAM_COMBINER_NR_TASKLETS] = { 0 };                                                 \
+    struct mram_combiner NAME = { .op = (OP), .tables = mram_combiner_tables_##NAME, .nr_lines = mram_combiner_nr_lines_##NAME };
+
+static inline int32_t
+__mram_combiner_apply(mram_combiner_op_t op, int32_t current, int32_t value)
+{
+    switch (op) {
+        case MRAM_COMBINER_ADD:
+            return current + value;
+        case MRAM_COMBINER_MIN:
+            return value < current ? value : current;
+        case MRAM_COMBINER_MAX:
+            return value > current ? value : current;
+        default:
+            return current | value;
+    }
+}
+
+/**
+ * @fn mram_combiner_flush
+ * @brief Applies to MRAM all the updates pending in the table of the invoking tasklet.
+ *
+ * Each MRAM line is updated with one locked 8-byte read-modify-write.
+ * A tasklet must flush its table before the updated integers are read by other tasklets or by the host.
+ *
+ * @param c the combiner
+ */
+static inline void
+mram_combiner_flush(struct mram_combiner *c)
+{
+    sysname_t id = me();
+    struct __mram_combiner_line *table = c->tables[id];
+    int32_t *buffer = (int32_t *)&__mram_unaligned_access_buffer[id << 3];
+
+    if (c->nr_lines[id] == 0) {
+        return;
+    }
+
+    for (unsigned int each_slot = 0; each_slot < MRAM_COMBINER_CAPACITY; each_slot++) {
+        struct __mram_combiner_line *pending = &table[each_slot];
+        uint32_t line = pending->line;
+        uint16_t lock;
+        __mram_ptr void *address;
+
+        if (line == __MRAM_COMBINER_EMPTY) {
+            continue;
+        }
+
+        lock = line & ((1 << __MRAM_UNALIGNED_ACCESS_LOG_NB_VLOCK) - 1);
+        address = (__mram_ptr void *)(uintptr_t)(line << 3);
+
+        vmutex_lock(&__mram_unaligned_access_virtual_locks, lock);
+        mram_read(address, buffer, 8);
+        if (pending->valid & 1) {
+            buffer[0] = __mram_combiner_apply(c->op, buffer[0], pending->values[0]);
+        }
+        if (pending->valid & 2) {
+            buffer[1] = __mram_combiner_apply(c->op, buffer[1], pending->values[1]);
+        }
+        mram_write(buffer, address, 8);
+        vmutex_unlock(&__mram_unaligned_access_virtual_locks, lock);
+
+        pending->line = __MRAM_COMBINER_EMPTY;
+    }
+
+    c->nr_lines[id] = 0;
+}
+
+/**
+ * @fn mram_combiner_update
+ * @brief Records an update of an integer in MRAM.
+ *
+ * The update is combined in WRAM with the pending updates of the same MRAM line. The table of the invoking tasklet is
+ * flushed first if it is full. The integer in MRAM is only modified when the table is flushed.
+ *
+ * @param c the combiner
+ * @param dest the address of the integer in MRAM, which must be a multiple of 4
+ * @param value the operand of the operation of the combiner
+ */
+static inline void
+mram_combiner_update(struct mram_combiner *c, __mram_ptr int32_t *dest, int32_t value)
+{
+    sysname_t id = me();
+    struct __mram_combiner_line *table = c->tables[id];
+    uint32_t line = (uintptr_t)dest >> 3;
+    uint32_t half = ((uintptr_t)dest >> 2) & 1;
+    uint32_t slot = (line ^ (line >> 6)) & (MRAM_COMBINER_CAPACITY - 1);
+
+    for (;;) {
+        struct __mram_combiner_line *pending = &table[slot];
+
+        if (pending->line == line) {
+            if (pending->valid & (1 << half)) {
+                pending->values[half] = __mram_combiner_apply(c->op, pending->values[half], value);
+            } else {
+                pending->values[half] = value;
+                pending->valid |= 1 << half;
+            }
+            return;
+        }
+
+        if (pending->line == __MRAM_COMBINER_EMPTY) {
+            if (c->nr_lines[id] == __MRAM_COMBINER_THRESHOLD) {
+                mram_combiner_flush(c);
+                slot = (line ^ (line >> 6)) & (MRAM_COMBINER_CAPACITY - 1);
+                pending = &table[slot];
+            }
+            pending->line = line;
+            pending->valid = 1 << half;
+            pending->values[half] = value;
+            c->nr_lines[id]++;
+            return;
+        }
+
+        slot = (slot + 1) & (MRAM_COMBINER_CAPACITY - 1);
+    }
+}
+
+#endif /* DPUSYSCORE_MRAM_COMBINER_H */
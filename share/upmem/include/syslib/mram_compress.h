@@ -0,0 +1,426 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_COMPRESS_H
+#define DPUSYSCORE_MRAM_COMPRESS_H
+
+/**
+ * @file mram_compress.h
+ * @brief Decompression into WRAM of integer columns and byte streams stored compressed in MRAM.
+ *
+ * The data is compressed by the host (see dpu_compress.h) into an image, which is copied to MRAM as it is. Two formats
+ * are supported:
+ *  - integer columns in frame of reference: the values are split in blocks of MRAM_COMPRESS_FOR_BLOCK values, and each
+ *    block stores the difference of its values to their minimum on the number of bits of the largest one. The values can
+ *    be replaced by the difference to the previous value before, for sorted or slowly varying columns. The bits are
+ *    packed in 4 interleaved lanes of 32 values (the layout of the SIMD encoder of the host).
+ *  - byte streams in LZ4: the bytes are split in blocks of at most MRAM_COMPRESS_LZ4_BLOCK_SIZE bytes, each compressed
+ *    independently in the LZ4 block format, or stored as they are when they do not compress.
+ *
+ * Each block has a descriptor at a fixed place in the image, so that the blocks are decompressed in any order. A scan
+ * decompresses each block into the WRAM of the tasklet with mram_compress_for_get or mram_compress_lz4_get, and reads it
+ * there: the bytes read from MRAM are the compressed ones. mram_compress_for_decompress and mram_compress_lz4_decompress
+ * decompress a whole image to MRAM with all the tasklets.
+ *
+ * The WRAM used by each tasklet is 2 * MRAM_COMPRESS_LZ4_BLOCK_SIZE bytes: 2048 bytes with the default parameters.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_COMPRESS_LZ4_BLOCK_SIZE
+/**
+ * @def MRAM_COMPRESS_LZ4_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Maximum size of the blocks of an LZ4 image, which is the size of the WRAM buffers of each tasklet.
+ */
+#define MRAM_COMPRESS_LZ4_BLOCK_SIZE 1024
+#endif
+
+_Static_assert((MRAM_COMPRESS_LZ4_BLOCK_SIZE & 7) == 0 && MRAM_COMPRESS_LZ4_BLOCK_SIZE >= 1024
+        && MRAM_COMPRESS_LZ4_BLOCK_SIZE <= 2048,
+    "mram_compress error: invalid block size defined");
+
+/**
+ * @def MRAM_COMPRESS_FOR_BLOCK
+ * @brief Number of values of the blocks of a frame of reference image. Shared with the host, cannot be changed.
+ */
+#define MRAM_COMPRESS_FOR_BLOCK 128
+
+#ifdef NR_TASKLETS
+#define __MRAM_COMPRESS_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_COMPRESS_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @struct mram_compress_for_header
+ * @brief The start of a frame of reference image, followed by the descriptors of its blocks.
+ */
+struct mram_compress_for_header {
+    /** The number of values. */
+    uint32_t nr_values;
+    /** The number of blocks. */
+    uint32_t nr_blocks;
+    uint32_t reserved[2];
+};
+
+/**
+ * @struct mram_compress_for_block
+ * @brief The descriptor of a block of a frame of reference image.
+ *
+ * Value i of the block is reference + packed[i]. When delta is set, it is the sum of first and of reference + packed[k]
+ * for k from 0 to i, where reference + packed[0] is 0.
+ */
+struct mram_compress_for_block {
+    /** The offset of the packed bits in the image, 8-byte aligned. */
+    uint32_t offset;
+    /** The number of values of the block. */
+    uint16_t nr_values;
+    /** The number of bits of each packed value, from 0 to 32. */
+    uint8_t width;
+    /** Whether the packed values are the differences to the previous value. */
+    uint8_t delta;
+    /** The minimum of the values, or of the differences. */
+    int32_t reference;
+    /** The first value of the block, with delta. */
+    int32_t first;
+};
+
+/**
+ * @struct mram_compress_lz4_header
+ * @brief The start of an LZ4 image, followed by the descriptors of its blocks.
+ */
+struct mram_compress_lz4_header {
+    /** The number of bytes. */
+    uint32_t length;
+    /** The number of bytes of each block but the last one, a multiple of 8. */
+    uint32_t block_size;
+    /** The number of blocks. */
+    uint32_t nr_blocks;
+    uint32_t reserved;
+};
+
+/**
+ * @struct mram_compress_lz4_block
+ * @brief The descriptor of a block of an LZ4 image. The block is stored as it is when size equals length.
+ */
+struct mram_compress_lz4_block {
+    /** The offset of the compressed block in the image, 8-byte aligned. */
+    uint32_t offset;
+    /** The size of the compressed block. */
+    uint16_t size;
+    /** The number of bytes of the block. */
+    uint16_t length;
+};
+
+/**
+ * @struct mram_compress
+ * @brief The WRAM state of the decompressions, as declared by MRAM_COMPRESS_INIT.
+ */
+struct mram_compress {
+    barrier_t *barrier;
+    volatile uint32_t failed;
+    uint8_t (*inputs)[MRAM_COMPRESS_LZ4_BLOCK_SIZE];
+    uint8_t (*outputs)[MRAM_COMPRESS_LZ4_BLOCK_SIZE];
+};
+
+/**
+ * @def MRAM_COMPRESS_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the decompressions.
+ */
+#define MRAM_COMPRESS_INIT(NAME)                                                                                                 \
+    BARRIER_INIT(mram_compress_barrier_##NAME, __MRAM_COMPRESS_NR_TASKLETS);                                                     \
+    __dma_aligned uint8_t mram_compress_inputs_##NAME[__MRAM_COMPRESS_NR_TASKLETS][MRAM_COMPRESS_LZ4_BLOCK_SIZE];                \
+    __dma_aligned uint8_t mram_compress_outputs_##NAME[__MRAM_COMPRESS_NR_TASKLETS][MRAM_COMPRESS_LZ4_BLOCK_SIZE];               \
+    struct mram_compress NAME = { .barrier = &mram_compress_barrier_##NAME,                                                      \
+        .failed = 0,                                                                                                             \
+        .inputs = mram_compress_inputs_##NAME,                                                                                   \
+        .outputs = mram_compress_outputs_##NAME };
+
+/* Unpacks the 4 interleaved lanes of 32 values of the given width. Reads one word past the packed bits of each lane. */
+static inline void
+__mram_compress_unpack(const uint32_t *packed, uint32_t width, uint32_t *values)
+{
+    uint32_t mask = width == 32 ? 0xffffffff : (1u << width) - 1;
+
+    for (uint32_t lane = 0; lane < 4; lane++) {
+        const uint32_t *words = &packed[lane];
+        uint32_t word = *words, shift = 0;
+
+        for (uint32_t each_value = lane; each_value < MRAM_COMPRESS_FOR_BLOCK; each_value += 4) {
+            uint32_t value = word >> shift;
+            shift += width;
+            if (shift >= 32) {
+                shift -= 32;
+                words += 4;
+                word = *words;
+                if (shift != 0) {
+                    value |= word << (width - shift);
+                }
+            }
+            values[each_value] = value & mask;
+        }
+    }
+}
+
+/**
+ * @fn mram_compress_for_get
+ * @brief Decompresses a block of a frame of reference image into the WRAM of the invoking tasklet.
+ *
+ * The values stay valid until the next call of the tasklet.
+ *
+ * @param c the state of the decompressions
+ * @param image the image in MRAM, 8-byte aligned
+ * @param block the index of the block
+ * @param nr_values receives the number of values of the block
+ * @return The values of the block, or NULL if its descriptor is invalid.
+ */
+static inline int32_t *
+mram_compress_for_get(struct mram_compress *c, const __mram_ptr uint8_t *image, uint32_t block, uint32_t *nr_values)
+{
+    sysname_t id = me();
+    uint32_t *packed = (uint32_t *)c->inputs[id];
+    uint32_t *values = (uint32_t *)c->outputs[id];
+    struct mram_compress_for_block *descriptor = (struct mram_compress_for_block *)values;
+    uint32_t n, width, reference;
+
+    mram_read(&image[sizeof(struct mram_compress_for_header) + block * sizeof(struct mram_compress_for_block)],
+        descriptor,
+        sizeof(struct mram_compress_for_block));
+    n = descriptor->nr_values;
+    width = descriptor->width;
+    reference = (uint32_t)descriptor->reference;
+    if (n > MRAM_COMPRESS_FOR_BLOCK || width > 32) {
+        return NULL;
+    }
+
+    if (descriptor->delta) {
+        uint32_t value = (uint32_t)descriptor->first;
+        if (width != 0) {
+            mram_read(&image[descriptor->offset], packed, MRAM_COMPRESS_FOR_BLOCK / 8 * width);
+            __mram_compress_unpack(packed, width, values);
+        } else {
+            memset(values, 0, n * sizeof(uint32_t));
+        }
+        for (uint32_t each_value = 0; each_value < n; each_value++) {
+            value += reference + values[each_value];
+            values[each_value] = value;
+        }
+    } else if (width != 0) {
+        mram_read(&image[descriptor->offset], packed, MRAM_COMPRESS_FOR_BLOCK / 8 * width);
+        __mram_compress_unpack(packed, width, values);
+        for (uint32_t each_value = 0; each_value < n; each_value++) {
+            values[each_value] += reference;
+        }
+    } else {
+        for (uint32_t each_value = 0; each_value < n; each_value++) {
+            values[each_value] = reference;
+        }
+    }
+
+    *nr_values = n;
+    return (int32_t *)values;
+}
+
+/* Decodes an LZ4 block of size bytes into length bytes, checking that it stays within the buffers. */
+static inline bool
+__mram_compress_lz4_decode(const uint8_t *in, uint32_t size, uint8_t *out, uint32_t length)
+{
+    const uint8_t *in_end = in + size;
+    uint8_t *op = out, *out_end = out + length;
+
+    while (in < in_end) {
+        uint32_t token = *in++;
+        uint32_t n = token >> 4, offset;
+        const uint8_t *match;
+
+        if (n == 15) {
+            uint32_t extension;
+            do {
+                if (in == in_end) {
+                    return false;
+                }
+                extension = *in++;
+                n += extension;
+            } while (extension == 255);
+        }
+        if (n > (uint32_t)(in_end - in) || n > (uint32_t)(out_end - op)) {
+            return false;
+        }
+        memcpy(op, in, n);
+        op += n;
+        in += n;
+        /* The last sequence has no match. */
+        if (in == in_end) {
+            break;
+        }
+
+        if (in_end - in < 2) {
+            return false;
+        }
+        offset = in[0] | (in[1] << 8);
+        in += 2;
+        n = (token & 15) + 4;
+        if ((token & 15) == 15) {
+            uint32_t extension;
+            do {
+                if (in == in_end) {
+                    return false;
+                }
+                extension = *in++;
+                n += extension;
+            } while (extension == 255);
+        }
+        if (offset == 0 || offset > (uint32_t)(op - out) || n > (uint32_t)(out_end - op)) {
+            return false;
+        }
+        /* The match overlaps the output when offset < n: it is copied byte by byte. */
+        match = op - offset;
+        for (uint32_t each_byte = 0; each_byte < n; each_byte++) {
+            op[each_byte] = match[each_byte];
+        }
+        op += n;
+    }
+    return op == out_end;
+}
+
+/**
+ * @fn mram_compress_lz4_get
+ * @brief Decompresses a block of an LZ4 image into the WRAM of the invoking tasklet.
+ *
+ * The bytes stay valid until the next call of the tasklet.
+ *
+ * @param c the state of the decompressions
+ * @param image the image in MRAM, 8-byte aligned
+ * @param block the index of the block
+ * @param length receives the number of bytes of the block
+ * @return The bytes of the block, or NULL if the block is invalid or larger than MRAM_COMPRESS_LZ4_BLOCK_SIZE.
+ */
+static inline uint8_t *
+mram_compress_lz4_get(struct mram_compress *c, const __mram_ptr uint8_t *image, uint32_t block, uint32_t *length)
+{
+    sysname_t id = me();
+    uint8_t *in = c->inputs[id];
+    uint8_t *out = c->outputs[id];
+    struct mram_compress_lz4_block *descriptor = (struct mram_compress_lz4_block *)out;
+    uint32_t offset, size, n;
+
+    mram_read(&image[sizeof(struct mram_compress_lz4_header) + block * sizeof(struct mram_compress_lz4_block)],
+        descriptor,
+        sizeof(struct mram_compress_lz4_block));
+    offset = descriptor->offset;
+    size = descriptor->size;
+    n = descriptor->length;
+    if (size == 0 || size > MRAM_COMPRESS_LZ4_BLOCK_SIZE || n > MRAM_COMPRESS_LZ4_BLOCK_SIZE || size > n) {
+        return NULL;
+    }
+
+    mram_read(&image[offset], in, (size + 7) & ~7);
+    *length = n;
+    /* A block stored as it is is read in place. */
+    if (size == n) {
+        return in;
+    }
+    return __mram_compress_lz4_decode(in, size, out, n) ? out : NULL;
+}
+
+/* Resets the failure flag of the decompressions, before the tasklets start. */
+static inline void
+__mram_compress_start(struct mram_compress *c)
+{
+    if (me() == 0) {
+        c->failed = 0;
+    }
+    barrier_wait(c->barrier);
+}
+
+/* Waits for all the tasklets and returns whether none of them failed. */
+static inline bool
+__mram_compress_end(struct mram_compress *c)
+{
+    bool success;
+
+    barrier_wait(c->barrier);
+    success = c->failed == 0;
+    barrier_wait(c->barrier);
+    return success;
+}
+
+/**
+ * @fn mram_compress_for_decompress
+ * @brief Decompresses a frame of reference image to MRAM, with all the tasklets.
+ *
+ * Must be called by all the tasklets, with the same arguments. The values are complete when the tasklets return.
+ *
+ * @param c the state of the decompressions
+ * @param image the image in MRAM, 8-byte aligned
+ * @param values the MRAM array receiving the values, 8-byte aligned, with room for an even number of values
+ * @return Whether the image was valid.
+ */
+static inline bool
+mram_compress_for_decompress(struct mram_compress *c, const __mram_ptr uint8_t *image, __mram_ptr int32_t *values)
+{
+    uint32_t nr_blocks;
+
+    __mram_compress_start(c);
+    mram_read(image, c->inputs[me()], sizeof(struct mram_compress_for_header));
+    nr_blocks = ((struct mram_compress_for_header *)c->inputs[me()])->nr_blocks;
+
+    for (uint32_t each_block = me(); each_block < nr_blocks; each_block += __MRAM_COMPRESS_NR_TASKLETS) {
+        uint32_t n;
+        int32_t *block = mram_compress_for_get(c, image, each_block, &n);
+        if (block == NULL) {
+            c->failed = 1;
+            break;
+        }
+        if (n != 0) {
+            mram_write(block, &values[each_block * MRAM_COMPRESS_FOR_BLOCK], ((n + 1) & ~1) * sizeof(int32_t));
+        }
+    }
+    return __mram_compress_end(c);
+}
+
+/**
+ * @fn mram_compress_lz4_decompress
+ * @brief Decompresses an LZ4 image to MRAM, with all the tasklets.
+ *
+ * Must be called by all the tasklets, with the same arguments. The bytes are complete when the tasklets return.
+ *
+ * @param c the state of the decompressions
+ * @param image the image in MRAM, 8-byte aligned
+ * @param bytes the MRAM buffer receiving the bytes, 8-byte aligned, with room for their number rounded up to 8
+ * @return Whether the image was valid.
+ */
+static inline bool
+mram_compress_lz4_decompress(struct mram_compress *c, const __mram_ptr uint8_t *image, __mram_ptr uint8_t *bytes)
+{
+    struct mram_compress_lz4_header *header = (struct mram_compress_lz4_header *)c->inputs[me()];
+    uint32_t nr_blocks, block_size;
+
+    __mram_compress_start(c);
+    mram_read(image, header, sizeof(struct mram_compress_lz4_header));
+    nr_blocks = header->nr_blocks;
+    block_size = header->block_size;
+
+    for (uint32_t each_block = me(); each_block < nr_blocks; each_block += __MRAM_COMPRESS_NR_TASKLETS) {
+        uint32_t n;
+        uint8_t *block = mram_compress_lz4_get(c, image, each_block, &n);
+        if (block == NULL) {
+            c->failed = 1;
+            break;
+        }
+        mram_write(block, &bytes[each_block * block_size], (n + 7) & ~7);
+    }
+    return __mram_compress_end(c);
+}
+
+#endif /* DPUSYSCORE_MRAM_COMPRESS_H */
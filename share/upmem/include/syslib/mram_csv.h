@@ -0,0 +1,522 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_CSV_H
+#define DPUSYSCORE_MRAM_CSV_H
+
+/**
+ * @file mram_csv.h
+ * @brief Parsing of delimited text (CSV) from MRAM into MRAM columns.
+ *
+ * The records are separated by newlines, and their fields by a delimiter. A field can be quoted with double quotes to hold
+ * delimiters and newlines, a double quote being written twice inside a quoted field. As in the SIMD parsers of the host,
+ * the bytes between an odd and the following even double quote of the text are quoted: a quoted field needs not span the
+ * whole field, and a newline is a record separator if the number of double quotes before it is even. A carriage return
+ * before a newline is dropped.
+ *
+ * The text is split evenly between the tasklets, in two passes:
+ *  - each tasklet counts the double quotes of its part, and the newlines following an even and an odd number of double
+ *    quotes of its part. The exclusive prefix sum of the double quotes gives the quoting state at the start of each part,
+ *    which gives its number of records and, with a second prefix sum, the index of its first record,
+ *  - each tasklet parses the records starting after a newline of its part, the first tasklet also parsing the record
+ *    starting the text. The last record of a tasklet generally ends in the part of the next one.
+ * Both passes test 4 bytes at a time for the bytes they look for, and the integer fields are converted 4 digits at a time.
+ *
+ * Each field of the schema is skipped, or written to its own MRAM column at the index of the record: the tasklets write
+ * their values through the write-combining lines of mram_scatter.h, which merge the 8-byte words they share with the
+ * neighbouring tasklets. The integer fields are signed decimal numbers, with an optional sign. The fixed-point fields
+ * have a decimal point followed by up to scale decimals, and are written as integers multiplied by 10 to the power of
+ * scale: the decimals past scale are dropped. An empty number is 0. An invalid number, or a number not fitting in its
+ * column, is written as 0 and counted as an error. The string fields are written as the offset and length of their bytes
+ * in the text, without their enclosing double quotes: the double quotes they hold are still written twice. The missing
+ * fields at the end of a record are written as empty fields, and the fields past the schema are skipped.
+ *
+ * The WRAM used by each tasklet is MRAM_CSV_WINDOW + MRAM_CSV_MAX_FIELDS * (MRAM_CSV_LINE_SIZE + 8) bytes: 896 bytes
+ * with the default parameters.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <mram_scatter.h>
+#include <tasklet_scan.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_CSV_WINDOW
+/**
+ * @def MRAM_CSV_WINDOW
+ * @hideinitializer
+ * @brief Size of the window of the text read by each tasklet, which is the size of the DMAs reading the text.
+ */
+#define MRAM_CSV_WINDOW 256
+#endif
+
+#ifndef MRAM_CSV_LINE_SIZE
+/**
+ * @def MRAM_CSV_LINE_SIZE
+ * @hideinitializer
+ * @brief Size of the write-combining line of each tasklet for each field, which is the size of the DMAs writing the
+ * columns.
+ */
+#define MRAM_CSV_LINE_SIZE 32
+#endif
+
+_Static_assert((MRAM_CSV_WINDOW & 7) == 0 && MRAM_CSV_WINDOW >= 64 && MRAM_CSV_WINDOW <= 2048,
+    "mram_csv error: invalid window size defined");
+
+/**
+ * @def MRAM_CSV_MAX_FIELDS
+ * @brief Maximum number of fields of a schema. Shared with the host, cannot be changed.
+ */
+#define MRAM_CSV_MAX_FIELDS 16
+
+/**
+ * @def MRAM_CSV_MAX_SCALE
+ * @brief Maximum number of decimals of a fixed-point field.
+ */
+#define MRAM_CSV_MAX_SCALE 9
+
+#ifdef NR_TASKLETS
+#define __MRAM_CSV_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_CSV_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @enum mram_csv_type_t
+ * @brief The types of the fields, which set the type of the elements of their columns.
+ */
+typedef enum _mram_csv_type_t {
+    /** The field is not written. */
+    MRAM_CSV_SKIP = 0,
+    /** An int32_t. */
+    MRAM_CSV_INT32 = 1,
+    /** An int64_t. */
+    MRAM_CSV_INT64 = 2,
+    /** A fixed-point number, as an int32_t. */
+    MRAM_CSV_FIXED32 = 3,
+    /** A fixed-point number, as an int64_t. */
+    MRAM_CSV_FIXED64 = 4,
+    /** A struct mram_csv_string. */
+    MRAM_CSV_STRING = 5,
+} mram_csv_type_t;
+
+/**
+ * @struct mram_csv_schema
+ * @brief The fields of the records, as built by the host: the layout is identical to struct dpu_csv_schema.
+ */
+struct mram_csv_schema {
+    /** The byte separating the fields. */
+    uint8_t delimiter;
+    /** The number of fields of the schema. */
+    uint8_t nr_fields;
+    uint8_t reserved[2];
+    /** The type of each field, an mram_csv_type_t. */
+    uint8_t types[MRAM_CSV_MAX_FIELDS];
+    /** The number of decimals of each fixed-point field. */
+    uint8_t scales[MRAM_CSV_MAX_FIELDS];
+};
+
+/**
+ * @struct mram_csv_string
+ * @brief The element of the column of a string field.
+ */
+struct mram_csv_string {
+    /** The offset of the first byte of the string in the text. */
+    uint32_t offset;
+    /** The length of the string, in bytes. */
+    uint32_t length;
+};
+
+/**
+ * @struct mram_csv
+ * @brief The WRAM state of the parsing, as declared by MRAM_CSV_INIT.
+ */
+struct mram_csv {
+    struct tasklet_scan *scan;
+    struct mram_scatter *scatter;
+    uint8_t (*windows)[MRAM_CSV_WINDOW];
+};
+
+/**
+ * @def MRAM_CSV_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the parsing.
+ */
+#define MRAM_CSV_INIT(NAME)                                                                                                      \
+    TASKLET_SCAN_INIT(mram_csv_scan_##NAME, 0);                                                                                  \
+    MRAM_SCATTER_INIT(mram_csv_scatter_##NAME, MRAM_CSV_MAX_FIELDS, MRAM_CSV_LINE_SIZE);                                         \
+    __dma_aligned uint8_t mram_csv_windows_##NAME[__MRAM_CSV_NR_TASKLETS][MRAM_CSV_WINDOW];                                      \
+    struct mram_csv NAME = { .scan = &mram_csv_scan_##NAME,                                                                      \
+        .scatter = &mram_csv_scatter_##NAME,                                                                                     \
+        .windows = mram_csv_windows_##NAME };
+
+#define __MRAM_CSV_ONES 0x01010101u
+#define __MRAM_CSV_QUOTES ('"' * __MRAM_CSV_ONES)
+#define __MRAM_CSV_NEWLINES ('\n' * __MRAM_CSV_ONES)
+
+/* Non-zero if one of the bytes of a word is equal to the byte repeated in pattern. */
+static inline uint32_t
+__mram_csv_has(uint32_t word, uint32_t pattern)
+{
+    uint32_t x = word ^ pattern;
+    return (x - __MRAM_CSV_ONES) & ~x & 0x80808080u;
+}
+
+/* The window of the text of a tasklet: the bytes [base, base + MRAM_CSV_WINDOW) of the text, base being 8-byte aligned. */
+struct __mram_csv_reader {
+    const __mram_ptr uint8_t *text;
+    uint32_t length;
+    uint32_t base;
+    uint8_t *window;
+};
+
+/* Moves the window so that it holds the bytes [position, position + size). */
+static inline void
+__mram_csv_seek(struct __mram_csv_reader *r, uint32_t position, uint32_t size)
+{
+    if (position < r->base || position + size > r->base + MRAM_CSV_WINDOW) {
+        r->base = position & ~7;
+        mram_read(&r->text[r->base], r->window, MRAM_CSV_WINDOW);
+    }
+}
+
+static inline uint32_t
+__mram_csv_byte(struct __mram_csv_reader *r, uint32_t position)
+{
+    __mram_csv_seek(r, position, 1);
+    return r->window[position - r->base];
+}
+
+/* The 4 bytes of the text starting at position, as a little-endian word. */
+static inline uint32_t
+__mram_csv_word(struct __mram_csv_reader *r, uint32_t position)
+{
+    uint32_t offset, shift;
+    const uint32_t *words;
+
+    __mram_csv_seek(r, position, 4);
+    offset = position - r->base;
+    shift = (offset & 3) << 3;
+    words = (const uint32_t *)&r->window[offset & ~3];
+    return shift == 0 ? words[0] : (words[0] >> shift) | (words[1] << (32 - shift));
+}
+
+/*
+ * Returns the position of the first double quote from position, or, when not quoted, of the first double quote, delimiter
+ * or newline. Returns the length of the text if there is none.
+ */
+static inline uint32_t
+__mram_csv_find(struct __mram_csv_reader *r, uint32_t position, uint32_t delimiter, bool quoted)
+{
+    uint32_t delimiters = delimiter * __MRAM_CSV_ONES;
+
+    while (position < r->length) {
+        uint32_t c = __mram_csv_byte(r, position);
+        uint32_t offset = position - r->base;
+
+        if ((offset & 3) == 0 && offset + 4 <= MRAM_CSV_WINDOW) {
+            uint32_t word = *(const uint32_t *)&r->window[offset];
+            uint32_t found = __mram_csv_has(word, __MRAM_CSV_QUOTES);
+            if (!quoted) {
+                found |= __mram_csv_has(word, delimiters) | __mram_csv_has(word, __MRAM_CSV_NEWLINES);
+            }
+            if (found == 0) {
+                position += 4;
+                continue;
+            }
+        }
+        if (c == '"' || (!quoted && (c == delimiter || c == '\n'))) {
+            return position;
+        }
+        position++;
+    }
+    return r->length;
+}
+
+/* The value of 4 ASCII digits, the first one in the low byte of the word, or UINT32_MAX if one of them is not a digit. */
+static inline uint32_t
+__mram_csv_digits4(uint32_t word)
+{
+    uint32_t pairs;
+
+    if ((word & 0xf0f0f0f0u) != 0x30303030u || ((word + 0x06060606u) & 0xf0f0f0f0u) != 0x30303030u) {
+        return UINT32_MAX;
+    }
+    word -= 0x30303030u;
+    /* Each even byte becomes 10 times itself plus the next byte, the multiplications are shifts and adds. */
+    pairs = ((word << 3) + (word << 1) + (word >> 8)) & 0x00ff00ffu;
+    return ((pairs & 0xff) << 6) + ((pairs & 0xff) << 5) + ((pairs & 0xff) << 2) + (pairs >> 16);
+}
+
+static inline uint64_t
+__mram_csv_times10(uint64_t value)
+{
+    return (value << 3) + (value << 1);
+}
+
+/* Parses the number [from, to) of the text, multiplied by 10 to the power of scale if fixed. */
+static inline bool
+__mram_csv_number(struct __mram_csv_reader *r, uint32_t from, uint32_t to, bool fixed, uint32_t scale, int64_t *number)
+{
+    uint64_t value = 0;
+    uint32_t nr_digits = 0, nr_decimals = 0;
+    bool negative = false, point = false;
+
+    *number = 0;
+    if (from == to) {
+        return true;
+    }
+    if (__mram_csv_byte(r, from) == '-' || __mram_csv_byte(r, from) == '+') {
+        negative = __mram_csv_byte(r, from) == '-';
+        from++;
+    }
+    while (from + 4 <= to) {
+        uint32_t digits = __mram_csv_digits4(__mram_csv_word(r, from));
+        if (digits == UINT32_MAX) {
+            break;
+        }
+        value = (value << 13) + (value << 10) + (value << 9) + (value << 8) + (value << 4) + digits;
+        nr_digits += 4;
+        from += 4;
+    }
+    for (; from < to; from++) {
+        uint32_t c = __mram_csv_byte(r, from);
+        if (c >= '0' && c <= '9') {
+            if (!point) {
+                value = __mram_csv_times10(value) + (c - '0');
+                nr_digits++;
+            } else if (nr_decimals < scale) {
+                value = __mram_csv_times10(value) + (c - '0');
+                nr_decimals++;
+            }
+        } else if (c == '.' && fixed && !point) {
+            point = true;
+        } else {
+            return false;
+        }
+    }
+    if (nr_digits + scale > 18 || (nr_digits == 0 && !point)) {
+        return false;
+    }
+    for (; nr_decimals < scale; nr_decimals++) {
+        value = __mram_csv_times10(value);
+    }
+    *number = negative ? -(int64_t)value : (int64_t)value;
+    return true;
+}
+
+/* Writes a field of the record to its column, and returns whether it is valid. */
+static inline bool
+__mram_csv_store(struct __mram_csv_reader *r,
+    const struct mram_csv_schema *schema,
+    uint32_t field,
+    uint32_t from,
+    uint32_t to,
+    mram_scatter_writer_t *writer)
+{
+    uint32_t type = schema->types[field];
+    bool valid = true;
+
+    if (type == MRAM_CSV_STRING) {
+        struct mram_csv_string string = { .offset = from, .length = to - from };
+        mram_scatter_push(writer, field, &string, sizeof(string));
+    } else if (type == MRAM_CSV_INT32 || type == MRAM_CSV_FIXED32) {
+        int64_t number;
+        int32_t element;
+        valid = __mram_csv_number(r, from, to, type == MRAM_CSV_FIXED32, type == MRAM_CSV_FIXED32 ? schema->scales[field] : 0,
+                    &number)
+            && number >= INT32_MIN && number <= INT32_MAX;
+        element = valid ? (int32_t)number : 0;
+        mram_scatter_push(writer, field, &element, sizeof(element));
+    } else if (type == MRAM_CSV_INT64 || type == MRAM_CSV_FIXED64) {
+        int64_t element;
+        valid = __mram_csv_number(r, from, to, type == MRAM_CSV_FIXED64, type == MRAM_CSV_FIXED64 ? schema->scales[field] : 0,
+            &element);
+        if (!valid) {
+            element = 0;
+        }
+        mram_scatter_push(writer, field, &element, sizeof(element));
+    }
+    return valid;
+}
+
+/* Parses the record starting at position, and returns the position of the newline ending it, or the length of the text. */
+static inline uint32_t
+__mram_csv_record(struct __mram_csv_reader *r,
+    const struct mram_csv_schema *schema,
+    uint32_t position,
+    mram_scatter_writer_t *writer,
+    uint32_t *nr_errors)
+{
+    uint32_t delimiter = schema->delimiter, field = 0, end = position, separator;
+
+    do {
+        uint32_t from = position, to;
+        bool quoted = false;
+
+        /* The field ends at the first delimiter or newline which is not quoted. */
+        for (end = position;; end++) {
+            end = __mram_csv_find(r, end, delimiter, quoted);
+            if (end == r->length || __mram_csv_byte(r, end) != '"') {
+                break;
+            }
+            quoted = !quoted;
+        }
+        separator = end == r->length ? '\n' : __mram_csv_byte(r, end);
+
+        if (field < schema->nr_fields && schema->types[field] != MRAM_CSV_SKIP) {
+            to = end;
+            if (separator == '\n' && to > from && __mram_csv_byte(r, to - 1) == '\r') {
+                to--;
+            }
+            if (to > from && __mram_csv_byte(r, from) == '"') {
+                from++;
+                if (to > from && __mram_csv_byte(r, to - 1) == '"') {
+                    to--;
+                }
+            }
+            *nr_errors += !__mram_csv_store(r, schema, field, from, to, writer);
+        }
+        field++;
+        position = end + 1;
+    } while (separator != '\n');
+
+    for (; field < schema->nr_fields; field++) {
+        if (schema->types[field] != MRAM_CSV_SKIP) {
+            __mram_csv_store(r, schema, field, end, end, writer);
+        }
+    }
+    return end;
+}
+
+/* The start of the part of the text of a tasklet: the parts start on 8-byte boundaries, but for the first one. */
+static inline uint32_t
+__mram_csv_part(uint32_t tasklet, uint32_t from, uint32_t length)
+{
+    uint32_t start;
+
+    if (tasklet == 0) {
+        return from;
+    }
+    if (tasklet == __MRAM_CSV_NR_TASKLETS) {
+        return length;
+    }
+    start = (from + (uint32_t)((uint64_t)(length - from) * tasklet / __MRAM_CSV_NR_TASKLETS)) & ~7;
+    return start > from ? start : from;
+}
+
+/*
+ * Counts the double quotes of the bytes [start, end) of the text, and the newlines followed by a record after an even
+ * and after an odd number of these double quotes.
+ */
+static inline uint32_t
+__mram_csv_count(struct __mram_csv_reader *r, uint32_t start, uint32_t end, uint32_t *newlines)
+{
+    uint32_t quotes = 0;
+
+    newlines[0] = 0;
+    newlines[1] = 0;
+    for (uint32_t base = start & ~7; base < end; base += MRAM_CSV_WINDOW) {
+        uint32_t first = base < start ? start - base : 0;
+        uint32_t last = end - base < MRAM_CSV_WINDOW ? end - base : MRAM_CSV_WINDOW;
+
+        mram_read(&r->text[base], r->window, MRAM_CSV_WINDOW);
+        r->base = base;
+        for (uint32_t offset = first & ~3; offset < last; offset += 4) {
+            uint32_t word = *(const uint32_t *)&r->window[offset];
+            if ((__mram_csv_has(word, __MRAM_CSV_QUOTES) | __mram_csv_has(word, __MRAM_CSV_NEWLINES)) == 0) {
+                continue;
+            }
+            uint32_t stop = offset + 4 < last ? offset + 4 : last;
+            for (uint32_t each_byte = offset < first ? first : offset; each_byte < stop; each_byte++) {
+                uint32_t c = r->window[each_byte];
+                if (c == '"') {
+                    quotes++;
+                } else if (c == '\n' && base + each_byte + 1 < r->length) {
+                    newlines[quotes & 1]++;
+                }
+            }
+        }
+    }
+    return quotes;
+}
+
+/**
+ * @fn mram_csv_parse
+ * @brief Parses the records of a text into MRAM columns.
+ *
+ * Must be called by all the tasklets, with the same arguments. The columns are complete when the tasklets return. The
+ * text may be read up to MRAM_CSV_WINDOW bytes past its end.
+ *
+ * @param c the state of the parsing
+ * @param schema the fields of the records
+ * @param text the text in MRAM, 8-byte aligned
+ * @param from the offset of the start of the first record in the text
+ * @param length the length of the text, in bytes, which ends at the end of its last record
+ * @param columns the MRAM column of each field of the schema which is not skipped, with no alignment constraint
+ * @param max_records the capacity of the columns, in records
+ * @param nr_errors if not NULL, receives the number of invalid numbers
+ * @return The number of records, which are all in the columns if it does not exceed max_records.
+ */
+static inline uint32_t
+mram_csv_parse(struct mram_csv *c,
+    const struct mram_csv_schema *schema,
+    const __mram_ptr uint8_t *text,
+    uint32_t from,
+    uint32_t length,
+    __mram_ptr void *const *columns,
+    uint32_t max_records,
+    uint32_t *nr_errors)
+{
+    /* No position is below the initial base: the first access reads the window. */
+    struct __mram_csv_reader reader = { .text = text, .length = length, .base = UINT32_MAX & ~7, .window = c->windows[me()] };
+    uint32_t start = __mram_csv_part(me(), from, length), end = __mram_csv_part(me() + 1, from, length);
+    uint32_t newlines[2], quoted, nr_records, first_record, total, errors = 0, total_errors, position;
+    mram_scatter_writer_t writer = mram_scatter_writer(c->scatter);
+
+    /* The quoting state at the start of the part gives its number of records. */
+    quoted = tasklet_scan_exclusive(c->scan, __mram_csv_count(&reader, start, end, newlines), NULL) & 1;
+    nr_records = newlines[quoted] + (me() == 0 && from < length);
+    first_record = tasklet_scan_exclusive(c->scan, nr_records, &total);
+    if (first_record + nr_records > max_records) {
+        nr_records = first_record < max_records ? max_records - first_record : 0;
+    }
+
+    for (uint32_t field = 0; field < schema->nr_fields; field++) {
+        uint32_t type = schema->types[field];
+        uint32_t size = type == MRAM_CSV_INT32 || type == MRAM_CSV_FIXED32 ? sizeof(int32_t) : sizeof(int64_t);
+        if (type != MRAM_CSV_SKIP) {
+            mram_scatter_set_destination(&writer, field, (__mram_ptr uint8_t *)columns[field] + first_record * size);
+        }
+    }
+
+    /* Find the first record of the part, after its first newline which is not quoted. */
+    position = start;
+    if (me() != 0) {
+        for (; position < end; position++) {
+            position = __mram_csv_find(&reader, position, '\n', quoted != 0);
+            if (position >= end || __mram_csv_byte(&reader, position) == '\n') {
+                break;
+            }
+            quoted = !quoted;
+        }
+        position++;
+    }
+
+    for (uint32_t each_record = 0; each_record < nr_records; each_record++) {
+        position = __mram_csv_record(&reader, schema, position, &writer, &errors) + 1;
+    }
+    mram_scatter_flush(&writer);
+
+    tasklet_scan_exclusive(c->scan, errors, &total_errors);
+    if (nr_errors != NULL) {
+        *nr_errors = total_errors;
+    }
+    return total;
+}
+
+#endif /* DPUSYSCORE_MRAM_CSV_H */
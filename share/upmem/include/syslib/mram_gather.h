@@ -0,0 +1,151 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_GATHER_H
+#define DPUSYSCORE_MRAM_GATHER_H
+
+/**
+ * @file mram_gather.h
+ * @brief Coalesced gather of a batch of elements of an MRAM table into WRAM.
+ *
+ * Looking up random elements of a table in MRAM (dictionary decoding, embedding lookup, foreign-key probes) one
+ * mram_read per index pays the fixed cost of a DMA for each element. mram_gather takes a whole batch of indices, sorts
+ * them and loads the elements falling in the same MRAM window with a single DMA of at most MRAM_GATHER_WINDOW_SIZE
+ * bytes, then scatters the elements into the output array in the order of the indices.
+ *
+ * Two elements are loaded by the same DMA if they fit in the same window and if the gap between them is at most
+ * MRAM_GATHER_MAX_GAP bytes: beyond that gap, transferring the unused bytes costs more than starting a new DMA.
+ * Defining MRAM_GATHER_MAX_GAP to MRAM_GATHER_WINDOW_SIZE minimizes the number of DMAs instead.
+ *
+ * The elements do not need to be 8-byte aligned, nor their size to be a multiple of 8.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <mram.h>
+#include <attributes.h>
+
+#ifndef MRAM_GATHER_WINDOW_SIZE
+/**
+ * @def MRAM_GATHER_WINDOW_SIZE
+ * @hideinitializer
+ * @brief Size of the WRAM window buffer used by mram_gather, which is also the largest DMA it performs.
+ */
+#define MRAM_GATHER_WINDOW_SIZE 2048
+#endif
+
+_Static_assert((MRAM_GATHER_WINDOW_SIZE & 7) == 0 && MRAM_GATHER_WINDOW_SIZE >= 64 && MRAM_GATHER_WINDOW_SIZE <= 2048,
+    "mram_gather error: invalid window size defined");
+
+#ifndef MRAM_GATHER_MAX_GAP
+/**
+ * @def MRAM_GATHER_MAX_GAP
+ * @hideinitializer
+ * @brief Largest number of unused bytes between two elements loaded by the same DMA.
+ */
+#define MRAM_GATHER_MAX_GAP 128
+#endif
+
+/*
+ * Sorts the permutation order[0..nr_indices) by increasing index, with a Shell sort: no extra WRAM, no recursion on the
+ * small tasklet stacks, and close to linear on batches that are already sorted.
+ */
+static inline void
+__mram_gather_sort(const uint32_t *indices, uint16_t *order, uint32_t nr_indices)
+{
+    static const uint16_t gaps[] = { 701, 301, 132, 57, 23, 10, 4, 1 };
+
+    for (unsigned int each_gap = 0; each_gap < sizeof(gaps) / sizeof(gaps[0]); each_gap++) {
+        uint32_t gap = gaps[each_gap];
+        for (uint32_t i = gap; i < nr_indices; i++) {
+            uint16_t position = order[i];
+            uint32_t index = indices[position];
+            uint32_t j = i;
+            while (j >= gap && indices[order[j - gap]] > index) {
+                order[j] = order[j - gap];
+                j -= gap;
+            }
+            order[j] = position;
+        }
+    }
+}
+
+/**
+ * @fn mram_gather
+ * @brief Loads table[indices[i]] into output[i] for each of the nr_indices indices.
+ *
+ * @param table the address of the table in MRAM
+ * @param element_size the size of an element of the table, in bytes (at most MRAM_GATHER_WINDOW_SIZE - 8)
+ * @param indices the indices of the elements to load, in WRAM
+ * @param nr_indices the number of indices (at most 65536)
+ * @param output the WRAM array receiving the nr_indices elements
+ * @param order a WRAM scratch array of nr_indices entries
+ * @param window a WRAM scratch buffer of MRAM_GATHER_WINDOW_SIZE bytes, 8-byte aligned
+ * @return The number of DMAs performed.
+ */
+static inline uint32_t
+mram_gather(const __mram_ptr void *table,
+    uint32_t element_size,
+    const uint32_t *indices,
+    uint32_t nr_indices,
+    void *output,
+    uint16_t *order,
+    uint8_t *window)
+{
+    uintptr_t base = (uintptr_t)table;
+    uint32_t nr_dmas = 0;
+    uint32_t first = 0;
+
+    for (uint32_t i = 0; i < nr_indices; i++) {
+        order[i] = i;
+    }
+    __mram_gather_sort(indices, order, nr_indices);
+
+    while (first < nr_indices) {
+        uintptr_t start = base + indices[order[first]] * element_size;
+        uintptr_t window_start = start & ~7;
+        uintptr_t end = start + element_size;
+        uint32_t last = first + 1;
+        uint32_t length;
+
+        /* Extend the window with the following elements while they fit and are close enough. */
+        while (last < nr_indices) {
+            uintptr_t next = base + indices[order[last]] * element_size;
+            uintptr_t next_end = next + element_size;
+            if ((next > end && next - end > MRAM_GATHER_MAX_GAP)
+                || ((next_end + 7) & ~7) - window_start > MRAM_GATHER_WINDOW_SIZE) {
+                break;
+            }
+            if (next_end > end) {
+                end = next_end;
+            }
+            last++;
+        }
+
+        length = ((end + 7) & ~7) - window_start;
+        mram_read((const __mram_ptr void *)window_start, window, length);
+        nr_dmas++;
+
+        /* Scatter the elements of the window in the order of the indices. */
+        for (uint32_t i = first; i < last; i++) {
+            uint32_t position = order[i];
+            const uint8_t *from = window + (base + indices[position] * element_size - window_start);
+            uint8_t *to = (uint8_t *)output + position * element_size;
+            if (element_size == sizeof(uint32_t) && (((uintptr_t)to | (uintptr_t)from) & 3) == 0) {
+                *(uint32_t *)to = *(const uint32_t *)from;
+            } else if (element_size == sizeof(uint64_t) && (((uintptr_t)to | (uintptr_t)from) & 7) == 0) {
+                *(uint64_t *)to = *(const uint64_t *)from;
+            } else {
+                memcpy(to, from, element_size);
+            }
+        }
+
+        first = last;
+    }
+
+    return nr_dmas;
+}
+
+#endif /* DPUSYSCORE_MRAM_GATHER_H */
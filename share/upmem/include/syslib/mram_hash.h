@@ -0,0 +1,339 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_HASH_H
+#define DPUSYSCORE_MRAM_HASH_H
+
+/**
+ * @file mram_hash.h
+ * @brief Hash table of 32-bit keys and values stored in MRAM, shared by all the tasklets.
+ *
+ * The table is an array of buckets in MRAM. A bucket holds MRAM_HASH_BUCKET_SIZE / 8 slots (a 32-bit key and its 32-bit
+ * value) and is read with a single DMA. A key is stored in the first bucket with a free slot, starting from its home
+ * bucket (the hash of the key modulo the number of buckets) and probing the following buckets linearly. The key
+ * MRAM_HASH_EMPTY_KEY marks a free slot and cannot be stored: an MRAM area set to 0xff bytes is an empty table.
+ *
+ * Lookups take no lock: a slot is written with a single 8-byte DMA, so a lookup sees either a free slot or a complete
+ * entry. Insertions lock the bucket they inspect with a mutex of a mutex pool, so that tasklets can insert and update
+ * concurrently. Entries cannot be removed.
+ *
+ * The table can also be built by the host, with the same hash function and layout (see dpu_hash_table.h), and copied
+ * into MRAM before attaching it with mram_hash_attach.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <mutex_pool.h>
+#include <mram_gather.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_HASH_BUCKET_SIZE
+/**
+ * @def MRAM_HASH_BUCKET_SIZE
+ * @hideinitializer
+ * @brief Size of a bucket in bytes, read with one DMA.
+ */
+#define MRAM_HASH_BUCKET_SIZE 64
+#endif
+
+_Static_assert((MRAM_HASH_BUCKET_SIZE & 7) == 0 && MRAM_HASH_BUCKET_SIZE >= 8 && MRAM_HASH_BUCKET_SIZE <= 512,
+    "mram_hash error: invalid bucket size defined");
+
+#ifdef NR_TASKLETS
+#define __MRAM_HASH_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_HASH_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+#define __MRAM_HASH_NR_SLOTS (MRAM_HASH_BUCKET_SIZE / 8)
+
+/**
+ * @def MRAM_HASH_EMPTY_KEY
+ * @hideinitializer
+ * @brief The key of a free slot.
+ */
+#define MRAM_HASH_EMPTY_KEY 0xffffffffu
+
+/**
+ * @enum mram_hash_status_t
+ * @brief The result of an insertion.
+ *
+ * @var MRAM_HASH_INSERTED  the key was added to the table
+ * @var MRAM_HASH_UPDATED   the key was already in the table, and its value was updated
+ * @var MRAM_HASH_FULL      the key was not in the table, and there is no free slot left
+ */
+typedef enum _mram_hash_status_t {
+    MRAM_HASH_INSERTED = 0,
+    MRAM_HASH_UPDATED = 1,
+    MRAM_HASH_FULL = 2,
+} mram_hash_status_t;
+
+/*
+ * A slot of a bucket.
+ */
+struct __mram_hash_slot {
+    uint32_t key;
+    uint32_t value;
+};
+
+/**
+ * @struct mram_hash
+ * @brief A hash table, as declared by MRAM_HASH_INIT and located in MRAM by mram_hash_attach.
+ */
+struct mram_hash {
+    uintptr_t buckets;
+    uint32_t bucket_mask;
+    struct mutex_pool *locks;
+    struct __mram_hash_slot (*cache)[__MRAM_HASH_NR_SLOTS];
+};
+
+/**
+ * @def MRAM_HASH_INIT
+ * @hideinitializer
+ * @brief Declare and initialize a hash table, with a pool of NB_MUTEXES hardware mutexes protecting the insertions.
+ */
+#define MRAM_HASH_INIT(NAME, NB_MUTEXES)                                                                                         \
+    MUTEX_POOL_INIT(mram_hash_locks_##NAME, NB_MUTEXES);                                                                         \
+    __dma_aligned struct __mram_hash_slot mram_hash_cache_##NAME[__MRAM_HASH_NR_TASKLETS][__MRAM_HASH_NR_SLOTS];                 \
+    struct mram_hash NAME = { .buckets = 0, .bucket_mask = 0, .locks = &mram_hash_locks_##NAME, .cache = mram_hash_cache_##NAME };
+
+/**
+ * @fn mram_hash_key
+ * @brief The hash of a key, also computed by dpu_hash_key on the host.
+ *
+ * The 32-bit multiplication being slow on the DPU, the hash only uses shifts, additions and exclusive ors.
+ *
+ * @param key the key
+ * @return The hash of the key.
+ */
+static inline uint32_t
+mram_hash_key(uint32_t key)
+{
+    uint32_t h = key;
+    h ^= h >> 16;
+    h += h << 3;
+    h ^= h >> 11;
+    h += h << 15;
+    h ^= h >> 7;
+    return h;
+}
+
+/**
+ * @fn mram_hash_attach
+ * @brief Sets the MRAM location of a hash table.
+ * @param t the hash table
+ * @param buckets the buckets of the table, 8-byte aligned in MRAM
+ * @param nr_buckets the number of buckets, a power of 2
+ */
+static inline void
+mram_hash_attach(struct mram_hash *t, __mram_ptr void *buckets, uint32_t nr_buckets)
+{
+    t->buckets = (uintptr_t)buckets;
+    t->bucket_mask = nr_buckets - 1;
+}
+
+static inline __mram_ptr void *
+__mram_hash_bucket(struct mram_hash *t, uint32_t bucket)
+{
+    return (__mram_ptr void *)(t->buckets + bucket * MRAM_HASH_BUCKET_SIZE);
+}
+
+/*
+ * Looks for a key, probing the buckets from the given one until the key or a free slot is found.
+ */
+static inline bool
+__mram_hash_find(struct mram_hash *t, uint32_t key, uint32_t bucket, struct __mram_hash_slot *cache, uint32_t *value)
+{
+    for (uint32_t each_bucket = 0; each_bucket <= t->bucket_mask; each_bucket++) {
+        mram_read(__mram_hash_bucket(t, bucket), cache, MRAM_HASH_BUCKET_SIZE);
+        for (uint32_t each_slot = 0; each_slot < __MRAM_HASH_NR_SLOTS; each_slot++) {
+            if (cache[each_slot].key == key) {
+                *value = cache[each_slot].value;
+                return true;
+            }
+            if (cache[each_slot].key == MRAM_HASH_EMPTY_KEY) {
+                return false;
+            }
+        }
+        bucket = (bucket + 1) & t->bucket_mask;
+    }
+    return false;
+}
+
+/**
+ * @fn mram_hash_lookup
+ * @brief Looks a key up in a hash table.
+ * @param t the hash table
+ * @param key the key
+ * @param value receives the value of the key, if found
+ * @return Whether the key is in the table.
+ */
+static inline bool
+mram_hash_lookup(struct mram_hash *t, uint32_t key, uint32_t *value)
+{
+    return __mram_hash_find(t, key, mram_hash_key(key) & t->bucket_mask, t->cache[me()], value);
+}
+
+/*
+ * Inserts a key, or combines its value with the one in the table: replaced if add is false, added otherwise.
+ */
+static inline mram_hash_status_t
+__mram_hash_upsert(struct mram_hash *t, uint32_t key, uint32_t value, bool add)
+{
+    struct __mram_hash_slot *cache = t->cache[me()];
+    uint32_t bucket = mram_hash_key(key) & t->bucket_mask;
+
+    for (uint32_t each_bucket = 0; each_bucket <= t->bucket_mask; each_bucket++) {
+        __mram_ptr struct __mram_hash_slot *slots = (__mram_ptr struct __mram_hash_slot *)__mram_hash_bucket(t, bucket);
+
+        mutex_pool_lock(t->locks, bucket);
+        mram_read(slots, cache, MRAM_HASH_BUCKET_SIZE);
+        for (uint32_t each_slot = 0; each_slot < __MRAM_HASH_NR_SLOTS; each_slot++) {
+            struct __mram_hash_slot *slot = &cache[each_slot];
+            if (slot->key == key) {
+                slot->value = add ? slot->value + value : value;
+                mram_write(slot, &slots[each_slot], sizeof(*slot));
+                mutex_pool_unlock(t->locks, bucket);
+                return MRAM_HASH_UPDATED;
+            }
+            if (slot->key == MRAM_HASH_EMPTY_KEY) {
+                slot->key = key;
+                slot->value = value;
+                mram_write(slot, &slots[each_slot], sizeof(*slot));
+                mutex_pool_unlock(t->locks, bucket);
+                return MRAM_HASH_INSERTED;
+            }
+        }
+        mutex_pool_unlock(t->locks, bucket);
+        bucket = (bucket + 1) & t->bucket_mask;
+    }
+    return MRAM_HASH_FULL;
+}
+
+/**
+ * @fn mram_hash_insert
+ * @brief Inserts a key in a hash table, or replaces its value if the key is already in the table.
+ * @param t the hash table
+ * @param key the key, different from MRAM_HASH_EMPTY_KEY
+ * @param value the value
+ * @return Whether the key was inserted or updated, or MRAM_HASH_FULL.
+ */
+static inline mram_hash_status_t
+mram_hash_insert(struct mram_hash *t, uint32_t key, uint32_t value)
+{
+    return __mram_hash_upsert(t, key, value, false);
+}
+
+/**
+ * @fn mram_hash_add
+ * @brief Adds a value to the value of a key, inserting the key with this value if it is not in the table.
+ * @param t the hash table
+ * @param key the key, different from MRAM_HASH_EMPTY_KEY
+ * @param value the value to add
+ * @return Whether the key was inserted or updated, or MRAM_HASH_FULL.
+ */
+static inline mram_hash_status_t
+mram_hash_add(struct mram_hash *t, uint32_t key, uint32_t value)
+{
+    return __mram_hash_upsert(t, key, value, true);
+}
+
+/**
+ * @struct mram_hash_batch
+ * @brief The WRAM buffers of batched lookups, as declared by MRAM_HASH_BATCH_INIT.
+ */
+struct mram_hash_batch {
+    uint32_t capacity;
+    uint32_t *indices;
+    uint16_t *orders;
+    struct __mram_hash_slot *buckets;
+    uint8_t *windows;
+};
+
+/**
+ * @def MRAM_HASH_BATCH_INIT
+ * @hideinitializer
+ * @brief Declare the buffers for batches of at most CAPACITY lookups per tasklet.
+ *
+ * Each tasklet uses CAPACITY * (MRAM_HASH_BUCKET_SIZE + 6) + MRAM_GATHER_WINDOW_SIZE bytes of WRAM.
+ */
+#define MRAM_HASH_BATCH_INIT(NAME, CAPACITY)                                                                                     \
+    uint32_t mram_hash_batch_indices_##NAME[__MRAM_HASH_NR_TASKLETS * (CAPACITY)];                                               \
+    uint16_t mram_hash_batch_orders_##NAME[__MRAM_HASH_NR_TASKLETS * (CAPACITY)];                                                \
+    __dma_aligned struct __mram_hash_slot                                                                                        \
+        mram_hash_batch_buckets_##NAME[__MRAM_HASH_NR_TASKLETS * (CAPACITY)*__MRAM_HASH_NR_SLOTS];                              \
+    __dma_aligned uint8_t mram_hash_batch_windows_##NAME[__MRAM_HASH_NR_TASKLETS * MRAM_GATHER_WINDOW_SIZE];                     \
+    struct mram_hash_batch NAME = { .capacity = (CAPACITY),                                                                      \
+        .indices = mram_hash_batch_indices_##NAME,                                                                               \
+        .orders = mram_hash_batch_orders_##NAME,                                                                                 \
+        .buckets = mram_hash_batch_buckets_##NAME,                                                                               \
+        .windows = mram_hash_batch_windows_##NAME };
+
+/**
+ * @fn mram_hash_lookup_batch
+ * @brief Looks a batch of keys up in a hash table.
+ *
+ * The home buckets of the keys are loaded with mram_gather: keys sharing a bucket, or falling in neighbouring buckets,
+ * are served by the same DMA. Only the keys that are not resolved by their home bucket (because it is full and does not
+ * hold the key) probe the following buckets one by one. The tasklets can look batches up concurrently.
+ *
+ * @param t the hash table
+ * @param b the batch buffers
+ * @param keys the keys, in WRAM
+ * @param nr_keys the number of keys, at most the capacity of the batch buffers
+ * @param values receives the value of each key found, in WRAM
+ * @param found receives, for each key, whether it was found
+ * @return The number of keys found.
+ */
+static inline uint32_t
+mram_hash_lookup_batch(struct mram_hash *t,
+    struct mram_hash_batch *b,
+    const uint32_t *keys,
+    uint32_t nr_keys,
+    uint32_t *values,
+    bool *found)
+{
+    sysname_t id = me();
+    uint32_t *indices = b->indices + id * b->capacity;
+    struct __mram_hash_slot *buckets = b->buckets + id * b->capacity * __MRAM_HASH_NR_SLOTS;
+    uint32_t nr_found = 0;
+
+    for (uint32_t i = 0; i < nr_keys; i++) {
+        indices[i] = mram_hash_key(keys[i]) & t->bucket_mask;
+    }
+    mram_gather((const __mram_ptr void *)t->buckets,
+        MRAM_HASH_BUCKET_SIZE,
+        indices,
+        nr_keys,
+        buckets,
+        b->orders + id * b->capacity,
+        b->windows + id * MRAM_GATHER_WINDOW_SIZE);
+
+    for (uint32_t i = 0; i < nr_keys; i++) {
+        const struct __mram_hash_slot *home = &buckets[i * __MRAM_HASH_NR_SLOTS];
+        uint32_t each_slot;
+
+        found[i] = false;
+        for (each_slot = 0; each_slot < __MRAM_HASH_NR_SLOTS; each_slot++) {
+            if (home[each_slot].key == keys[i]) {
+                values[i] = home[each_slot].value;
+                found[i] = true;
+                break;
+            }
+            if (home[each_slot].key == MRAM_HASH_EMPTY_KEY) {
+                break;
+            }
+        }
+        if (each_slot == __MRAM_HASH_NR_SLOTS && t->bucket_mask != 0) {
+            found[i] = __mram_hash_find(t, keys[i], (indices[i] + 1) & t->bucket_mask, t->cache[id], &values[i]);
+        }
+        nr_found += found[i];
+    }
+    return nr_found;
+}
+
+#endif /* DPUSYSCORE_MRAM_HASH_H */
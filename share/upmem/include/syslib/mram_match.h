@@ -0,0 +1,233 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_MATCH_H
+#define DPUSYSCORE_MRAM_MATCH_H
+
+/**
+ * @file mram_match.h
+ * @brief Search of several patterns at once in an MRAM text, with a deterministic automaton in WRAM.
+ *
+ * The automaton is an Aho-Corasick automaton with all its transitions resolved, built on the host by dpu_match_compile
+ * (see dpu_match.h) and copied into WRAM. The bytes are mapped to classes, so that a state has one transition per byte
+ * class: each byte of the text costs a class lookup, a transition lookup and a comparison. A transition holds the index
+ * of the row of its target state, and the accepting states come last, so a match is found by comparing this index to the
+ * row of the first accepting state.
+ *
+ * The text is split evenly between the tasklets, and read sequentially with seqread. A match belongs to the tasklet
+ * whose range holds its last byte: each tasklet starts reading max_length - 1 bytes before its range, so that the
+ * matches straddling the boundary with the previous tasklet are found. The host splits the text between the DPUs in the
+ * same way, with an overlap of max_length - 1 bytes before each DPU text.
+ *
+ * The matches are buffered in WRAM by each tasklet, and written to a compacted MRAM array: the tasklets reserve slots at
+ * the end of the array for a full buffer at once. The matches are thus not sorted. The count of matches goes on past the
+ * capacity of the array, so that an overflow is detected.
+ *
+ * The WRAM used by each tasklet is 2 * SEQREAD_CACHE_SIZE + MRAM_MATCH_BUFFER * 8 + 8 bytes: 648 bytes with the default
+ * parameters. The seqread cache of a tasklet is allocated with seqread_alloc on its first search: the heap must not be
+ * reset with mem_reset after the first search.
+ */
+
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <mutex.h>
+#include <barrier.h>
+#include <seqread.h>
+#include <atomic_bit.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_MATCH_BUFFER
+/**
+ * @def MRAM_MATCH_BUFFER
+ * @hideinitializer
+ * @brief Number of matches buffered in WRAM by each tasklet before they are written to MRAM.
+ */
+#define MRAM_MATCH_BUFFER 16
+#endif
+
+_Static_assert(MRAM_MATCH_BUFFER >= 1 && MRAM_MATCH_BUFFER <= 256, "mram_match error: invalid buffer size defined");
+
+/**
+ * @def MRAM_MATCH_STEP
+ * @brief Number of bytes of text processed between two calls to seqread_get.
+ */
+#define MRAM_MATCH_STEP (SEQREAD_CACHE_SIZE / 2)
+
+#ifdef NR_TASKLETS
+#define __MRAM_MATCH_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_MATCH_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @struct mram_match_automaton
+ * @brief The automaton built by dpu_match_compile on the host, copied into WRAM.
+ *
+ * The transitions are followed by the outputs of the accepting states: nr_accepting + 1 offsets, where the patterns
+ * recognized by accepting state k are at the offsets [offsets[k], offsets[k + 1]) of the array of pattern indices
+ * which follows.
+ */
+struct mram_match_automaton {
+    /** The number of states, the accepting ones last. */
+    uint16_t nr_states;
+    /** The number of byte classes, which is the number of transitions per state. */
+    uint16_t nr_classes;
+    /** The row of the first accepting state, that is its index times nr_classes. */
+    uint16_t first_accepting;
+    /** The length of the longest pattern. */
+    uint16_t max_length;
+    /** The class of each byte. */
+    uint8_t classes[256];
+    /** The row of the target of each transition, nr_classes per state, followed by the outputs. */
+    uint16_t transitions[];
+};
+
+/**
+ * @struct mram_match_result
+ * @brief A match, as written in MRAM.
+ */
+struct mram_match_result {
+    /** The offset in the text of the byte following the match. */
+    uint32_t end;
+    /** The index of the pattern. */
+    uint32_t pattern;
+};
+
+/**
+ * @struct mram_match
+ * @brief The state of the searches, as declared by MRAM_MATCH_INIT.
+ */
+struct mram_match {
+    barrier_t *barrier;
+    mutex_id_t lock;
+    volatile uint32_t count;
+    seqreader_buffer_t *caches;
+    struct mram_match_result (*buffers)[MRAM_MATCH_BUFFER];
+};
+
+/**
+ * @def MRAM_MATCH_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the searches.
+ */
+#define MRAM_MATCH_INIT(NAME)                                                                                                    \
+    BARRIER_INIT(mram_match_barrier_##NAME, __MRAM_MATCH_NR_TASKLETS);                                                           \
+    ATOMIC_BIT_INIT(mram_match_lock_##NAME);                                                                                     \
+    seqreader_buffer_t mram_match_caches_##NAME[__MRAM_MATCH_NR_TASKLETS];                                                       \
+    __dma_aligned struct mram_match_result mram_match_buffers_##NAME[__MRAM_MATCH_NR_TASKLETS][MRAM_MATCH_BUFFER];               \
+    struct mram_match NAME = { .barrier = &mram_match_barrier_##NAME,                                                            \
+        .lock = &ATOMIC_BIT_GET(mram_match_lock_##NAME),                                                                         \
+        .count = 0,                                                                                                              \
+        .caches = mram_match_caches_##NAME,                                                                                      \
+        .buffers = mram_match_buffers_##NAME };
+
+/* Writes the buffered matches of a tasklet to the slots it reserves at the end of the results. */
+static inline void
+__mram_match_flush(struct mram_match *m,
+    struct mram_match_result *buffer,
+    uint32_t nr_buffered,
+    __mram_ptr struct mram_match_result *results,
+    uint32_t max_results)
+{
+    uint32_t slot;
+
+    mutex_lock(m->lock);
+    slot = m->count;
+    m->count = slot + nr_buffered;
+    mutex_unlock(m->lock);
+
+    if (slot < max_results) {
+        uint32_t nr_written = max_results - slot < nr_buffered ? max_results - slot : nr_buffered;
+        mram_write(buffer, &results[slot], nr_written * sizeof(struct mram_match_result));
+    }
+}
+
+/**
+ * @fn mram_match_search
+ * @brief Finds all the occurrences of the patterns of an automaton in an MRAM text.
+ *
+ * Must be called by all the tasklets, with the same arguments. Only the matches whose last byte is at an offset of at
+ * least report_from are reported: the bytes before it are the overlap with the text of the previous DPU. The text may be
+ * read up to 2 * SEQREAD_CACHE_SIZE bytes past its end.
+ *
+ * @param m the state of the searches
+ * @param automaton the automaton, built by dpu_match_compile
+ * @param text the text in MRAM, with no alignment constraint
+ * @param length the length of the text, in bytes
+ * @param report_from the offset of the first byte of the text where matches can end
+ * @param results receives the matches, in no particular order, 8-byte aligned in MRAM
+ * @param max_results the capacity of the results
+ * @return The number of matches, which are all in the results if it does not exceed max_results.
+ */
+static inline uint32_t
+mram_match_search(struct mram_match *m,
+    const struct mram_match_automaton *automaton,
+    const __mram_ptr uint8_t *text,
+    uint32_t length,
+    uint32_t report_from,
+    __mram_ptr struct mram_match_result *results,
+    uint32_t max_results)
+{
+    sysname_t id = me();
+    struct mram_match_result *buffer = m->buffers[id];
+    const uint8_t *classes = automaton->classes;
+    const uint16_t *transitions = automaton->transitions;
+    const uint16_t *offsets = &transitions[(uint32_t)automaton->nr_states * automaton->nr_classes];
+    const uint16_t *patterns = &offsets[automaton->nr_states - automaton->first_accepting / automaton->nr_classes + 1];
+    uint32_t first_accepting = automaton->first_accepting, overlap = automaton->max_length - 1;
+    uint32_t span = report_from < length ? length - report_from : 0;
+    uint32_t begin = report_from + (uint32_t)((uint64_t)span * id / __MRAM_MATCH_NR_TASKLETS);
+    uint32_t end = report_from + (uint32_t)((uint64_t)span * (id + 1) / __MRAM_MATCH_NR_TASKLETS);
+    uint32_t position = begin > overlap ? begin - overlap : 0;
+    uint32_t nr_buffered = 0, total;
+
+    if (m->caches[id] == 0) {
+        m->caches[id] = seqread_alloc();
+    }
+    if (id == 0) {
+        m->count = 0;
+    }
+    barrier_wait(m->barrier);
+
+    if (position < end) {
+        seqreader_t reader;
+        const uint8_t *bytes = seqread_init(m->caches[id], (__mram_ptr void *)&text[position], &reader);
+        uint32_t state = 0;
+
+        while (true) {
+            uint32_t n = end - position < MRAM_MATCH_STEP ? end - position : MRAM_MATCH_STEP;
+
+            for (uint32_t each_byte = 0; each_byte < n; each_byte++) {
+                state = transitions[state + classes[bytes[each_byte]]];
+                if (state >= first_accepting && position + each_byte >= begin) {
+                    uint32_t accepting = (state - first_accepting) / automaton->nr_classes;
+                    for (uint32_t each_output = offsets[accepting]; each_output < offsets[accepting + 1]; each_output++) {
+                        buffer[nr_buffered].end = position + each_byte + 1;
+                        buffer[nr_buffered].pattern = patterns[each_output];
+                        if (++nr_buffered == MRAM_MATCH_BUFFER) {
+                            __mram_match_flush(m, buffer, nr_buffered, results, max_results);
+                            nr_buffered = 0;
+                        }
+                    }
+                }
+            }
+            position += n;
+            if (position == end) {
+                break;
+            }
+            bytes = seqread_get((void *)bytes, MRAM_MATCH_STEP, &reader);
+        }
+    }
+    if (nr_buffered != 0) {
+        __mram_match_flush(m, buffer, nr_buffered, results, max_results);
+    }
+    barrier_wait(m->barrier);
+    total = m->count;
+    barrier_wait(m->barrier);
+    return total;
+}
+
+#endif /* DPUSYSCORE_MRAM_MATCH_H */
@@ -0,0 +1,165 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_PREFIX_SUM_H
+#define DPUSYSCORE_MRAM_PREFIX_SUM_H
+
+/**
+ * @file mram_prefix_sum.h
+ * @brief Prefix sums of MRAM arrays of 64-bit integers, across the DPUs of a system.
+ *
+ * The prefix sum of an array split between the DPUs takes two launches. The first one replaces the part of each DPU by
+ * its exclusive prefix sum with mram_prefix_sum_exclusive, and publishes the total of the DPU in a __host variable. The
+ * host gathers the totals, scans them and sends back to each DPU the sum of the parts of the DPUs before it (see
+ * dpu_prefix_sum.h). The second launch adds this offset to the part of the DPU with mram_prefix_sum_add, and is skipped
+ * by the first DPU, whose offset is 0.
+ *
+ * Each tasklet handles a contiguous range of blocks of MRAM_PREFIX_SUM_BLOCK_SIZE bytes: it reads its range once to sum
+ * it, takes its offset from tasklet_scan_exclusive_u64, then reads its range again to write the prefix sum. The array is
+ * read twice and written once, and the offset is added by reading and writing it once more.
+ *
+ * The WRAM used by each tasklet is MRAM_PREFIX_SUM_BLOCK_SIZE + 24 bytes: 1048 bytes with the default parameters.
+ */
+
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <tasklet_scan.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_PREFIX_SUM_BLOCK_SIZE
+/**
+ * @def MRAM_PREFIX_SUM_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Size of the blocks read and written by the tasklets, in bytes.
+ */
+#define MRAM_PREFIX_SUM_BLOCK_SIZE 1024
+#endif
+
+_Static_assert((MRAM_PREFIX_SUM_BLOCK_SIZE & 7) == 0 && MRAM_PREFIX_SUM_BLOCK_SIZE <= 2048,
+    "mram_prefix_sum error: invalid block size defined");
+
+#ifdef NR_TASKLETS
+#define __MRAM_PREFIX_SUM_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_PREFIX_SUM_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+#define __MRAM_PREFIX_SUM_BLOCK_VALUES (MRAM_PREFIX_SUM_BLOCK_SIZE / sizeof(uint64_t))
+
+/**
+ * @struct mram_prefix_sum
+ * @brief The WRAM state of a prefix sum, as declared by MRAM_PREFIX_SUM_INIT.
+ */
+struct mram_prefix_sum {
+    struct tasklet_scan_u64 *scan;
+    uint64_t (*blocks)[__MRAM_PREFIX_SUM_BLOCK_VALUES];
+};
+
+/**
+ * @def MRAM_PREFIX_SUM_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of a prefix sum.
+ */
+#define MRAM_PREFIX_SUM_INIT(NAME)                                                                                               \
+    TASKLET_SCAN_U64_INIT(mram_prefix_sum_scan_##NAME);                                                                          \
+    __dma_aligned uint64_t mram_prefix_sum_blocks_##NAME[__MRAM_PREFIX_SUM_NR_TASKLETS][__MRAM_PREFIX_SUM_BLOCK_VALUES];         \
+    struct mram_prefix_sum NAME = { .scan = &mram_prefix_sum_scan_##NAME, .blocks = mram_prefix_sum_blocks_##NAME };
+
+/* The range [*first, *last) of the values of the invoking tasklet: whole blocks, except at the end of the array. */
+static inline void
+__mram_prefix_sum_range(uint32_t nr_values, uint32_t *first, uint32_t *last)
+{
+    uint32_t nr_blocks = (nr_values + __MRAM_PREFIX_SUM_BLOCK_VALUES - 1) / __MRAM_PREFIX_SUM_BLOCK_VALUES;
+    uint32_t blocks_per_tasklet = (nr_blocks + __MRAM_PREFIX_SUM_NR_TASKLETS - 1) / __MRAM_PREFIX_SUM_NR_TASKLETS;
+    uint32_t values_per_tasklet = blocks_per_tasklet * __MRAM_PREFIX_SUM_BLOCK_VALUES;
+
+    *first = me() * values_per_tasklet;
+    *last = *first + values_per_tasklet;
+    if (*first > nr_values) {
+        *first = nr_values;
+    }
+    if (*last > nr_values) {
+        *last = nr_values;
+    }
+}
+
+/**
+ * @fn mram_prefix_sum_exclusive
+ * @brief Replaces each value of an MRAM array by the sum of the values before it.
+ *
+ * Must be called by all the tasklets, with the same arguments.
+ *
+ * @param p the state of the prefix sum
+ * @param values the array, 8-byte aligned
+ * @param nr_values the number of values of the array
+ * @return The sum of all the values, which is the offset of the next part of the array on the other DPUs.
+ */
+static inline uint64_t
+mram_prefix_sum_exclusive(struct mram_prefix_sum *p, __mram_ptr uint64_t *values, uint32_t nr_values)
+{
+    uint64_t *block = p->blocks[me()];
+    uint64_t sum = 0, total;
+    uint32_t first, last;
+
+    __mram_prefix_sum_range(nr_values, &first, &last);
+
+    for (uint32_t start = first; start < last; start += __MRAM_PREFIX_SUM_BLOCK_VALUES) {
+        uint32_t n = last - start < __MRAM_PREFIX_SUM_BLOCK_VALUES ? last - start : __MRAM_PREFIX_SUM_BLOCK_VALUES;
+        mram_read(&values[start], block, n * sizeof(uint64_t));
+        for (uint32_t i = 0; i < n; i++) {
+            sum += block[i];
+        }
+    }
+
+    sum = tasklet_scan_exclusive_u64(p->scan, sum, &total);
+
+    for (uint32_t start = first; start < last; start += __MRAM_PREFIX_SUM_BLOCK_VALUES) {
+        uint32_t n = last - start < __MRAM_PREFIX_SUM_BLOCK_VALUES ? last - start : __MRAM_PREFIX_SUM_BLOCK_VALUES;
+        mram_read(&values[start], block, n * sizeof(uint64_t));
+        for (uint32_t i = 0; i < n; i++) {
+            uint64_t value = block[i];
+            block[i] = sum;
+            sum += value;
+        }
+        mram_write(block, &values[start], n * sizeof(uint64_t));
+    }
+    return total;
+}
+
+/**
+ * @fn mram_prefix_sum_add
+ * @brief Adds an offset to each value of an MRAM array.
+ *
+ * Must be called by all the tasklets, with the same arguments. Does not synchronize the tasklets, and returns at once
+ * when the offset is 0.
+ *
+ * @param p the state of the prefix sum
+ * @param values the array, 8-byte aligned
+ * @param nr_values the number of values of the array
+ * @param offset the offset, usually the sum of the values of the DPUs before this one
+ */
+static inline void
+mram_prefix_sum_add(struct mram_prefix_sum *p, __mram_ptr uint64_t *values, uint32_t nr_values, uint64_t offset)
+{
+    uint64_t *block = p->blocks[me()];
+    uint32_t first, last;
+
+    if (offset == 0) {
+        return;
+    }
+    __mram_prefix_sum_range(nr_values, &first, &last);
+
+    for (uint32_t start = first; start < last; start += __MRAM_PREFIX_SUM_BLOCK_VALUES) {
+        uint32_t n = last - start < __MRAM_PREFIX_SUM_BLOCK_VALUES ? last - start : __MRAM_PREFIX_SUM_BLOCK_VALUES;
+        mram_read(&values[start], block, n * sizeof(uint64_t));
+        for (uint32_t i = 0; i < n; i++) {
+            block[i] += offset;
+        }
+        mram_write(block, &values[start], n * sizeof(uint64_t));
+    }
+}
+
+#endif /* DPUSYSCORE_MRAM_PREFIX_SUM_H */
@@ -0,0 +1,421 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_SCAN_H
+#define DPUSYSCORE_MRAM_SCAN_H
+
+/**
+ * @file mram_scan.h
+ * @brief Filtering of MRAM columns by a predicate compiled on the host.
+ *
+ * A table is stored by columns: one MRAM array of 32-bit signed integers per column, all with the same number of rows.
+ * The predicate is a small program, built on the host (see dpu_scan.h) and copied to a __host struct mram_scan_program.
+ * The instructions are in postfix order and operate on a stack of row masks: the comparisons push the mask of the rows
+ * of a column satisfying them, and AND, OR and NOT combine the masks on top of the stack.
+ *
+ * The rows are evaluated by blocks of MRAM_SCAN_BLOCK_ROWS: each instruction runs a tight loop over the block, specialized
+ * for its opcode, so that the cost of decoding the program is paid once per block and not once per row. A column is
+ * read at most once per block when consecutive instructions compare the same column.
+ *
+ * The selected rows are output as a bitmap (bit i of byte i / 8 is set when row i is selected), and can be compacted into
+ * the list of their indices, in increasing order. The tasklets write their indices through the write-combining lines of
+ * mram_scatter.h, at the offsets given by tasklet_scan_exclusive.
+ *
+ * Unsigned columns can be compared by flipping the sign bit of the values and of the operands.
+ *
+ * The WRAM used by each tasklet is MRAM_SCAN_BLOCK_ROWS * 4 + MRAM_SCAN_STACK_DEPTH * MRAM_SCAN_BLOCK_ROWS / 8 +
+ * MRAM_SCAN_LINE_SIZE + 8 bytes: 776 bytes with the default parameters.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <mram_scatter.h>
+#include <tasklet_scan.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_SCAN_BLOCK_ROWS
+/**
+ * @def MRAM_SCAN_BLOCK_ROWS
+ * @hideinitializer
+ * @brief Number of rows evaluated at once, which sets the size of the DMAs reading the columns.
+ */
+#define MRAM_SCAN_BLOCK_ROWS 128
+#endif
+
+#ifndef MRAM_SCAN_LINE_SIZE
+/**
+ * @def MRAM_SCAN_LINE_SIZE
+ * @hideinitializer
+ * @brief Size of the write-combining line of each tasklet, which is the size of the DMAs writing the row indices.
+ */
+#define MRAM_SCAN_LINE_SIZE 128
+#endif
+
+_Static_assert((MRAM_SCAN_BLOCK_ROWS & 63) == 0 && MRAM_SCAN_BLOCK_ROWS <= 512, "mram_scan error: invalid block size defined");
+
+/**
+ * @def MRAM_SCAN_MAX_INSTRUCTIONS
+ * @brief Maximum number of instructions of a program. Shared with the host, cannot be changed.
+ */
+#define MRAM_SCAN_MAX_INSTRUCTIONS 32
+
+/**
+ * @def MRAM_SCAN_MAX_CONSTANTS
+ * @brief Maximum number of values of the IN lists of a program. Shared with the host, cannot be changed.
+ */
+#define MRAM_SCAN_MAX_CONSTANTS 64
+
+/**
+ * @def MRAM_SCAN_STACK_DEPTH
+ * @brief Maximum number of masks on the stack while running a program. Shared with the host, cannot be changed.
+ */
+#define MRAM_SCAN_STACK_DEPTH 8
+
+/**
+ * @def MRAM_SCAN_BITMAP_SIZE
+ * @hideinitializer
+ * @brief The size, in bytes, of the MRAM bitmap receiving the selection of nr_rows rows.
+ */
+#define MRAM_SCAN_BITMAP_SIZE(nr_rows)                                                                                           \
+    ((((nr_rows) + MRAM_SCAN_BLOCK_ROWS - 1) / MRAM_SCAN_BLOCK_ROWS) * (MRAM_SCAN_BLOCK_ROWS / 8))
+
+#ifdef NR_TASKLETS
+#define __MRAM_SCAN_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_SCAN_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+#define __MRAM_SCAN_NR_WORDS (MRAM_SCAN_BLOCK_ROWS / 32)
+
+/**
+ * @enum mram_scan_opcode_t
+ * @brief The instructions of a program.
+ */
+typedef enum _mram_scan_opcode_t {
+    /** Pushes the mask of all the rows. */
+    MRAM_SCAN_TRUE = 0,
+    /** Pushes the mask of the rows where column == a. */
+    MRAM_SCAN_EQ = 1,
+    /** Pushes the mask of the rows where column != a. */
+    MRAM_SCAN_NE = 2,
+    /** Pushes the mask of the rows where column < a. */
+    MRAM_SCAN_LT = 3,
+    /** Pushes the mask of the rows where column <= a. */
+    MRAM_SCAN_LE = 4,
+    /** Pushes the mask of the rows where column > a. */
+    MRAM_SCAN_GT = 5,
+    /** Pushes the mask of the rows where column >= a. */
+    MRAM_SCAN_GE = 6,
+    /** Pushes the mask of the rows where a <= column <= b. */
+    MRAM_SCAN_BETWEEN = 7,
+    /** Pushes the mask of the rows where column is one of the count constants starting at index a. */
+    MRAM_SCAN_IN = 8,
+    /** Replaces the two masks on top of the stack by their intersection. */
+    MRAM_SCAN_AND = 9,
+    /** Replaces the two masks on top of the stack by their union. */
+    MRAM_SCAN_OR = 10,
+    /** Replaces the mask on top of the stack by its complement. */
+    MRAM_SCAN_NOT = 11,
+} mram_scan_opcode_t;
+
+/**
+ * @struct mram_scan_instruction
+ * @brief An instruction of a program.
+ */
+struct mram_scan_instruction {
+    /** The operation, an mram_scan_opcode_t. */
+    uint8_t opcode;
+    /** The column compared by the instruction. */
+    uint8_t column;
+    /** The number of constants of an IN instruction. */
+    uint16_t count;
+    /** The first operand. */
+    int32_t a;
+    /** The second operand. */
+    int32_t b;
+};
+
+/**
+ * @struct mram_scan_program
+ * @brief A predicate, as built by the host: the layout is identical to struct dpu_scan_program.
+ */
+struct mram_scan_program {
+    uint32_t nr_instructions;
+    uint32_t nr_constants;
+    struct mram_scan_instruction instructions[MRAM_SCAN_MAX_INSTRUCTIONS];
+    int32_t constants[MRAM_SCAN_MAX_CONSTANTS];
+};
+
+/**
+ * @struct mram_scan
+ * @brief The WRAM state of a scan, as declared by MRAM_SCAN_INIT.
+ */
+struct mram_scan {
+    struct tasklet_scan *scan;
+    struct mram_scatter *scatter;
+    int32_t (*values)[MRAM_SCAN_BLOCK_ROWS];
+    uint32_t (*stacks)[MRAM_SCAN_STACK_DEPTH][__MRAM_SCAN_NR_WORDS];
+};
+
+/**
+ * @def MRAM_SCAN_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of a scan.
+ */
+#define MRAM_SCAN_INIT(NAME)                                                                                                     \
+    TASKLET_SCAN_INIT(mram_scan_scan_##NAME, 1);                                                                                 \
+    MRAM_SCATTER_INIT(mram_scan_scatter_##NAME, 1, MRAM_SCAN_LINE_SIZE);                                                         \
+    __dma_aligned int32_t mram_scan_values_##NAME[__MRAM_SCAN_NR_TASKLETS][MRAM_SCAN_BLOCK_ROWS];                                \
+    __dma_aligned uint32_t                                                                                                       \
+        mram_scan_stacks_##NAME[__MRAM_SCAN_NR_TASKLETS][MRAM_SCAN_STACK_DEPTH][__MRAM_SCAN_NR_WORDS];                           \
+    struct mram_scan NAME = { .scan = &mram_scan_scan_##NAME,                                                                    \
+        .scatter = &mram_scan_scatter_##NAME,                                                                                    \
+        .values = mram_scan_values_##NAME,                                                                                       \
+        .stacks = mram_scan_stacks_##NAME };
+
+/*
+ * Sets the bits of a mask from a condition on the value x of each row of a block.
+ */
+#define __MRAM_SCAN_COMPARE(mask, values, nr_words, condition)                                                                   \
+    do {                                                                                                                         \
+        uint32_t *__mask = (mask);                                                                                               \
+        for (uint32_t __w = 0; __w < (nr_words); __w++) {                                                                        \
+            const int32_t *__v = &(values)[__w << 5];                                                                            \
+            uint32_t __m = 0;                                                                                                    \
+            for (uint32_t __b = 0; __b < 32; __b++) {                                                                            \
+                int32_t x = __v[__b];                                                                                            \
+                __m |= (uint32_t)(condition) << __b;                                                                             \
+            }                                                                                                                    \
+            __mask[__w] = __m;                                                                                                   \
+        }                                                                                                                        \
+    } while (0)
+
+/*
+ * Runs the program on the nr_rows rows of a block starting at row, and returns the mask of the selected rows.
+ */
+static inline uint32_t *
+__mram_scan_block(struct mram_scan *s,
+    const struct mram_scan_program *program,
+    const __mram_ptr int32_t *const *columns,
+    uint32_t row,
+    uint32_t nr_rows)
+{
+    sysname_t id = me();
+    int32_t *values = s->values[id];
+    uint32_t(*stack)[__MRAM_SCAN_NR_WORDS] = s->stacks[id];
+    uint32_t nr_words = (nr_rows + 31) >> 5;
+    uint32_t top = 0;
+    int32_t loaded = -1;
+
+    for (uint32_t each_instruction = 0; each_instruction < program->nr_instructions; each_instruction++) {
+        const struct mram_scan_instruction *instruction = &program->instructions[each_instruction];
+        uint32_t opcode = instruction->opcode;
+        int32_t a = instruction->a;
+        int32_t b = instruction->b;
+
+        if (opcode >= MRAM_SCAN_EQ && opcode <= MRAM_SCAN_IN && instruction->column != loaded) {
+            mram_read(&columns[instruction->column][row], values, ((nr_rows + 1) & ~1) * sizeof(int32_t));
+            loaded = instruction->column;
+        }
+
+        switch (opcode) {
+            case MRAM_SCAN_TRUE:
+                for (uint32_t w = 0; w < nr_words; w++) {
+                    stack[top][w] = 0xffffffff;
+                }
+                top++;
+                break;
+            case MRAM_SCAN_EQ:
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, x == a);
+                break;
+            case MRAM_SCAN_NE:
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, x != a);
+                break;
+            case MRAM_SCAN_LT:
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, x < a);
+                break;
+            case MRAM_SCAN_LE:
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, x <= a);
+                break;
+            case MRAM_SCAN_GT:
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, x > a);
+                break;
+            case MRAM_SCAN_GE:
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, x >= a);
+                break;
+            case MRAM_SCAN_BETWEEN:
+                /* a <= x <= b, with one unsigned comparison. */
+                __MRAM_SCAN_COMPARE(stack[top++], values, nr_words, (uint32_t)x - (uint32_t)a <= (uint32_t)b - (uint32_t)a);
+                break;
+            case MRAM_SCAN_IN: {
+                const int32_t *constants = &program->constants[a];
+                uint32_t count = instruction->count;
+                uint32_t *mask = stack[top++];
+                for (uint32_t w = 0; w < nr_words; w++) {
+                    const int32_t *v = &values[w << 5];
+                    uint32_t m = 0;
+                    for (uint32_t each_row = 0; each_row < 32; each_row++) {
+                        bool found = false;
+                        for (uint32_t each_constant = 0; each_constant < count; each_constant++) {
+                            found |= v[each_row] == constants[each_constant];
+                        }
+                        m |= (uint32_t)found << each_row;
+                    }
+                    mask[w] = m;
+                }
+                break;
+            }
+            case MRAM_SCAN_AND:
+                top--;
+                for (uint32_t w = 0; w < nr_words; w++) {
+                    stack[top - 1][w] &= stack[top][w];
+                }
+                break;
+            case MRAM_SCAN_OR:
+                top--;
+                for (uint32_t w = 0; w < nr_words; w++) {
+                    stack[top - 1][w] |= stack[top][w];
+                }
+                break;
+            case MRAM_SCAN_NOT:
+                for (uint32_t w = 0; w < nr_words; w++) {
+                    stack[top - 1][w] = ~stack[top - 1][w];
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    /* Clear the rows past the end of the block, and the words that were not evaluated. */
+    if ((nr_rows & 31) != 0) {
+        stack[0][nr_words - 1] &= (1u << (nr_rows & 31)) - 1;
+    }
+    for (uint32_t w = nr_words; w < __MRAM_SCAN_NR_WORDS; w++) {
+        stack[0][w] = 0;
+    }
+    return stack[0];
+}
+
+/*
+ * Evaluates the blocks [*first, *last) of the invoking tasklet into the bitmap, and returns the number of selected rows.
+ */
+static inline uint32_t
+__mram_scan_evaluate(struct mram_scan *s,
+    const struct mram_scan_program *program,
+    const __mram_ptr int32_t *const *columns,
+    uint32_t nr_rows,
+    __mram_ptr uint8_t *bitmap,
+    uint32_t *first,
+    uint32_t *last)
+{
+    uint32_t nr_blocks = (nr_rows + MRAM_SCAN_BLOCK_ROWS - 1) / MRAM_SCAN_BLOCK_ROWS;
+    uint32_t per_tasklet = (nr_blocks + __MRAM_SCAN_NR_TASKLETS - 1) / __MRAM_SCAN_NR_TASKLETS;
+    uint32_t from = me() * per_tasklet;
+    uint32_t to = from + per_tasklet;
+    uint32_t count = 0;
+
+    if (to > nr_blocks) {
+        to = nr_blocks;
+    }
+    if (from > to) {
+        from = to;
+    }
+
+    for (uint32_t each_block = from; each_block < to; each_block++) {
+        uint32_t row = each_block * MRAM_SCAN_BLOCK_ROWS;
+        uint32_t n = nr_rows - row < MRAM_SCAN_BLOCK_ROWS ? nr_rows - row : MRAM_SCAN_BLOCK_ROWS;
+        uint32_t *mask = __mram_scan_block(s, program, columns, row, n);
+
+        for (uint32_t w = 0; w < __MRAM_SCAN_NR_WORDS; w++) {
+            count += __builtin_popcount(mask[w]);
+        }
+        mram_write(mask, &bitmap[each_block * (MRAM_SCAN_BLOCK_ROWS / 8)], MRAM_SCAN_BLOCK_ROWS / 8);
+    }
+
+    *first = from;
+    *last = to;
+    return count;
+}
+
+/**
+ * @fn mram_scan_bitmap
+ * @brief Selects the rows of a table satisfying a predicate, as a bitmap.
+ *
+ * Must be called by all the tasklets, with the same arguments. The bitmap is complete when the tasklets return.
+ *
+ * @param s the state of the scan
+ * @param program the predicate
+ * @param columns the MRAM address of each column, 8-byte aligned
+ * @param nr_rows the number of rows
+ * @param bitmap the MRAM bitmap receiving the selection, 8-byte aligned, of MRAM_SCAN_BITMAP_SIZE(nr_rows) bytes
+ * @return The number of selected rows.
+ */
+static inline uint32_t
+mram_scan_bitmap(struct mram_scan *s,
+    const struct mram_scan_program *program,
+    const __mram_ptr int32_t *const *columns,
+    uint32_t nr_rows,
+    __mram_ptr uint8_t *bitmap)
+{
+    uint32_t first, last, total;
+
+    tasklet_scan_exclusive(s->scan, __mram_scan_evaluate(s, program, columns, nr_rows, bitmap, &first, &last), &total);
+    return total;
+}
+
+/**
+ * @fn mram_scan_row_ids
+ * @brief Selects the rows of a table satisfying a predicate, as the list of their indices.
+ *
+ * Must be called by all the tasklets, with the same arguments. The row indices, in increasing order, are complete when
+ * the tasklets return. The bitmap of the selection is built on the way.
+ *
+ * @param s the state of the scan
+ * @param program the predicate
+ * @param columns the MRAM address of each column, 8-byte aligned
+ * @param nr_rows the number of rows
+ * @param bitmap the MRAM bitmap receiving the selection, 8-byte aligned, of MRAM_SCAN_BITMAP_SIZE(nr_rows) bytes
+ * @param row_ids the MRAM array receiving the indices of the selected rows, 8-byte aligned
+ * @return The number of selected rows.
+ */
+static inline uint32_t
+mram_scan_row_ids(struct mram_scan *s,
+    const struct mram_scan_program *program,
+    const __mram_ptr int32_t *const *columns,
+    uint32_t nr_rows,
+    __mram_ptr uint8_t *bitmap,
+    __mram_ptr uint32_t *row_ids)
+{
+    uint32_t *words = (uint32_t *)s->values[me()];
+    uint32_t first, last, total, offset;
+    mram_scatter_writer_t writer;
+
+    offset = tasklet_scan_exclusive(
+        s->scan, __mram_scan_evaluate(s, program, columns, nr_rows, bitmap, &first, &last), &total);
+
+    /* Read back the bitmap of the blocks of the tasklet, and write the indices of the selected rows. */
+    writer = mram_scatter_writer(s->scatter);
+    mram_scatter_set_destination(&writer, 0, &row_ids[offset]);
+    for (uint32_t each_block = first; each_block < last; each_block++) {
+        uint32_t row = each_block * MRAM_SCAN_BLOCK_ROWS;
+        mram_read(&bitmap[each_block * (MRAM_SCAN_BLOCK_ROWS / 8)], words, MRAM_SCAN_BLOCK_ROWS / 8);
+        for (uint32_t w = 0; w < __MRAM_SCAN_NR_WORDS; w++) {
+            uint32_t m = words[w];
+            while (m != 0) {
+                uint32_t id = row + (w << 5) + __builtin_ctz(m);
+                mram_scatter_push(&writer, 0, &id, sizeof(id));
+                m &= m - 1;
+            }
+        }
+    }
+    mram_scatter_flush(&writer);
+    return total;
+}
+
+#endif /* DPUSYSCORE_MRAM_SCAN_H */
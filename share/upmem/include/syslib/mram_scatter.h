@@ -0,0 +1,273 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_SCATTER_H
+#define DPUSYSCORE_MRAM_SCATTER_H
+
+/**
+ * @file mram_scatter.h
+ * @brief Write-combining scatter of elements to many MRAM destinations.
+ *
+ * Partitioning and bucketing kernels append elements to many MRAM areas (the partitions). Writing each element with its
+ * own DMA is slow and, since mram_write requires 8-byte aligned addresses and sizes, small elements would need a
+ * read-modify-write of MRAM.
+ *
+ * A scatter engine gives each tasklet one WRAM staging line per partition. Elements are appended to the line of their
+ * partition, and a full line is written to MRAM with a single mram_write. The first and last 8-byte words of a partition
+ * may be shared with the neighbouring partitions (when the partitions are not 8-byte aligned): these words are updated
+ * with a locked read-modify-write, using the virtual mutexes of mram_unaligned.h, so that tasklets can fill adjacent
+ * partitions concurrently.
+ *
+ * The WRAM used by each tasklet is nr_partitions * (line_size + 8) bytes, and the lines of all the tasklets must fit in
+ * the 64 KB of WRAM with the stacks and the other buffers. With 16 tasklets, 64 partitions with 16-byte lines take 1.5 KB
+ * per tasklet, 24 KB in total, and 16 partitions with 64-byte lines take 1.1 KB per tasklet, 18 KB in total. A few
+ * hundred partitions only fit with fewer tasklets: 256 partitions with 8-byte lines take 4 KB per tasklet, 32 KB with 8
+ * tasklets.
+ *
+ * Typical usage:
+ *
+ *     MRAM_SCATTER_INIT(scatter, NR_PARTITIONS, 64);
+ *
+ *     mram_scatter_writer_t writer = mram_scatter_writer(&scatter);
+ *     for (p = 0; p < NR_PARTITIONS; p++)
+ *         mram_scatter_set_destination(&writer, p, &output[partition_offset[me()][p]]);
+ *     for each element:
+ *         mram_scatter_push(&writer, partition_of(element), &element, sizeof(element));
+ *     mram_scatter_flush(&writer);
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <defs.h>
+#include <mram.h>
+#include <vmutex.h>
+#include <mram_unaligned.h>
+#include <dpu_characteristics.h>
+
+#ifdef NR_TASKLETS
+#define __MRAM_SCATTER_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_SCATTER_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/*
+ * State of one partition for one tasklet: the staging line maps the 8-byte aligned MRAM address mram.
+ * The bytes of the line in [valid_from, fill) are pending, the bytes before valid_from are not owned by the partition
+ * or have already been written.
+ */
+struct __mram_scatter_partition {
+    uint32_t mram;
+    uint16_t fill;
+    uint16_t valid_from;
+};
+
+/**
+ * @struct mram_scatter
+ * @brief A scatter engine, as declared by MRAM_SCATTER_INIT.
+ */
+struct mram_scatter {
+    uint32_t nr_partitions;
+    uint32_t line_log2;
+    struct __mram_scatter_partition *partitions;
+    uint8_t *lines;
+};
+
+/**
+ * @typedef mram_scatter_writer_t
+ * @brief The view of a scatter engine used by one tasklet, as returned by mram_scatter_writer.
+ */
+typedef struct mram_scatter_writer {
+    uint32_t line_log2;
+    uint32_t nr_partitions;
+    struct __mram_scatter_partition *partitions;
+    uint8_t *lines;
+} mram_scatter_writer_t;
+
+/**
+ * @def MRAM_SCATTER_INIT
+ * @hideinitializer
+ * @brief Declare and initialize a scatter engine with the given number of partitions and the given staging line size.
+ *
+ * The line size is the largest DMA performed by the engine. It must be a power of 2 between 8 and 2048.
+ */
+#define MRAM_SCATTER_INIT(NAME, NR_PARTITIONS, LINE_SIZE)                                                                        \
+    static_assert((LINE_SIZE) >= 8 && (LINE_SIZE) <= 2048 && ((LINE_SIZE) & ((LINE_SIZE)-1)) == 0,                               \
+        "Line size should be a power of 2 between 8 and 2048");                                                                  \
+    __dma_aligned uint8_t mram_scatter_lines_##NAME[__MRAM_SCATTER_NR_TASKLETS * (NR_PARTITIONS) * (LINE_SIZE)];                 \
+    struct __mram_scatter_partition mram_scatter_partitions_##NAME[__MRAM_SCATTER_NR_TASKLETS * (NR_PARTITIONS)];                \
+    struct mram_scatter NAME = { .nr_partitions = (NR_PARTITIONS),                                                               \
+        .line_log2 = __builtin_ctz(LINE_SIZE),                                                                                   \
+        .partitions = mram_scatter_partitions_##NAME,                                                                            \
+        .lines = mram_scatter_lines_##NAME };
+
+/**
+ * @fn mram_scatter_writer
+ * @brief Returns the view of the scatter engine for the invoking tasklet.
+ * @param s the scatter engine
+ * @return The writer to use with the other functions of the scatter engine.
+ */
+static inline mram_scatter_writer_t
+mram_scatter_writer(struct mram_scatter *s)
+{
+    uint32_t first = me() * s->nr_partitions;
+    mram_scatter_writer_t writer = {
+        .line_log2 = s->line_log2,
+        .nr_partitions = s->nr_partitions,
+        .partitions = s->partitions + first,
+        .lines = s->lines + (first << s->line_log2),
+    };
+    return writer;
+}
+
+/*
+ * Writes bytes [lo, hi) of an 8-byte word of WRAM to the corresponding MRAM word, keeping the other bytes of the MRAM word.
+ */
+static inline void
+__mram_scatter_merge_word(const uint8_t *word, uintptr_t mram, uint32_t lo, uint32_t hi)
+{
+    uint16_t lock = (mram >> 3) & ((1 << __MRAM_UNALIGNED_ACCESS_LOG_NB_VLOCK) - 1);
+    uint8_t *buffer = &__mram_unaligned_access_buffer[me() << 3];
+
+    vmutex_lock(&__mram_unaligned_access_virtual_locks, lock);
+    mram_read((const __mram_ptr void *)mram, buffer, 8);
+    for (uint32_t i = lo; i < hi; i++) {
+        buffer[i] = word[i];
+    }
+    mram_write(buffer, (__mram_ptr void *)mram, 8);
+    vmutex_unlock(&__mram_unaligned_access_virtual_locks, lock);
+}
+
+/*
+ * Writes bytes [from, to) of a staging line to MRAM: the partial words at both ends with a read-modify-write, the rest
+ * with a single mram_write.
+ */
+static inline void
+__mram_scatter_write_range(const uint8_t *line, uintptr_t mram, uint32_t from, uint32_t to)
+{
+    uint32_t body_end;
+
+    if (from >= to) {
+        return;
+    }
+
+    if ((from & 7) != 0) {
+        uint32_t word = from & ~7;
+        uint32_t stop = to < word + 8 ? to : word + 8;
+        __mram_scatter_merge_word(line + word, mram + word, from - word, stop - word);
+        from = stop;
+    }
+
+    body_end = to & ~7;
+    if (body_end > from) {
+        mram_write(line + from, (__mram_ptr void *)(mram + from), body_end - from);
+        from = body_end;
+    }
+
+    if (from < to) {
+        __mram_scatter_merge_word(line + from, mram + from, 0, to - from);
+    }
+}
+
+/**
+ * @fn mram_scatter_set_destination
+ * @brief Sets the MRAM address where the next elements of a partition are written by the invoking tasklet.
+ *
+ * Any element still pending for the partition must have been flushed before.
+ *
+ * @param w the writer of the invoking tasklet
+ * @param partition the partition
+ * @param destination the MRAM address, which needs not be aligned
+ */
+static inline void
+mram_scatter_set_destination(mram_scatter_writer_t *w, uint32_t partition, __mram_ptr void *destination)
+{
+    struct __mram_scatter_partition *p = &w->partitions[partition];
+    uintptr_t address = (uintptr_t)destination;
+
+    p->mram = address & ~7;
+    p->fill = address & 7;
+    p->valid_from = address & 7;
+}
+
+/**
+ * @fn mram_scatter_push
+ * @brief Appends an element to a partition.
+ *
+ * The staging line of the partition is written to MRAM when it is full.
+ *
+ * @param w the writer of the invoking tasklet
+ * @param partition the partition
+ * @param element the element to append, in WRAM
+ * @param size the size of the element, in bytes
+ */
+static inline void
+mram_scatter_push(mram_scatter_writer_t *w, uint32_t partition, const void *element, uint32_t size)
+{
+    struct __mram_scatter_partition *p = &w->partitions[partition];
+    uint8_t *line = w->lines + (partition << w->line_log2);
+    uint32_t line_size = 1 << w->line_log2;
+    const uint8_t *from = (const uint8_t *)element;
+
+    while (size != 0) {
+        uint32_t room = line_size - p->fill;
+        uint32_t nr_bytes = size < room ? size : room;
+        uint8_t *to = line + p->fill;
+
+        if (nr_bytes == sizeof(uint32_t) && (((uintptr_t)to | (uintptr_t)from) & 3) == 0) {
+            *(uint32_t *)to = *(const uint32_t *)from;
+        } else if (nr_bytes == sizeof(uint64_t) && (((uintptr_t)to | (uintptr_t)from) & 7) == 0) {
+            *(uint64_t *)to = *(const uint64_t *)from;
+        } else {
+            memcpy(to, from, nr_bytes);
+        }
+        p->fill += nr_bytes;
+        from += nr_bytes;
+        size -= nr_bytes;
+
+        if (p->fill == line_size) {
+            __mram_scatter_write_range(line, p->mram, p->valid_from, line_size);
+            p->mram += line_size;
+            p->fill = 0;
+            p->valid_from = 0;
+        }
+    }
+}
+
+/**
+ * @fn mram_scatter_tell
+ * @brief Returns the MRAM address where the next element of a partition will be written.
+ * @param w the writer of the invoking tasklet
+ * @param partition the partition
+ * @return The MRAM address following the last element pushed to the partition.
+ */
+static inline __mram_ptr void *
+mram_scatter_tell(mram_scatter_writer_t *w, uint32_t partition)
+{
+    struct __mram_scatter_partition *p = &w->partitions[partition];
+    return (__mram_ptr void *)(p->mram + p->fill);
+}
+
+/**
+ * @fn mram_scatter_flush
+ * @brief Writes to MRAM the elements pending in all the staging lines of the invoking tasklet.
+ *
+ * Must be called before the partitions are read by other tasklets or by the host. The tasklet can keep pushing
+ * elements after a flush.
+ *
+ * @param w the writer of the invoking tasklet
+ */
+static inline void
+mram_scatter_flush(mram_scatter_writer_t *w)
+{
+    for (uint32_t each_partition = 0; each_partition < w->nr_partitions; each_partition++) {
+        struct __mram_scatter_partition *p = &w->partitions[each_partition];
+        uint8_t *line = w->lines + (each_partition << w->line_log2);
+
+        __mram_scatter_write_range(line, p->mram, p->valid_from, p->fill);
+        p->valid_from = p->fill;
+    }
+}
+
+#endif /* DPUSYSCORE_MRAM_SCATTER_H */
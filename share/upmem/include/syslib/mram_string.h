@@ -0,0 +1,334 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_MRAM_STRING_H
+#define DPUSYSCORE_MRAM_STRING_H
+
+/**
+ * @file mram_string.h
+ * @brief Copy, move and set areas of MRAM of any size and alignment.
+ *
+ * mram_read and mram_write transfer at most 2048 bytes between MRAM and WRAM, from and to 8-byte aligned addresses,
+ * and the functions of string.h only operate on WRAM. The functions of this file operate directly on MRAM: the data
+ * streams through a WRAM bounce buffer provided by the invoking tasklet, in DMAs as large as the buffer.
+ *
+ * The source and destination addresses and the size need not be multiples of 8. When the source and the destination
+ * have a different alignment, the data is realigned in WRAM. The partial 8-byte words at both ends of the destination
+ * are updated with a read-modify-write of MRAM, which is not atomic: another tasklet must not write the bytes sharing
+ * these words at the same time.
+ *
+ * The bounce buffer must be 8-byte aligned and hold MRAM_STRING_BUFFER_SIZE bytes.
+ *
+ * The _parallel variants split one operation between all the tasklets: each of the NR_TASKLETS tasklets must call the
+ * function with the same arguments (except for the buffer), and the operation is complete once they all returned
+ * (typically after a barrier). The tasklet slices are 8-byte aligned in the destination, so that the tasklets never
+ * share a partial word.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <defs.h>
+#include <mram.h>
+#include <dpu_characteristics.h>
+
+#ifndef MRAM_STRING_BUFFER_SIZE
+/**
+ * @def MRAM_STRING_BUFFER_SIZE
+ * @hideinitializer
+ * @brief Size of the WRAM bounce buffer given to the functions of mram_string.h.
+ */
+#define MRAM_STRING_BUFFER_SIZE 1024
+#endif
+
+_Static_assert((MRAM_STRING_BUFFER_SIZE & 7) == 0 && MRAM_STRING_BUFFER_SIZE >= 32 && MRAM_STRING_BUFFER_SIZE <= 2048,
+    "mram_string error: invalid buffer size defined");
+
+#ifdef NR_TASKLETS
+#define __MRAM_STRING_NR_TASKLETS NR_TASKLETS
+#else
+#define __MRAM_STRING_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/*
+ * Moves buffer[shift, shift + length) to buffer[0, length), with shift in [1, 7] and length a multiple of 8.
+ * The buffer holds at least length + 8 bytes.
+ */
+static inline void
+__mram_string_realign(uint8_t *buffer, uint32_t shift, uint32_t length)
+{
+    uint32_t *words = (uint32_t *)buffer;
+    const uint32_t *from = (const uint32_t *)(buffer + (shift & 4));
+    uint32_t nr_words = length >> 2;
+    uint32_t right = (shift & 3) << 3;
+
+    if (right == 0) {
+        for (uint32_t i = 0; i < nr_words; i++) {
+            words[i] = from[i];
+        }
+    } else {
+        uint32_t left = 32 - right;
+        for (uint32_t i = 0; i < nr_words; i++) {
+            words[i] = (from[i] >> right) | (from[i + 1] << left);
+        }
+    }
+}
+
+/*
+ * Copies length bytes from any MRAM address to an 8-byte aligned MRAM address.
+ * The length is a multiple of 8, at most MRAM_STRING_BUFFER_SIZE - 8 (or MRAM_STRING_BUFFER_SIZE when src is aligned).
+ */
+static inline void
+__mram_string_copy_block(uintptr_t dest, uintptr_t src, uint32_t length, uint8_t *buffer)
+{
+    uint32_t shift = src & 7;
+
+    mram_read((const __mram_ptr void *)(src & ~7), buffer, (shift + length + 7) & ~7);
+    if (shift != 0) {
+        __mram_string_realign(buffer, shift, length);
+    }
+    mram_write(buffer, (__mram_ptr void *)dest, length);
+}
+
+/*
+ * Copies length bytes (less than 8, all in the same 8-byte word of the destination) with a read-modify-write.
+ */
+static inline void
+__mram_string_copy_partial(uintptr_t dest, uintptr_t src, uint32_t length, uint8_t *buffer)
+{
+    uintptr_t word = dest & ~7;
+    uint32_t offset = dest & 7;
+    uint32_t shift = src & 7;
+
+    mram_read((const __mram_ptr void *)word, buffer, 8);
+    mram_read((const __mram_ptr void *)(src & ~7), buffer + 8, (shift + length + 7) & ~7);
+    for (uint32_t i = 0; i < length; i++) {
+        buffer[offset + i] = buffer[8 + shift + i];
+    }
+    mram_write(buffer, (__mram_ptr void *)word, 8);
+}
+
+static inline void
+__mram_string_copy_forward(uintptr_t dest, uintptr_t src, uint32_t n, uint8_t *buffer)
+{
+    uint32_t head = (8 - (dest & 7)) & 7;
+    uint32_t block;
+
+    if (head > n) {
+        head = n;
+    }
+    if (head != 0) {
+        __mram_string_copy_partial(dest, src, head, buffer);
+        dest += head;
+        src += head;
+        n -= head;
+    }
+
+    block = (src & 7) != 0 ? MRAM_STRING_BUFFER_SIZE - 8 : MRAM_STRING_BUFFER_SIZE;
+    while (n >= 8) {
+        uint32_t length = n & ~7;
+        if (length > block) {
+            length = block;
+        }
+        __mram_string_copy_block(dest, src, length, buffer);
+        dest += length;
+        src += length;
+        n -= length;
+    }
+
+    if (n != 0) {
+        __mram_string_copy_partial(dest, src, n, buffer);
+    }
+}
+
+static inline void
+__mram_string_copy_backward(uintptr_t dest, uintptr_t src, uint32_t n, uint8_t *buffer)
+{
+    uint32_t tail = (dest + n) & 7;
+    uint32_t block;
+
+    if (tail > n) {
+        tail = n;
+    }
+    if (tail != 0) {
+        n -= tail;
+        __mram_string_copy_partial(dest + n, src + n, tail, buffer);
+    }
+
+    block = (src & 7) != 0 ? MRAM_STRING_BUFFER_SIZE - 8 : MRAM_STRING_BUFFER_SIZE;
+    while (n >= 8) {
+        uint32_t length = n & ~7;
+        if (length > block) {
+            length = block;
+        }
+        n -= length;
+        __mram_string_copy_block(dest + n, src + n, length, buffer);
+    }
+
+    if (n != 0) {
+        __mram_string_copy_partial(dest, src, n, buffer);
+    }
+}
+
+/*
+ * Bytes [from, to) of an operation of n bytes at dest handled by the invoking tasklet in a _parallel variant.
+ */
+static inline void
+__mram_string_slice(uintptr_t dest, uint32_t n, uint32_t *from, uint32_t *to)
+{
+    uint32_t offset = dest & 7;
+    uint32_t total = offset + n;
+    uint32_t slice = (((total + __MRAM_STRING_NR_TASKLETS - 1) / __MRAM_STRING_NR_TASKLETS) + 7) & ~7;
+    uint32_t begin = me() * slice;
+    uint32_t end = begin + slice;
+
+    if (end > total) {
+        end = total;
+    }
+    if (begin < offset) {
+        begin = offset;
+    }
+    if (begin >= end) {
+        *from = 0;
+        *to = 0;
+    } else {
+        *from = begin - offset;
+        *to = end - offset;
+    }
+}
+
+/**
+ * @fn mram_memcpy
+ * @brief Copies n bytes from an MRAM area to another MRAM area. The areas must not overlap.
+ * @param dest the destination address in MRAM
+ * @param src the source address in MRAM
+ * @param n the number of bytes to copy
+ * @param buffer a WRAM bounce buffer of MRAM_STRING_BUFFER_SIZE bytes, 8-byte aligned
+ * @return dest
+ */
+static inline __mram_ptr void *
+mram_memcpy(__mram_ptr void *dest, const __mram_ptr void *src, uint32_t n, void *buffer)
+{
+    __mram_string_copy_forward((uintptr_t)dest, (uintptr_t)src, n, (uint8_t *)buffer);
+    return dest;
+}
+
+/**
+ * @fn mram_memmove
+ * @brief Copies n bytes from an MRAM area to another MRAM area. The areas may overlap.
+ * @param dest the destination address in MRAM
+ * @param src the source address in MRAM
+ * @param n the number of bytes to copy
+ * @param buffer a WRAM bounce buffer of MRAM_STRING_BUFFER_SIZE bytes, 8-byte aligned
+ * @return dest
+ */
+static inline __mram_ptr void *
+mram_memmove(__mram_ptr void *dest, const __mram_ptr void *src, uint32_t n, void *buffer)
+{
+    uintptr_t to = (uintptr_t)dest;
+    uintptr_t from = (uintptr_t)src;
+
+    if (to <= from || to >= from + n) {
+        if (to != from) {
+            __mram_string_copy_forward(to, from, n, (uint8_t *)buffer);
+        }
+    } else {
+        __mram_string_copy_backward(to, from, n, (uint8_t *)buffer);
+    }
+    return dest;
+}
+
+/**
+ * @fn mram_memset
+ * @brief Sets n bytes of an MRAM area to the given value.
+ * @param dest the destination address in MRAM
+ * @param value the value of the bytes
+ * @param n the number of bytes to set
+ * @param buffer a WRAM bounce buffer of MRAM_STRING_BUFFER_SIZE bytes, 8-byte aligned
+ * @return dest
+ */
+static inline __mram_ptr void *
+mram_memset(__mram_ptr void *dest, int value, uint32_t n, void *buffer)
+{
+    uintptr_t to = (uintptr_t)dest;
+    uint8_t *bytes = (uint8_t *)buffer;
+    uint32_t head = (8 - (to & 7)) & 7;
+    uint32_t fill;
+
+    if (head > n) {
+        head = n;
+    }
+    if (head != 0) {
+        mram_read((const __mram_ptr void *)(to & ~7), bytes, 8);
+        memset(bytes + (to & 7), value, head);
+        mram_write(bytes, (__mram_ptr void *)(to & ~7), 8);
+        to += head;
+        n -= head;
+    }
+
+    fill = (n + 7) & ~7;
+    memset(bytes, value, fill < MRAM_STRING_BUFFER_SIZE ? fill : MRAM_STRING_BUFFER_SIZE);
+    while (n >= 8) {
+        uint32_t length = n & ~7;
+        if (length > MRAM_STRING_BUFFER_SIZE) {
+            length = MRAM_STRING_BUFFER_SIZE;
+        }
+        mram_write(bytes, (__mram_ptr void *)to, length);
+        to += length;
+        n -= length;
+    }
+
+    if (n != 0) {
+        mram_read((const __mram_ptr void *)to, bytes, 8);
+        memset(bytes, value, n);
+        mram_write(bytes, (__mram_ptr void *)to, 8);
+    }
+    return dest;
+}
+
+/**
+ * @fn mram_memcpy_parallel
+ * @brief Copies n bytes from an MRAM area to another MRAM area, the work being split between all the tasklets.
+ *
+ * Every tasklet must call this function with the same dest, src and n. The areas must not overlap.
+ *
+ * @param dest the destination address in MRAM
+ * @param src the source address in MRAM
+ * @param n the number of bytes to copy
+ * @param buffer a WRAM bounce buffer of MRAM_STRING_BUFFER_SIZE bytes, 8-byte aligned, owned by the invoking tasklet
+ */
+static inline void
+mram_memcpy_parallel(__mram_ptr void *dest, const __mram_ptr void *src, uint32_t n, void *buffer)
+{
+    uint32_t from, to;
+
+    __mram_string_slice((uintptr_t)dest, n, &from, &to);
+    if (from != to) {
+        __mram_string_copy_forward((uintptr_t)dest + from, (uintptr_t)src + from, to - from, (uint8_t *)buffer);
+    }
+}
+
+/**
+ * @fn mram_memset_parallel
+ * @brief Sets n bytes of an MRAM area to the given value, the work being split between all the tasklets.
+ *
+ * Every tasklet must call this function with the same dest, value and n.
+ *
+ * @param dest the destination address in MRAM
+ * @param value the value of the bytes
+ * @param n the number of bytes to set
+ * @param buffer a WRAM bounce buffer of MRAM_STRING_BUFFER_SIZE bytes, 8-byte aligned, owned by the invoking tasklet
+ */
+static inline void
+mram_memset_parallel(__mram_ptr void *dest, int value, uint32_t n, void *buffer)
+{
+    uint32_t from, to;
+
+    __mram_string_slice((uintptr_t)dest, n, &from, &to);
+    if (from != to) {
+        mram_memset((__mram_ptr void *)((uintptr_t)dest + from), value, to - from, buffer);
+    }
+}
+
+#endif /* DPUSYSCORE_MRAM_STRING_H */
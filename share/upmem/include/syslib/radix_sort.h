@@ -0,0 +1,219 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_RADIX_SORT_H
+#define DPUSYSCORE_RADIX_SORT_H
+
+/**
+ * @file radix_sort.h
+ * @brief Stable sort of an MRAM array by unsigned integer keys, split between all the tasklets.
+ *
+ * The elements are sorted with an LSD radix sort, RADIX_SORT_DIGIT_BITS bits of key per pass. Each pass:
+ *  - each tasklet builds the histogram of the digits of its slice of the input in WRAM,
+ *  - the histograms are turned into output offsets with tasklet_scan_histograms,
+ *  - each tasklet scatters its slice into the other MRAM buffer through the write-combining lines of mram_scatter.h.
+ *
+ * The input and a scratch array of the same size are used as ping-pong buffers, and a pass is skipped when all the keys
+ * have the same digit, so the sorted elements can end in either buffer: radix_sort returns the one holding them.
+ *
+ * An element starts with its key, a little-endian unsigned integer of 4 or 8 bytes, and can carry a payload: the element
+ * size must be a multiple of the key size, and at most RADIX_SORT_BLOCK_SIZE / 2. Signed keys can be sorted by flipping
+ * their sign bit before and after the sort.
+ *
+ * The WRAM used by each tasklet is (1 << RADIX_SORT_DIGIT_BITS) * (RADIX_SORT_LINE_SIZE + 12) + RADIX_SORT_BLOCK_SIZE
+ * bytes: 1920 bytes with the default parameters.
+ */
+
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <mram_scatter.h>
+#include <tasklet_scan.h>
+#include <dpu_characteristics.h>
+
+#ifndef RADIX_SORT_DIGIT_BITS
+/**
+ * @def RADIX_SORT_DIGIT_BITS
+ * @hideinitializer
+ * @brief Number of bits of key sorted by each pass.
+ */
+#define RADIX_SORT_DIGIT_BITS 5
+#endif
+
+#ifndef RADIX_SORT_LINE_SIZE
+/**
+ * @def RADIX_SORT_LINE_SIZE
+ * @hideinitializer
+ * @brief Size of the write-combining line of each bucket, which is the size of the DMAs of the scatter phase.
+ */
+#define RADIX_SORT_LINE_SIZE 32
+#endif
+
+#ifndef RADIX_SORT_BLOCK_SIZE
+/**
+ * @def RADIX_SORT_BLOCK_SIZE
+ * @hideinitializer
+ * @brief Size of the DMAs reading the input of each pass.
+ */
+#define RADIX_SORT_BLOCK_SIZE 512
+#endif
+
+_Static_assert(RADIX_SORT_DIGIT_BITS >= 1 && RADIX_SORT_DIGIT_BITS <= 8, "radix_sort error: invalid digit size defined");
+_Static_assert((RADIX_SORT_BLOCK_SIZE & 7) == 0 && RADIX_SORT_BLOCK_SIZE >= 16 && RADIX_SORT_BLOCK_SIZE <= 2048,
+    "radix_sort error: invalid block size defined");
+
+#ifdef NR_TASKLETS
+#define __RADIX_SORT_NR_TASKLETS NR_TASKLETS
+#else
+#define __RADIX_SORT_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+#define __RADIX_SORT_NR_BUCKETS (1 << RADIX_SORT_DIGIT_BITS)
+
+/**
+ * @struct radix_sort
+ * @brief The WRAM state of the sort, as declared by RADIX_SORT_INIT.
+ */
+struct radix_sort {
+    struct mram_scatter *scatter;
+    struct tasklet_scan *scan;
+    barrier_t *barrier;
+    uint32_t (*histograms)[__RADIX_SORT_NR_BUCKETS];
+    uint8_t (*blocks)[RADIX_SORT_BLOCK_SIZE];
+};
+
+/**
+ * @def RADIX_SORT_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of a sort.
+ */
+#define RADIX_SORT_INIT(NAME)                                                                                                    \
+    MRAM_SCATTER_INIT(radix_sort_scatter_##NAME, __RADIX_SORT_NR_BUCKETS, RADIX_SORT_LINE_SIZE);                                 \
+    TASKLET_SCAN_INIT(radix_sort_scan_##NAME, __RADIX_SORT_NR_BUCKETS);                                                          \
+    BARRIER_INIT(radix_sort_barrier_##NAME, __RADIX_SORT_NR_TASKLETS);                                                           \
+    uint32_t radix_sort_histograms_##NAME[__RADIX_SORT_NR_TASKLETS][__RADIX_SORT_NR_BUCKETS];                                    \
+    __dma_aligned uint8_t radix_sort_blocks_##NAME[__RADIX_SORT_NR_TASKLETS][RADIX_SORT_BLOCK_SIZE];                             \
+    struct radix_sort NAME = { .scatter = &radix_sort_scatter_##NAME,                                                            \
+        .scan = &radix_sort_scan_##NAME,                                                                                         \
+        .barrier = &radix_sort_barrier_##NAME,                                                                                   \
+        .histograms = radix_sort_histograms_##NAME,                                                                              \
+        .blocks = radix_sort_blocks_##NAME };
+
+static inline uint32_t
+__radix_sort_digit(const uint8_t *element, uint32_t key_size, uint32_t shift)
+{
+    if (key_size == sizeof(uint32_t)) {
+        return (*(const uint32_t *)element >> shift) & (__RADIX_SORT_NR_BUCKETS - 1);
+    }
+    return (uint32_t)(*(const uint64_t *)element >> shift) & (__RADIX_SORT_NR_BUCKETS - 1);
+}
+
+/*
+ * Reads the elements [from, from + count) of an MRAM array into a block.
+ * The tasklet slices and the blocks start at even element offsets, so that the DMAs are 8-byte aligned.
+ */
+static inline void
+__radix_sort_load(uintptr_t array, uint32_t from, uint32_t count, uint32_t element_size, uint8_t *block)
+{
+    mram_read((const __mram_ptr void *)(array + from * element_size), block, (count * element_size + 7) & ~7);
+}
+
+/**
+ * @fn radix_sort
+ * @brief Sorts an MRAM array of elements by their key.
+ *
+ * Must be called by all the tasklets, with the same arguments. The sorted elements are in the returned buffer when the
+ * tasklets return.
+ *
+ * @param s the state of the sort
+ * @param data the elements to sort, 8-byte aligned in MRAM
+ * @param scratch an MRAM array of the same size, 8-byte aligned
+ * @param nr_elements the number of elements
+ * @param element_size the size of an element, in bytes
+ * @param key_size the size of the key at the beginning of each element: 4 or 8 bytes
+ * @return data or scratch, whichever holds the sorted elements.
+ */
+static inline __mram_ptr void *
+radix_sort(struct radix_sort *s,
+    __mram_ptr void *data,
+    __mram_ptr void *scratch,
+    uint32_t nr_elements,
+    uint32_t element_size,
+    uint32_t key_size)
+{
+    sysname_t id = me();
+    uint32_t *histogram = s->histograms[id];
+    uint8_t *block = s->blocks[id];
+    uint32_t per_block = (RADIX_SORT_BLOCK_SIZE / element_size) & ~1;
+    uint32_t per_tasklet = (((nr_elements + __RADIX_SORT_NR_TASKLETS - 1) / __RADIX_SORT_NR_TASKLETS) + 1) & ~1;
+    uint32_t from = id * per_tasklet;
+    uint32_t to = from + per_tasklet;
+    uintptr_t input = (uintptr_t)data;
+    uintptr_t output = (uintptr_t)scratch;
+
+    if (to > nr_elements) {
+        to = nr_elements;
+    }
+    if (from > to) {
+        from = to;
+    }
+
+    for (uint32_t shift = 0; shift < (key_size << 3); shift += RADIX_SORT_DIGIT_BITS) {
+        mram_scatter_writer_t writer;
+        uint32_t first_bucket_end = 0;
+        uintptr_t swap;
+
+        /* The previous pass must be complete before reading its output. */
+        barrier_wait(s->barrier);
+
+        for (uint32_t each_bucket = 0; each_bucket < __RADIX_SORT_NR_BUCKETS; each_bucket++) {
+            histogram[each_bucket] = 0;
+        }
+        for (uint32_t i = from; i < to; i += per_block) {
+            uint32_t count = to - i < per_block ? to - i : per_block;
+            __radix_sort_load(input, i, count, element_size, block);
+            for (uint32_t j = 0, offset = 0; j < count; j++, offset += element_size) {
+                histogram[__radix_sort_digit(block + offset, key_size, shift)]++;
+            }
+        }
+
+        tasklet_scan_histograms(s->scan, histogram, __RADIX_SORT_NR_BUCKETS);
+
+        /* The histogram of tasklet 0 holds the start of each bucket: skip the pass if one bucket holds everything. */
+        for (uint32_t each_bucket = 0; each_bucket < __RADIX_SORT_NR_BUCKETS; each_bucket++) {
+            first_bucket_end = each_bucket + 1 < __RADIX_SORT_NR_BUCKETS ? s->histograms[0][each_bucket + 1] : nr_elements;
+            if (first_bucket_end != 0) {
+                break;
+            }
+        }
+        if (first_bucket_end == nr_elements) {
+            continue;
+        }
+
+        writer = mram_scatter_writer(s->scatter);
+        for (uint32_t each_bucket = 0; each_bucket < __RADIX_SORT_NR_BUCKETS; each_bucket++) {
+            mram_scatter_set_destination(
+                &writer, each_bucket, (__mram_ptr void *)(output + histogram[each_bucket] * element_size));
+        }
+        for (uint32_t i = from; i < to; i += per_block) {
+            uint32_t count = to - i < per_block ? to - i : per_block;
+            __radix_sort_load(input, i, count, element_size, block);
+            for (uint32_t j = 0, offset = 0; j < count; j++, offset += element_size) {
+                mram_scatter_push(&writer, __radix_sort_digit(block + offset, key_size, shift), block + offset, element_size);
+            }
+        }
+        mram_scatter_flush(&writer);
+
+        swap = input;
+        input = output;
+        output = swap;
+    }
+
+    barrier_wait(s->barrier);
+    return (__mram_ptr void *)input;
+}
+
+#endif /* DPUSYSCORE_RADIX_SORT_H */
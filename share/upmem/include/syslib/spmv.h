@@ -0,0 +1,296 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_SPMV_H
+#define DPUSYSCORE_SPMV_H
+
+/**
+ * @file spmv.h
+ * @brief Product of a sparse MRAM matrix with an MRAM vector (SpMV), in CSR or 2x2 block CSR format.
+ *
+ * The matrix is a list of entries sorted by row: single values in CSR format, dense blocks of SPMV_BLOCK_SIZE x
+ * SPMV_BLOCK_SIZE values in BCSR format, where the rows and the columns are rows and columns of blocks. Each entry has a
+ * column index, and row_offsets[r] is the index of the first entry of row r. CSR is handled as BCSR with 1x1 blocks.
+ *
+ * The entries, and not the rows, are split evenly between the tasklets: a row with many entries can be shared by several
+ * tasklets. A tasklet owns the rows starting in its range of entries, and writes their results. When its range starts in
+ * the middle of a row, it keeps the sum of the beginning of its range aside, and this sum is added to the result of the
+ * row after all the tasklets are done. The host splits the matrix between the DPUs in the same way (see dpu_spmv.h).
+ *
+ * The entries are processed by batches of SPMV_BATCH: the elements of x multiplied with a batch are loaded with
+ * mram_gather, which merges the elements close to each other into a single DMA. The application can set
+ * MRAM_GATHER_WINDOW_SIZE to a smaller value to save WRAM.
+ *
+ * The WRAM used by each tasklet is SPMV_BATCH * 50 + MRAM_GATHER_WINDOW_SIZE + 24 bytes: 3.6 KB with the default
+ * parameters, 2.1 KB with a window of 512 bytes.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <defs.h>
+#include <mram.h>
+#include <barrier.h>
+#include <mram_gather.h>
+#include <dpu_characteristics.h>
+
+#ifndef SPMV_BATCH
+/**
+ * @def SPMV_BATCH
+ * @hideinitializer
+ * @brief Number of entries processed at once, which sets the number of elements of x gathered at once.
+ */
+#define SPMV_BATCH 32
+#endif
+
+_Static_assert((SPMV_BATCH & 3) == 0 && SPMV_BATCH >= 4 && SPMV_BATCH <= 128, "spmv error: invalid batch size defined");
+
+/**
+ * @def SPMV_BLOCK_SIZE
+ * @brief Number of rows and of columns of the blocks of the BCSR format. Shared with the host, cannot be changed.
+ */
+#define SPMV_BLOCK_SIZE 2
+
+#ifdef NR_TASKLETS
+#define __SPMV_NR_TASKLETS NR_TASKLETS
+#else
+#define __SPMV_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @brief The format of the matrix.
+ */
+typedef enum _spmv_format_t {
+    /** One value per entry. */
+    SPMV_CSR = 0,
+    /** One block of SPMV_BLOCK_SIZE x SPMV_BLOCK_SIZE values per entry, stored row by row. */
+    SPMV_BCSR = 1,
+} spmv_format_t;
+
+/* The sums of the first row of a tasklet, when its range starts in the middle of the row. */
+struct __spmv_carry {
+    uint32_t row;
+    bool used;
+    int64_t sums[SPMV_BLOCK_SIZE];
+};
+
+/* The buffers of a tasklet. */
+struct __spmv_buffers {
+    uint32_t offsets[SPMV_BATCH];
+    uint32_t columns[SPMV_BATCH];
+    int32_t values[SPMV_BATCH * SPMV_BLOCK_SIZE * SPMV_BLOCK_SIZE];
+    int32_t xs[SPMV_BATCH * SPMV_BLOCK_SIZE];
+    int64_t ys[SPMV_BATCH * SPMV_BLOCK_SIZE];
+    uint16_t order[SPMV_BATCH];
+    uint8_t window[MRAM_GATHER_WINDOW_SIZE];
+};
+
+/**
+ * @struct spmv
+ * @brief The state of the products, as declared by SPMV_INIT.
+ */
+struct spmv {
+    barrier_t *barrier;
+    struct __spmv_carry *carries;
+    struct __spmv_buffers *buffers;
+};
+
+/**
+ * @def SPMV_INIT
+ * @hideinitializer
+ * @brief Declare and initialize the state of the products.
+ */
+#define SPMV_INIT(NAME)                                                                                                          \
+    BARRIER_INIT(spmv_barrier_##NAME, __SPMV_NR_TASKLETS);                                                                       \
+    __dma_aligned struct __spmv_carry spmv_carries_##NAME[__SPMV_NR_TASKLETS];                                                   \
+    __dma_aligned struct __spmv_buffers spmv_buffers_##NAME[__SPMV_NR_TASKLETS];                                                 \
+    struct spmv NAME = { .barrier = &spmv_barrier_##NAME, .carries = spmv_carries_##NAME, .buffers = spmv_buffers_##NAME };
+
+/* The iteration of a tasklet over its rows: the row offsets are read by batches, and the results written by batches. */
+struct __spmv_rows {
+    const __mram_ptr uint32_t *row_offsets;
+    uint32_t nr_rows;
+    uint32_t first_offset;
+    __mram_ptr int64_t *y;
+    uint32_t first_owned;
+    uint32_t nr_buffered;
+};
+
+static inline uint32_t
+__spmv_read_offset(const __mram_ptr uint32_t *row_offsets, uint32_t row, uint32_t *buffer)
+{
+    mram_read(&row_offsets[row & ~1], buffer, 2 * sizeof(uint32_t));
+    return buffer[row & 1];
+}
+
+/* The first row whose offset is at least the given entry index, among the rows [0, nr_rows]. */
+static inline uint32_t
+__spmv_lower_bound(const __mram_ptr uint32_t *row_offsets, uint32_t nr_rows, uint32_t entry, uint32_t *buffer)
+{
+    uint32_t low = 0, high = nr_rows;
+
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (__spmv_read_offset(row_offsets, middle, buffer) < entry) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/* The offset of a row, among the rows [0, nr_rows]. No offsets are loaded while first_offset is past the last row. */
+static inline uint32_t
+__spmv_offset(struct __spmv_rows *rows, struct __spmv_buffers *buffers, uint32_t row)
+{
+    if (row - rows->first_offset >= SPMV_BATCH) {
+        uint32_t remaining = rows->nr_rows + 1 - (row & ~1);
+        rows->first_offset = row & ~1;
+        mram_read(&rows->row_offsets[rows->first_offset],
+            buffers->offsets,
+            ((remaining < SPMV_BATCH ? remaining : SPMV_BATCH) + 1) / 2 * 2 * sizeof(uint32_t));
+    }
+    return buffers->offsets[row - rows->first_offset];
+}
+
+static inline void
+__spmv_flush(struct __spmv_rows *rows, struct __spmv_buffers *buffers, uint32_t block_size)
+{
+    if (rows->nr_buffered != 0) {
+        mram_write(buffers->ys, &rows->y[rows->first_owned * block_size], rows->nr_buffered * block_size * sizeof(int64_t));
+        rows->first_owned += rows->nr_buffered;
+        rows->nr_buffered = 0;
+    }
+}
+
+/* Completes a row: an owned row is buffered for writing, the first row of a range starting inside it is carried. */
+static inline void
+__spmv_finish(struct spmv *s,
+    struct __spmv_rows *rows,
+    struct __spmv_buffers *buffers,
+    uint32_t row,
+    uint32_t block_size,
+    int64_t *sums)
+{
+    if (row < rows->first_owned) {
+        struct __spmv_carry *carry = &s->carries[me()];
+        carry->row = row;
+        carry->used = true;
+        for (uint32_t i = 0; i < block_size; i++) {
+            carry->sums[i] = sums[i];
+        }
+    } else {
+        for (uint32_t i = 0; i < block_size; i++) {
+            buffers->ys[rows->nr_buffered * block_size + i] = sums[i];
+        }
+        if (++rows->nr_buffered == SPMV_BATCH) {
+            __spmv_flush(rows, buffers, block_size);
+        }
+    }
+    for (uint32_t i = 0; i < block_size; i++) {
+        sums[i] = 0;
+    }
+}
+
+/**
+ * @fn spmv_multiply
+ * @brief Multiplies a sparse MRAM matrix with an MRAM vector: y = A.x.
+ *
+ * Must be called by all the tasklets, with the same arguments. The results are complete when the tasklets return.
+ * The arrays of row offsets, of column indices and of CSR values may be read up to the next multiple of 8 bytes.
+ *
+ * @param s the state of the products
+ * @param format the format of the matrix
+ * @param row_offsets the nr_rows + 1 offsets of the rows in the entries, 8-byte aligned in MRAM
+ * @param columns the column index of each entry, 8-byte aligned in MRAM
+ * @param values the values of each entry, 8-byte aligned in MRAM
+ * @param nr_rows the number of rows of the matrix, counted in blocks in BCSR format
+ * @param x the vector, 8-byte aligned in MRAM, holding SPMV_BLOCK_SIZE elements per column in BCSR format
+ * @param y receives the nr_rows results, SPMV_BLOCK_SIZE per row in BCSR format, 8-byte aligned in MRAM
+ */
+static inline void
+spmv_multiply(struct spmv *s,
+    spmv_format_t format,
+    const __mram_ptr uint32_t *row_offsets,
+    const __mram_ptr uint32_t *columns,
+    const __mram_ptr int32_t *values,
+    uint32_t nr_rows,
+    const __mram_ptr int32_t *x,
+    __mram_ptr int64_t *y)
+{
+    sysname_t id = me();
+    struct __spmv_buffers *buffers = &s->buffers[id];
+    uint32_t block_size = format == SPMV_BCSR ? SPMV_BLOCK_SIZE : 1;
+    uint32_t nr_values = block_size * block_size;
+    uint32_t nr_entries = __spmv_read_offset(row_offsets, nr_rows, buffers->offsets);
+    uint32_t from = ((uint64_t)nr_entries * id / __SPMV_NR_TASKLETS) & ~1;
+    uint32_t to = id == __SPMV_NR_TASKLETS - 1 ? nr_entries : ((uint64_t)nr_entries * (id + 1) / __SPMV_NR_TASKLETS) & ~1;
+    uint32_t row_begin = __spmv_lower_bound(row_offsets, nr_rows, from, buffers->offsets);
+    uint32_t row_end = id == __SPMV_NR_TASKLETS - 1 ? nr_rows : __spmv_lower_bound(row_offsets, nr_rows, to, buffers->offsets);
+    struct __spmv_rows rows = { .row_offsets = row_offsets,
+        .nr_rows = nr_rows,
+        .first_offset = nr_rows + 1,
+        .y = y,
+        .first_owned = row_begin,
+        .nr_buffered = 0 };
+    int64_t sums[SPMV_BLOCK_SIZE] = { 0 };
+    uint32_t row, next_offset;
+
+    s->carries[id].used = false;
+    /* When the range starts inside a row, its first entries complete the row of the previous tasklet. */
+    row = row_begin != 0 && from < __spmv_offset(&rows, buffers, row_begin) ? row_begin - 1 : row_begin;
+    next_offset = row < nr_rows ? __spmv_offset(&rows, buffers, row + 1) : nr_entries;
+
+    for (uint32_t first = from; first < to; first += SPMV_BATCH) {
+        uint32_t n = to - first < SPMV_BATCH ? to - first : SPMV_BATCH;
+        uint32_t even = (n + 1) & ~1;
+
+        mram_read(&columns[first], buffers->columns, even * sizeof(uint32_t));
+        mram_read(&values[first * nr_values], buffers->values, even * nr_values * sizeof(int32_t));
+        mram_gather(x, block_size * sizeof(int32_t), buffers->columns, n, buffers->xs, buffers->order, buffers->window);
+
+        for (uint32_t each_entry = 0; each_entry < n; each_entry++) {
+            while (first + each_entry >= next_offset) {
+                __spmv_finish(s, &rows, buffers, row, block_size, sums);
+                row++;
+                next_offset = __spmv_offset(&rows, buffers, row + 1);
+            }
+            if (format == SPMV_CSR) {
+                sums[0] += (int64_t)buffers->values[each_entry] * buffers->xs[each_entry];
+            } else {
+                const int32_t *block = &buffers->values[each_entry * SPMV_BLOCK_SIZE * SPMV_BLOCK_SIZE];
+                const int32_t *xs = &buffers->xs[each_entry * SPMV_BLOCK_SIZE];
+                for (uint32_t i = 0; i < SPMV_BLOCK_SIZE; i++) {
+                    for (uint32_t j = 0; j < SPMV_BLOCK_SIZE; j++) {
+                        sums[i] += (int64_t)block[i * SPMV_BLOCK_SIZE + j] * xs[j];
+                    }
+                }
+            }
+        }
+    }
+    /* Complete the current row, which can continue in the range of the next tasklet, and the empty rows after it. */
+    while (row < row_end) {
+        __spmv_finish(s, &rows, buffers, row, block_size, sums);
+        row++;
+    }
+    __spmv_flush(&rows, buffers, block_size);
+    barrier_wait(s->barrier);
+
+    if (id == 0) {
+        for (uint32_t each_tasklet = 1; each_tasklet < __SPMV_NR_TASKLETS; each_tasklet++) {
+            struct __spmv_carry *carry = &s->carries[each_tasklet];
+            if (carry->used) {
+                mram_read(&y[carry->row * block_size], buffers->ys, block_size * sizeof(int64_t));
+                for (uint32_t i = 0; i < block_size; i++) {
+                    buffers->ys[i] += carry->sums[i];
+                }
+                mram_write(buffers->ys, &y[carry->row * block_size], block_size * sizeof(int64_t));
+            }
+        }
+    }
+    barrier_wait(s->barrier);
+}
+
+#endif /* DPUSYSCORE_SPMV_H */
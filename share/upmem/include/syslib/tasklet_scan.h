@@ -0,0 +1,234 @@
+/* Copyright 2024 UPMEM. All rights reserved.
+ * Use of this source code is governed by a BSD-style license that can be
+ * found in the LICENSE file.
+ */
+
+#ifndef DPUSYSCORE_TASKLET_SCAN_H
+#define DPUSYSCORE_TASKLET_SCAN_H
+
+/**
+ * @file tasklet_scan.h
+ * @brief Prefix sums across the tasklets of a DPU.
+ *
+ * Partitioning kernels need, for each tasklet, the position of its output among the outputs of all the tasklets: the
+ * exclusive prefix sum of one value per tasklet, or of one histogram per tasklet. The functions of this file must be
+ * called by all the NR_TASKLETS tasklets, and they synchronize the tasklets with a barrier.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <defs.h>
+#include <barrier.h>
+#include <dpu_characteristics.h>
+
+#ifdef NR_TASKLETS
+#define __TASKLET_SCAN_NR_TASKLETS NR_TASKLETS
+#else
+#define __TASKLET_SCAN_NR_TASKLETS DPU_NR_THREADS
+#endif
+
+/**
+ * @struct tasklet_scan
+ * @brief A tasklet scan, as declared by TASKLET_SCAN_INIT.
+ */
+struct tasklet_scan {
+    barrier_t *barrier;
+    uint32_t max_bins;
+    uint32_t (*values)[__TASKLET_SCAN_NR_TASKLETS];
+    uint8_t *phases;
+    uint32_t **histograms;
+    uint32_t *columns;
+    uint32_t *slice_totals;
+};
+
+/**
+ * @def TASKLET_SCAN_INIT
+ * @hideinitializer
+ * @brief Declare and initialize a tasklet scan, handling histograms of at most MAX_BINS bins.
+ *
+ * MAX_BINS can be 0 if tasklet_scan_histograms is not used.
+ */
+#define TASKLET_SCAN_INIT(NAME, MAX_BINS)                                                                                        \
+    BARRIER_INIT(tasklet_scan_barrier_##NAME, __TASKLET_SCAN_NR_TASKLETS);                                                        \
+    uint32_t tasklet_scan_values_##NAME[2][__TASKLET_SCAN_NR_TASKLETS];                                                          \
+    uint8_t tasklet_scan_phases_##NAME[__TASKLET_SCAN_NR_TASKLETS] = { 0 };                                                      \
+    uint32_t *tasklet_scan_histograms_##NAME[__TASKLET_SCAN_NR_TASKLETS];                                                        \
+    uint32_t tasklet_scan_columns_##NAME[(MAX_BINS) + 1];                                                                        \
+    uint32_t tasklet_scan_slice_totals_##NAME[__TASKLET_SCAN_NR_TASKLETS];                                                       \
+    struct tasklet_scan NAME = { .barrier = &tasklet_scan_barrier_##NAME,                                                        \
+        .max_bins = (MAX_BINS),                                                                                                  \
+        .values = tasklet_scan_values_##NAME,                                                                                    \
+        .phases = tasklet_scan_phases_##NAME,                                                                                    \
+        .histograms = tasklet_scan_histograms_##NAME,                                                                            \
+        .columns = tasklet_scan_columns_##NAME,                                                                                  \
+        .slice_totals = tasklet_scan_slice_totals_##NAME };
+
+/**
+ * @fn tasklet_scan_exclusive
+ * @brief Returns the sum of the values given by the tasklets with a smaller id.
+ *
+ * Must be called by all the tasklets. A single barrier is used: the values are double-buffered, so that the function
+ * can be called again right after it returns.
+ *
+ * @param s the tasklet scan
+ * @param value the value of the invoking tasklet
+ * @param total if not NULL, receives the sum of the values of all the tasklets
+ * @return The exclusive prefix sum of the values for the invoking tasklet.
+ */
+static inline uint32_t
+tasklet_scan_exclusive(struct tasklet_scan *s, uint32_t value, uint32_t *total)
+{
+    sysname_t id = me();
+    uint32_t *values = s->values[s->phases[id]];
+    uint32_t prefix = 0;
+    uint32_t sum;
+
+    s->phases[id] ^= 1;
+    values[id] = value;
+    barrier_wait(s->barrier);
+
+    for (sysname_t each_tasklet = 0; each_tasklet < id; each_tasklet++) {
+        prefix += values[each_tasklet];
+    }
+    if (total != NULL) {
+        sum = prefix;
+        for (sysname_t each_tasklet = id; each_tasklet < __TASKLET_SCAN_NR_TASKLETS; each_tasklet++) {
+            sum += values[each_tasklet];
+        }
+        *total = sum;
+    }
+    return prefix;
+}
+
+/**
+ * @struct tasklet_scan_u64
+ * @brief A tasklet scan of 64-bit values, as declared by TASKLET_SCAN_U64_INIT.
+ */
+struct tasklet_scan_u64 {
+    barrier_t *barrier;
+    uint64_t (*values)[__TASKLET_SCAN_NR_TASKLETS];
+    uint8_t *phases;
+};
+
+/**
+ * @def TASKLET_SCAN_U64_INIT
+ * @hideinitializer
+ * @brief Declare and initialize a tasklet scan of 64-bit values, for tasklet_scan_exclusive_u64.
+ */
+#define TASKLET_SCAN_U64_INIT(NAME)                                                                                              \
+    BARRIER_INIT(tasklet_scan_u64_barrier_##NAME, __TASKLET_SCAN_NR_TASKLETS);                                                    \
+    uint64_t tasklet_scan_u64_values_##NAME[2][__TASKLET_SCAN_NR_TASKLETS];                                                      \
+    uint8_t tasklet_scan_u64_phases_##NAME[__TASKLET_SCAN_NR_TASKLETS] = { 0 };                                                  \
+    struct tasklet_scan_u64 NAME = { .barrier = &tasklet_scan_u64_barrier_##NAME,                                                \
+        .values = tasklet_scan_u64_values_##NAME,                                                                                \
+        .phases = tasklet_scan_u64_phases_##NAME };
+
+/**
+ * @fn tasklet_scan_exclusive_u64
+ * @brief Returns the sum of the 64-bit values given by the tasklets with a smaller id.
+ *
+ * Same as tasklet_scan_exclusive, for sums that can exceed 32 bits, such as the prefix sums of 64-bit elements. The
+ * 64-bit values are kept in a scan of their own, so that the other scans do not pay for them in WRAM.
+ *
+ * @param s the tasklet scan of 64-bit values
+ * @param value the value of the invoking tasklet
+ * @param total if not NULL, receives the sum of the values of all the tasklets
+ * @return The exclusive prefix sum of the values for the invoking tasklet.
+ */
+static inline uint64_t
+tasklet_scan_exclusive_u64(struct tasklet_scan_u64 *s, uint64_t value, uint64_t *total)
+{
+    sysname_t id = me();
+    uint64_t *values = s->values[s->phases[id]];
+    uint64_t prefix = 0;
+    uint64_t sum;
+
+    s->phases[id] ^= 1;
+    values[id] = value;
+    barrier_wait(s->barrier);
+
+    for (sysname_t each_tasklet = 0; each_tasklet < id; each_tasklet++) {
+        prefix += values[each_tasklet];
+    }
+    if (total != NULL) {
+        sum = prefix;
+        for (sysname_t each_tasklet = id; each_tasklet < __TASKLET_SCAN_NR_TASKLETS; each_tasklet++) {
+            sum += values[each_tasklet];
+        }
+        *total = sum;
+    }
+    return prefix;
+}
+
+/**
+ * @fn tasklet_scan_histograms
+ * @brief Replaces the histogram of each tasklet by the offsets of its elements in the partitioned output.
+ *
+ * The output holds the elements of bin 0 of all the tasklets (tasklet 0 first), then the elements of bin 1, and so on,
+ * which keeps a partitioning stable when each tasklet handles a contiguous slice of the input. After the call,
+ * histogram[b] is the number of elements of all the bins before b, plus the number of elements of bin b of the tasklets
+ * with a smaller id.
+ *
+ * Must be called by all the tasklets, with the same number of bins. The bins are split between the tasklets, each one
+ * reading and updating a slice of the bins of all the histograms, between three barriers.
+ *
+ * @param s the tasklet scan
+ * @param histogram the histogram of the invoking tasklet, in WRAM
+ * @param nr_bins the number of bins, at most the MAX_BINS of the tasklet scan
+ * @return The total number of elements.
+ */
+static inline uint32_t
+tasklet_scan_histograms(struct tasklet_scan *s, uint32_t *histogram, uint32_t nr_bins)
+{
+    sysname_t id = me();
+    uint32_t bins_per_tasklet = (nr_bins + __TASKLET_SCAN_NR_TASKLETS - 1) / __TASKLET_SCAN_NR_TASKLETS;
+    uint32_t first_bin = id * bins_per_tasklet;
+    uint32_t last_bin = first_bin + bins_per_tasklet;
+    uint32_t prefix = 0;
+    uint32_t total;
+
+    if (first_bin > nr_bins) {
+        first_bin = nr_bins;
+    }
+    if (last_bin > nr_bins) {
+        last_bin = nr_bins;
+    }
+
+    s->histograms[id] = histogram;
+    barrier_wait(s->barrier);
+
+    /* Prefix sum of each bin of the slice across the tasklets. */
+    for (uint32_t each_bin = first_bin; each_bin < last_bin; each_bin++) {
+        uint32_t column = 0;
+        for (sysname_t each_tasklet = 0; each_tasklet < __TASKLET_SCAN_NR_TASKLETS; each_tasklet++) {
+            uint32_t count = s->histograms[each_tasklet][each_bin];
+            s->histograms[each_tasklet][each_bin] = column;
+            column += count;
+        }
+        s->columns[each_bin] = column;
+        prefix += column;
+    }
+    s->slice_totals[id] = prefix;
+    barrier_wait(s->barrier);
+
+    /* Offset of the slice, then of each bin of the slice. */
+    prefix = 0;
+    for (sysname_t each_tasklet = 0; each_tasklet < id; each_tasklet++) {
+        prefix += s->slice_totals[each_tasklet];
+    }
+    total = prefix;
+    for (sysname_t each_tasklet = id; each_tasklet < __TASKLET_SCAN_NR_TASKLETS; each_tasklet++) {
+        total += s->slice_totals[each_tasklet];
+    }
+    for (uint32_t each_bin = first_bin; each_bin < last_bin; each_bin++) {
+        for (sysname_t each_tasklet = 0; each_tasklet < __TASKLET_SCAN_NR_TASKLETS; each_tasklet++) {
+            s->histograms[each_tasklet][each_bin] += prefix;
+        }
+        prefix += s->columns[each_bin];
+    }
+    barrier_wait(s->barrier);
+
+    return total;
+}
+
+#endif /* DPUSYSCORE_TASKLET_SCAN_H */